@@ -0,0 +1,57 @@
+﻿// Точка входа режимов отчетов (Reports.h) для Linux и сборочных машин без GPU и Windows. В Windows
+// те же режимы запускаются из lab6 теми же ключами, а здесь файл пустой. Сборка:
+//   g++ -std=c++17 -O2 -I<DirectXMath> BenchMain.cpp Reports.cpp ReportWriter.cpp LabTests.cpp MicroBenchmark.cpp
+//       SceneFrame.cpp SoftwareRasterizer.cpp SceneGraph.cpp Transforms.cpp TransformBatch.cpp Instancing.cpp
+//       FrustumCulling.cpp TransparencyQueue.cpp OitReference.cpp LightClusters.cpp MeshOptimizer.cpp MeshImporter.cpp
+//       Meshlets.cpp MeshSimplifier.cpp HeadlessRenderer.cpp ImageWriter.cpp CameraDriver.cpp TextureCache.cpp
+//       TextureStreamer.cpp ShaderCache.cpp UploadRing.cpp PackedVertex.cpp MipGenerator.cpp DdsFile.cpp
+//       BlockCompression.cpp CpuFeatures.cpp FileIO.cpp Hash.cpp ThreadPool.cpp FrameProfiler.cpp -lpthread -o lab6_bench
+// Запуск из каталога с текстурами: lab6_bench -cullbench, lab6_bench -test, lab6_bench -benchcompare и т.д.
+// Безоконный режим: lab6_bench -headless 60 -format png -out frames/frame_ или по сценарию камеры до его
+// конца: lab6_bench -headless 0 -camerapath camera_path.txt (HeadlessRenderer.h).
+// Отчет пишется в тот же файл, что и в Windows, и на стандартный вывод. Код возврата 0 - проверки прошли.
+#if !defined(_WIN32)
+
+#include <clocale>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+
+#include "Reports.h"
+
+int main(int argc, char* argv[]) {
+    // Пути в аргументах - в кодировке локали (ее же использует FileIO); числа в сценарии камеры
+    // читаются с точкой, поэтому меняется только кодировка
+    setlocale(LC_CTYPE, "");
+    std::string arguments;
+    for (int i = 1; i < argc; i++) {
+        arguments += ' ';
+        arguments += argv[i];
+    }
+    std::wstring commandLine(arguments.size() + 1, L'\0');
+    const size_t length = mbstowcs(&commandLine[0], arguments.c_str(), commandLine.size());
+    if (length == static_cast<size_t>(-1)) {
+        fprintf(stderr, "cannot convert command line\n");
+        return 1;
+    }
+    commandLine.resize(length);
+
+    const ReportMode* pMode = FindReportMode(commandLine.c_str());
+    if (!pMode) {
+        fprintf(stderr, "usage: %s mode [arguments], modes:", argv[0]);
+        size_t count = 0;
+        const ReportMode* pModes = GetReportModes(count);
+        for (size_t i = 0; i < count; i++) {
+            fprintf(stderr, " %ls", pModes[i].key);
+        }
+        fprintf(stderr, "\n");
+        return 1;
+    }
+
+    ReportWriter report;
+    const bool success = RunReportMode(*pMode, commandLine.c_str(), report);
+    fputs(report.GetText().c_str(), stdout);
+    return success ? 0 : 1;
+}
+
+#endif
@@ -0,0 +1,1390 @@
+﻿#include "BlockCompression.h"
+#include "CpuFeatures.h"
+#include "DdsFile.h"
+
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <utility>
+
+#if defined(_M_X64) || defined(__x86_64__) || defined(__SSE2__) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define BC_HAS_SSE2 1
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#define BC_TARGET_AVX2
+#else
+#define BC_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+#else
+#define BC_HAS_SSE2 0
+#endif
+
+namespace {
+
+enum class BlockKind {
+    BC1,
+    BC2,
+    BC3,
+    BC4U,
+    BC4S,
+    BC5U,
+    BC5S,
+    BC7,
+    Count,
+};
+
+typedef void (*BlockDecoder)(const uint8_t* pBlock, uint32_t* pPixels, size_t pitch);
+
+bool GetBlockKind(uint32_t dxgiFormat, BlockKind& kind) {
+    switch (dxgiFormat) {
+    case DdsFormat::BC1_UNORM:
+    case DdsFormat::BC1_UNORM_SRGB:
+        kind = BlockKind::BC1;
+        return true;
+    case DdsFormat::BC2_UNORM:
+    case DdsFormat::BC2_UNORM_SRGB:
+        kind = BlockKind::BC2;
+        return true;
+    case DdsFormat::BC3_UNORM:
+    case DdsFormat::BC3_UNORM_SRGB:
+        kind = BlockKind::BC3;
+        return true;
+    case DdsFormat::BC4_UNORM:
+        kind = BlockKind::BC4U;
+        return true;
+    case DdsFormat::BC4_SNORM:
+        kind = BlockKind::BC4S;
+        return true;
+    case DdsFormat::BC5_UNORM:
+        kind = BlockKind::BC5U;
+        return true;
+    case DdsFormat::BC5_SNORM:
+        kind = BlockKind::BC5S;
+        return true;
+    case DdsFormat::BC7_UNORM:
+    case DdsFormat::BC7_UNORM_SRGB:
+        kind = BlockKind::BC7;
+        return true;
+    default:
+        return false;
+    }
+}
+
+inline uint32_t ReadU32(const uint8_t* p) {
+    uint32_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+inline uint64_t ReadU64(const uint8_t* p) {
+    uint64_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+// 48 бит индексов альфа-блока BC3/BC4/BC5 (3 бита на пиксель)
+inline uint64_t ReadAlphaIndices(const uint8_t* pAlphaBlock) {
+    return ReadU64(pAlphaBlock) >> 16;
+}
+
+inline uint32_t PackRgba(uint32_t r, uint32_t g, uint32_t b, uint32_t a) {
+    return r | (g << 8) | (b << 16) | (a << 24);
+}
+
+// ---------------------------------------------------------------------------------------------
+// Палитры (общие для всех реализаций, поэтому результат совпадает побитово)
+
+// Палитра цветового блока BC1-BC3. В BC2/BC3 всегда четырехцветный режим.
+void BuildColorPalette(const uint8_t* pColorBlock, bool bc1, uint32_t palette[4]) {
+    const uint32_t c0 = pColorBlock[0] | (pColorBlock[1] << 8);
+    const uint32_t c1 = pColorBlock[2] | (pColorBlock[3] << 8);
+
+    const uint32_t r0 = ((c0 >> 11) << 3) | (c0 >> 13);
+    const uint32_t g0 = (((c0 >> 5) & 63) << 2) | ((c0 >> 9) & 3);
+    const uint32_t b0 = ((c0 & 31) << 3) | ((c0 >> 2) & 7);
+    const uint32_t r1 = ((c1 >> 11) << 3) | (c1 >> 13);
+    const uint32_t g1 = (((c1 >> 5) & 63) << 2) | ((c1 >> 9) & 3);
+    const uint32_t b1 = ((c1 & 31) << 3) | ((c1 >> 2) & 7);
+
+    palette[0] = PackRgba(r0, g0, b0, 255);
+    palette[1] = PackRgba(r1, g1, b1, 255);
+    if (!bc1 || c0 > c1) {
+        palette[2] = PackRgba((2 * r0 + r1 + 1) / 3, (2 * g0 + g1 + 1) / 3, (2 * b0 + b1 + 1) / 3, 255);
+        palette[3] = PackRgba((r0 + 2 * r1 + 1) / 3, (g0 + 2 * g1 + 1) / 3, (b0 + 2 * b1 + 1) / 3, 255);
+    }
+    else {
+        // Трехцветный режим BC1: четвертый цвет - прозрачный черный
+        palette[2] = PackRgba((r0 + r1 + 1) / 2, (g0 + g1 + 1) / 2, (b0 + b1 + 1) / 2, 255);
+        palette[3] = 0;
+    }
+}
+
+// Деление с округлением от нуля (для SNORM-интерполяции)
+inline int DivRound(int value, int divisor) {
+    return value >= 0 ? (value + divisor / 2) / divisor : -((-value + divisor / 2) / divisor);
+}
+
+// Палитра альфа-блока BC3 / канала BC4/BC5 (8 значений)
+void BuildAlphaPalette(const uint8_t* pAlphaBlock, bool isSigned, uint8_t palette[8]) {
+    int a0;
+    int a1;
+    if (isSigned) {
+        a0 = static_cast<int8_t>(pAlphaBlock[0]);
+        a1 = static_cast<int8_t>(pAlphaBlock[1]);
+        // -128 и -127 оба означают -1.0
+        a0 = a0 < -127 ? -127 : a0;
+        a1 = a1 < -127 ? -127 : a1;
+    }
+    else {
+        a0 = pAlphaBlock[0];
+        a1 = pAlphaBlock[1];
+    }
+
+    int values[8];
+    values[0] = a0;
+    values[1] = a1;
+    if (a0 > a1) {
+        for (int i = 1; i <= 6; i++) {
+            values[i + 1] = DivRound((7 - i) * a0 + i * a1, 7);
+        }
+    }
+    else {
+        for (int i = 1; i <= 4; i++) {
+            values[i + 1] = DivRound((5 - i) * a0 + i * a1, 5);
+        }
+        values[6] = isSigned ? -127 : 0;
+        values[7] = isSigned ? 127 : 255;
+    }
+
+    for (int i = 0; i < 8; i++) {
+        palette[i] = static_cast<uint8_t>(isSigned ? values[i] + 128 : values[i]);
+    }
+}
+
+// ---------------------------------------------------------------------------------------------
+// BC7: разбор блока в концы отрезков и веса для каждого пикселя и канала
+
+struct Bc7ModeInfo {
+    uint8_t subsetCount;
+    uint8_t partitionBits;
+    uint8_t rotationBits;
+    uint8_t indexSelectionBits;
+    uint8_t colorBits;
+    uint8_t alphaBits;
+    uint8_t endpointPBits; // P-бит на каждый конец отрезка
+    uint8_t sharedPBits;   // P-бит на подмножество
+    uint8_t indexBits;
+    uint8_t secondaryIndexBits;
+};
+
+const Bc7ModeInfo kBc7Modes[8] = {
+    { 3, 4, 0, 0, 4, 0, 1, 0, 3, 0 },
+    { 2, 6, 0, 0, 6, 0, 0, 1, 3, 0 },
+    { 3, 6, 0, 0, 5, 0, 0, 0, 2, 0 },
+    { 2, 6, 0, 0, 7, 0, 1, 0, 2, 0 },
+    { 1, 0, 2, 1, 5, 6, 0, 0, 2, 3 },
+    { 1, 0, 2, 0, 7, 8, 0, 0, 2, 2 },
+    { 1, 0, 0, 0, 7, 7, 1, 0, 4, 0 },
+    { 2, 6, 0, 0, 5, 5, 1, 0, 2, 0 },
+};
+
+// Разбиения на 2 подмножества: бит i - подмножество пикселя i
+const uint16_t kBc7Partitions2[64] = {
+    0xCCCC, 0x8888, 0xEEEE, 0xECC8, 0xC880, 0xFEEC, 0xFEC8, 0xEC80,
+    0xC800, 0xFFEC, 0xFE80, 0xE800, 0xFFE8, 0xFF00, 0xFFF0, 0xF000,
+    0xF710, 0x008E, 0x7100, 0x08CE, 0x008C, 0x7310, 0x3100, 0x8CCE,
+    0x088C, 0x3110, 0x6666, 0x366C, 0x17E8, 0x0FF0, 0x718E, 0x399C,
+    0xAAAA, 0xF0F0, 0x5A5A, 0x33CC, 0x3C3C, 0x55AA, 0x9696, 0xA55A,
+    0x73CE, 0x13C8, 0x324C, 0x3BDC, 0x6996, 0xC33C, 0x9966, 0x0660,
+    0x0272, 0x04E4, 0x4E40, 0x2720, 0xC936, 0x936C, 0x39C6, 0x639C,
+    0x9336, 0x9CC6, 0x817E, 0xE718, 0xCCF0, 0x0FCC, 0x7744, 0xEE22,
+};
+
+// Разбиения на 3 подмножества
+const uint8_t kBc7Partitions3[64][16] = {
+    { 0, 0, 1, 1, 0, 0, 1, 1, 0, 2, 2, 1, 2, 2, 2, 2 },
+    { 0, 0, 0, 1, 0, 0, 1, 1, 2, 2, 1, 1, 2, 2, 2, 1 },
+    { 0, 0, 0, 0, 2, 0, 0, 1, 2, 2, 1, 1, 2, 2, 1, 1 },
+    { 0, 2, 2, 2, 0, 0, 2, 2, 0, 0, 1, 1, 0, 1, 1, 1 },
+    { 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 2, 2, 1, 1, 2, 2 },
+    { 0, 0, 1, 1, 0, 0, 1, 1, 0, 0, 2, 2, 0, 0, 2, 2 },
+    { 0, 0, 2, 2, 0, 0, 2, 2, 1, 1, 1, 1, 1, 1, 1, 1 },
+    { 0, 0, 1, 1, 0, 0, 1, 1, 2, 2, 1, 1, 2, 2, 1, 1 },
+    { 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2 },
+    { 0, 0, 0, 0, 1, 1, 1, 1, 1, 1, 1, 1, 2, 2, 2, 2 },
+    { 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 2, 2, 2, 2 },
+    { 0, 0, 1, 2, 0, 0, 1, 2, 0, 0, 1, 2, 0, 0, 1, 2 },
+    { 0, 1, 1, 2, 0, 1, 1, 2, 0, 1, 1, 2, 0, 1, 1, 2 },
+    { 0, 1, 2, 2, 0, 1, 2, 2, 0, 1, 2, 2, 0, 1, 2, 2 },
+    { 0, 0, 1, 1, 0, 1, 1, 2, 1, 1, 2, 2, 1, 2, 2, 2 },
+    { 0, 0, 1, 1, 2, 0, 0, 1, 2, 2, 0, 0, 2, 2, 2, 0 },
+    { 0, 0, 0, 1, 0, 0, 1, 1, 0, 1, 1, 2, 1, 1, 2, 2 },
+    { 0, 1, 1, 1, 0, 0, 1, 1, 2, 0, 0, 1, 2, 2, 0, 0 },
+    { 0, 0, 0, 0, 1, 1, 2, 2, 1, 1, 2, 2, 1, 1, 2, 2 },
+    { 0, 0, 2, 2, 0, 0, 2, 2, 0, 0, 2, 2, 1, 1, 1, 1 },
+    { 0, 1, 1, 1, 0, 1, 1, 1, 0, 2, 2, 2, 0, 2, 2, 2 },
+    { 0, 0, 0, 1, 0, 0, 0, 1, 2, 2, 2, 1, 2, 2, 2, 1 },
+    { 0, 0, 0, 0, 0, 0, 1, 1, 0, 1, 2, 2, 0, 1, 2, 2 },
+    { 0, 0, 0, 0, 1, 1, 0, 0, 2, 2, 1, 0, 2, 2, 1, 0 },
+    { 0, 1, 2, 2, 0, 1, 2, 2, 0, 0, 1, 1, 0, 0, 0, 0 },
+    { 0, 0, 1, 2, 0, 0, 1, 2, 1, 1, 2, 2, 2, 2, 2, 2 },
+    { 0, 1, 1, 0, 1, 2, 2, 1, 1, 2, 2, 1, 0, 1, 1, 0 },
+    { 0, 0, 0, 0, 0, 1, 1, 0, 1, 2, 2, 1, 1, 2, 2, 1 },
+    { 0, 0, 2, 2, 1, 1, 0, 2, 1, 1, 0, 2, 0, 0, 2, 2 },
+    { 0, 1, 1, 0, 0, 1, 1, 0, 2, 0, 0, 2, 2, 2, 2, 2 },
+    { 0, 0, 1, 1, 0, 1, 2, 2, 0, 1, 2, 2, 0, 0, 1, 1 },
+    { 0, 0, 0, 0, 2, 0, 0, 0, 2, 2, 1, 1, 2, 2, 2, 1 },
+    { 0, 0, 0, 0, 0, 0, 0, 2, 1, 1, 2, 2, 1, 2, 2, 2 },
+    { 0, 2, 2, 2, 0, 0, 2, 2, 0, 0, 1, 2, 0, 0, 1, 1 },
+    { 0, 0, 1, 1, 0, 0, 1, 2, 0, 0, 2, 2, 0, 2, 2, 2 },
+    { 0, 1, 2, 0, 0, 1, 2, 0, 0, 1, 2, 0, 0, 1, 2, 0 },
+    { 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 0, 0, 0, 0 },
+    { 0, 1, 2, 0, 1, 2, 0, 1, 2, 0, 1, 2, 0, 1, 2, 0 },
+    { 0, 1, 2, 0, 2, 0, 1, 2, 1, 2, 0, 1, 0, 1, 2, 0 },
+    { 0, 0, 1, 1, 2, 2, 0, 0, 1, 1, 2, 2, 0, 0, 1, 1 },
+    { 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 0, 0, 0, 0, 1, 1 },
+    { 0, 1, 0, 1, 0, 1, 0, 1, 2, 2, 2, 2, 2, 2, 2, 2 },
+    { 0, 0, 0, 0, 0, 0, 0, 0, 2, 1, 2, 1, 2, 1, 2, 1 },
+    { 0, 0, 2, 2, 1, 1, 2, 2, 0, 0, 2, 2, 1, 1, 2, 2 },
+    { 0, 0, 2, 2, 0, 0, 1, 1, 0, 0, 2, 2, 0, 0, 1, 1 },
+    { 0, 2, 2, 0, 1, 2, 2, 1, 0, 2, 2, 0, 1, 2, 2, 1 },
+    { 0, 1, 0, 1, 2, 2, 2, 2, 2, 2, 2, 2, 0, 1, 0, 1 },
+    { 0, 0, 0, 0, 2, 1, 2, 1, 2, 1, 2, 1, 2, 1, 2, 1 },
+    { 0, 1, 0, 1, 0, 1, 0, 1, 0, 1, 0, 1, 2, 2, 2, 2 },
+    { 0, 2, 2, 2, 0, 1, 1, 1, 0, 2, 2, 2, 0, 1, 1, 1 },
+    { 0, 0, 0, 2, 1, 1, 1, 2, 0, 0, 0, 2, 1, 1, 1, 2 },
+    { 0, 0, 0, 0, 2, 1, 1, 2, 2, 1, 1, 2, 2, 1, 1, 2 },
+    { 0, 2, 2, 2, 0, 1, 1, 1, 0, 1, 1, 1, 0, 2, 2, 2 },
+    { 0, 0, 0, 2, 1, 1, 1, 2, 1, 1, 1, 2, 0, 0, 0, 2 },
+    { 0, 1, 1, 0, 0, 1, 1, 0, 0, 1, 1, 0, 2, 2, 2, 2 },
+    { 0, 0, 0, 0, 0, 0, 0, 0, 2, 1, 1, 2, 2, 1, 1, 2 },
+    { 0, 1, 1, 0, 0, 1, 1, 0, 2, 2, 2, 2, 2, 2, 2, 2 },
+    { 0, 0, 2, 2, 0, 0, 1, 1, 0, 0, 1, 1, 0, 0, 2, 2 },
+    { 0, 0, 2, 2, 1, 1, 2, 2, 1, 1, 2, 2, 0, 0, 2, 2 },
+    { 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 2, 1, 1, 2 },
+    { 0, 0, 0, 2, 0, 0, 0, 1, 0, 0, 0, 2, 0, 0, 0, 1 },
+    { 0, 2, 2, 2, 1, 2, 2, 2, 0, 2, 2, 2, 1, 2, 2, 2 },
+    { 0, 1, 0, 1, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2 },
+    { 0, 1, 1, 1, 2, 0, 1, 1, 2, 2, 0, 1, 2, 2, 2, 0 },
+};
+
+// Опорные (anchor) пиксели подмножеств: их индексы хранятся на бит короче
+const uint8_t kBc7Anchors2[64] = {
+    15, 15, 15, 15, 15, 15, 15, 15,
+    15, 15, 15, 15, 15, 15, 15, 15,
+    15, 2, 8, 2, 2, 8, 8, 15,
+    2, 8, 2, 2, 8, 8, 2, 2,
+    15, 15, 6, 8, 2, 8, 15, 15,
+    2, 8, 2, 2, 2, 15, 15, 6,
+    6, 2, 6, 8, 15, 15, 2, 2,
+    15, 15, 15, 15, 15, 2, 2, 15,
+};
+
+const uint8_t kBc7Anchors3Second[64] = {
+    3, 3, 15, 15, 8, 3, 15, 15,
+    8, 8, 6, 6, 6, 5, 3, 3,
+    3, 3, 8, 15, 3, 3, 6, 10,
+    5, 8, 8, 6, 8, 5, 15, 15,
+    8, 15, 3, 5, 6, 10, 8, 15,
+    15, 3, 15, 5, 15, 15, 15, 15,
+    3, 15, 5, 5, 5, 8, 5, 10,
+    5, 10, 8, 13, 15, 12, 3, 3,
+};
+
+const uint8_t kBc7Anchors3Third[64] = {
+    15, 8, 8, 3, 15, 15, 3, 8,
+    15, 15, 15, 15, 15, 15, 15, 8,
+    15, 8, 15, 3, 15, 8, 15, 8,
+    3, 15, 6, 10, 15, 15, 10, 8,
+    15, 3, 15, 10, 10, 8, 9, 10,
+    6, 15, 8, 15, 3, 6, 6, 8,
+    15, 3, 15, 15, 15, 15, 15, 15,
+    15, 15, 15, 15, 3, 15, 15, 8,
+};
+
+const uint8_t kBc7Weights2[4] = { 0, 21, 43, 64 };
+const uint8_t kBc7Weights3[8] = { 0, 9, 18, 27, 37, 46, 55, 64 };
+const uint8_t kBc7Weights4[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+inline const uint8_t* GetBc7Weights(uint32_t indexBits) {
+    return indexBits == 2 ? kBc7Weights2 : (indexBits == 3 ? kBc7Weights3 : kBc7Weights4);
+}
+
+class Bc7BitReader {
+public:
+    explicit Bc7BitReader(const uint8_t* pBlock) : m_lo(ReadU64(pBlock)), m_hi(ReadU64(pBlock + 8)) {}
+
+    uint32_t Read(uint32_t count) {
+        uint64_t bits;
+        if (m_pos >= 64) {
+            bits = m_hi >> (m_pos - 64);
+        }
+        else if (m_pos == 0) {
+            bits = m_lo;
+        }
+        else {
+            bits = (m_lo >> m_pos) | (m_hi << (64 - m_pos));
+        }
+        m_pos += count;
+        return static_cast<uint32_t>(bits & ((1ull << count) - 1));
+    }
+
+    void Skip(uint32_t count) { m_pos += count; }
+
+private:
+    uint64_t m_lo;
+    uint64_t m_hi;
+    uint32_t m_pos = 0;
+};
+
+// Интерполяция для пикселя i и канала c: ((64 - w) * e0 + w * e1 + 32) >> 6, индекс i * 4 + c
+struct Bc7Unpacked {
+    uint8_t e0[64];
+    uint8_t e1[64];
+    uint8_t weight[64];
+};
+
+inline uint8_t UnquantizeBc7(uint32_t value, uint32_t bits) {
+    return static_cast<uint8_t>((value << (8 - bits)) | (value >> (2 * bits - 8)));
+}
+
+void UnpackBc7(const uint8_t* pBlock, Bc7Unpacked& out) {
+    uint32_t mode = 0;
+    while (mode < 8 && !(pBlock[0] & (1u << mode))) {
+        mode++;
+    }
+    if (mode == 8) {
+        // Зарезервированный режим: блок распаковывается в прозрачный черный
+        memset(&out, 0, sizeof(out));
+        return;
+    }
+
+    const Bc7ModeInfo& info = kBc7Modes[mode];
+    Bc7BitReader reader(pBlock);
+    reader.Skip(mode + 1);
+    const uint32_t partition = reader.Read(info.partitionBits);
+    const uint32_t rotation = reader.Read(info.rotationBits);
+    const uint32_t indexSelection = reader.Read(info.indexSelectionBits);
+
+    const uint32_t endpointCount = info.subsetCount * 2u;
+    uint32_t endpoints[6][4];
+    for (uint32_t c = 0; c < 3; c++) {
+        for (uint32_t e = 0; e < endpointCount; e++) {
+            endpoints[e][c] = reader.Read(info.colorBits);
+        }
+    }
+    for (uint32_t e = 0; e < endpointCount; e++) {
+        endpoints[e][3] = info.alphaBits ? reader.Read(info.alphaBits) : 255;
+    }
+
+    uint32_t pBits[6] = {};
+    const bool hasPBit = info.endpointPBits || info.sharedPBits;
+    if (info.endpointPBits) {
+        for (uint32_t e = 0; e < endpointCount; e++) {
+            pBits[e] = reader.Read(1);
+        }
+    }
+    else if (info.sharedPBits) {
+        for (uint32_t s = 0; s < info.subsetCount; s++) {
+            pBits[s * 2] = pBits[s * 2 + 1] = reader.Read(1);
+        }
+    }
+
+    uint8_t colors[6][4];
+    for (uint32_t e = 0; e < endpointCount; e++) {
+        for (uint32_t c = 0; c < 4; c++) {
+            uint32_t bits = c < 3 ? info.colorBits : info.alphaBits;
+            if (bits == 0) {
+                colors[e][c] = 255;
+                continue;
+            }
+            uint32_t value = endpoints[e][c];
+            if (hasPBit) {
+                value = (value << 1) | pBits[e];
+                bits++;
+            }
+            colors[e][c] = UnquantizeBc7(value, bits);
+        }
+    }
+
+    uint8_t subsets[16];
+    uint32_t anchors[3] = { 0, 0, 0 };
+    for (uint32_t i = 0; i < 16; i++) {
+        if (info.subsetCount == 1) {
+            subsets[i] = 0;
+        }
+        else if (info.subsetCount == 2) {
+            subsets[i] = static_cast<uint8_t>((kBc7Partitions2[partition] >> i) & 1);
+        }
+        else {
+            subsets[i] = kBc7Partitions3[partition][i];
+        }
+    }
+    if (info.subsetCount == 2) {
+        anchors[1] = kBc7Anchors2[partition];
+    }
+    else if (info.subsetCount == 3) {
+        anchors[1] = kBc7Anchors3Second[partition];
+        anchors[2] = kBc7Anchors3Third[partition];
+    }
+
+    uint8_t indices[16];
+    for (uint32_t i = 0; i < 16; i++) {
+        indices[i] = static_cast<uint8_t>(reader.Read(info.indexBits - (i == anchors[subsets[i]] ? 1 : 0)));
+    }
+    uint8_t secondaryIndices[16] = {};
+    if (info.secondaryIndexBits) {
+        for (uint32_t i = 0; i < 16; i++) {
+            secondaryIndices[i] = static_cast<uint8_t>(reader.Read(info.secondaryIndexBits - (i == 0 ? 1 : 0)));
+        }
+    }
+
+    // Режим 4: бит выбора индексов меняет местами наборы для цвета и альфы
+    const uint8_t* colorIndices = indices;
+    const uint8_t* alphaIndices = indices;
+    const uint8_t* colorWeights = GetBc7Weights(info.indexBits);
+    const uint8_t* alphaWeights = colorWeights;
+    if (info.secondaryIndexBits) {
+        alphaIndices = secondaryIndices;
+        alphaWeights = GetBc7Weights(info.secondaryIndexBits);
+        if (indexSelection) {
+            std::swap(colorIndices, alphaIndices);
+            std::swap(colorWeights, alphaWeights);
+        }
+    }
+
+    for (uint32_t i = 0; i < 16; i++) {
+        const uint8_t* c0 = colors[subsets[i] * 2];
+        const uint8_t* c1 = colors[subsets[i] * 2 + 1];
+        for (uint32_t c = 0; c < 4; c++) {
+            out.e0[i * 4 + c] = c0[c];
+            out.e1[i * 4 + c] = c1[c];
+            out.weight[i * 4 + c] = c < 3 ? colorWeights[colorIndices[i]] : alphaWeights[alphaIndices[i]];
+        }
+        // Поворот каналов: альфа меняется местами с R, G или B. Интерполяция поканальная,
+        // поэтому менять можно до нее.
+        if (rotation) {
+            const uint32_t c = i * 4 + rotation - 1;
+            std::swap(out.e0[i * 4 + 3], out.e0[c]);
+            std::swap(out.e1[i * 4 + 3], out.e1[c]);
+            std::swap(out.weight[i * 4 + 3], out.weight[c]);
+        }
+    }
+}
+
+// ---------------------------------------------------------------------------------------------
+// Скалярная (эталонная) реализация
+
+inline void StoreBlock(const uint32_t block[16], uint32_t* pPixels, size_t pitch) {
+    for (uint32_t y = 0; y < 4; y++) {
+        memcpy(pPixels + y * pitch, block + y * 4, 4 * sizeof(uint32_t));
+    }
+}
+
+void DecodeColorScalar(const uint8_t* pColorBlock, bool bc1, uint32_t out[16]) {
+    uint32_t palette[4];
+    BuildColorPalette(pColorBlock, bc1, palette);
+    const uint32_t indices = ReadU32(pColorBlock + 4);
+    for (uint32_t i = 0; i < 16; i++) {
+        out[i] = palette[(indices >> (2 * i)) & 3];
+    }
+}
+
+void DecodeAlphaScalar(const uint8_t* pAlphaBlock, bool isSigned, uint8_t out[16]) {
+    uint8_t palette[8];
+    BuildAlphaPalette(pAlphaBlock, isSigned, palette);
+    const uint64_t indices = ReadAlphaIndices(pAlphaBlock);
+    for (uint32_t i = 0; i < 16; i++) {
+        out[i] = palette[(indices >> (3 * i)) & 7];
+    }
+}
+
+void DecodeBc1Scalar(const uint8_t* pBlock, uint32_t* pPixels, size_t pitch) {
+    uint32_t block[16];
+    DecodeColorScalar(pBlock, true, block);
+    StoreBlock(block, pPixels, pitch);
+}
+
+void DecodeBc2Scalar(const uint8_t* pBlock, uint32_t* pPixels, size_t pitch) {
+    uint32_t block[16];
+    DecodeColorScalar(pBlock + 8, false, block);
+    const uint64_t alpha = ReadU64(pBlock);
+    for (uint32_t i = 0; i < 16; i++) {
+        block[i] = (block[i] & 0x00FFFFFF) | (static_cast<uint32_t>((alpha >> (4 * i)) & 15) * 17 << 24);
+    }
+    StoreBlock(block, pPixels, pitch);
+}
+
+void DecodeBc3Scalar(const uint8_t* pBlock, uint32_t* pPixels, size_t pitch) {
+    uint32_t block[16];
+    uint8_t alpha[16];
+    DecodeColorScalar(pBlock + 8, false, block);
+    DecodeAlphaScalar(pBlock, false, alpha);
+    for (uint32_t i = 0; i < 16; i++) {
+        block[i] = (block[i] & 0x00FFFFFF) | (static_cast<uint32_t>(alpha[i]) << 24);
+    }
+    StoreBlock(block, pPixels, pitch);
+}
+
+template <bool isSigned>
+void DecodeBc4Scalar(const uint8_t* pBlock, uint32_t* pPixels, size_t pitch) {
+    uint32_t block[16];
+    uint8_t red[16];
+    DecodeAlphaScalar(pBlock, isSigned, red);
+    for (uint32_t i = 0; i < 16; i++) {
+        block[i] = PackRgba(red[i], 0, 0, 255);
+    }
+    StoreBlock(block, pPixels, pitch);
+}
+
+template <bool isSigned>
+void DecodeBc5Scalar(const uint8_t* pBlock, uint32_t* pPixels, size_t pitch) {
+    uint32_t block[16];
+    uint8_t red[16];
+    uint8_t green[16];
+    DecodeAlphaScalar(pBlock, isSigned, red);
+    DecodeAlphaScalar(pBlock + 8, isSigned, green);
+    for (uint32_t i = 0; i < 16; i++) {
+        block[i] = PackRgba(red[i], green[i], 0, 255);
+    }
+    StoreBlock(block, pPixels, pitch);
+}
+
+void DecodeBc7Scalar(const uint8_t* pBlock, uint32_t* pPixels, size_t pitch) {
+    Bc7Unpacked unpacked;
+    UnpackBc7(pBlock, unpacked);
+    uint8_t block[64];
+    for (uint32_t i = 0; i < 64; i++) {
+        const uint32_t w = unpacked.weight[i];
+        block[i] = static_cast<uint8_t>(((64 - w) * unpacked.e0[i] + w * unpacked.e1[i] + 32) >> 6);
+    }
+    for (uint32_t y = 0; y < 4; y++) {
+        memcpy(pPixels + y * pitch, block + y * 16, 16);
+    }
+}
+
+const BlockDecoder kScalarDecoders[static_cast<int>(BlockKind::Count)] = {
+    DecodeBc1Scalar,
+    DecodeBc2Scalar,
+    DecodeBc3Scalar,
+    DecodeBc4Scalar<false>,
+    DecodeBc4Scalar<true>,
+    DecodeBc5Scalar<false>,
+    DecodeBc5Scalar<true>,
+    DecodeBc7Scalar,
+};
+
+#if BC_HAS_SSE2
+
+// ---------------------------------------------------------------------------------------------
+// SSE2: пиксели - 32-битные слова, по строке (4 пикселя) на регистр. Значения выбираются
+// из палитры без сравнений: биты индекса превращаются в маски, маски выбирают между парами.
+
+inline void StoreRowsSse2(const __m128i rows[4], uint32_t* pPixels, size_t pitch) {
+    for (uint32_t y = 0; y < 4; y++) {
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(pPixels + y * pitch), rows[y]);
+    }
+}
+
+// mask ? b : a, где diff = a ^ b
+inline __m128i SelectSse2(__m128i a, __m128i diff, __m128i mask) {
+    return _mm_xor_si128(a, _mm_and_si128(diff, mask));
+}
+
+// Цвета 16 пикселей по 2-битным индексам. Умножение 16-битного слова переносит нужный бит
+// индекса в знаковый разряд, арифметический сдвиг размножает его в маску.
+void DecodeColorSse2(const uint32_t palette[4], uint32_t indices, __m128i rows[4]) {
+    const __m128i c0 = _mm_set1_epi32(static_cast<int>(palette[0]));
+    const __m128i d01 = _mm_set1_epi32(static_cast<int>(palette[0] ^ palette[1]));
+    const __m128i c2 = _mm_set1_epi32(static_cast<int>(palette[2]));
+    const __m128i d23 = _mm_set1_epi32(static_cast<int>(palette[2] ^ palette[3]));
+    const __m128i toBit0 = _mm_setr_epi16(-32768, 1 << 13, 1 << 11, 1 << 9, -32768, 1 << 13, 1 << 11, 1 << 9);
+    const __m128i toBit1 = _mm_setr_epi16(1 << 14, 1 << 12, 1 << 10, 1 << 8, 1 << 14, 1 << 12, 1 << 10, 1 << 8);
+
+    const __m128i words = _mm_unpacklo_epi8(_mm_cvtsi32_si128(static_cast<int>(indices)), _mm_setzero_si128());
+    const __m128i pairs = _mm_unpacklo_epi16(words, words);
+    for (uint32_t half = 0; half < 2; half++) {
+        // Байт индексов строки, повторенный в 4 словах: строки 0 и 1 или 2 и 3
+        const __m128i rowBytes = half ? _mm_unpackhi_epi32(pairs, pairs) : _mm_unpacklo_epi32(pairs, pairs);
+        const __m128i bit0 = _mm_srai_epi16(_mm_mullo_epi16(rowBytes, toBit0), 15);
+        const __m128i bit1 = _mm_srai_epi16(_mm_mullo_epi16(rowBytes, toBit1), 15);
+        for (uint32_t row = 0; row < 2; row++) {
+            const __m128i mask0 = row ? _mm_unpackhi_epi16(bit0, bit0) : _mm_unpacklo_epi16(bit0, bit0);
+            const __m128i mask1 = row ? _mm_unpackhi_epi16(bit1, bit1) : _mm_unpacklo_epi16(bit1, bit1);
+            const __m128i lo = SelectSse2(c0, d01, mask0);
+            const __m128i hi = SelectSse2(c2, d23, mask0);
+            rows[half * 2 + row] = SelectSse2(lo, _mm_xor_si128(lo, hi), mask1);
+        }
+    }
+}
+
+// 24 бита (8 индексов по 3 бита) -> 8 байт, по индексу в байте
+inline uint64_t SpreadAlphaIndices(uint64_t bits) {
+    bits = (bits & 0xFFF) | ((bits & 0xFFF000) << 20);
+    bits = (bits & 0x0000003F0000003Full) | ((bits & 0x00000FC000000FC0ull) << 10);
+    return (bits & 0x0007000700070007ull) | ((bits & 0x0038003800380038ull) << 5);
+}
+
+// Канал из 8-значной палитры (BC3/BC4/BC5): 16 байт, по байту на пиксель
+__m128i DecodeAlphaSse2(const uint8_t palette[8], uint64_t indices) {
+    const __m128i index = _mm_set_epi64x(static_cast<long long>(SpreadAlphaIndices(indices >> 24)),
+        static_cast<long long>(SpreadAlphaIndices(indices & 0xFFFFFF)));
+    __m128i masks[3];
+    for (int k = 0; k < 3; k++) {
+        const __m128i bit = _mm_set1_epi8(static_cast<char>(1 << k));
+        masks[k] = _mm_cmpeq_epi8(_mm_and_si128(index, bit), bit);
+    }
+
+    // Каждое значение палитры размножается на все 16 байт
+    const __m128i words = _mm_unpacklo_epi8(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(palette)),
+        _mm_loadl_epi64(reinterpret_cast<const __m128i*>(palette)));
+    const __m128i lowWords = _mm_unpacklo_epi64(words, words);
+    const __m128i highWords = _mm_unpackhi_epi64(words, words);
+    const __m128i v0 = _mm_shuffle_epi32(_mm_shufflelo_epi16(lowWords, 0x00), 0);
+    const __m128i v1 = _mm_shuffle_epi32(_mm_shufflelo_epi16(lowWords, 0x55), 0);
+    const __m128i v2 = _mm_shuffle_epi32(_mm_shufflelo_epi16(lowWords, 0xAA), 0);
+    const __m128i v3 = _mm_shuffle_epi32(_mm_shufflelo_epi16(lowWords, 0xFF), 0);
+    const __m128i v4 = _mm_shuffle_epi32(_mm_shufflelo_epi16(highWords, 0x00), 0);
+    const __m128i v5 = _mm_shuffle_epi32(_mm_shufflelo_epi16(highWords, 0x55), 0);
+    const __m128i v6 = _mm_shuffle_epi32(_mm_shufflelo_epi16(highWords, 0xAA), 0);
+    const __m128i v7 = _mm_shuffle_epi32(_mm_shufflelo_epi16(highWords, 0xFF), 0);
+
+    // Дерево выбора: бит 0 - внутри пар, бит 1 - между парами, бит 2 - между четверками
+    const __m128i l0 = SelectSse2(v0, _mm_xor_si128(v0, v1), masks[0]);
+    const __m128i l1 = SelectSse2(v2, _mm_xor_si128(v2, v3), masks[0]);
+    const __m128i l2 = SelectSse2(v4, _mm_xor_si128(v4, v5), masks[0]);
+    const __m128i l3 = SelectSse2(v6, _mm_xor_si128(v6, v7), masks[0]);
+    const __m128i q0 = SelectSse2(l0, _mm_xor_si128(l0, l1), masks[1]);
+    const __m128i q1 = SelectSse2(l2, _mm_xor_si128(l2, l3), masks[1]);
+    return SelectSse2(q0, _mm_xor_si128(q0, q1), masks[2]);
+}
+
+// 16 байт канала -> байт channel в каждом из 16 пикселей (строки rows[0..3])
+inline void ExpandChannelSse2(__m128i values, uint32_t channel, __m128i rows[4]) {
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i lo = channel & 1 ? _mm_unpacklo_epi8(zero, values) : _mm_unpacklo_epi8(values, zero);
+    const __m128i hi = channel & 1 ? _mm_unpackhi_epi8(zero, values) : _mm_unpackhi_epi8(values, zero);
+    if (channel & 2) {
+        rows[0] = _mm_unpacklo_epi16(zero, lo);
+        rows[1] = _mm_unpackhi_epi16(zero, lo);
+        rows[2] = _mm_unpacklo_epi16(zero, hi);
+        rows[3] = _mm_unpackhi_epi16(zero, hi);
+    }
+    else {
+        rows[0] = _mm_unpacklo_epi16(lo, zero);
+        rows[1] = _mm_unpackhi_epi16(lo, zero);
+        rows[2] = _mm_unpacklo_epi16(hi, zero);
+        rows[3] = _mm_unpackhi_epi16(hi, zero);
+    }
+}
+
+void DecodeBc1Sse2(const uint8_t* pBlock, uint32_t* pPixels, size_t pitch) {
+    uint32_t palette[4];
+    BuildColorPalette(pBlock, true, palette);
+    __m128i rows[4];
+    DecodeColorSse2(palette, ReadU32(pBlock + 4), rows);
+    StoreRowsSse2(rows, pPixels, pitch);
+}
+
+void DecodeBc2Sse2(const uint8_t* pBlock, uint32_t* pPixels, size_t pitch) {
+    uint32_t palette[4];
+    BuildColorPalette(pBlock + 8, false, palette);
+    for (uint32_t k = 0; k < 4; k++) {
+        palette[k] &= 0x00FFFFFF;
+    }
+    __m128i rows[4];
+    DecodeColorSse2(palette, ReadU32(pBlock + 12), rows);
+
+    // 4-битная альфа: младшие и старшие полубайты чередуются, x * 17 = (x << 4) | x
+    const __m128i packed = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(pBlock));
+    const __m128i nibble = _mm_set1_epi8(0x0F);
+    const __m128i lo = _mm_and_si128(packed, nibble);
+    const __m128i hi = _mm_and_si128(_mm_srli_epi16(packed, 4), nibble);
+    const __m128i alpha = _mm_unpacklo_epi8(lo, hi);
+    __m128i alphaRows[4];
+    ExpandChannelSse2(_mm_or_si128(alpha, _mm_slli_epi16(alpha, 4)), 3, alphaRows);
+    for (uint32_t y = 0; y < 4; y++) {
+        rows[y] = _mm_or_si128(rows[y], alphaRows[y]);
+    }
+    StoreRowsSse2(rows, pPixels, pitch);
+}
+
+void DecodeBc3Sse2(const uint8_t* pBlock, uint32_t* pPixels, size_t pitch) {
+    uint32_t palette[4];
+    uint8_t alphaPalette[8];
+    BuildColorPalette(pBlock + 8, false, palette);
+    BuildAlphaPalette(pBlock, false, alphaPalette);
+    for (uint32_t k = 0; k < 4; k++) {
+        palette[k] &= 0x00FFFFFF;
+    }
+    __m128i rows[4];
+    __m128i alphaRows[4];
+    DecodeColorSse2(palette, ReadU32(pBlock + 12), rows);
+    ExpandChannelSse2(DecodeAlphaSse2(alphaPalette, ReadAlphaIndices(pBlock)), 3, alphaRows);
+    for (uint32_t y = 0; y < 4; y++) {
+        rows[y] = _mm_or_si128(rows[y], alphaRows[y]);
+    }
+    StoreRowsSse2(rows, pPixels, pitch);
+}
+
+template <bool isSigned>
+void DecodeBc4Sse2(const uint8_t* pBlock, uint32_t* pPixels, size_t pitch) {
+    uint8_t palette[8];
+    BuildAlphaPalette(pBlock, isSigned, palette);
+    __m128i rows[4];
+    ExpandChannelSse2(DecodeAlphaSse2(palette, ReadAlphaIndices(pBlock)), 0, rows);
+    const __m128i opaque = _mm_set1_epi32(static_cast<int>(0xFF000000));
+    for (uint32_t y = 0; y < 4; y++) {
+        rows[y] = _mm_or_si128(rows[y], opaque);
+    }
+    StoreRowsSse2(rows, pPixels, pitch);
+}
+
+template <bool isSigned>
+void DecodeBc5Sse2(const uint8_t* pBlock, uint32_t* pPixels, size_t pitch) {
+    uint8_t redPalette[8];
+    uint8_t greenPalette[8];
+    BuildAlphaPalette(pBlock, isSigned, redPalette);
+    BuildAlphaPalette(pBlock + 8, isSigned, greenPalette);
+    // Красный и зеленый перемежаются в 16-битные пары, затем дополняются B = 0, A = 255
+    const __m128i red = DecodeAlphaSse2(redPalette, ReadAlphaIndices(pBlock));
+    const __m128i green = DecodeAlphaSse2(greenPalette, ReadAlphaIndices(pBlock + 8));
+    const __m128i lo = _mm_unpacklo_epi8(red, green);
+    const __m128i hi = _mm_unpackhi_epi8(red, green);
+    const __m128i opaque = _mm_set1_epi16(static_cast<short>(0xFF00));
+    __m128i rows[4];
+    rows[0] = _mm_unpacklo_epi16(lo, opaque);
+    rows[1] = _mm_unpackhi_epi16(lo, opaque);
+    rows[2] = _mm_unpacklo_epi16(hi, opaque);
+    rows[3] = _mm_unpackhi_epi16(hi, opaque);
+    StoreRowsSse2(rows, pPixels, pitch);
+}
+
+void DecodeBc7Sse2(const uint8_t* pBlock, uint32_t* pPixels, size_t pitch) {
+    Bc7Unpacked unpacked;
+    UnpackBc7(pBlock, unpacked);
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i full = _mm_set1_epi16(64);
+    const __m128i round = _mm_set1_epi16(32);
+    for (uint32_t y = 0; y < 4; y++) {
+        // Строка - 4 пикселя = 16 байт, считаем двумя половинами по 8 16-битных значений
+        const __m128i e0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(unpacked.e0 + y * 16));
+        const __m128i e1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(unpacked.e1 + y * 16));
+        const __m128i w = _mm_loadu_si128(reinterpret_cast<const __m128i*>(unpacked.weight + y * 16));
+        __m128i halves[2];
+        for (uint32_t h = 0; h < 2; h++) {
+            const __m128i e0w = h ? _mm_unpackhi_epi8(e0, zero) : _mm_unpacklo_epi8(e0, zero);
+            const __m128i e1w = h ? _mm_unpackhi_epi8(e1, zero) : _mm_unpacklo_epi8(e1, zero);
+            const __m128i ww = h ? _mm_unpackhi_epi8(w, zero) : _mm_unpacklo_epi8(w, zero);
+            __m128i sum = _mm_add_epi16(_mm_mullo_epi16(_mm_sub_epi16(full, ww), e0w), _mm_mullo_epi16(ww, e1w));
+            halves[h] = _mm_srli_epi16(_mm_add_epi16(sum, round), 6);
+        }
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(pPixels + y * pitch), _mm_packus_epi16(halves[0], halves[1]));
+    }
+}
+
+const BlockDecoder kSse2Decoders[static_cast<int>(BlockKind::Count)] = {
+    DecodeBc1Sse2,
+    DecodeBc2Sse2,
+    DecodeBc3Sse2,
+    DecodeBc4Sse2<false>,
+    DecodeBc4Sse2<true>,
+    DecodeBc5Sse2<false>,
+    DecodeBc5Sse2<true>,
+    DecodeBc7Sse2,
+};
+
+// ---------------------------------------------------------------------------------------------
+// AVX2: по 8 пикселей (две строки) за раз, выбор из палитры через vpermd.
+
+BC_TARGET_AVX2 inline void StoreRowsAvx2(__m256i rows01, __m256i rows23, uint32_t* pPixels, size_t pitch) {
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(pPixels), _mm256_castsi256_si128(rows01));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(pPixels + pitch), _mm256_extracti128_si256(rows01, 1));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(pPixels + 2 * pitch), _mm256_castsi256_si128(rows23));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(pPixels + 3 * pitch), _mm256_extracti128_si256(rows23, 1));
+}
+
+// Палитры строятся до векторной части: вызов скалярного кода при занятых YMM-регистрах
+// стоит перехода между SSE- и AVX-состоянием.
+
+// Цвета 16 пикселей по 2-битным индексам
+BC_TARGET_AVX2 inline void SelectColorAvx2(const uint32_t palette[4], uint32_t indices, __m256i& rows01, __m256i& rows23) {
+    const __m256i paletteVector = _mm256_broadcastsi128_si256(_mm_loadu_si128(reinterpret_cast<const __m128i*>(palette)));
+    const __m256i shifts = _mm256_setr_epi32(0, 2, 4, 6, 8, 10, 12, 14);
+    const __m256i mask = _mm256_set1_epi32(3);
+    const __m256i i01 = _mm256_and_si256(_mm256_srlv_epi32(_mm256_set1_epi32(static_cast<int>(indices)), shifts), mask);
+    const __m256i i23 = _mm256_and_si256(_mm256_srlv_epi32(_mm256_set1_epi32(static_cast<int>(indices >> 16)), shifts), mask);
+    rows01 = _mm256_permutevar8x32_epi32(paletteVector, i01);
+    rows23 = _mm256_permutevar8x32_epi32(paletteVector, i23);
+}
+
+// Канал из 8-значной палитры (BC3/BC4/BC5), значения сразу сдвинуты на место канала
+BC_TARGET_AVX2 inline void SelectAlphaAvx2(const uint8_t palette[8], uint64_t indices, int channelShift, __m256i& rows01, __m256i& rows23) {
+    const __m256i paletteVector = _mm256_slli_epi32(_mm256_cvtepu8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(palette))), channelShift);
+    const __m256i shifts = _mm256_setr_epi32(0, 3, 6, 9, 12, 15, 18, 21);
+    const __m256i mask = _mm256_set1_epi32(7);
+    const __m256i i01 = _mm256_and_si256(_mm256_srlv_epi32(_mm256_set1_epi32(static_cast<int>(indices & 0xFFFFFF)), shifts), mask);
+    const __m256i i23 = _mm256_and_si256(_mm256_srlv_epi32(_mm256_set1_epi32(static_cast<int>(indices >> 24)), shifts), mask);
+    rows01 = _mm256_permutevar8x32_epi32(paletteVector, i01);
+    rows23 = _mm256_permutevar8x32_epi32(paletteVector, i23);
+}
+
+BC_TARGET_AVX2 void DecodeBc1Avx2(const uint8_t* pBlock, uint32_t* pPixels, size_t pitch) {
+    uint32_t palette[4];
+    BuildColorPalette(pBlock, true, palette);
+    __m256i rows01, rows23;
+    SelectColorAvx2(palette, ReadU32(pBlock + 4), rows01, rows23);
+    StoreRowsAvx2(rows01, rows23, pPixels, pitch);
+}
+
+BC_TARGET_AVX2 void DecodeBc2Avx2(const uint8_t* pBlock, uint32_t* pPixels, size_t pitch) {
+    uint32_t palette[4];
+    BuildColorPalette(pBlock + 8, false, palette);
+    for (uint32_t k = 0; k < 4; k++) {
+        palette[k] &= 0x00FFFFFF;
+    }
+    __m256i rows01, rows23;
+    SelectColorAvx2(palette, ReadU32(pBlock + 12), rows01, rows23);
+    const __m256i shifts = _mm256_setr_epi32(0, 4, 8, 12, 16, 20, 24, 28);
+    const __m256i mask = _mm256_set1_epi32(15);
+    const __m256i seventeen = _mm256_set1_epi32(17);
+    const __m256i a01 = _mm256_and_si256(_mm256_srlv_epi32(_mm256_set1_epi32(static_cast<int>(ReadU32(pBlock))), shifts), mask);
+    const __m256i a23 = _mm256_and_si256(_mm256_srlv_epi32(_mm256_set1_epi32(static_cast<int>(ReadU32(pBlock + 4))), shifts), mask);
+    rows01 = _mm256_or_si256(rows01, _mm256_slli_epi32(_mm256_mullo_epi32(a01, seventeen), 24));
+    rows23 = _mm256_or_si256(rows23, _mm256_slli_epi32(_mm256_mullo_epi32(a23, seventeen), 24));
+    StoreRowsAvx2(rows01, rows23, pPixels, pitch);
+}
+
+BC_TARGET_AVX2 void DecodeBc3Avx2(const uint8_t* pBlock, uint32_t* pPixels, size_t pitch) {
+    uint32_t palette[4];
+    uint8_t alphaPalette[8];
+    BuildColorPalette(pBlock + 8, false, palette);
+    BuildAlphaPalette(pBlock, false, alphaPalette);
+    for (uint32_t k = 0; k < 4; k++) {
+        palette[k] &= 0x00FFFFFF;
+    }
+    __m256i rows01, rows23, a01, a23;
+    SelectColorAvx2(palette, ReadU32(pBlock + 12), rows01, rows23);
+    SelectAlphaAvx2(alphaPalette, ReadAlphaIndices(pBlock), 24, a01, a23);
+    StoreRowsAvx2(_mm256_or_si256(rows01, a01), _mm256_or_si256(rows23, a23), pPixels, pitch);
+}
+
+template <bool isSigned>
+BC_TARGET_AVX2 void DecodeBc4Avx2(const uint8_t* pBlock, uint32_t* pPixels, size_t pitch) {
+    uint8_t palette[8];
+    BuildAlphaPalette(pBlock, isSigned, palette);
+    __m256i r01, r23;
+    SelectAlphaAvx2(palette, ReadAlphaIndices(pBlock), 0, r01, r23);
+    const __m256i opaque = _mm256_set1_epi32(static_cast<int>(0xFF000000));
+    StoreRowsAvx2(_mm256_or_si256(r01, opaque), _mm256_or_si256(r23, opaque), pPixels, pitch);
+}
+
+template <bool isSigned>
+BC_TARGET_AVX2 void DecodeBc5Avx2(const uint8_t* pBlock, uint32_t* pPixels, size_t pitch) {
+    uint8_t redPalette[8];
+    uint8_t greenPalette[8];
+    BuildAlphaPalette(pBlock, isSigned, redPalette);
+    BuildAlphaPalette(pBlock + 8, isSigned, greenPalette);
+    __m256i r01, r23, g01, g23;
+    SelectAlphaAvx2(redPalette, ReadAlphaIndices(pBlock), 0, r01, r23);
+    SelectAlphaAvx2(greenPalette, ReadAlphaIndices(pBlock + 8), 8, g01, g23);
+    const __m256i opaque = _mm256_set1_epi32(static_cast<int>(0xFF000000));
+    StoreRowsAvx2(_mm256_or_si256(_mm256_or_si256(r01, g01), opaque), _mm256_or_si256(_mm256_or_si256(r23, g23), opaque), pPixels, pitch);
+}
+
+BC_TARGET_AVX2 void DecodeBc7Avx2(const uint8_t* pBlock, uint32_t* pPixels, size_t pitch) {
+    Bc7Unpacked unpacked;
+    UnpackBc7(pBlock, unpacked);
+    const __m256i full = _mm256_set1_epi16(64);
+    const __m256i round = _mm256_set1_epi16(32);
+    for (uint32_t y = 0; y < 4; y++) {
+        // Строка - 16 каналов, все в одном 256-битном регистре по 16 бит
+        const __m256i e0 = _mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(unpacked.e0 + y * 16)));
+        const __m256i e1 = _mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(unpacked.e1 + y * 16)));
+        const __m256i w = _mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(unpacked.weight + y * 16)));
+        const __m256i sum = _mm256_add_epi16(_mm256_mullo_epi16(_mm256_sub_epi16(full, w), e0), _mm256_mullo_epi16(w, e1));
+        const __m256i value = _mm256_srli_epi16(_mm256_add_epi16(sum, round), 6);
+        // packus работает внутри 128-битных половин: нужные байты - в четвертях 0 и 2
+        const __m256i packed = _mm256_permute4x64_epi64(_mm256_packus_epi16(value, value), 0x08);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(pPixels + y * pitch), _mm256_castsi256_si128(packed));
+    }
+}
+
+const BlockDecoder kAvx2Decoders[static_cast<int>(BlockKind::Count)] = {
+    DecodeBc1Avx2,
+    DecodeBc2Avx2,
+    DecodeBc3Avx2,
+    DecodeBc4Avx2<false>,
+    DecodeBc4Avx2<true>,
+    DecodeBc5Avx2<false>,
+    DecodeBc5Avx2<true>,
+    DecodeBc7Avx2,
+};
+
+#endif // BC_HAS_SSE2
+
+BlockDecoder GetBlockDecoder(uint32_t dxgiFormat, BcDecoderPath path) {
+    BlockKind kind;
+    if (!GetBlockKind(dxgiFormat, kind) || !IsBcDecoderPathSupported(path)) {
+        return nullptr;
+    }
+    const int index = static_cast<int>(kind);
+    switch (path) {
+#if BC_HAS_SSE2
+    case BcDecoderPath::Sse2:
+        return kSse2Decoders[index];
+    case BcDecoderPath::Avx2:
+        return kAvx2Decoders[index];
+#endif
+    default:
+        return kScalarDecoders[index];
+    }
+}
+
+} // namespace
+
+bool IsBcDecoderPathSupported(BcDecoderPath path) {
+    switch (path) {
+    case BcDecoderPath::Scalar:
+        return true;
+#if BC_HAS_SSE2
+    case BcDecoderPath::Sse2:
+        return true;
+    case BcDecoderPath::Avx2:
+        return CpuSupportsAvx2();
+#endif
+    default:
+        return false;
+    }
+}
+
+BcDecoderPath GetBestBcDecoderPath() {
+    if (IsBcDecoderPathSupported(BcDecoderPath::Avx2)) {
+        return BcDecoderPath::Avx2;
+    }
+    if (IsBcDecoderPathSupported(BcDecoderPath::Sse2)) {
+        return BcDecoderPath::Sse2;
+    }
+    return BcDecoderPath::Scalar;
+}
+
+const char* GetBcDecoderPathName(BcDecoderPath path) {
+    switch (path) {
+    case BcDecoderPath::Sse2:
+        return "SSE2";
+    case BcDecoderPath::Avx2:
+        return "AVX2";
+    default:
+        return "scalar";
+    }
+}
+
+bool IsBcFormatDecodable(uint32_t dxgiFormat) {
+    BlockKind kind;
+    return GetBlockKind(dxgiFormat, kind);
+}
+
+const char* GetBcFormatName(uint32_t dxgiFormat) {
+    switch (dxgiFormat) {
+    case DdsFormat::BC1_UNORM: return "BC1_UNORM";
+    case DdsFormat::BC1_UNORM_SRGB: return "BC1_UNORM_SRGB";
+    case DdsFormat::BC2_UNORM: return "BC2_UNORM";
+    case DdsFormat::BC2_UNORM_SRGB: return "BC2_UNORM_SRGB";
+    case DdsFormat::BC3_UNORM: return "BC3_UNORM";
+    case DdsFormat::BC3_UNORM_SRGB: return "BC3_UNORM_SRGB";
+    case DdsFormat::BC4_UNORM: return "BC4_UNORM";
+    case DdsFormat::BC4_SNORM: return "BC4_SNORM";
+    case DdsFormat::BC5_UNORM: return "BC5_UNORM";
+    case DdsFormat::BC5_SNORM: return "BC5_SNORM";
+    case DdsFormat::BC6H_UF16: return "BC6H_UF16";
+    case DdsFormat::BC6H_SF16: return "BC6H_SF16";
+    case DdsFormat::BC7_UNORM: return "BC7_UNORM";
+    case DdsFormat::BC7_UNORM_SRGB: return "BC7_UNORM_SRGB";
+    default: return "unknown";
+    }
+}
+
+bool DecodeBcBlock(uint32_t dxgiFormat, const uint8_t* pBlock, uint32_t* pPixels, size_t pixelPitch) {
+    return DecodeBcBlock(dxgiFormat, pBlock, pPixels, pixelPitch, GetBestBcDecoderPath());
+}
+
+bool DecodeBcBlock(uint32_t dxgiFormat, const uint8_t* pBlock, uint32_t* pPixels, size_t pixelPitch, BcDecoderPath path) {
+    BlockDecoder decode = GetBlockDecoder(dxgiFormat, path);
+    if (!decode) {
+        return false;
+    }
+    decode(pBlock, pPixels, pixelPitch);
+    return true;
+}
+
+bool DecodeBcImage(uint32_t dxgiFormat, const uint8_t* pSrc, size_t srcRowPitch, uint32_t width, uint32_t height,
+    uint32_t* pDst, size_t dstPixelPitch) {
+    return DecodeBcImage(dxgiFormat, pSrc, srcRowPitch, width, height, pDst, dstPixelPitch, GetBestBcDecoderPath());
+}
+
+bool DecodeBcImage(uint32_t dxgiFormat, const uint8_t* pSrc, size_t srcRowPitch, uint32_t width, uint32_t height,
+    uint32_t* pDst, size_t dstPixelPitch, BcDecoderPath path) {
+    BlockDecoder decode = GetBlockDecoder(dxgiFormat, path);
+    if (!decode) {
+        return false;
+    }
+
+    const uint32_t bytesPerBlock = DdsFile::GetBytesPerBlock(dxgiFormat);
+    const uint32_t blocksX = (width + 3) / 4;
+    const uint32_t blocksY = (height + 3) / 4;
+    for (uint32_t by = 0; by < blocksY; by++) {
+        const uint8_t* pRow = pSrc + by * srcRowPitch;
+        const uint32_t y = by * 4;
+        for (uint32_t bx = 0; bx < blocksX; bx++) {
+            const uint32_t x = bx * 4;
+            if (x + 4 <= width && y + 4 <= height) {
+                decode(pRow + bx * bytesPerBlock, pDst + y * dstPixelPitch + x, dstPixelPitch);
+                continue;
+            }
+            // Неполный блок на краю (mip-уровни меньше 4x4)
+            uint32_t block[16];
+            decode(pRow + bx * bytesPerBlock, block, 4);
+            const uint32_t copyWidth = width - x < 4 ? width - x : 4;
+            const uint32_t copyHeight = height - y < 4 ? height - y : 4;
+            for (uint32_t row = 0; row < copyHeight; row++) {
+                memcpy(pDst + (y + row) * dstPixelPitch + x, block + row * 4, copyWidth * sizeof(uint32_t));
+            }
+        }
+    }
+    return true;
+}
+
+namespace {
+
+// ---------------------------------------------------------------------------------------------
+// Кодер
+
+inline uint32_t QuantizeChannel(uint32_t value, uint32_t maxValue) {
+    return (value * maxValue + 127) / 255;
+}
+
+inline uint32_t QuantizeColor565(uint32_t pixel) {
+    return (QuantizeChannel(pixel & 255, 31) << 11) | (QuantizeChannel((pixel >> 8) & 255, 63) << 5) | QuantizeChannel((pixel >> 16) & 255, 31);
+}
+
+inline int ColorDistance(uint32_t a, uint32_t b) {
+    const int dr = static_cast<int>(a & 255) - static_cast<int>(b & 255);
+    const int dg = static_cast<int>((a >> 8) & 255) - static_cast<int>((b >> 8) & 255);
+    const int db = static_cast<int>((a >> 16) & 255) - static_cast<int>((b >> 16) & 255);
+    return dr * dr + dg * dg + db * db;
+}
+
+// Цветовой блок BC1-BC3. Концы отрезка - крайние по главной оси пиксели; ось ищется
+// степенным методом по ковариационной матрице цветов блока.
+void EncodeColorBlock(const uint32_t pixels[16], bool bc1, uint8_t* pBlock) {
+    bool transparent[16];
+    bool hasTransparent = false;
+    float mean[3] = { 0.0f, 0.0f, 0.0f };
+    uint32_t count = 0;
+    for (uint32_t i = 0; i < 16; i++) {
+        transparent[i] = bc1 && (pixels[i] >> 24) < 128;
+        hasTransparent = hasTransparent || transparent[i];
+        if (!transparent[i]) {
+            for (uint32_t c = 0; c < 3; c++) {
+                mean[c] += static_cast<float>((pixels[i] >> (8 * c)) & 255);
+            }
+            count++;
+        }
+    }
+
+    uint32_t c0 = 0;
+    uint32_t c1 = 0;
+    if (count > 0) {
+        float cov[6] = {}; // rr, rg, rb, gg, gb, bb
+        float minColor[3] = { 255.0f, 255.0f, 255.0f };
+        float maxColor[3] = { 0.0f, 0.0f, 0.0f };
+        for (uint32_t c = 0; c < 3; c++) {
+            mean[c] /= static_cast<float>(count);
+        }
+        for (uint32_t i = 0; i < 16; i++) {
+            if (transparent[i]) {
+                continue;
+            }
+            float d[3];
+            for (uint32_t c = 0; c < 3; c++) {
+                const float value = static_cast<float>((pixels[i] >> (8 * c)) & 255);
+                d[c] = value - mean[c];
+                minColor[c] = value < minColor[c] ? value : minColor[c];
+                maxColor[c] = value > maxColor[c] ? value : maxColor[c];
+            }
+            cov[0] += d[0] * d[0];
+            cov[1] += d[0] * d[1];
+            cov[2] += d[0] * d[2];
+            cov[3] += d[1] * d[1];
+            cov[4] += d[1] * d[2];
+            cov[5] += d[2] * d[2];
+        }
+
+        // Начальное приближение - диагональ ограничивающего параллелепипеда
+        float axis[3] = { maxColor[0] - minColor[0], maxColor[1] - minColor[1], maxColor[2] - minColor[2] };
+        for (int iteration = 0; iteration < 4; iteration++) {
+            const float next[3] = {
+                cov[0] * axis[0] + cov[1] * axis[1] + cov[2] * axis[2],
+                cov[1] * axis[0] + cov[3] * axis[1] + cov[4] * axis[2],
+                cov[2] * axis[0] + cov[4] * axis[1] + cov[5] * axis[2],
+            };
+            float scale = next[0] * next[0] + next[1] * next[1] + next[2] * next[2];
+            if (scale < 1e-6f) {
+                break;
+            }
+            scale = 1.0f / std::sqrt(scale);
+            for (uint32_t c = 0; c < 3; c++) {
+                axis[c] = next[c] * scale;
+            }
+        }
+
+        uint32_t minPixel = 0;
+        uint32_t maxPixel = 0;
+        float minProjection = 0.0f;
+        float maxProjection = 0.0f;
+        bool first = true;
+        for (uint32_t i = 0; i < 16; i++) {
+            if (transparent[i]) {
+                continue;
+            }
+            float projection = 0.0f;
+            for (uint32_t c = 0; c < 3; c++) {
+                projection += static_cast<float>((pixels[i] >> (8 * c)) & 255) * axis[c];
+            }
+            if (first || projection < minProjection) {
+                minProjection = projection;
+                minPixel = pixels[i];
+            }
+            if (first || projection > maxProjection) {
+                maxProjection = projection;
+                maxPixel = pixels[i];
+            }
+            first = false;
+        }
+        c0 = QuantizeColor565(maxPixel);
+        c1 = QuantizeColor565(minPixel);
+    }
+
+    // Порядок концов задает режим BC1: c0 > c1 - четыре цвета, иначе три цвета и прозрачный
+    if (hasTransparent ? c0 > c1 : c0 < c1) {
+        std::swap(c0, c1);
+    }
+    pBlock[0] = static_cast<uint8_t>(c0);
+    pBlock[1] = static_cast<uint8_t>(c0 >> 8);
+    pBlock[2] = static_cast<uint8_t>(c1);
+    pBlock[3] = static_cast<uint8_t>(c1 >> 8);
+
+    uint32_t palette[4];
+    BuildColorPalette(pBlock, bc1, palette);
+    const uint32_t candidateCount = bc1 && c0 <= c1 ? 3 : 4;
+    uint32_t indices = 0;
+    for (uint32_t i = 0; i < 16; i++) {
+        uint32_t best = 3;
+        if (!transparent[i]) {
+            int bestDistance = ColorDistance(pixels[i], palette[0]);
+            best = 0;
+            for (uint32_t k = 1; k < candidateCount; k++) {
+                const int distance = ColorDistance(pixels[i], palette[k]);
+                if (distance < bestDistance) {
+                    bestDistance = distance;
+                    best = k;
+                }
+            }
+        }
+        indices |= best << (2 * i);
+    }
+    memcpy(pBlock + 4, &indices, sizeof(indices));
+}
+
+// Альфа-блок BC3 / канал BC4/BC5 (значения SNORM - со смещением +128, как на выходе декодера)
+void EncodeAlphaBlock(const uint8_t values[16], bool isSigned, uint8_t* pBlock) {
+    uint8_t minValue = values[0];
+    uint8_t maxValue = values[0];
+    for (uint32_t i = 1; i < 16; i++) {
+        minValue = values[i] < minValue ? values[i] : minValue;
+        maxValue = values[i] > maxValue ? values[i] : maxValue;
+    }
+    // a0 > a1 - восьмизначный режим; при равенстве все пиксели берут a0
+    pBlock[0] = static_cast<uint8_t>(isSigned ? maxValue - 128 : maxValue);
+    pBlock[1] = static_cast<uint8_t>(isSigned ? minValue - 128 : minValue);
+
+    uint8_t palette[8];
+    BuildAlphaPalette(pBlock, isSigned, palette);
+    uint64_t indices = 0;
+    for (uint32_t i = 0; i < 16; i++) {
+        uint32_t best = 0;
+        int bestDistance = 256;
+        for (uint32_t k = 0; k < 8; k++) {
+            const int distance = std::abs(static_cast<int>(values[i]) - static_cast<int>(palette[k]));
+            if (distance < bestDistance) {
+                bestDistance = distance;
+                best = k;
+            }
+        }
+        indices |= static_cast<uint64_t>(best) << (3 * i);
+    }
+    for (uint32_t i = 0; i < 6; i++) {
+        pBlock[2 + i] = static_cast<uint8_t>(indices >> (8 * i));
+    }
+}
+
+void ExtractChannel(const uint32_t pixels[16], uint32_t channel, uint8_t values[16]) {
+    for (uint32_t i = 0; i < 16; i++) {
+        values[i] = static_cast<uint8_t>(pixels[i] >> (8 * channel));
+    }
+}
+
+} // namespace
+
+bool IsBcFormatEncodable(uint32_t dxgiFormat) {
+    BlockKind kind;
+    return GetBlockKind(dxgiFormat, kind) && kind != BlockKind::BC7;
+}
+
+bool EncodeBcBlock(uint32_t dxgiFormat, const uint32_t* pPixels, size_t pixelPitch, uint8_t* pBlock) {
+    BlockKind kind;
+    if (!GetBlockKind(dxgiFormat, kind)) {
+        return false;
+    }
+
+    uint32_t pixels[16];
+    for (uint32_t y = 0; y < 4; y++) {
+        memcpy(pixels + y * 4, pPixels + y * pixelPitch, 4 * sizeof(uint32_t));
+    }
+
+    uint8_t values[16];
+    switch (kind) {
+    case BlockKind::BC1:
+        EncodeColorBlock(pixels, true, pBlock);
+        return true;
+    case BlockKind::BC2: {
+        uint64_t alpha = 0;
+        for (uint32_t i = 0; i < 16; i++) {
+            alpha |= static_cast<uint64_t>(((pixels[i] >> 24) + 8) / 17) << (4 * i);
+        }
+        memcpy(pBlock, &alpha, sizeof(alpha));
+        EncodeColorBlock(pixels, false, pBlock + 8);
+        return true;
+    }
+    case BlockKind::BC3:
+        ExtractChannel(pixels, 3, values);
+        EncodeAlphaBlock(values, false, pBlock);
+        EncodeColorBlock(pixels, false, pBlock + 8);
+        return true;
+    case BlockKind::BC4U:
+    case BlockKind::BC4S:
+        ExtractChannel(pixels, 0, values);
+        EncodeAlphaBlock(values, kind == BlockKind::BC4S, pBlock);
+        return true;
+    case BlockKind::BC5U:
+    case BlockKind::BC5S:
+        ExtractChannel(pixels, 0, values);
+        EncodeAlphaBlock(values, kind == BlockKind::BC5S, pBlock);
+        ExtractChannel(pixels, 1, values);
+        EncodeAlphaBlock(values, kind == BlockKind::BC5S, pBlock + 8);
+        return true;
+    default:
+        return false;
+    }
+}
+
+bool EncodeBcImage(uint32_t dxgiFormat, const uint32_t* pSrc, size_t srcPixelPitch, uint32_t width, uint32_t height,
+    uint8_t* pDst, size_t dstRowPitch) {
+    if (!IsBcFormatEncodable(dxgiFormat) || width == 0 || height == 0) {
+        return false;
+    }
+
+    const uint32_t bytesPerBlock = DdsFile::GetBytesPerBlock(dxgiFormat);
+    const uint32_t blocksX = (width + 3) / 4;
+    const uint32_t blocksY = (height + 3) / 4;
+    for (uint32_t by = 0; by < blocksY; by++) {
+        for (uint32_t bx = 0; bx < blocksX; bx++) {
+            uint32_t block[16];
+            for (uint32_t y = 0; y < 4; y++) {
+                const uint32_t sy = by * 4 + y < height ? by * 4 + y : height - 1;
+                for (uint32_t x = 0; x < 4; x++) {
+                    const uint32_t sx = bx * 4 + x < width ? bx * 4 + x : width - 1;
+                    block[y * 4 + x] = pSrc[sy * srcPixelPitch + sx];
+                }
+            }
+            EncodeBcBlock(dxgiFormat, block, 4, pDst + by * dstRowPitch + bx * bytesPerBlock);
+        }
+    }
+    return true;
+}
+
+size_t ValidateBcDecoder(uint32_t dxgiFormat, const uint8_t* pBlocks, size_t blockCount, BcDecoderPath path) {
+    BlockDecoder decode = GetBlockDecoder(dxgiFormat, path);
+    BlockDecoder reference = GetBlockDecoder(dxgiFormat, BcDecoderPath::Scalar);
+    if (!decode || !reference) {
+        return blockCount * 16;
+    }
+
+    const uint32_t bytesPerBlock = DdsFile::GetBytesPerBlock(dxgiFormat);
+    size_t mismatchCount = 0;
+    for (size_t i = 0; i < blockCount; i++) {
+        uint32_t expected[16];
+        uint32_t actual[16];
+        reference(pBlocks + i * bytesPerBlock, expected, 4);
+        decode(pBlocks + i * bytesPerBlock, actual, 4);
+        for (uint32_t p = 0; p < 16; p++) {
+            mismatchCount += expected[p] != actual[p] ? 1 : 0;
+        }
+    }
+    return mismatchCount;
+}
+
+double BenchmarkBcDecoder(uint32_t dxgiFormat, const uint8_t* pBlocks, size_t blockCount, BcDecoderPath path, uint32_t repeatCount) {
+    if (!GetBlockDecoder(dxgiFormat, path) || blockCount == 0) {
+        return 0.0;
+    }
+
+    // Блоки раскладываются в одну полосу высотой 4 пикселя
+    const uint32_t bytesPerBlock = DdsFile::GetBytesPerBlock(dxgiFormat);
+    const uint32_t width = static_cast<uint32_t>(blockCount * 4);
+    std::vector<uint32_t> pixels(static_cast<size_t>(width) * 4);
+
+    double bestSeconds = 0.0;
+    for (uint32_t repeat = 0; repeat < (repeatCount ? repeatCount : 1); repeat++) {
+        auto start = std::chrono::high_resolution_clock::now();
+        DecodeBcImage(dxgiFormat, pBlocks, blockCount * bytesPerBlock, width, 4, pixels.data(), width, path);
+        double seconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+        if (repeat == 0 || seconds < bestSeconds) {
+            bestSeconds = seconds;
+        }
+    }
+    return bestSeconds > 0.0 ? blockCount * 64.0 / bestSeconds / (1024.0 * 1024.0) : 0.0;
+}
+
+std::vector<BcBenchmarkResult> RunBcDecoderBenchmark(size_t blockCount, uint32_t repeatCount, uint32_t seed) {
+    const uint32_t formats[] = {
+        DdsFormat::BC1_UNORM, DdsFormat::BC2_UNORM, DdsFormat::BC3_UNORM, DdsFormat::BC4_UNORM,
+        DdsFormat::BC4_SNORM, DdsFormat::BC5_UNORM, DdsFormat::BC5_SNORM, DdsFormat::BC7_UNORM,
+    };
+    const BcDecoderPath paths[] = { BcDecoderPath::Scalar, BcDecoderPath::Sse2, BcDecoderPath::Avx2 };
+
+    // Случайные блоки покрывают все ветви: оба режима BC1, оба режима альфы, все режимы BC7
+    std::mt19937 random(seed);
+    std::vector<uint8_t> blocks(blockCount * 16);
+    for (uint8_t& value : blocks) {
+        value = static_cast<uint8_t>(random());
+    }
+
+    std::vector<BcBenchmarkResult> results;
+    for (uint32_t format : formats) {
+        for (BcDecoderPath path : paths) {
+            if (!IsBcDecoderPathSupported(path)) {
+                continue;
+            }
+            BcBenchmarkResult result;
+            result.format = format;
+            result.path = path;
+            result.mismatchCount = ValidateBcDecoder(format, blocks.data(), blockCount, path);
+            result.megabytesPerSecond = BenchmarkBcDecoder(format, blocks.data(), blockCount, path, repeatCount);
+            results.push_back(result);
+        }
+    }
+    return results;
+}
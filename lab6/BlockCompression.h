@@ -0,0 +1,64 @@
+﻿#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Распаковка BC-текстур (BC1-BC5, BC7) на CPU в RGBA8 (R в младшем байте, как SoftwareTexture).
+// Скалярная реализация - эталонная; векторные SSE2 и AVX2 дают побитово тот же результат.
+// AVX2 выбирается во время работы, если процессор и ОС его поддерживают, поэтому сборка
+// не требует /arch:AVX2.
+//
+// BC4 раскладывается в R, BC5 - в RG; отсутствующие каналы B (и G для BC4) равны 0, A = 255.
+// SNORM-варианты выдаются со смещением +128 (значение -1 -> 1, 0 -> 128, 1 -> 255).
+// BC6H (HDR, half float) не поддерживается.
+
+enum class BcDecoderPath {
+    Scalar,
+    Sse2,
+    Avx2,
+};
+
+bool IsBcDecoderPathSupported(BcDecoderPath path);
+BcDecoderPath GetBestBcDecoderPath();
+const char* GetBcDecoderPathName(BcDecoderPath path);
+
+// Формат задается значением DXGI_FORMAT (DdsFormat::*)
+bool IsBcFormatDecodable(uint32_t dxgiFormat);
+const char* GetBcFormatName(uint32_t dxgiFormat);
+
+// Один блок 4x4. pPixels - левый верхний пиксель, pixelPitch - шаг строки в пикселях.
+bool DecodeBcBlock(uint32_t dxgiFormat, const uint8_t* pBlock, uint32_t* pPixels, size_t pixelPitch);
+bool DecodeBcBlock(uint32_t dxgiFormat, const uint8_t* pBlock, uint32_t* pPixels, size_t pixelPitch, BcDecoderPath path);
+
+// Целый mip-уровень (srcRowPitch - байт в строке блоков). Блоки на краях обрезаются до width x height.
+bool DecodeBcImage(uint32_t dxgiFormat, const uint8_t* pSrc, size_t srcRowPitch, uint32_t width, uint32_t height,
+    uint32_t* pDst, size_t dstPixelPitch);
+bool DecodeBcImage(uint32_t dxgiFormat, const uint8_t* pSrc, size_t srcRowPitch, uint32_t width, uint32_t height,
+    uint32_t* pDst, size_t dstPixelPitch, BcDecoderPath path);
+
+// Сжатие RGBA8 в BC1-BC5 (быстрый кодер для сгенерированных mip-уровней, не для подготовки ассетов):
+// цвет - концы по главной оси облака точек, альфа и BC4/BC5 - по минимуму и максимуму.
+// BC1 переходит в трехцветный режим, если в блоке есть пиксели с альфой < 128.
+bool IsBcFormatEncodable(uint32_t dxgiFormat);
+bool EncodeBcBlock(uint32_t dxgiFormat, const uint32_t* pPixels, size_t pixelPitch, uint8_t* pBlock);
+// Блоки на краях дополняются повторением последней строки / столбца
+bool EncodeBcImage(uint32_t dxgiFormat, const uint32_t* pSrc, size_t srcPixelPitch, uint32_t width, uint32_t height,
+    uint8_t* pDst, size_t dstRowPitch);
+
+// Проверка: распаковывает blockCount подряд идущих блоков путем path и скалярно,
+// возвращает число отличающихся пикселей
+size_t ValidateBcDecoder(uint32_t dxgiFormat, const uint8_t* pBlocks, size_t blockCount, BcDecoderPath path);
+
+// Скорость распаковки в МБ/с распакованных данных (64 байта на блок), лучшая из repeatCount попыток
+double BenchmarkBcDecoder(uint32_t dxgiFormat, const uint8_t* pBlocks, size_t blockCount, BcDecoderPath path, uint32_t repeatCount);
+
+struct BcBenchmarkResult {
+    uint32_t format = 0;
+    BcDecoderPath path = BcDecoderPath::Scalar;
+    double megabytesPerSecond = 0.0;
+    size_t mismatchCount = 0; // отличия от скалярной реализации на тех же блоках
+};
+
+// Прогон всех форматов и всех доступных путей на blockCount псевдослучайных блоках
+std::vector<BcBenchmarkResult> RunBcDecoderBenchmark(size_t blockCount, uint32_t repeatCount, uint32_t seed = 1);
@@ -0,0 +1,411 @@
+﻿#include "CameraDriver.h"
+
+#include <cfloat>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <cwchar>
+
+#include <DirectXMath.h>
+
+#include "FileIO.h"
+
+namespace {
+
+const uint8_t kLogMagic[4] = { 'L', '6', 'C', 'R' };
+const uint32_t kLogVersion = 1;
+// Магия, версия, число кадров, начальное положение камеры
+const size_t kLogHeaderSize = 4 + 4 + 4 + 3 * 8;
+const size_t kLogFrameCountOffset = 8;
+// Бит байта кадра: за ним следует новое время кадра
+const uint8_t kNewTimeFlag = 0x80;
+
+void StoreLE32(uint8_t* pDst, uint32_t value) {
+    for (int i = 0; i < 4; i++) {
+        pDst[i] = uint8_t(value >> (8 * i));
+    }
+}
+
+uint32_t LoadLE32(const uint8_t* pSrc) {
+    return uint32_t(pSrc[0]) | uint32_t(pSrc[1]) << 8 | uint32_t(pSrc[2]) << 16 | uint32_t(pSrc[3]) << 24;
+}
+
+void StoreDouble(uint8_t* pDst, double value) {
+    uint64_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    StoreLE32(pDst, static_cast<uint32_t>(bits));
+    StoreLE32(pDst + 4, static_cast<uint32_t>(bits >> 32));
+}
+
+double LoadDouble(const uint8_t* pSrc) {
+    const uint64_t bits = uint64_t(LoadLE32(pSrc)) | uint64_t(LoadLE32(pSrc + 4)) << 32;
+    double value;
+    memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+// Беззнаковое LEB128: по 7 бит, старший бит байта - продолжение
+void AppendVarint(std::vector<uint8_t>& log, uint32_t value) {
+    while (value >= 0x80) {
+        log.push_back(uint8_t(value | 0x80));
+        value >>= 7;
+    }
+    log.push_back(uint8_t(value));
+}
+
+bool ReadVarint(const std::vector<uint8_t>& log, size_t& position, uint32_t& value) {
+    value = 0;
+    for (int shift = 0; shift < 35; shift += 7) {
+        if (position >= log.size()) {
+            return false;
+        }
+        const uint8_t byte = log[position++];
+        value |= uint32_t(byte & 0x7F) << shift;
+        if (!(byte & 0x80)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Предел наклона камеры: она не переходит через полюс
+const double kMaxAngleXZ = DirectX::XM_PI / 2 - FLT_EPSILON;
+
+} // namespace
+
+std::wstring GetCommandLineValue(const wchar_t* pCommandLine, const wchar_t* pKey) {
+    const wchar_t* pValue = wcsstr(pCommandLine, pKey);
+    if (!pValue) {
+        return std::wstring();
+    }
+    pValue += wcslen(pKey);
+    while (*pValue == L' ') {
+        pValue++;
+    }
+    const wchar_t* pEnd = pValue;
+    while (*pEnd && *pEnd != L' ') {
+        pEnd++;
+    }
+    return std::wstring(pValue, pEnd);
+}
+
+void ApplyCameraKeys(uint8_t keys, double deltaTime, double rotationSpeed, CameraState& camera) {
+    if (keys & CameraKey::Right) {
+        camera.angle_y -= rotationSpeed * deltaTime;
+    }
+    if (keys & CameraKey::Left) {
+        camera.angle_y += rotationSpeed * deltaTime;
+    }
+    if (keys & CameraKey::Up) {
+        camera.angle_xz += rotationSpeed * deltaTime;
+    }
+    if (keys & CameraKey::Down) {
+        camera.angle_xz -= rotationSpeed * deltaTime;
+    }
+    // проверка на выход из диапазона
+    if (camera.angle_y > 2 * DirectX::XM_PI) {
+        camera.angle_y -= 2 * DirectX::XM_PI;
+    }
+    if (camera.angle_y < 0) {
+        camera.angle_y += 2 * DirectX::XM_PI;
+    }
+    if (camera.angle_xz > kMaxAngleXZ) {
+        camera.angle_xz = kMaxAngleXZ;
+    }
+    if (camera.angle_xz < -kMaxAngleXZ) {
+        camera.angle_xz = -kMaxAngleXZ;
+    }
+
+    // изменение расстояния от камеры
+    if ((keys & CameraKey::Closer) && camera.cameraRadius > 1.0) {
+        camera.cameraRadius -= rotationSpeed * 2.0 * deltaTime;
+    }
+    if ((keys & CameraKey::Farther) && camera.cameraRadius < 100.0) {
+        camera.cameraRadius += rotationSpeed * 2.0 * deltaTime;
+    }
+}
+
+bool CameraPath::Load(const std::wstring& filePath) {
+    MappedFile file;
+    if (!file.Open(filePath)) {
+        m_keys.clear();
+        m_error = std::string("cannot open camera path: ") + file.GetErrorMessage();
+        return false;
+    }
+    return Parse(reinterpret_cast<const char*>(file.GetData()), file.GetSize());
+}
+
+bool CameraPath::Parse(const char* pText, size_t size) {
+    m_keys.clear();
+    m_error.clear();
+    // Метка UTF-8 в начале (так сохраняют блокнот и Visual Studio)
+    if (size >= 3 && memcmp(pText, "\xEF\xBB\xBF", 3) == 0) {
+        pText += 3;
+        size -= 3;
+    }
+    std::string line;
+    uint32_t lineNumber = 0;
+    size_t position = 0;
+    while (position < size) {
+        size_t end = position;
+        while (end < size && pText[end] != '\n') {
+            end++;
+        }
+        line.assign(pText + position, end - position);
+        position = end + 1;
+        lineNumber++;
+
+        const size_t comment = line.find('#');
+        if (comment != std::string::npos) {
+            line.resize(comment);
+        }
+        const char* pCursor = line.c_str();
+        double values[4];
+        int count = 0;
+        for (; count < 4; count++) {
+            char* pEnd = nullptr;
+            values[count] = strtod(pCursor, &pEnd);
+            if (pEnd == pCursor) {
+                break;
+            }
+            pCursor = pEnd;
+        }
+        while (*pCursor == ' ' || *pCursor == '\t' || *pCursor == '\r') {
+            pCursor++;
+        }
+        if (count == 0 && *pCursor == '\0') {
+            continue;  // пустая строка или комментарий
+        }
+
+        const char* pError = nullptr;
+        if (count != 4 || *pCursor != '\0') {
+            pError = "expected \"time angle_y angle_xz cameraRadius\"";
+        }
+        else if (!m_keys.empty() && !(values[0] > m_keys.back().time)) {
+            pError = "key times must increase";
+        }
+        else if (!(fabs(values[2]) <= kMaxAngleXZ)) {
+            pError = "angle_xz must be within (-pi/2, pi/2)";
+        }
+        else if (!(values[3] > 0.0)) {
+            pError = "cameraRadius must be positive";
+        }
+        if (pError) {
+            m_keys.clear();
+            m_error = std::string(pError) + " at line " + std::to_string(lineNumber);
+            return false;
+        }
+
+        Key key;
+        key.time = values[0];
+        key.camera.angle_y = values[1];
+        key.camera.angle_xz = values[2];
+        key.camera.cameraRadius = values[3];
+        m_keys.push_back(key);
+    }
+    if (m_keys.empty()) {
+        m_error = "camera path has no keys";
+        return false;
+    }
+    return true;
+}
+
+CameraState CameraPath::Evaluate(double time) const {
+    if (m_keys.empty()) {
+        return CameraState();
+    }
+    if (time <= m_keys.front().time) {
+        return m_keys.front().camera;
+    }
+    if (time >= m_keys.back().time) {
+        return m_keys.back().camera;
+    }
+    // Первый ключ позже time; ключей обычно десятки - хватает линейного поиска
+    size_t next = 1;
+    while (m_keys[next].time <= time) {
+        next++;
+    }
+    const Key& a = m_keys[next - 1];
+    const Key& b = m_keys[next];
+    const double t = (time - a.time) / (b.time - a.time);
+    CameraState camera;
+    camera.angle_y = a.camera.angle_y + (b.camera.angle_y - a.camera.angle_y) * t;
+    camera.angle_xz = a.camera.angle_xz + (b.camera.angle_xz - a.camera.angle_xz) * t;
+    camera.cameraRadius = a.camera.cameraRadius + (b.camera.cameraRadius - a.camera.cameraRadius) * t;
+    return camera;
+}
+
+bool CameraDriver::Fail(const char* message) {
+    m_error = message;
+    m_mode = Mode::Keyboard;
+    m_log.clear();
+    return false;
+}
+
+bool CameraDriver::Start(const wchar_t* pCommandLine, const CameraState& camera, double pathTimeStep) {
+    const std::wstring replayPath = GetCommandLineValue(pCommandLine, L"-replay");
+    if (!replayPath.empty()) {
+        return StartReplay(replayPath);
+    }
+    const std::wstring pathPath = GetCommandLineValue(pCommandLine, L"-camerapath");
+    if (!pathPath.empty()) {
+        return StartPath(pathPath, pathTimeStep);
+    }
+    const std::wstring recordPath = GetCommandLineValue(pCommandLine, L"-record");
+    if (!recordPath.empty()) {
+        StartRecording(recordPath, camera);
+    }
+    return true;
+}
+
+void CameraDriver::StartRecording(const std::wstring& filePath, const CameraState& camera) {
+    m_mode = Mode::Record;
+    m_recordPath = filePath;
+    m_frameIndex = 0;
+    m_start = camera;
+    m_log.assign(kLogHeaderSize, 0);
+    memcpy(m_log.data(), kLogMagic, sizeof(kLogMagic));
+    StoreLE32(m_log.data() + 4, kLogVersion);
+    StoreDouble(m_log.data() + 12, camera.angle_y);
+    StoreDouble(m_log.data() + 20, camera.angle_xz);
+    StoreDouble(m_log.data() + 28, camera.cameraRadius);
+}
+
+bool CameraDriver::StartReplay(const std::wstring& filePath) {
+    MappedFile file;
+    if (!file.Open(filePath)) {
+        return Fail(file.GetErrorMessage());
+    }
+    m_log.assign(file.GetData(), file.GetData() + file.GetSize());
+    if (m_log.size() < kLogHeaderSize || memcmp(m_log.data(), kLogMagic, sizeof(kLogMagic)) != 0) {
+        return Fail("not an input recording");
+    }
+    if (LoadLE32(m_log.data() + 4) != kLogVersion) {
+        return Fail("unsupported input recording version");
+    }
+    m_logFrameCount = LoadLE32(m_log.data() + kLogFrameCountOffset);
+    m_start.angle_y = LoadDouble(m_log.data() + 12);
+    m_start.angle_xz = LoadDouble(m_log.data() + 20);
+    m_start.cameraRadius = LoadDouble(m_log.data() + 28);
+
+    // Журнал проверяется целиком заранее, чтобы воспроизведение не оборвалось посередине
+    size_t position = kLogHeaderSize;
+    for (uint32_t frame = 0; frame < m_logFrameCount; frame++) {
+        if (position >= m_log.size()) {
+            return Fail("input recording is truncated");
+        }
+        const uint8_t byte = m_log[position++];
+        uint32_t microseconds = 0;
+        if ((byte & ~(CameraKey::All | kNewTimeFlag)) != 0 || (frame == 0 && !(byte & kNewTimeFlag)) ||
+            ((byte & kNewTimeFlag) && !ReadVarint(m_log, position, microseconds))) {
+            return Fail("input recording is corrupted");
+        }
+    }
+    if (position != m_log.size()) {
+        return Fail("input recording has trailing data");
+    }
+
+    m_mode = Mode::Replay;
+    m_logPosition = kLogHeaderSize;
+    m_frameIndex = 0;
+    return true;
+}
+
+bool CameraDriver::StartPath(const std::wstring& filePath, double timeStep) {
+    if (!m_path.Load(filePath)) {
+        return Fail(m_path.GetErrorMessage());
+    }
+    m_mode = Mode::Path;
+    m_timeStep = timeStep;
+    m_frameIndex = 0;
+    return true;
+}
+
+double CameraDriver::BeginFrame(double deltaTime) {
+    switch (m_mode) {
+    case Mode::Keyboard:
+        m_frameTime = deltaTime;
+        break;
+    case Mode::Record: {
+        const double microseconds = floor(deltaTime * 1e6 + 0.5);
+        m_frameMicroseconds = microseconds <= 0.0 ? 0 : microseconds >= 4294967295.0 ? 0xFFFFFFFFu : static_cast<uint32_t>(microseconds);
+        m_frameTime = m_frameMicroseconds * 1e-6;
+        break;
+    }
+    case Mode::Replay:
+        m_frameKeys = 0;
+        if (IsFinished()) {
+            m_frameTime = 0.0;
+            break;
+        }
+        {
+            const uint8_t byte = m_log[m_logPosition++];
+            m_frameKeys = byte & CameraKey::All;
+            if (byte & kNewTimeFlag) {
+                ReadVarint(m_log, m_logPosition, m_frameMicroseconds);
+            }
+        }
+        m_frameTime = m_frameMicroseconds * 1e-6;
+        break;
+    case Mode::Path:
+        m_frameTime = m_timeStep;
+        break;
+    }
+    return m_frameTime;
+}
+
+void CameraDriver::Update(uint8_t keys, CameraState& camera) {
+    switch (m_mode) {
+    case Mode::Keyboard:
+        ApplyCameraKeys(keys, m_frameTime, kCameraRotationSpeed, camera);
+        break;
+    case Mode::Record:
+        keys &= CameraKey::All;
+        if (m_frameIndex == 0 || m_frameMicroseconds != m_lastMicroseconds) {
+            m_log.push_back(keys | kNewTimeFlag);
+            AppendVarint(m_log, m_frameMicroseconds);
+            m_lastMicroseconds = m_frameMicroseconds;
+        }
+        else {
+            m_log.push_back(keys);
+        }
+        ApplyCameraKeys(keys, m_frameTime, kCameraRotationSpeed, camera);
+        break;
+    case Mode::Replay:
+        if (m_frameIndex == 0) {
+            camera = m_start;
+        }
+        if (m_frameIndex < m_logFrameCount) {
+            ApplyCameraKeys(m_frameKeys, m_frameTime, kCameraRotationSpeed, camera);
+        }
+        break;
+    case Mode::Path:
+        camera = m_path.Evaluate(m_frameIndex * m_timeStep);
+        break;
+    }
+    m_frameIndex++;
+}
+
+bool CameraDriver::IsFinished() const {
+    switch (m_mode) {
+    case Mode::Replay:
+        return m_frameIndex >= m_logFrameCount;
+    case Mode::Path:
+        return m_frameIndex * m_timeStep > m_path.GetDuration();
+    default:
+        return false;
+    }
+}
+
+bool CameraDriver::Stop() {
+    if (m_mode != Mode::Record) {
+        return true;
+    }
+    m_mode = Mode::Keyboard;
+    StoreLE32(m_log.data() + kLogFrameCountOffset, m_frameIndex);
+    if (!WriteWholeFile(m_recordPath, m_log.data(), m_log.size())) {
+        m_error = "cannot write input recording";
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,123 @@
+﻿#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Движение камеры lab6 (angle_y, angle_xz, cameraRadius) из одного из источников:
+// клавиатуры, клавиатуры с записью, записи (воспроизведение) или сценария камеры.
+// Окно опрашивает клавиши (GetAsyncKeyState) и передает их маской CameraKey, остальное
+// не зависит от Windows, поэтому запись и сценарий воспроизводятся и в безоконном режиме.
+//
+// Запись - двоичный журнал: заголовок с начальным положением камеры, затем байт на кадр
+// (маска клавиш, старший бит - за ним следует новое время кадра в микросекундах, LEB128).
+// При записи время кадра округляется до микросекунды до того, как попадет в сцену, так что
+// воспроизведение повторяет кадры записи побитно: то же время, те же клавиши, та же арифметика.
+//
+// Сценарий - текст, строка - ключевой кадр "время angle_y angle_xz cameraRadius" (секунды, радианы),
+// '#' - комментарий до конца строки. Времена возрастают, между ключами - линейная интерполяция,
+// angle_y не сворачивается, так что 0 -> 6.283 - полный оборот. Кадры идут с постоянным шагом.
+
+// Клавиши управления камерой (HandleInput)
+namespace CameraKey {
+    enum : uint8_t {
+        Left = 1 << 0,     // поворот влево, angle_y растет
+        Right = 1 << 1,
+        Up = 1 << 2,       // angle_xz растет
+        Down = 1 << 3,
+        Closer = 1 << 4,   // W - cameraRadius уменьшается
+        Farther = 1 << 5,  // S
+        All = 0x3F,
+    };
+}
+
+struct CameraState {
+    double angle_y = 0.0;
+    double angle_xz = 0.5;
+    double cameraRadius = 2.0;
+};
+
+// Скорость поворота камеры, рад/с; приближение - вдвое быстрее, единиц/с
+const double kCameraRotationSpeed = 1.0;
+
+// Поворот и приближение камеры по нажатым клавишам за deltaTime с пределами углов и расстояния
+void ApplyCameraKeys(uint8_t keys, double deltaTime, double rotationSpeed, CameraState& camera);
+
+// Значение ключа командной строки - до пробела; пустая строка, если ключа нет
+std::wstring GetCommandLineValue(const wchar_t* pCommandLine, const wchar_t* pKey);
+
+class CameraPath {
+public:
+    struct Key {
+        double time;
+        CameraState camera;
+    };
+
+    bool Load(const std::wstring& filePath);
+    // Разбор текста сценария; причина ошибки - в GetErrorMessage
+    bool Parse(const char* pText, size_t size);
+    const char* GetErrorMessage() const { return m_error.c_str(); }
+
+    // До первого ключа - первый, после последнего - последний
+    CameraState Evaluate(double time) const;
+    double GetDuration() const { return m_keys.empty() ? 0.0 : m_keys.back().time; }
+    const std::vector<Key>& GetKeys() const { return m_keys; }
+
+private:
+    std::vector<Key> m_keys;
+    std::string m_error;
+};
+
+class CameraDriver {
+public:
+    enum class Mode {
+        Keyboard,
+        Record,
+        Replay,
+        Path,
+    };
+
+    // Ключи командной строки (окно lab6 и безоконный режим): -record файл, -replay файл,
+    // -camerapath файл; без них - клавиатура. camera - начальное положение для записи,
+    // pathTimeStep - шаг кадров сценария. false, если запись или сценарий не загрузились
+    bool Start(const wchar_t* pCommandLine, const CameraState& camera, double pathTimeStep);
+    // Запись начинается с положения camera; журнал пишется в Stop
+    void StartRecording(const std::wstring& filePath, const CameraState& camera);
+    // Замена текущего положения камеры - в первом Update
+    bool StartReplay(const std::wstring& filePath);
+    bool StartPath(const std::wstring& filePath, double timeStep = 1.0 / 60.0);
+    const char* GetErrorMessage() const { return m_error.c_str(); }
+
+    Mode GetMode() const { return m_mode; }
+
+    // Время кадра для сцены: в Keyboard - deltaTime, в Record - оно же, округленное до микросекунды,
+    // в Replay - записанное, в Path - шаг сценария
+    double BeginFrame(double deltaTime);
+    // Положение камеры кадра: из клавиш keys (Keyboard, Record), из записи или из сценария
+    void Update(uint8_t keys, CameraState& camera);
+    // Запись или сценарий пройдены до конца (бенчмарк окончен)
+    bool IsFinished() const;
+    uint32_t GetFrameIndex() const { return m_frameIndex; }
+
+    // Сохранение записи (WriteWholeFile); true, если записи нет
+    bool Stop();
+    size_t GetRecordedSize() const { return m_log.size(); }
+
+private:
+    bool Fail(const char* message);
+
+    Mode m_mode = Mode::Keyboard;
+    std::wstring m_recordPath;
+    std::vector<uint8_t> m_log;       // журнал целиком, с заголовком
+    size_t m_logPosition = 0;         // воспроизведение: следующий кадр
+    uint32_t m_logFrameCount = 0;
+    uint32_t m_frameIndex = 0;        // кадров прошло через Update
+    double m_frameTime = 0.0;         // время текущего кадра
+    uint32_t m_frameMicroseconds = 0; // оно же в записи
+    uint32_t m_lastMicroseconds = 0;  // последнее записанное время
+    uint8_t m_frameKeys = 0;          // воспроизведение: клавиши текущего кадра
+    CameraState m_start;
+    CameraPath m_path;
+    double m_timeStep = 0.0;
+    std::string m_error;
+};
@@ -0,0 +1,44 @@
+﻿#include "CpuFeatures.h"
+
+#if defined(_M_X64) || defined(__x86_64__) || defined(__SSE2__) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define CPU_HAS_X86 1
+#if defined(_MSC_VER)
+#include <intrin.h>
+#include <immintrin.h>
+#endif
+#else
+#define CPU_HAS_X86 0
+#endif
+
+namespace {
+
+bool DetectAvx2() {
+#if !CPU_HAS_X86
+    return false;
+#elif defined(_MSC_VER)
+    int info[4];
+    __cpuid(info, 0);
+    if (info[0] < 7) {
+        return false;
+    }
+    __cpuid(info, 1);
+    const bool osXSave = (info[2] & (1 << 27)) != 0;
+    const bool avx = (info[2] & (1 << 28)) != 0;
+    // ОС должна сохранять регистры YMM при переключении потоков
+    if (!osXSave || !avx || (_xgetbv(0) & 6) != 6) {
+        return false;
+    }
+    __cpuidex(info, 7, 0);
+    return (info[1] & (1 << 5)) != 0;
+#else
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2") != 0;
+#endif
+}
+
+} // namespace
+
+bool CpuSupportsAvx2() {
+    static const bool supported = DetectAvx2();
+    return supported;
+}
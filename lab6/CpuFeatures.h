@@ -0,0 +1,5 @@
+﻿#pragma once
+
+// Возможности процессора, которые проверяются во время выполнения. Код для AVX2 собирается
+// без /arch:AVX2 и вызывается, только если процессор и ОС его поддерживают.
+bool CpuSupportsAvx2();
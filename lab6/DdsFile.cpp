@@ -0,0 +1,327 @@
+﻿#include "DdsFile.h"
+
+#include <cstring>
+#include <utility>
+
+namespace {
+
+const uint32_t kDdsMagic = 0x20534444; // "DDS "
+const size_t kHeaderSize = 124;
+const size_t kHeaderDx10Size = 20;
+
+// Пределы D3D11 для 2D-текстур (D3D11_REQ_TEXTURE2D_U_OR_V_DIMENSION и
+// D3D11_REQ_TEXTURE2D_ARRAY_AXIS_DIMENSION): больше не создать, а размеры из заголовка
+// дальше перемножаются
+const uint32_t kMaxDimension = 16384;
+const uint32_t kMaxArraySize = 2048;
+
+// DDS_HEADER::flags
+const uint32_t DDSD_HEIGHT = 0x2;
+const uint32_t DDSD_WIDTH = 0x4;
+const uint32_t DDSD_DEPTH = 0x800000;
+
+// DDS_PIXELFORMAT::flags
+const uint32_t DDPF_FOURCC = 0x4;
+const uint32_t DDPF_RGB = 0x40;
+
+// DDS_HEADER::caps2
+const uint32_t DDSCAPS2_CUBEMAP = 0x200;
+const uint32_t DDSCAPS2_CUBEMAP_ALLFACES = 0xFC00;
+const uint32_t DDSCAPS2_VOLUME = 0x200000;
+
+// DDS_HEADER_DXT10
+const uint32_t DDS_DIMENSION_TEXTURE2D = 3;
+const uint32_t DDS_RESOURCE_MISC_TEXTURECUBE = 0x4;
+
+inline uint32_t MakeFourCC(char a, char b, char c, char d) {
+    return static_cast<uint32_t>(static_cast<uint8_t>(a)) | (static_cast<uint32_t>(static_cast<uint8_t>(b)) << 8) |
+        (static_cast<uint32_t>(static_cast<uint8_t>(c)) << 16) | (static_cast<uint32_t>(static_cast<uint8_t>(d)) << 24);
+}
+
+inline uint32_t ReadU32(const uint8_t* p) {
+    uint32_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+// Формат из старого заголовка без расширения DX10
+uint32_t FormatFromPixelFormat(const uint8_t* ddspf) {
+    const uint32_t flags = ReadU32(ddspf + 4);
+    const uint32_t fourCC = ReadU32(ddspf + 8);
+    const uint32_t bitCount = ReadU32(ddspf + 12);
+    const uint32_t rMask = ReadU32(ddspf + 16);
+    const uint32_t gMask = ReadU32(ddspf + 20);
+    const uint32_t bMask = ReadU32(ddspf + 24);
+    const uint32_t aMask = ReadU32(ddspf + 28);
+
+    if (flags & DDPF_FOURCC) {
+        if (fourCC == MakeFourCC('D', 'X', 'T', '1')) return DdsFormat::BC1_UNORM;
+        if (fourCC == MakeFourCC('D', 'X', 'T', '2') || fourCC == MakeFourCC('D', 'X', 'T', '3')) return DdsFormat::BC2_UNORM;
+        if (fourCC == MakeFourCC('D', 'X', 'T', '4') || fourCC == MakeFourCC('D', 'X', 'T', '5')) return DdsFormat::BC3_UNORM;
+        if (fourCC == MakeFourCC('A', 'T', 'I', '1') || fourCC == MakeFourCC('B', 'C', '4', 'U')) return DdsFormat::BC4_UNORM;
+        if (fourCC == MakeFourCC('B', 'C', '4', 'S')) return DdsFormat::BC4_SNORM;
+        if (fourCC == MakeFourCC('A', 'T', 'I', '2') || fourCC == MakeFourCC('B', 'C', '5', 'U')) return DdsFormat::BC5_UNORM;
+        if (fourCC == MakeFourCC('B', 'C', '5', 'S')) return DdsFormat::BC5_SNORM;
+        return DdsFormat::Unknown;
+    }
+    if ((flags & DDPF_RGB) && bitCount == 32) {
+        if (rMask == 0x000000FF && gMask == 0x0000FF00 && bMask == 0x00FF0000) return DdsFormat::R8G8B8A8_UNORM;
+        if (rMask == 0x00FF0000 && gMask == 0x0000FF00 && bMask == 0x000000FF) {
+            return aMask ? DdsFormat::B8G8R8A8_UNORM : DdsFormat::B8G8R8X8_UNORM;
+        }
+    }
+    return DdsFormat::Unknown;
+}
+
+} // namespace
+
+uint32_t DdsFile::GetBytesPerBlock(uint32_t dxgiFormat) {
+    switch (dxgiFormat) {
+    case DdsFormat::BC1_UNORM:
+    case DdsFormat::BC1_UNORM_SRGB:
+    case DdsFormat::BC4_UNORM:
+    case DdsFormat::BC4_SNORM:
+        return 8;
+    case DdsFormat::BC2_UNORM:
+    case DdsFormat::BC2_UNORM_SRGB:
+    case DdsFormat::BC3_UNORM:
+    case DdsFormat::BC3_UNORM_SRGB:
+    case DdsFormat::BC5_UNORM:
+    case DdsFormat::BC5_SNORM:
+    case DdsFormat::BC6H_UF16:
+    case DdsFormat::BC6H_SF16:
+    case DdsFormat::BC7_UNORM:
+    case DdsFormat::BC7_UNORM_SRGB:
+        return 16;
+    case DdsFormat::R8G8B8A8_UNORM:
+    case DdsFormat::R8G8B8A8_UNORM_SRGB:
+    case DdsFormat::B8G8R8A8_UNORM:
+    case DdsFormat::B8G8R8X8_UNORM:
+        return 4;
+    default:
+        return 0;
+    }
+}
+
+bool DdsFile::IsBlockCompressedFormat(uint32_t dxgiFormat) {
+    return GetBytesPerBlock(dxgiFormat) > 4;
+}
+
+DdsFile::~DdsFile() {
+    Close();
+}
+
+DdsFile::DdsFile(DdsFile&& other) noexcept {
+    *this = std::move(other);
+}
+
+DdsFile& DdsFile::operator=(DdsFile&& other) noexcept {
+    if (this != &other) {
+        Close();
+        m_mapping = std::move(other.m_mapping);
+        m_pData = other.m_pData;
+        m_size = other.m_size;
+        m_width = other.m_width;
+        m_height = other.m_height;
+        m_mipLevels = other.m_mipLevels;
+        m_arraySize = other.m_arraySize;
+        m_format = other.m_format;
+        m_cubemap = other.m_cubemap;
+        m_blockCompressed = other.m_blockCompressed;
+        m_subresources = std::move(other.m_subresources);
+        m_error = std::move(other.m_error);
+        other.m_pData = nullptr;
+        other.m_size = 0;
+        other.m_subresources.clear();
+    }
+    return *this;
+}
+
+bool DdsFile::Open(const std::wstring& filePath) {
+    Close();
+    if (!m_mapping.Open(filePath)) {
+        return Fail(m_mapping.GetErrorMessage());
+    }
+    m_pData = m_mapping.GetData();
+    m_size = m_mapping.GetSize();
+    if (!Parse()) {
+        Unmap();
+        return false;
+    }
+    return true;
+}
+
+bool DdsFile::Open(const std::string& filePath) {
+    Close();
+    if (!m_mapping.Open(filePath)) {
+        return Fail(m_mapping.GetErrorMessage());
+    }
+    m_pData = m_mapping.GetData();
+    m_size = m_mapping.GetSize();
+    if (!Parse()) {
+        Unmap();
+        return false;
+    }
+    return true;
+}
+
+void DdsFile::Unmap() {
+    m_mapping.Close();
+    m_pData = nullptr;
+    m_size = 0;
+}
+
+bool DdsFile::OpenMemory(const void* pData, size_t size) {
+    Close();
+    m_pData = static_cast<const uint8_t*>(pData);
+    m_size = size;
+    if (!Parse()) {
+        m_pData = nullptr;
+        m_size = 0;
+        return false;
+    }
+    return true;
+}
+
+void DdsFile::Close() {
+    Unmap();
+    m_subresources.clear();
+    m_width = m_height = m_mipLevels = m_arraySize = 0;
+    m_format = DdsFormat::Unknown;
+    m_cubemap = false;
+    m_blockCompressed = false;
+}
+
+bool DdsFile::Fail(const char* message) {
+    m_error = message;
+    return false;
+}
+
+bool DdsFile::Parse() {
+    m_error.clear();
+    m_subresources.clear();
+
+    if (m_size < sizeof(uint32_t) + kHeaderSize || ReadU32(m_pData) != kDdsMagic) {
+        return Fail("not a DDS file");
+    }
+    const uint8_t* pHeader = m_pData + sizeof(uint32_t);
+    const uint8_t* pPixelFormat = pHeader + 72;
+    if (ReadU32(pHeader) != kHeaderSize || ReadU32(pPixelFormat) != 32) {
+        return Fail("invalid DDS header size");
+    }
+
+    const uint32_t flags = ReadU32(pHeader + 4);
+    m_height = ReadU32(pHeader + 8);
+    m_width = ReadU32(pHeader + 12);
+    const uint32_t depth = ReadU32(pHeader + 20);
+    m_mipLevels = ReadU32(pHeader + 24);
+    const uint32_t caps2 = ReadU32(pHeader + 108);
+    if (!(flags & DDSD_WIDTH) || !(flags & DDSD_HEIGHT) || m_width == 0 || m_height == 0) {
+        return Fail("DDS header has no size");
+    }
+    if (m_width > kMaxDimension || m_height > kMaxDimension) {
+        return Fail("DDS texture is too large");
+    }
+    if ((flags & DDSD_DEPTH && depth > 1) || (caps2 & DDSCAPS2_VOLUME)) {
+        return Fail("volume textures are not supported");
+    }
+    if (m_mipLevels == 0) {
+        m_mipLevels = 1;
+    }
+
+    size_t dataOffset = sizeof(uint32_t) + kHeaderSize;
+    uint64_t arraySize = 1;
+    const uint32_t pixelFormatFlags = ReadU32(pPixelFormat + 4);
+    if ((pixelFormatFlags & DDPF_FOURCC) && ReadU32(pPixelFormat + 8) == MakeFourCC('D', 'X', '1', '0')) {
+        // Расширенный заголовок DDS_HEADER_DXT10
+        if (m_size < dataOffset + kHeaderDx10Size) {
+            return Fail("truncated DX10 header");
+        }
+        const uint8_t* pDx10 = m_pData + dataOffset;
+        m_format = ReadU32(pDx10);
+        const uint32_t dimension = ReadU32(pDx10 + 4);
+        const uint32_t miscFlag = ReadU32(pDx10 + 8);
+        arraySize = ReadU32(pDx10 + 12);
+        if (dimension != DDS_DIMENSION_TEXTURE2D) {
+            return Fail("only 2D textures are supported");
+        }
+        if (arraySize == 0) {
+            return Fail("DX10 header has zero array size");
+        }
+        m_cubemap = (miscFlag & DDS_RESOURCE_MISC_TEXTURECUBE) != 0;
+        if (m_cubemap) {
+            arraySize *= 6;
+        }
+        dataOffset += kHeaderDx10Size;
+    }
+    else {
+        m_format = FormatFromPixelFormat(pPixelFormat);
+        if (caps2 & DDSCAPS2_CUBEMAP) {
+            // Старый формат позволяет хранить не все грани, D3D11 так не умеет
+            if ((caps2 & DDSCAPS2_CUBEMAP_ALLFACES) != DDSCAPS2_CUBEMAP_ALLFACES) {
+                return Fail("partial cubemaps are not supported");
+            }
+            m_cubemap = true;
+            arraySize = 6;
+        }
+    }
+    if (arraySize > kMaxArraySize) {
+        return Fail("DDS array is too large");
+    }
+    m_arraySize = static_cast<uint32_t>(arraySize);
+
+    const uint32_t bytesPerBlock = GetBytesPerBlock(m_format);
+    if (bytesPerBlock == 0) {
+        return Fail("unsupported pixel format");
+    }
+    m_blockCompressed = IsBlockCompressedFormat(m_format);
+    if (m_cubemap && m_width != m_height) {
+        return Fail("cubemap faces must be square");
+    }
+
+    uint32_t maxMipLevels = 1;
+    for (uint32_t size = m_width > m_height ? m_width : m_height; size > 1; size >>= 1) {
+        maxMipLevels++;
+    }
+    if (m_mipLevels > maxMipLevels) {
+        return Fail("too many mip levels");
+    }
+
+    // Раскладка данных: для каждого элемента массива (грани) подряд все его mip-уровни
+    m_subresources.resize(static_cast<size_t>(m_arraySize) * m_mipLevels);
+    uint64_t offset = dataOffset;
+    for (uint32_t item = 0; item < m_arraySize; item++) {
+        uint32_t width = m_width;
+        uint32_t height = m_height;
+        for (uint32_t mip = 0; mip < m_mipLevels; mip++) {
+            DdsSubresource& sub = m_subresources[static_cast<size_t>(item) * m_mipLevels + mip];
+            sub.width = width;
+            sub.height = height;
+            // Произведения - в 64 битах, чтобы не зависеть от пределов размеров выше
+            uint64_t rowPitch;
+            uint64_t rowCount;
+            if (m_blockCompressed) {
+                rowPitch = ((static_cast<uint64_t>(width) + 3) / 4) * bytesPerBlock;
+                rowCount = (static_cast<uint64_t>(height) + 3) / 4;
+            }
+            else {
+                rowPitch = static_cast<uint64_t>(width) * bytesPerBlock;
+                rowCount = height;
+            }
+            const uint64_t size = rowPitch * rowCount;
+            if (offset + size > m_size) {
+                m_subresources.clear();
+                return Fail("DDS file is truncated");
+            }
+            sub.rowPitch = static_cast<uint32_t>(rowPitch);
+            sub.rowCount = static_cast<uint32_t>(rowCount);
+            sub.size = static_cast<size_t>(size);
+            sub.pData = m_pData + offset;
+            offset += size;
+
+            width = width > 1 ? width / 2 : 1;
+            height = height > 1 ? height / 2 : 1;
+        }
+    }
+    return true;
+}
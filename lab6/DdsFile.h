@@ -0,0 +1,106 @@
+﻿#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "FileIO.h"
+
+// Разбор DDS-файла без копирования: файл отображается в память, а подресурсы (mip-уровни
+// и грани куба) выдаются как указатели прямо в отображение. Отображение живет, пока жив
+// объект или до вызова Close() - обычно сразу после загрузки текстуры в видеопамять.
+
+// Значения DXGI_FORMAT, с которыми работает загрузчик (совпадают с dxgiformat.h)
+namespace DdsFormat {
+    enum : uint32_t {
+        Unknown = 0,
+        R8G8B8A8_UNORM = 28,
+        R8G8B8A8_UNORM_SRGB = 29,
+        BC1_UNORM = 71,
+        BC1_UNORM_SRGB = 72,
+        BC2_UNORM = 74,
+        BC2_UNORM_SRGB = 75,
+        BC3_UNORM = 77,
+        BC3_UNORM_SRGB = 78,
+        BC4_UNORM = 80,
+        BC4_SNORM = 81,
+        BC5_UNORM = 83,
+        BC5_SNORM = 84,
+        B8G8R8A8_UNORM = 87,
+        B8G8R8X8_UNORM = 88,
+        BC6H_UF16 = 95,
+        BC6H_SF16 = 96,
+        BC7_UNORM = 98,
+        BC7_UNORM_SRGB = 99,
+    };
+}
+
+// Один подресурс: mip-уровень одного элемента массива / грани куба
+struct DdsSubresource {
+    const uint8_t* pData = nullptr;
+    size_t size = 0;
+    uint32_t rowPitch = 0;   // байт в строке (для BC-форматов - в строке блоков 4x4)
+    uint32_t rowCount = 0;   // строк (для BC-форматов - строк блоков)
+    uint32_t width = 0;
+    uint32_t height = 0;
+};
+
+class DdsFile {
+public:
+    DdsFile() = default;
+    ~DdsFile();
+
+    DdsFile(const DdsFile&) = delete;
+    DdsFile& operator=(const DdsFile&) = delete;
+    DdsFile(DdsFile&& other) noexcept;
+    DdsFile& operator=(DdsFile&& other) noexcept;
+
+    bool Open(const std::wstring& filePath);
+    bool Open(const std::string& filePath);
+    // Разбор уже загруженного буфера (буфер должен пережить объект)
+    bool OpenMemory(const void* pData, size_t size);
+    void Close();
+
+    bool IsOpen() const { return m_pData != nullptr; }
+    const std::string& GetErrorMessage() const { return m_error; }
+    // Файл целиком (заголовок и данные) - для хеширования содержимого
+    const uint8_t* GetFileData() const { return m_pData; }
+    size_t GetFileSize() const { return m_size; }
+
+    uint32_t GetWidth() const { return m_width; }
+    uint32_t GetHeight() const { return m_height; }
+    uint32_t GetMipLevels() const { return m_mipLevels; }
+    uint32_t GetArraySize() const { return m_arraySize; } // для кубов - число граней (6 * число кубов)
+    bool IsCubemap() const { return m_cubemap; }
+    // Значение DXGI_FORMAT (модуль не зависит от заголовков DXGI)
+    uint32_t GetFormat() const { return m_format; }
+    bool IsBlockCompressed() const { return m_blockCompressed; }
+
+    // Индекс подресурса как в D3D11: item * mipLevels + mip
+    uint32_t GetSubresourceCount() const { return static_cast<uint32_t>(m_subresources.size()); }
+    const DdsSubresource& GetSubresource(uint32_t mip, uint32_t item = 0) const { return m_subresources[item * m_mipLevels + mip]; }
+    const DdsSubresource* GetSubresources() const { return m_subresources.data(); }
+
+    // Размер одного блока 4x4 для BC-форматов или одного пикселя для остальных; 0 - формат не поддерживается
+    static uint32_t GetBytesPerBlock(uint32_t dxgiFormat);
+    static bool IsBlockCompressedFormat(uint32_t dxgiFormat);
+
+private:
+    bool Parse();
+    bool Fail(const char* message);
+    void Unmap();
+
+    MappedFile m_mapping;
+    const uint8_t* m_pData = nullptr; // отображение или буфер OpenMemory
+    size_t m_size = 0;
+
+    uint32_t m_width = 0;
+    uint32_t m_height = 0;
+    uint32_t m_mipLevels = 0;
+    uint32_t m_arraySize = 0;
+    uint32_t m_format = 0;
+    bool m_cubemap = false;
+    bool m_blockCompressed = false;
+    std::vector<DdsSubresource> m_subresources;
+    std::string m_error;
+};
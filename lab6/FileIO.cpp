@@ -0,0 +1,196 @@
+﻿#include "FileIO.h"
+
+#include <cstdio>
+#include <utility>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <cstdlib>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#ifndef _WIN32
+namespace {
+
+bool NarrowPath(const std::wstring& filePath, std::string& narrowPath) {
+    narrowPath.assign(filePath.size() * 4 + 1, '\0');
+    size_t length = wcstombs(&narrowPath[0], filePath.c_str(), narrowPath.size());
+    if (length == static_cast<size_t>(-1)) {
+        return false;
+    }
+    narrowPath.resize(length);
+    return true;
+}
+
+} // namespace
+#endif
+
+MappedFile::~MappedFile() {
+    Close();
+}
+
+MappedFile::MappedFile(MappedFile&& other) noexcept {
+    *this = std::move(other);
+}
+
+MappedFile& MappedFile::operator=(MappedFile&& other) noexcept {
+    if (this != &other) {
+        Close();
+        m_pData = other.m_pData;
+        m_size = other.m_size;
+#ifdef _WIN32
+        m_hFile = other.m_hFile;
+        m_hMapping = other.m_hMapping;
+        other.m_hFile = nullptr;
+        other.m_hMapping = nullptr;
+#endif
+        m_error = other.m_error;
+        other.m_pData = nullptr;
+        other.m_size = 0;
+    }
+    return *this;
+}
+
+bool MappedFile::Fail(const char* message) {
+    Close();
+    m_error = message;
+    return false;
+}
+
+#ifdef _WIN32
+
+bool MappedFile::Open(const std::wstring& filePath) {
+    Close();
+    HANDLE hFile = CreateFileW(filePath.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+        FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (hFile == INVALID_HANDLE_VALUE) {
+        return Fail("cannot open file");
+    }
+    m_hFile = hFile;
+
+    LARGE_INTEGER fileSize = {};
+    if (!GetFileSizeEx(hFile, &fileSize) || fileSize.QuadPart == 0) {
+        return Fail("cannot get file size");
+    }
+
+    m_hMapping = CreateFileMappingW(hFile, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (!m_hMapping) {
+        return Fail("cannot create file mapping");
+    }
+    m_pData = static_cast<const uint8_t*>(MapViewOfFile(m_hMapping, FILE_MAP_READ, 0, 0, 0));
+    if (!m_pData) {
+        return Fail("cannot map file");
+    }
+    m_size = static_cast<size_t>(fileSize.QuadPart);
+    m_error = "";
+    return true;
+}
+
+bool MappedFile::Open(const std::string& filePath) {
+    int length = MultiByteToWideChar(CP_UTF8, 0, filePath.c_str(), -1, nullptr, 0);
+    std::wstring widePath(length > 0 ? length - 1 : 0, L'\0');
+    if (length > 1) {
+        MultiByteToWideChar(CP_UTF8, 0, filePath.c_str(), -1, &widePath[0], length);
+    }
+    return Open(widePath);
+}
+
+void MappedFile::Close() {
+    if (m_pData) {
+        UnmapViewOfFile(m_pData);
+    }
+    if (m_hMapping) {
+        CloseHandle(m_hMapping);
+    }
+    if (m_hFile) {
+        CloseHandle(m_hFile);
+    }
+    m_hMapping = nullptr;
+    m_hFile = nullptr;
+    m_pData = nullptr;
+    m_size = 0;
+}
+
+bool WriteWholeFile(const std::wstring& filePath, const void* pData, size_t size) {
+    const std::wstring tempPath = filePath + L".tmp";
+    FILE* pFile = nullptr;
+    if (_wfopen_s(&pFile, tempPath.c_str(), L"wb") != 0 || !pFile) {
+        return false;
+    }
+    const bool written = fwrite(pData, 1, size, pFile) == size;
+    if (fclose(pFile) != 0 || !written) {
+        DeleteFileW(tempPath.c_str());
+        return false;
+    }
+    if (!MoveFileExW(tempPath.c_str(), filePath.c_str(), MOVEFILE_REPLACE_EXISTING)) {
+        DeleteFileW(tempPath.c_str());
+        return false;
+    }
+    return true;
+}
+
+#else
+
+bool MappedFile::Open(const std::string& filePath) {
+    Close();
+    int fd = open(filePath.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return Fail("cannot open file");
+    }
+    struct stat st = {};
+    if (fstat(fd, &st) != 0 || st.st_size == 0) {
+        close(fd);
+        return Fail("cannot get file size");
+    }
+    void* pMapping = mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+    // Дескриптор после mmap не нужен
+    close(fd);
+    if (pMapping == MAP_FAILED) {
+        return Fail("cannot map file");
+    }
+    m_pData = static_cast<const uint8_t*>(pMapping);
+    m_size = static_cast<size_t>(st.st_size);
+    m_error = "";
+    return true;
+}
+
+bool MappedFile::Open(const std::wstring& filePath) {
+    std::string narrowPath;
+    if (!NarrowPath(filePath, narrowPath)) {
+        return Fail("cannot convert file name");
+    }
+    return Open(narrowPath);
+}
+
+void MappedFile::Close() {
+    if (m_pData) {
+        munmap(const_cast<uint8_t*>(m_pData), m_size);
+    }
+    m_pData = nullptr;
+    m_size = 0;
+}
+
+bool WriteWholeFile(const std::wstring& filePath, const void* pData, size_t size) {
+    std::string narrowPath;
+    if (!NarrowPath(filePath, narrowPath)) {
+        return false;
+    }
+    const std::string tempPath = narrowPath + ".tmp";
+    FILE* pFile = fopen(tempPath.c_str(), "wb");
+    if (!pFile) {
+        return false;
+    }
+    const bool written = fwrite(pData, 1, size, pFile) == size;
+    if (fclose(pFile) != 0 || !written || rename(tempPath.c_str(), narrowPath.c_str()) != 0) {
+        remove(tempPath.c_str());
+        return false;
+    }
+    return true;
+}
+
+#endif
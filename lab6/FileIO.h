@@ -0,0 +1,42 @@
+﻿#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// Файл, отображенный в память только для чтения. Используется загрузчиком DDS и кэшем шейдеров.
+class MappedFile {
+public:
+    MappedFile() = default;
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+    MappedFile(MappedFile&& other) noexcept;
+    MappedFile& operator=(MappedFile&& other) noexcept;
+
+    bool Open(const std::wstring& filePath);
+    bool Open(const std::string& filePath);
+    void Close();
+
+    bool IsOpen() const { return m_pData != nullptr; }
+    const uint8_t* GetData() const { return m_pData; }
+    size_t GetSize() const { return m_size; }
+    // Причина последней ошибки Open
+    const char* GetErrorMessage() const { return m_error; }
+
+private:
+    bool Fail(const char* message);
+
+    const uint8_t* m_pData = nullptr;
+    size_t m_size = 0;
+#ifdef _WIN32
+    void* m_hFile = nullptr;
+    void* m_hMapping = nullptr;
+#endif
+    const char* m_error = "";
+};
+
+// Запись файла целиком: сначала во временный файл рядом, затем замена, чтобы при сбое
+// на диске не остался наполовину записанный файл. Файл не должен быть отображен в память.
+bool WriteWholeFile(const std::wstring& filePath, const void* pData, size_t size);
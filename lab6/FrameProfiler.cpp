@@ -0,0 +1,296 @@
+﻿#include "FrameProfiler.h"
+#include "FileIO.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <thread>
+
+namespace {
+
+std::atomic<uint64_t> g_nextProfilerId{ 1 };
+
+// Кольца текущего потока: последнее использованное и все, по профилировщикам
+struct ThreadRingEntry {
+    uint64_t profilerId;
+    void* pRing;
+};
+thread_local ThreadRingEntry t_lastRing = { 0, nullptr };
+thread_local std::vector<ThreadRingEntry> t_rings;
+
+double GetPercentile(const std::vector<float>& sorted, double fraction) {
+    // Ближайший ранг: наименьший замер, не меньше которого доля fraction замеров
+    const size_t rank = static_cast<size_t>(std::ceil(fraction * sorted.size()));
+    return sorted[rank > 0 ? (std::min)(rank, sorted.size()) - 1 : 0];
+}
+
+void AppendJsonString(std::string& json, const char* text) {
+    json += '"';
+    for (const char* p = text; *p; p++) {
+        if (*p == '"' || *p == '\\') {
+            json += '\\';
+        }
+        json += *p;
+    }
+    json += '"';
+}
+
+} // namespace
+
+FrameProfiler::FrameProfiler()
+    : m_id(g_nextProfilerId.fetch_add(1, std::memory_order_relaxed)),
+      m_startTicks(ReadProfileTicks()),
+      m_startTime(std::chrono::steady_clock::now()) {
+    m_history.reserve(kHistoryCapacity);
+}
+
+FrameProfiler::ThreadRing* FrameProfiler::GetThreadRing() {
+    if (t_lastRing.profilerId == m_id) {
+        return static_cast<ThreadRing*>(t_lastRing.pRing);
+    }
+    for (const ThreadRingEntry& entry : t_rings) {
+        if (entry.profilerId == m_id) {
+            t_lastRing = entry;
+            return static_cast<ThreadRing*>(entry.pRing);
+        }
+    }
+
+    // Первая зона потока: кольцо создается один раз и живет, пока жив профилировщик
+    auto pRing = std::make_unique<ThreadRing>();
+    ThreadRing* pResult = pRing.get();
+    {
+        std::lock_guard<std::mutex> lock(m_ringsMutex);
+        pRing->threadIndex = static_cast<unsigned>(m_rings.size());
+        m_rings.push_back(std::move(pRing));
+    }
+    t_lastRing = { m_id, pResult };
+    t_rings.push_back(t_lastRing);
+    return pResult;
+}
+
+void FrameProfiler::Record(const char* name, uint64_t begin, uint64_t end) {
+    ThreadRing* pRing = GetThreadRing();
+    const uint32_t head = pRing->head.load(std::memory_order_relaxed);
+    if (head - pRing->tail.load(std::memory_order_acquire) >= kRingCapacity) {
+        pRing->dropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    ProfileEvent& event = pRing->events[head & (kRingCapacity - 1)];
+    event.name = name;
+    event.begin = begin;
+    event.end = end;
+    // Запись становится видна Collect вместе с новым head
+    pRing->head.store(head + 1, std::memory_order_release);
+}
+
+FrameProfiler::Stage& FrameProfiler::GetStage(const char* name) {
+    // Этапов немного, и записи одного этапа обычно идут подряд
+    if (m_lastStage < m_stages.size() && m_stages[m_lastStage].name == name) {
+        return m_stages[m_lastStage];
+    }
+    for (size_t i = 0; i < m_stages.size(); i++) {
+        if (m_stages[i].name == name) {
+            m_lastStage = i;
+            return m_stages[i];
+        }
+    }
+    m_stages.push_back(Stage());
+    m_stages.back().name = name;
+    m_stages.back().window.reserve(kWindowSize);
+    m_lastStage = m_stages.size() - 1;
+    return m_stages.back();
+}
+
+void FrameProfiler::Collect() {
+    std::lock_guard<std::mutex> lock(m_ringsMutex);
+    for (const std::unique_ptr<ThreadRing>& pRing : m_rings) {
+        const uint32_t head = pRing->head.load(std::memory_order_acquire);
+        uint32_t tail = pRing->tail.load(std::memory_order_relaxed);
+        m_collectedCount += head - tail;
+        for (; tail != head; tail++) {
+            const ProfileEvent& event = pRing->events[tail & (kRingCapacity - 1)];
+            Stage& stage = GetStage(event.name);
+            const float ticks = static_cast<float>(event.end - event.begin);
+            if (stage.window.size() < kWindowSize) {
+                stage.window.push_back(ticks);
+            }
+            else {
+                stage.window[stage.next] = ticks;
+            }
+            stage.next = (stage.next + 1) % kWindowSize;
+            stage.totalCount++;
+
+            const HistoryEvent historyEvent = { event.name, event.begin, event.end, pRing->threadIndex };
+            if (m_history.size() < kHistoryCapacity) {
+                m_history.push_back(historyEvent);
+            }
+            else {
+                m_history[m_historyNext] = historyEvent;
+            }
+            m_historyNext = (m_historyNext + 1) % kHistoryCapacity;
+        }
+        // Место в кольце освобождается после чтения записей
+        pRing->tail.store(head, std::memory_order_release);
+    }
+}
+
+void FrameProfiler::Reset() {
+    Collect();
+    m_stages.clear();
+    m_history.clear();
+    m_historyNext = 0;
+    m_lastStage = 0;
+}
+
+double FrameProfiler::GetTicksPerMicrosecond() const {
+#ifdef PROFILER_USE_TSC
+    const uint64_t ticks = ReadProfileTicks();
+    const double microseconds = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - m_startTime).count();
+    return microseconds > 0 ? (ticks - m_startTicks) / microseconds : 1.0;
+#else
+    return static_cast<double>(std::chrono::steady_clock::period::den) / std::chrono::steady_clock::period::num / 1e6;
+#endif
+}
+
+std::vector<ProfileStageStats> FrameProfiler::GetStageStats() const {
+    const double ticksPerMillisecond = GetTicksPerMicrosecond() * 1000.0;
+    std::vector<ProfileStageStats> result;
+    std::vector<float> sorted;
+    for (const Stage& stage : m_stages) {
+        ProfileStageStats stats;
+        stats.name = stage.name;
+        stats.sampleCount = static_cast<uint32_t>(stage.window.size());
+        stats.totalCount = stage.totalCount;
+        if (!stage.window.empty()) {
+            sorted = stage.window;
+            std::sort(sorted.begin(), sorted.end());
+            stats.p50 = GetPercentile(sorted, 0.50) / ticksPerMillisecond;
+            stats.p95 = GetPercentile(sorted, 0.95) / ticksPerMillisecond;
+            stats.p99 = GetPercentile(sorted, 0.99) / ticksPerMillisecond;
+            stats.maximum = sorted.back() / ticksPerMillisecond;
+        }
+        result.push_back(stats);
+    }
+    return result;
+}
+
+uint64_t FrameProfiler::GetDroppedCount() const {
+    std::lock_guard<std::mutex> lock(m_ringsMutex);
+    uint64_t dropped = 0;
+    for (const std::unique_ptr<ThreadRing>& pRing : m_rings) {
+        dropped += pRing->dropped.load(std::memory_order_relaxed);
+    }
+    return dropped;
+}
+
+unsigned FrameProfiler::GetThreadCount() const {
+    std::lock_guard<std::mutex> lock(m_ringsMutex);
+    return static_cast<unsigned>(m_rings.size());
+}
+
+std::string FrameProfiler::BuildChromeTrace() const {
+    const double ticksPerMicrosecond = GetTicksPerMicrosecond();
+    std::string json = "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+    char buffer[128];
+    const unsigned threadCount = GetThreadCount();
+    for (unsigned thread = 0; thread < threadCount; thread++) {
+        snprintf(buffer, sizeof(buffer), "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":\"thread %u\"}},\n", thread, thread);
+        json += buffer;
+    }
+    // Старые записи первыми
+    const size_t count = m_history.size();
+    const size_t first = count < kHistoryCapacity ? 0 : m_historyNext;
+    for (size_t i = 0; i < count; i++) {
+        const HistoryEvent& event = m_history[(first + i) % count];
+        json += "{\"name\":";
+        AppendJsonString(json, event.name);
+        snprintf(buffer, sizeof(buffer), ",\"cat\":\"frame\",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f},\n",
+            event.threadIndex, (static_cast<double>(event.begin) - static_cast<double>(m_startTicks)) / ticksPerMicrosecond,
+            (event.end - event.begin) / ticksPerMicrosecond);
+        json += buffer;
+    }
+    // Запятая после последнего события недопустима в JSON
+    if (json.compare(json.size() - 2, 2, ",\n") == 0) {
+        json.resize(json.size() - 2);
+    }
+    json += "\n]}\n";
+    return json;
+}
+
+bool FrameProfiler::WriteChromeTrace(const std::wstring& filePath) const {
+    const std::string json = BuildChromeTrace();
+    return WriteWholeFile(filePath, json.data(), json.size());
+}
+
+FrameProfiler& GetFrameProfiler() {
+    static FrameProfiler profiler;
+    return profiler;
+}
+
+ProfilerBenchmarkResult RunProfilerBenchmark(uint32_t zoneCount, unsigned writerThreads) {
+    FrameProfiler profiler;
+    ProfilerBenchmarkResult result;
+    result.writerThreads = writerThreads;
+
+    // Один поток: порции в половину кольца, Collect между порциями не входит в замер
+    const uint32_t batchSize = FrameProfiler::kRingCapacity / 2;
+    volatile uint32_t sink = 0;
+    double zoneSeconds = 0;
+    double loopSeconds = 0;
+    for (uint32_t done = 0; done < zoneCount; done += batchSize) {
+        const uint32_t count = (std::min)(batchSize, zoneCount - done);
+        auto startTime = std::chrono::steady_clock::now();
+        for (uint32_t i = 0; i < count; i++) {
+            ProfileZone zone("zone", profiler);
+            sink = sink + i;
+        }
+        zoneSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+        profiler.Collect();
+
+        startTime = std::chrono::steady_clock::now();
+        for (uint32_t i = 0; i < count; i++) {
+            sink = sink + i;
+        }
+        loopSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+    }
+    result.nanosecondsPerZone = zoneCount > 0 ? zoneSeconds * 1e9 / zoneCount : 0.0;
+    result.nanosecondsPerLoop = zoneCount > 0 ? loopSeconds * 1e9 / zoneCount : 0.0;
+
+    uint64_t tickSum = 0;
+    auto startTime = std::chrono::steady_clock::now();
+    for (uint32_t i = 0; i < zoneCount; i++) {
+        tickSum += ReadProfileTicks();
+    }
+    const double tickSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+    result.nanosecondsPerTicks = zoneCount > 0 ? tickSeconds * 1e9 / zoneCount : 0.0;
+    sink = sink + static_cast<uint32_t>(tickSum);
+    result.writtenCount = zoneCount;
+
+    // Несколько писателей без пауз, основной поток собирает параллельно: кольца могут переполняться,
+    // но каждая запись должна быть либо собрана, либо учтена как отброшенная
+    std::atomic<unsigned> running{ writerThreads };
+    std::vector<std::thread> writers;
+    for (unsigned t = 0; t < writerThreads; t++) {
+        writers.emplace_back([&profiler, &running, zoneCount] {
+            for (uint32_t i = 0; i < zoneCount; i++) {
+                ProfileZone zone((i & 1) ? "odd" : "even", profiler);
+            }
+            running.fetch_sub(1, std::memory_order_release);
+        });
+    }
+    while (running.load(std::memory_order_acquire) != 0) {
+        profiler.Collect();
+        std::this_thread::yield();
+    }
+    for (std::thread& writer : writers) {
+        writer.join();
+    }
+    profiler.Collect();
+    result.writtenCount += static_cast<uint64_t>(writerThreads) * zoneCount;
+
+    result.ticksPerMicrosecond = profiler.GetTicksPerMicrosecond();
+    result.collectedCount = profiler.GetCollectedCount();
+    result.droppedCount = profiler.GetDroppedCount();
+    result.lostCount = result.writtenCount - result.collectedCount - result.droppedCount;
+    return result;
+}
@@ -0,0 +1,160 @@
+﻿#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#if defined(_M_X64) || defined(__x86_64__)
+#ifdef _MSC_VER
+#include <intrin.h>
+#else
+#include <x86intrin.h>
+#endif
+#define PROFILER_USE_TSC 1
+#endif
+
+// Замер этапов кадра. Зона - объект на стеке: в конструкторе и деструкторе читается счетчик
+// тактов, и пара отметок пишется в кольцевой буфер своего потока без блокировок (писатель -
+// только этот поток, читатель - только Collect). Collect раз в кадр забирает записи всех потоков:
+// длительности копятся в скользящем окне каждого этапа (p50/p95/p99), сами записи - в истории,
+// которая выгружается в формате Chrome trace (chrome://tracing, ui.perfetto.dev).
+
+// Такты TSC (на x64 он постоянной частоты); перевод во время - по калибровке
+inline uint64_t ReadProfileTicks() {
+#ifdef PROFILER_USE_TSC
+    return __rdtsc();
+#else
+    return static_cast<uint64_t>(std::chrono::steady_clock::now().time_since_epoch().count());
+#endif
+}
+
+struct ProfileEvent {
+    const char* name;  // строковый литерал: этапы различаются по адресу
+    uint64_t begin;
+    uint64_t end;
+};
+
+struct ProfileStageStats {
+    const char* name = "";
+    uint32_t sampleCount = 0;   // в окне
+    uint64_t totalCount = 0;    // за все время
+    double p50 = 0;             // мс
+    double p95 = 0;
+    double p99 = 0;
+    double maximum = 0;
+};
+
+class FrameProfiler {
+public:
+    static const uint32_t kRingCapacity = 4096;         // записей потока между вызовами Collect
+    static const uint32_t kWindowSize = 256;            // последних замеров этапа для перцентилей
+    static const uint32_t kHistoryCapacity = 1u << 16;  // последних записей для трассы
+
+    FrameProfiler();
+
+    FrameProfiler(const FrameProfiler&) = delete;
+    FrameProfiler& operator=(const FrameProfiler&) = delete;
+
+    // Запись зоны текущего потока. Кольцо заполнено - запись отбрасывается и учитывается в GetDroppedCount
+    void Record(const char* name, uint64_t begin, uint64_t end);
+
+    // Забрать записи всех потоков. Вызывается одним потоком, обычно раз в кадр
+    void Collect();
+    // Забыть окна и историю; кольца потоков остаются
+    void Reset();
+
+    // Этапы в порядке первого появления
+    std::vector<ProfileStageStats> GetStageStats() const;
+    uint64_t GetDroppedCount() const;
+    uint64_t GetCollectedCount() const { return m_collectedCount; }
+    unsigned GetThreadCount() const;
+    // Частота счетчика по времени с создания профилировщика; точнее с каждым вызовом
+    double GetTicksPerMicrosecond() const;
+
+    // История в JSON формата Chrome trace: события "X" с длительностью, время - от создания профилировщика
+    std::string BuildChromeTrace() const;
+    bool WriteChromeTrace(const std::wstring& filePath) const;
+
+private:
+    // Кольцо одного потока. Индексы растут без ограничения, позиция - по маске
+    struct ThreadRing {
+        alignas(64) std::atomic<uint32_t> head{ 0 };  // пишет поток-владелец
+        alignas(64) std::atomic<uint32_t> tail{ 0 };  // пишет Collect
+        std::atomic<uint64_t> dropped{ 0 };
+        unsigned threadIndex = 0;
+        ProfileEvent events[kRingCapacity];
+    };
+
+    // Окна и история хранят такты: в миллисекунды они переводятся при чтении, по последней калибровке
+    struct Stage {
+        const char* name;
+        std::vector<float> window;  // по кругу
+        uint32_t next = 0;
+        uint64_t totalCount = 0;
+    };
+
+    struct HistoryEvent {
+        const char* name;
+        uint64_t begin;
+        uint64_t end;
+        unsigned threadIndex;
+    };
+
+    ThreadRing* GetThreadRing();
+    Stage& GetStage(const char* name);
+
+    const uint64_t m_id;  // различает кольца потоков разных профилировщиков
+    mutable std::mutex m_ringsMutex;
+    std::vector<std::unique_ptr<ThreadRing>> m_rings;
+
+    // Данные Collect
+    std::vector<Stage> m_stages;
+    std::vector<HistoryEvent> m_history;
+    uint32_t m_historyNext = 0;
+    uint64_t m_collectedCount = 0;
+    size_t m_lastStage = 0;
+
+    const uint64_t m_startTicks;
+    const std::chrono::steady_clock::time_point m_startTime;
+};
+
+// Профилировщик кадра lab6; зоны без явного профилировщика пишут в него
+FrameProfiler& GetFrameProfiler();
+
+class ProfileZone {
+public:
+    explicit ProfileZone(const char* name, FrameProfiler& profiler = GetFrameProfiler())
+        : m_profiler(profiler), m_name(name), m_begin(ReadProfileTicks()) {}
+    ~ProfileZone() { m_profiler.Record(m_name, m_begin, ReadProfileTicks()); }
+
+    ProfileZone(const ProfileZone&) = delete;
+    ProfileZone& operator=(const ProfileZone&) = delete;
+
+private:
+    FrameProfiler& m_profiler;
+    const char* m_name;
+    uint64_t m_begin;
+};
+
+// Предел стоимости пустой зоны для -profilebench. Зона - два чтения счетчика и запись в кольцо;
+// где rdtsc медленный (виртуальные машины с перехватом TSC), предел не выполняется
+const double kProfileZoneMaxNanoseconds = 50.0;
+
+struct ProfilerBenchmarkResult {
+    double nanosecondsPerZone = 0;   // пустая зона в одном потоке, без Collect
+    double nanosecondsPerLoop = 0;   // тот же цикл без зон
+    double nanosecondsPerTicks = 0;  // одно чтение счетчика; в зоне их два
+    double ticksPerMicrosecond = 0;
+    unsigned writerThreads = 0;
+    uint64_t writtenCount = 0;       // зон во всех потоках
+    uint64_t collectedCount = 0;
+    uint64_t droppedCount = 0;
+    uint64_t lostCount = 0;          // не собраны и не учтены как отброшенные - ошибка кольца
+};
+
+// Стоимость зоны и проверка колец: writerThreads потоков пишут зоны, пока основной поток собирает
+ProfilerBenchmarkResult RunProfilerBenchmark(uint32_t zoneCount, unsigned writerThreads);
@@ -0,0 +1,401 @@
+﻿#include "FrustumCulling.h"
+#include "CpuFeatures.h"
+
+#include <chrono>
+#include <cmath>
+#include <random>
+
+#if defined(_M_X64) || defined(__x86_64__) || defined(__SSE2__) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define CULL_HAS_SSE2 1
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#define CULL_TARGET_AVX2
+#else
+#define CULL_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+#else
+#define CULL_HAS_SSE2 0
+#endif
+
+namespace {
+
+// Расстояние до плоскости со знаком. Порядок операций один во всех путях - результаты совпадают.
+inline float PlaneDistance(const float plane[4], float x, float y, float z) {
+    return ((x * plane[0] + y * plane[1]) + z * plane[2]) + plane[3];
+}
+
+// Проекция половин размеров AABB на нормаль плоскости
+inline float PlaneExtent(const float absPlane[4], float ex, float ey, float ez) {
+    return (ex * absPlane[0] + ey * absPlane[1]) + ez * absPlane[2];
+}
+
+void GetAbsPlanes(const Frustum& frustum, float absPlanes[6][4]) {
+    for (int p = 0; p < 6; p++) {
+        for (int c = 0; c < 4; c++) {
+            absPlanes[p][c] = std::fabs(frustum.planes[p][c]);
+        }
+    }
+}
+
+// Индекс пишется всегда, а счетчик растет только для видимых - без ветвлений.
+// Запись не выходит за конец: видимых до i не больше i.
+uint32_t CullSpheresScalar(const Frustum& frustum, const SphereBounds& bounds, uint32_t begin, uint32_t* pVisible, uint32_t visibleCount) {
+    for (uint32_t i = begin; i < bounds.GetCount(); i++) {
+        const float negRadius = -bounds.radius[i];
+        bool outside = false;
+        for (int p = 0; p < 6; p++) {
+            outside |= PlaneDistance(frustum.planes[p], bounds.x[i], bounds.y[i], bounds.z[i]) < negRadius;
+        }
+        pVisible[visibleCount] = i;
+        visibleCount += outside ? 0 : 1;
+    }
+    return visibleCount;
+}
+
+uint32_t CullAabbsScalar(const Frustum& frustum, const AabbBounds& bounds, uint32_t begin, uint32_t* pVisible, uint32_t visibleCount) {
+    float absPlanes[6][4];
+    GetAbsPlanes(frustum, absPlanes);
+    for (uint32_t i = begin; i < bounds.GetCount(); i++) {
+        bool outside = false;
+        for (int p = 0; p < 6; p++) {
+            const float distance = PlaneDistance(frustum.planes[p], bounds.centerX[i], bounds.centerY[i], bounds.centerZ[i]);
+            outside |= distance < -PlaneExtent(absPlanes[p], bounds.extentX[i], bounds.extentY[i], bounds.extentZ[i]);
+        }
+        pVisible[visibleCount] = i;
+        visibleCount += outside ? 0 : 1;
+    }
+    return visibleCount;
+}
+
+#if CULL_HAS_SSE2
+
+// SSE2: по 4 объекта, маска видимых раскладывается в индексы без ветвлений
+inline uint32_t AppendVisible4(int mask, uint32_t first, uint32_t* pVisible, uint32_t visibleCount) {
+    for (uint32_t lane = 0; lane < 4; lane++) {
+        pVisible[visibleCount] = first + lane;
+        visibleCount += (mask >> lane) & 1;
+    }
+    return visibleCount;
+}
+
+uint32_t CullSpheresSse2(const Frustum& frustum, const SphereBounds& bounds, uint32_t* pVisible) {
+    const uint32_t blockEnd = bounds.GetCount() & ~3u;
+    uint32_t visibleCount = 0;
+    for (uint32_t i = 0; i < blockEnd; i += 4) {
+        const __m128 x = _mm_loadu_ps(bounds.x.data() + i);
+        const __m128 y = _mm_loadu_ps(bounds.y.data() + i);
+        const __m128 z = _mm_loadu_ps(bounds.z.data() + i);
+        const __m128 negRadius = _mm_sub_ps(_mm_setzero_ps(), _mm_loadu_ps(bounds.radius.data() + i));
+        __m128 outside = _mm_setzero_ps();
+        for (int p = 0; p < 6; p++) {
+            const float* plane = frustum.planes[p];
+            const __m128 distance = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(x, _mm_set1_ps(plane[0])), _mm_mul_ps(y, _mm_set1_ps(plane[1]))),
+                _mm_mul_ps(z, _mm_set1_ps(plane[2]))), _mm_set1_ps(plane[3]));
+            outside = _mm_or_ps(outside, _mm_cmplt_ps(distance, negRadius));
+        }
+        visibleCount = AppendVisible4(~_mm_movemask_ps(outside) & 0xF, i, pVisible, visibleCount);
+    }
+    return CullSpheresScalar(frustum, bounds, blockEnd, pVisible, visibleCount);
+}
+
+uint32_t CullAabbsSse2(const Frustum& frustum, const AabbBounds& bounds, uint32_t* pVisible) {
+    float absPlanes[6][4];
+    GetAbsPlanes(frustum, absPlanes);
+    const uint32_t blockEnd = bounds.GetCount() & ~3u;
+    uint32_t visibleCount = 0;
+    for (uint32_t i = 0; i < blockEnd; i += 4) {
+        const __m128 cx = _mm_loadu_ps(bounds.centerX.data() + i);
+        const __m128 cy = _mm_loadu_ps(bounds.centerY.data() + i);
+        const __m128 cz = _mm_loadu_ps(bounds.centerZ.data() + i);
+        const __m128 ex = _mm_loadu_ps(bounds.extentX.data() + i);
+        const __m128 ey = _mm_loadu_ps(bounds.extentY.data() + i);
+        const __m128 ez = _mm_loadu_ps(bounds.extentZ.data() + i);
+        __m128 outside = _mm_setzero_ps();
+        for (int p = 0; p < 6; p++) {
+            const float* plane = frustum.planes[p];
+            const float* absPlane = absPlanes[p];
+            const __m128 distance = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(cx, _mm_set1_ps(plane[0])), _mm_mul_ps(cy, _mm_set1_ps(plane[1]))),
+                _mm_mul_ps(cz, _mm_set1_ps(plane[2]))), _mm_set1_ps(plane[3]));
+            const __m128 extent = _mm_add_ps(_mm_add_ps(_mm_mul_ps(ex, _mm_set1_ps(absPlane[0])), _mm_mul_ps(ey, _mm_set1_ps(absPlane[1]))),
+                _mm_mul_ps(ez, _mm_set1_ps(absPlane[2])));
+            outside = _mm_or_ps(outside, _mm_cmplt_ps(distance, _mm_sub_ps(_mm_setzero_ps(), extent)));
+        }
+        visibleCount = AppendVisible4(~_mm_movemask_ps(outside) & 0xF, i, pVisible, visibleCount);
+    }
+    return CullAabbsScalar(frustum, bounds, blockEnd, pVisible, visibleCount);
+}
+
+// Таблица сжатия для AVX2: для каждой маски из 8 бит - номера видимых дорожек по 3 бита
+// (биты 0-23) и их число (биты 24-27). Номера разворачиваются в вектор для vpermd.
+struct CompactTable {
+    uint32_t entries[256];
+
+    CompactTable() {
+        for (uint32_t mask = 0; mask < 256; mask++) {
+            uint32_t entry = 0;
+            uint32_t count = 0;
+            for (uint32_t lane = 0; lane < 8; lane++) {
+                if (mask & (1u << lane)) {
+                    entry |= lane << (3 * count);
+                    count++;
+                }
+            }
+            entries[mask] = entry | (count << 24);
+        }
+    }
+};
+
+const CompactTable kCompactTable;
+
+// Все 8 индексов пишутся одной записью, счетчик растет на число видимых.
+// Запись не выходит за конец: видимых до first не больше first, а first + 8 <= count.
+CULL_TARGET_AVX2 inline uint32_t AppendVisible8(int mask, uint32_t first, uint32_t* pVisible, uint32_t visibleCount) {
+    const uint32_t entry = kCompactTable.entries[mask];
+    const __m256i lanes = _mm256_and_si256(_mm256_srlv_epi32(_mm256_set1_epi32(static_cast<int>(entry)),
+        _mm256_setr_epi32(0, 3, 6, 9, 12, 15, 18, 21)), _mm256_set1_epi32(7));
+    const __m256i indices = _mm256_add_epi32(_mm256_set1_epi32(static_cast<int>(first)), _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7));
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(pVisible + visibleCount), _mm256_permutevar8x32_epi32(indices, lanes));
+    return visibleCount + (entry >> 24);
+}
+
+CULL_TARGET_AVX2 uint32_t CullSpheresAvx2(const Frustum& frustum, const SphereBounds& bounds, uint32_t* pVisible) {
+    const uint32_t blockEnd = bounds.GetCount() & ~7u;
+    uint32_t visibleCount = 0;
+    for (uint32_t i = 0; i < blockEnd; i += 8) {
+        const __m256 x = _mm256_loadu_ps(bounds.x.data() + i);
+        const __m256 y = _mm256_loadu_ps(bounds.y.data() + i);
+        const __m256 z = _mm256_loadu_ps(bounds.z.data() + i);
+        const __m256 negRadius = _mm256_sub_ps(_mm256_setzero_ps(), _mm256_loadu_ps(bounds.radius.data() + i));
+        __m256 outside = _mm256_setzero_ps();
+        for (int p = 0; p < 6; p++) {
+            const float* plane = frustum.planes[p];
+            const __m256 distance = _mm256_add_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(x, _mm256_set1_ps(plane[0])),
+                _mm256_mul_ps(y, _mm256_set1_ps(plane[1]))), _mm256_mul_ps(z, _mm256_set1_ps(plane[2]))), _mm256_set1_ps(plane[3]));
+            outside = _mm256_or_ps(outside, _mm256_cmp_ps(distance, negRadius, _CMP_LT_OQ));
+        }
+        visibleCount = AppendVisible8(~_mm256_movemask_ps(outside) & 0xFF, i, pVisible, visibleCount);
+    }
+    // Хвост и вызывающий код - SSE: верхние половины YMM сбрасываются, иначе переход
+    // между состояниями AVX и SSE замедляет их инструкции
+    _mm256_zeroupper();
+    return CullSpheresScalar(frustum, bounds, blockEnd, pVisible, visibleCount);
+}
+
+CULL_TARGET_AVX2 uint32_t CullAabbsAvx2(const Frustum& frustum, const AabbBounds& bounds, uint32_t* pVisible) {
+    float absPlanes[6][4];
+    GetAbsPlanes(frustum, absPlanes);
+    const uint32_t blockEnd = bounds.GetCount() & ~7u;
+    uint32_t visibleCount = 0;
+    for (uint32_t i = 0; i < blockEnd; i += 8) {
+        const __m256 cx = _mm256_loadu_ps(bounds.centerX.data() + i);
+        const __m256 cy = _mm256_loadu_ps(bounds.centerY.data() + i);
+        const __m256 cz = _mm256_loadu_ps(bounds.centerZ.data() + i);
+        const __m256 ex = _mm256_loadu_ps(bounds.extentX.data() + i);
+        const __m256 ey = _mm256_loadu_ps(bounds.extentY.data() + i);
+        const __m256 ez = _mm256_loadu_ps(bounds.extentZ.data() + i);
+        __m256 outside = _mm256_setzero_ps();
+        for (int p = 0; p < 6; p++) {
+            const float* plane = frustum.planes[p];
+            const float* absPlane = absPlanes[p];
+            const __m256 distance = _mm256_add_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(cx, _mm256_set1_ps(plane[0])),
+                _mm256_mul_ps(cy, _mm256_set1_ps(plane[1]))), _mm256_mul_ps(cz, _mm256_set1_ps(plane[2]))), _mm256_set1_ps(plane[3]));
+            const __m256 extent = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(ex, _mm256_set1_ps(absPlane[0])),
+                _mm256_mul_ps(ey, _mm256_set1_ps(absPlane[1]))), _mm256_mul_ps(ez, _mm256_set1_ps(absPlane[2])));
+            outside = _mm256_or_ps(outside, _mm256_cmp_ps(distance, _mm256_sub_ps(_mm256_setzero_ps(), extent), _CMP_LT_OQ));
+        }
+        visibleCount = AppendVisible8(~_mm256_movemask_ps(outside) & 0xFF, i, pVisible, visibleCount);
+    }
+    _mm256_zeroupper();
+    return CullAabbsScalar(frustum, bounds, blockEnd, pVisible, visibleCount);
+}
+
+#endif // CULL_HAS_SSE2
+
+size_t CountMismatches(const uint32_t* pExpected, uint32_t expectedCount, const uint32_t* pActual, uint32_t actualCount) {
+    size_t mismatchCount = expectedCount > actualCount ? expectedCount - actualCount : actualCount - expectedCount;
+    const uint32_t commonCount = expectedCount < actualCount ? expectedCount : actualCount;
+    for (uint32_t i = 0; i < commonCount; i++) {
+        mismatchCount += pExpected[i] != pActual[i] ? 1 : 0;
+    }
+    return mismatchCount;
+}
+
+} // namespace
+
+bool IsCullPathSupported(CullPath path) {
+    switch (path) {
+    case CullPath::Scalar:
+        return true;
+#if CULL_HAS_SSE2
+    case CullPath::Sse2:
+        return true;
+    case CullPath::Avx2:
+        return CpuSupportsAvx2();
+#endif
+    default:
+        return false;
+    }
+}
+
+CullPath GetBestCullPath() {
+    if (IsCullPathSupported(CullPath::Avx2)) {
+        return CullPath::Avx2;
+    }
+    if (IsCullPathSupported(CullPath::Sse2)) {
+        return CullPath::Sse2;
+    }
+    return CullPath::Scalar;
+}
+
+const char* GetCullPathName(CullPath path) {
+    switch (path) {
+    case CullPath::Sse2:
+        return "SSE2";
+    case CullPath::Avx2:
+        return "AVX2";
+    default:
+        return "scalar";
+    }
+}
+
+Frustum ExtractFrustum(DirectX::FXMMATRIX viewProjection) {
+    // Плоскости - суммы и разности столбцов матрицы: -w <= x <= w, -w <= y <= w, 0 <= z <= w
+    DirectX::XMFLOAT4X4 m;
+    DirectX::XMStoreFloat4x4(&m, viewProjection);
+    Frustum frustum;
+    for (int row = 0; row < 4; row++) {
+        frustum.planes[0][row] = m.m[row][3] + m.m[row][0]; // левая
+        frustum.planes[1][row] = m.m[row][3] - m.m[row][0]; // правая
+        frustum.planes[2][row] = m.m[row][3] + m.m[row][1]; // нижняя
+        frustum.planes[3][row] = m.m[row][3] - m.m[row][1]; // верхняя
+        frustum.planes[4][row] = m.m[row][2];               // ближняя
+        frustum.planes[5][row] = m.m[row][3] - m.m[row][2]; // дальняя
+    }
+    // Единичные нормали: расстояние до плоскости сравнивается с радиусом
+    for (float* plane : frustum.planes) {
+        const float length = std::sqrt(plane[0] * plane[0] + plane[1] * plane[1] + plane[2] * plane[2]);
+        const float scale = length > 0.0f ? 1.0f / length : 0.0f;
+        for (int c = 0; c < 4; c++) {
+            plane[c] *= scale;
+        }
+    }
+    return frustum;
+}
+
+void SphereBounds::Resize(uint32_t count) {
+    x.resize(count);
+    y.resize(count);
+    z.resize(count);
+    radius.resize(count);
+}
+
+void SphereBounds::Set(uint32_t index, const DirectX::XMFLOAT3& center, float r) {
+    x[index] = center.x;
+    y[index] = center.y;
+    z[index] = center.z;
+    radius[index] = r;
+}
+
+void AabbBounds::Resize(uint32_t count) {
+    centerX.resize(count);
+    centerY.resize(count);
+    centerZ.resize(count);
+    extentX.resize(count);
+    extentY.resize(count);
+    extentZ.resize(count);
+}
+
+void AabbBounds::Set(uint32_t index, const DirectX::XMFLOAT3& center, const DirectX::XMFLOAT3& extent) {
+    centerX[index] = center.x;
+    centerY[index] = center.y;
+    centerZ[index] = center.z;
+    extentX[index] = extent.x;
+    extentY[index] = extent.y;
+    extentZ[index] = extent.z;
+}
+
+uint32_t CullSpheres(const Frustum& frustum, const SphereBounds& bounds, uint32_t* pVisible, CullPath path) {
+    if (!IsCullPathSupported(path)) {
+        path = CullPath::Scalar;
+    }
+    switch (path) {
+#if CULL_HAS_SSE2
+    case CullPath::Sse2:
+        return CullSpheresSse2(frustum, bounds, pVisible);
+    case CullPath::Avx2:
+        return CullSpheresAvx2(frustum, bounds, pVisible);
+#endif
+    default:
+        return CullSpheresScalar(frustum, bounds, 0, pVisible, 0);
+    }
+}
+
+uint32_t CullAabbs(const Frustum& frustum, const AabbBounds& bounds, uint32_t* pVisible, CullPath path) {
+    if (!IsCullPathSupported(path)) {
+        path = CullPath::Scalar;
+    }
+    switch (path) {
+#if CULL_HAS_SSE2
+    case CullPath::Sse2:
+        return CullAabbsSse2(frustum, bounds, pVisible);
+    case CullPath::Avx2:
+        return CullAabbsAvx2(frustum, bounds, pVisible);
+#endif
+    default:
+        return CullAabbsScalar(frustum, bounds, 0, pVisible, 0);
+    }
+}
+
+std::vector<CullBenchmarkResult> RunCullingBenchmark(uint32_t objectCount, uint32_t repeatCount, uint32_t seed) {
+    std::mt19937 random(seed);
+    std::uniform_real_distribution<float> position(-100.0f, 100.0f);
+    std::uniform_real_distribution<float> size(0.5f, 3.0f);
+    SphereBounds spheres;
+    AabbBounds aabbs;
+    spheres.Resize(objectCount);
+    aabbs.Resize(objectCount);
+    for (uint32_t i = 0; i < objectCount; i++) {
+        const DirectX::XMFLOAT3 center(position(random), position(random), position(random));
+        const DirectX::XMFLOAT3 extent(size(random), size(random), size(random));
+        spheres.Set(i, center, size(random));
+        aabbs.Set(i, center, extent);
+    }
+
+    // Камера в начале координат смотрит вдоль +z, как в lab6
+    const DirectX::XMMATRIX view = DirectX::XMMatrixLookAtLH(DirectX::XMVectorZero(),
+        DirectX::XMVectorSet(0.0f, 0.0f, 1.0f, 0.0f), DirectX::XMVectorSet(0.0f, 1.0f, 0.0f, 0.0f));
+    const DirectX::XMMATRIX projection = DirectX::XMMatrixPerspectiveFovLH(DirectX::XM_PI / 3.0f, 1280.0f / 720.0f, 0.1f, 1000.0f);
+    const Frustum frustum = ExtractFrustum(DirectX::XMMatrixMultiply(view, projection));
+
+    const CullPath paths[] = { CullPath::Scalar, CullPath::Sse2, CullPath::Avx2 };
+    std::vector<uint32_t> expected(objectCount);
+    std::vector<uint32_t> visible(objectCount);
+    std::vector<CullBenchmarkResult> results;
+    for (int shape = 0; shape < 2; shape++) {
+        auto cull = [&](CullPath path) {
+            return shape == 0 ? CullSpheres(frustum, spheres, visible.data(), path) : CullAabbs(frustum, aabbs, visible.data(), path);
+        };
+        const uint32_t expectedCount = cull(CullPath::Scalar);
+        expected.assign(visible.begin(), visible.begin() + expectedCount);
+
+        for (CullPath path : paths) {
+            if (!IsCullPathSupported(path)) {
+                continue;
+            }
+            CullBenchmarkResult result;
+            result.shape = shape == 0 ? "sphere" : "aabb";
+            result.path = path;
+            result.visibleCount = cull(path);
+            result.mismatchCount = CountMismatches(expected.data(), expectedCount, visible.data(), result.visibleCount);
+
+            const auto startTime = std::chrono::steady_clock::now();
+            for (uint32_t repeat = 0; repeat < repeatCount; repeat++) {
+                cull(path);
+            }
+            const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+            result.millionObjectsPerSecond = seconds > 0.0 ? static_cast<double>(objectCount) * repeatCount / seconds / 1e6 : 0.0;
+            results.push_back(result);
+        }
+    }
+    return results;
+}
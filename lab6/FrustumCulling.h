@@ -0,0 +1,71 @@
+﻿#pragma once
+
+#include <cstdint>
+#include <vector>
+#include <DirectXMath.h>
+
+// Отсечение по пирамиде видимости. Объемы объектов хранятся по полям (SoA), поэтому
+// проверка идет сразу по 8 объектов (AVX2) или по 4 (SSE2): каждая плоскость размножается
+// в регистр один раз, а координаты объектов читаются подряд. Результат - сжатый список
+// индексов видимых объектов в порядке возрастания.
+
+enum class CullPath {
+    Scalar,
+    Sse2,
+    Avx2,
+};
+
+bool IsCullPathSupported(CullPath path);
+CullPath GetBestCullPath();
+const char* GetCullPathName(CullPath path);
+
+// Шесть плоскостей (a, b, c, d) с нормалями внутрь пирамиды: точка p внутри, если a*x + b*y + c*z + d >= 0
+struct Frustum {
+    float planes[6][4];
+};
+
+// Плоскости из матрицы view * projection в соглашении DirectXMath (вектор-строка, z от 0 до w)
+Frustum ExtractFrustum(DirectX::FXMMATRIX viewProjection);
+
+// Ограничивающие сферы: центр и радиус
+struct SphereBounds {
+    std::vector<float> x;
+    std::vector<float> y;
+    std::vector<float> z;
+    std::vector<float> radius;
+
+    void Resize(uint32_t count);
+    void Set(uint32_t index, const DirectX::XMFLOAT3& center, float r);
+    uint32_t GetCount() const { return static_cast<uint32_t>(x.size()); }
+};
+
+// Ограничивающие параллелепипеды, выровненные по осям: центр и половины размеров
+struct AabbBounds {
+    std::vector<float> centerX;
+    std::vector<float> centerY;
+    std::vector<float> centerZ;
+    std::vector<float> extentX;
+    std::vector<float> extentY;
+    std::vector<float> extentZ;
+
+    void Resize(uint32_t count);
+    void Set(uint32_t index, const DirectX::XMFLOAT3& center, const DirectX::XMFLOAT3& extent);
+    uint32_t GetCount() const { return static_cast<uint32_t>(centerX.size()); }
+};
+
+// Индексы видимых объектов в pVisible (место под GetCount() индексов), возвращает их число.
+// Проверка консервативная: объект, пересекающий плоскость, считается видимым.
+// Все пути считают в одном порядке и без FMA, поэтому результаты совпадают побитно.
+uint32_t CullSpheres(const Frustum& frustum, const SphereBounds& bounds, uint32_t* pVisible, CullPath path);
+uint32_t CullAabbs(const Frustum& frustum, const AabbBounds& bounds, uint32_t* pVisible, CullPath path);
+
+struct CullBenchmarkResult {
+    const char* shape = "";
+    CullPath path = CullPath::Scalar;
+    double millionObjectsPerSecond = 0; // в одном потоке
+    uint32_t visibleCount = 0;
+    size_t mismatchCount = 0; // расхождения со скалярным путем
+};
+
+// Случайные объекты вокруг камеры (видна примерно десятая часть), все поддерживаемые пути для сфер и AABB
+std::vector<CullBenchmarkResult> RunCullingBenchmark(uint32_t objectCount, uint32_t repeatCount, uint32_t seed = 1);
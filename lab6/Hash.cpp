@@ -0,0 +1,69 @@
+﻿#include "Hash.h"
+
+#include <cstring>
+
+namespace {
+
+inline uint64_t Rotl(uint64_t value, int shift) {
+    return (value << shift) | (value >> (64 - shift));
+}
+
+inline uint64_t ReadU64(const uint8_t* p) {
+    uint64_t value;
+    memcpy(&value, p, sizeof(value));
+    return value;
+}
+
+const uint64_t kPrime1 = 0x9E3779B185EBCA87ull;
+const uint64_t kPrime2 = 0xC2B2AE3D27D4EB4Full;
+const uint64_t kPrime3 = 0x165667B19E3779F9ull;
+
+inline uint64_t Round(uint64_t acc, uint64_t input) {
+    acc += input * kPrime2;
+    return Rotl(acc, 31) * kPrime1;
+}
+
+} // namespace
+
+uint64_t Hash64(const void* pData, size_t size, uint64_t seed) {
+    const uint8_t* p = static_cast<const uint8_t*>(pData);
+    const uint8_t* pEnd = p + size;
+
+    uint64_t hash;
+    if (size >= 32) {
+        // Четыре полосы не зависят друг от друга - умножения идут параллельно
+        uint64_t v0 = seed + kPrime1 + kPrime2;
+        uint64_t v1 = seed + kPrime2;
+        uint64_t v2 = seed;
+        uint64_t v3 = seed - kPrime1;
+        for (; p + 32 <= pEnd; p += 32) {
+            v0 = Round(v0, ReadU64(p));
+            v1 = Round(v1, ReadU64(p + 8));
+            v2 = Round(v2, ReadU64(p + 16));
+            v3 = Round(v3, ReadU64(p + 24));
+        }
+        hash = Rotl(v0, 1) + Rotl(v1, 7) + Rotl(v2, 12) + Rotl(v3, 18);
+        hash = (hash ^ Round(0, v0)) * kPrime1;
+        hash = (hash ^ Round(0, v1)) * kPrime1;
+        hash = (hash ^ Round(0, v2)) * kPrime1;
+        hash = (hash ^ Round(0, v3)) * kPrime1;
+    }
+    else {
+        hash = seed + kPrime3;
+    }
+    hash += static_cast<uint64_t>(size);
+
+    for (; p + 8 <= pEnd; p += 8) {
+        hash = Rotl(hash ^ Round(0, ReadU64(p)), 27) * kPrime1 + kPrime3;
+    }
+    for (; p < pEnd; p++) {
+        hash = Rotl(hash ^ (*p * kPrime3), 11) * kPrime1;
+    }
+
+    hash ^= hash >> 33;
+    hash *= kPrime2;
+    hash ^= hash >> 29;
+    hash *= kPrime3;
+    hash ^= hash >> 32;
+    return hash;
+}
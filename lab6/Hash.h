@@ -0,0 +1,8 @@
+﻿#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// Быстрый некриптографический 64-битный хеш: 4 независимые полосы по 8 байт, затем перемешивание.
+// seed позволяет хешировать несколько полей подряд: Hash64(b, n, Hash64(a, m)).
+uint64_t Hash64(const void* pData, size_t size, uint64_t seed = 0);
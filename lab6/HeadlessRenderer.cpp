@@ -0,0 +1,186 @@
+﻿#include "HeadlessRenderer.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cwchar>
+#include <memory>
+
+#include "CameraDriver.h"
+#include "Hash.h"
+#include "ReportWriter.h"
+#include "SceneFrame.h"
+#include "TextureCache.h"
+#include "ThreadPool.h"
+
+namespace {
+
+double MillisecondsSince(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+bool LoadSoftwareTexture(TextureCache& textureCache, const std::wstring& filePath, SoftwareTexture& texture, std::string& error) {
+    const std::shared_ptr<TextureData> pSource = textureCache.Load(filePath);
+    if (!pSource) {
+        error = "cannot load texture: " + textureCache.GetErrorMessage();
+        return false;
+    }
+    if (!DecodeSoftwareTexture(*pSource, texture)) {
+        // Без DirectXTex распаковываются только RGBA8 и BC-форматы
+        error = "unsupported texture format";
+        return false;
+    }
+    return true;
+}
+
+// Ближайший ранг по отсортированным значениям
+double Percentile(const std::vector<double>& sorted, double fraction) {
+    if (sorted.empty()) {
+        return 0;
+    }
+    const size_t rank = static_cast<size_t>(fraction * (sorted.size() - 1) + 0.5);
+    return sorted[rank];
+}
+
+} // namespace
+
+bool ParseHeadlessOptions(const wchar_t* pCommandLine, HeadlessOptions& options) {
+    if (const wchar_t* pFrames = wcsstr(pCommandLine, L"-headless")) {
+        pFrames += wcslen(L"-headless");
+        wchar_t* pEnd = nullptr;
+        const unsigned long frameCount = wcstoul(pFrames, &pEnd, 10);
+        if (pEnd != pFrames) {
+            options.frameCount = static_cast<uint32_t>(frameCount);
+        }
+    }
+    const std::wstring format = GetCommandLineValue(pCommandLine, L"-format");
+    if (!format.empty() && !ParseImageFormat(format.c_str(), options.format)) {
+        return false;
+    }
+    const std::wstring prefix = GetCommandLineValue(pCommandLine, L"-out");
+    if (!prefix.empty()) {
+        options.outputPrefix = prefix;
+    }
+    options.replayPath = GetCommandLineValue(pCommandLine, L"-replay");
+    options.cameraPathPath = GetCommandLineValue(pCommandLine, L"-camerapath");
+    return true;
+}
+
+bool RunHeadless(ThreadPool& threadPool, const HeadlessOptions& options, HeadlessResult& result) {
+    result = HeadlessResult();
+    result.threadCount = threadPool.GetThreadCount();
+
+    const auto loadStart = std::chrono::steady_clock::now();
+    TextureCache textureCache(&threadPool);
+    SoftwareTexture colorTexture;
+    SoftwareTexture normalTexture;
+    SoftwareCubeTexture skyTexture;
+    if (!LoadSoftwareTexture(textureCache, options.colorTexturePath, colorTexture, result.error) ||
+        !LoadSoftwareTexture(textureCache, options.normalTexturePath, normalTexture, result.error) ||
+        !LoadSoftwareTexture(textureCache, options.skyTexturePath, skyTexture.faces[0], result.error)) {
+        return false;
+    }
+    for (int i = 1; i < 6; i++) {
+        skyTexture.faces[i] = skyTexture.faces[0];
+    }
+    result.loadMilliseconds = MillisecondsSince(loadStart);
+
+    CameraDriver cameraDriver;
+    if (!options.replayPath.empty() && !cameraDriver.StartReplay(options.replayPath)) {
+        result.error = std::string("cannot replay input: ") + cameraDriver.GetErrorMessage();
+        return false;
+    }
+    if (options.replayPath.empty() && !options.cameraPathPath.empty() && !cameraDriver.StartPath(options.cameraPathPath, options.timeStep)) {
+        result.error = cameraDriver.GetErrorMessage();
+        return false;
+    }
+    if (options.frameCount == 0 && cameraDriver.GetMode() == CameraDriver::Mode::Keyboard) {
+        result.error = "frame count is required without -replay or -camerapath";
+        return false;
+    }
+
+    MaterialBuffer material = {};
+    material.shine = DirectX::XMFLOAT4(32.0f, 0.0f, 0.0f, 0.0f);
+
+    // Без записи и сценария камера стоит в начальном положении окна
+    CameraState camera;
+    DirectX::XMFLOAT3 cameraPosition = { 0.0f, 0.0f, 0.0f };
+    FrameConstants frame = {};
+    SceneTransforms transforms;
+
+    SoftwareRasterizer rasterizer(threadPool, kHeadlessWidth, kHeadlessHeight);
+    const size_t frameBytes = static_cast<size_t>(kHeadlessWidth) * kHeadlessHeight * sizeof(uint32_t);
+    std::vector<uint8_t> file;
+    for (uint32_t i = 0; (options.frameCount == 0 || i < options.frameCount) && !cameraDriver.IsFinished(); i++) {
+        result.frames.emplace_back();
+        HeadlessFrameResult& frameResult = result.frames.back();
+
+        const auto renderStart = std::chrono::steady_clock::now();
+        const double deltaTime = cameraDriver.BeginFrame(options.timeStep);
+        cameraDriver.Update(0, camera);
+        ComputeFrameConstants(deltaTime, camera.angle_y, camera.angle_xz, camera.cameraRadius, cameraPosition, transforms, frame);
+        RenderSoftware(rasterizer, frame, material, colorTexture, normalTexture, skyTexture);
+        frameResult.renderMilliseconds = MillisecondsSince(renderStart);
+
+        frameResult.imageHash = Hash64(rasterizer.GetColorBuffer(), frameBytes);
+        result.sequenceHash = Hash64(&frameResult.imageHash, sizeof(frameResult.imageHash), result.sequenceHash);
+
+        if (options.outputPrefix.empty()) {
+            continue;
+        }
+        wchar_t number[16];
+        swprintf(number, sizeof(number) / sizeof(number[0]), L"%04u", i);
+        const std::wstring filePath = options.outputPrefix + number + GetImageFileExtension(options.format);
+        const auto writeStart = std::chrono::steady_clock::now();
+        if (!WriteImage(filePath, options.format, rasterizer.GetColorBuffer(), kHeadlessWidth, kHeadlessHeight, kHeadlessWidth, file)) {
+            result.error = "cannot write frame " + std::to_string(i);
+            result.frames.pop_back();
+            return false;
+        }
+        frameResult.writeMilliseconds = MillisecondsSince(writeStart);
+        result.bytesWritten += file.size();
+    }
+    return true;
+}
+
+std::string FormatHeadlessReport(const HeadlessOptions& options, const HeadlessResult& result) {
+    ReportWriter report;
+    report.Print("Headless render: %u frames %ux%u, time step %.6f s, %u threads, format %s\n",
+        static_cast<unsigned>(result.frames.size()), kHeadlessWidth, kHeadlessHeight, options.timeStep, result.threadCount,
+        GetImageFormatName(options.format));
+    const char* pCamera = !options.replayPath.empty() ? "input replay" : !options.cameraPathPath.empty() ? "camera path" : "fixed";
+    report.Print("Camera: %s\n", pCamera);
+    report.Print("Texture load: %.2f ms, written: %.1f MB\n",
+        result.loadMilliseconds, result.bytesWritten / (1024.0 * 1024.0));
+    report.Print("Sequence hash: %016llx\n\n", static_cast<unsigned long long>(result.sequenceHash));
+
+    report.Print("%6s %12s %12s %18s\n", "frame", "render ms", "write ms", "hash");
+    std::vector<double> render;
+    std::vector<double> write;
+    for (size_t i = 0; i < result.frames.size(); i++) {
+        const HeadlessFrameResult& frame = result.frames[i];
+        report.Print("%6u %12.3f %12.3f %18llx\n", static_cast<unsigned>(i), frame.renderMilliseconds,
+            frame.writeMilliseconds, static_cast<unsigned long long>(frame.imageHash));
+        render.push_back(frame.renderMilliseconds);
+        write.push_back(frame.writeMilliseconds);
+    }
+
+    report.Print("\n%-8s %10s %10s %10s %10s\n", "", "mean ms", "p50 ms", "p95 ms", "max ms");
+    const char* const kNames[2] = { "render", "write" };
+    std::vector<double>* const pSeries[2] = { &render, &write };
+    for (int s = 0; s < 2; s++) {
+        std::vector<double>& values = *pSeries[s];
+        std::sort(values.begin(), values.end());
+        double sum = 0;
+        for (double value : values) {
+            sum += value;
+        }
+        report.Print("%-8s %10.3f %10.3f %10.3f %10.3f\n", kNames[s],
+            values.empty() ? 0.0 : sum / values.size(), Percentile(values, 0.5), Percentile(values, 0.95),
+            values.empty() ? 0.0 : values.back());
+    }
+    if (!result.error.empty()) {
+        report.Print("\nFAILED: %s\n", result.error.c_str());
+    }
+    return report.GetText();
+}
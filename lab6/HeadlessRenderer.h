@@ -0,0 +1,61 @@
+﻿#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "ImageWriter.h"
+
+class ThreadPool;
+
+// Безоконный режим: кадры сцены lab6 на программном растеризаторе (SceneFrame.h) без окна,
+// цепочки обмена и устройства, с записью последовательности изображений. Время кадра - не часы,
+// а постоянный шаг timeStep; камера стоит в начальном положении окна или движется по записи
+// клавиш окна либо по сценарию (CameraDriver.h). Кадр i зависит только от i, шага и записи или
+// сценария: повторный прогон дает те же изображения (хеши кадров в отчете).
+// Работает и без Windows (lab6_bench -headless, BenchMain.cpp).
+
+// Размер кадра окна lab6 (под него рассчитана проекция ComputeFrameConstants)
+const uint32_t kHeadlessWidth = 1280;
+const uint32_t kHeadlessHeight = 720;
+
+struct HeadlessOptions {
+    uint32_t frameCount = 60;  // 0 - до конца записи или сценария
+    double timeStep = 1.0 / 60.0;
+    ImageFormat format = ImageFormat::Ppm;
+    // Кадр i пишется в <outputPrefix><i, 4 цифры><расширение>; пустой префикс - без записи
+    std::wstring outputPrefix = L"frame_";
+    // Движение камеры: запись -record окна (время кадров - из нее) или сценарий с шагом timeStep
+    std::wstring replayPath;
+    std::wstring cameraPathPath;
+    // Текстуры сцены (как в окне: space.dds - все шесть граней неба)
+    std::wstring colorTexturePath = L"texture.dds";
+    std::wstring normalTexturePath = L"normal_map.dds";
+    std::wstring skyTexturePath = L"space.dds";
+};
+
+struct HeadlessFrameResult {
+    double renderMilliseconds = 0;
+    double writeMilliseconds = 0;  // кодирование и запись файла
+    uint64_t imageHash = 0;        // Hash64 цветового буфера
+};
+
+struct HeadlessResult {
+    std::vector<HeadlessFrameResult> frames;
+    uint32_t threadCount = 0;
+    double loadMilliseconds = 0;   // загрузка и распаковка текстур
+    uint64_t sequenceHash = 0;     // хеш всех кадров подряд
+    size_t bytesWritten = 0;
+    std::string error;             // причина неудачи RunHeadless
+};
+
+// Ключи командной строки (одинаковые в lab6 и lab6_bench): -headless N - число кадров,
+// -format ppm|png|exr, -out префикс (до пробела), -replay файл, -camerapath файл.
+// false для неизвестного формата
+bool ParseHeadlessOptions(const wchar_t* pCommandLine, HeadlessOptions& options);
+
+// false, если не загрузились текстуры или не записался кадр (причина - в result.error)
+bool RunHeadless(ThreadPool& threadPool, const HeadlessOptions& options, HeadlessResult& result);
+
+// Таблица по кадрам и сводка (среднее, p50, p95, максимум) в текстовом виде
+std::string FormatHeadlessReport(const HeadlessOptions& options, const HeadlessResult& result);
@@ -0,0 +1,397 @@
+﻿#include "ImageWriter.h"
+
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <cwchar>
+
+#include "FileIO.h"
+
+namespace {
+
+void AppendBytes(std::vector<uint8_t>& file, const void* pData, size_t size) {
+    const uint8_t* pBytes = static_cast<const uint8_t*>(pData);
+    file.insert(file.end(), pBytes, pBytes + size);
+}
+
+void AppendString(std::vector<uint8_t>& file, const char* pText) {
+    // Вместе с завершающим нулем
+    AppendBytes(file, pText, strlen(pText) + 1);
+}
+
+void AppendLE32(std::vector<uint8_t>& file, uint32_t value) {
+    const uint8_t bytes[4] = { uint8_t(value), uint8_t(value >> 8), uint8_t(value >> 16), uint8_t(value >> 24) };
+    AppendBytes(file, bytes, sizeof(bytes));
+}
+
+void AppendLE64(std::vector<uint8_t>& file, uint64_t value) {
+    AppendLE32(file, static_cast<uint32_t>(value));
+    AppendLE32(file, static_cast<uint32_t>(value >> 32));
+}
+
+void StoreBE32(uint8_t* pDst, uint32_t value) {
+    pDst[0] = uint8_t(value >> 24);
+    pDst[1] = uint8_t(value >> 16);
+    pDst[2] = uint8_t(value >> 8);
+    pDst[3] = uint8_t(value);
+}
+
+void AppendBE32(std::vector<uint8_t>& file, uint32_t value) {
+    uint8_t bytes[4];
+    StoreBE32(bytes, value);
+    AppendBytes(file, bytes, sizeof(bytes));
+}
+
+void EncodePpm(const uint32_t* pPixels, uint32_t width, uint32_t height, size_t pixelPitch, std::vector<uint8_t>& file) {
+    char header[64];
+    const int headerSize = snprintf(header, sizeof(header), "P6\n%u %u\n255\n", width, height);
+    file.assign(header, header + headerSize);
+    file.resize(file.size() + static_cast<size_t>(width) * height * 3);
+    uint8_t* pDst = file.data() + headerSize;
+    for (uint32_t y = 0; y < height; y++) {
+        const uint32_t* pRow = pPixels + y * pixelPitch;
+        for (uint32_t x = 0; x < width; x++, pDst += 3) {
+            pDst[0] = uint8_t(pRow[x]);
+            pDst[1] = uint8_t(pRow[x] >> 8);
+            pDst[2] = uint8_t(pRow[x] >> 16);
+        }
+    }
+}
+
+// CRC-32 чанков PNG (полином 0xEDB88320)
+struct CrcTable {
+    uint32_t values[256];
+
+    CrcTable() {
+        for (uint32_t i = 0; i < 256; i++) {
+            uint32_t crc = i;
+            for (int bit = 0; bit < 8; bit++) {
+                crc = (crc & 1) ? 0xEDB88320u ^ (crc >> 1) : crc >> 1;
+            }
+            values[i] = crc;
+        }
+    }
+};
+
+uint32_t Crc32(const uint8_t* pData, size_t size) {
+    static const CrcTable table;
+    uint32_t crc = 0xFFFFFFFFu;
+    for (size_t i = 0; i < size; i++) {
+        crc = table.values[(crc ^ pData[i]) & 0xFF] ^ (crc >> 8);
+    }
+    return crc ^ 0xFFFFFFFFu;
+}
+
+// Поток zlib из несжатых блоков deflate (до 65535 байт) прямо в заранее выделенный файл
+class StoredDeflateWriter {
+public:
+    static const size_t kMaxBlockSize = 65535;
+
+    static size_t GetEncodedSize(size_t rawSize) {
+        const size_t blockCount = rawSize == 0 ? 1 : (rawSize + kMaxBlockSize - 1) / kMaxBlockSize;
+        // заголовок zlib, заголовки блоков, данные, Adler-32
+        return 2 + blockCount * 5 + rawSize + 4;
+    }
+
+    StoredDeflateWriter(uint8_t* pDst, size_t rawSize) : m_pDst(pDst), m_remaining(rawSize) {
+        // CMF: deflate, окно 32 КБ; FLG: без словаря, контрольная сумма (CMF * 256 + FLG) % 31 == 0
+        *m_pDst++ = 0x78;
+        *m_pDst++ = 0x01;
+        if (rawSize == 0) {
+            BeginBlock();
+        }
+    }
+
+    void Append(const uint8_t* pData, size_t size) {
+        UpdateAdler(pData, size);
+        while (size > 0) {
+            if (m_blockLeft == 0) {
+                BeginBlock();
+            }
+            const size_t count = size < m_blockLeft ? size : m_blockLeft;
+            memcpy(m_pDst, pData, count);
+            m_pDst += count;
+            pData += count;
+            size -= count;
+            m_blockLeft -= count;
+        }
+    }
+
+    // Возвращает конец потока
+    uint8_t* Finish() {
+        StoreBE32(m_pDst, (m_adlerB << 16) | m_adlerA);
+        return m_pDst + 4;
+    }
+
+private:
+    void BeginBlock() {
+        const size_t size = m_remaining < kMaxBlockSize ? m_remaining : kMaxBlockSize;
+        m_remaining -= size;
+        // BFINAL в последнем блоке, BTYPE = 00 (без сжатия), затем LEN и NLEN
+        *m_pDst++ = m_remaining == 0 ? 1 : 0;
+        const uint16_t length = static_cast<uint16_t>(size);
+        const uint16_t inverted = static_cast<uint16_t>(~length);
+        *m_pDst++ = uint8_t(length);
+        *m_pDst++ = uint8_t(length >> 8);
+        *m_pDst++ = uint8_t(inverted);
+        *m_pDst++ = uint8_t(inverted >> 8);
+        m_blockLeft = size;
+    }
+
+    void UpdateAdler(const uint8_t* pData, size_t size) {
+        // 5552 - наибольшая серия, после которой суммы еще не переполняют 32 бита
+        const size_t kChunk = 5552;
+        while (size > 0) {
+            const size_t count = size < kChunk ? size : kChunk;
+            for (size_t i = 0; i < count; i++) {
+                m_adlerA += pData[i];
+                m_adlerB += m_adlerA;
+            }
+            m_adlerA %= 65521;
+            m_adlerB %= 65521;
+            pData += count;
+            size -= count;
+        }
+    }
+
+    uint8_t* m_pDst;
+    size_t m_remaining;
+    size_t m_blockLeft = 0;
+    uint32_t m_adlerA = 1;
+    uint32_t m_adlerB = 0;
+};
+
+void EncodePng(const uint32_t* pPixels, uint32_t width, uint32_t height, size_t pixelPitch, std::vector<uint8_t>& file) {
+    // Строка - байт фильтра (0, без фильтра) и RGB
+    const size_t rowSize = 1 + static_cast<size_t>(width) * 3;
+    const size_t rawSize = rowSize * height;
+    const size_t idatSize = StoredDeflateWriter::GetEncodedSize(rawSize);
+
+    static const uint8_t kSignature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+    file.clear();
+    file.reserve(sizeof(kSignature) + 25 + 12 + idatSize + 12);
+    AppendBytes(file, kSignature, sizeof(kSignature));
+
+    // Чанк: длина, тип, данные, CRC типа и данных
+    auto appendChunk = [&file](const char* pType, const uint8_t* pData, size_t size) {
+        AppendBE32(file, static_cast<uint32_t>(size));
+        const size_t typeOffset = file.size();
+        AppendBytes(file, pType, 4);
+        AppendBytes(file, pData, size);
+        AppendBE32(file, Crc32(file.data() + typeOffset, size + 4));
+    };
+
+    uint8_t header[13];
+    StoreBE32(header, width);
+    StoreBE32(header + 4, height);
+    header[8] = 8;   // бит на канал
+    header[9] = 2;   // RGB
+    header[10] = 0;  // deflate
+    header[11] = 0;  // адаптивные фильтры
+    header[12] = 0;  // без чересстрочности
+    appendChunk("IHDR", header, sizeof(header));
+
+    // IDAT пишется на место, без промежуточного буфера всего изображения
+    AppendBE32(file, static_cast<uint32_t>(idatSize));
+    const size_t typeOffset = file.size();
+    AppendBytes(file, "IDAT", 4);
+    file.resize(file.size() + idatSize);
+    StoredDeflateWriter writer(file.data() + typeOffset + 4, rawSize);
+    std::vector<uint8_t> row(rowSize, 0);
+    for (uint32_t y = 0; y < height; y++) {
+        const uint32_t* pRow = pPixels + y * pixelPitch;
+        uint8_t* pDst = row.data() + 1;
+        for (uint32_t x = 0; x < width; x++, pDst += 3) {
+            pDst[0] = uint8_t(pRow[x]);
+            pDst[1] = uint8_t(pRow[x] >> 8);
+            pDst[2] = uint8_t(pRow[x] >> 16);
+        }
+        writer.Append(row.data(), rowSize);
+    }
+    writer.Finish();
+    AppendBE32(file, Crc32(file.data() + typeOffset, idatSize + 4));
+
+    appendChunk("IEND", nullptr, 0);
+}
+
+// float в half с округлением; бесконечности и NaN в кадре не встречаются
+uint16_t FloatToHalf(float value) {
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    const uint16_t sign = static_cast<uint16_t>((bits >> 16) & 0x8000);
+    const int32_t exponent = static_cast<int32_t>((bits >> 23) & 0xFF) - 127 + 15;
+    uint32_t mantissa = bits & 0x7FFFFF;
+    if (exponent >= 31) {
+        return sign | 0x7C00;
+    }
+    if (exponent <= 0) {
+        // Денормализованное half или ноль
+        if (exponent < -10) {
+            return sign;
+        }
+        mantissa |= 0x800000;
+        const uint32_t shift = static_cast<uint32_t>(14 - exponent);
+        return static_cast<uint16_t>(sign | ((mantissa + (1u << (shift - 1))) >> shift));
+    }
+    // Перенос при округлении мантиссы корректно увеличивает порядок
+    uint32_t half = (static_cast<uint32_t>(exponent) << 10) | (mantissa >> 13);
+    if (mantissa & 0x1000) {
+        half++;
+    }
+    return static_cast<uint16_t>(sign | half);
+}
+
+// sRGB-байт в линейный half
+struct SrgbToHalfTable {
+    uint16_t values[256];
+
+    SrgbToHalfTable() {
+        for (int i = 0; i < 256; i++) {
+            const float c = i / 255.0f;
+            const float linear = c <= 0.04045f ? c / 12.92f : powf((c + 0.055f) / 1.055f, 2.4f);
+            values[i] = FloatToHalf(linear);
+        }
+    }
+};
+
+void AppendAttribute(std::vector<uint8_t>& file, const char* pName, const char* pType, uint32_t size) {
+    AppendString(file, pName);
+    AppendString(file, pType);
+    AppendLE32(file, size);
+}
+
+void EncodeExr(const uint32_t* pPixels, uint32_t width, uint32_t height, size_t pixelPitch, std::vector<uint8_t>& file) {
+    static const SrgbToHalfTable table;
+    file.clear();
+    // Магическое число и версия 2, однослойный файл из строк
+    AppendLE32(file, 20000630);
+    AppendLE32(file, 2);
+
+    // Каналы в алфавитном порядке; HALF = 1, без линейного признака, шаг выборки 1
+    const char* const kChannels[3] = { "B", "G", "R" };
+    AppendAttribute(file, "channels", "chlist", 3 * (2 + 16) + 1);
+    for (const char* pChannel : kChannels) {
+        AppendString(file, pChannel);
+        AppendLE32(file, 1);
+        AppendLE32(file, 0);
+        AppendLE32(file, 1);
+        AppendLE32(file, 1);
+    }
+    file.push_back(0);
+
+    AppendAttribute(file, "compression", "compression", 1);
+    file.push_back(0);  // NO_COMPRESSION
+
+    for (const char* pWindow : { "dataWindow", "displayWindow" }) {
+        AppendAttribute(file, pWindow, "box2i", 16);
+        AppendLE32(file, 0);
+        AppendLE32(file, 0);
+        AppendLE32(file, width - 1);
+        AppendLE32(file, height - 1);
+    }
+
+    AppendAttribute(file, "lineOrder", "lineOrder", 1);
+    file.push_back(0);  // INCREASING_Y
+
+    const float one = 1.0f;
+    const float zero = 0.0f;
+    AppendAttribute(file, "pixelAspectRatio", "float", 4);
+    AppendBytes(file, &one, 4);
+    AppendAttribute(file, "screenWindowCenter", "v2f", 8);
+    AppendBytes(file, &zero, 4);
+    AppendBytes(file, &zero, 4);
+    AppendAttribute(file, "screenWindowWidth", "float", 4);
+    AppendBytes(file, &one, 4);
+    file.push_back(0);  // конец заголовка
+
+    // Таблица смещений строк, затем строки: номер, размер данных и каналы строки друг за другом
+    const uint32_t lineDataSize = width * 3 * sizeof(uint16_t);
+    const uint64_t firstLine = file.size() + static_cast<uint64_t>(height) * sizeof(uint64_t);
+    for (uint32_t y = 0; y < height; y++) {
+        AppendLE64(file, firstLine + static_cast<uint64_t>(y) * (8 + lineDataSize));
+    }
+    size_t offset = file.size();
+    file.resize(offset + static_cast<size_t>(height) * (8 + lineDataSize));
+    for (uint32_t y = 0; y < height; y++) {
+        uint8_t* pLine = file.data() + offset;
+        const uint32_t lineHeader[2] = { y, lineDataSize };
+        for (int i = 0; i < 2; i++) {
+            for (int b = 0; b < 4; b++) {
+                pLine[i * 4 + b] = uint8_t(lineHeader[i] >> (8 * b));
+            }
+        }
+        uint8_t* pChannel = pLine + 8;
+        const uint32_t* pRow = pPixels + y * pixelPitch;
+        // B - третий байт пикселя, G - второй, R - младший
+        for (int shift = 16; shift >= 0; shift -= 8) {
+            for (uint32_t x = 0; x < width; x++, pChannel += 2) {
+                const uint16_t half = table.values[(pRow[x] >> shift) & 0xFF];
+                pChannel[0] = uint8_t(half);
+                pChannel[1] = uint8_t(half >> 8);
+            }
+        }
+        offset += 8 + lineDataSize;
+    }
+}
+
+} // namespace
+
+const char* GetImageFormatName(ImageFormat format) {
+    switch (format) {
+    case ImageFormat::Ppm: return "ppm";
+    case ImageFormat::Png: return "png";
+    case ImageFormat::Exr: return "exr";
+    }
+    return "unknown";
+}
+
+const wchar_t* GetImageFileExtension(ImageFormat format) {
+    switch (format) {
+    case ImageFormat::Ppm: return L".ppm";
+    case ImageFormat::Png: return L".png";
+    case ImageFormat::Exr: return L".exr";
+    }
+    return L"";
+}
+
+bool ParseImageFormat(const char* pName, ImageFormat& format) {
+    for (ImageFormat candidate : { ImageFormat::Ppm, ImageFormat::Png, ImageFormat::Exr }) {
+        if (strcmp(pName, GetImageFormatName(candidate)) == 0) {
+            format = candidate;
+            return true;
+        }
+    }
+    return false;
+}
+
+bool ParseImageFormat(const wchar_t* pName, ImageFormat& format) {
+    char name[8] = {};
+    for (size_t i = 0; i + 1 < sizeof(name) && pName[i]; i++) {
+        if (pName[i] > 0x7F) {
+            return false;
+        }
+        name[i] = static_cast<char>(pName[i]);
+    }
+    return wcslen(pName) < sizeof(name) && ParseImageFormat(name, format);
+}
+
+void EncodeImage(ImageFormat format, const uint32_t* pPixels, uint32_t width, uint32_t height, size_t pixelPitch,
+    std::vector<uint8_t>& file) {
+    switch (format) {
+    case ImageFormat::Ppm:
+        EncodePpm(pPixels, width, height, pixelPitch, file);
+        break;
+    case ImageFormat::Png:
+        EncodePng(pPixels, width, height, pixelPitch, file);
+        break;
+    case ImageFormat::Exr:
+        EncodeExr(pPixels, width, height, pixelPitch, file);
+        break;
+    }
+}
+
+bool WriteImage(const std::wstring& filePath, ImageFormat format, const uint32_t* pPixels, uint32_t width, uint32_t height,
+    size_t pixelPitch, std::vector<uint8_t>& file) {
+    EncodeImage(format, pPixels, width, height, pixelPitch, file);
+    return WriteWholeFile(filePath, file.data(), file.size());
+}
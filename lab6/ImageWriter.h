@@ -0,0 +1,33 @@
+﻿#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Запись кадров RGBA8 (R в младшем байте, как цветовой буфер SoftwareRasterizer) в файлы
+// без сторонних библиотек:
+// PPM - двоичный P6, RGB 8 бит;
+// PNG - RGB 8 бит, deflate из несжатых блоков (кодирование - одно копирование, файл в размер PPM);
+// EXR - несжатые строки, каналы B, G, R в half. Кадр хранится в sRGB, в EXR пишется линейный цвет.
+// Альфа-канал не записывается.
+
+enum class ImageFormat {
+    Ppm,
+    Png,
+    Exr,
+};
+
+const char* GetImageFormatName(ImageFormat format);
+// Расширение с точкой: L".ppm"
+const wchar_t* GetImageFileExtension(ImageFormat format);
+// "ppm", "png", "exr"; false для неизвестного имени
+bool ParseImageFormat(const char* pName, ImageFormat& format);
+bool ParseImageFormat(const wchar_t* pName, ImageFormat& format);
+
+// Файл целиком в file (буфер можно переиспользовать между кадрами). pixelPitch - шаг строки в пикселях
+void EncodeImage(ImageFormat format, const uint32_t* pPixels, uint32_t width, uint32_t height, size_t pixelPitch,
+    std::vector<uint8_t>& file);
+
+// EncodeImage и WriteWholeFile (FileIO.h)
+bool WriteImage(const std::wstring& filePath, ImageFormat format, const uint32_t* pPixels, uint32_t width, uint32_t height,
+    size_t pixelPitch, std::vector<uint8_t>& file);
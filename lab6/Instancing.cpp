@@ -0,0 +1,260 @@
+﻿#include "Instancing.h"
+#include "ThreadPool.h"
+#include "TransformBatch.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <random>
+
+DirectX::XMMATRIX ComputeNormalMatrix(DirectX::FXMMATRIX model) {
+    return DirectX::XMMatrixTranspose(DirectX::XMMatrixInverse(nullptr, model));
+}
+
+void InstanceBatch::Reset(const uint32_t* pInstanceCounts, uint32_t meshCount) {
+    m_ranges.resize(meshCount);
+    uint32_t total = 0;
+    for (uint32_t mesh = 0; mesh < meshCount; mesh++) {
+        m_ranges[mesh].first = total;
+        m_ranges[mesh].count = pInstanceCounts[mesh];
+        total += pInstanceCounts[mesh];
+    }
+    m_instances.resize(total);
+}
+
+void InstanceBatch::SetInstance(uint32_t mesh, uint32_t index, DirectX::FXMMATRIX model) {
+    InstanceData& instance = m_instances[m_ranges[mesh].first + index];
+    instance.model = model;
+    instance.normalMatrix = ComputeNormalMatrix(model);
+}
+
+void InstanceBatch::SetInstance(uint32_t mesh, uint32_t index, DirectX::FXMMATRIX model, DirectX::CXMMATRIX normalMatrix) {
+    InstanceData& instance = m_instances[m_ranges[mesh].first + index];
+    instance.model = model;
+    instance.normalMatrix = normalMatrix;
+}
+
+void CubeField::Generate(uint32_t cubeCount, uint32_t meshCount, float spacing, float height, uint32_t seed) {
+    m_x.resize(cubeCount);
+    m_z.resize(cubeCount);
+    m_scale.resize(cubeCount);
+    m_axis.resize(cubeCount);
+    m_speed.resize(cubeCount);
+    m_bounds.Resize(cubeCount);
+    m_height = height;
+
+    // Кубы поровну между сетками, остаток - первым сеткам
+    meshCount = meshCount > 0 ? meshCount : 1;
+    m_meshCounts.assign(meshCount, cubeCount / meshCount);
+    for (uint32_t mesh = 0; mesh < cubeCount % meshCount; mesh++) {
+        m_meshCounts[mesh]++;
+    }
+
+    // Квадратная сетка с центром в начале координат
+    const uint32_t side = static_cast<uint32_t>(std::ceil(std::sqrt(static_cast<double>(cubeCount))));
+    const float origin = -0.5f * spacing * static_cast<float>(side > 0 ? side - 1 : 0);
+    std::mt19937 random(seed);
+    std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+    for (uint32_t i = 0; i < cubeCount; i++) {
+        m_x[i] = origin + spacing * static_cast<float>(i % side);
+        m_z[i] = origin + spacing * static_cast<float>(i / side);
+        m_scale[i] = spacing * (0.3f + 0.3f * unit(random));
+
+        DirectX::XMFLOAT3 axis(unit(random) - 0.5f, unit(random) - 0.5f, unit(random) - 0.5f);
+        DirectX::XMVECTOR axisVector = DirectX::XMVector3Normalize(DirectX::XMVectorSet(axis.x, axis.y, axis.z + 1e-3f, 0.0f));
+        DirectX::XMStoreFloat4(&m_axis[i], DirectX::XMVectorSetW(axisVector, DirectX::XM_2PI * unit(random)));
+        m_speed[i] = 0.5f + 1.5f * unit(random);
+        // Половина диагонали единичного куба
+        m_bounds.Set(i, DirectX::XMFLOAT3(m_x[i], height, m_z[i]), 0.8660254f * m_scale[i]);
+    }
+}
+
+uint32_t CubeField::GetMeshFirst(uint32_t mesh) const {
+    uint32_t first = 0;
+    for (uint32_t i = 0; i < mesh; i++) {
+        first += m_meshCounts[i];
+    }
+    return first;
+}
+
+void CubeField::CountMeshCubes(const uint32_t* pCubes, uint32_t cubeCount, uint32_t* pMeshCounts) const {
+    if (!pCubes) {
+        std::copy(m_meshCounts.begin(), m_meshCounts.end(), pMeshCounts);
+        return;
+    }
+    // Список возрастает, а кубы сеток идут подряд - границы сеток находятся двоичным поиском
+    const uint32_t* pBegin = pCubes;
+    const uint32_t* pEnd = pCubes + cubeCount;
+    uint32_t meshEnd = 0;
+    for (uint32_t mesh = 0; mesh < GetMeshCount(); mesh++) {
+        meshEnd += m_meshCounts[mesh];
+        const uint32_t* pMeshEnd = std::lower_bound(pBegin, pEnd, meshEnd);
+        pMeshCounts[mesh] = static_cast<uint32_t>(pMeshEnd - pBegin);
+        pBegin = pMeshEnd;
+    }
+}
+
+DirectX::XMMATRIX CubeField::GetModel(uint32_t cube, double time) const {
+    const DirectX::XMFLOAT4& axis = m_axis[cube];
+    // Угол приводится к [0, 2pi) в double, чтобы не терять точность при большом time
+    const float angle = static_cast<float>(std::fmod(axis.w + m_speed[cube] * time, 2.0 * DirectX::XM_PI));
+
+    // Масштаб, поворот и перенос без перемножения трех матриц
+    DirectX::XMMATRIX model = DirectX::XMMatrixRotationNormal(DirectX::XMVectorSet(axis.x, axis.y, axis.z, 0.0f), angle);
+    const DirectX::XMVECTOR scale = DirectX::XMVectorReplicate(m_scale[cube]);
+    model.r[0] = DirectX::XMVectorMultiply(model.r[0], scale);
+    model.r[1] = DirectX::XMVectorMultiply(model.r[1], scale);
+    model.r[2] = DirectX::XMVectorMultiply(model.r[2], scale);
+    model.r[3] = DirectX::XMVectorSet(m_x[cube], m_height, m_z[cube], 1.0f);
+    return model;
+}
+
+void CubeField::GetInstance(uint32_t cube, double time, InstanceData& instance) const {
+    instance.model = GetModel(cube, time);
+    const DirectX::XMVECTOR inverseScaleSq = DirectX::XMVectorReplicate(1.0f / (m_scale[cube] * m_scale[cube]));
+    instance.normalMatrix.r[0] = DirectX::XMVectorMultiply(instance.model.r[0], inverseScaleSq);
+    instance.normalMatrix.r[1] = DirectX::XMVectorMultiply(instance.model.r[1], inverseScaleSq);
+    instance.normalMatrix.r[2] = DirectX::XMVectorMultiply(instance.model.r[2], inverseScaleSq);
+    instance.normalMatrix.r[3] = DirectX::XMVectorSet(0.0f, 0.0f, 0.0f, 1.0f);
+}
+
+void CubeField::FillInstances(double time, const uint32_t* pCubes, uint32_t cubeCount, InstanceData* pInstances, ThreadPool* pThreadPool) const {
+    if (!pCubes) {
+        cubeCount = GetCubeCount();
+    }
+    // Повороты кубов порциями переводятся в кватернионы на стеке, матрицы считаются пакетом
+    const CullPath path = GetBestCullPath();
+    auto fill = [this, time, pCubes, pInstances, path](uint32_t begin, uint32_t end) {
+        const uint32_t kChunkSize = 256;
+        float fields[8][kChunkSize];
+        const TransformStreams streams = { fields[0], fields[1], fields[2], fields[3], fields[4], fields[5], fields[6], fields[7] };
+        for (uint32_t first = begin; first < end; first += kChunkSize) {
+            const uint32_t count = end - first < kChunkSize ? end - first : kChunkSize;
+            for (uint32_t k = 0; k < count; k++) {
+                const uint32_t cube = pCubes ? pCubes[first + k] : first + k;
+                const DirectX::XMFLOAT4& axis = m_axis[cube];
+                const float angle = static_cast<float>(std::fmod(axis.w + m_speed[cube] * time, 2.0 * DirectX::XM_PI));
+                float sinHalf = 0.0f;
+                float cosHalf = 0.0f;
+                DirectX::XMScalarSinCos(&sinHalf, &cosHalf, 0.5f * angle);
+                fields[0][k] = axis.x * sinHalf;
+                fields[1][k] = axis.y * sinHalf;
+                fields[2][k] = axis.z * sinHalf;
+                fields[3][k] = cosHalf;
+                fields[4][k] = m_scale[cube];
+                fields[5][k] = m_x[cube];
+                fields[6][k] = m_height;
+                fields[7][k] = m_z[cube];
+            }
+            ComputeTransformBatch(streams, count, DirectX::XMMatrixIdentity(), pInstances + first, nullptr, path);
+        }
+    };
+    if (pThreadPool) {
+        pThreadPool->ParallelFor(cubeCount, 4096, fill);
+    }
+    else {
+        fill(0, cubeCount);
+    }
+}
+
+void NullSceneDrawBackend::BeginFrame() {
+    m_constantCount = 0;
+}
+
+void NullSceneDrawBackend::DrawObject(uint32_t mesh, const GeomBuffer& geom) {
+    (void)mesh;
+    if (m_constantCount == m_constants.size()) {
+        m_constants.resize(m_constants.size() * 2 + 64);
+    }
+    m_constants[m_constantCount++] = geom;
+}
+
+void NullSceneDrawBackend::DrawBatch(const GeomBuffer& camera, const InstanceBatch& batch) {
+    DrawObject(0, camera);
+    if (m_instanceBuffer.size() < batch.GetInstanceCount()) {
+        m_instanceBuffer.resize(batch.GetInstanceCount());
+    }
+    memcpy(m_instanceBuffer.data(), batch.GetData(), batch.GetInstanceCount() * sizeof(InstanceData));
+}
+
+void SubmitPerObject(const CubeField& field, double time, const GeomBuffer& camera, ISceneDrawBackend& backend,
+    const uint32_t* pCubes, uint32_t cubeCount) {
+    std::vector<uint32_t> meshCounts(field.GetMeshCount());
+    field.CountMeshCubes(pCubes, cubeCount, meshCounts.data());
+
+    GeomBuffer geom = camera;
+    InstanceData instance;
+    uint32_t index = 0;
+    for (uint32_t mesh = 0; mesh < field.GetMeshCount(); mesh++) {
+        const uint32_t end = index + meshCounts[mesh];
+        for (; index < end; index++) {
+            field.GetInstance(pCubes ? pCubes[index] : index, time, instance);
+            geom.model = instance.model;
+            geom.normalMatrix = instance.normalMatrix;
+            backend.DrawObject(mesh, geom);
+        }
+    }
+}
+
+void SubmitInstanced(const CubeField& field, double time, const GeomBuffer& camera, InstanceBatch& batch,
+    ISceneDrawBackend& backend, ThreadPool* pThreadPool, const uint32_t* pCubes, uint32_t cubeCount) {
+    std::vector<uint32_t> meshCounts(field.GetMeshCount());
+    field.CountMeshCubes(pCubes, cubeCount, meshCounts.data());
+    batch.Reset(meshCounts.data(), field.GetMeshCount());
+    field.FillInstances(time, pCubes, cubeCount, batch.GetData(), pThreadPool);
+    backend.DrawBatch(camera, batch);
+}
+
+std::vector<InstancingBenchmarkResult> RunInstancingBenchmark(ISceneDrawBackend& backend, uint32_t cubeCount, uint32_t meshCount,
+    uint32_t frameCount, ThreadPool* pThreadPool) {
+    CubeField field;
+    field.Generate(cubeCount, meshCount, 1.5f, 0.0f);
+
+    GeomBuffer camera = {};
+    camera.view = DirectX::XMMatrixLookAtLH(DirectX::XMVectorSet(0.0f, 50.0f, -100.0f, 0.0f),
+        DirectX::XMVectorZero(), DirectX::XMVectorSet(0.0f, 1.0f, 0.0f, 0.0f));
+    camera.projection = DirectX::XMMatrixPerspectiveFovLH(DirectX::XM_PI / 3.0f, 1280.0f / 720.0f, 0.1f, 1000.0f);
+
+    uint64_t meshDrawCount = 0;
+    for (uint32_t mesh = 0; mesh < field.GetMeshCount(); mesh++) {
+        meshDrawCount += field.GetMeshCounts()[mesh] > 0 ? 1 : 0;
+    }
+
+    InstanceBatch batch;
+    std::vector<InstancingBenchmarkResult> results;
+    auto measure = [&](const char* name, unsigned threadCount, uint64_t drawCalls, uint64_t bytes, auto submit) {
+        // Первый кадр - прогрев: выделение памяти под массивы экземпляров не входит в замер
+        backend.BeginFrame();
+        submit(0.0);
+        const auto startTime = std::chrono::steady_clock::now();
+        for (uint32_t frame = 0; frame < frameCount; frame++) {
+            backend.BeginFrame();
+            submit(frame / 60.0);
+        }
+        const double elapsed = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - startTime).count();
+
+        InstancingBenchmarkResult result;
+        result.name = name;
+        result.threadCount = threadCount;
+        result.millisecondsPerFrame = frameCount > 0 ? elapsed / frameCount : 0.0;
+        result.drawCallsPerFrame = drawCalls;
+        result.bytesPerFrame = bytes;
+        results.push_back(result);
+    };
+
+    const uint64_t perObjectBytes = uint64_t(cubeCount) * sizeof(GeomBuffer);
+    const uint64_t instancedBytes = sizeof(GeomBuffer) + uint64_t(cubeCount) * sizeof(InstanceData);
+    measure("per-object", 1, cubeCount, perObjectBytes, [&](double time) {
+        SubmitPerObject(field, time, camera, backend);
+    });
+    measure("instanced", 1, meshDrawCount, instancedBytes, [&](double time) {
+        SubmitInstanced(field, time, camera, batch, backend, nullptr);
+    });
+    if (pThreadPool) {
+        measure("instanced", pThreadPool->GetThreadCount(), meshDrawCount, instancedBytes, [&](double time) {
+            SubmitInstanced(field, time, camera, batch, backend, pThreadPool);
+        });
+    }
+    return results;
+}
@@ -0,0 +1,141 @@
+﻿#pragma once
+
+#include <cstdint>
+#include <vector>
+#include <DirectXMath.h>
+#include "SceneTypes.h"
+#include "FrustumCulling.h"
+
+class ThreadPool;
+
+// Отрисовка многих одинаковых объектов с инстансингом. Вместо своего GeomBuffer,
+// UpdateSubresource и DrawIndexed на каждый куб матрицы всех экземпляров кадра лежат
+// в одном непрерывном массиве (одна загрузка в вершинный буфер), а на каждую сетку
+// приходится один вызов отрисовки. Вид и проекция общие и передаются один раз.
+
+// Данные одного экземпляра. Матрицы выровнены на 16 байт и хранятся строками, как XMMATRIX,
+// поэтому заполняются векторными записями и копируются в буфер без перестановок.
+struct InstanceData {
+    DirectX::XMMATRIX model;
+    DirectX::XMMATRIX normalMatrix; // транспонированная обратная к model
+};
+
+DirectX::XMMATRIX ComputeNormalMatrix(DirectX::FXMMATRIX model);
+
+// Экземпляры одной сетки в общем массиве
+struct InstanceRange {
+    uint32_t first = 0;
+    uint32_t count = 0;
+};
+
+// Экземпляры всех сеток кадра, сгруппированные по сеткам: диапазон сетки задает
+// StartInstanceLocation и число экземпляров ее вызова отрисовки.
+class InstanceBatch {
+public:
+    // Разметка массива: pInstanceCounts[mesh] экземпляров каждой сетки. Память переиспользуется между кадрами.
+    void Reset(const uint32_t* pInstanceCounts, uint32_t meshCount);
+
+    void SetInstance(uint32_t mesh, uint32_t index, DirectX::FXMMATRIX model);
+    // Матрица нормалей уже посчитана (TransformSet) - без обращения
+    void SetInstance(uint32_t mesh, uint32_t index, DirectX::FXMMATRIX model, DirectX::CXMMATRIX normalMatrix);
+
+    InstanceData* GetData() { return m_instances.data(); }
+    const InstanceData* GetData() const { return m_instances.data(); }
+    InstanceData* GetMeshInstances(uint32_t mesh) { return m_instances.data() + m_ranges[mesh].first; }
+    uint32_t GetInstanceCount() const { return static_cast<uint32_t>(m_instances.size()); }
+    uint32_t GetMeshCount() const { return static_cast<uint32_t>(m_ranges.size()); }
+    const InstanceRange& GetMeshRange(uint32_t mesh) const { return m_ranges[mesh]; }
+
+private:
+    std::vector<InstanceData> m_instances;
+    std::vector<InstanceRange> m_ranges;
+};
+
+// Поле вращающихся кубов на сетке в плоскости XZ. Параметры кубов хранятся по полям (SoA),
+// кубы одной сетки идут подряд, поэтому порядок кубов совпадает с порядком экземпляров в InstanceBatch.
+// Списки кубов (pCubes) - возрастающие номера, например результат CullSpheres по GetBounds();
+// nullptr - все кубы.
+class CubeField {
+public:
+    void Generate(uint32_t cubeCount, uint32_t meshCount, float spacing, float height, uint32_t seed = 1);
+
+    uint32_t GetCubeCount() const { return static_cast<uint32_t>(m_x.size()); }
+    uint32_t GetMeshCount() const { return static_cast<uint32_t>(m_meshCounts.size()); }
+    const uint32_t* GetMeshCounts() const { return m_meshCounts.data(); }
+    uint32_t GetMeshFirst(uint32_t mesh) const;
+    // Описанные сферы кубов: куб вращается на месте, поэтому сфера не меняется
+    const SphereBounds& GetBounds() const { return m_bounds; }
+    // Число кубов каждой сетки в списке
+    void CountMeshCubes(const uint32_t* pCubes, uint32_t cubeCount, uint32_t* pMeshCounts) const;
+
+    // Матрица мира куба в момент time (секунды)
+    DirectX::XMMATRIX GetModel(uint32_t cube, double time) const;
+    // Матрица мира и матрица нормалей. Куб только поворачивается и равномерно масштабируется,
+    // поэтому матрица нормалей - та же матрица, деленная на квадрат масштаба, без обращения.
+    // Перенос в ней не учитывается: шейдер берет только ее часть 3x3.
+    void GetInstance(uint32_t cube, double time, InstanceData& instance) const;
+
+    // Экземпляры кубов из списка подряд, начиная с pInstances: матрицы считаются пакетом
+    // (ComputeTransformBatch); с пулом - параллельно по диапазонам
+    void FillInstances(double time, const uint32_t* pCubes, uint32_t cubeCount, InstanceData* pInstances, ThreadPool* pThreadPool) const;
+
+private:
+    std::vector<float> m_x;
+    std::vector<float> m_z;
+    std::vector<float> m_scale;
+    std::vector<DirectX::XMFLOAT4> m_axis; // ось вращения (xyz) и начальный угол (w)
+    std::vector<float> m_speed;
+    std::vector<uint32_t> m_meshCounts;
+    float m_height = 0.0f;
+    SphereBounds m_bounds;
+};
+
+// Куда уходят кубы кадра. Рендер реализует его поверх D3D11, NullSceneDrawBackend
+// только копирует данные, как это делают UpdateSubresource и Map, - для замеров без устройства,
+// в которые поэтому не входит стоимость вызовов драйвера.
+class ISceneDrawBackend {
+public:
+    virtual ~ISceneDrawBackend() = default;
+
+    virtual void BeginFrame() {}
+
+    // Путь по объектам: свой GeomBuffer и свой вызов отрисовки на каждый объект
+    virtual void DrawObject(uint32_t mesh, const GeomBuffer& geom) = 0;
+    // Путь с инстансингом: view и projection из camera, все экземпляры одной загрузкой, вызов на сетку
+    virtual void DrawBatch(const GeomBuffer& camera, const InstanceBatch& batch) = 0;
+};
+
+// Константы каждого DrawObject копируются в поток кадра, как UpdateSubresource в командный
+// буфер драйвера; экземпляры DrawBatch - в отдельный буфер, как при Map с WRITE_DISCARD.
+class NullSceneDrawBackend : public ISceneDrawBackend {
+public:
+    void BeginFrame() override;
+    void DrawObject(uint32_t mesh, const GeomBuffer& geom) override;
+    void DrawBatch(const GeomBuffer& camera, const InstanceBatch& batch) override;
+
+private:
+    std::vector<GeomBuffer> m_constants;
+    size_t m_constantCount = 0;
+    std::vector<InstanceData> m_instanceBuffer;
+};
+
+// Кадр поля кубов по объектам: GeomBuffer с матрицами камеры (view, projection) из camera
+void SubmitPerObject(const CubeField& field, double time, const GeomBuffer& camera, ISceneDrawBackend& backend,
+    const uint32_t* pCubes = nullptr, uint32_t cubeCount = 0);
+
+// Кадр поля кубов с инстансингом: batch заполняется заново (с пулом - параллельно)
+void SubmitInstanced(const CubeField& field, double time, const GeomBuffer& camera, InstanceBatch& batch,
+    ISceneDrawBackend& backend, ThreadPool* pThreadPool, const uint32_t* pCubes = nullptr, uint32_t cubeCount = 0);
+
+struct InstancingBenchmarkResult {
+    const char* name = "";
+    unsigned threadCount = 1;
+    double millisecondsPerFrame = 0;
+    uint64_t drawCallsPerFrame = 0;
+    uint64_t bytesPerFrame = 0;
+};
+
+// Замер подготовки кадра на CPU для поля из cubeCount кубов: по объектам, с инстансингом
+// в одном потоке и, если передан пул, с инстансингом в пуле. С NullSceneDrawBackend работает без D3D.
+std::vector<InstancingBenchmarkResult> RunInstancingBenchmark(ISceneDrawBackend& backend, uint32_t cubeCount, uint32_t meshCount,
+    uint32_t frameCount, ThreadPool* pThreadPool);
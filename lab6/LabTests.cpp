@@ -0,0 +1,631 @@
+﻿#include "LabTests.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+#include "DdsFile.h"
+#include "FileIO.h"
+#include "PackedVertex.h"
+#include "ReportWriter.h"
+#include "SceneMeshes.h"
+#include "ShaderCache.h"
+#include "TextureCache.h"
+#include "TextureStreamer.h"
+#include "UploadRing.h"
+
+namespace {
+
+// Отчет одной проверки: строки и признак ошибки
+class TestLog : public ReportWriter {
+public:
+    // Ошибка с причиной; проверка продолжается, чтобы в отчет попали все расхождения
+    bool Check(bool condition, const char* pWhat) {
+        if (!condition) {
+            Print("  failed: %s\n", pWhat);
+            m_failed = true;
+        }
+        return condition;
+    }
+
+    bool HasFailed() const { return m_failed; }
+
+private:
+    bool m_failed = false;
+};
+
+// Временные файлы проверок - в текущем каталоге, имена ASCII (одинаковы в char и wchar_t)
+std::wstring WidenAscii(const char* pText) {
+    return std::wstring(pText, pText + strlen(pText));
+}
+
+uint32_t GetMipLevelCount(uint32_t size) {
+    uint32_t mipLevels = 1;
+    for (; size > 1; size >>= 1) {
+        mipLevels++;
+    }
+    return mipLevels;
+}
+
+void PutU32(std::vector<uint8_t>& file, size_t offset, uint32_t value) {
+    memcpy(&file[offset], &value, sizeof(value));
+}
+
+// Заголовок DDS R8G8B8A8_UNORM с расширением DX10 (смещения - от начала файла, с "DDS ")
+std::vector<uint8_t> MakeTestDdsHeader(uint32_t width, uint32_t height, uint32_t mipLevels, uint32_t arraySize) {
+    std::vector<uint8_t> file(4 + 124 + 20, 0);
+    PutU32(file, 0, 0x20534444);                         // "DDS "
+    PutU32(file, 4, 124);                                // dwSize
+    PutU32(file, 8, 0x1 | 0x2 | 0x4 | 0x1000 | 0x20000); // CAPS | HEIGHT | WIDTH | PIXELFORMAT | MIPMAPCOUNT
+    PutU32(file, 12, height);
+    PutU32(file, 16, width);
+    PutU32(file, 28, mipLevels);
+    PutU32(file, 76, 32);                                // ddspf.dwSize
+    PutU32(file, 80, 0x4);                               // DDPF_FOURCC
+    PutU32(file, 84, 0x30315844);                        // "DX10"
+    PutU32(file, 128, 28);                               // DXGI_FORMAT_R8G8B8A8_UNORM
+    PutU32(file, 132, 3);                                // D3D10_RESOURCE_DIMENSION_TEXTURE2D
+    PutU32(file, 140, arraySize);
+    return file;
+}
+
+// DDS R8G8B8A8_UNORM (заголовок DX10) с полной mip-цепочкой; байты уровня mip - его номер
+bool WriteTestDds(const char* pPath, uint32_t width, uint32_t height) {
+    const uint32_t mipLevels = GetMipLevelCount((std::max)(width, height));
+    std::vector<uint8_t> file = MakeTestDdsHeader(width, height, mipLevels, 1);
+    for (uint32_t mip = 0; mip < mipLevels; mip++) {
+        const uint32_t w = (std::max)(width >> mip, 1u);
+        const uint32_t h = (std::max)(height >> mip, 1u);
+        file.insert(file.end(), static_cast<size_t>(w) * h * 4, static_cast<uint8_t>(mip));
+    }
+    return WriteWholeFile(WidenAscii(pPath), file.data(), file.size());
+}
+
+// Подресурсы разобранного файла: размеры уровней, шаг строки и отрезки данных внутри файла, подряд без дыр
+void CheckDdsSubresources(TestLog& log, const DdsFile& file) {
+    const uint8_t* pBegin = file.GetFileData();
+    const uint8_t* pEnd = pBegin + file.GetFileSize();
+    const uint8_t* pNext = nullptr;
+    const uint32_t bytesPerBlock = DdsFile::GetBytesPerBlock(file.GetFormat());
+    bool inside = true;
+    bool contiguous = true;
+    bool pitchValid = true;
+    bool sizeValid = true;
+    for (uint32_t item = 0; item < file.GetArraySize(); item++) {
+        for (uint32_t mip = 0; mip < file.GetMipLevels(); mip++) {
+            const DdsSubresource& sub = file.GetSubresource(mip, item);
+            inside = inside && sub.pData >= pBegin + 128 && sub.pData <= pEnd && sub.size <= static_cast<size_t>(pEnd - sub.pData);
+            contiguous = contiguous && (!pNext || sub.pData == pNext);
+            pNext = sub.pData + sub.size;
+            const uint32_t width = (std::max)(file.GetWidth() >> mip, 1u);
+            const uint32_t height = (std::max)(file.GetHeight() >> mip, 1u);
+            sizeValid = sizeValid && sub.width == width && sub.height == height;
+            const uint32_t rowPitch = file.IsBlockCompressed() ? (width + 3) / 4 * bytesPerBlock : width * bytesPerBlock;
+            const uint32_t rowCount = file.IsBlockCompressed() ? (height + 3) / 4 : height;
+            pitchValid = pitchValid && sub.rowPitch == rowPitch && sub.rowCount == rowCount &&
+                sub.size == static_cast<size_t>(rowPitch) * rowCount;
+        }
+    }
+    log.Check(file.GetSubresourceCount() == file.GetArraySize() * file.GetMipLevels(), "subresource count");
+    log.Check(inside, "subresource outside the mapping");
+    log.Check(contiguous, "subresources are not contiguous");
+    log.Check(sizeValid, "mip size");
+    log.Check(pitchValid, "row pitch or row count");
+}
+
+// Устройство для TextureStreamer, которое только записывает вызовы
+class RecordingUploadTarget : public ITextureUploadTarget {
+public:
+    struct Upload {
+        uint32_t handle;
+        uint32_t item;
+        uint32_t mip;
+        size_t size;
+        uint8_t firstByte;
+    };
+
+    struct Texture {
+        bool created = false;
+        uint32_t width = 0;
+        uint32_t height = 0;
+        uint32_t mipLevels = 0;
+        uint32_t arraySize = 0;
+        bool cubemap = false;
+        uint32_t mostDetailedMip = 0;
+        uint32_t mipChanges = 0;
+        bool mipOrderBroken = false; // самый детальный уровень не уменьшался на единицу
+    };
+
+    // CreateTexture с этим дескриптором завершается ошибкой
+    uint32_t failHandle = TextureStreamer::InvalidHandle;
+    std::vector<Texture> textures;
+    std::vector<Upload> uploads;
+
+    bool CreateTexture(uint32_t handle, uint32_t width, uint32_t height, uint32_t mipLevels,
+        uint32_t arraySize, bool cubemap, uint32_t format) override {
+        if (handle == failHandle || format != 28) {
+            return false;
+        }
+        Texture& texture = Get(handle);
+        texture.created = true;
+        texture.width = width;
+        texture.height = height;
+        texture.mipLevels = mipLevels;
+        texture.arraySize = arraySize;
+        texture.cubemap = cubemap;
+        texture.mostDetailedMip = mipLevels;
+        return true;
+    }
+
+    void UploadMip(uint32_t handle, uint32_t item, uint32_t mip, const DdsSubresource& data) override {
+        uploads.push_back(Upload{ handle, item, mip, data.size, data.size > 0 ? data.pData[0] : uint8_t(0xFF) });
+    }
+
+    void SetMostDetailedMip(uint32_t handle, uint32_t mip) override {
+        Texture& texture = Get(handle);
+        texture.mipOrderBroken = texture.mipOrderBroken || mip + 1 != texture.mostDetailedMip;
+        texture.mostDetailedMip = mip;
+        texture.mipChanges++;
+    }
+
+private:
+    Texture& Get(uint32_t handle) {
+        if (handle >= textures.size()) {
+            textures.resize(handle + 1);
+        }
+        return textures[handle];
+    }
+};
+
+// Текстуры lab6 (BC1 1024x1024, полная mip-цепочка) разбираются прямо в отображении файла, а испорченные
+// заголовки отклоняются: обрезанный файл, чужая сигнатура, неверное расширение DX10, неполный куб,
+// размер больше 16384 и массив больше 2048 элементов
+bool TestDdsFile(TestLog& log) {
+    const char* const assetNames[] = { "texture.dds", "normal_map.dds", "space.dds" };
+    std::vector<uint8_t> asset;
+    for (const char* pName : assetNames) {
+        DdsFile file;
+        if (!file.Open(std::string(pName))) {
+            log.Print("  %s: %s\n", pName, file.GetErrorMessage().c_str());
+            log.Check(false, "bundled texture does not open");
+            continue;
+        }
+        log.Print("  %-16s format %u, %ux%u, %u mips, %zu bytes\n", pName, file.GetFormat(), file.GetWidth(), file.GetHeight(),
+            file.GetMipLevels(), file.GetFileSize());
+        log.Check(file.GetFormat() == DdsFormat::BC1_UNORM && file.IsBlockCompressed(), "format");
+        log.Check(file.GetWidth() == 1024 && file.GetHeight() == 1024, "size");
+        log.Check(file.GetMipLevels() == 11 && file.GetArraySize() == 1 && !file.IsCubemap(), "mip levels");
+        CheckDdsSubresources(log, file);
+        // Последний уровень кончается ровно в конце файла
+        const DdsSubresource& last = file.GetSubresource(file.GetMipLevels() - 1);
+        log.Check(last.pData + last.size == file.GetFileData() + file.GetFileSize(), "data size");
+        if (asset.empty()) {
+            asset.assign(file.GetFileData(), file.GetFileData() + file.GetFileSize());
+        }
+    }
+    if (asset.empty()) {
+        return false;
+    }
+
+    // Отказ должен быть по своей причине: без проверок пределов те же заголовки отклоняются как обрезанные
+    struct Case {
+        const char* name;
+        std::vector<uint8_t> file;
+        const char* error;
+    };
+    std::vector<Case> rejected;
+    auto add = [&rejected](const char* pName, std::vector<uint8_t> file, const char* pError) {
+        rejected.push_back(Case{ pName, std::move(file), pError });
+    };
+
+    add("truncated data", std::vector<uint8_t>(asset.begin(), asset.end() - 1), "DDS file is truncated");
+    add("truncated header", std::vector<uint8_t>(asset.begin(), asset.begin() + 100), "not a DDS file");
+    std::vector<uint8_t> file = asset;
+    file[3] = 'X';
+    add("bad magic", file, "not a DDS file");
+    file = asset;
+    PutU32(file, 4, 100);
+    add("bad header size", file, "invalid DDS header size");
+
+    // Расширение DX10: обрезанное, не 2D-текстура, пустой массив, неизвестный формат
+    const std::vector<uint8_t> dx10 = MakeTestDdsHeader(4, 4, 1, 1);
+    add("truncated DX10 header", std::vector<uint8_t>(dx10.begin(), dx10.begin() + 140), "truncated DX10 header");
+    file = dx10;
+    PutU32(file, 132, 4);
+    add("DX10 3D texture", file, "only 2D textures are supported");
+    file = dx10;
+    PutU32(file, 140, 0);
+    add("DX10 zero array size", file, "DX10 header has zero array size");
+    file = dx10;
+    PutU32(file, 128, 2);
+    add("DX10 unsupported format", file, "unsupported pixel format");
+
+    // Куб в старом заголовке только с гранью +X; в DX10 - грани не квадратные
+    file = asset;
+    PutU32(file, 112, 0x200 | 0x400);
+    add("cubemap with missing faces", file, "partial cubemaps are not supported");
+    file = MakeTestDdsHeader(8, 4, 1, 1);
+    PutU32(file, 136, 0x4);
+    add("DX10 cubemap not square", file, "cubemap faces must be square");
+
+    file = MakeTestDdsHeader(16385, 4, 1, 1);
+    add("width over 16384", file, "DDS texture is too large");
+    file = MakeTestDdsHeader(4, 16385, 1, 1);
+    add("height over 16384", file, "DDS texture is too large");
+    file = MakeTestDdsHeader(4, 4, 1, 2049);
+    add("array over 2048", file, "DDS array is too large");
+    file = MakeTestDdsHeader(4, 4, 1, 342);
+    PutU32(file, 136, 0x4);
+    add("cube array over 2048 faces", file, "DDS array is too large");
+    file = MakeTestDdsHeader(4, 4, 4, 1);
+    add("too many mip levels", file, "too many mip levels");
+
+    for (const Case& test : rejected) {
+        DdsFile parsed;
+        const bool opened = parsed.OpenMemory(test.file.data(), test.file.size());
+        log.Print("  %-28s %s\n", test.name, opened ? "accepted" : parsed.GetErrorMessage().c_str());
+        log.Check(!opened && parsed.GetErrorMessage() == test.error, test.name);
+    }
+
+    // Те же заголовки с допустимыми значениями и данными разбираются: края проверок выше
+    struct Accepted {
+        const char* name;
+        uint32_t size;
+        uint32_t arraySize;
+        bool cubemap;
+    };
+    const Accepted accepted[] = {
+        { "16384x1", 16384, 1, false },
+        { "array of 2048", 1, 2048, false },
+        { "cube array of 341", 1, 341, true },
+    };
+    for (const Accepted& test : accepted) {
+        file = MakeTestDdsHeader(test.size, 1, 1, test.arraySize);
+        if (test.cubemap) {
+            PutU32(file, 136, 0x4);
+        }
+        file.resize(file.size() + static_cast<size_t>(test.size) * 4 * test.arraySize * (test.cubemap ? 6 : 1));
+        DdsFile parsed;
+        const bool opened = parsed.OpenMemory(file.data(), file.size());
+        log.Print("  %-28s %s\n", test.name, opened ? "accepted" : parsed.GetErrorMessage().c_str());
+        if (log.Check(opened, test.name)) {
+            log.Check(parsed.GetArraySize() == test.arraySize * (test.cubemap ? 6 : 1), "array size");
+            CheckDdsSubresources(log, parsed);
+        }
+    }
+    return !log.HasFailed();
+}
+
+// Кадры Update, пока все запросы не обработаны; на кадр - не больше бюджета (или один уровень)
+bool TestTextureStreamer(TestLog& log) {
+    const char* const kFiles[3] = { "lab6_test_stream0.dds", "lab6_test_stream1.dds", "lab6_test_stream2.dds" };
+    const uint32_t kSizes[3] = { 512, 64, 32 };
+    for (int i = 0; i < 3; i++) {
+        if (!log.Check(WriteTestDds(kFiles[i], kSizes[i], kSizes[i]), "cannot write test texture")) {
+            return false;
+        }
+    }
+
+    const uint64_t budget = 64 << 10;
+    {
+        TextureCache textureCache;
+        RecordingUploadTarget target;
+        TextureStreamer streamer(textureCache, target, budget);
+        const uint32_t plain = streamer.Request(WidenAscii(kFiles[0]));
+        const uint32_t small = streamer.Request(WidenAscii(kFiles[1]));
+        const std::wstring faces[6] = { WidenAscii(kFiles[2]), WidenAscii(kFiles[2]), WidenAscii(kFiles[2]),
+            WidenAscii(kFiles[2]), WidenAscii(kFiles[2]), WidenAscii(kFiles[2]) };
+        const uint32_t cube = streamer.RequestCube(faces);
+        log.Check(streamer.Request(WidenAscii(kFiles[0])) == plain, "repeated request returned another handle");
+
+        uint32_t frames = 0;
+        bool overBudget = false;
+        while (!streamer.IsIdle() && frames < 100000) {
+            const size_t first = target.uploads.size();
+            streamer.Update();
+            uint64_t spent = 0;
+            for (size_t i = first; i < target.uploads.size(); i++) {
+                spent += target.uploads[i].size;
+            }
+            overBudget = overBudget || (target.uploads.size() - first > 1 && spent > budget);
+            if (target.uploads.size() == first) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            }
+            frames++;
+        }
+        log.Print("  %u frames, %zu uploads, %.1f KB\n", frames, target.uploads.size(), streamer.GetStats().bytesUploaded / 1024.0);
+        log.Check(streamer.IsIdle(), "streamer did not finish");
+        log.Check(!overBudget, "frame upload exceeded the budget");
+
+        const uint32_t handles[3] = { plain, small, cube };
+        for (int i = 0; i < 3; i++) {
+            const uint32_t handle = handles[i];
+            log.Check(streamer.IsFullyResident(handle) && !streamer.HasFailed(handle), "texture is not fully resident");
+            if (!log.Check(handle < target.textures.size() && target.textures[handle].created, "texture was not created")) {
+                continue;
+            }
+            const RecordingUploadTarget::Texture& texture = target.textures[handle];
+            log.Check(texture.width == kSizes[i] && texture.height == kSizes[i] && texture.mipLevels == GetMipLevelCount(kSizes[i]),
+                "wrong texture size");
+            log.Check(texture.cubemap == (handle == cube) && texture.arraySize == (handle == cube ? 6u : 1u), "wrong array size");
+            log.Check(texture.mostDetailedMip == 0 && texture.mipChanges == texture.mipLevels && !texture.mipOrderBroken,
+                "mip levels did not become resident one by one from the smallest");
+
+            // Каждый уровень каждой грани - ровно один раз, от маленьких к большим, с данными своего уровня
+            std::vector<uint32_t> uploadCount(static_cast<size_t>(texture.mipLevels) * texture.arraySize, 0);
+            uint32_t lastMip = texture.mipLevels;
+            bool orderBroken = false;
+            bool dataBroken = false;
+            for (const RecordingUploadTarget::Upload& upload : target.uploads) {
+                if (upload.handle != handle || upload.mip >= texture.mipLevels || upload.item >= texture.arraySize) {
+                    continue;
+                }
+                uploadCount[static_cast<size_t>(upload.item) * texture.mipLevels + upload.mip]++;
+                orderBroken = orderBroken || upload.mip > lastMip;
+                lastMip = upload.mip;
+                const uint32_t size = (std::max)(kSizes[i] >> upload.mip, 1u);
+                dataBroken = dataBroken || upload.size != static_cast<size_t>(size) * size * 4 || upload.firstByte != upload.mip;
+            }
+            bool countBroken = false;
+            for (uint32_t count : uploadCount) {
+                countBroken = countBroken || count != 1;
+            }
+            log.Check(!countBroken, "mip level uploaded not exactly once");
+            log.Check(!orderBroken, "larger mip level uploaded before a smaller one");
+            log.Check(!dataBroken, "uploaded data does not match the mip level");
+        }
+    }
+
+    // Ошибка устройства, пока поток ввода-вывода еще читает уровни: запись переходит в Failed,
+    // остальные текстуры загружаются. Повторяется, чтобы ошибка попадала на разные моменты чтения
+    bool failureHandled = true;
+    for (int run = 0; run < 20; run++) {
+        TextureCache textureCache;
+        RecordingUploadTarget target;
+        target.failHandle = 0;
+        TextureStreamer streamer(textureCache, target, budget);
+        const uint32_t failing = streamer.Request(WidenAscii(kFiles[0]));
+        const uint32_t plain = streamer.Request(WidenAscii(kFiles[1]));
+        for (uint32_t frame = 0; !streamer.IsIdle() && frame < 100000; frame++) {
+            streamer.Update();
+            std::this_thread::yield();
+        }
+        streamer.Flush();
+        failureHandled = failureHandled && streamer.HasFailed(failing) && !streamer.IsCreated(failing) &&
+            streamer.IsFullyResident(plain) && streamer.GetStats().failed == 1;
+    }
+    log.Check(failureHandled, "failed texture creation was not handled");
+
+    for (const char* pFile : kFiles) {
+        remove(pFile);
+    }
+    return !log.HasFailed();
+}
+
+// Замена компилятора шейдеров: байт-код - версия и все поля описания подряд, так что по нему
+// видно, для какого описания он получен. Исходный текст с "#error" не компилируется.
+class FakeShaderCompiler : public IShaderCompiler {
+public:
+    std::string version = "fake 1";
+    uint32_t compileCount = 0;
+
+    std::string GetVersion() const override { return version; }
+
+    bool Compile(const ShaderCompileDesc& desc, std::vector<uint8_t>& bytecode, std::string& errors) override {
+        compileCount++;
+        const std::string source(desc.pSource, desc.sourceSize);
+        if (source.find("#error") != std::string::npos) {
+            errors = "fake(1): error: #error directive";
+            return false;
+        }
+        const std::string text = Describe(desc, version);
+        bytecode.assign(text.begin(), text.end());
+        return true;
+    }
+
+    static std::string Describe(const ShaderCompileDesc& desc, const std::string& version) {
+        std::string text = version + "|" + std::string(desc.pSource, desc.sourceSize) + "|" + desc.entryPoint + "|" + desc.target;
+        for (uint32_t i = 0; i < desc.defineCount; i++) {
+            text += std::string("|") + desc.pDefines[i].name + "=" + (desc.pDefines[i].definition ? desc.pDefines[i].definition : "");
+        }
+        return text + "|" + std::to_string(desc.flags);
+    }
+};
+
+bool TestShaderCache(TestLog& log) {
+    const char* const kCacheFile = "lab6_test_shaders.bin";
+    const std::wstring cachePath = WidenAscii(kCacheFile);
+    remove(kCacheFile);
+
+    const char source[] = "float4 main() : SV_Target { return COLOR; }";
+    const ShaderMacro red[] = { { "COLOR", "float4(1, 0, 0, 1)" } };
+    const ShaderMacro green[] = { { "COLOR", "float4(0, 1, 0, 1)" } };
+    const ShaderMacro renamed[] = { { "TINT", "float4(1, 0, 0, 1)" } };
+    ShaderCompileDesc descs[5];
+    for (ShaderCompileDesc& desc : descs) {
+        desc.pSource = source;
+        desc.sourceSize = sizeof(source) - 1;
+        desc.entryPoint = "main";
+        desc.target = "ps_5_0";
+        desc.pDefines = red;
+        desc.defineCount = 1;
+    }
+    descs[1].pDefines = green;  // другое значение макроса
+    descs[2].pDefines = renamed;
+    descs[3].flags = 1;         // другие флаги
+    descs[4].target = "ps_4_0";
+
+    FakeShaderCompiler compiler;
+    // Все описания: true, если каждое попало (или промахнулось) и байт-код - от своего описания
+    auto requestAll = [&log, &descs, &compiler](ShaderCache& cache, bool expectHits, const char* pWhat) {
+        const uint32_t compilesBefore = compiler.compileCount;
+        bool bytecodeMatches = true;
+        for (const ShaderCompileDesc& desc : descs) {
+            ShaderBytecode bytecode;
+            const std::string expected = FakeShaderCompiler::Describe(desc, compiler.version);
+            bytecodeMatches = bytecodeMatches && cache.GetBytecode(desc, bytecode) && bytecode.size == expected.size() &&
+                memcmp(bytecode.pData, expected.data(), expected.size()) == 0;
+        }
+        const uint32_t compiled = compiler.compileCount - compilesBefore;
+        log.Print("  %-28s %u of %u compiled\n", pWhat, compiled, static_cast<unsigned>(sizeof(descs) / sizeof(descs[0])));
+        log.Check(bytecodeMatches, "bytecode does not match its description");
+        log.Check(compiled == (expectHits ? 0u : static_cast<uint32_t>(sizeof(descs) / sizeof(descs[0]))),
+            expectHits ? "expected cache hits" : "expected cache misses");
+    };
+
+    {
+        ShaderCache cache(compiler);
+        log.Check(!cache.Open(cachePath), "missing cache file opened");
+        requestAll(cache, false, "empty cache:");
+        requestAll(cache, true, "same run:");
+        log.Check(cache.GetStats().misses == 5 && cache.GetStats().hits == 5, "wrong hit and miss counts");
+
+        const char broken[] = "#error broken";
+        ShaderCompileDesc failing = descs[0];
+        failing.pSource = broken;
+        failing.sourceSize = sizeof(broken) - 1;
+        ShaderBytecode bytecode;
+        std::string errors;
+        log.Check(!cache.GetBytecode(failing, bytecode, &errors) && !errors.empty() && cache.GetStats().failures == 1,
+            "compile error was not reported");
+        log.Check(cache.Save(), "cannot save the cache");
+    }
+    {
+        ShaderCache cache(compiler);
+        log.Check(cache.Open(cachePath), "saved cache does not open");
+        requestAll(cache, true, "reopened:");
+    }
+
+    // Новая версия компилятора - промахи; запись оставляет только записи этого запуска
+    compiler.version = "fake 2";
+    {
+        ShaderCache cache(compiler);
+        log.Check(cache.Open(cachePath), "saved cache does not open");
+        requestAll(cache, false, "compiler version changed:");
+        log.Check(cache.Save(), "cannot save the cache");
+    }
+    compiler.version = "fake 1";
+    {
+        ShaderCache cache(compiler);
+        cache.Open(cachePath);
+        requestAll(cache, false, "stale entries dropped:");
+    }
+
+    // Испорченный файл - пустой кэш, который Save пишет заново
+    MappedFile saved;
+    std::vector<uint8_t> valid;
+    if (log.Check(saved.Open(cachePath), "cannot read the cache file")) {
+        valid.assign(saved.GetData(), saved.GetData() + saved.GetSize());
+    }
+    saved.Close();
+    struct Corruption {
+        const char* name;
+        size_t offset;    // байт, который меняется; SIZE_MAX - файл обрезается до половины
+        uint8_t value;
+    };
+    const Corruption corruptions[] = {
+        { "bad magic:", 0, 0x00 },
+        { "bad version:", 4, 0x7F },
+        { "huge entry count:", 10, 0xFF },
+        { "entry out of file:", 16 + 16 + 6, 0xFF },  // старшие байты offset первой записи
+        { "truncated file:", SIZE_MAX, 0 },
+    };
+    for (const Corruption& corruption : corruptions) {
+        if (valid.size() < 64) {
+            break;
+        }
+        std::vector<uint8_t> file = valid;
+        if (corruption.offset == SIZE_MAX) {
+            file.resize(file.size() / 2);
+        }
+        else {
+            file[corruption.offset] = corruption.value;
+        }
+        WriteWholeFile(cachePath, file.data(), file.size());
+        ShaderCache cache(compiler);
+        log.Check(!cache.Open(cachePath), "corrupt cache file opened");
+        requestAll(cache, false, corruption.name);
+        log.Check(cache.Save(), "cannot save the cache");
+        ShaderCache reopened(compiler);
+        log.Check(reopened.Open(cachePath), "rewritten cache does not open");
+    }
+
+    remove(kCacheFile);
+    return !log.HasFailed();
+}
+
+// Кольцо загрузки констант на MockUploadRingDevice (RunUploadRingTest): кадры с разной задержкой GPU,
+// переходы через конец кольца, ожидания и блоки больше кольца. Ошибка, если блок перезаписан до того,
+// как его прочитал GPU, выделен не по границе 256 байт или отказ пришелся не на блок больше кольца
+bool TestUploadRing(TestLog& log) {
+    log.Print("  scenario     capacity  lag   uploads/frame  KB/frame  padded KB  waits  wraps  failed  oversized  corrupted  ns/upload\n");
+    for (const UploadRingTestResult& result : RunUploadRingTest(2000)) {
+        const double frames = result.stats.frameCount > 0 ? static_cast<double>(result.stats.frameCount) : 1.0;
+        log.Print("  %-11s %7u K %4u %15.1f %9.1f %10.1f %6llu %6llu %7llu %10llu %10zu %10.1f\n", result.scenario, result.capacity / 1024, result.latency,
+            result.stats.uploadCount / frames, result.stats.byteCount / frames / 1024.0, result.stats.paddedByteCount / frames / 1024.0,
+            static_cast<unsigned long long>(result.stats.waitCount), static_cast<unsigned long long>(result.stats.wrapCount),
+            static_cast<unsigned long long>(result.stats.failedCount), static_cast<unsigned long long>(result.oversizedCount),
+            result.corruptedCount, result.nanosecondsPerUpload);
+        log.Check(result.corruptedCount == 0, "block overwritten before the GPU read it");
+        log.Check(result.misalignedCount == 0, "block is not 256-byte aligned");
+        log.Check(result.stats.failedCount == result.oversizedCount, "allocation failed for a block that fits the ring");
+    }
+    return !log.HasFailed();
+}
+
+// Ошибки упаковки PackedTangentVertex на вершинах куба и тестовых наборах RunPackedVertexTests против
+// границ из PackedVertex.h, совпадение путей SSE2 и скалярного; для сведения - скорость упаковки и распаковки
+bool TestPackedVertex(TestLog& log) {
+    std::vector<PackedVertexErrorStats> results;
+    results.push_back(MeasurePackedVertexError("cube", Vertices, static_cast<uint32_t>(sizeof(Vertices) / sizeof(Vertices[0]))));
+    for (const PackedVertexErrorStats& stats : RunPackedVertexTests()) {
+        results.push_back(stats);
+    }
+
+    log.Print("  vertex: %u bytes packed, %u bytes unpacked\n", static_cast<unsigned>(sizeof(PackedTangentVertex)),
+        static_cast<unsigned>(sizeof(TextureTangentVertex)));
+    log.Print("  bounds: position quantization 0.5 step, float unpack rounding %.4f step + 2^-24 |offset| / step, "
+        "normal %.2f deg, tangent %.2f deg, uv 2^-11 relative\n",
+        kPackedPositionRoundingSteps, kPackedNormalMaxErrorDegrees, kPackedTangentMaxErrorDegrees);
+    log.Print("  mesh               vertices  position steps  rounding steps  normal deg  tangent deg  uv relative  simd mismatches  ok\n");
+    for (const PackedVertexErrorStats& stats : results) {
+        log.Print("  %-18s %9u %15.4f %15.4f %11.4f %12.4f %12.3g %16u  %s\n", stats.mesh, stats.vertexCount, stats.maxPositionSteps,
+            stats.maxPositionRoundingSteps, stats.maxNormalDegrees, stats.maxTangentDegrees, stats.maxUvRelativeError, stats.simdMismatchCount, stats.withinBounds ? "yes" : "NO");
+        log.Check(stats.withinBounds, "packing error exceeds the bounds or SSE2 and scalar paths differ");
+    }
+
+    const PackedVertexBenchmarkResult benchmark = RunPackedVertexBenchmark(1 << 20);
+    log.Print("  %u vertices, ns per vertex: pack scalar %.2f, sse2 %.2f; unpack scalar %.2f, sse2 %.2f\n", benchmark.vertexCount,
+        benchmark.packScalarNanoseconds, benchmark.packSimdNanoseconds, benchmark.unpackScalarNanoseconds, benchmark.unpackSimdNanoseconds);
+    return !log.HasFailed();
+}
+
+} // namespace
+
+bool RunLabTests(ReportWriter& report) {
+    struct Test {
+        const char* name;
+        bool (*pRun)(TestLog& log);
+    };
+    const Test tests[] = {
+        { "DdsFile", TestDdsFile },
+        { "TextureStreamer", TestTextureStreamer },
+        { "ShaderCache", TestShaderCache },
+        { "UploadRing", TestUploadRing },
+        { "PackedVertex", TestPackedVertex },
+    };
+
+    bool success = true;
+    for (const Test& test : tests) {
+        TestLog log;
+        const bool passed = test.pRun(log);
+        report.Print("%s %s\n", passed ? "PASS" : "FAIL", test.name);
+        report.Append(log.GetText());
+        success = success && passed;
+    }
+    return success;
+}
@@ -0,0 +1,11 @@
+﻿#pragma once
+
+#include "ReportWriter.h"
+
+// Проверки модулей lab6 без окна и устройства: вместо D3D11 - заглушки, которые записывают
+// вызовы или выдают предсказуемый результат. Запускаются программой TestMain.cpp (Linux и
+// сборочные машины) и ключом -test окна lab6 (отчет - в tests.txt).
+
+// Все проверки подряд; в report - строка PASS/FAIL на проверку и причины ошибок.
+// false, если хотя бы одна проверка не прошла
+bool RunLabTests(ReportWriter& report);
@@ -0,0 +1,444 @@
+﻿#include "LightClusters.h"
+#include "ThreadPool.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <random>
+
+#if defined(_M_X64) || defined(__x86_64__) || defined(__SSE2__) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define CLUSTER_HAS_SSE2 1
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#define CLUSTER_TARGET_AVX2
+#else
+#define CLUSTER_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+#else
+#define CLUSTER_HAS_SSE2 0
+#endif
+
+namespace {
+
+// Квадрат расстояния от центра сферы до AABB кластера. Порядок операций один во всех путях -
+// списки совпадают.
+inline float AabbDistanceSq(const DirectX::XMFLOAT3& boxMin, const DirectX::XMFLOAT3& boxMax, float x, float y, float z) {
+    const float dx = std::max(std::max(boxMin.x - x, x - boxMax.x), 0.0f);
+    const float dy = std::max(std::max(boxMin.y - y, y - boxMax.y), 0.0f);
+    const float dz = std::max(std::max(boxMin.z - z, z - boxMax.z), 0.0f);
+    return (dx * dx + dy * dy) + dz * dz;
+}
+
+// Номер источника пишется всегда, а счетчик растет только для задевших кластер.
+// В буфере должно быть место под rowCount записей после indexCount.
+uint32_t TestClusterScalar(const DirectX::XMFLOAT3& boxMin, const DirectX::XMFLOAT3& boxMax, const float* pX, const float* pY, const float* pZ,
+    const float* pRadiusSq, const uint32_t* pLights, uint32_t begin, uint32_t rowCount, uint32_t* pIndices, uint32_t indexCount) {
+    for (uint32_t i = begin; i < rowCount; i++) {
+        pIndices[indexCount] = pLights[i];
+        indexCount += AabbDistanceSq(boxMin, boxMax, pX[i], pY[i], pZ[i]) <= pRadiusSq[i] ? 1 : 0;
+    }
+    return indexCount;
+}
+
+#if CLUSTER_HAS_SSE2
+
+inline __m128 AxisDistanceSse2(float boxMin, float boxMax, __m128 c) {
+    const __m128 d = _mm_max_ps(_mm_max_ps(_mm_sub_ps(_mm_set1_ps(boxMin), c), _mm_sub_ps(c, _mm_set1_ps(boxMax))), _mm_setzero_ps());
+    return _mm_mul_ps(d, d);
+}
+
+uint32_t TestClusterSse2(const DirectX::XMFLOAT3& boxMin, const DirectX::XMFLOAT3& boxMax, const float* pX, const float* pY, const float* pZ,
+    const float* pRadiusSq, const uint32_t* pLights, uint32_t rowCount, uint32_t* pIndices, uint32_t indexCount) {
+    const uint32_t blockEnd = rowCount & ~3u;
+    for (uint32_t i = 0; i < blockEnd; i += 4) {
+        const __m128 distanceSq = _mm_add_ps(_mm_add_ps(AxisDistanceSse2(boxMin.x, boxMax.x, _mm_loadu_ps(pX + i)),
+            AxisDistanceSse2(boxMin.y, boxMax.y, _mm_loadu_ps(pY + i))), AxisDistanceSse2(boxMin.z, boxMax.z, _mm_loadu_ps(pZ + i)));
+        const int mask = _mm_movemask_ps(_mm_cmple_ps(distanceSq, _mm_loadu_ps(pRadiusSq + i)));
+        for (uint32_t lane = 0; lane < 4; lane++) {
+            pIndices[indexCount] = pLights[i + lane];
+            indexCount += (mask >> lane) & 1;
+        }
+    }
+    return TestClusterScalar(boxMin, boxMax, pX, pY, pZ, pRadiusSq, pLights, blockEnd, rowCount, pIndices, indexCount);
+}
+
+// Для маски из 8 бит - номера задевших дорожек по 3 бита (биты 0-23) и их число (биты 24-27)
+struct CompactTable {
+    uint32_t entries[256];
+
+    CompactTable() {
+        for (uint32_t mask = 0; mask < 256; mask++) {
+            uint32_t entry = 0;
+            uint32_t count = 0;
+            for (uint32_t lane = 0; lane < 8; lane++) {
+                if (mask & (1u << lane)) {
+                    entry |= lane << (3 * count);
+                    count++;
+                }
+            }
+            entries[mask] = entry | (count << 24);
+        }
+    }
+};
+
+const CompactTable kCompactTable;
+
+CLUSTER_TARGET_AVX2 inline __m256 AxisDistanceAvx2(float boxMin, float boxMax, __m256 c) {
+    const __m256 d = _mm256_max_ps(_mm256_max_ps(_mm256_sub_ps(_mm256_set1_ps(boxMin), c), _mm256_sub_ps(c, _mm256_set1_ps(boxMax))), _mm256_setzero_ps());
+    return _mm256_mul_ps(d, d);
+}
+
+// Номера источников сжимаются через vpermd и пишутся одной записью на 8 дорожек
+CLUSTER_TARGET_AVX2 uint32_t TestClusterAvx2(const DirectX::XMFLOAT3& boxMin, const DirectX::XMFLOAT3& boxMax, const float* pX, const float* pY, const float* pZ,
+    const float* pRadiusSq, const uint32_t* pLights, uint32_t rowCount, uint32_t* pIndices, uint32_t indexCount) {
+    const uint32_t blockEnd = rowCount & ~7u;
+    for (uint32_t i = 0; i < blockEnd; i += 8) {
+        const __m256 distanceSq = _mm256_add_ps(_mm256_add_ps(AxisDistanceAvx2(boxMin.x, boxMax.x, _mm256_loadu_ps(pX + i)),
+            AxisDistanceAvx2(boxMin.y, boxMax.y, _mm256_loadu_ps(pY + i))), AxisDistanceAvx2(boxMin.z, boxMax.z, _mm256_loadu_ps(pZ + i)));
+        const int mask = _mm256_movemask_ps(_mm256_cmp_ps(distanceSq, _mm256_loadu_ps(pRadiusSq + i), _CMP_LE_OQ));
+        const uint32_t entry = kCompactTable.entries[mask];
+        const __m256i lanes = _mm256_and_si256(_mm256_srlv_epi32(_mm256_set1_epi32(static_cast<int>(entry)),
+            _mm256_setr_epi32(0, 3, 6, 9, 12, 15, 18, 21)), _mm256_set1_epi32(7));
+        const __m256i lights = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(pLights + i));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(pIndices + indexCount), _mm256_permutevar8x32_epi32(lights, lanes));
+        indexCount += entry >> 24;
+    }
+    // Скалярный хвост и код после возврата - SSE: без сброса верхних половин YMM каждая их
+    // инструкция платит за переход между состояниями AVX и SSE
+    _mm256_zeroupper();
+    return TestClusterScalar(boxMin, boxMax, pX, pY, pZ, pRadiusSq, pLights, blockEnd, rowCount, pIndices, indexCount);
+}
+
+#endif
+
+// Тайл экрана по координате NDC: столбцы слева направо, строки сверху вниз
+inline uint32_t NdcToTile(float ndc, uint32_t tileCount) {
+    const float tile = std::floor((ndc + 1.0f) * 0.5f * static_cast<float>(tileCount));
+    return tile <= 0.0f ? 0 : std::min(static_cast<uint32_t>(tile), tileCount - 1);
+}
+
+} // namespace
+
+LightClusterDesc MakeLightClusterDesc(DirectX::FXMMATRIX projection, float nearZ, float farZ, uint32_t tilesX, uint32_t tilesY, uint32_t slices) {
+    LightClusterDesc desc;
+    desc.tilesX = tilesX;
+    desc.tilesY = tilesY;
+    desc.slices = slices;
+    desc.nearZ = nearZ;
+    desc.farZ = farZ;
+    // В XMMatrixPerspectiveFovLH _11 = 1 / tan(fovX / 2), _22 = 1 / tan(fovY / 2)
+    desc.tanHalfFovX = 1.0f / DirectX::XMVectorGetX(projection.r[0]);
+    desc.tanHalfFovY = 1.0f / DirectX::XMVectorGetY(projection.r[1]);
+    return desc;
+}
+
+void LightClusterGrid::Configure(const LightClusterDesc& desc) {
+    m_desc = desc;
+    const float depthRatio = std::log(desc.farZ / desc.nearZ);
+    m_sliceScale = static_cast<float>(desc.slices) / depthRatio;
+    m_sliceBias = -std::log(desc.nearZ) * m_sliceScale;
+
+    m_sliceDepths.resize(desc.slices + 1);
+    for (uint32_t slice = 0; slice <= desc.slices; slice++) {
+        m_sliceDepths[slice] = desc.nearZ * std::exp(depthRatio * slice / desc.slices);
+    }
+    m_sliceDepths[desc.slices] = desc.farZ;
+
+    // Тайл покрывает отрезок NDC, в пространстве вида он расширяется с глубиной:
+    // крайние значения - на ближней или дальней границе слоя
+    m_clusterMin.resize(desc.GetClusterCount());
+    m_clusterMax.resize(desc.GetClusterCount());
+    for (uint32_t slice = 0; slice < desc.slices; slice++) {
+        const float z0 = m_sliceDepths[slice];
+        const float z1 = m_sliceDepths[slice + 1];
+        for (uint32_t tileY = 0; tileY < desc.tilesY; tileY++) {
+            const float ndcTop = 1.0f - 2.0f * tileY / desc.tilesY;
+            const float ndcBottom = 1.0f - 2.0f * (tileY + 1) / desc.tilesY;
+            for (uint32_t tileX = 0; tileX < desc.tilesX; tileX++) {
+                const float ndcLeft = 2.0f * tileX / desc.tilesX - 1.0f;
+                const float ndcRight = 2.0f * (tileX + 1) / desc.tilesX - 1.0f;
+                const uint32_t cluster = GetClusterIndex(tileX, tileY, slice);
+                m_clusterMin[cluster] = DirectX::XMFLOAT3(
+                    std::min(ndcLeft * desc.tanHalfFovX * z0, ndcLeft * desc.tanHalfFovX * z1),
+                    std::min(ndcBottom * desc.tanHalfFovY * z0, ndcBottom * desc.tanHalfFovY * z1), z0);
+                m_clusterMax[cluster] = DirectX::XMFLOAT3(
+                    std::max(ndcRight * desc.tanHalfFovX * z0, ndcRight * desc.tanHalfFovX * z1),
+                    std::max(ndcTop * desc.tanHalfFovY * z0, ndcTop * desc.tanHalfFovY * z1), z1);
+            }
+        }
+    }
+
+    m_sliceWork.resize(desc.slices);
+    m_clusters.assign(desc.GetClusterCount(), LightClusterRange{ 0, 0 });
+    m_lightIndices.clear();
+}
+
+bool LightClusterGrid::FindCluster(const DirectX::XMFLOAT3& viewPosition, uint32_t& cluster) const {
+    if (!(viewPosition.z >= m_desc.nearZ && viewPosition.z < m_desc.farZ)) {
+        return false;
+    }
+    const float ndcX = viewPosition.x / (viewPosition.z * m_desc.tanHalfFovX);
+    const float ndcY = viewPosition.y / (viewPosition.z * m_desc.tanHalfFovY);
+    if (ndcX < -1.0f || ndcX > 1.0f || ndcY < -1.0f || ndcY > 1.0f) {
+        return false;
+    }
+    const float slice = std::log(viewPosition.z) * m_sliceScale + m_sliceBias;
+    cluster = GetClusterIndex(NdcToTile(ndcX, m_desc.tilesX), NdcToTile(-ndcY, m_desc.tilesY),
+        std::min(static_cast<uint32_t>(std::max(slice, 0.0f)), m_desc.slices - 1));
+    return true;
+}
+
+void LightClusterGrid::Build(DirectX::FXMMATRIX view, const PointLight* pLights, uint32_t lightCount, CullPath path, ThreadPool* pThreadPool) {
+    m_lightX.resize(lightCount);
+    m_lightY.resize(lightCount);
+    m_lightZ.resize(lightCount);
+    m_lightRadius.resize(lightCount);
+    for (uint32_t i = 0; i < lightCount; i++) {
+        DirectX::XMFLOAT3 position;
+        DirectX::XMStoreFloat3(&position, DirectX::XMVector3TransformCoord(DirectX::XMLoadFloat3(&pLights[i].position), view));
+        m_lightX[i] = position.x;
+        m_lightY[i] = position.y;
+        m_lightZ[i] = position.z;
+        m_lightRadius[i] = pLights[i].radius;
+    }
+
+    // Слои независимы: каждый пишет свои диапазоны и свой массив индексов
+    if (pThreadPool && m_desc.slices > 1) {
+        pThreadPool->ParallelFor(m_desc.slices, 1, [&](uint32_t begin, uint32_t end) {
+            for (uint32_t slice = begin; slice < end; slice++) {
+                BuildSlice(slice, path);
+            }
+        });
+    }
+    else {
+        for (uint32_t slice = 0; slice < m_desc.slices; slice++) {
+            BuildSlice(slice, path);
+        }
+    }
+
+    // Диапазоны в слое считались от его начала - сдвиг на индексы предыдущих слоев
+    uint32_t indexCount = 0;
+    for (uint32_t slice = 0; slice < m_desc.slices; slice++) {
+        indexCount += m_sliceWork[slice].indexCount;
+    }
+    m_lightIndices.resize(indexCount);
+    const uint32_t sliceClusterCount = m_desc.tilesX * m_desc.tilesY;
+    uint32_t sliceOffset = 0;
+    for (uint32_t slice = 0; slice < m_desc.slices; slice++) {
+        const SliceWork& work = m_sliceWork[slice];
+        LightClusterRange* pRanges = m_clusters.data() + slice * sliceClusterCount;
+        for (uint32_t i = 0; i < sliceClusterCount; i++) {
+            pRanges[i].offset += sliceOffset;
+        }
+        if (work.indexCount > 0) {
+            std::memcpy(m_lightIndices.data() + sliceOffset, work.indices.data(), work.indexCount * sizeof(uint32_t));
+        }
+        sliceOffset += work.indexCount;
+    }
+}
+
+void LightClusterGrid::BuildSlice(uint32_t slice, CullPath path) {
+    SliceWork& work = m_sliceWork[slice];
+    const float z0 = m_sliceDepths[slice];
+    const float z1 = m_sliceDepths[slice + 1];
+    const uint32_t lightCount = static_cast<uint32_t>(m_lightX.size());
+
+    // Кандидаты слоя и прямоугольники тайлов, которые они могут задеть. Для точек сферы внутри
+    // слоя x / z не меньше (x - r) / z, взятого на ближней границе при x - r < 0 и на дальней иначе.
+    work.candidates.clear();
+    work.tileRects.clear();
+    for (uint32_t i = 0; i < lightCount; i++) {
+        const float x = m_lightX[i];
+        const float y = m_lightY[i];
+        const float z = m_lightZ[i];
+        const float r = m_lightRadius[i];
+        if (z + r < z0 || z - r > z1) {
+            continue;
+        }
+        const float zNear = std::max(z - r, z0);
+        const float zFar = std::min(z + r, z1);
+        const float ndcLeft = (x - r) / (m_desc.tanHalfFovX * (x - r < 0.0f ? zNear : zFar));
+        const float ndcRight = (x + r) / (m_desc.tanHalfFovX * (x + r > 0.0f ? zNear : zFar));
+        const float ndcBottom = (y - r) / (m_desc.tanHalfFovY * (y - r < 0.0f ? zNear : zFar));
+        const float ndcTop = (y + r) / (m_desc.tanHalfFovY * (y + r > 0.0f ? zNear : zFar));
+        if (ndcRight < -1.0f || ndcLeft > 1.0f || ndcTop < -1.0f || ndcBottom > 1.0f) {
+            continue;
+        }
+        work.candidates.push_back(i);
+        work.tileRects.push_back(NdcToTile(ndcLeft, m_desc.tilesX));
+        work.tileRects.push_back(NdcToTile(ndcRight, m_desc.tilesX));
+        work.tileRects.push_back(NdcToTile(-ndcTop, m_desc.tilesY));
+        work.tileRects.push_back(NdcToTile(-ndcBottom, m_desc.tilesY));
+    }
+
+    const uint32_t candidateCount = static_cast<uint32_t>(work.candidates.size());
+    work.rowX.resize(candidateCount);
+    work.rowY.resize(candidateCount);
+    work.rowZ.resize(candidateCount);
+    work.rowRadiusSq.resize(candidateCount);
+    work.rowLights.resize(candidateCount);
+    work.indexCount = 0;
+    for (uint32_t tileY = 0; tileY < m_desc.tilesY; tileY++) {
+        // Источники строки по полям - для проверки сразу нескольких
+        uint32_t rowCount = 0;
+        for (uint32_t c = 0; c < candidateCount; c++) {
+            if (tileY < work.tileRects[4 * c + 2] || tileY > work.tileRects[4 * c + 3]) {
+                continue;
+            }
+            const uint32_t light = work.candidates[c];
+            work.rowX[rowCount] = m_lightX[light];
+            work.rowY[rowCount] = m_lightY[light];
+            work.rowZ[rowCount] = m_lightZ[light];
+            work.rowRadiusSq[rowCount] = m_lightRadius[light] * m_lightRadius[light];
+            work.rowLights[rowCount] = light;
+            rowCount++;
+        }
+
+        for (uint32_t tileX = 0; tileX < m_desc.tilesX; tileX++) {
+            const uint32_t cluster = GetClusterIndex(tileX, tileY, slice);
+            const uint32_t first = work.indexCount;
+            // Запас на безусловную запись последних дорожек
+            if (work.indices.size() < first + rowCount + 8) {
+                work.indices.resize(std::max<size_t>(2 * work.indices.size(), first + rowCount + 8));
+            }
+            uint32_t* pIndices = work.indices.data();
+            switch (path) {
+#if CLUSTER_HAS_SSE2
+            case CullPath::Avx2:
+                work.indexCount = TestClusterAvx2(m_clusterMin[cluster], m_clusterMax[cluster], work.rowX.data(), work.rowY.data(),
+                    work.rowZ.data(), work.rowRadiusSq.data(), work.rowLights.data(), rowCount, pIndices, first);
+                break;
+            case CullPath::Sse2:
+                work.indexCount = TestClusterSse2(m_clusterMin[cluster], m_clusterMax[cluster], work.rowX.data(), work.rowY.data(),
+                    work.rowZ.data(), work.rowRadiusSq.data(), work.rowLights.data(), rowCount, pIndices, first);
+                break;
+#endif
+            default:
+                work.indexCount = TestClusterScalar(m_clusterMin[cluster], m_clusterMax[cluster], work.rowX.data(), work.rowY.data(),
+                    work.rowZ.data(), work.rowRadiusSq.data(), work.rowLights.data(), 0, rowCount, pIndices, first);
+                break;
+            }
+            m_clusters[cluster].offset = first;
+            m_clusters[cluster].count = work.indexCount - first;
+        }
+    }
+}
+
+void RunLightClusterBenchmark(const uint32_t* pLightCounts, uint32_t countCount, uint32_t repeatCount, ThreadPool* pThreadPool,
+    std::vector<LightClusterBuildResult>& buildResults, std::vector<LightShadingResult>& shadingResults, uint32_t seed) {
+    // Камера в начале координат смотрит вдоль +z, проекция как в lab6
+    const DirectX::XMMATRIX view = DirectX::XMMatrixIdentity();
+    const DirectX::XMMATRIX projection = DirectX::XMMatrixPerspectiveFovLH(DirectX::XM_PI / 3.0f, 1280.0f / 720.0f, 0.1f, 1000.0f);
+    LightClusterGrid grid;
+    grid.Configure(MakeLightClusterDesc(projection, 0.1f, 1000.0f));
+    LightClusterGrid expectedGrid;
+    expectedGrid.Configure(grid.GetDesc());
+    const LightClusterDesc& desc = grid.GetDesc();
+
+    // Тестовые пиксели: видимая поверхность на случайной глубине
+    const uint32_t sampleWidth = 320;
+    const uint32_t sampleHeight = 180;
+    std::mt19937 sampleRandom(seed + 1);
+    std::uniform_real_distribution<float> sampleDepth(1.0f, 80.0f);
+    std::vector<DirectX::XMFLOAT3> samples(sampleWidth * sampleHeight);
+    for (uint32_t y = 0; y < sampleHeight; y++) {
+        for (uint32_t x = 0; x < sampleWidth; x++) {
+            const float z = sampleDepth(sampleRandom);
+            const float ndcX = (x + 0.5f) / sampleWidth * 2.0f - 1.0f;
+            const float ndcY = 1.0f - (y + 0.5f) / sampleHeight * 2.0f;
+            samples[y * sampleWidth + x] = DirectX::XMFLOAT3(ndcX * desc.tanHalfFovX * z, ndcY * desc.tanHalfFovY * z, z);
+        }
+    }
+    std::vector<float> naiveLight(samples.size());
+
+    const CullPath paths[] = { CullPath::Scalar, CullPath::Sse2, CullPath::Avx2 };
+    for (uint32_t run = 0; run < countCount; run++) {
+        const uint32_t lightCount = pLightCounts[run];
+        std::mt19937 random(seed);
+        std::uniform_real_distribution<float> side(-40.0f, 40.0f);
+        std::uniform_real_distribution<float> depth(1.0f, 80.0f);
+        std::uniform_real_distribution<float> radius(1.0f, 4.0f);
+        std::vector<PointLight> lights(lightCount);
+        for (PointLight& light : lights) {
+            light.position = DirectX::XMFLOAT3(side(random), side(random), depth(random));
+            light.radius = radius(random);
+            light.color = DirectX::XMFLOAT3(1.0f, 1.0f, 1.0f);
+            light.padding = 0.0f;
+        }
+
+        expectedGrid.Build(view, lights.data(), lightCount, CullPath::Scalar, nullptr);
+        for (CullPath path : paths) {
+            if (!IsCullPathSupported(path)) {
+                continue;
+            }
+            for (int pooled = 0; pooled < (pThreadPool ? 2 : 1); pooled++) {
+                ThreadPool* pPool = pooled ? pThreadPool : nullptr;
+                LightClusterBuildResult result;
+                result.lightCount = lightCount;
+                result.path = path;
+                result.threadCount = pPool ? pPool->GetThreadCount() : 1;
+
+                grid.Build(view, lights.data(), lightCount, path, pPool);
+                result.indexCount = grid.GetLightIndexCount();
+                for (uint32_t cluster = 0; cluster < desc.GetClusterCount(); cluster++) {
+                    const LightClusterRange& range = grid.GetClusters()[cluster];
+                    const LightClusterRange& expected = expectedGrid.GetClusters()[cluster];
+                    if (range.count != expected.count || !std::equal(grid.GetLightIndices() + range.offset,
+                        grid.GetLightIndices() + range.offset + range.count, expectedGrid.GetLightIndices() + expected.offset)) {
+                        result.mismatchCount++;
+                    }
+                }
+
+                const auto startTime = std::chrono::steady_clock::now();
+                for (uint32_t repeat = 0; repeat < repeatCount; repeat++) {
+                    grid.Build(view, lights.data(), lightCount, path, pPool);
+                }
+                const double milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - startTime).count();
+                result.milliseconds = repeatCount > 0 ? milliseconds / repeatCount : 0.0;
+                buildResults.push_back(result);
+            }
+        }
+
+        // Освещенность - сумма ослаблений, цвет у всех источников один
+        LightShadingResult shading;
+        shading.lightCount = lightCount;
+        auto startTime = std::chrono::steady_clock::now();
+        for (size_t s = 0; s < samples.size(); s++) {
+            float sum = 0.0f;
+            for (uint32_t i = 0; i < lightCount; i++) {
+                const float dx = lights[i].position.x - samples[s].x;
+                const float dy = lights[i].position.y - samples[s].y;
+                const float dz = lights[i].position.z - samples[s].z;
+                sum += ComputeLightAttenuation(dx * dx + dy * dy + dz * dz, lights[i].radius);
+            }
+            naiveLight[s] = sum;
+        }
+        shading.naiveMilliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - startTime).count();
+
+        uint64_t listedCount = 0;
+        float maxDifference = 0.0f;
+        startTime = std::chrono::steady_clock::now();
+        for (size_t s = 0; s < samples.size(); s++) {
+            float sum = 0.0f;
+            uint32_t cluster = 0;
+            if (expectedGrid.FindCluster(samples[s], cluster)) {
+                const LightClusterRange& range = expectedGrid.GetClusters()[cluster];
+                const uint32_t* pIndices = expectedGrid.GetLightIndices() + range.offset;
+                for (uint32_t k = 0; k < range.count; k++) {
+                    const PointLight& light = lights[pIndices[k]];
+                    const float dx = light.position.x - samples[s].x;
+                    const float dy = light.position.y - samples[s].y;
+                    const float dz = light.position.z - samples[s].z;
+                    sum += ComputeLightAttenuation(dx * dx + dy * dy + dz * dz, light.radius);
+                }
+                listedCount += range.count;
+            }
+            maxDifference = std::max(maxDifference, std::fabs(sum - naiveLight[s]));
+        }
+        shading.clusteredMilliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - startTime).count();
+        shading.lightsPerPixel = static_cast<double>(listedCount) / samples.size();
+        shading.maxDifference = maxDifference;
+        shadingResults.push_back(shading);
+    }
+}
@@ -0,0 +1,129 @@
+﻿#pragma once
+
+#include <cstdint>
+#include <vector>
+#include <DirectXMath.h>
+#include "FrustumCulling.h"
+
+class ThreadPool;
+
+// Кластерное освещение: пирамида видимости делится на сетку кластеров (тайлы экрана x слои
+// по глубине, слои растут в геометрической прогрессии), и для каждого кластера на CPU
+// строится список точечных источников, сферы которых его задевают. Пиксельный шейдер находит
+// свой кластер по SV_Position и перебирает только его список, а не все источники сцены.
+
+// Точечный источник: за радиусом вклад равен нулю, поэтому он нужен только задетым кластерам.
+// 32 байта - элемент StructuredBuffer<PointLight> в pixelShaderCode.
+struct PointLight {
+    DirectX::XMFLOAT3 position; // в мировых координатах
+    float radius;
+    DirectX::XMFLOAT3 color;
+    float padding;
+};
+
+// Ослабление с расстоянием: (1 - d^2 / r^2)^2, плавно до нуля на радиусе. Та же формула в шейдере.
+inline float ComputeLightAttenuation(float distanceSq, float radius) {
+    const float falloff = 1.0f - distanceSq / (radius * radius);
+    return falloff > 0.0f ? falloff * falloff : 0.0f;
+}
+
+struct LightClusterDesc {
+    uint32_t tilesX = 16;
+    uint32_t tilesY = 9;
+    uint32_t slices = 24;
+    float nearZ = 0.1f;
+    float farZ = 1000.0f;
+    float tanHalfFovX = 1.0f;
+    float tanHalfFovY = 1.0f;
+
+    uint32_t GetClusterCount() const { return tilesX * tilesY * slices; }
+};
+
+// Сетка для перспективной проекции DirectXMath (углы обзора берутся из нее)
+LightClusterDesc MakeLightClusterDesc(DirectX::FXMMATRIX projection, float nearZ, float farZ,
+    uint32_t tilesX = 16, uint32_t tilesY = 9, uint32_t slices = 24);
+
+// Список кластера в общем массиве индексов - элемент StructuredBuffer<uint2>
+struct LightClusterRange {
+    uint32_t offset;
+    uint32_t count;
+};
+
+class LightClusterGrid {
+public:
+    // Границы кластеров зависят только от проекции - пересчитываются здесь, а не каждый кадр
+    void Configure(const LightClusterDesc& desc);
+    const LightClusterDesc& GetDesc() const { return m_desc; }
+
+    // Списки источников кадра. Проверки сфер с кластерами идут по 8 (AVX2) или 4 (SSE2)
+    // источника сразу; с пулом слои по глубине раздаются потокам. Результат не зависит
+    // ни от пути, ни от числа потоков: в каждом списке индексы по возрастанию.
+    void Build(DirectX::FXMMATRIX view, const PointLight* pLights, uint32_t lightCount, CullPath path, ThreadPool* pThreadPool);
+
+    uint32_t GetClusterIndex(uint32_t tileX, uint32_t tileY, uint32_t slice) const {
+        return (slice * m_desc.tilesY + tileY) * m_desc.tilesX + tileX;
+    }
+    // Слой по глубине в пространстве вида: log(z) * scale + bias, как в шейдере
+    float GetSliceScale() const { return m_sliceScale; }
+    float GetSliceBias() const { return m_sliceBias; }
+    // Кластер точки в пространстве вида; false, если точка вне сетки
+    bool FindCluster(const DirectX::XMFLOAT3& viewPosition, uint32_t& cluster) const;
+
+    const LightClusterRange* GetClusters() const { return m_clusters.data(); }
+    const uint32_t* GetLightIndices() const { return m_lightIndices.data(); }
+    uint32_t GetLightIndexCount() const { return static_cast<uint32_t>(m_lightIndices.size()); }
+
+private:
+    // Рабочие массивы одного слоя: у каждого потока свои
+    struct SliceWork {
+        std::vector<uint32_t> candidates; // источники, задевающие слой по глубине
+        std::vector<uint32_t> tileRects;  // x0, x1, y0, y1 каждого кандидата
+        std::vector<float> rowX, rowY, rowZ, rowRadiusSq;
+        std::vector<uint32_t> rowLights;
+        std::vector<uint32_t> indices;
+        uint32_t indexCount = 0;
+    };
+
+    void BuildSlice(uint32_t slice, CullPath path);
+
+    LightClusterDesc m_desc;
+    float m_sliceScale = 0.0f;
+    float m_sliceBias = 0.0f;
+    std::vector<float> m_sliceDepths; // границы слоев, slices + 1
+    // AABB кластеров в пространстве вида
+    std::vector<DirectX::XMFLOAT3> m_clusterMin;
+    std::vector<DirectX::XMFLOAT3> m_clusterMax;
+
+    // Источники кадра в пространстве вида, по полям
+    std::vector<float> m_lightX;
+    std::vector<float> m_lightY;
+    std::vector<float> m_lightZ;
+    std::vector<float> m_lightRadius;
+
+    std::vector<SliceWork> m_sliceWork;
+    std::vector<LightClusterRange> m_clusters;
+    std::vector<uint32_t> m_lightIndices;
+};
+
+struct LightClusterBuildResult {
+    uint32_t lightCount = 0;
+    CullPath path = CullPath::Scalar;
+    unsigned threadCount = 1;
+    double milliseconds = 0;
+    uint32_t indexCount = 0;
+    size_t mismatchCount = 0; // отличия списков от скалярного пути в одном потоке
+};
+
+struct LightShadingResult {
+    uint32_t lightCount = 0;
+    double lightsPerPixel = 0;     // источников в списке кластера пикселя, в среднем
+    double clusteredMilliseconds = 0;
+    double naiveMilliseconds = 0;  // перебор всех источников, как цикл по lights[] в pixelShaderCode
+    double maxDifference = 0;      // между освещенностью по спискам и по всем источникам
+};
+
+// Источники в объеме перед камерой (60 градусов, 16:9), для каждого числа источников:
+// построение списков на всех путях в одном потоке и в пуле, затем освещение 320x180
+// тестовых пикселей на CPU по спискам кластеров и перебором всех источников
+void RunLightClusterBenchmark(const uint32_t* pLightCounts, uint32_t countCount, uint32_t repeatCount, ThreadPool* pThreadPool,
+    std::vector<LightClusterBuildResult>& buildResults, std::vector<LightShadingResult>& shadingResults, uint32_t seed = 1);
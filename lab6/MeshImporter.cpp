@@ -0,0 +1,1608 @@
+﻿#include "MeshImporter.h"
+#include "FileIO.h"
+#include "Hash.h"
+#include "MeshOptimizer.h"
+#include "ThreadPool.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+
+using namespace DirectX;
+
+// Углы треугольников, как их записал разборщик: индексы в массивы атрибутов файла
+struct MeshImporter::Corners {
+    static constexpr uint32_t kNone = 0xFFFFFFFFu;
+
+    std::vector<XMFLOAT3> positions;
+    std::vector<XMFLOAT3> normals;
+    std::vector<XMFLOAT2> uvs;
+    std::vector<uint32_t> positionIndices;  // по три на треугольник
+    std::vector<uint32_t> normalIndices;    // kNone - нормали в файле нет
+    std::vector<uint32_t> uvIndices;        // kNone - текстурных координат нет
+};
+
+namespace {
+
+typedef MeshImporter::Corners Corners;
+
+const uint32_t kGrain = 16384;
+const size_t kObjChunkSize = 1 << 20;
+const uint32_t kWeldPartitionBits = 6;
+const uint32_t kWeldPartitionCount = 1u << kWeldPartitionBits;
+
+void ParallelRanges(ThreadPool* pThreadPool, uint32_t count, uint32_t grainSize, const std::function<void(uint32_t begin, uint32_t end)>& fn) {
+    if (count == 0) {
+        return;
+    }
+    if (pThreadPool && count > grainSize) {
+        pThreadPool->ParallelFor(count, grainSize, fn);
+    }
+    else {
+        fn(0, count);
+    }
+}
+
+double MillisecondsSince(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+// ---------------------------------------------------------------------------------------------
+// Числа
+
+inline bool IsSpace(char c) {
+    return c == ' ' || c == '\t' || c == '\r';
+}
+
+inline bool IsDigit(char c) {
+    return c >= '0' && c <= '9';
+}
+
+inline const char* SkipSpaces(const char* p, const char* pEnd) {
+    while (p < pEnd && IsSpace(*p)) {
+        p++;
+    }
+    return p;
+}
+
+// Десятичное число с необязательными дробной частью и порядком, без учета локали.
+// Старше 19 значащих цифр отбрасываются - для float этого с запасом
+const char* ParseNumber(const char* p, const char* pEnd, double& value) {
+    static const double kPowersOf10[] = {
+        1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+        1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+    };
+
+    bool negative = false;
+    if (p < pEnd && (*p == '-' || *p == '+')) {
+        negative = *p == '-';
+        p++;
+    }
+    uint64_t mantissa = 0;
+    int digitCount = 0;
+    int exponent = 0;
+    bool anyDigit = false;
+    for (; p < pEnd && IsDigit(*p); p++) {
+        anyDigit = true;
+        if (digitCount < 19) {
+            mantissa = mantissa * 10 + static_cast<uint32_t>(*p - '0');
+            digitCount += mantissa != 0 ? 1 : 0;
+        }
+        else {
+            exponent++;
+        }
+    }
+    if (p < pEnd && *p == '.') {
+        for (p++; p < pEnd && IsDigit(*p); p++) {
+            anyDigit = true;
+            if (digitCount < 19) {
+                mantissa = mantissa * 10 + static_cast<uint32_t>(*p - '0');
+                digitCount += mantissa != 0 ? 1 : 0;
+                exponent--;
+            }
+        }
+    }
+    if (!anyDigit) {
+        return nullptr;
+    }
+    if (p < pEnd && (*p == 'e' || *p == 'E')) {
+        p++;
+        bool negativeExponent = false;
+        if (p < pEnd && (*p == '-' || *p == '+')) {
+            negativeExponent = *p == '-';
+            p++;
+        }
+        if (p >= pEnd || !IsDigit(*p)) {
+            return nullptr;
+        }
+        int exponentValue = 0;
+        for (; p < pEnd && IsDigit(*p); p++) {
+            if (exponentValue < 10000) {
+                exponentValue = exponentValue * 10 + (*p - '0');
+            }
+        }
+        exponent += negativeExponent ? -exponentValue : exponentValue;
+    }
+
+    double result = static_cast<double>(mantissa);
+    if (mantissa != 0 && exponent != 0) {
+        if (exponent > 0 && exponent <= 22) {
+            result *= kPowersOf10[exponent];
+        }
+        else if (exponent < 0 && exponent >= -22) {
+            result /= kPowersOf10[-exponent];
+        }
+        else {
+            result *= std::pow(10.0, exponent);
+        }
+    }
+    value = negative ? -result : result;
+    return p;
+}
+
+// Число в строке OBJ: после него пробел или конец строки
+const char* ParseObjFloat(const char* p, const char* pEnd, float& value) {
+    double number = 0;
+    p = ParseNumber(SkipSpaces(p, pEnd), pEnd, number);
+    if (!p || (p < pEnd && !IsSpace(*p))) {
+        return nullptr;
+    }
+    value = static_cast<float>(number);
+    return p;
+}
+
+const char* ParseInteger(const char* p, const char* pEnd, int64_t& value) {
+    bool negative = false;
+    if (p < pEnd && (*p == '-' || *p == '+')) {
+        negative = *p == '-';
+        p++;
+    }
+    if (p >= pEnd || !IsDigit(*p)) {
+        return nullptr;
+    }
+    int64_t result = 0;
+    for (; p < pEnd && IsDigit(*p); p++) {
+        if (result < (int64_t(1) << 40)) {
+            result = result * 10 + (*p - '0');
+        }
+    }
+    value = negative ? -result : result;
+    return p;
+}
+
+// ---------------------------------------------------------------------------------------------
+// OBJ: файл режется на куски по границам строк. Первый проход считает v, vt, vn и углы
+// треугольников в каждом куске, префиксные суммы дают куску места в общих массивах,
+// второй проход пишет туда разобранные данные. Оба прохода идут по кускам параллельно.
+
+struct ObjChunk {
+    const char* pBegin = nullptr;
+    const char* pEnd = nullptr;
+    uint32_t lineCount = 0;
+    uint32_t positionCount = 0;
+    uint32_t uvCount = 0;
+    uint32_t normalCount = 0;
+    uint64_t cornerCount = 0;
+    uint32_t lineBase = 0;
+    uint32_t positionBase = 0;
+    uint32_t uvBase = 0;
+    uint32_t normalBase = 0;
+    uint32_t cornerBase = 0;
+    std::string error;
+};
+
+enum ObjLineType {
+    kObjOther,
+    kObjPosition,
+    kObjUv,
+    kObjNormal,
+    kObjFace
+};
+
+// pLine - первый непробельный символ строки, возвращается начало данных после ключевого слова
+ObjLineType GetObjLineType(const char*& pLine, const char* pLineEnd) {
+    const char* p = pLine;
+    const ptrdiff_t length = pLineEnd - p;
+    if (length >= 2 && p[0] == 'v') {
+        if (IsSpace(p[1])) {
+            pLine = p + 1;
+            return kObjPosition;
+        }
+        if (length >= 3 && IsSpace(p[2])) {
+            pLine = p + 2;
+            return p[1] == 't' ? kObjUv : (p[1] == 'n' ? kObjNormal : kObjOther);
+        }
+    }
+    else if (length >= 2 && p[0] == 'f' && IsSpace(p[1])) {
+        pLine = p + 1;
+        return kObjFace;
+    }
+    return kObjOther;
+}
+
+const char* FindLineEnd(const char* p, const char* pEnd) {
+    const char* pNewLine = static_cast<const char*>(memchr(p, '\n', pEnd - p));
+    return pNewLine ? pNewLine : pEnd;
+}
+
+void CountObjChunk(ObjChunk& chunk) {
+    for (const char* p = chunk.pBegin; p < chunk.pEnd;) {
+        const char* pLineEnd = FindLineEnd(p, chunk.pEnd);
+        const char* pLine = SkipSpaces(p, pLineEnd);
+        switch (GetObjLineType(pLine, pLineEnd)) {
+        case kObjPosition:
+            chunk.positionCount++;
+            break;
+        case kObjUv:
+            chunk.uvCount++;
+            break;
+        case kObjNormal:
+            chunk.normalCount++;
+            break;
+        case kObjFace: {
+            uint32_t vertexCount = 0;
+            for (const char* q = SkipSpaces(pLine, pLineEnd); q < pLineEnd; q = SkipSpaces(q, pLineEnd)) {
+                vertexCount++;
+                while (q < pLineEnd && !IsSpace(*q)) {
+                    q++;
+                }
+            }
+            // Многоугольник разбивается веером
+            chunk.cornerCount += vertexCount >= 3 ? (vertexCount - 2) * 3 : 0;
+            break;
+        }
+        default:
+            break;
+        }
+        chunk.lineCount++;
+        p = pLineEnd + 1;
+    }
+}
+
+// Индексы OBJ начинаются с 1, отрицательные отсчитываются от последнего объявленного элемента
+bool ResolveObjIndex(int64_t index, uint32_t declaredCount, uint32_t totalCount, uint32_t& result) {
+    if (index > 0 && index <= totalCount) {
+        result = static_cast<uint32_t>(index - 1);
+        return true;
+    }
+    if (index < 0 && -index <= declaredCount) {
+        result = static_cast<uint32_t>(declaredCount + index);
+        return true;
+    }
+    return false;
+}
+
+struct ObjFaceVertex {
+    uint32_t position;
+    uint32_t uv;
+    uint32_t normal;
+};
+
+bool ParseObjChunk(ObjChunk& chunk, Corners& corners) {
+    const uint32_t totalPositions = static_cast<uint32_t>(corners.positions.size());
+    const uint32_t totalUvs = static_cast<uint32_t>(corners.uvs.size());
+    const uint32_t totalNormals = static_cast<uint32_t>(corners.normals.size());
+    uint32_t position = chunk.positionBase;
+    uint32_t uv = chunk.uvBase;
+    uint32_t normal = chunk.normalBase;
+    uint32_t corner = chunk.cornerBase;
+    uint32_t line = chunk.lineBase;
+    char message[96];
+
+    for (const char* p = chunk.pBegin; p < chunk.pEnd; line++) {
+        const char* pLineEnd = FindLineEnd(p, chunk.pEnd);
+        const char* q = SkipSpaces(p, pLineEnd);
+        const char* pError = nullptr;
+        switch (GetObjLineType(q, pLineEnd)) {
+        case kObjPosition: {
+            XMFLOAT3& value = corners.positions[position++];
+            if ((q = ParseObjFloat(q, pLineEnd, value.x)) && (q = ParseObjFloat(q, pLineEnd, value.y)) &&
+                (q = ParseObjFloat(q, pLineEnd, value.z))) {
+                value.z = -value.z;
+            }
+            else {
+                pError = "bad vertex position";
+            }
+            break;
+        }
+        case kObjUv: {
+            XMFLOAT2& value = corners.uvs[uv++];
+            value.y = 0;
+            if ((q = ParseObjFloat(q, pLineEnd, value.x)) != nullptr) {
+                // v необязательна
+                if (SkipSpaces(q, pLineEnd) < pLineEnd && !ParseObjFloat(q, pLineEnd, value.y)) {
+                    pError = "bad texture coordinate";
+                }
+                value.y = 1.0f - value.y;
+            }
+            else {
+                pError = "bad texture coordinate";
+            }
+            break;
+        }
+        case kObjNormal: {
+            XMFLOAT3& value = corners.normals[normal++];
+            if ((q = ParseObjFloat(q, pLineEnd, value.x)) && (q = ParseObjFloat(q, pLineEnd, value.y)) &&
+                (q = ParseObjFloat(q, pLineEnd, value.z))) {
+                value.z = -value.z;
+            }
+            else {
+                pError = "bad vertex normal";
+            }
+            break;
+        }
+        case kObjFace: {
+            ObjFaceVertex first = {};
+            ObjFaceVertex previous = {};
+            uint32_t vertexCount = 0;
+            for (q = SkipSpaces(q, pLineEnd); q < pLineEnd && !pError; q = SkipSpaces(q, pLineEnd)) {
+                // v, v/vt, v//vn или v/vt/vn
+                int64_t positionIndex = 0;
+                int64_t uvIndex = 0;
+                int64_t normalIndex = 0;
+                q = ParseInteger(q, pLineEnd, positionIndex);
+                if (q && q < pLineEnd && *q == '/') {
+                    q++;
+                    if (q < pLineEnd && *q != '/') {
+                        q = ParseInteger(q, pLineEnd, uvIndex);
+                    }
+                    if (q && q < pLineEnd && *q == '/') {
+                        q = ParseInteger(q + 1, pLineEnd, normalIndex);
+                    }
+                }
+                ObjFaceVertex vertex = { Corners::kNone, Corners::kNone, Corners::kNone };
+                if (!q || (q < pLineEnd && !IsSpace(*q)) ||
+                    !ResolveObjIndex(positionIndex, position, totalPositions, vertex.position) ||
+                    (uvIndex != 0 && !ResolveObjIndex(uvIndex, uv, totalUvs, vertex.uv)) ||
+                    (normalIndex != 0 && !ResolveObjIndex(normalIndex, normal, totalNormals, vertex.normal))) {
+                    pError = "bad face index";
+                    break;
+                }
+
+                if (vertexCount == 0) {
+                    first = vertex;
+                }
+                else if (vertexCount >= 2) {
+                    // Треугольник веера (first, previous, vertex) с обратным обходом
+                    const ObjFaceVertex triangle[3] = { first, vertex, previous };
+                    for (const ObjFaceVertex& triangleVertex : triangle) {
+                        corners.positionIndices[corner] = triangleVertex.position;
+                        corners.uvIndices[corner] = triangleVertex.uv;
+                        corners.normalIndices[corner] = triangleVertex.normal;
+                        corner++;
+                    }
+                }
+                previous = vertex;
+                vertexCount++;
+            }
+            if (!pError && vertexCount < 3) {
+                pError = "face with fewer than 3 vertices";
+            }
+            break;
+        }
+        default:
+            break;
+        }
+        if (pError) {
+            snprintf(message, sizeof(message), "%s at line %u", pError, line + 1);
+            chunk.error = message;
+            return false;
+        }
+        p = pLineEnd + 1;
+    }
+    return true;
+}
+
+// ---------------------------------------------------------------------------------------------
+// JSON для glTF: дерево значений целиком в памяти, файлы glTF небольшие - данные в буферах
+
+struct JsonValue {
+    enum Type {
+        kNull,
+        kBool,
+        kNumber,
+        kString,
+        kArray,
+        kObject
+    };
+
+    Type type = kNull;
+    double number = 0;
+    std::string text;
+    std::vector<JsonValue> items;
+    std::vector<std::pair<std::string, JsonValue>> members;
+
+    const JsonValue* Find(const char* key) const {
+        for (const auto& member : members) {
+            if (member.first == key) {
+                return &member.second;
+            }
+        }
+        return nullptr;
+    }
+
+    int64_t GetInteger(const char* key, int64_t defaultValue) const {
+        const JsonValue* pValue = Find(key);
+        return pValue && pValue->type == kNumber ? static_cast<int64_t>(pValue->number) : defaultValue;
+    }
+
+    const std::string* GetString(const char* key) const {
+        const JsonValue* pValue = Find(key);
+        return pValue && pValue->type == kString ? &pValue->text : nullptr;
+    }
+
+    // Элемент массива верхнего уровня ("accessors", "bufferViews", ...) или nullptr
+    const JsonValue* GetItem(const char* key, int64_t index) const {
+        const JsonValue* pArray = Find(key);
+        if (!pArray || pArray->type != kArray || index < 0 || index >= static_cast<int64_t>(pArray->items.size())) {
+            return nullptr;
+        }
+        return &pArray->items[static_cast<size_t>(index)];
+    }
+};
+
+class JsonReader {
+public:
+    JsonReader(const char* p, const char* pEnd) : m_p(p), m_pEnd(pEnd) {}
+
+    bool Read(JsonValue& value) {
+        if (!ReadValue(value, 0)) {
+            return false;
+        }
+        SkipSpaces();
+        return m_p == m_pEnd;
+    }
+
+private:
+    static const int kMaxDepth = 64;
+
+    void SkipSpaces() {
+        while (m_p < m_pEnd && (*m_p == ' ' || *m_p == '\t' || *m_p == '\r' || *m_p == '\n')) {
+            m_p++;
+        }
+    }
+
+    bool Expect(const char* word) {
+        const size_t length = strlen(word);
+        if (static_cast<size_t>(m_pEnd - m_p) < length || memcmp(m_p, word, length) != 0) {
+            return false;
+        }
+        m_p += length;
+        return true;
+    }
+
+    static void AppendUtf8(std::string& text, uint32_t code) {
+        if (code < 0x80) {
+            text += static_cast<char>(code);
+        }
+        else if (code < 0x800) {
+            text += static_cast<char>(0xC0 | (code >> 6));
+            text += static_cast<char>(0x80 | (code & 0x3F));
+        }
+        else {
+            text += static_cast<char>(0xE0 | (code >> 12));
+            text += static_cast<char>(0x80 | ((code >> 6) & 0x3F));
+            text += static_cast<char>(0x80 | (code & 0x3F));
+        }
+    }
+
+    bool ReadString(std::string& text) {
+        if (m_p >= m_pEnd || *m_p != '"') {
+            return false;
+        }
+        for (m_p++; m_p < m_pEnd; m_p++) {
+            const char c = *m_p;
+            if (c == '"') {
+                m_p++;
+                return true;
+            }
+            if (c != '\\') {
+                text += c;
+                continue;
+            }
+            if (++m_p >= m_pEnd) {
+                return false;
+            }
+            switch (*m_p) {
+            case 'b': text += '\b'; break;
+            case 'f': text += '\f'; break;
+            case 'n': text += '\n'; break;
+            case 'r': text += '\r'; break;
+            case 't': text += '\t'; break;
+            case 'u': {
+                // Суррогатные пары в именах glTF не встречаются на практике и остаются как есть
+                if (m_pEnd - m_p < 5) {
+                    return false;
+                }
+                uint32_t code = 0;
+                for (int i = 1; i <= 4; i++) {
+                    const char h = m_p[i];
+                    const int digit = IsDigit(h) ? h - '0' : (h >= 'a' && h <= 'f') ? h - 'a' + 10 : (h >= 'A' && h <= 'F') ? h - 'A' + 10 : -1;
+                    if (digit < 0) {
+                        return false;
+                    }
+                    code = code * 16 + static_cast<uint32_t>(digit);
+                }
+                AppendUtf8(text, code);
+                m_p += 4;
+                break;
+            }
+            default:
+                text += *m_p;
+                break;
+            }
+        }
+        return false;
+    }
+
+    bool ReadValue(JsonValue& value, int depth) {
+        SkipSpaces();
+        if (m_p >= m_pEnd || depth > kMaxDepth) {
+            return false;
+        }
+        switch (*m_p) {
+        case '{':
+            value.type = JsonValue::kObject;
+            m_p++;
+            SkipSpaces();
+            if (m_p < m_pEnd && *m_p == '}') {
+                m_p++;
+                return true;
+            }
+            for (;;) {
+                SkipSpaces();
+                value.members.emplace_back();
+                if (!ReadString(value.members.back().first)) {
+                    return false;
+                }
+                SkipSpaces();
+                if (m_p >= m_pEnd || *m_p++ != ':' || !ReadValue(value.members.back().second, depth + 1)) {
+                    return false;
+                }
+                SkipSpaces();
+                if (m_p < m_pEnd && *m_p == ',') {
+                    m_p++;
+                    continue;
+                }
+                return m_p < m_pEnd && *m_p++ == '}';
+            }
+        case '[':
+            value.type = JsonValue::kArray;
+            m_p++;
+            SkipSpaces();
+            if (m_p < m_pEnd && *m_p == ']') {
+                m_p++;
+                return true;
+            }
+            for (;;) {
+                value.items.emplace_back();
+                if (!ReadValue(value.items.back(), depth + 1)) {
+                    return false;
+                }
+                SkipSpaces();
+                if (m_p < m_pEnd && *m_p == ',') {
+                    m_p++;
+                    continue;
+                }
+                return m_p < m_pEnd && *m_p++ == ']';
+            }
+        case '"':
+            value.type = JsonValue::kString;
+            return ReadString(value.text);
+        case 't':
+            value.type = JsonValue::kBool;
+            value.number = 1;
+            return Expect("true");
+        case 'f':
+            value.type = JsonValue::kBool;
+            return Expect("false");
+        case 'n':
+            return Expect("null");
+        default:
+            value.type = JsonValue::kNumber;
+            m_p = ParseNumber(m_p, m_pEnd, value.number);
+            return m_p != nullptr;
+        }
+    }
+
+    const char* m_p;
+    const char* m_pEnd;
+};
+
+// ---------------------------------------------------------------------------------------------
+// glTF
+
+const uint32_t kGlbMagic = 0x46546C67;      // "glTF"
+const uint32_t kGlbChunkJson = 0x4E4F534A;  // "JSON"
+const uint32_t kGlbChunkBin = 0x004E4942;   // "BIN\0"
+
+const uint32_t kGltfByte = 5120;
+const uint32_t kGltfUnsignedByte = 5121;
+const uint32_t kGltfShort = 5122;
+const uint32_t kGltfUnsignedShort = 5123;
+const uint32_t kGltfUnsignedInt = 5125;
+const uint32_t kGltfFloat = 5126;
+const int64_t kGltfTriangles = 4;
+
+uint32_t ReadUint32(const uint8_t* p) {
+    uint32_t value;
+    memcpy(&value, p, sizeof(value));
+    return value;
+}
+
+struct GltfBuffer {
+    const uint8_t* pData = nullptr;
+    size_t size = 0;
+};
+
+struct GltfAccessor {
+    const uint8_t* pData = nullptr;
+    uint32_t count = 0;
+    uint32_t stride = 0;
+    uint32_t componentType = 0;
+    uint32_t componentCount = 0;
+    bool normalized = false;
+};
+
+uint32_t GetGltfComponentSize(uint32_t componentType) {
+    switch (componentType) {
+    case kGltfByte:
+    case kGltfUnsignedByte:
+        return 1;
+    case kGltfShort:
+    case kGltfUnsignedShort:
+        return 2;
+    case kGltfUnsignedInt:
+    case kGltfFloat:
+        return 4;
+    default:
+        return 0;
+    }
+}
+
+uint32_t GetGltfComponentCount(const std::string& type) {
+    if (type == "SCALAR") {
+        return 1;
+    }
+    if (type.size() == 4 && type.compare(0, 3, "VEC") == 0 && type[3] >= '2' && type[3] <= '4') {
+        return static_cast<uint32_t>(type[3] - '0');
+    }
+    return 0;
+}
+
+bool DecodeBase64(const char* p, size_t size, std::vector<uint8_t>& data) {
+    uint32_t bits = 0;
+    int bitCount = 0;
+    data.reserve(size / 4 * 3);
+    for (size_t i = 0; i < size; i++) {
+        const char c = p[i];
+        int digit;
+        if (c >= 'A' && c <= 'Z') {
+            digit = c - 'A';
+        }
+        else if (c >= 'a' && c <= 'z') {
+            digit = c - 'a' + 26;
+        }
+        else if (IsDigit(c)) {
+            digit = c - '0' + 52;
+        }
+        else if (c == '+') {
+            digit = 62;
+        }
+        else if (c == '/') {
+            digit = 63;
+        }
+        else if (c == '=') {
+            break;
+        }
+        else {
+            return false;
+        }
+        bits = (bits << 6) | static_cast<uint32_t>(digit);
+        bitCount += 6;
+        if (bitCount >= 8) {
+            bitCount -= 8;
+            data.push_back(static_cast<uint8_t>(bits >> bitCount));
+        }
+    }
+    return true;
+}
+
+// URI относительного пути: %XX раскрываются, UTF-8 переводится в UTF-16
+std::wstring DecodeUriPath(const std::string& uri) {
+    std::string bytes;
+    for (size_t i = 0; i < uri.size(); i++) {
+        if (uri[i] == '%' && i + 2 < uri.size()) {
+            const std::string hex = uri.substr(i + 1, 2);
+            char* pEnd = nullptr;
+            const long value = strtol(hex.c_str(), &pEnd, 16);
+            if (pEnd == hex.c_str() + 2) {
+                bytes += static_cast<char>(value);
+                i += 2;
+                continue;
+            }
+        }
+        bytes += uri[i];
+    }
+
+    std::wstring path;
+    for (size_t i = 0; i < bytes.size();) {
+        const uint8_t c = static_cast<uint8_t>(bytes[i]);
+        const size_t length = c < 0x80 ? 1 : (c >> 5) == 6 ? 2 : (c >> 4) == 14 ? 3 : 1;
+        uint32_t code = length == 1 ? c : length == 2 ? (c & 0x1Fu) : (c & 0x0Fu);
+        for (size_t k = 1; k < length && i + k < bytes.size(); k++) {
+            code = (code << 6) | (static_cast<uint8_t>(bytes[i + k]) & 0x3Fu);
+        }
+        path += static_cast<wchar_t>(code);
+        i += length;
+    }
+    return path;
+}
+
+bool GetGltfAccessor(const JsonValue& root, int64_t index, const std::vector<GltfBuffer>& buffers, GltfAccessor& accessor, std::string& error) {
+    const JsonValue* pAccessor = root.GetItem("accessors", index);
+    if (!pAccessor) {
+        error = "missing accessor";
+        return false;
+    }
+    const std::string* pType = pAccessor->GetString("type");
+    accessor.componentType = static_cast<uint32_t>(pAccessor->GetInteger("componentType", 0));
+    accessor.componentCount = pType ? GetGltfComponentCount(*pType) : 0;
+    const uint32_t componentSize = GetGltfComponentSize(accessor.componentType);
+    const int64_t count = pAccessor->GetInteger("count", -1);
+    if (componentSize == 0 || accessor.componentCount == 0 || count < 0 || count > 0x7FFFFFFF) {
+        error = "bad accessor";
+        return false;
+    }
+    if (pAccessor->Find("sparse")) {
+        error = "sparse accessors are not supported";
+        return false;
+    }
+    const JsonValue* pNormalized = pAccessor->Find("normalized");
+    accessor.normalized = pNormalized && pNormalized->type == JsonValue::kBool && pNormalized->number != 0;
+    accessor.count = static_cast<uint32_t>(count);
+
+    const JsonValue* pView = root.GetItem("bufferViews", pAccessor->GetInteger("bufferView", -1));
+    if (!pView) {
+        error = "accessor without buffer view";
+        return false;
+    }
+    const int64_t bufferIndex = pView->GetInteger("buffer", -1);
+    const int64_t viewOffset = pView->GetInteger("byteOffset", 0);
+    const int64_t viewLength = pView->GetInteger("byteLength", -1);
+    const int64_t accessorOffset = pAccessor->GetInteger("byteOffset", 0);
+    const uint32_t elementSize = componentSize * accessor.componentCount;
+    const int64_t stride = pView->GetInteger("byteStride", elementSize);
+    if (bufferIndex < 0 || bufferIndex >= static_cast<int64_t>(buffers.size()) || viewOffset < 0 || viewLength < 0 ||
+        accessorOffset < 0 || stride < elementSize || stride > 252) {
+        error = "bad buffer view";
+        return false;
+    }
+    const GltfBuffer& buffer = buffers[static_cast<size_t>(bufferIndex)];
+    const int64_t used = count > 0 ? accessorOffset + stride * (count - 1) + elementSize : 0;
+    if (viewOffset + viewLength > static_cast<int64_t>(buffer.size) || used > viewLength) {
+        error = "accessor is out of buffer bounds";
+        return false;
+    }
+    accessor.pData = buffer.pData + viewOffset + accessorOffset;
+    accessor.stride = static_cast<uint32_t>(stride);
+    return true;
+}
+
+// Компоненты элемента как float: float как есть, нормализованные целые без знака - в [0, 1]
+void ReadGltfFloats(const GltfAccessor& accessor, uint32_t index, float* pValues) {
+    const uint8_t* p = accessor.pData + static_cast<size_t>(index) * accessor.stride;
+    for (uint32_t c = 0; c < accessor.componentCount; c++) {
+        switch (accessor.componentType) {
+        case kGltfFloat:
+            memcpy(&pValues[c], p + c * 4, 4);
+            break;
+        case kGltfUnsignedByte:
+            pValues[c] = p[c] / 255.0f;
+            break;
+        case kGltfUnsignedShort: {
+            uint16_t value;
+            memcpy(&value, p + c * 2, 2);
+            pValues[c] = value / 65535.0f;
+            break;
+        }
+        default:
+            pValues[c] = 0;
+            break;
+        }
+    }
+}
+
+uint32_t ReadGltfIndex(const GltfAccessor& accessor, uint32_t index) {
+    const uint8_t* p = accessor.pData + static_cast<size_t>(index) * accessor.stride;
+    switch (accessor.componentType) {
+    case kGltfUnsignedByte:
+        return *p;
+    case kGltfUnsignedShort: {
+        uint16_t value;
+        memcpy(&value, p, 2);
+        return value;
+    }
+    default:
+        return ReadUint32(p);
+    }
+}
+
+// ---------------------------------------------------------------------------------------------
+// Сварка
+
+inline uint32_t FloatKey(float value) {
+    // -0 и +0 - одна вершина
+    value += 0.0f;
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    return bits;
+}
+
+// Ключ кратен 8 байтам: Hash64 не хеширует хвост побайтно
+const uint32_t kCornerKeySize = 10;
+
+// Позиция, нормаль, текстурные координаты и знак развертки угла
+void GetCornerKey(const Corners& corners, const uint8_t* pMirrored, uint32_t corner, uint32_t key[kCornerKeySize]) {
+    const XMFLOAT3& position = corners.positions[corners.positionIndices[corner]];
+    const XMFLOAT3& normal = corners.normals[corners.normalIndices[corner]];
+    const uint32_t uvIndex = corners.uvIndices[corner];
+    const XMFLOAT2 uv = uvIndex != Corners::kNone ? corners.uvs[uvIndex] : XMFLOAT2(0, 0);
+    key[0] = FloatKey(position.x);
+    key[1] = FloatKey(position.y);
+    key[2] = FloatKey(position.z);
+    key[3] = FloatKey(normal.x);
+    key[4] = FloatKey(normal.y);
+    key[5] = FloatKey(normal.z);
+    key[6] = FloatKey(uv.x);
+    key[7] = FloatKey(uv.y);
+    key[8] = pMirrored[corner];
+    key[9] = 0;
+}
+
+float GetCornerAngle(FXMVECTOR corner, FXMVECTOR a, FXMVECTOR b) {
+    const XMVECTOR edgeA = XMVectorSubtract(a, corner);
+    const XMVECTOR edgeB = XMVectorSubtract(b, corner);
+    const float lengths = XMVectorGetX(XMVector3Length(edgeA)) * XMVectorGetX(XMVector3Length(edgeB));
+    if (!(lengths > 1e-30f)) {
+        return 0.0f;
+    }
+    const float cosine = XMVectorGetX(XMVector3Dot(edgeA, edgeB)) / lengths;
+    return std::acos(cosine < -1.0f ? -1.0f : (cosine > 1.0f ? 1.0f : cosine));
+}
+
+} // namespace
+
+bool MeshImporter::Fail(const std::string& message) {
+    m_error = message;
+    return false;
+}
+
+bool MeshImporter::Import(const std::wstring& filePath, ImportedMesh& mesh) {
+    std::wstring extension;
+    const size_t dot = filePath.find_last_of(L'.');
+    if (dot != std::wstring::npos) {
+        for (size_t i = dot + 1; i < filePath.size(); i++) {
+            const wchar_t c = filePath[i];
+            extension += (c >= L'A' && c <= L'Z') ? static_cast<wchar_t>(c - L'A' + L'a') : c;
+        }
+    }
+    if (extension != L"obj" && extension != L"gltf" && extension != L"glb") {
+        return Fail("unknown mesh file extension");
+    }
+
+    MappedFile file;
+    if (!file.Open(filePath)) {
+        return Fail(std::string("cannot open mesh file: ") + file.GetErrorMessage());
+    }
+    if (extension == L"obj") {
+        return ImportObj(file.GetData(), file.GetSize(), mesh);
+    }
+    const size_t slash = filePath.find_last_of(L"\\/");
+    const std::wstring baseDirectory = slash != std::wstring::npos ? filePath.substr(0, slash + 1) : std::wstring();
+    return ImportGltf(file.GetData(), file.GetSize(), baseDirectory, mesh);
+}
+
+bool MeshImporter::ImportObj(const void* pData, size_t size, ImportedMesh& mesh) {
+    const auto startTime = std::chrono::steady_clock::now();
+    m_stats = MeshImportStats();
+    m_stats.fileBytes = size;
+    m_error.clear();
+    mesh = ImportedMesh();
+
+    // Куски по границам строк
+    const char* pText = static_cast<const char*>(pData);
+    const char* pTextEnd = pText + size;
+    std::vector<ObjChunk> chunks;
+    for (const char* p = pText; p < pTextEnd;) {
+        const char* pEnd = p + (std::min)(kObjChunkSize, static_cast<size_t>(pTextEnd - p));
+        if (pEnd < pTextEnd) {
+            pEnd = FindLineEnd(pEnd, pTextEnd);
+            pEnd = pEnd < pTextEnd ? pEnd + 1 : pEnd;
+        }
+        chunks.emplace_back();
+        chunks.back().pBegin = p;
+        chunks.back().pEnd = pEnd;
+        p = pEnd;
+    }
+    const uint32_t chunkCount = static_cast<uint32_t>(chunks.size());
+    ParallelRanges(m_pThreadPool, chunkCount, 1, [&](uint32_t begin, uint32_t end) {
+        for (uint32_t i = begin; i < end; i++) {
+            CountObjChunk(chunks[i]);
+        }
+    });
+
+    uint64_t lineCount = 0;
+    uint64_t positionCount = 0;
+    uint64_t uvCount = 0;
+    uint64_t normalCount = 0;
+    uint64_t cornerCount = 0;
+    for (ObjChunk& chunk : chunks) {
+        chunk.lineBase = static_cast<uint32_t>(lineCount);
+        chunk.positionBase = static_cast<uint32_t>(positionCount);
+        chunk.uvBase = static_cast<uint32_t>(uvCount);
+        chunk.normalBase = static_cast<uint32_t>(normalCount);
+        chunk.cornerBase = static_cast<uint32_t>(cornerCount);
+        lineCount += chunk.lineCount;
+        positionCount += chunk.positionCount;
+        uvCount += chunk.uvCount;
+        normalCount += chunk.normalCount;
+        cornerCount += chunk.cornerCount;
+    }
+    if (cornerCount >= Corners::kNone || positionCount >= Corners::kNone || uvCount >= Corners::kNone ||
+        normalCount >= Corners::kNone || lineCount >= Corners::kNone) {
+        return Fail("mesh is too large");
+    }
+    if (cornerCount == 0) {
+        return Fail("no faces in OBJ file");
+    }
+
+    Corners corners;
+    corners.positions.resize(static_cast<size_t>(positionCount));
+    corners.uvs.resize(static_cast<size_t>(uvCount));
+    corners.normals.resize(static_cast<size_t>(normalCount));
+    corners.positionIndices.resize(static_cast<size_t>(cornerCount));
+    corners.uvIndices.resize(static_cast<size_t>(cornerCount));
+    corners.normalIndices.resize(static_cast<size_t>(cornerCount));
+    ParallelRanges(m_pThreadPool, chunkCount, 1, [&](uint32_t begin, uint32_t end) {
+        for (uint32_t i = begin; i < end; i++) {
+            ParseObjChunk(chunks[i], corners);
+        }
+    });
+    for (const ObjChunk& chunk : chunks) {
+        if (!chunk.error.empty()) {
+            return Fail(chunk.error);
+        }
+    }
+    m_stats.parseMilliseconds = MillisecondsSince(startTime);
+
+    const bool result = BuildMesh(corners, mesh);
+    m_stats.totalMilliseconds = MillisecondsSince(startTime);
+    return result;
+}
+
+bool MeshImporter::ImportGltf(const void* pData, size_t size, const std::wstring& baseDirectory, ImportedMesh& mesh) {
+    const auto startTime = std::chrono::steady_clock::now();
+    m_stats = MeshImportStats();
+    m_stats.fileBytes = size;
+    m_error.clear();
+    mesh = ImportedMesh();
+
+    // .glb: заголовок, кусок JSON и необязательный кусок BIN - буфер 0 без uri
+    const uint8_t* pBytes = static_cast<const uint8_t*>(pData);
+    const char* pJson = static_cast<const char*>(pData);
+    size_t jsonSize = size;
+    GltfBuffer binaryChunk;
+    if (size >= 12 && ReadUint32(pBytes) == kGlbMagic) {
+        if (ReadUint32(pBytes + 4) != 2) {
+            return Fail("unsupported GLB version");
+        }
+        const size_t length = (std::min)(static_cast<size_t>(ReadUint32(pBytes + 8)), size);
+        if (length < 20 || ReadUint32(pBytes + 16) != kGlbChunkJson || ReadUint32(pBytes + 12) > length - 20) {
+            return Fail("bad GLB JSON chunk");
+        }
+        pJson = reinterpret_cast<const char*>(pBytes + 20);
+        jsonSize = ReadUint32(pBytes + 12);
+        const size_t binOffset = 20 + ((jsonSize + 3) & ~size_t(3));
+        if (binOffset + 8 <= length && ReadUint32(pBytes + binOffset + 4) == kGlbChunkBin) {
+            const size_t binSize = ReadUint32(pBytes + binOffset);
+            if (binSize > length - binOffset - 8) {
+                return Fail("bad GLB binary chunk");
+            }
+            binaryChunk.pData = pBytes + binOffset + 8;
+            binaryChunk.size = binSize;
+        }
+    }
+
+    JsonValue root;
+    if (!JsonReader(pJson, pJson + jsonSize).Read(root) || root.type != JsonValue::kObject) {
+        return Fail("bad glTF JSON");
+    }
+
+    // Буферы: кусок BIN, data: URI в base64 или внешние файлы, отображенные в память
+    std::vector<GltfBuffer> buffers;
+    std::vector<std::vector<uint8_t>> decodedBuffers;
+    std::vector<MappedFile> bufferFiles;
+    if (const JsonValue* pBuffers = root.Find("buffers")) {
+        for (const JsonValue& bufferValue : pBuffers->items) {
+            GltfBuffer buffer;
+            const std::string* pUri = bufferValue.GetString("uri");
+            if (!pUri) {
+                if (!buffers.empty() || !binaryChunk.pData) {
+                    return Fail("buffer without uri");
+                }
+                buffer = binaryChunk;
+            }
+            else if (pUri->compare(0, 5, "data:") == 0) {
+                const size_t comma = pUri->find(',');
+                if (comma == std::string::npos || pUri->rfind(";base64", comma) == std::string::npos) {
+                    return Fail("unsupported data URI");
+                }
+                decodedBuffers.emplace_back();
+                if (!DecodeBase64(pUri->data() + comma + 1, pUri->size() - comma - 1, decodedBuffers.back())) {
+                    return Fail("bad base64 buffer");
+                }
+                buffer.pData = decodedBuffers.back().data();
+                buffer.size = decodedBuffers.back().size();
+            }
+            else {
+                bufferFiles.emplace_back();
+                if (!bufferFiles.back().Open(baseDirectory + DecodeUriPath(*pUri))) {
+                    return Fail("cannot open buffer " + *pUri + ": " + bufferFiles.back().GetErrorMessage());
+                }
+                buffer.pData = bufferFiles.back().GetData();
+                buffer.size = bufferFiles.back().GetSize();
+                m_stats.fileBytes += buffer.size;
+            }
+            const int64_t byteLength = bufferValue.GetInteger("byteLength", -1);
+            if (byteLength < 0 || static_cast<uint64_t>(byteLength) > buffer.size) {
+                return Fail("buffer is shorter than byteLength");
+            }
+            buffer.size = static_cast<size_t>(byteLength);
+            buffers.push_back(buffer);
+        }
+    }
+
+    Corners corners;
+    std::string error;
+    const JsonValue* pMeshes = root.Find("meshes");
+    for (size_t meshIndex = 0; pMeshes && meshIndex < pMeshes->items.size(); meshIndex++) {
+        const JsonValue* pPrimitives = pMeshes->items[meshIndex].Find("primitives");
+        for (size_t primitiveIndex = 0; pPrimitives && primitiveIndex < pPrimitives->items.size(); primitiveIndex++) {
+            const JsonValue& primitive = pPrimitives->items[primitiveIndex];
+            const JsonValue* pAttributes = primitive.Find("attributes");
+            if (primitive.GetInteger("mode", kGltfTriangles) != kGltfTriangles || !pAttributes) {
+                continue;
+            }
+
+            GltfAccessor positions;
+            GltfAccessor normals;
+            GltfAccessor uvs;
+            GltfAccessor indices;
+            const int64_t normalAccessor = pAttributes->GetInteger("NORMAL", -1);
+            const int64_t uvAccessor = pAttributes->GetInteger("TEXCOORD_0", -1);
+            const int64_t indexAccessor = primitive.GetInteger("indices", -1);
+            if (!GetGltfAccessor(root, pAttributes->GetInteger("POSITION", -1), buffers, positions, error) ||
+                (normalAccessor >= 0 && !GetGltfAccessor(root, normalAccessor, buffers, normals, error)) ||
+                (uvAccessor >= 0 && !GetGltfAccessor(root, uvAccessor, buffers, uvs, error)) ||
+                (indexAccessor >= 0 && !GetGltfAccessor(root, indexAccessor, buffers, indices, error))) {
+                return Fail(error);
+            }
+            const uint32_t vertexCount = positions.count;
+            if (positions.componentType != kGltfFloat || positions.componentCount != 3 ||
+                (normals.pData && (normals.componentType != kGltfFloat || normals.componentCount != 3 || normals.count != vertexCount)) ||
+                (uvs.pData && (uvs.componentCount != 2 || uvs.count != vertexCount ||
+                    (uvs.componentType != kGltfFloat && !(uvs.normalized && uvs.componentType != kGltfUnsignedInt)))) ||
+                (indices.pData && (indices.componentCount != 1 || indices.componentType == kGltfFloat || indices.normalized))) {
+                return Fail("unsupported vertex attribute format");
+            }
+
+            const uint32_t positionBase = static_cast<uint32_t>(corners.positions.size());
+            const uint32_t normalBase = static_cast<uint32_t>(corners.normals.size());
+            const uint32_t uvBase = static_cast<uint32_t>(corners.uvs.size());
+            const uint32_t cornerBase = static_cast<uint32_t>(corners.positionIndices.size());
+            const uint32_t primitiveCorners = (indices.pData ? indices.count : vertexCount) / 3 * 3;
+            if (static_cast<uint64_t>(cornerBase) + primitiveCorners >= Corners::kNone ||
+                static_cast<uint64_t>(positionBase) + vertexCount >= Corners::kNone) {
+                return Fail("mesh is too large");
+            }
+            corners.positions.resize(positionBase + vertexCount);
+            corners.normals.resize(normalBase + (normals.pData ? vertexCount : 0));
+            corners.uvs.resize(uvBase + (uvs.pData ? vertexCount : 0));
+            corners.positionIndices.resize(cornerBase + primitiveCorners);
+            corners.normalIndices.resize(cornerBase + primitiveCorners);
+            corners.uvIndices.resize(cornerBase + primitiveCorners);
+
+            ParallelRanges(m_pThreadPool, vertexCount, kGrain, [&](uint32_t begin, uint32_t end) {
+                for (uint32_t i = begin; i < end; i++) {
+                    XMFLOAT3& position = corners.positions[positionBase + i];
+                    ReadGltfFloats(positions, i, &position.x);
+                    position.z = -position.z;
+                    if (normals.pData) {
+                        XMFLOAT3& normal = corners.normals[normalBase + i];
+                        ReadGltfFloats(normals, i, &normal.x);
+                        normal.z = -normal.z;
+                    }
+                    if (uvs.pData) {
+                        ReadGltfFloats(uvs, i, &corners.uvs[uvBase + i].x);
+                    }
+                }
+            });
+            std::atomic<bool> badIndex{ false };
+            ParallelRanges(m_pThreadPool, primitiveCorners / 3, kGrain, [&](uint32_t begin, uint32_t end) {
+                for (uint32_t triangle = begin; triangle < end; triangle++) {
+                    // Обратный обход: (0, 2, 1)
+                    static const uint32_t kOrder[3] = { 0, 2, 1 };
+                    for (uint32_t k = 0; k < 3; k++) {
+                        const uint32_t source = triangle * 3 + kOrder[k];
+                        const uint32_t vertex = indices.pData ? ReadGltfIndex(indices, source) : source;
+                        const uint32_t corner = cornerBase + triangle * 3 + k;
+                        if (vertex >= vertexCount) {
+                            badIndex.store(true, std::memory_order_relaxed);
+                            corners.positionIndices[corner] = positionBase;
+                            corners.normalIndices[corner] = Corners::kNone;
+                            corners.uvIndices[corner] = Corners::kNone;
+                            continue;
+                        }
+                        corners.positionIndices[corner] = positionBase + vertex;
+                        corners.normalIndices[corner] = normals.pData ? normalBase + vertex : Corners::kNone;
+                        corners.uvIndices[corner] = uvs.pData ? uvBase + vertex : Corners::kNone;
+                    }
+                }
+            });
+            if (badIndex.load()) {
+                return Fail("vertex index is out of range");
+            }
+        }
+    }
+    if (corners.positionIndices.empty()) {
+        return Fail("no triangle primitives in glTF file");
+    }
+    m_stats.parseMilliseconds = MillisecondsSince(startTime);
+
+    const bool result = BuildMesh(corners, mesh);
+    m_stats.totalMilliseconds = MillisecondsSince(startTime);
+    return result;
+}
+
+bool MeshImporter::BuildMesh(Corners& corners, ImportedMesh& mesh) {
+    const auto startTime = std::chrono::steady_clock::now();
+    const uint32_t cornerCount = static_cast<uint32_t>(corners.positionIndices.size());
+    const uint32_t triangleCount = cornerCount / 3;
+    m_stats.cornerCount = cornerCount;
+    m_stats.triangleCount = triangleCount;
+
+    // 1. Недостающие нормали: сглаженные по позициям, нормали граней с весом по площади
+    m_stats.normalsGenerated = std::find(corners.normalIndices.begin(), corners.normalIndices.end(), Corners::kNone) != corners.normalIndices.end();
+    if (m_stats.normalsGenerated) {
+        std::vector<XMFLOAT3> faceNormals(triangleCount);
+        ParallelRanges(m_pThreadPool, triangleCount, kGrain, [&](uint32_t begin, uint32_t end) {
+            for (uint32_t triangle = begin; triangle < end; triangle++) {
+                const XMVECTOR p0 = XMLoadFloat3(&corners.positions[corners.positionIndices[triangle * 3]]);
+                const XMVECTOR p1 = XMLoadFloat3(&corners.positions[corners.positionIndices[triangle * 3 + 1]]);
+                const XMVECTOR p2 = XMLoadFloat3(&corners.positions[corners.positionIndices[triangle * 3 + 2]]);
+                XMStoreFloat3(&faceNormals[triangle], XMVector3Cross(XMVectorSubtract(p1, p0), XMVectorSubtract(p2, p0)));
+            }
+        });
+        const uint32_t normalBase = static_cast<uint32_t>(corners.normals.size());
+        corners.normals.resize(normalBase + corners.positions.size(), XMFLOAT3(0, 0, 0));
+        XMFLOAT3* pGenerated = corners.normals.data() + normalBase;
+        for (uint32_t corner = 0; corner < cornerCount; corner++) {
+            XMFLOAT3& normal = pGenerated[corners.positionIndices[corner]];
+            const XMFLOAT3& face = faceNormals[corner / 3];
+            normal.x += face.x;
+            normal.y += face.y;
+            normal.z += face.z;
+        }
+        ParallelRanges(m_pThreadPool, static_cast<uint32_t>(corners.positions.size()), kGrain, [&](uint32_t begin, uint32_t end) {
+            for (uint32_t i = begin; i < end; i++) {
+                const XMVECTOR normal = XMLoadFloat3(&pGenerated[i]);
+                XMStoreFloat3(&pGenerated[i], XMVectorGetX(XMVector3LengthSq(normal)) > 1e-30f ? XMVector3Normalize(normal) : XMVectorSet(0, 1, 0, 0));
+            }
+        });
+        ParallelRanges(m_pThreadPool, cornerCount, kGrain, [&](uint32_t begin, uint32_t end) {
+            for (uint32_t corner = begin; corner < end; corner++) {
+                if (corners.normalIndices[corner] == Corners::kNone) {
+                    corners.normalIndices[corner] = normalBase + corners.positionIndices[corner];
+                }
+            }
+        });
+    }
+
+    // 2. Касательная грани из производных развертки; в каждом углу - знак развертки и вклад
+    //    касательной грани, ортогонализованной к нормали угла, с весом по углу при вершине
+    std::vector<XMFLOAT3> cornerTangents(cornerCount);
+    std::vector<uint8_t> mirrored(cornerCount);
+    ParallelRanges(m_pThreadPool, triangleCount, kGrain, [&](uint32_t begin, uint32_t end) {
+        for (uint32_t triangle = begin; triangle < end; triangle++) {
+            XMVECTOR p[3];
+            XMFLOAT2 uv[3];
+            for (uint32_t k = 0; k < 3; k++) {
+                const uint32_t corner = triangle * 3 + k;
+                p[k] = XMLoadFloat3(&corners.positions[corners.positionIndices[corner]]);
+                const uint32_t uvIndex = corners.uvIndices[corner];
+                uv[k] = uvIndex != Corners::kNone ? corners.uvs[uvIndex] : XMFLOAT2(0, 0);
+            }
+            const XMVECTOR edge1 = XMVectorSubtract(p[1], p[0]);
+            const XMVECTOR edge2 = XMVectorSubtract(p[2], p[0]);
+            const float du1 = uv[1].x - uv[0].x;
+            const float dv1 = uv[1].y - uv[0].y;
+            const float du2 = uv[2].x - uv[0].x;
+            const float dv2 = uv[2].y - uv[0].y;
+            const float determinant = du1 * dv2 - du2 * dv1;
+            if (std::fabs(determinant) < 1e-20f) {
+                // Вырожденная развертка: касательная достроится из нормали
+                for (uint32_t k = 0; k < 3; k++) {
+                    cornerTangents[triangle * 3 + k] = XMFLOAT3(0, 0, 0);
+                    mirrored[triangle * 3 + k] = 0;
+                }
+                continue;
+            }
+            const XMVECTOR tangent = XMVectorScale(XMVectorSubtract(XMVectorScale(edge1, dv2), XMVectorScale(edge2, dv1)), 1.0f / determinant);
+            const XMVECTOR bitangent = XMVectorScale(XMVectorSubtract(XMVectorScale(edge2, du1), XMVectorScale(edge1, du2)), 1.0f / determinant);
+            for (uint32_t k = 0; k < 3; k++) {
+                const uint32_t corner = triangle * 3 + k;
+                const XMVECTOR normal = XMLoadFloat3(&corners.normals[corners.normalIndices[corner]]);
+                const float handedness = XMVectorGetX(XMVector3Dot(XMVector3Cross(normal, tangent), bitangent));
+                mirrored[corner] = handedness < 0.0f ? 1 : 0;
+
+                const XMVECTOR projected = XMVectorSubtract(tangent, XMVectorScale(normal, XMVectorGetX(XMVector3Dot(normal, tangent))));
+                const float lengthSquared = XMVectorGetX(XMVector3LengthSq(projected));
+                const float angle = GetCornerAngle(p[k], p[(k + 1) % 3], p[(k + 2) % 3]);
+                XMStoreFloat3(&cornerTangents[corner], lengthSquared > 1e-30f ? XMVectorScale(projected, angle / std::sqrt(lengthSquared)) : XMVectorZero());
+            }
+        }
+    });
+
+    // 3. Сварка: хеши ключей углов и разбиение пар (хеш, угол) на части по старшим битам
+    //    хеша; в каждой части своя хеш-таблица с первым углом каждого хеша, и части читают
+    //    только свои пары. Затем проход по углам подряд сверяет ключ угла с ключом первого
+    //    угла, и только при коллизии 64-битного хеша сварка повторяется со сравнением ключей.
+    //    Номера вершин - в порядке первого угла, поэтому результат не зависит от числа потоков
+    struct HashedCorner {
+        uint64_t hash;
+        uint32_t corner;
+    };
+    std::vector<HashedCorner> partitionCorners(cornerCount);
+    uint32_t partitionStart[kWeldPartitionCount + 1] = {};
+    {
+        std::vector<uint64_t> hashes(cornerCount);
+        ParallelRanges(m_pThreadPool, cornerCount, kGrain, [&](uint32_t begin, uint32_t end) {
+            uint32_t key[kCornerKeySize];
+            for (uint32_t corner = begin; corner < end; corner++) {
+                GetCornerKey(corners, mirrored.data(), corner, key);
+                hashes[corner] = Hash64(key, sizeof(key));
+            }
+        });
+        for (uint32_t corner = 0; corner < cornerCount; corner++) {
+            partitionStart[(hashes[corner] >> (64 - kWeldPartitionBits)) + 1]++;
+        }
+        for (uint32_t partition = 0; partition < kWeldPartitionCount; partition++) {
+            partitionStart[partition + 1] += partitionStart[partition];
+        }
+        uint32_t partitionNext[kWeldPartitionCount];
+        memcpy(partitionNext, partitionStart, sizeof(partitionNext));
+        for (uint32_t corner = 0; corner < cornerCount; corner++) {
+            partitionCorners[partitionNext[hashes[corner] >> (64 - kWeldPartitionBits)]++] = { hashes[corner], corner };
+        }
+    }
+
+    // indices[угол] - первый угол с тем же ключом
+    std::vector<uint32_t> indices(cornerCount);
+    auto weld = [&](bool compareKeys) {
+        ParallelRanges(m_pThreadPool, kWeldPartitionCount, 1, [&](uint32_t begin, uint32_t end) {
+            std::vector<uint32_t> table;  // номер пары в части
+            uint32_t key[kCornerKeySize];
+            uint32_t otherKey[kCornerKeySize];
+            for (uint32_t partition = begin; partition < end; partition++) {
+                const HashedCorner* pItems = partitionCorners.data() + partitionStart[partition];
+                const uint32_t count = partitionStart[partition + 1] - partitionStart[partition];
+                uint32_t capacity = 16;
+                while (capacity < count * 2) {
+                    capacity *= 2;
+                }
+                table.assign(capacity, Corners::kNone);
+                for (uint32_t i = 0; i < count; i++) {
+                    const HashedCorner& item = pItems[i];
+                    if (compareKeys) {
+                        GetCornerKey(corners, mirrored.data(), item.corner, key);
+                    }
+                    for (uint32_t slot = static_cast<uint32_t>(item.hash) & (capacity - 1);; slot = (slot + 1) & (capacity - 1)) {
+                        if (table[slot] == Corners::kNone) {
+                            table[slot] = i;
+                            indices[item.corner] = item.corner;
+                            break;
+                        }
+                        const HashedCorner& other = pItems[table[slot]];
+                        if (other.hash != item.hash) {
+                            continue;
+                        }
+                        if (compareKeys) {
+                            GetCornerKey(corners, mirrored.data(), other.corner, otherKey);
+                            if (memcmp(key, otherKey, sizeof(key)) != 0) {
+                                continue;
+                            }
+                        }
+                        indices[item.corner] = other.corner;
+                        break;
+                    }
+                }
+            }
+        });
+    };
+    weld(false);
+    std::atomic<bool> collision{ false };
+    ParallelRanges(m_pThreadPool, cornerCount, kGrain, [&](uint32_t begin, uint32_t end) {
+        uint32_t key[kCornerKeySize];
+        uint32_t firstKey[kCornerKeySize];
+        for (uint32_t corner = begin; corner < end; corner++) {
+            if (indices[corner] != corner) {
+                GetCornerKey(corners, mirrored.data(), corner, key);
+                GetCornerKey(corners, mirrored.data(), indices[corner], firstKey);
+                if (memcmp(key, firstKey, sizeof(key)) != 0) {
+                    collision.store(true, std::memory_order_relaxed);
+                    return;
+                }
+            }
+        }
+    });
+    if (collision.load()) {
+        weld(true);
+    }
+    partitionCorners = std::vector<HashedCorner>();
+
+    // Первый угол ключа в части всегда раньше остальных, его номер уже назначен
+    std::vector<uint32_t> vertexCorners;
+    for (uint32_t corner = 0; corner < cornerCount; corner++) {
+        const uint32_t representative = indices[corner];
+        if (representative == corner) {
+            indices[corner] = static_cast<uint32_t>(vertexCorners.size());
+            vertexCorners.push_back(corner);
+        }
+        else {
+            indices[corner] = indices[representative];
+        }
+    }
+    const uint32_t vertexCount = static_cast<uint32_t>(vertexCorners.size());
+
+    // 4. Суммы касательных углов по вершинам - в порядке углов, как и нумерация вершин
+    std::vector<XMFLOAT3> tangentSums(vertexCount, XMFLOAT3(0, 0, 0));
+    for (uint32_t corner = 0; corner < cornerCount; corner++) {
+        XMFLOAT3& sum = tangentSums[indices[corner]];
+        const XMFLOAT3& tangent = cornerTangents[corner];
+        sum.x += tangent.x;
+        sum.y += tangent.y;
+        sum.z += tangent.z;
+    }
+
+    // 5. Вершины: касательная ортогонализуется к нормали, без развертки - любая перпендикулярная
+    mesh.vertices.resize(vertexCount);
+    ParallelRanges(m_pThreadPool, vertexCount, kGrain, [&](uint32_t begin, uint32_t end) {
+        for (uint32_t vertex = begin; vertex < end; vertex++) {
+            const uint32_t corner = vertexCorners[vertex];
+            const XMFLOAT3& position = corners.positions[corners.positionIndices[corner]];
+            const uint32_t uvIndex = corners.uvIndices[corner];
+            const XMFLOAT2 uv = uvIndex != Corners::kNone ? corners.uvs[uvIndex] : XMFLOAT2(0, 0);
+            XMFLOAT3 normal = corners.normals[corners.normalIndices[corner]];
+            XMVECTOR n = XMLoadFloat3(&normal);
+            n = XMVectorGetX(XMVector3LengthSq(n)) > 1e-30f ? XMVector3Normalize(n) : XMVectorSet(0, 1, 0, 0);
+            XMVECTOR t = XMLoadFloat3(&tangentSums[vertex]);
+            t = XMVectorSubtract(t, XMVectorScale(n, XMVectorGetX(XMVector3Dot(n, t))));
+            if (!(XMVectorGetX(XMVector3LengthSq(t)) > 1e-20f)) {
+                const XMVECTOR axis = std::fabs(XMVectorGetX(n)) < 0.9f ? XMVectorSet(1, 0, 0, 0) : XMVectorSet(0, 1, 0, 0);
+                t = XMVectorSubtract(axis, XMVectorScale(n, XMVectorGetX(XMVector3Dot(n, axis))));
+            }
+            t = XMVector3Normalize(t);
+            XMStoreFloat3(&normal, n);
+            XMFLOAT3 tangent;
+            XMStoreFloat3(&tangent, t);
+            mesh.vertices[vertex] = {
+                position.x, position.y, position.z,
+                normal.x, normal.y, normal.z,
+                tangent.x, tangent.y, tangent.z,
+                uv.x, uv.y
+            };
+        }
+    });
+    for (uint32_t vertex = 0; vertex < vertexCount; vertex++) {
+        mesh.mirroredVertexCount += mirrored[vertexCorners[vertex]];
+    }
+    m_stats.vertexCount = vertexCount;
+    m_stats.tangentMilliseconds = MillisecondsSince(startTime);
+
+    if (m_optimize) {
+        const auto optimizeTime = std::chrono::steady_clock::now();
+        OptimizeVertexCache(indices.data(), indices.data(), cornerCount, vertexCount);
+        std::vector<TextureTangentVertex> optimized(vertexCount);
+        const uint32_t usedCount = OptimizeVertexFetch(optimized.data(), indices.data(), cornerCount,
+            mesh.vertices.data(), vertexCount, sizeof(TextureTangentVertex));
+        optimized.resize(usedCount);
+        mesh.vertices.swap(optimized);
+        m_stats.optimizeMilliseconds = MillisecondsSince(optimizeTime);
+    }
+
+    // Индексы LOD дописываются за индексами исходной сетки
+    if (m_lodCount > 1) {
+        const auto lodTime = std::chrono::steady_clock::now();
+        std::vector<uint32_t> lodIndices;
+        BuildMeshLods(indices.data(), cornerCount, mesh.vertices.data(), static_cast<uint32_t>(mesh.vertices.size()),
+            sizeof(TextureTangentVertex), lodIndices, mesh.lods, m_lodCount);
+        indices.swap(lodIndices);
+        m_stats.lodMilliseconds = MillisecondsSince(lodTime);
+    }
+    else {
+        mesh.lods.assign(1, MeshLod{ 0, cornerCount, 0.0f });
+    }
+    m_stats.lodCount = mesh.GetLodCount();
+
+    if (mesh.vertices.size() <= 65536) {
+        mesh.indices16.resize(indices.size());
+        for (size_t i = 0; i < indices.size(); i++) {
+            mesh.indices16[i] = static_cast<uint16_t>(indices[i]);
+        }
+    }
+    else {
+        mesh.indices32.swap(indices);
+    }
+    return true;
+}
+
+// ---------------------------------------------------------------------------------------------
+// Замер
+
+namespace {
+
+std::string BuildGridObj(uint32_t gridSize) {
+    std::string text;
+    const size_t vertexCount = static_cast<size_t>(gridSize + 1) * (gridSize + 1);
+    text.reserve(vertexCount * 48 + static_cast<size_t>(gridSize) * gridSize * 48 + 64);
+    text += "# grid\nvn 0 1 0\n";
+    char line[96];
+    const double step = 1.0 / gridSize;
+    for (uint32_t j = 0; j <= gridSize; j++) {
+        for (uint32_t i = 0; i <= gridSize; i++) {
+            snprintf(line, sizeof(line), "v %.6f 0 %.6f\nvt %.6f %.6f\n", i * step, j * step, i * step, 1.0 - j * step);
+            text += line;
+        }
+    }
+    for (uint32_t j = 0; j < gridSize; j++) {
+        for (uint32_t i = 0; i < gridSize; i++) {
+            const uint32_t a = j * (gridSize + 1) + i + 1;
+            const uint32_t b = a + gridSize + 1;
+            snprintf(line, sizeof(line), "f %u/%u/1 %u/%u/1 %u/%u/1 %u/%u/1\n", a, a, b, b, b + 1, b + 1, a + 1, a + 1);
+            text += line;
+        }
+    }
+    return text;
+}
+
+void AppendBytes(std::vector<uint8_t>& data, const void* pData, size_t size) {
+    data.insert(data.end(), static_cast<const uint8_t*>(pData), static_cast<const uint8_t*>(pData) + size);
+}
+
+std::vector<uint8_t> BuildGridGlb(uint32_t gridSize) {
+    const uint32_t vertexCount = (gridSize + 1) * (gridSize + 1);
+    const uint32_t indexCount = gridSize * gridSize * 6;
+    std::vector<uint8_t> binary;
+    binary.reserve(static_cast<size_t>(vertexCount) * 32 + static_cast<size_t>(indexCount) * 4);
+    const float step = 1.0f / gridSize;
+    for (uint32_t j = 0; j <= gridSize; j++) {
+        for (uint32_t i = 0; i <= gridSize; i++) {
+            const float position[3] = { i * step, 0.0f, j * step };
+            AppendBytes(binary, position, sizeof(position));
+        }
+    }
+    const float up[3] = { 0.0f, 1.0f, 0.0f };
+    for (uint32_t i = 0; i < vertexCount; i++) {
+        AppendBytes(binary, up, sizeof(up));
+    }
+    for (uint32_t j = 0; j <= gridSize; j++) {
+        for (uint32_t i = 0; i <= gridSize; i++) {
+            const float uv[2] = { i * step, j * step };
+            AppendBytes(binary, uv, sizeof(uv));
+        }
+    }
+    for (uint32_t j = 0; j < gridSize; j++) {
+        for (uint32_t i = 0; i < gridSize; i++) {
+            const uint32_t a = j * (gridSize + 1) + i;
+            const uint32_t b = a + gridSize + 1;
+            const uint32_t quad[6] = { a, b, b + 1, a, b + 1, a + 1 };
+            AppendBytes(binary, quad, sizeof(quad));
+        }
+    }
+
+    const uint32_t positionBytes = vertexCount * 12;
+    const uint32_t uvBytes = vertexCount * 8;
+    char json[1536];
+    snprintf(json, sizeof(json),
+        "{\"asset\":{\"version\":\"2.0\"},\"buffers\":[{\"byteLength\":%u}],"
+        "\"bufferViews\":[{\"buffer\":0,\"byteOffset\":0,\"byteLength\":%u},{\"buffer\":0,\"byteOffset\":%u,\"byteLength\":%u},"
+        "{\"buffer\":0,\"byteOffset\":%u,\"byteLength\":%u},{\"buffer\":0,\"byteOffset\":%u,\"byteLength\":%u}],"
+        "\"accessors\":[{\"bufferView\":0,\"componentType\":5126,\"count\":%u,\"type\":\"VEC3\"},"
+        "{\"bufferView\":1,\"componentType\":5126,\"count\":%u,\"type\":\"VEC3\"},"
+        "{\"bufferView\":2,\"componentType\":5126,\"count\":%u,\"type\":\"VEC2\"},"
+        "{\"bufferView\":3,\"componentType\":5125,\"count\":%u,\"type\":\"SCALAR\"}],"
+        "\"meshes\":[{\"primitives\":[{\"attributes\":{\"POSITION\":0,\"NORMAL\":1,\"TEXCOORD_0\":2},\"indices\":3}]}]}",
+        static_cast<uint32_t>(binary.size()),
+        positionBytes, positionBytes, positionBytes, positionBytes * 2, uvBytes, positionBytes * 2 + uvBytes, indexCount * 4,
+        vertexCount, vertexCount, vertexCount, indexCount);
+    std::string jsonChunk = json;
+    jsonChunk.resize((jsonChunk.size() + 3) & ~size_t(3), ' ');
+    binary.resize((binary.size() + 3) & ~size_t(3), 0);
+
+    std::vector<uint8_t> glb;
+    const uint32_t header[5] = {
+        kGlbMagic, 2, static_cast<uint32_t>(12 + 8 + jsonChunk.size() + 8 + binary.size()),
+        static_cast<uint32_t>(jsonChunk.size()), kGlbChunkJson
+    };
+    AppendBytes(glb, header, sizeof(header));
+    AppendBytes(glb, jsonChunk.data(), jsonChunk.size());
+    const uint32_t binHeader[2] = { static_cast<uint32_t>(binary.size()), kGlbChunkBin };
+    AppendBytes(glb, binHeader, sizeof(binHeader));
+    AppendBytes(glb, binary.data(), binary.size());
+    return glb;
+}
+
+// Плоскость y = 0, развертка u по x, v против z: нормаль +y, касательная +x, без зеркальных вершин
+void ValidateGridMesh(const ImportedMesh& mesh, uint32_t gridSize, MeshImportBenchmarkResult& result) {
+    const uint32_t expectedVertices = (gridSize + 1) * (gridSize + 1);
+    result.maxNormalError = 0;
+    result.maxTangentError = 0;
+    for (const TextureTangentVertex& vertex : mesh.vertices) {
+        const float normalError = std::fabs(vertex.nx) + std::fabs(vertex.ny - 1.0f) + std::fabs(vertex.nz);
+        const float tangentError = std::fabs(vertex.tx - 1.0f) + std::fabs(vertex.ty) + std::fabs(vertex.tz);
+        result.maxNormalError = normalError > result.maxNormalError ? normalError : result.maxNormalError;
+        result.maxTangentError = tangentError > result.maxTangentError ? tangentError : result.maxTangentError;
+    }
+    result.valid = result.triangleCount == 2 * gridSize * gridSize && mesh.vertices.size() == expectedVertices &&
+        mesh.GetIndexCount() == result.triangleCount * 3 && mesh.mirroredVertexCount == 0 &&
+        result.maxNormalError < 1e-4f && result.maxTangentError < 1e-4f;
+}
+
+} // namespace
+
+std::vector<MeshImportBenchmarkResult> RunMeshImportBenchmark(uint32_t gridSize, ThreadPool* pThreadPool, uint32_t repeatCount) {
+    std::vector<MeshImportBenchmarkResult> results;
+    const std::string obj = BuildGridObj(gridSize);
+    const std::vector<uint8_t> glb = BuildGridGlb(gridSize);
+
+    for (int format = 0; format < 2; format++) {
+        for (int pooled = 0; pooled < (pThreadPool ? 2 : 1); pooled++) {
+            MeshImportBenchmarkResult result;
+            result.format = format == 0 ? "OBJ" : "GLB";
+            result.threadCount = pooled ? pThreadPool->GetThreadCount() : 1;
+            result.megabytes = (format == 0 ? obj.size() : glb.size()) / (1024.0 * 1024.0);
+
+            // Оптимизация для GPU и цепочка LOD не входят в замер - их стоимость в отчетах -meshopt и -lodbench
+            MeshImporter importer(pooled ? pThreadPool : nullptr);
+            importer.SetOptimize(false);
+            importer.SetLodCount(1);
+            ImportedMesh mesh;
+            for (uint32_t repeat = 0; repeat < repeatCount; repeat++) {
+                const bool imported = format == 0 ? importer.ImportObj(obj.data(), obj.size(), mesh) :
+                    importer.ImportGltf(glb.data(), glb.size(), std::wstring(), mesh);
+                if (!imported) {
+                    break;
+                }
+                if (repeat == 0 || importer.GetStats().totalMilliseconds < result.milliseconds) {
+                    result.stats = importer.GetStats();
+                    result.milliseconds = result.stats.totalMilliseconds;
+                }
+            }
+            result.triangleCount = result.stats.triangleCount;
+            result.vertexCount = result.stats.vertexCount;
+            if (result.milliseconds > 0) {
+                result.megabytesPerSecond = result.megabytes * 1000.0 / result.milliseconds;
+                result.millionTrianglesPerSecond = result.triangleCount / (result.milliseconds * 1000.0);
+            }
+            ValidateGridMesh(mesh, gridSize, result);
+            results.push_back(result);
+        }
+    }
+    return results;
+}
@@ -0,0 +1,107 @@
+﻿#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "MeshSimplifier.h"
+#include "SceneTypes.h"
+
+class ThreadPool;
+
+// Загрузка треугольных сеток из OBJ и glTF 2.0 (.gltf с внешними или data: буферами, .glb)
+// в вершины TextureTangentVertex. Файл отображается в память, текст OBJ разбирается по кускам
+// на потоках пула. Углы треугольников с одинаковыми позицией, нормалью, текстурными
+// координатами и ориентацией развертки свариваются в одну вершину через хеш-таблицу;
+// касательные считаются как в MikkTSpace: по треугольникам из производных развертки,
+// с весом по углу при вершине, затем ортогонализуются к нормали.
+//
+// Оба формата в правой системе координат с обходом передних граней против часовой стрелки;
+// при загрузке z меняет знак и обход разворачивается (левая система lab6, передняя грань по
+// часовой). Текстурная координата v у OBJ отсчитывается снизу и переворачивается.
+// У glTF берутся POSITION, NORMAL и TEXCOORD_0 всех примитивов с mode 4 (треугольники);
+// преобразования узлов не применяются - сетки остаются в своих координатах.
+// После оптимизации строится цепочка LOD (MeshSimplifier.h) над тем же вершинным буфером.
+
+struct ImportedMesh {
+    std::vector<TextureTangentVertex> vertices;
+    // Заполнен один массив: 16-битные индексы, если вершин не больше 65536, иначе 32-битные.
+    // Индексы всех LOD лежат подряд, LOD 0 (исходная сетка) - первым
+    std::vector<uint16_t> indices16;
+    std::vector<uint32_t> indices32;
+    std::vector<MeshLod> lods;
+    // Вершины с зеркальной разверткой: в формате вершины нет знака бинормали, и шейдерная
+    // бинормаль cross(n, t) у них направлена против развертки
+    uint32_t mirroredVertexCount = 0;
+
+    bool Uses16BitIndices() const { return !indices16.empty(); }
+    // Индексов LOD 0
+    uint32_t GetIndexCount() const { return lods.empty() ? 0 : lods[0].indexCount; }
+    uint32_t GetLodCount() const { return static_cast<uint32_t>(lods.size()); }
+};
+
+struct MeshImportStats {
+    uint64_t fileBytes = 0;
+    uint32_t triangleCount = 0;
+    uint32_t cornerCount = 0;           // углов треугольников до сварки
+    uint32_t vertexCount = 0;           // вершин после сварки
+    bool normalsGenerated = false;      // у части углов не было нормалей
+    double parseMilliseconds = 0;       // отображение и разбор файла
+    double tangentMilliseconds = 0;     // нормали, касательные и сварка
+    double optimizeMilliseconds = 0;    // MeshOptimizer
+    uint32_t lodCount = 0;
+    double lodMilliseconds = 0;         // цепочка LOD
+    double totalMilliseconds = 0;
+};
+
+class MeshImporter {
+public:
+    // Без пула все проходы выполняются в вызывающем потоке
+    explicit MeshImporter(ThreadPool* pThreadPool = nullptr) : m_pThreadPool(pThreadPool) {}
+
+    // Формат по расширению: .obj, .gltf или .glb
+    bool Import(const std::wstring& filePath, ImportedMesh& mesh);
+    bool ImportObj(const void* pData, size_t size, ImportedMesh& mesh);
+    // baseDirectory - каталог внешних буферов .gltf с разделителем в конце (или пустая строка)
+    bool ImportGltf(const void* pData, size_t size, const std::wstring& baseDirectory, ImportedMesh& mesh);
+
+    // Порядок треугольников и вершин для кэшей GPU (MeshOptimizer.h) после сварки, по умолчанию включен
+    void SetOptimize(bool optimize) { m_optimize = optimize; }
+    // Число LOD в цепочке, по умолчанию kMaxMeshLods; 1 - только исходная сетка
+    void SetLodCount(uint32_t lodCount) { m_lodCount = lodCount; }
+
+    const std::string& GetErrorMessage() const { return m_error; }
+    const MeshImportStats& GetStats() const { return m_stats; }
+
+    struct Corners;
+
+private:
+    bool BuildMesh(Corners& corners, ImportedMesh& mesh);
+    bool Fail(const std::string& message);
+
+    ThreadPool* m_pThreadPool;
+    bool m_optimize = true;
+    uint32_t m_lodCount = kMaxMeshLods;
+    std::string m_error;
+    MeshImportStats m_stats;
+};
+
+struct MeshImportBenchmarkResult {
+    const char* format = "";
+    unsigned threadCount = 1;
+    uint32_t triangleCount = 0;
+    uint32_t vertexCount = 0;
+    double megabytes = 0;              // размер файла
+    double milliseconds = 0;           // лучший из замеров
+    double megabytesPerSecond = 0;
+    double millionTrianglesPerSecond = 0;
+    MeshImportStats stats;             // лучшего замера
+    float maxNormalError = 0;          // отклонение от ожидаемых нормали и касательной
+    float maxTangentError = 0;
+    bool valid = false;                // число треугольников и вершин, нормали и касательные как ожидалось
+};
+
+// Плоская сетка gridSize x gridSize клеток (2 * gridSize^2 треугольников) в памяти как OBJ
+// с четырехугольными гранями и как GLB; каждый формат загружается в одном потоке и на пуле
+std::vector<MeshImportBenchmarkResult> RunMeshImportBenchmark(uint32_t gridSize, ThreadPool* pThreadPool, uint32_t repeatCount = 3);
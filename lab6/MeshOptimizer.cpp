@@ -0,0 +1,514 @@
+﻿#include "MeshOptimizer.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <numeric>
+#include <random>
+#include <DirectXMath.h>
+
+namespace {
+
+const uint32_t kInvalidIndex = 0xFFFFFFFFu;
+
+// Оценки Форсайта: кэш из 32 вершин, вершины последнего треугольника - 0.75, дальше по убыванию
+// до 0 к концу кэша; вершинам с немногими оставшимися треугольниками - прибавка, чтобы они
+// уходили из сетки раньше и не оставляли одиночных треугольников
+const uint32_t kScoreCacheSize = 32;
+const uint32_t kMaxValence = 32;
+
+struct VertexScoreTable {
+    float cache[kScoreCacheSize];
+    float valence[kMaxValence + 1];
+
+    VertexScoreTable() {
+        for (uint32_t i = 0; i < kScoreCacheSize; i++) {
+            cache[i] = i < 3 ? 0.75f : powf(1.0f - static_cast<float>(i - 3) / (kScoreCacheSize - 3), 1.5f);
+        }
+        valence[0] = 0.0f;
+        for (uint32_t i = 1; i <= kMaxValence; i++) {
+            valence[i] = 2.0f / sqrtf(static_cast<float>(i));
+        }
+    }
+
+    float Get(int32_t cachePosition, uint32_t liveTriangles) const {
+        if (liveTriangles == 0) {
+            return -1.0f;
+        }
+        const float cacheScore = cachePosition >= 0 ? cache[cachePosition] : 0.0f;
+        return cacheScore + valence[liveTriangles < kMaxValence ? liveTriangles : kMaxValence];
+    }
+};
+
+// Смежность вершин и треугольников в виде CSR
+struct TriangleAdjacency {
+    std::vector<uint32_t> offsets;   // vertexCount + 1
+    std::vector<uint32_t> counts;    // живых треугольников у вершины
+    std::vector<uint32_t> triangles;
+
+    void Build(const uint32_t* pIndices, uint32_t indexCount, uint32_t vertexCount) {
+        counts.assign(vertexCount, 0);
+        for (uint32_t i = 0; i < indexCount; i++) {
+            counts[pIndices[i]]++;
+        }
+        offsets.assign(vertexCount + 1, 0);
+        for (uint32_t v = 0; v < vertexCount; v++) {
+            offsets[v + 1] = offsets[v] + counts[v];
+        }
+        triangles.resize(indexCount);
+        std::vector<uint32_t> fill(offsets.begin(), offsets.end() - 1);
+        for (uint32_t i = 0; i < indexCount; i++) {
+            triangles[fill[pIndices[i]]++] = i / 3;
+        }
+    }
+
+    // Убрать треугольник из списка вершины: живые треугольники - первые counts[v] элементов
+    void Remove(uint32_t vertex, uint32_t triangle) {
+        uint32_t* pList = &triangles[offsets[vertex]];
+        const uint32_t count = counts[vertex];
+        for (uint32_t i = 0; i < count; i++) {
+            if (pList[i] == triangle) {
+                pList[i] = pList[count - 1];
+                pList[count - 1] = triangle;
+                counts[vertex] = count - 1;
+                return;
+            }
+        }
+    }
+};
+
+// Кэш FIFO по отметкам времени: вершина в кэше, если загружена не раньше cacheSize загрузок назад
+uint32_t CountCacheMisses(const uint32_t* pIndices, uint32_t indexCount, uint32_t cacheSize,
+    std::vector<uint32_t>& timestamps, uint32_t& time) {
+    uint32_t misses = 0;
+    for (uint32_t i = 0; i < indexCount; i++) {
+        const uint32_t vertex = pIndices[i];
+        if (time - timestamps[vertex] > cacheSize) {
+            timestamps[vertex] = time++;
+            misses++;
+        }
+    }
+    return misses;
+}
+
+const float* GetPosition(const void* pVertices, uint32_t vertexStride, uint32_t vertex) {
+    return reinterpret_cast<const float*>(static_cast<const uint8_t*>(pVertices) + static_cast<size_t>(vertex) * vertexStride);
+}
+
+} // namespace
+
+VertexCacheStats AnalyzeVertexCache(const uint32_t* pIndices, uint32_t indexCount, uint32_t vertexCount, uint32_t cacheSize) {
+    VertexCacheStats stats;
+    stats.triangleCount = indexCount / 3;
+    // Отметки начинаются далеко в прошлом, чтобы первое обращение было промахом
+    uint32_t time = cacheSize + 1;
+    std::vector<uint32_t> timestamps(vertexCount, 0);
+    stats.missCount = CountCacheMisses(pIndices, indexCount, cacheSize, timestamps, time);
+
+    std::vector<uint8_t> used(vertexCount, 0);
+    for (uint32_t i = 0; i < indexCount; i++) {
+        stats.vertexCount += used[pIndices[i]] ? 0 : 1;
+        used[pIndices[i]] = 1;
+    }
+    stats.acmr = stats.triangleCount > 0 ? static_cast<double>(stats.missCount) / stats.triangleCount : 0.0;
+    stats.atvr = stats.vertexCount > 0 ? static_cast<double>(stats.missCount) / stats.vertexCount : 0.0;
+    return stats;
+}
+
+double AnalyzeVertexFetch(const uint32_t* pIndices, uint32_t indexCount, uint32_t vertexCount, uint32_t vertexStride) {
+    const uint32_t kLineSize = 64;
+    const uint32_t kLineCount = 64;
+    const size_t lineTotal = (static_cast<size_t>(vertexCount) * vertexStride + kLineSize - 1) / kLineSize;
+    std::vector<uint32_t> timestamps(lineTotal, 0);
+    uint32_t time = kLineCount + 1;
+    uint64_t bytesFetched = 0;
+    std::vector<uint8_t> used(vertexCount, 0);
+    uint64_t usedBytes = 0;
+    for (uint32_t i = 0; i < indexCount; i++) {
+        const uint32_t vertex = pIndices[i];
+        if (!used[vertex]) {
+            used[vertex] = 1;
+            usedBytes += vertexStride;
+        }
+        const size_t firstLine = static_cast<size_t>(vertex) * vertexStride / kLineSize;
+        const size_t lastLine = (static_cast<size_t>(vertex) * vertexStride + vertexStride - 1) / kLineSize;
+        for (size_t line = firstLine; line <= lastLine; line++) {
+            if (time - timestamps[line] > kLineCount) {
+                timestamps[line] = time++;
+                bytesFetched += kLineSize;
+            }
+        }
+    }
+    return usedBytes > 0 ? static_cast<double>(bytesFetched) / usedBytes : 0.0;
+}
+
+void OptimizeVertexCache(uint32_t* pDestination, const uint32_t* pIndices, uint32_t indexCount, uint32_t vertexCount) {
+    static const VertexScoreTable scoreTable;
+    const uint32_t triangleCount = indexCount / 3;
+    if (triangleCount == 0) {
+        return;
+    }
+    // Источник нужен до конца, а результат может писаться поверх него
+    std::vector<uint32_t> indices(pIndices, pIndices + triangleCount * 3);
+
+    TriangleAdjacency adjacency;
+    adjacency.Build(indices.data(), triangleCount * 3, vertexCount);
+
+    std::vector<int32_t> cachePositions(vertexCount, -1);
+    std::vector<float> vertexScores(vertexCount);
+    for (uint32_t v = 0; v < vertexCount; v++) {
+        vertexScores[v] = scoreTable.Get(-1, adjacency.counts[v]);
+    }
+    std::vector<uint8_t> emitted(triangleCount, 0);
+    uint32_t bestTriangle = 0;
+    float bestScore = -1.0f;
+    for (uint32_t t = 0; t < triangleCount; t++) {
+        const uint32_t* pTriangle = &indices[t * 3];
+        const float score = vertexScores[pTriangle[0]] + vertexScores[pTriangle[1]] + vertexScores[pTriangle[2]];
+        if (score > bestScore) {
+            bestScore = score;
+            bestTriangle = t;
+        }
+    }
+
+    // Кэш с тремя лишними местами: вершины нового треугольника добавляются до вытеснения
+    uint32_t cache[kScoreCacheSize + 3];
+    uint32_t newCache[kScoreCacheSize + 3];
+    uint32_t cacheCount = 0;
+    uint32_t scanCursor = 0;
+    for (uint32_t output = 0; output < triangleCount; output++) {
+        if (bestTriangle == kInvalidIndex) {
+            // В кэше нет вершин с живыми треугольниками - следующий по порядку неиспользованный
+            while (emitted[scanCursor]) {
+                scanCursor++;
+            }
+            bestTriangle = scanCursor;
+        }
+
+        const uint32_t* pTriangle = &indices[bestTriangle * 3];
+        pDestination[output * 3 + 0] = pTriangle[0];
+        pDestination[output * 3 + 1] = pTriangle[1];
+        pDestination[output * 3 + 2] = pTriangle[2];
+        emitted[bestTriangle] = 1;
+        for (uint32_t k = 0; k < 3; k++) {
+            adjacency.Remove(pTriangle[k], bestTriangle);
+        }
+
+        // Вершины треугольника в начало кэша, остальные сдвигаются
+        uint32_t newCount = 0;
+        for (uint32_t k = 0; k < 3; k++) {
+            newCache[newCount++] = pTriangle[k];
+        }
+        for (uint32_t i = 0; i < cacheCount; i++) {
+            const uint32_t vertex = cache[i];
+            if (vertex != pTriangle[0] && vertex != pTriangle[1] && vertex != pTriangle[2]) {
+                newCache[newCount++] = vertex;
+            }
+        }
+        // Вытесненные вершины теряют оценку кэша
+        for (uint32_t i = kScoreCacheSize; i < newCount; i++) {
+            cachePositions[newCache[i]] = -1;
+            vertexScores[newCache[i]] = scoreTable.Get(-1, adjacency.counts[newCache[i]]);
+        }
+        cacheCount = newCount < kScoreCacheSize ? newCount : kScoreCacheSize;
+        memcpy(cache, newCache, cacheCount * sizeof(uint32_t));
+        for (uint32_t i = 0; i < cacheCount; i++) {
+            cachePositions[cache[i]] = static_cast<int32_t>(i);
+            vertexScores[cache[i]] = scoreTable.Get(static_cast<int32_t>(i), adjacency.counts[cache[i]]);
+        }
+
+        // Оценки меняются только у треугольников вершин кэша; лучший выбирается среди них
+        bestTriangle = kInvalidIndex;
+        bestScore = -1.0f;
+        for (uint32_t i = 0; i < cacheCount; i++) {
+            const uint32_t vertex = cache[i];
+            const uint32_t* pList = &adjacency.triangles[adjacency.offsets[vertex]];
+            for (uint32_t j = 0; j < adjacency.counts[vertex]; j++) {
+                const uint32_t triangle = pList[j];
+                const uint32_t* pOther = &indices[triangle * 3];
+                const float score = vertexScores[pOther[0]] + vertexScores[pOther[1]] + vertexScores[pOther[2]];
+                if (score > bestScore) {
+                    bestScore = score;
+                    bestTriangle = triangle;
+                }
+            }
+        }
+    }
+}
+
+void OptimizeOverdraw(uint32_t* pDestination, const uint32_t* pIndices, uint32_t indexCount,
+    const void* pVertices, uint32_t vertexCount, uint32_t vertexStride, float threshold) {
+    const uint32_t cacheSize = 16;
+    const uint32_t triangleCount = indexCount / 3;
+    if (triangleCount == 0) {
+        return;
+    }
+    std::vector<uint32_t> indices(pIndices, pIndices + triangleCount * 3);
+
+    // Жесткие границы: треугольник, у которого промахнулись все три вершины, начинает новый
+    // участок - на этом месте порядок кэша уже ничего не сохраняет
+    std::vector<uint32_t> timestamps(vertexCount, 0);
+    uint32_t time = cacheSize + 1;
+    std::vector<uint32_t> hardBoundaries;
+    for (uint32_t t = 0; t < triangleCount; t++) {
+        if (CountCacheMisses(&indices[t * 3], 3, cacheSize, timestamps, time) == 3) {
+            hardBoundaries.push_back(t);
+        }
+    }
+    hardBoundaries.push_back(triangleCount);
+
+    // Мягкие границы: участок делится, как только его ACMR с начала кластера не хуже ACMR всего
+    // участка, умноженного на threshold - новый кластер начинается с пустого кэша
+    std::vector<uint32_t> clusters;
+    for (size_t h = 0; h + 1 < hardBoundaries.size(); h++) {
+        const uint32_t begin = hardBoundaries[h];
+        const uint32_t end = hardBoundaries[h + 1];
+        time += cacheSize + 1;
+        const double sectionAcmr = static_cast<double>(CountCacheMisses(&indices[begin * 3], (end - begin) * 3, cacheSize, timestamps, time)) / (end - begin);
+
+        clusters.push_back(begin);
+        time += cacheSize + 1;
+        uint32_t clusterBegin = begin;
+        uint32_t clusterMisses = 0;
+        for (uint32_t t = begin; t < end; t++) {
+            clusterMisses += CountCacheMisses(&indices[t * 3], 3, cacheSize, timestamps, time);
+            const uint32_t clusterTriangles = t + 1 - clusterBegin;
+            if (t + 1 < end && static_cast<double>(clusterMisses) / clusterTriangles <= sectionAcmr * threshold) {
+                clusters.push_back(t + 1);
+                clusterBegin = t + 1;
+                clusterMisses = 0;
+                time += cacheSize + 1;
+            }
+        }
+    }
+    clusters.push_back(triangleCount);
+    const uint32_t clusterCount = static_cast<uint32_t>(clusters.size()) - 1;
+
+    // Центр и нормаль кластера с весом по площади; ключ - насколько кластер смотрит наружу
+    // от центра сетки. Раньше рисуются кластеры с большим ключом: они чаще закрывают остальные
+    std::vector<float> clusterData(clusterCount * 7, 0.0f);  // центр * площадь, нормаль * площадь, площадь
+    float meshCenter[3] = { 0.0f, 0.0f, 0.0f };
+    float meshArea = 0.0f;
+    for (uint32_t c = 0; c < clusterCount; c++) {
+        float* pData = &clusterData[c * 7];
+        for (uint32_t t = clusters[c]; t < clusters[c + 1]; t++) {
+            const float* p0 = GetPosition(pVertices, vertexStride, indices[t * 3 + 0]);
+            const float* p1 = GetPosition(pVertices, vertexStride, indices[t * 3 + 1]);
+            const float* p2 = GetPosition(pVertices, vertexStride, indices[t * 3 + 2]);
+            const float e1[3] = { p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2] };
+            const float e2[3] = { p2[0] - p0[0], p2[1] - p0[1], p2[2] - p0[2] };
+            const float normal[3] = { e1[1] * e2[2] - e1[2] * e2[1], e1[2] * e2[0] - e1[0] * e2[2], e1[0] * e2[1] - e1[1] * e2[0] };
+            const float area = sqrtf(normal[0] * normal[0] + normal[1] * normal[1] + normal[2] * normal[2]);
+            for (uint32_t k = 0; k < 3; k++) {
+                const float center = (p0[k] + p1[k] + p2[k]) / 3.0f;
+                pData[k] += center * area;
+                pData[3 + k] += normal[k];
+                meshCenter[k] += center * area;
+            }
+            pData[6] += area;
+            meshArea += area;
+        }
+    }
+    for (uint32_t k = 0; k < 3; k++) {
+        meshCenter[k] = meshArea > 0.0f ? meshCenter[k] / meshArea : 0.0f;
+    }
+    std::vector<float> keys(clusterCount, 0.0f);
+    for (uint32_t c = 0; c < clusterCount; c++) {
+        const float* pData = &clusterData[c * 7];
+        const float area = pData[6] > 0.0f ? pData[6] : 1.0f;
+        const float normalLength = sqrtf(pData[3] * pData[3] + pData[4] * pData[4] + pData[5] * pData[5]);
+        if (normalLength <= 0.0f) {
+            continue;
+        }
+        float key = 0.0f;
+        for (uint32_t k = 0; k < 3; k++) {
+            key += (pData[k] / area - meshCenter[k]) * pData[3 + k] / normalLength;
+        }
+        keys[c] = key;
+    }
+    std::vector<uint32_t> order(clusterCount);
+    std::iota(order.begin(), order.end(), 0u);
+    std::stable_sort(order.begin(), order.end(), [&keys](uint32_t a, uint32_t b) { return keys[a] > keys[b]; });
+
+    uint32_t output = 0;
+    for (uint32_t c : order) {
+        const uint32_t count = (clusters[c + 1] - clusters[c]) * 3;
+        memcpy(pDestination + output, &indices[clusters[c] * 3], count * sizeof(uint32_t));
+        output += count;
+    }
+}
+
+uint32_t BuildVertexFetchRemap(uint32_t* pRemap, const uint32_t* pIndices, uint32_t indexCount, uint32_t vertexCount) {
+    std::fill(pRemap, pRemap + vertexCount, kInvalidIndex);
+    uint32_t next = 0;
+    for (uint32_t i = 0; i < indexCount; i++) {
+        if (pRemap[pIndices[i]] == kInvalidIndex) {
+            pRemap[pIndices[i]] = next++;
+        }
+    }
+    return next;
+}
+
+uint32_t OptimizeVertexFetch(void* pDestinationVertices, uint32_t* pIndices, uint32_t indexCount,
+    const void* pVertices, uint32_t vertexCount, uint32_t vertexStride) {
+    std::vector<uint32_t> remap(vertexCount);
+    const uint32_t usedCount = BuildVertexFetchRemap(remap.data(), pIndices, indexCount, vertexCount);
+    uint8_t* pDestination = static_cast<uint8_t*>(pDestinationVertices);
+    const uint8_t* pSource = static_cast<const uint8_t*>(pVertices);
+    for (uint32_t v = 0; v < vertexCount; v++) {
+        if (remap[v] != kInvalidIndex) {
+            memcpy(pDestination + static_cast<size_t>(remap[v]) * vertexStride, pSource + static_cast<size_t>(v) * vertexStride, vertexStride);
+        }
+    }
+    for (uint32_t i = 0; i < indexCount; i++) {
+        pIndices[i] = remap[pIndices[i]];
+    }
+    return usedCount;
+}
+
+MeshOptimizationResult MeasureMeshOptimization(const char* mesh, const uint32_t* pIndices, uint32_t indexCount,
+    const void* pVertices, uint32_t vertexCount, uint32_t vertexStride) {
+    MeshOptimizationResult result;
+    result.mesh = mesh;
+    result.triangleCount = indexCount / 3;
+    result.vertexCount = vertexCount;
+    result.before = AnalyzeVertexCache(pIndices, indexCount, vertexCount);
+    result.overfetchBefore = AnalyzeVertexFetch(pIndices, indexCount, vertexCount, vertexStride);
+
+    std::vector<uint32_t> indices(indexCount);
+    std::vector<uint8_t> vertices(static_cast<size_t>(vertexCount) * vertexStride);
+    const auto startTime = std::chrono::steady_clock::now();
+    OptimizeVertexCache(indices.data(), pIndices, indexCount, vertexCount);
+    OptimizeOverdraw(indices.data(), indices.data(), indexCount, pVertices, vertexCount, vertexStride);
+    const std::vector<uint32_t> reordered = indices;
+    const uint32_t usedCount = OptimizeVertexFetch(vertices.data(), indices.data(), indexCount, pVertices, vertexCount, vertexStride);
+    result.milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - startTime).count();
+
+    result.after = AnalyzeVertexCache(indices.data(), indexCount, usedCount);
+    result.overfetchAfter = AnalyzeVertexFetch(indices.data(), indexCount, usedCount, vertexStride);
+
+    // Треугольники переводятся обратно в номера исходной сетки и сравниваются с исходными: каждый
+    // поворачивается так, чтобы первой шла вершина с меньшим номером (обход сохраняется), затем
+    // списки сортируются. Копии вершин сравниваются с исходными побайтно
+    std::vector<uint32_t> remap(vertexCount);
+    BuildVertexFetchRemap(remap.data(), reordered.data(), indexCount, vertexCount);
+    std::vector<uint32_t> original(usedCount);
+    for (uint32_t v = 0; v < vertexCount; v++) {
+        if (remap[v] != kInvalidIndex) {
+            original[remap[v]] = v;
+        }
+    }
+    auto canonical = [](const uint32_t* pTriangle, uint32_t* pResult) {
+        const uint32_t first = pTriangle[0] < pTriangle[1] ? (pTriangle[0] < pTriangle[2] ? 0 : 2) : (pTriangle[1] < pTriangle[2] ? 1 : 2);
+        for (uint32_t k = 0; k < 3; k++) {
+            pResult[k] = pTriangle[(first + k) % 3];
+        }
+    };
+    std::vector<uint64_t> expected;
+    std::vector<uint64_t> actual;
+    bool valid = true;
+    for (uint32_t t = 0; t < result.triangleCount; t++) {
+        uint32_t triangle[3];
+        uint32_t optimized[3] = { 0, 0, 0 };
+        canonical(&pIndices[t * 3], triangle);
+        expected.push_back((static_cast<uint64_t>(triangle[0]) << 42) | (static_cast<uint64_t>(triangle[1]) << 21) | triangle[2]);
+        for (uint32_t k = 0; k < 3; k++) {
+            const uint32_t index = indices[t * 3 + k];
+            valid = valid && index < usedCount;
+            optimized[k] = index < usedCount ? original[index] : 0;
+            valid = valid && memcmp(&vertices[static_cast<size_t>(index < usedCount ? index : 0) * vertexStride],
+                static_cast<const uint8_t*>(pVertices) + static_cast<size_t>(optimized[k]) * vertexStride, vertexStride) == 0;
+        }
+        canonical(optimized, triangle);
+        actual.push_back((static_cast<uint64_t>(triangle[0]) << 42) | (static_cast<uint64_t>(triangle[1]) << 21) | triangle[2]);
+    }
+    std::sort(expected.begin(), expected.end());
+    std::sort(actual.begin(), actual.end());
+    result.valid = valid && expected == actual;
+    return result;
+}
+
+std::vector<MeshOptimizationResult> RunMeshOptimizerBenchmark(uint32_t seed) {
+    struct Vertex {
+        float x, y, z;
+        float nx, ny, nz;
+        float u, v;
+    };
+    std::mt19937 random(seed);
+    std::vector<MeshOptimizationResult> results;
+
+    // Треугольники в случайном порядке, вершины перенумерованы случайно
+    auto shuffleMesh = [&random](std::vector<Vertex>& vertices, std::vector<uint32_t>& indices) {
+        const uint32_t triangleCount = static_cast<uint32_t>(indices.size() / 3);
+        std::vector<uint32_t> triangleOrder(triangleCount);
+        std::iota(triangleOrder.begin(), triangleOrder.end(), 0u);
+        std::shuffle(triangleOrder.begin(), triangleOrder.end(), random);
+        std::vector<uint32_t> vertexOrder(vertices.size());
+        std::iota(vertexOrder.begin(), vertexOrder.end(), 0u);
+        std::shuffle(vertexOrder.begin(), vertexOrder.end(), random);
+
+        std::vector<uint32_t> shuffledIndices(indices.size());
+        for (uint32_t t = 0; t < triangleCount; t++) {
+            for (uint32_t k = 0; k < 3; k++) {
+                shuffledIndices[t * 3 + k] = vertexOrder[indices[triangleOrder[t] * 3 + k]];
+            }
+        }
+        std::vector<Vertex> shuffledVertices(vertices.size());
+        for (size_t v = 0; v < vertices.size(); v++) {
+            shuffledVertices[vertexOrder[v]] = vertices[v];
+        }
+        vertices.swap(shuffledVertices);
+        indices.swap(shuffledIndices);
+    };
+
+    // Сфера по параллелям и меридианам
+    std::vector<Vertex> sphereVertices;
+    std::vector<uint32_t> sphereIndices;
+    const uint32_t rings = 128;
+    const uint32_t segments = 256;
+    for (uint32_t r = 0; r <= rings; r++) {
+        const float theta = DirectX::XM_PI * r / rings;
+        for (uint32_t s = 0; s <= segments; s++) {
+            const float phi = 2.0f * DirectX::XM_PI * s / segments;
+            const float x = sinf(theta) * cosf(phi);
+            const float y = cosf(theta);
+            const float z = sinf(theta) * sinf(phi);
+            sphereVertices.push_back({ x, y, z, x, y, z, static_cast<float>(s) / segments, static_cast<float>(r) / rings });
+        }
+    }
+    for (uint32_t r = 0; r < rings; r++) {
+        for (uint32_t s = 0; s < segments; s++) {
+            const uint32_t a = r * (segments + 1) + s;
+            const uint32_t b = a + segments + 1;
+            sphereIndices.insert(sphereIndices.end(), { a, b, a + 1, a + 1, b, b + 1 });
+        }
+    }
+    results.push_back(MeasureMeshOptimization("sphere, built order", sphereIndices.data(), static_cast<uint32_t>(sphereIndices.size()),
+        sphereVertices.data(), static_cast<uint32_t>(sphereVertices.size()), sizeof(Vertex)));
+    shuffleMesh(sphereVertices, sphereIndices);
+    results.push_back(MeasureMeshOptimization("sphere, shuffled", sphereIndices.data(), static_cast<uint32_t>(sphereIndices.size()),
+        sphereVertices.data(), static_cast<uint32_t>(sphereVertices.size()), sizeof(Vertex)));
+
+    // Плоская сетка 256 x 256 клеток
+    std::vector<Vertex> gridVertices;
+    std::vector<uint32_t> gridIndices;
+    const uint32_t gridSize = 256;
+    for (uint32_t y = 0; y <= gridSize; y++) {
+        for (uint32_t x = 0; x <= gridSize; x++) {
+            gridVertices.push_back({ static_cast<float>(x), 0.0f, static_cast<float>(y), 0.0f, 1.0f, 0.0f,
+                static_cast<float>(x) / gridSize, static_cast<float>(y) / gridSize });
+        }
+    }
+    for (uint32_t y = 0; y < gridSize; y++) {
+        for (uint32_t x = 0; x < gridSize; x++) {
+            const uint32_t a = y * (gridSize + 1) + x;
+            const uint32_t b = a + gridSize + 1;
+            gridIndices.insert(gridIndices.end(), { a, b, a + 1, a + 1, b, b + 1 });
+        }
+    }
+    shuffleMesh(gridVertices, gridIndices);
+    results.push_back(MeasureMeshOptimization("grid, shuffled", gridIndices.data(), static_cast<uint32_t>(gridIndices.size()),
+        gridVertices.data(), static_cast<uint32_t>(gridVertices.size()), sizeof(Vertex)));
+    return results;
+}
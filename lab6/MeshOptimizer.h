@@ -0,0 +1,66 @@
+﻿#pragma once
+
+#include <cstdint>
+#include <vector>
+
+// Оптимизация индексных и вершинных буферов треугольных сеток перед загрузкой на GPU.
+// 1. OptimizeVertexCache - порядок треугольников для кэша преобразованных вершин (алгоритм
+//    Форсайта: жадно берется треугольник с наибольшей оценкой вершин по месту в кэше и числу
+//    оставшихся треугольников).
+// 2. OptimizeOverdraw - необязательно: порядок кластеров этого порядка так, чтобы раньше
+//    рисовались обращенные наружу части сетки (Sander et al., Tipsify), пока ACMR растет
+//    не больше чем в threshold раз.
+// 3. OptimizeVertexFetch - вершины в порядке первого использования, чтобы чтение вершинного
+//    буфера шло подряд.
+// Все функции работают с 32-битными индексами; порядок вершин внутри треугольника сохраняется.
+
+struct VertexCacheStats {
+    uint32_t triangleCount = 0;
+    uint32_t vertexCount = 0;  // вершин, на которые ссылаются индексы
+    uint32_t missCount = 0;    // преобразований вершин
+    double acmr = 0;           // преобразований на треугольник: от 0.5 у больших сеток до 3
+    double atvr = 0;           // преобразований на вершину: 1 - идеал
+};
+
+// Кэш FIFO из cacheSize вершин, как у большинства GPU
+VertexCacheStats AnalyzeVertexCache(const uint32_t* pIndices, uint32_t indexCount, uint32_t vertexCount, uint32_t cacheSize = 16);
+
+// Прочитанные из вершинного буфера байты по строкам кэша 64 байта (в кэше последние 64 строки)
+// к размеру использованных вершин: 1 - каждая вершина прочитана один раз
+double AnalyzeVertexFetch(const uint32_t* pIndices, uint32_t indexCount, uint32_t vertexCount, uint32_t vertexStride);
+
+// pDestination может совпадать с pIndices
+void OptimizeVertexCache(uint32_t* pDestination, const uint32_t* pIndices, uint32_t indexCount, uint32_t vertexCount);
+
+// Индексы - результат OptimizeVertexCache. Позиция - три float в начале вершины.
+// pDestination может совпадать с pIndices
+void OptimizeOverdraw(uint32_t* pDestination, const uint32_t* pIndices, uint32_t indexCount,
+    const void* pVertices, uint32_t vertexCount, uint32_t vertexStride, float threshold = 1.05f);
+
+// Новые номера вершин в порядке первого использования; неиспользуемые получают 0xFFFFFFFF.
+// Возвращает число использованных вершин
+uint32_t BuildVertexFetchRemap(uint32_t* pRemap, const uint32_t* pIndices, uint32_t indexCount, uint32_t vertexCount);
+// Индексы переписываются на месте, вершины копируются в pDestinationVertices (не совпадает с pVertices).
+// Возвращает число вершин результата
+uint32_t OptimizeVertexFetch(void* pDestinationVertices, uint32_t* pIndices, uint32_t indexCount,
+    const void* pVertices, uint32_t vertexCount, uint32_t vertexStride);
+
+struct MeshOptimizationResult {
+    const char* mesh = "";
+    uint32_t triangleCount = 0;
+    uint32_t vertexCount = 0;
+    VertexCacheStats before;
+    VertexCacheStats after;
+    double overfetchBefore = 0;
+    double overfetchAfter = 0;
+    double milliseconds = 0;  // все три прохода
+    bool valid = false;       // те же треугольники с теми же вершинами и обходом
+};
+
+// Все три прохода над копией сетки, статистика до и после и проверка результата
+MeshOptimizationResult MeasureMeshOptimization(const char* mesh, const uint32_t* pIndices, uint32_t indexCount,
+    const void* pVertices, uint32_t vertexCount, uint32_t vertexStride);
+
+// Сетки как после загрузки без оптимизации: сфера и сетка-плоскость с треугольниками и вершинами
+// в случайном порядке и сфера в порядке построения по параллелям
+std::vector<MeshOptimizationResult> RunMeshOptimizerBenchmark(uint32_t seed = 1);
@@ -0,0 +1,841 @@
+﻿#include "MeshSimplifier.h"
+#include "FrustumCulling.h"
+#include "MeshOptimizer.h"
+#include "SceneTypes.h"
+#include "SoftwareRasterizer.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <chrono>
+#include <cmath>
+#include <random>
+
+namespace {
+
+const uint32_t kNone = 0xFFFFFFFFu;
+
+enum VertexKind : uint8_t {
+    kManifold,  // внутренняя вершина, стягивается в любого соседа
+    kBorder,    // на простой границе открытой сетки, стягивается в соседа по границе
+    kLocked,    // шов, вершина с несколькими границами или неоднозначной границей
+};
+
+// Вес плоскостей вдоль границы (на квадрат длины ребра) к весу плоскостей треугольников
+// (площадь): граница открытой сетки почти не уходит внутрь и наружу
+const float kBorderWeight = 10.0f;
+
+// Стягивание отменяется, если нормаль треугольника поворачивается почти на 90 градусов и больше
+const float kFlipDot = 1e-2f;
+
+// Квадрика: сумма w * (n . p + d)^2 по плоскостям, в матричной форме p^T A p + 2 b . p + c.
+// area - площадь треугольников, по которой ошибка усредняется
+struct Quadric {
+    float a00, a11, a22, a01, a02, a12;
+    float b0, b1, b2;
+    float c;
+    float area;
+};
+
+Quadric MakePlaneQuadric(const float n[3], float d, float weight, float area) {
+    Quadric q;
+    q.a00 = weight * n[0] * n[0];
+    q.a11 = weight * n[1] * n[1];
+    q.a22 = weight * n[2] * n[2];
+    q.a01 = weight * n[0] * n[1];
+    q.a02 = weight * n[0] * n[2];
+    q.a12 = weight * n[1] * n[2];
+    q.b0 = weight * n[0] * d;
+    q.b1 = weight * n[1] * d;
+    q.b2 = weight * n[2] * d;
+    q.c = weight * d * d;
+    q.area = area;
+    return q;
+}
+
+void AddQuadric(Quadric& q, const Quadric& r) {
+    q.a00 += r.a00; q.a11 += r.a11; q.a22 += r.a22;
+    q.a01 += r.a01; q.a02 += r.a02; q.a12 += r.a12;
+    q.b0 += r.b0; q.b1 += r.b1; q.b2 += r.b2;
+    q.c += r.c;
+    q.area += r.area;
+}
+
+float EvaluateQuadric(const Quadric& q, const float p[3]) {
+    const float rx = q.a00 * p[0] + q.a01 * p[1] + q.a02 * p[2];
+    const float ry = q.a01 * p[0] + q.a11 * p[1] + q.a12 * p[2];
+    const float rz = q.a02 * p[0] + q.a12 * p[1] + q.a22 * p[2];
+    return rx * p[0] + ry * p[1] + rz * p[2] + 2.0f * (q.b0 * p[0] + q.b1 * p[1] + q.b2 * p[2]) + q.c;
+}
+
+void Cross(const float a[3], const float b[3], float* pResult) {
+    pResult[0] = a[1] * b[2] - a[2] * b[1];
+    pResult[1] = a[2] * b[0] - a[0] * b[2];
+    pResult[2] = a[0] * b[1] - a[1] * b[0];
+}
+
+float Dot(const float a[3], const float b[3]) {
+    return a[0] * b[0] + a[1] * b[1] + a[2] * b[2];
+}
+
+// Ненормированная нормаль cross(b - a, c - a): длина - удвоенная площадь
+void GetTriangleNormal(const float* a, const float* b, const float* c, float* pNormal) {
+    const float e1[3] = { b[0] - a[0], b[1] - a[1], b[2] - a[2] };
+    const float e2[3] = { c[0] - a[0], c[1] - a[1], c[2] - a[2] };
+    Cross(e1, e2, pNormal);
+}
+
+// Треугольники, в которые входит каждая вершина
+struct Adjacency {
+    std::vector<uint32_t> offsets;    // vertexCount + 1
+    std::vector<uint32_t> triangles;
+
+    void Build(const uint32_t* pIndices, uint32_t indexCount, uint32_t vertexCount) {
+        offsets.assign(vertexCount + 1, 0);
+        for (uint32_t i = 0; i < indexCount; i++) {
+            offsets[pIndices[i] + 1]++;
+        }
+        for (uint32_t v = 0; v < vertexCount; v++) {
+            offsets[v + 1] += offsets[v];
+        }
+        triangles.resize(indexCount);
+        std::vector<uint32_t> fill(offsets.begin(), offsets.end() - 1);
+        for (uint32_t i = 0; i < indexCount; i++) {
+            triangles[fill[pIndices[i]]++] = i / 3;
+        }
+    }
+};
+
+// Есть ли треугольник с ребром from -> to в порядке обхода
+bool HasEdge(const Adjacency& adjacency, const uint32_t* pIndices, uint32_t from, uint32_t to) {
+    for (uint32_t k = adjacency.offsets[from]; k < adjacency.offsets[from + 1]; k++) {
+        const uint32_t* pTriangle = pIndices + adjacency.triangles[k] * 3;
+        for (int corner = 0; corner < 3; corner++) {
+            if (pTriangle[corner] == from && pTriangle[(corner + 1) % 3] == to) {
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+struct Collapse {
+    uint32_t from;
+    uint32_t to;
+    float cost;
+};
+
+class Simplifier {
+public:
+    Simplifier(const uint32_t* pIndices, uint32_t indexCount, const void* pVertices, uint32_t vertexCount, uint32_t vertexStride);
+
+    // Стягивает ребра, пока треугольников больше targetTriangleCount; возвращает квадрат ошибки
+    // в нормированных координатах
+    float Run(uint32_t targetTriangleCount, float errorLimit);
+
+    const std::vector<uint32_t>& GetIndices() const { return m_indices; }
+    float GetExtent() const { return m_extent; }
+
+private:
+    void LoadPositions(const void* pVertices, uint32_t vertexStride);
+    void ClassifyVertices();
+    void BuildQuadrics();
+
+    bool CanCollapse(uint32_t from, uint32_t to) const;
+    float GetCost(uint32_t from, uint32_t to) const;
+    bool FlipsTriangles(uint32_t from, uint32_t to) const;
+    uint32_t Pass(uint32_t collapseGoal, float errorLimit, bool boundCost, float& maxCost);
+
+    const float* Position(uint32_t vertex) const { return &m_positions[static_cast<size_t>(vertex) * 3]; }
+
+    uint32_t m_vertexCount;
+    float m_extent = 1.0f;
+    std::vector<uint32_t> m_indices;
+    std::vector<float> m_positions;      // нормированные в куб [0, 1]
+    std::vector<uint8_t> m_kinds;
+    std::vector<uint32_t> m_borderNext;  // соседи по границе: ребро границы vertex -> next
+    std::vector<uint32_t> m_borderPrev;
+    std::vector<Quadric> m_quadrics;
+    Adjacency m_adjacency;
+    std::vector<Collapse> m_collapses;
+    std::vector<uint32_t> m_remap;
+    std::vector<uint8_t> m_touched;      // вершины, треугольники которых уже изменены в этом проходе
+};
+
+Simplifier::Simplifier(const uint32_t* pIndices, uint32_t indexCount, const void* pVertices, uint32_t vertexCount, uint32_t vertexStride)
+    : m_vertexCount(vertexCount), m_indices(pIndices, pIndices + indexCount) {
+    LoadPositions(pVertices, vertexStride);
+    m_adjacency.Build(m_indices.data(), indexCount, vertexCount);
+    ClassifyVertices();
+    BuildQuadrics();
+}
+
+void Simplifier::LoadPositions(const void* pVertices, uint32_t vertexStride) {
+    m_positions.resize(static_cast<size_t>(m_vertexCount) * 3);
+    float minimum[3] = { FLT_MAX, FLT_MAX, FLT_MAX };
+    float maximum[3] = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+    const uint8_t* pBytes = static_cast<const uint8_t*>(pVertices);
+    for (uint32_t v = 0; v < m_vertexCount; v++) {
+        const float* p = reinterpret_cast<const float*>(pBytes + static_cast<size_t>(v) * vertexStride);
+        for (int i = 0; i < 3; i++) {
+            m_positions[v * 3 + i] = p[i];
+            minimum[i] = (std::min)(minimum[i], p[i]);
+            maximum[i] = (std::max)(maximum[i], p[i]);
+        }
+    }
+    // Квадрики во float: без сдвига и масштаба c и b теряют точность у сеток вдали от нуля
+    const float extent = (std::max)((std::max)(maximum[0] - minimum[0], maximum[1] - minimum[1]), maximum[2] - minimum[2]);
+    m_extent = extent > 0.0f ? extent : 1.0f;
+    const float scale = 1.0f / m_extent;
+    for (uint32_t v = 0; v < m_vertexCount; v++) {
+        for (int i = 0; i < 3; i++) {
+            m_positions[v * 3 + i] = (m_positions[v * 3 + i] - minimum[i]) * scale;
+        }
+    }
+}
+
+void Simplifier::ClassifyVertices() {
+    const uint32_t indexCount = static_cast<uint32_t>(m_indices.size());
+    m_kinds.assign(m_vertexCount, kManifold);
+    m_borderNext.assign(m_vertexCount, kNone);
+    m_borderPrev.assign(m_vertexCount, kNone);
+
+    // Швы: у используемой вершины есть другая вершина с той же позицией
+    std::vector<uint32_t> order;
+    order.reserve(m_vertexCount);
+    for (uint32_t v = 0; v < m_vertexCount; v++) {
+        if (m_adjacency.offsets[v + 1] > m_adjacency.offsets[v]) {
+            order.push_back(v);
+        }
+    }
+    auto less = [this](uint32_t a, uint32_t b) {
+        const float* pa = Position(a);
+        const float* pb = Position(b);
+        return pa[0] != pb[0] ? pa[0] < pb[0] : pa[1] != pb[1] ? pa[1] < pb[1] : pa[2] < pb[2];
+    };
+    std::sort(order.begin(), order.end(), less);
+    for (size_t i = 0; i + 1 < order.size(); i++) {
+        if (!less(order[i], order[i + 1])) {
+            m_kinds[order[i]] = kLocked;
+            m_kinds[order[i + 1]] = kLocked;
+        }
+    }
+
+    // Граница: ребро без ребра с обратным обходом. Вершина с одним ребром границы в каждую
+    // сторону стягивается вдоль нее, с несколькими (касание границ, неориентируемая сетка) - нет
+    std::vector<uint8_t> borderEdges(m_vertexCount, 0);
+    for (uint32_t i = 0; i < indexCount; i++) {
+        const uint32_t a = m_indices[i];
+        const uint32_t b = m_indices[i - i % 3 + (i + 1) % 3];
+        if (a == b || HasEdge(m_adjacency, m_indices.data(), b, a)) {
+            continue;
+        }
+        if (m_borderNext[a] != kNone || m_borderPrev[b] != kNone) {
+            m_kinds[a] = kLocked;
+            m_kinds[b] = kLocked;
+        }
+        m_borderNext[a] = b;
+        m_borderPrev[b] = a;
+        borderEdges[a] = static_cast<uint8_t>((std::min)(borderEdges[a] + 1, 255));
+        borderEdges[b] = static_cast<uint8_t>((std::min)(borderEdges[b] + 1, 255));
+    }
+    for (uint32_t v = 0; v < m_vertexCount; v++) {
+        if (m_kinds[v] == kManifold && borderEdges[v] != 0) {
+            const bool simple = borderEdges[v] == 2 && m_borderNext[v] != kNone && m_borderPrev[v] != kNone &&
+                m_borderNext[v] != m_borderPrev[v];
+            m_kinds[v] = simple ? kBorder : kLocked;
+        }
+    }
+}
+
+void Simplifier::BuildQuadrics() {
+    const Quadric zero = {};
+    m_quadrics.assign(m_vertexCount, zero);
+    const uint32_t indexCount = static_cast<uint32_t>(m_indices.size());
+    for (uint32_t i = 0; i < indexCount; i += 3) {
+        const uint32_t* pTriangle = &m_indices[i];
+        const float* p0 = Position(pTriangle[0]);
+        float n[3];
+        GetTriangleNormal(p0, Position(pTriangle[1]), Position(pTriangle[2]), n);
+        const float length = std::sqrt(Dot(n, n));
+        if (length == 0.0f) {
+            continue;
+        }
+        for (int k = 0; k < 3; k++) {
+            n[k] /= length;
+        }
+        const float area = length * 0.5f;
+        const Quadric plane = MakePlaneQuadric(n, -Dot(n, p0), area, area);
+        for (int k = 0; k < 3; k++) {
+            AddQuadric(m_quadrics[pTriangle[k]], plane);
+        }
+
+        // Плоскость через ребро границы перпендикулярно треугольнику
+        for (int k = 0; k < 3; k++) {
+            const uint32_t a = pTriangle[k];
+            const uint32_t b = pTriangle[(k + 1) % 3];
+            if (m_borderNext[a] != b || m_kinds[a] == kManifold) {
+                continue;
+            }
+            const float* pa = Position(a);
+            const float* pb = Position(b);
+            const float edge[3] = { pb[0] - pa[0], pb[1] - pa[1], pb[2] - pa[2] };
+            float side[3];
+            Cross(edge, n, side);
+            const float sideLength = std::sqrt(Dot(side, side));
+            if (sideLength == 0.0f) {
+                continue;
+            }
+            for (int j = 0; j < 3; j++) {
+                side[j] /= sideLength;
+            }
+            const Quadric border = MakePlaneQuadric(side, -Dot(side, pa), Dot(edge, edge) * kBorderWeight, 0.0f);
+            AddQuadric(m_quadrics[a], border);
+            AddQuadric(m_quadrics[b], border);
+        }
+    }
+}
+
+bool Simplifier::CanCollapse(uint32_t from, uint32_t to) const {
+    switch (m_kinds[from]) {
+    case kManifold:
+        return true;
+    case kBorder:
+        return to == m_borderNext[from] || to == m_borderPrev[from];
+    default:
+        return false;
+    }
+}
+
+// Средний квадрат расстояния до плоскостей обеих вершин, если from переходит в to
+float Simplifier::GetCost(uint32_t from, uint32_t to) const {
+    const Quadric& qf = m_quadrics[from];
+    const Quadric& qt = m_quadrics[to];
+    const float* p = Position(to);
+    const float error = EvaluateQuadric(qf, p) + EvaluateQuadric(qt, p);
+    const float area = qf.area + qt.area;
+    return std::fabs(error) / (area > 0.0f ? area : FLT_MIN);
+}
+
+// Треугольники from, которые остаются после стягивания, не должны перевернуться или выродиться
+bool Simplifier::FlipsTriangles(uint32_t from, uint32_t to) const {
+    const float* pTo = Position(to);
+    for (uint32_t k = m_adjacency.offsets[from]; k < m_adjacency.offsets[from + 1]; k++) {
+        const uint32_t* pTriangle = &m_indices[m_adjacency.triangles[k] * 3];
+        if (pTriangle[0] == to || pTriangle[1] == to || pTriangle[2] == to) {
+            continue;
+        }
+        const float* p[3];
+        const float* q[3];
+        for (int corner = 0; corner < 3; corner++) {
+            p[corner] = Position(pTriangle[corner]);
+            q[corner] = pTriangle[corner] == from ? pTo : p[corner];
+        }
+        float before[3];
+        float after[3];
+        GetTriangleNormal(p[0], p[1], p[2], before);
+        GetTriangleNormal(q[0], q[1], q[2], after);
+        const float beforeLength = std::sqrt(Dot(before, before));
+        const float afterLength = std::sqrt(Dot(after, after));
+        if (afterLength <= beforeLength * 1e-6f || Dot(before, after) < kFlipDot * beforeLength * afterLength) {
+            return true;
+        }
+    }
+    return false;
+}
+
+uint32_t Simplifier::Pass(uint32_t collapseGoal, float errorLimit, bool boundCost, float& maxCost) {
+    const uint32_t indexCount = static_cast<uint32_t>(m_indices.size());
+    m_adjacency.Build(m_indices.data(), indexCount, m_vertexCount);
+
+    // Каждое ребро один раз: внутреннее встречается в двух треугольниках с разным обходом
+    m_collapses.clear();
+    for (uint32_t i = 0; i < indexCount; i++) {
+        const uint32_t a = m_indices[i];
+        const uint32_t b = m_indices[i - i % 3 + (i + 1) % 3];
+        if (a > b && HasEdge(m_adjacency, m_indices.data(), b, a)) {
+            continue;
+        }
+        const bool canAB = CanCollapse(a, b);
+        const bool canBA = CanCollapse(b, a);
+        if (!canAB && !canBA) {
+            continue;
+        }
+        const float costAB = canAB ? GetCost(a, b) : FLT_MAX;
+        const float costBA = canBA ? GetCost(b, a) : FLT_MAX;
+        const Collapse collapse = costAB <= costBA ? Collapse{ a, b, costAB } : Collapse{ b, a, costBA };
+        if (collapse.cost <= errorLimit) {
+            m_collapses.push_back(collapse);
+        }
+    }
+    std::sort(m_collapses.begin(), m_collapses.end(), [](const Collapse& x, const Collapse& y) {
+        return x.cost != y.cost ? x.cost < y.cost : x.from != y.from ? x.from < y.from : x.to < y.to;
+    });
+
+    for (uint32_t v = 0; v < m_vertexCount; v++) {
+        m_remap[v] = v;
+    }
+    std::fill(m_touched.begin(), m_touched.end(), static_cast<uint8_t>(0));
+
+    // Стягивание убирает два треугольника; дороже полуторной стоимости стягивания, которого
+    // хватило бы до цели, проход не идет - дешевые ребра появятся в следующих проходах
+    const size_t edgeGoal = collapseGoal / 2;
+    const float costBound = boundCost && edgeGoal < m_collapses.size() ? m_collapses[edgeGoal].cost * 1.5f : FLT_MAX;
+    uint32_t removed = 0;
+    uint32_t performed = 0;
+    for (const Collapse& collapse : m_collapses) {
+        if (removed >= collapseGoal || collapse.cost > costBound) {
+            break;
+        }
+        const uint32_t from = collapse.from;
+        const uint32_t to = collapse.to;
+        if (m_touched[from] || m_touched[to] || FlipsTriangles(from, to)) {
+            continue;
+        }
+        // Треугольники from меняются: их вершины в этом проходе больше не стягиваются,
+        // иначе проверка переворота шла бы по устаревшим треугольникам
+        for (uint32_t k = m_adjacency.offsets[from]; k < m_adjacency.offsets[from + 1]; k++) {
+            const uint32_t* pTriangle = &m_indices[m_adjacency.triangles[k] * 3];
+            removed += pTriangle[0] == to || pTriangle[1] == to || pTriangle[2] == to ? 1 : 0;
+            for (int corner = 0; corner < 3; corner++) {
+                m_touched[pTriangle[corner]] = 1;
+            }
+        }
+        m_remap[from] = to;
+        AddQuadric(m_quadrics[to], m_quadrics[from]);
+        maxCost = (std::max)(maxCost, collapse.cost);
+
+        if (m_kinds[from] == kBorder) {
+            const uint32_t next = m_borderNext[from];
+            const uint32_t prev = m_borderPrev[from];
+            if (to == next) {
+                m_borderNext[prev] = to;
+                m_borderPrev[to] = prev;
+            }
+            else {
+                m_borderPrev[next] = to;
+                m_borderNext[to] = next;
+            }
+            // Граница из двух ребер после стягивания вырождается
+            if (m_kinds[to] == kBorder && m_borderNext[to] == m_borderPrev[to]) {
+                m_kinds[to] = kLocked;
+            }
+        }
+        performed++;
+    }
+    if (performed == 0) {
+        return 0;
+    }
+
+    // Индексы в новых номерах без треугольников, стянутых в ребро
+    uint32_t writeCount = 0;
+    for (uint32_t i = 0; i < indexCount; i += 3) {
+        const uint32_t a = m_remap[m_indices[i]];
+        const uint32_t b = m_remap[m_indices[i + 1]];
+        const uint32_t c = m_remap[m_indices[i + 2]];
+        if (a != b && b != c && a != c) {
+            m_indices[writeCount++] = a;
+            m_indices[writeCount++] = b;
+            m_indices[writeCount++] = c;
+        }
+    }
+    m_indices.resize(writeCount);
+    return performed;
+}
+
+float Simplifier::Run(uint32_t targetTriangleCount, float errorLimit) {
+    m_remap.resize(m_vertexCount);
+    m_touched.resize(m_vertexCount);
+    float maxCost = 0.0f;
+    while (m_indices.size() / 3 > targetTriangleCount) {
+        const uint32_t collapseGoal = static_cast<uint32_t>(m_indices.size() / 3) - targetTriangleCount;
+        // Если все дешевые ребра заняты или переворачивают треугольники, берутся и дорогие
+        if (Pass(collapseGoal, errorLimit, true, maxCost) == 0 && Pass(collapseGoal, errorLimit, false, maxCost) == 0) {
+            break;
+        }
+    }
+    return maxCost;
+}
+
+} // namespace
+
+uint32_t SimplifyMesh(uint32_t* pDestination, const uint32_t* pIndices, uint32_t indexCount,
+    const void* pVertices, uint32_t vertexCount, uint32_t vertexStride,
+    uint32_t targetIndexCount, float targetError, float* pResultError) {
+    Simplifier simplifier(pIndices, indexCount - indexCount % 3, pVertices, vertexCount, vertexStride);
+    const float extent = simplifier.GetExtent();
+    const float limit = targetError < FLT_MAX ? targetError / extent : FLT_MAX;
+    const float cost = simplifier.Run(targetIndexCount / 3, limit < FLT_MAX ? limit * limit : FLT_MAX);
+    if (pResultError) {
+        *pResultError = std::sqrt(cost) * extent;
+    }
+    const std::vector<uint32_t>& result = simplifier.GetIndices();
+    std::copy(result.begin(), result.end(), pDestination);
+    return static_cast<uint32_t>(result.size());
+}
+
+void BuildMeshLods(const uint32_t* pIndices, uint32_t indexCount, const void* pVertices, uint32_t vertexCount, uint32_t vertexStride,
+    std::vector<uint32_t>& lodIndices, std::vector<MeshLod>& lods, uint32_t maxLodCount, float reduction, uint32_t minTriangleCount) {
+    indexCount -= indexCount % 3;
+    lodIndices.assign(pIndices, pIndices + indexCount);
+    lods.clear();
+    lods.push_back(MeshLod{ 0, indexCount, 0.0f });
+
+    std::vector<uint32_t> current(pIndices, pIndices + indexCount);
+    std::vector<uint32_t> next(indexCount);
+    while (lods.size() < (std::min)(maxLodCount, kMaxMeshLods)) {
+        const uint32_t triangleCount = static_cast<uint32_t>(current.size() / 3);
+        if (triangleCount <= minTriangleCount) {
+            break;
+        }
+        const uint32_t targetTriangles = (std::max)(static_cast<uint32_t>(triangleCount * reduction), minTriangleCount);
+        float error = 0.0f;
+        const uint32_t resultCount = SimplifyMesh(next.data(), current.data(), static_cast<uint32_t>(current.size()),
+            pVertices, vertexCount, vertexStride, targetTriangles * 3, FLT_MAX, &error);
+        // Меньше 15% треугольников убрать не удалось: дальше упрощать мешают швы
+        if (resultCount == 0 || resultCount * 20 > current.size() * 17) {
+            break;
+        }
+        OptimizeVertexCache(next.data(), next.data(), resultCount, vertexCount);
+        lods.push_back(MeshLod{ static_cast<uint32_t>(lodIndices.size()), resultCount, lods.back().error + error });
+        lodIndices.insert(lodIndices.end(), next.begin(), next.begin() + resultCount);
+        current.assign(next.begin(), next.begin() + resultCount);
+    }
+}
+
+float GetLodPixelScale(const DirectX::XMMATRIX& projection, float viewportHeight) {
+    return DirectX::XMVectorGetY(projection.r[1]) * viewportHeight * 0.5f;
+}
+
+uint32_t SelectMeshLod(const MeshLod* pLods, uint32_t lodCount, uint32_t currentLod, float pixelsPerUnit,
+    float thresholdPixels, float hysteresis) {
+    if (lodCount == 0) {
+        return 0;
+    }
+    uint32_t lod = (std::min)(currentLod, lodCount - 1);
+    while (lod > 0 && pLods[lod].error * pixelsPerUnit > thresholdPixels) {
+        lod--;
+    }
+    const float coarserThreshold = thresholdPixels * (1.0f - hysteresis);
+    while (lod + 1 < lodCount && pLods[lod + 1].error * pixelsPerUnit <= coarserThreshold) {
+        lod++;
+    }
+    return lod;
+}
+
+// ---------------------------------------------------------------------------------------------
+// Замер
+
+namespace {
+
+struct LodBenchmarkMesh {
+    const char* name;
+    std::vector<TextureTangentVertex> vertices;
+    std::vector<uint32_t> indices;
+    std::vector<uint32_t> lodIndices;
+    std::vector<uint16_t> lodIndices16;
+    std::vector<MeshLod> lods;
+    float radius;  // ограничивающей сферы с центром в нуле
+};
+
+// Сфера радиуса около 1 с неровностями; меридиан развертки u = 0 / 1 и полюса - швы.
+// Обход по часовой стрелке снаружи, как у куба lab6
+LodBenchmarkMesh MakeBumpySphere(uint32_t stacks, uint32_t slices) {
+    LodBenchmarkMesh mesh;
+    mesh.name = "bumpy sphere";
+    const float pi = 3.14159265358979f;
+    auto position = [pi](float theta, float phi, float* p) {
+        const float r = 1.0f + 0.06f * std::sin(5.0f * theta) * std::cos(4.0f * phi) + 0.02f * std::sin(13.0f * theta + 7.0f * phi);
+        p[0] = r * std::sin(theta) * std::cos(phi);
+        p[1] = r * std::cos(theta);
+        p[2] = r * std::sin(theta) * std::sin(phi);
+    };
+    mesh.radius = 0.0f;
+    for (uint32_t i = 0; i <= stacks; i++) {
+        const float theta = pi * i / stacks;
+        for (uint32_t j = 0; j <= slices; j++) {
+            const float phi = 2.0f * pi * j / slices;
+            const float eps = 1e-3f;
+            float p[3], t0[3], t1[3], p0[3], p1[3];
+            position(theta, phi, p);
+            position(theta, phi + eps, t1);
+            position(theta, phi - eps, t0);
+            const float tangent[3] = { t1[0] - t0[0], t1[1] - t0[1], t1[2] - t0[2] };
+            position(theta + eps, phi, p1);
+            position(theta - eps, phi, p0);
+            const float bitangent[3] = { p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2] };
+            float n[3];
+            Cross(bitangent, tangent, n);
+            float length = std::sqrt(Dot(n, n));
+            if (length < 1e-9f || i == 0 || i == stacks) {
+                n[0] = p[0]; n[1] = p[1]; n[2] = p[2];
+                length = std::sqrt(Dot(n, n));
+            }
+            if (Dot(n, p) < 0.0f) {
+                length = -length;
+            }
+            const float tangentLength = std::sqrt(Dot(tangent, tangent));
+            const float tx = tangentLength > 1e-9f ? tangent[0] / tangentLength : -std::sin(phi);
+            const float tz = tangentLength > 1e-9f ? tangent[2] / tangentLength : std::cos(phi);
+            const float ty = tangentLength > 1e-9f ? tangent[1] / tangentLength : 0.0f;
+            mesh.vertices.push_back({ p[0], p[1], p[2], n[0] / length, n[1] / length, n[2] / length, tx, ty, tz,
+                static_cast<float>(j) / slices, static_cast<float>(i) / stacks });
+            mesh.radius = (std::max)(mesh.radius, std::sqrt(Dot(p, p)));
+        }
+    }
+    for (uint32_t i = 0; i < stacks; i++) {
+        for (uint32_t j = 0; j < slices; j++) {
+            const uint32_t v00 = i * (slices + 1) + j;
+            const uint32_t v01 = v00 + 1;
+            const uint32_t v10 = v00 + slices + 1;
+            const uint32_t v11 = v10 + 1;
+            if (i > 0) {
+                mesh.indices.insert(mesh.indices.end(), { v00, v01, v10 });
+            }
+            if (i + 1 < stacks) {
+                mesh.indices.insert(mesh.indices.end(), { v01, v11, v10 });
+            }
+        }
+    }
+    return mesh;
+}
+
+// Холмистая плоскость 20 x 20 с открытой границей
+LodBenchmarkMesh MakeTerrain(uint32_t size) {
+    LodBenchmarkMesh mesh;
+    mesh.name = "terrain";
+    auto height = [](float x, float z) {
+        return 0.8f * std::sin(x * 0.7f) * std::cos(z * 0.6f) + 0.15f * std::sin(x * 3.1f + z * 2.3f);
+    };
+    mesh.radius = 0.0f;
+    for (uint32_t i = 0; i <= size; i++) {
+        for (uint32_t j = 0; j <= size; j++) {
+            const float x = 20.0f * j / size - 10.0f;
+            const float z = 20.0f * i / size - 10.0f;
+            const float y = height(x, z);
+            const float dx = (height(x + 1e-2f, z) - height(x - 1e-2f, z)) / 2e-2f;
+            const float dz = (height(x, z + 1e-2f) - height(x, z - 1e-2f)) / 2e-2f;
+            const float nl = std::sqrt(dx * dx + 1.0f + dz * dz);
+            const float tl = std::sqrt(1.0f + dx * dx);
+            mesh.vertices.push_back({ x, y, z, -dx / nl, 1.0f / nl, -dz / nl, 1.0f / tl, dx / tl, 0.0f,
+                static_cast<float>(j) / size, static_cast<float>(i) / size });
+            mesh.radius = (std::max)(mesh.radius, std::sqrt(x * x + y * y + z * z));
+        }
+    }
+    for (uint32_t i = 0; i < size; i++) {
+        for (uint32_t j = 0; j < size; j++) {
+            const uint32_t v00 = i * (size + 1) + j;
+            const uint32_t v01 = v00 + 1;
+            const uint32_t v10 = v00 + size + 1;
+            const uint32_t v11 = v10 + 1;
+            mesh.indices.insert(mesh.indices.end(), { v00, v10, v01, v01, v10, v11 });
+        }
+    }
+    return mesh;
+}
+
+double MillisecondsSince(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+MeshLodBuildResult BuildBenchmarkLods(LodBenchmarkMesh& mesh) {
+    MeshLodBuildResult result;
+    result.mesh = mesh.name;
+    result.vertexCount = static_cast<uint32_t>(mesh.vertices.size());
+    const auto startTime = std::chrono::steady_clock::now();
+    BuildMeshLods(mesh.indices.data(), static_cast<uint32_t>(mesh.indices.size()), mesh.vertices.data(), result.vertexCount,
+        sizeof(TextureTangentVertex), mesh.lodIndices, mesh.lods);
+    result.buildMilliseconds = MillisecondsSince(startTime);
+    result.lodCount = static_cast<uint32_t>(mesh.lods.size());
+
+    // Индексы в пределах буфера, треугольники не вырождены, с каждым LOD треугольников меньше, а ошибка не меньше
+    result.valid = result.lodCount > 1;
+    for (uint32_t lod = 0; lod < result.lodCount; lod++) {
+        const MeshLod& range = mesh.lods[lod];
+        result.triangleCounts[lod] = range.indexCount / 3;
+        result.errors[lod] = range.error;
+        if (lod > 0) {
+            result.valid = result.valid && result.triangleCounts[lod] < result.triangleCounts[lod - 1] &&
+                range.error >= mesh.lods[lod - 1].error;
+        }
+        for (uint32_t i = range.indexOffset; i < range.indexOffset + range.indexCount; i += 3) {
+            const uint32_t* pTriangle = &mesh.lodIndices[i];
+            result.valid = result.valid && pTriangle[0] < result.vertexCount && pTriangle[1] < result.vertexCount &&
+                pTriangle[2] < result.vertexCount && pTriangle[0] != pTriangle[1] && pTriangle[1] != pTriangle[2] &&
+                pTriangle[0] != pTriangle[2];
+        }
+    }
+    mesh.lodIndices16.assign(mesh.lodIndices.begin(), mesh.lodIndices.end());
+    return result;
+}
+
+// Ближняя плоскость и угол обзора lab6 (ComputeFrameConstants)
+const float kBenchmarkNearZ = 0.1f;
+
+// Порог ошибки LOD на экране и шаги медленного облета для подсчета переключений
+const float kLodThresholdPixels = 1.0f;
+const uint32_t kSwitchSteps = 2000;
+
+struct LodInstance {
+    DirectX::XMFLOAT3 position;
+    float scale;
+    GeomBuffer geom;
+};
+
+// Облет при t от 0 до 1: камера подлетает к центру поля на 6 единиц, отходит на 100 (предел
+// cameraRadius в HandleInput) и возвращается, обходя поле по дуге. distanceScale - дрожание
+DirectX::XMMATRIX GetOrbitView(float t, float distanceScale, DirectX::XMFLOAT4& eyePosition) {
+    using namespace DirectX;
+    const float distance = (6.0f + 94.0f * (0.5f - 0.5f * std::cos(2.0f * XM_PI * t))) * distanceScale;
+    const float angle = 1.5f * XM_PI * t;
+    const XMVECTOR eye = XMVectorSet(distance * std::sin(angle), 0.4f * distance + 2.0f, -distance * std::cos(angle), 1.0f);
+    XMStoreFloat4(&eyePosition, eye);
+    return XMMatrixLookAtLH(eye, XMVectorSet(0.0f, 0.0f, 0.0f, 1.0f), XMVectorSet(0.0f, 1.0f, 0.0f, 0.0f));
+}
+
+// Пиксели на единицу длины сетки экземпляра: по глубине ближней точки ограничивающей сферы,
+// ошибка LOD в мировых единицах растет с масштабом
+float GetInstancePixelsPerUnit(const LodInstance& instance, const DirectX::XMFLOAT4X4& view, float pixelScale, float meshRadius) {
+    const DirectX::XMFLOAT3& c = instance.position;
+    const float depth = c.x * view._13 + c.y * view._23 + c.z * view._33 + view._43 - meshRadius * instance.scale;
+    return pixelScale / (std::max)(depth, kBenchmarkNearZ) * instance.scale;
+}
+
+} // namespace
+
+MeshLodBenchmarkResult RunMeshLodBenchmark(ThreadPool& threadPool, uint32_t gridSize, uint32_t frameCount,
+    uint32_t width, uint32_t height, uint32_t repeatCount) {
+    using namespace DirectX;
+    MeshLodBenchmarkResult result;
+    result.frameCount = frameCount;
+    result.width = width;
+    result.height = height;
+
+    LodBenchmarkMesh sphere = MakeBumpySphere(64, 128);
+    LodBenchmarkMesh terrain = MakeTerrain(255);
+    result.builds.push_back(BuildBenchmarkLods(sphere));
+    result.builds.push_back(BuildBenchmarkLods(terrain));
+
+    // Поле экземпляров сферы с шагом 6 единиц, случайный масштаб
+    const float spacing = 6.0f;
+    const float half = spacing * (gridSize - 1) * 0.5f;
+    std::mt19937 random(1);
+    std::uniform_real_distribution<float> scaleDistribution(0.7f, 1.6f);
+    std::vector<LodInstance> instances;
+    for (uint32_t i = 0; i < gridSize; i++) {
+        for (uint32_t j = 0; j < gridSize; j++) {
+            LodInstance instance;
+            instance.position = XMFLOAT3(j * spacing - half, 0.0f, i * spacing - half);
+            instance.scale = scaleDistribution(random);
+            instance.geom.model = XMMatrixScaling(instance.scale, instance.scale, instance.scale) *
+                XMMatrixTranslation(instance.position.x, instance.position.y, instance.position.z);
+            instance.geom.normalMatrix = instance.geom.model;
+            instances.push_back(instance);
+        }
+    }
+    result.instanceCount = static_cast<uint32_t>(instances.size());
+
+    // Проекция lab6, пропорции - по размеру кадра
+    const XMMATRIX projection = XMMatrixPerspectiveFovLH(XM_PI / 3.0f, static_cast<float>(width) / height, kBenchmarkNearZ, 1000.0f);
+    const float pixelScale = GetLodPixelScale(projection, static_cast<float>(height));
+    const uint32_t lodCount = static_cast<uint32_t>(sphere.lods.size());
+
+    std::vector<SceneBuffer> scenes(frameCount);
+    std::vector<XMMATRIX> views(frameCount);
+    for (uint32_t frame = 0; frame < frameCount; frame++) {
+        SceneBuffer& scene = scenes[frame];
+        scene = {};
+        views[frame] = GetOrbitView(frameCount > 1 ? static_cast<float>(frame) / (frameCount - 1) : 0.0f, 1.0f, scene.cameraPos);
+        scene.vp = views[frame] * projection;
+        scene.lightCount = XMFLOAT4(1, 0, 0, 0);
+        scene.lights[0].pos = XMFLOAT4(20.0f, 40.0f, -30.0f, 1.0f);
+        scene.lights[0].color = XMFLOAT4(1.0f, 1.0f, 1.0f, 1.0f);
+        scene.ambientColor = XMFLOAT4(0.05f, 0.05f, 0.05f, 1.0f);
+    }
+
+    MaterialBuffer material = {};
+    material.shine = XMFLOAT4(32.0f, 0.0f, 0.0f, 0.0f);
+    static const float clearColor[4] = { 0.3f, 0.3f, 0.3f, 1.0f };
+    SoftwareRasterizer rasterizer(threadPool, width, height);
+
+    const char* const modeNames[] = { "full detail", "lod", "lod + hysteresis" };
+    const float hysteresis[] = { 0.0f, 0.0f, 0.25f };
+    for (uint32_t mode = 0; mode < 3; mode++) {
+        MeshLodFrameResult frames;
+        frames.mode = modeNames[mode];
+        std::vector<uint32_t> currentLods(instances.size(), 0);
+        uint64_t triangles = 0;
+        double milliseconds = 0;
+        for (uint32_t frame = 0; frame < frameCount; frame++) {
+            const Frustum frustum = ExtractFrustum(scenes[frame].vp);
+            XMFLOAT4X4 view;
+            XMStoreFloat4x4(&view, views[frame]);
+
+            // LOD выбирается и у невидимых экземпляров, но рисуются только попавшие в пирамиду
+            std::vector<SoftwareMeshDraw> draws;
+            for (size_t i = 0; i < instances.size(); i++) {
+                LodInstance& instance = instances[i];
+                instance.geom.view = views[frame];
+                instance.geom.projection = projection;
+                uint32_t& lod = currentLods[i];
+                if (mode > 0) {
+                    lod = SelectMeshLod(sphere.lods.data(), lodCount, lod,
+                        GetInstancePixelsPerUnit(instance, view, pixelScale, sphere.radius), kLodThresholdPixels, hysteresis[mode]);
+                }
+
+                const XMFLOAT3& c = instance.position;
+                const float radius = sphere.radius * instance.scale;
+                bool visible = true;
+                for (int p = 0; p < 6; p++) {
+                    const float* plane = frustum.planes[p];
+                    visible = visible && c.x * plane[0] + c.y * plane[1] + c.z * plane[2] + plane[3] >= -radius;
+                }
+                if (!visible) {
+                    continue;
+                }
+                frames.lodHistogram[lod]++;
+
+                SoftwareMeshDraw draw;
+                draw.vertices = sphere.vertices.data();
+                draw.vertexCount = static_cast<uint32_t>(sphere.vertices.size());
+                draw.indices = sphere.lodIndices16.data() + sphere.lods[lod].indexOffset;
+                draw.indexCount = sphere.lods[lod].indexCount;
+                draw.geom = &instance.geom;
+                draws.push_back(draw);
+                triangles += draw.indexCount / 3;
+            }
+
+            double best = 0;
+            for (uint32_t repeat = 0; repeat < repeatCount; repeat++) {
+                const auto startTime = std::chrono::steady_clock::now();
+                rasterizer.BeginFrame(clearColor, scenes[frame], material);
+                for (const SoftwareMeshDraw& draw : draws) {
+                    rasterizer.DrawMesh(draw);
+                }
+                rasterizer.EndFrame();
+                const double elapsed = MillisecondsSince(startTime);
+                best = repeat == 0 || elapsed < best ? elapsed : best;
+            }
+            milliseconds += best;
+        }
+        frames.trianglesPerFrame = frameCount > 0 ? triangles / frameCount : 0;
+        frames.millisecondsPerFrame = frameCount > 0 ? milliseconds / frameCount : 0;
+
+        // Переключения: медленный отход камеры от поля с дрожанием расстояния на 2% без отрисовки
+        if (mode > 0) {
+            std::fill(currentLods.begin(), currentLods.end(), 0u);
+            for (uint32_t step = 0; step < kSwitchSteps; step++) {
+                XMFLOAT4 eye;
+                XMFLOAT4X4 view;
+                XMStoreFloat4x4(&view, GetOrbitView(0.5f * step / kSwitchSteps, 1.0f + 0.02f * std::sin(step * 2.5f), eye));
+                for (size_t i = 0; i < instances.size(); i++) {
+                    const uint32_t lod = SelectMeshLod(sphere.lods.data(), lodCount, currentLods[i],
+                        GetInstancePixelsPerUnit(instances[i], view, pixelScale, sphere.radius), kLodThresholdPixels, hysteresis[mode]);
+                    frames.lodSwitches += step > 0 && lod != currentLods[i] ? 1 : 0;
+                    currentLods[i] = lod;
+                }
+            }
+        }
+        result.frames.push_back(frames);
+    }
+    return result;
+}
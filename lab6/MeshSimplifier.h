@@ -0,0 +1,94 @@
+﻿#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include <DirectXMath.h>
+
+class ThreadPool;
+
+// Упрощение треугольных сеток по квадрикам ошибки (Garland, Heckbert) для цепочки LOD
+// и выбор LOD по размеру ошибки на экране.
+//
+// Ребра стягиваются в одну из своих вершин, так что индексы упрощенной сетки ссылаются на тот же
+// вершинный буфер - все LOD сетки делят один буфер вершин. Стоимость стягивания u -> v - сумма
+// квадрик плоскостей треугольников обеих вершин в точке v, деленная на их площадь: средний
+// квадрат расстояния до исходной поверхности. За проход ребра берутся по возрастанию стоимости,
+// стягивание пропускается, если переворачивает треугольник или задевает уже измененные
+// в этом проходе треугольники.
+//
+// Вершины на шве (несколько вершин с одной позицией: разные нормали или развертка) и вершины
+// с неоднозначной границей не двигаются; вершины границы открытой сетки стягиваются только
+// вдоль границы. Позиция - три float в начале вершины.
+
+const uint32_t kMaxMeshLods = 8;
+
+struct MeshLod {
+    uint32_t indexOffset;  // в общем массиве индексов всех LOD
+    uint32_t indexCount;
+    float error;           // оценка отклонения от LOD 0 в единицах сетки, у LOD 0 - 0
+};
+
+// Упрощает сетку до targetIndexCount индексов или пока стоимость стягивания не превысит
+// targetError (в единицах сетки). pDestination может совпадать с pIndices. Возвращает число
+// индексов результата, в pResultError - оценку отклонения результата от исходной сетки
+uint32_t SimplifyMesh(uint32_t* pDestination, const uint32_t* pIndices, uint32_t indexCount,
+    const void* pVertices, uint32_t vertexCount, uint32_t vertexStride,
+    uint32_t targetIndexCount, float targetError, float* pResultError = nullptr);
+
+// Цепочка LOD: каждый следующий - упрощение предыдущего примерно в 1 / reduction раз
+// треугольников, с порядком треугольников для кэша вершин (MeshOptimizer.h). В lodIndices
+// пишутся индексы всех LOD подряд, начиная с копии исходных (LOD 0). Цепочка обрывается на
+// maxLodCount, на minTriangleCount треугольников или когда сетка почти перестает упрощаться
+// (швы и выступы). Ошибки накапливаются: ошибка LOD - сумма ошибок шагов до него
+void BuildMeshLods(const uint32_t* pIndices, uint32_t indexCount, const void* pVertices, uint32_t vertexCount, uint32_t vertexStride,
+    std::vector<uint32_t>& lodIndices, std::vector<MeshLod>& lods,
+    uint32_t maxLodCount = kMaxMeshLods, float reduction = 0.5f, uint32_t minTriangleCount = 64);
+
+// Пикселей экрана на единицу длины на расстоянии 1 по оси взгляда: для перспективной матрицы
+// (XMMatrixPerspectiveFovLH) - projection._22 * высота / 2. Для объекта на глубине z ошибка
+// error занимает на экране error * GetLodPixelScale / z пикселей
+float GetLodPixelScale(const DirectX::XMMATRIX& projection, float viewportHeight);
+
+// Самый грубый LOD, ошибка которого на экране не больше thresholdPixels, с гистерезисом:
+// к более подробному LOD переход сразу, как только ошибка текущего превысила порог,
+// а к более грубому - только когда его ошибка меньше порога в (1 - hysteresis) раз. Так объект
+// на границе двух LOD не переключается туда и обратно в каждом кадре. pixelsPerUnit -
+// GetLodPixelScale / глубину ближней точки ограничивающей сферы (не меньше ближней плоскости)
+uint32_t SelectMeshLod(const MeshLod* pLods, uint32_t lodCount, uint32_t currentLod, float pixelsPerUnit,
+    float thresholdPixels = 1.0f, float hysteresis = 0.25f);
+
+struct MeshLodBuildResult {
+    const char* mesh = "";
+    uint32_t vertexCount = 0;
+    uint32_t lodCount = 0;
+    uint32_t triangleCounts[kMaxMeshLods] = {};
+    float errors[kMaxMeshLods] = {};
+    double buildMilliseconds = 0;
+    bool valid = false;  // индексы в пределах буфера, нет вырожденных треугольников, ошибки растут
+};
+
+struct MeshLodFrameResult {
+    const char* mode = "";
+    uint64_t trianglesPerFrame = 0;    // в среднем по кадрам
+    double millisecondsPerFrame = 0;   // лучший из замеров на программном растеризаторе
+    uint32_t lodSwitches = 0;          // смен LOD экземпляров на медленном отходе камеры
+    uint32_t lodHistogram[kMaxMeshLods] = {};  // экземпляро-кадров на каждом LOD
+};
+
+struct MeshLodBenchmarkResult {
+    std::vector<MeshLodBuildResult> builds;
+    std::vector<MeshLodFrameResult> frames;  // полная детализация, LOD без гистерезиса и с гистерезисом
+    uint32_t instanceCount = 0;
+    uint32_t frameCount = 0;
+    uint32_t width = 0;
+    uint32_t height = 0;
+};
+
+// Цепочки LOD неровной сферы (16 тысяч треугольников, шов развертки и полюса) и холмистой плоскости
+// (130 тысяч, открытая граница). Поле из gridSize x gridSize экземпляров сферы облетается камерой,
+// которая подлетает к нему и отходит на 100 единиц (предел cameraRadius в HandleInput); кадры рисуются
+// на программном растеризаторе с проекцией lab6 (60 градусов) в полной детализации и с LOD.
+// Переключения LOD считаются на отдельном медленном отходе камеры с дрожанием расстояния
+MeshLodBenchmarkResult RunMeshLodBenchmark(ThreadPool& threadPool, uint32_t gridSize = 10, uint32_t frameCount = 32,
+    uint32_t width = 640, uint32_t height = 360, uint32_t repeatCount = 2);
@@ -0,0 +1,653 @@
+﻿#include "Meshlets.h"
+#include "CpuFeatures.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <random>
+
+#if defined(_M_X64) || defined(__x86_64__) || defined(__SSE2__) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define MESHLET_HAS_SSE2 1
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#define MESHLET_TARGET_AVX2
+#else
+#define MESHLET_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+#else
+#define MESHLET_HAS_SSE2 0
+#endif
+
+namespace {
+
+const uint32_t kNone = 0xFFFFFFFFu;
+
+// Вес отклонения нормали треугольника от средней нормали кластера против числа новых вершин
+const float kConeWeight = 0.25f;
+
+// Кластер с нормалями шире 84 градусов от оси почти никогда не обращен от камеры целиком
+const float kMinConeDot = 0.1f;
+
+inline const float* GetPosition(const void* pVertices, uint32_t vertexStride, uint32_t vertex) {
+    return reinterpret_cast<const float*>(static_cast<const uint8_t*>(pVertices) + static_cast<size_t>(vertex) * vertexStride);
+}
+
+// Единичная внешняя нормаль, у вырожденного треугольника нулевая
+void GetTriangleNormal(const float* a, const float* b, const float* c, float* pNormal) {
+    const float e1[3] = { b[0] - a[0], b[1] - a[1], b[2] - a[2] };
+    const float e2[3] = { c[0] - a[0], c[1] - a[1], c[2] - a[2] };
+    const float n[3] = { e1[1] * e2[2] - e1[2] * e2[1], e1[2] * e2[0] - e1[0] * e2[2], e1[0] * e2[1] - e1[1] * e2[0] };
+    const float length = std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+    const float scale = length > 0.0f ? 1.0f / length : 0.0f;
+    for (int i = 0; i < 3; i++) {
+        pNormal[i] = n[i] * scale;
+    }
+}
+
+// Сфера по центру AABB вершин кластера и конус по нормалям его треугольников
+void ComputeMeshletBounds(const MeshletMesh& mesh, const Meshlet& meshlet, uint32_t index, const void* pVertices, uint32_t vertexStride,
+    const std::vector<float>& normals, const std::vector<uint32_t>& triangleIds, MeshletBounds& bounds) {
+    float minimum[3] = { 0, 0, 0 };
+    float maximum[3] = { 0, 0, 0 };
+    for (uint32_t k = 0; k < meshlet.vertexCount; k++) {
+        const float* p = GetPosition(pVertices, vertexStride, mesh.vertices[meshlet.vertexOffset + k]);
+        for (int i = 0; i < 3; i++) {
+            minimum[i] = k == 0 || p[i] < minimum[i] ? p[i] : minimum[i];
+            maximum[i] = k == 0 || p[i] > maximum[i] ? p[i] : maximum[i];
+        }
+    }
+    const DirectX::XMFLOAT3 center((minimum[0] + maximum[0]) * 0.5f, (minimum[1] + maximum[1]) * 0.5f, (minimum[2] + maximum[2]) * 0.5f);
+    float radiusSquared = 0.0f;
+    for (uint32_t k = 0; k < meshlet.vertexCount; k++) {
+        const float* p = GetPosition(pVertices, vertexStride, mesh.vertices[meshlet.vertexOffset + k]);
+        const float d[3] = { p[0] - center.x, p[1] - center.y, p[2] - center.z };
+        radiusSquared = (std::max)(radiusSquared, d[0] * d[0] + d[1] * d[1] + d[2] * d[2]);
+    }
+    bounds.spheres.Set(index, center, std::sqrt(radiusSquared));
+
+    float axis[3] = { 0, 0, 0 };
+    for (uint32_t t = 0; t < meshlet.triangleCount; t++) {
+        const float* n = &normals[static_cast<size_t>(triangleIds[meshlet.indexOffset / 3 + t]) * 3];
+        for (int i = 0; i < 3; i++) {
+            axis[i] += n[i];
+        }
+    }
+    const float axisLength = std::sqrt(axis[0] * axis[0] + axis[1] * axis[1] + axis[2] * axis[2]);
+    float minDot = axisLength > 1e-6f ? 1.0f : -1.0f;
+    for (int i = 0; i < 3; i++) {
+        axis[i] = axisLength > 1e-6f ? axis[i] / axisLength : 0.0f;
+    }
+    for (uint32_t t = 0; t < meshlet.triangleCount && minDot > kMinConeDot; t++) {
+        const float* n = &normals[static_cast<size_t>(triangleIds[meshlet.indexOffset / 3 + t]) * 3];
+        const float lengthSquared = n[0] * n[0] + n[1] * n[1] + n[2] * n[2];
+        if (lengthSquared > 0.0f) {
+            minDot = (std::min)(minDot, n[0] * axis[0] + n[1] * axis[1] + n[2] * axis[2]);
+        }
+    }
+    // Запас на округления: конус расширяется, кластер отсекается чуть реже
+    minDot -= 1e-4f;
+    bounds.coneAxisX[index] = axis[0];
+    bounds.coneAxisY[index] = axis[1];
+    bounds.coneAxisZ[index] = axis[2];
+    bounds.coneCutoff[index] = minDot > kMinConeDot ? std::sqrt(1.0f - minDot * minDot) : 1.0f;
+}
+
+// Все точки сферы видят треугольники кластера с обратной стороны: направление от камеры на любую
+// точку сферы отклоняется от оси меньше чем на 90 градусов минус раствор конуса. Порядок операций
+// один во всех путях - результаты совпадают
+inline bool IsConeBackfacing(float cx, float cy, float cz, float radius, float ax, float ay, float az, float cutoff, const DirectX::XMFLOAT3& camera) {
+    const float dx = cx - camera.x;
+    const float dy = cy - camera.y;
+    const float dz = cz - camera.z;
+    const float distance = std::sqrt((dx * dx + dy * dy) + dz * dz);
+    const float d = (dx * ax + dy * ay) + dz * az;
+    return d > cutoff * distance + radius * (1.0f + cutoff);
+}
+
+inline float PlaneDistance(const float plane[4], float x, float y, float z) {
+    return ((x * plane[0] + y * plane[1]) + z * plane[2]) + plane[3];
+}
+
+uint32_t CullMeshletsScalar(const Frustum& frustum, const DirectX::XMFLOAT3& camera, const MeshletBounds& bounds, uint32_t begin,
+    uint32_t* pVisible, uint32_t visibleCount) {
+    const SphereBounds& spheres = bounds.spheres;
+    for (uint32_t i = begin; i < bounds.GetCount(); i++) {
+        const float negRadius = -spheres.radius[i];
+        bool rejected = IsConeBackfacing(spheres.x[i], spheres.y[i], spheres.z[i], spheres.radius[i],
+            bounds.coneAxisX[i], bounds.coneAxisY[i], bounds.coneAxisZ[i], bounds.coneCutoff[i], camera);
+        for (int p = 0; p < 6; p++) {
+            rejected |= PlaneDistance(frustum.planes[p], spheres.x[i], spheres.y[i], spheres.z[i]) < negRadius;
+        }
+        pVisible[visibleCount] = i;
+        visibleCount += rejected ? 0 : 1;
+    }
+    return visibleCount;
+}
+
+#if MESHLET_HAS_SSE2
+
+inline uint32_t AppendVisible(int mask, uint32_t laneCount, uint32_t first, uint32_t* pVisible, uint32_t visibleCount) {
+    for (uint32_t lane = 0; lane < laneCount; lane++) {
+        pVisible[visibleCount] = first + lane;
+        visibleCount += (mask >> lane) & 1;
+    }
+    return visibleCount;
+}
+
+uint32_t CullMeshletsSse2(const Frustum& frustum, const DirectX::XMFLOAT3& camera, const MeshletBounds& bounds, uint32_t* pVisible) {
+    const SphereBounds& spheres = bounds.spheres;
+    const uint32_t blockEnd = bounds.GetCount() & ~3u;
+    const __m128 one = _mm_set1_ps(1.0f);
+    uint32_t visibleCount = 0;
+    for (uint32_t i = 0; i < blockEnd; i += 4) {
+        const __m128 x = _mm_loadu_ps(spheres.x.data() + i);
+        const __m128 y = _mm_loadu_ps(spheres.y.data() + i);
+        const __m128 z = _mm_loadu_ps(spheres.z.data() + i);
+        const __m128 radius = _mm_loadu_ps(spheres.radius.data() + i);
+        const __m128 negRadius = _mm_sub_ps(_mm_setzero_ps(), radius);
+
+        const __m128 dx = _mm_sub_ps(x, _mm_set1_ps(camera.x));
+        const __m128 dy = _mm_sub_ps(y, _mm_set1_ps(camera.y));
+        const __m128 dz = _mm_sub_ps(z, _mm_set1_ps(camera.z));
+        const __m128 distance = _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz)));
+        const __m128 d = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, _mm_loadu_ps(bounds.coneAxisX.data() + i)),
+            _mm_mul_ps(dy, _mm_loadu_ps(bounds.coneAxisY.data() + i))), _mm_mul_ps(dz, _mm_loadu_ps(bounds.coneAxisZ.data() + i)));
+        const __m128 cutoff = _mm_loadu_ps(bounds.coneCutoff.data() + i);
+        __m128 rejected = _mm_cmpgt_ps(d, _mm_add_ps(_mm_mul_ps(cutoff, distance), _mm_mul_ps(radius, _mm_add_ps(one, cutoff))));
+
+        for (int p = 0; p < 6; p++) {
+            const float* plane = frustum.planes[p];
+            const __m128 planeDistance = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(x, _mm_set1_ps(plane[0])), _mm_mul_ps(y, _mm_set1_ps(plane[1]))),
+                _mm_mul_ps(z, _mm_set1_ps(plane[2]))), _mm_set1_ps(plane[3]));
+            rejected = _mm_or_ps(rejected, _mm_cmplt_ps(planeDistance, negRadius));
+        }
+        visibleCount = AppendVisible(~_mm_movemask_ps(rejected) & 0xF, 4, i, pVisible, visibleCount);
+    }
+    return CullMeshletsScalar(frustum, camera, bounds, blockEnd, pVisible, visibleCount);
+}
+
+MESHLET_TARGET_AVX2 uint32_t CullMeshletsAvx2(const Frustum& frustum, const DirectX::XMFLOAT3& camera, const MeshletBounds& bounds, uint32_t* pVisible) {
+    const SphereBounds& spheres = bounds.spheres;
+    const uint32_t blockEnd = bounds.GetCount() & ~7u;
+    const __m256 one = _mm256_set1_ps(1.0f);
+    uint32_t visibleCount = 0;
+    for (uint32_t i = 0; i < blockEnd; i += 8) {
+        const __m256 x = _mm256_loadu_ps(spheres.x.data() + i);
+        const __m256 y = _mm256_loadu_ps(spheres.y.data() + i);
+        const __m256 z = _mm256_loadu_ps(spheres.z.data() + i);
+        const __m256 radius = _mm256_loadu_ps(spheres.radius.data() + i);
+        const __m256 negRadius = _mm256_sub_ps(_mm256_setzero_ps(), radius);
+
+        const __m256 dx = _mm256_sub_ps(x, _mm256_set1_ps(camera.x));
+        const __m256 dy = _mm256_sub_ps(y, _mm256_set1_ps(camera.y));
+        const __m256 dz = _mm256_sub_ps(z, _mm256_set1_ps(camera.z));
+        const __m256 distance = _mm256_sqrt_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(dx, dx), _mm256_mul_ps(dy, dy)), _mm256_mul_ps(dz, dz)));
+        const __m256 d = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(dx, _mm256_loadu_ps(bounds.coneAxisX.data() + i)),
+            _mm256_mul_ps(dy, _mm256_loadu_ps(bounds.coneAxisY.data() + i))), _mm256_mul_ps(dz, _mm256_loadu_ps(bounds.coneAxisZ.data() + i)));
+        const __m256 cutoff = _mm256_loadu_ps(bounds.coneCutoff.data() + i);
+        __m256 rejected = _mm256_cmp_ps(d, _mm256_add_ps(_mm256_mul_ps(cutoff, distance), _mm256_mul_ps(radius, _mm256_add_ps(one, cutoff))), _CMP_GT_OQ);
+
+        for (int p = 0; p < 6; p++) {
+            const float* plane = frustum.planes[p];
+            const __m256 planeDistance = _mm256_add_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(x, _mm256_set1_ps(plane[0])),
+                _mm256_mul_ps(y, _mm256_set1_ps(plane[1]))), _mm256_mul_ps(z, _mm256_set1_ps(plane[2]))), _mm256_set1_ps(plane[3]));
+            rejected = _mm256_or_ps(rejected, _mm256_cmp_ps(planeDistance, negRadius, _CMP_LT_OQ));
+        }
+        // Кластеров на порядки меньше треугольников - достаточно простой раскладки маски
+        visibleCount = AppendVisible(~_mm256_movemask_ps(rejected) & 0xFF, 8, i, pVisible, visibleCount);
+    }
+    _mm256_zeroupper();
+    return CullMeshletsScalar(frustum, camera, bounds, blockEnd, pVisible, visibleCount);
+}
+
+#endif // MESHLET_HAS_SSE2
+
+} // namespace
+
+void MeshletBounds::Resize(uint32_t count) {
+    spheres.Resize(count);
+    coneAxisX.resize(count);
+    coneAxisY.resize(count);
+    coneAxisZ.resize(count);
+    coneCutoff.resize(count);
+}
+
+void BuildMeshlets(const uint32_t* pIndices, uint32_t indexCount, const void* pVertices, uint32_t vertexCount, uint32_t vertexStride,
+    MeshletMesh& result, uint32_t maxVertices, uint32_t maxTriangles) {
+    result.meshlets.clear();
+    result.vertices.clear();
+    result.indices.clear();
+    const uint32_t triangleCount = indexCount / 3;
+    maxVertices = (std::max)(maxVertices, 3u);
+    maxTriangles = (std::max)(maxTriangles, 1u);
+
+    std::vector<float> normals(static_cast<size_t>(triangleCount) * 3);
+    std::vector<float> centers(static_cast<size_t>(triangleCount) * 3);
+    for (uint32_t t = 0; t < triangleCount; t++) {
+        const float* a = GetPosition(pVertices, vertexStride, pIndices[t * 3]);
+        const float* b = GetPosition(pVertices, vertexStride, pIndices[t * 3 + 1]);
+        const float* c = GetPosition(pVertices, vertexStride, pIndices[t * 3 + 2]);
+        GetTriangleNormal(a, b, c, &normals[static_cast<size_t>(t) * 3]);
+        for (int i = 0; i < 3; i++) {
+            centers[static_cast<size_t>(t) * 3 + i] = (a[i] + b[i] + c[i]) * (1.0f / 3.0f);
+        }
+    }
+
+    // Треугольники у каждой вершины; в начале списка - еще не взятые в кластеры (liveCounts)
+    std::vector<uint32_t> offsets(static_cast<size_t>(vertexCount) + 1, 0);
+    std::vector<uint32_t> liveCounts(vertexCount, 0);
+    for (uint32_t i = 0; i < triangleCount * 3; i++) {
+        liveCounts[pIndices[i]]++;
+    }
+    for (uint32_t v = 0; v < vertexCount; v++) {
+        offsets[v + 1] = offsets[v] + liveCounts[v];
+    }
+    std::vector<uint32_t> adjacency(static_cast<size_t>(triangleCount) * 3);
+    {
+        std::vector<uint32_t> fill(offsets.begin(), offsets.end() - 1);
+        for (uint32_t i = 0; i < triangleCount * 3; i++) {
+            adjacency[fill[pIndices[i]]++] = i / 3;
+        }
+    }
+
+    std::vector<uint8_t> used(triangleCount, 0);
+    std::vector<uint32_t> vertexMeshlet(vertexCount, kNone); // кластер, в который последним попала вершина
+    std::vector<uint32_t> triangleIds;                       // исходные номера треугольников по кластерам
+    triangleIds.reserve(triangleCount);
+
+    Meshlet meshlet = {};
+    uint32_t meshletIndex = 0;
+    float axis[3] = { 0, 0, 0 };
+    float centroid[3] = { 0, 0, 0 }; // сумма центров треугольников кластера
+
+    auto addTriangle = [&](uint32_t t) {
+        used[t] = 1;
+        for (uint32_t k = 0; k < 3; k++) {
+            const uint32_t v = pIndices[t * 3 + k];
+            uint32_t* pLive = &adjacency[offsets[v]];
+            for (uint32_t i = 0; i < liveCounts[v]; i++) {
+                if (pLive[i] == t) {
+                    pLive[i] = pLive[liveCounts[v] - 1];
+                    pLive[liveCounts[v] - 1] = t;
+                    liveCounts[v]--;
+                    break;
+                }
+            }
+            if (vertexMeshlet[v] != meshletIndex) {
+                vertexMeshlet[v] = meshletIndex;
+                result.vertices.push_back(v);
+                meshlet.vertexCount++;
+            }
+            result.indices.push_back(v);
+        }
+        for (int i = 0; i < 3; i++) {
+            axis[i] += normals[static_cast<size_t>(t) * 3 + i];
+            centroid[i] += centers[static_cast<size_t>(t) * 3 + i];
+        }
+        triangleIds.push_back(t);
+        meshlet.triangleCount++;
+    };
+
+    auto newVertexCount = [&](uint32_t t) {
+        const uint32_t a = pIndices[t * 3];
+        const uint32_t b = pIndices[t * 3 + 1];
+        const uint32_t c = pIndices[t * 3 + 2];
+        return (vertexMeshlet[a] != meshletIndex ? 1u : 0u) + (b != a && vertexMeshlet[b] != meshletIndex ? 1u : 0u) +
+            (c != a && c != b && vertexMeshlet[c] != meshletIndex ? 1u : 0u);
+    };
+
+    uint32_t seedCursor = 0;
+    while (triangleIds.size() < triangleCount) {
+        // Новый кластер начинается рядом с предыдущим, иначе с первого свободного треугольника
+        uint32_t seed = kNone;
+        if (!result.meshlets.empty()) {
+            const Meshlet& previous = result.meshlets.back();
+            for (uint32_t k = 0; k < previous.vertexCount && seed == kNone; k++) {
+                const uint32_t v = result.vertices[previous.vertexOffset + k];
+                seed = liveCounts[v] > 0 ? adjacency[offsets[v]] : kNone;
+            }
+        }
+        if (seed == kNone) {
+            while (used[seedCursor]) {
+                seedCursor++;
+            }
+            seed = seedCursor;
+        }
+
+        meshlet = {};
+        meshlet.indexOffset = static_cast<uint32_t>(result.indices.size());
+        meshlet.vertexOffset = static_cast<uint32_t>(result.vertices.size());
+        axis[0] = axis[1] = axis[2] = 0.0f;
+        centroid[0] = centroid[1] = centroid[2] = 0.0f;
+        addTriangle(seed);
+
+        while (meshlet.triangleCount < maxTriangles) {
+            const float axisLength = std::sqrt(axis[0] * axis[0] + axis[1] * axis[1] + axis[2] * axis[2]);
+            const float axisScale = axisLength > 0.0f ? 1.0f / axisLength : 0.0f;
+            const float invCount = 1.0f / meshlet.triangleCount;
+            const float center[3] = { centroid[0] * invCount, centroid[1] * invCount, centroid[2] * invCount };
+            uint32_t best = kNone;
+            float bestScore = 0.0f;
+            float bestDistance = 0.0f;
+            for (uint32_t k = meshlet.vertexOffset; k < result.vertices.size(); k++) {
+                const uint32_t v = result.vertices[k];
+                const uint32_t* pLive = &adjacency[offsets[v]];
+                for (uint32_t i = 0; i < liveCounts[v]; i++) {
+                    const uint32_t t = pLive[i];
+                    const uint32_t extra = newVertexCount(t);
+                    if (meshlet.vertexCount + extra > maxVertices) {
+                        continue;
+                    }
+                    const float* n = &normals[static_cast<size_t>(t) * 3];
+                    const float alignment = (n[0] * axis[0] + n[1] * axis[1] + n[2] * axis[2]) * axisScale;
+                    const float score = static_cast<float>(extra) + kConeWeight * (1.0f - alignment);
+                    const float* c = &centers[static_cast<size_t>(t) * 3];
+                    const float distance = (c[0] - center[0]) * (c[0] - center[0]) + (c[1] - center[1]) * (c[1] - center[1]) +
+                        (c[2] - center[2]) * (c[2] - center[2]);
+                    if (best == kNone || score < bestScore || (score == bestScore && (distance < bestDistance || (distance == bestDistance && t < best)))) {
+                        best = t;
+                        bestScore = score;
+                        bestDistance = distance;
+                    }
+                }
+            }
+            if (best == kNone) {
+                break;
+            }
+            addTriangle(best);
+        }
+        result.meshlets.push_back(meshlet);
+        meshletIndex++;
+    }
+
+    result.bounds.Resize(meshletIndex);
+    for (uint32_t m = 0; m < meshletIndex; m++) {
+        ComputeMeshletBounds(result, result.meshlets[m], m, pVertices, vertexStride, normals, triangleIds, result.bounds);
+    }
+}
+
+uint32_t CullMeshlets(const Frustum& frustum, const DirectX::XMFLOAT3& cameraPosition, const MeshletBounds& bounds, uint32_t* pVisible, CullPath path) {
+    if (!IsCullPathSupported(path)) {
+        path = CullPath::Scalar;
+    }
+    switch (path) {
+#if MESHLET_HAS_SSE2
+    case CullPath::Sse2:
+        return CullMeshletsSse2(frustum, cameraPosition, bounds, pVisible);
+    case CullPath::Avx2:
+        return CullMeshletsAvx2(frustum, cameraPosition, bounds, pVisible);
+#endif
+    default:
+        return CullMeshletsScalar(frustum, cameraPosition, bounds, 0, pVisible, 0);
+    }
+}
+
+uint32_t BuildMeshletDrawRanges(const MeshletMesh& mesh, const uint32_t* pVisible, uint32_t visibleCount, MeshletDrawRange* pRanges) {
+    uint32_t rangeCount = 0;
+    for (uint32_t i = 0; i < visibleCount; i++) {
+        const Meshlet& meshlet = mesh.meshlets[pVisible[i]];
+        if (rangeCount > 0 && pRanges[rangeCount - 1].indexOffset + pRanges[rangeCount - 1].indexCount == meshlet.indexOffset) {
+            pRanges[rangeCount - 1].indexCount += meshlet.triangleCount * 3;
+        }
+        else {
+            pRanges[rangeCount++] = MeshletDrawRange{ meshlet.indexOffset, meshlet.triangleCount * 3 };
+        }
+    }
+    return rangeCount;
+}
+
+namespace {
+
+struct BenchmarkMesh {
+    const char* name;
+    std::vector<float> positions; // x, y, z
+    std::vector<uint32_t> indices;
+};
+
+// Сфера радиуса 1 по параллелям и меридианам, без вырожденных треугольников у полюсов
+BenchmarkMesh MakeSphere(uint32_t stacks, uint32_t slices) {
+    BenchmarkMesh mesh;
+    mesh.name = "sphere";
+    const float pi = 3.14159265358979f;
+    for (uint32_t i = 0; i <= stacks; i++) {
+        const float theta = pi * i / stacks;
+        for (uint32_t j = 0; j <= slices; j++) {
+            const float phi = 2.0f * pi * j / slices;
+            mesh.positions.push_back(std::sin(theta) * std::cos(phi));
+            mesh.positions.push_back(std::cos(theta));
+            mesh.positions.push_back(std::sin(theta) * std::sin(phi));
+        }
+    }
+    for (uint32_t i = 0; i < stacks; i++) {
+        for (uint32_t j = 0; j < slices; j++) {
+            const uint32_t v00 = i * (slices + 1) + j;
+            const uint32_t v01 = v00 + 1;
+            const uint32_t v10 = v00 + slices + 1;
+            const uint32_t v11 = v10 + 1;
+            if (i > 0) {
+                mesh.indices.insert(mesh.indices.end(), { v00, v01, v10 });
+            }
+            if (i + 1 < stacks) {
+                mesh.indices.insert(mesh.indices.end(), { v01, v11, v10 });
+            }
+        }
+    }
+    return mesh;
+}
+
+// Холмистая плоскость 20 x 20 с нормалями вверх
+BenchmarkMesh MakeTerrain(uint32_t size) {
+    BenchmarkMesh mesh;
+    mesh.name = "terrain";
+    for (uint32_t i = 0; i <= size; i++) {
+        for (uint32_t j = 0; j <= size; j++) {
+            const float x = 20.0f * j / size - 10.0f;
+            const float z = 20.0f * i / size - 10.0f;
+            mesh.positions.push_back(x);
+            mesh.positions.push_back(0.8f * std::sin(x * 0.7f) * std::cos(z * 0.6f) + 0.15f * std::sin(x * 3.1f + z * 2.3f));
+            mesh.positions.push_back(z);
+        }
+    }
+    for (uint32_t i = 0; i < size; i++) {
+        for (uint32_t j = 0; j < size; j++) {
+            const uint32_t v00 = i * (size + 1) + j;
+            const uint32_t v01 = v00 + 1;
+            const uint32_t v10 = v00 + size + 1;
+            const uint32_t v11 = v10 + 1;
+            mesh.indices.insert(mesh.indices.end(), { v00, v10, v01, v01, v10, v11 });
+        }
+    }
+    return mesh;
+}
+
+// Кластеры покрывают каждый треугольник один раз с тем же обходом, ограничения соблюдены,
+// вершины кластеров - ровно вершины их треугольников и лежат в сферах
+bool ValidateMeshlets(const MeshletMesh& result, const BenchmarkMesh& mesh, uint32_t maxVertices, uint32_t maxTriangles) {
+    const uint32_t triangleCount = static_cast<uint32_t>(mesh.indices.size() / 3);
+    if (result.indices.size() != mesh.indices.size()) {
+        return false;
+    }
+    auto key = [](const uint32_t* pTriangle) {
+        return (static_cast<uint64_t>(pTriangle[0]) << 42) | (static_cast<uint64_t>(pTriangle[1]) << 21) | pTriangle[2];
+    };
+    std::vector<uint64_t> expected(triangleCount);
+    std::vector<uint64_t> actual(triangleCount);
+    for (uint32_t t = 0; t < triangleCount; t++) {
+        expected[t] = key(&mesh.indices[t * 3]);
+        actual[t] = key(&result.indices[t * 3]);
+    }
+    std::sort(expected.begin(), expected.end());
+    std::sort(actual.begin(), actual.end());
+    if (expected != actual) {
+        return false;
+    }
+
+    uint32_t nextIndex = 0;
+    std::vector<uint32_t> meshletVertices;
+    std::vector<uint32_t> triangleVertices;
+    for (uint32_t m = 0; m < result.GetMeshletCount(); m++) {
+        const Meshlet& meshlet = result.meshlets[m];
+        if (meshlet.indexOffset != nextIndex || meshlet.triangleCount == 0 || meshlet.triangleCount > maxTriangles || meshlet.vertexCount > maxVertices) {
+            return false;
+        }
+        nextIndex += meshlet.triangleCount * 3;
+        meshletVertices.assign(result.vertices.begin() + meshlet.vertexOffset, result.vertices.begin() + meshlet.vertexOffset + meshlet.vertexCount);
+        triangleVertices.assign(result.indices.begin() + meshlet.indexOffset, result.indices.begin() + meshlet.indexOffset + meshlet.triangleCount * 3);
+        std::sort(meshletVertices.begin(), meshletVertices.end());
+        std::sort(triangleVertices.begin(), triangleVertices.end());
+        triangleVertices.erase(std::unique(triangleVertices.begin(), triangleVertices.end()), triangleVertices.end());
+        if (meshletVertices != triangleVertices) {
+            return false;
+        }
+        const SphereBounds& spheres = result.bounds.spheres;
+        for (uint32_t v : meshletVertices) {
+            const float* p = &mesh.positions[static_cast<size_t>(v) * 3];
+            const float d[3] = { p[0] - spheres.x[m], p[1] - spheres.y[m], p[2] - spheres.z[m] };
+            if (std::sqrt(d[0] * d[0] + d[1] * d[1] + d[2] * d[2]) > spheres.radius[m] * (1.0f + 1e-5f) + 1e-6f) {
+                return false;
+            }
+        }
+    }
+    return nextIndex == result.indices.size();
+}
+
+struct BenchmarkView {
+    Frustum frustum;
+    DirectX::XMFLOAT3 camera;
+};
+
+} // namespace
+
+std::vector<MeshletBenchmarkResult> RunMeshletBenchmark(uint32_t viewCount, uint32_t repeatCount, uint32_t seed) {
+    std::mt19937 random(seed);
+    std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+    const DirectX::XMMATRIX projection = DirectX::XMMatrixPerspectiveFovLH(DirectX::XM_PI / 3.0f, 1280.0f / 720.0f, 0.1f, 1000.0f);
+
+    BenchmarkMesh meshes[] = { MakeSphere(384, 768), MakeTerrain(512) };
+    const CullPath paths[] = { CullPath::Scalar, CullPath::Sse2, CullPath::Avx2 };
+    std::vector<MeshletBenchmarkResult> results;
+    for (const BenchmarkMesh& mesh : meshes) {
+        const uint32_t vertexCount = static_cast<uint32_t>(mesh.positions.size() / 3);
+        const uint32_t triangleCount = static_cast<uint32_t>(mesh.indices.size() / 3);
+        MeshletMesh meshlets;
+        const auto buildStart = std::chrono::steady_clock::now();
+        BuildMeshlets(mesh.indices.data(), static_cast<uint32_t>(mesh.indices.size()), mesh.positions.data(), vertexCount, 3 * sizeof(float), meshlets);
+        const double buildMilliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - buildStart).count();
+        const bool meshletsValid = ValidateMeshlets(meshlets, mesh, kMeshletMaxVertices, kMeshletMaxTriangles);
+        const uint32_t meshletCount = meshlets.GetMeshletCount();
+
+        // Сфера - камера на расстоянии 3 со всех сторон, взгляд мимо центра (часть кластеров вне
+        // пирамиды); плоскость - камера над ней смотрит вниз под углом
+        std::vector<BenchmarkView> views(viewCount);
+        for (BenchmarkView& view : views) {
+            DirectX::XMVECTOR eye;
+            DirectX::XMVECTOR target;
+            if (mesh.name[0] == 's') {
+                eye = DirectX::XMVectorScale(DirectX::XMVector3Normalize(DirectX::XMVectorSet(unit(random), unit(random), unit(random), 0.0f)), 3.0f);
+                target = DirectX::XMVectorSet(unit(random) * 0.8f, unit(random) * 0.8f, unit(random) * 0.8f, 1.0f);
+            }
+            else {
+                eye = DirectX::XMVectorSet(unit(random) * 8.0f, 2.0f + unit(random), unit(random) * 8.0f, 1.0f);
+                target = DirectX::XMVectorSet(unit(random) * 8.0f, 0.0f, unit(random) * 8.0f, 1.0f);
+            }
+            const DirectX::XMMATRIX viewMatrix = DirectX::XMMatrixLookAtLH(eye, target, DirectX::XMVectorSet(0.0f, 1.0f, 0.0f, 0.0f));
+            view.frustum = ExtractFrustum(DirectX::XMMatrixMultiply(viewMatrix, projection));
+            DirectX::XMStoreFloat3(&view.camera, eye);
+        }
+
+        // Доли отброшенного и проверка консервативности по скалярному пути: кластер, отброшенный
+        // по конусу, не содержит ни одного треугольника, обращенного к камере
+        std::vector<uint32_t> frustumVisible(meshletCount);
+        std::vector<uint32_t> expected(static_cast<size_t>(viewCount) * meshletCount);
+        std::vector<uint32_t> expectedCounts(viewCount);
+        std::vector<MeshletDrawRange> ranges(meshletCount);
+        double frustumRejected = 0;
+        double coneRejected = 0;
+        double backfacing = 0;
+        double drawRanges = 0;
+        bool conservative = true;
+        for (uint32_t v = 0; v < viewCount; v++) {
+            const BenchmarkView& view = views[v];
+            uint32_t* pVisible = &expected[static_cast<size_t>(v) * meshletCount];
+            const uint32_t frustumCount = CullSpheres(view.frustum, meshlets.bounds.spheres, frustumVisible.data(), CullPath::Scalar);
+            expectedCounts[v] = CullMeshlets(view.frustum, view.camera, meshlets.bounds, pVisible, CullPath::Scalar);
+            drawRanges += BuildMeshletDrawRanges(meshlets, pVisible, expectedCounts[v], ranges.data());
+
+            uint32_t frustumTriangles = 0;
+            uint32_t visibleTriangles = 0;
+            uint32_t next = 0;
+            for (uint32_t i = 0; i < frustumCount; i++) {
+                const uint32_t m = frustumVisible[i];
+                const Meshlet& meshlet = meshlets.meshlets[m];
+                frustumTriangles += meshlet.triangleCount;
+                if (next < expectedCounts[v] && pVisible[next] == m) {
+                    visibleTriangles += meshlet.triangleCount;
+                    next++;
+                    continue;
+                }
+                for (uint32_t t = 0; t < meshlet.triangleCount; t++) {
+                    const uint32_t* pTriangle = &meshlets.indices[meshlet.indexOffset + t * 3];
+                    float normal[3];
+                    const float* a = &mesh.positions[static_cast<size_t>(pTriangle[0]) * 3];
+                    GetTriangleNormal(a, &mesh.positions[static_cast<size_t>(pTriangle[1]) * 3], &mesh.positions[static_cast<size_t>(pTriangle[2]) * 3], normal);
+                    const float facing = (a[0] - view.camera.x) * normal[0] + (a[1] - view.camera.y) * normal[1] + (a[2] - view.camera.z) * normal[2];
+                    conservative = conservative && facing >= -1e-5f;
+                }
+            }
+            conservative = conservative && next == expectedCounts[v];
+            frustumRejected += static_cast<double>(triangleCount - frustumTriangles) / triangleCount;
+            coneRejected += static_cast<double>(frustumTriangles - visibleTriangles) / triangleCount;
+
+            uint32_t backfacingCount = 0;
+            for (uint32_t t = 0; t < triangleCount; t++) {
+                float normal[3];
+                const float* a = &mesh.positions[static_cast<size_t>(mesh.indices[t * 3]) * 3];
+                GetTriangleNormal(a, &mesh.positions[static_cast<size_t>(mesh.indices[t * 3 + 1]) * 3], &mesh.positions[static_cast<size_t>(mesh.indices[t * 3 + 2]) * 3], normal);
+                backfacingCount += (a[0] - view.camera.x) * normal[0] + (a[1] - view.camera.y) * normal[1] + (a[2] - view.camera.z) * normal[2] > 0.0f ? 1 : 0;
+            }
+            backfacing += static_cast<double>(backfacingCount) / triangleCount;
+        }
+
+        std::vector<uint32_t> visible(meshletCount);
+        for (CullPath path : paths) {
+            if (!IsCullPathSupported(path)) {
+                continue;
+            }
+            MeshletBenchmarkResult result;
+            result.mesh = mesh.name;
+            result.path = path;
+            result.triangleCount = triangleCount;
+            result.meshletCount = meshletCount;
+            result.averageVertices = meshletCount > 0 ? static_cast<double>(meshlets.vertices.size()) / meshletCount : 0.0;
+            result.averageTriangles = meshletCount > 0 ? static_cast<double>(triangleCount) / meshletCount : 0.0;
+            result.buildMilliseconds = buildMilliseconds;
+            result.frustumRejectedShare = frustumRejected / viewCount;
+            result.coneRejectedShare = coneRejected / viewCount;
+            result.backfacingShare = backfacing / viewCount;
+            result.averageDrawRanges = drawRanges / viewCount;
+
+            for (uint32_t v = 0; v < viewCount; v++) {
+                const uint32_t visibleCount = CullMeshlets(views[v].frustum, views[v].camera, meshlets.bounds, visible.data(), path);
+                const uint32_t* pExpected = &expected[static_cast<size_t>(v) * meshletCount];
+                const uint32_t commonCount = (std::min)(visibleCount, expectedCounts[v]);
+                result.mismatchCount += visibleCount > expectedCounts[v] ? visibleCount - expectedCounts[v] : expectedCounts[v] - visibleCount;
+                for (uint32_t i = 0; i < commonCount; i++) {
+                    result.mismatchCount += visible[i] != pExpected[i] ? 1 : 0;
+                }
+            }
+
+            const auto startTime = std::chrono::steady_clock::now();
+            for (uint32_t repeat = 0; repeat < repeatCount; repeat++) {
+                for (const BenchmarkView& view : views) {
+                    CullMeshlets(view.frustum, view.camera, meshlets.bounds, visible.data(), path);
+                }
+            }
+            const double milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - startTime).count();
+            result.cullMilliseconds = milliseconds / (static_cast<double>(repeatCount) * viewCount);
+            result.cullMillisecondsPerMillionTriangles = result.cullMilliseconds / (triangleCount / 1e6);
+            result.valid = meshletsValid && conservative && result.mismatchCount == 0;
+            results.push_back(result);
+        }
+    }
+    return results;
+}
@@ -0,0 +1,92 @@
+﻿#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "FrustumCulling.h"
+
+// Разбиение треугольной сетки на кластеры (meshlets) до kMeshletMaxVertices вершин и
+// kMeshletMaxTriangles треугольников с ограничивающей сферой и конусом нормалей, и отсечение
+// кластеров перед отрисовкой: по пирамиде видимости и целиком обращенных от камеры.
+//
+// Кластеры строятся жадно: к кластеру добавляется соседний треугольник, которому нужно меньше
+// всего новых вершин, а при равенстве - с нормалью ближе к средней нормали кластера (узкий конус
+// чаще отсекается). Треугольники кластера лежат в MeshletMesh::indices подряд, так что видимые
+// кластеры рисуются диапазонами индексов. Лучше подавать индексы после OptimizeVertexCache.
+//
+// Передняя грань - обход по часовой стрелке (как в lab6), внешняя нормаль cross(b - a, c - a).
+
+const uint32_t kMeshletMaxVertices = 64;
+const uint32_t kMeshletMaxTriangles = 124;
+
+struct Meshlet {
+    uint32_t indexOffset;   // первый индекс треугольников кластера в MeshletMesh::indices
+    uint32_t triangleCount;
+    uint32_t vertexOffset;  // первая вершина кластера в MeshletMesh::vertices
+    uint32_t vertexCount;
+};
+
+// Границы кластеров по полям (SoA) для отсечения по 4 или 8 кластеров
+struct MeshletBounds {
+    SphereBounds spheres;
+    // Конус нормалей: ось - средняя нормаль, coneCutoff - синус половины угла раствора.
+    // 1, если треугольники смотрят в слишком разные стороны, - такой кластер не отсекается
+    std::vector<float> coneAxisX;
+    std::vector<float> coneAxisY;
+    std::vector<float> coneAxisZ;
+    std::vector<float> coneCutoff;
+
+    void Resize(uint32_t count);
+    uint32_t GetCount() const { return spheres.GetCount(); }
+};
+
+struct MeshletMesh {
+    std::vector<Meshlet> meshlets;
+    std::vector<uint32_t> vertices;  // номера вершин исходной сетки, по кластерам
+    std::vector<uint32_t> indices;   // треугольники по кластерам, в номерах исходной сетки
+    MeshletBounds bounds;
+
+    uint32_t GetMeshletCount() const { return static_cast<uint32_t>(meshlets.size()); }
+};
+
+// Позиция - три float в начале вершины. Порядок вершин внутри треугольника сохраняется
+void BuildMeshlets(const uint32_t* pIndices, uint32_t indexCount, const void* pVertices, uint32_t vertexCount, uint32_t vertexStride,
+    MeshletMesh& result, uint32_t maxVertices = kMeshletMaxVertices, uint32_t maxTriangles = kMeshletMaxTriangles);
+
+// Индексы видимых кластеров в pVisible (место под GetCount() индексов), возвращает их число.
+// frustum и cameraPosition - в координатах сетки (ExtractFrustum от model * view * projection).
+// Кластер отбрасывается, если сфера вне пирамиды или все его треугольники обращены от камеры
+// при любом положении точки в сфере. Все пути считают одинаково и совпадают побитно.
+uint32_t CullMeshlets(const Frustum& frustum, const DirectX::XMFLOAT3& cameraPosition, const MeshletBounds& bounds, uint32_t* pVisible, CullPath path);
+
+struct MeshletDrawRange {
+    uint32_t indexOffset;
+    uint32_t indexCount;
+};
+
+// Видимые кластеры (по возрастанию номеров) в диапазоны для DrawIndexed: соседние кластеры
+// сливаются в один вызов. В pRanges место под visibleCount диапазонов, возвращает их число
+uint32_t BuildMeshletDrawRanges(const MeshletMesh& mesh, const uint32_t* pVisible, uint32_t visibleCount, MeshletDrawRange* pRanges);
+
+struct MeshletBenchmarkResult {
+    const char* mesh = "";
+    CullPath path = CullPath::Scalar;
+    uint32_t triangleCount = 0;
+    uint32_t meshletCount = 0;
+    double averageVertices = 0;        // на кластер
+    double averageTriangles = 0;
+    double buildMilliseconds = 0;
+    double cullMilliseconds = 0;       // на вид, в одном потоке
+    double cullMillisecondsPerMillionTriangles = 0;
+    // Доли треугольников сетки, усредненные по видам
+    double frustumRejectedShare = 0;   // в кластерах вне пирамиды
+    double coneRejectedShare = 0;      // в кластерах внутри пирамиды, отброшенных по конусу
+    double backfacingShare = 0;        // обращенных от камеры - предел для отсечения по конусам
+    double averageDrawRanges = 0;      // вызовов DrawIndexed на вид
+    size_t mismatchCount = 0;          // расхождения со скалярным путем
+    bool valid = false;                // кластеры покрывают сетку, границы верны, отброшены только невидимые
+};
+
+// Сфера и холмистая плоскость около полумиллиона треугольников каждая, виды камеры вокруг и над сеткой;
+// все поддерживаемые пути отсечения
+std::vector<MeshletBenchmarkResult> RunMeshletBenchmark(uint32_t viewCount = 64, uint32_t repeatCount = 20, uint32_t seed = 1);
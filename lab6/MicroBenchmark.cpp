@@ -0,0 +1,309 @@
+﻿#include "MicroBenchmark.h"
+#include "DdsFile.h"
+#include "Instancing.h"
+#include "TransparencyQueue.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <random>
+#include <DirectXMath.h>
+
+namespace {
+
+double MeasureNanosecondsPerIteration(const MicroBenchmarkFunction& function, uint32_t iterations, double& checksum) {
+    const auto startTime = std::chrono::steady_clock::now();
+    checksum += function(iterations);
+    return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - startTime).count() / iterations;
+}
+
+// Камера на орбите радиуса 5, как в lab6: вид для кадра frame из frameCount
+DirectX::XMMATRIX GetOrbitView(uint32_t frame, uint32_t frameCount) {
+    const float angle = DirectX::XM_2PI * frame / frameCount;
+    return DirectX::XMMatrixLookAtLH(DirectX::XMVectorSet(5.0f * sinf(angle), 2.0f, 5.0f * cosf(angle), 0.0f),
+        DirectX::XMVectorZero(), DirectX::XMVectorSet(0.0f, 1.0f, 0.0f, 0.0f));
+}
+
+void WriteU32(std::vector<uint8_t>& data, size_t offset, uint32_t value) {
+    memcpy(data.data() + offset, &value, sizeof(value));
+}
+
+// DDS с заголовком DX10: куб size x size в BC1 с полной цепочкой mip-уровней, данные нулевые
+std::vector<uint8_t> MakeCubemapDds(uint32_t size) {
+    uint32_t mipLevels = 1;
+    size_t dataSize = 0;
+    for (uint32_t mipSize = size;; mipSize >>= 1, mipLevels++) {
+        const size_t blocks = (std::max)(1u, (mipSize + 3) / 4);
+        dataSize += blocks * blocks * 8;
+        if (mipSize == 1) {
+            break;
+        }
+    }
+    const size_t headerSize = 4 + 124 + 20;
+    std::vector<uint8_t> data(headerSize + dataSize * 6, 0);
+    memcpy(data.data(), "DDS ", 4);
+    WriteU32(data, 4, 124);                       // размер заголовка
+    WriteU32(data, 8, 0x1 | 0x2 | 0x4 | 0x1000 | 0x20000); // CAPS, HEIGHT, WIDTH, PIXELFORMAT, MIPMAPCOUNT
+    WriteU32(data, 12, size);
+    WriteU32(data, 16, size);
+    WriteU32(data, 28, mipLevels);
+    WriteU32(data, 4 + 72, 32);                   // размер описания формата
+    WriteU32(data, 4 + 76, 0x4);                  // DDPF_FOURCC
+    memcpy(data.data() + 4 + 80, "DX10", 4);
+    WriteU32(data, 4 + 124, DdsFormat::BC1_UNORM);
+    WriteU32(data, 4 + 128, 3);                   // DDS_DIMENSION_TEXTURE2D
+    WriteU32(data, 4 + 132, 0x4);                 // DDS_RESOURCE_MISC_TEXTURECUBE
+    WriteU32(data, 4 + 136, 1);
+    return data;
+}
+
+const char* FindKey(const char* pBegin, const char* pEnd, const char* key) {
+    const size_t keyLength = strlen(key);
+    for (const char* p = pBegin; p + keyLength + 2 <= pEnd; p++) {
+        if (p[0] == '"' && memcmp(p + 1, key, keyLength) == 0 && p[keyLength + 1] == '"') {
+            const char* pValue = p + keyLength + 2;
+            while (pValue < pEnd && (*pValue == ' ' || *pValue == ':' || *pValue == '\t' || *pValue == '\r' || *pValue == '\n')) {
+                pValue++;
+            }
+            return pValue < pEnd ? pValue : nullptr;
+        }
+    }
+    return nullptr;
+}
+
+bool ReadNumber(const char* pBegin, const char* pEnd, const char* key, double& value) {
+    const char* pValue = FindKey(pBegin, pEnd, key);
+    if (!pValue) {
+        return false;
+    }
+    char* pNumberEnd = nullptr;
+    value = strtod(pValue, &pNumberEnd);
+    return pNumberEnd != pValue;
+}
+
+} // namespace
+
+void MicroBenchmarkSuite::Add(const std::string& name, MicroBenchmarkFunction function) {
+    m_cases.push_back({ name, std::move(function) });
+}
+
+std::vector<MicroBenchmarkResult> MicroBenchmarkSuite::Run(uint32_t sampleCount, double sampleMilliseconds) const {
+    std::vector<MicroBenchmarkResult> results;
+    double checksum = 0;
+    std::vector<double> samples(sampleCount);
+    for (const Case& benchmarkCase : m_cases) {
+        // Число повторений удваивается, пока замер короче sampleMilliseconds; первый вызов прогревает кэши
+        uint32_t iterations = 1;
+        checksum += benchmarkCase.function(1);
+        while (iterations < (1u << 30) &&
+            MeasureNanosecondsPerIteration(benchmarkCase.function, iterations, checksum) * iterations < sampleMilliseconds * 1e6) {
+            iterations *= 2;
+        }
+
+        for (uint32_t i = 0; i < sampleCount; i++) {
+            samples[i] = MeasureNanosecondsPerIteration(benchmarkCase.function, iterations, checksum);
+        }
+        std::sort(samples.begin(), samples.end());
+
+        MicroBenchmarkResult result;
+        result.name = benchmarkCase.name;
+        result.iterations = iterations;
+        result.sampleCount = sampleCount;
+        if (sampleCount > 0) {
+            result.medianNanoseconds = sampleCount % 2 ? samples[sampleCount / 2] : (samples[sampleCount / 2 - 1] + samples[sampleCount / 2]) * 0.5;
+            result.minNanoseconds = samples.front();
+            result.maxNanoseconds = samples.back();
+        }
+        results.push_back(result);
+    }
+    // Контрольная сумма не нужна, но ее чтение не дает выбросить вызовы
+    volatile double sink = checksum;
+    (void)sink;
+    return results;
+}
+
+void AddCoreMicroBenchmarks(MicroBenchmarkSuite& suite) {
+    std::mt19937 random(1);
+    std::uniform_real_distribution<float> coordinate(-10.0f, 10.0f);
+    const uint32_t pointCount = 1024;
+    auto pX = std::make_shared<std::vector<float>>(pointCount);
+    auto pY = std::make_shared<std::vector<float>>(pointCount);
+    auto pZ = std::make_shared<std::vector<float>>(pointCount);
+    auto pPoints = std::make_shared<std::vector<DirectX::XMFLOAT3>>(pointCount);
+    for (uint32_t i = 0; i < pointCount; i++) {
+        (*pPoints)[i] = DirectX::XMFLOAT3(coordinate(random), coordinate(random), coordinate(random));
+        (*pX)[i] = (*pPoints)[i].x;
+        (*pY)[i] = (*pPoints)[i].y;
+        (*pZ)[i] = (*pPoints)[i].z;
+    }
+    const uint32_t viewCount = 64;
+    auto pViews = std::make_shared<std::vector<DirectX::XMFLOAT4X4>>(viewCount);
+    for (uint32_t i = 0; i < viewCount; i++) {
+        DirectX::XMStoreFloat4x4(&(*pViews)[i], GetOrbitView(i, viewCount));
+    }
+
+    // Глубина одной точки, как при сортировке полупрозрачных объектов (в lab5 - CalculateDistance)
+    suite.Add("ComputeViewDepth", [pPoints, pViews](uint32_t iterations) {
+        const DirectX::XMMATRIX view = DirectX::XMLoadFloat4x4(&(*pViews)[0]);
+        double sum = 0;
+        for (uint32_t i = 0; i < iterations; i++) {
+            sum += ComputeViewDepth(view, (*pPoints)[i & (1024 - 1)]);
+        }
+        return sum;
+    });
+    suite.Add("ComputeViewDepths x1024", [pX, pY, pZ, pViews](uint32_t iterations) {
+        std::vector<float> depths(1024);
+        double sum = 0;
+        for (uint32_t i = 0; i < iterations; i++) {
+            ComputeViewDepths(DirectX::XMLoadFloat4x4(&(*pViews)[i & (64 - 1)]), pX->data(), pY->data(), pZ->data(), 1024, depths.data());
+            sum += depths[i & (1024 - 1)];
+        }
+        return sum;
+    });
+
+    // Обращение и транспонирование матрицы мира
+    suite.Add("ComputeNormalMatrix", [pPoints](uint32_t iterations) {
+        double sum = 0;
+        for (uint32_t i = 0; i < iterations; i++) {
+            const DirectX::XMFLOAT3& position = (*pPoints)[i & (1024 - 1)];
+            const DirectX::XMMATRIX model = DirectX::XMMatrixMultiply(DirectX::XMMatrixRotationY(position.x),
+                DirectX::XMMatrixTranslation(position.x, position.y, position.z));
+            sum += DirectX::XMVectorGetX(ComputeNormalMatrix(model).r[0]);
+        }
+        return sum;
+    });
+
+    // Разбор заголовка и обход mip-уровней с вычислением шагов строк, как при загрузке текстур неба
+    auto pDds = std::make_shared<std::vector<uint8_t>>(MakeCubemapDds(1024));
+    suite.Add("DdsFile::OpenMemory cube 1024 BC1", [pDds](uint32_t iterations) {
+        DdsFile file;
+        double sum = 0;
+        for (uint32_t i = 0; i < iterations; i++) {
+            if (file.OpenMemory(pDds->data(), pDds->size())) {
+                sum += file.GetSubresource(file.GetMipLevels() - 1, 5).rowPitch;
+            }
+        }
+        return sum;
+    });
+
+    // Сортировка полупрозрачных квадратов от дальнего к ближнему: два квадрата, как в Render, и много
+    for (uint32_t squareCount : { 2u, 1024u }) {
+        auto pQueue = std::make_shared<TransparencyQueue>();
+        suite.Add("TransparencyQueue::Sort x" + std::to_string(squareCount), [pQueue, pPoints, pViews, squareCount](uint32_t iterations) {
+            double sum = 0;
+            pQueue->Resize(squareCount);
+            for (uint32_t i = 0; i < iterations; i++) {
+                const DirectX::XMMATRIX view = DirectX::XMLoadFloat4x4(&(*pViews)[i & (64 - 1)]);
+                for (uint32_t square = 0; square < squareCount; square++) {
+                    pQueue->SetDepth(square, ComputeViewDepth(view, (*pPoints)[square]));
+                }
+                sum += pQueue->Sort()[0];
+            }
+            return sum;
+        });
+    }
+}
+
+std::string BuildMicroBenchmarkJson(const std::vector<MicroBenchmarkResult>& results) {
+    std::string json = "{\n  \"schema\": 1,\n  \"benchmarks\": [\n";
+    char buffer[256];
+    for (size_t i = 0; i < results.size(); i++) {
+        const MicroBenchmarkResult& result = results[i];
+        // Имена случаев - обычный текст без кавычек и обратной косой черты
+        snprintf(buffer, sizeof(buffer),
+            "    {\"name\": \"%s\", \"iterations\": %llu, \"samples\": %u, \"median_ns\": %.4f, \"min_ns\": %.4f, \"max_ns\": %.4f}%s\n",
+            result.name.c_str(), static_cast<unsigned long long>(result.iterations), result.sampleCount,
+            result.medianNanoseconds, result.minNanoseconds, result.maxNanoseconds, i + 1 < results.size() ? "," : "");
+        json += buffer;
+    }
+    json += "  ]\n}\n";
+    return json;
+}
+
+bool ParseMicroBenchmarkJson(const std::string& json, std::vector<MicroBenchmarkResult>& results) {
+    results.clear();
+    const char* p = json.c_str();
+    const char* pEnd = p + json.size();
+    p = FindKey(p, pEnd, "benchmarks");
+    if (!p || *p != '[') {
+        return false;
+    }
+    // Объекты случаев без вложенных объектов: от { до }
+    for (;;) {
+        const char* pObject = static_cast<const char*>(memchr(p, '{', pEnd - p));
+        if (!pObject) {
+            break;
+        }
+        const char* pObjectEnd = static_cast<const char*>(memchr(pObject, '}', pEnd - pObject));
+        if (!pObjectEnd) {
+            return false;
+        }
+        const char* pName = FindKey(pObject, pObjectEnd, "name");
+        if (!pName || *pName != '"') {
+            return false;
+        }
+        const char* pNameEnd = static_cast<const char*>(memchr(pName + 1, '"', pObjectEnd - pName - 1));
+        if (!pNameEnd) {
+            return false;
+        }
+
+        MicroBenchmarkResult result;
+        result.name.assign(pName + 1, pNameEnd);
+        double iterations = 0;
+        double samples = 0;
+        if (!ReadNumber(pObject, pObjectEnd, "median_ns", result.medianNanoseconds)) {
+            return false;
+        }
+        ReadNumber(pObject, pObjectEnd, "iterations", iterations);
+        ReadNumber(pObject, pObjectEnd, "samples", samples);
+        ReadNumber(pObject, pObjectEnd, "min_ns", result.minNanoseconds);
+        ReadNumber(pObject, pObjectEnd, "max_ns", result.maxNanoseconds);
+        result.iterations = static_cast<uint64_t>(iterations);
+        result.sampleCount = static_cast<uint32_t>(samples);
+        results.push_back(result);
+        p = pObjectEnd + 1;
+    }
+    return true;
+}
+
+std::vector<MicroBenchmarkComparison> CompareMicroBenchmarks(const std::vector<MicroBenchmarkResult>& baseline,
+    const std::vector<MicroBenchmarkResult>& current, double tolerance) {
+    std::vector<MicroBenchmarkComparison> comparisons;
+    auto findBaseline = [&baseline](const std::string& name) -> const MicroBenchmarkResult* {
+        for (const MicroBenchmarkResult& result : baseline) {
+            if (result.name == name) {
+                return &result;
+            }
+        }
+        return nullptr;
+    };
+    for (const MicroBenchmarkResult& result : current) {
+        MicroBenchmarkComparison comparison;
+        comparison.name = result.name;
+        comparison.currentNanoseconds = result.medianNanoseconds;
+        if (const MicroBenchmarkResult* pBaseline = findBaseline(result.name)) {
+            comparison.baselineNanoseconds = pBaseline->medianNanoseconds;
+            if (comparison.baselineNanoseconds > 0) {
+                comparison.ratio = comparison.currentNanoseconds / comparison.baselineNanoseconds;
+                comparison.regression = comparison.ratio > 1.0 + tolerance;
+            }
+        }
+        comparisons.push_back(comparison);
+    }
+    for (const MicroBenchmarkResult& result : baseline) {
+        bool found = false;
+        for (const MicroBenchmarkResult& currentResult : current) {
+            found = found || currentResult.name == result.name;
+        }
+        if (!found) {
+            MicroBenchmarkComparison comparison;
+            comparison.name = result.name;
+            comparison.baselineNanoseconds = result.medianNanoseconds;
+            comparisons.push_back(comparison);
+        }
+    }
+    return comparisons;
+}
@@ -0,0 +1,62 @@
+﻿#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+// Набор микробенчмарков горячих путей математики и геометрии. Случай - функция, которая
+// повторяет операцию заданное число раз; число повторений подбирается так, чтобы один замер
+// длился не меньше заданного времени, затем делается несколько замеров и берется медиана.
+// Результаты пишутся в JSON и сравниваются с сохраненной базой: рост медианы больше допуска -
+// регрессия. Модуль и случаи из AddCoreMicroBenchmarks не зависят от Windows и D3D.
+
+struct MicroBenchmarkResult {
+    std::string name;
+    uint64_t iterations = 0;       // операций в одном замере
+    uint32_t sampleCount = 0;
+    double medianNanoseconds = 0;  // на операцию
+    double minNanoseconds = 0;
+    double maxNanoseconds = 0;
+};
+
+// Повторить операцию iterations раз. Результат - контрольная сумма, чтобы компилятор не выбросил работу
+typedef std::function<double(uint32_t iterations)> MicroBenchmarkFunction;
+
+class MicroBenchmarkSuite {
+public:
+    void Add(const std::string& name, MicroBenchmarkFunction function);
+    uint32_t GetCaseCount() const { return static_cast<uint32_t>(m_cases.size()); }
+
+    // Случаи в порядке добавления
+    std::vector<MicroBenchmarkResult> Run(uint32_t sampleCount = 15, double sampleMilliseconds = 5.0) const;
+
+private:
+    struct Case {
+        std::string name;
+        MicroBenchmarkFunction function;
+    };
+    std::vector<Case> m_cases;
+};
+
+// Случаи модулей lab6 без устройства: глубина в пространстве вида, матрица нормалей,
+// разбор mip-уровней DDS, сортировка полупрозрачных квадратов
+void AddCoreMicroBenchmarks(MicroBenchmarkSuite& suite);
+
+// {"schema": 1, "benchmarks": [{"name": ..., "iterations": ..., "samples": ..., "median_ns": ..., "min_ns": ..., "max_ns": ...}, ...]}
+std::string BuildMicroBenchmarkJson(const std::vector<MicroBenchmarkResult>& results);
+// Читает файлы BuildMicroBenchmarkJson; поля ищутся по именам, порядок и пробелы не важны
+bool ParseMicroBenchmarkJson(const std::string& json, std::vector<MicroBenchmarkResult>& results);
+
+struct MicroBenchmarkComparison {
+    std::string name;
+    double baselineNanoseconds = 0;  // 0 - случая нет в базе
+    double currentNanoseconds = 0;   // 0 - случай есть только в базе
+    double ratio = 0;                // текущее / база
+    bool regression = false;
+};
+
+// По случаям текущего запуска, затем исчезнувшие из базы. Регрессия - медиана выросла больше
+// чем в 1 + tolerance раз
+std::vector<MicroBenchmarkComparison> CompareMicroBenchmarks(const std::vector<MicroBenchmarkResult>& baseline,
+    const std::vector<MicroBenchmarkResult>& current, double tolerance);
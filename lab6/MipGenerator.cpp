@@ -0,0 +1,460 @@
+﻿#include "MipGenerator.h"
+#include "BlockCompression.h"
+#include "ThreadPool.h"
+
+#include <cmath>
+#include <cstring>
+
+#if defined(_M_X64) || defined(__x86_64__) || defined(__SSE2__) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define MIP_HAS_SSE2 1
+#include <emmintrin.h>
+#else
+#define MIP_HAS_SSE2 0
+#endif
+
+namespace {
+
+const uint32_t kRowGrain = 8;
+
+void ParallelRows(ThreadPool* pThreadPool, uint32_t count, const std::function<void(uint32_t begin, uint32_t end)>& fn) {
+    if (pThreadPool) {
+        pThreadPool->ParallelFor(count, kRowGrain, fn);
+    }
+    else {
+        fn(0, count);
+    }
+}
+
+// ---------------------------------------------------------------------------------------------
+// Пиксель RGBA в float: один регистр SSE, без SSE - массив из 4 float
+
+#if MIP_HAS_SSE2
+struct Pixel4 {
+    __m128 v;
+};
+
+inline Pixel4 PixelZero() {
+    return Pixel4{ _mm_setzero_ps() };
+}
+
+inline Pixel4 PixelMulAdd(Pixel4 acc, Pixel4 value, float weight) {
+    return Pixel4{ _mm_add_ps(acc.v, _mm_mul_ps(value.v, _mm_set1_ps(weight))) };
+}
+
+inline Pixel4 PixelFromUnorm(uint32_t pixel) {
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i words = _mm_unpacklo_epi8(_mm_cvtsi32_si128(static_cast<int>(pixel)), zero);
+    return Pixel4{ _mm_mul_ps(_mm_cvtepi32_ps(_mm_unpacklo_epi16(words, zero)), _mm_set1_ps(1.0f / 255.0f)) };
+}
+
+inline Pixel4 PixelSet(float r, float g, float b, float a) {
+    return Pixel4{ _mm_setr_ps(r, g, b, a) };
+}
+
+inline uint32_t PixelToUnorm(Pixel4 value) {
+    const __m128 clamped = _mm_min_ps(_mm_max_ps(value.v, _mm_setzero_ps()), _mm_set1_ps(1.0f));
+    const __m128i ints = _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(clamped, _mm_set1_ps(255.0f)), _mm_set1_ps(0.5f)));
+    const __m128i words = _mm_packs_epi32(ints, ints);
+    return static_cast<uint32_t>(_mm_cvtsi128_si32(_mm_packus_epi16(words, words)));
+}
+
+inline void PixelStore(Pixel4 value, float out[4]) {
+    _mm_storeu_ps(out, value.v);
+}
+#else
+struct Pixel4 {
+    float v[4];
+};
+
+inline Pixel4 PixelZero() {
+    return Pixel4{ { 0.0f, 0.0f, 0.0f, 0.0f } };
+}
+
+inline Pixel4 PixelMulAdd(Pixel4 acc, Pixel4 value, float weight) {
+    for (int c = 0; c < 4; c++) {
+        acc.v[c] += value.v[c] * weight;
+    }
+    return acc;
+}
+
+inline Pixel4 PixelFromUnorm(uint32_t pixel) {
+    Pixel4 result;
+    for (int c = 0; c < 4; c++) {
+        result.v[c] = static_cast<float>((pixel >> (8 * c)) & 255) * (1.0f / 255.0f);
+    }
+    return result;
+}
+
+inline Pixel4 PixelSet(float r, float g, float b, float a) {
+    return Pixel4{ { r, g, b, a } };
+}
+
+inline uint32_t PixelToUnorm(Pixel4 value) {
+    uint32_t result = 0;
+    for (int c = 0; c < 4; c++) {
+        float v = value.v[c] < 0.0f ? 0.0f : (value.v[c] > 1.0f ? 1.0f : value.v[c]);
+        result |= static_cast<uint32_t>(v * 255.0f + 0.5f) << (8 * c);
+    }
+    return result;
+}
+
+inline void PixelStore(Pixel4 value, float out[4]) {
+    memcpy(out, value.v, sizeof(value.v));
+}
+#endif
+
+// ---------------------------------------------------------------------------------------------
+// Гамма sRGB через таблицы: 256 значений в линейное пространство, 4096 ступеней обратно
+
+struct SrgbTables {
+    float toLinear[256];
+    uint8_t fromLinear[4097];
+};
+
+const SrgbTables& GetSrgbTables() {
+    static const SrgbTables tables = [] {
+        SrgbTables result;
+        for (int i = 0; i < 256; i++) {
+            const double v = i / 255.0;
+            result.toLinear[i] = static_cast<float>(v <= 0.04045 ? v / 12.92 : std::pow((v + 0.055) / 1.055, 2.4));
+        }
+        for (int i = 0; i <= 4096; i++) {
+            const double v = i / 4096.0;
+            const double s = v <= 0.0031308 ? v * 12.92 : 1.055 * std::pow(v, 1.0 / 2.4) - 0.055;
+            result.fromLinear[i] = static_cast<uint8_t>(s * 255.0 + 0.5);
+        }
+        return result;
+    }();
+    return tables;
+}
+
+inline Pixel4 PixelFromSrgb(uint32_t pixel, const SrgbTables& tables) {
+    return PixelSet(tables.toLinear[pixel & 255], tables.toLinear[(pixel >> 8) & 255], tables.toLinear[(pixel >> 16) & 255],
+        static_cast<float>(pixel >> 24) * (1.0f / 255.0f));
+}
+
+inline uint32_t PixelToSrgb(Pixel4 value, const SrgbTables& tables) {
+    float v[4];
+    PixelStore(value, v);
+    uint32_t result = 0;
+    for (int c = 0; c < 3; c++) {
+        const float clamped = v[c] < 0.0f ? 0.0f : (v[c] > 1.0f ? 1.0f : v[c]);
+        result |= static_cast<uint32_t>(tables.fromLinear[static_cast<int>(clamped * 4096.0f + 0.5f)]) << (8 * c);
+    }
+    const float alpha = v[3] < 0.0f ? 0.0f : (v[3] > 1.0f ? 1.0f : v[3]);
+    return result | (static_cast<uint32_t>(alpha * 255.0f + 0.5f) << 24);
+}
+
+// ---------------------------------------------------------------------------------------------
+// Фильтры. Уменьшение ровно вдвое, поэтому веса одинаковы для всех пикселей: отсчеты
+// исходного изображения в точках 2x + offset.
+
+struct FilterKernel {
+    int firstOffset;
+    uint32_t tapCount;
+    float weights[6];
+};
+
+double BesselI0(double x) {
+    double sum = 1.0;
+    double term = 1.0;
+    for (int k = 1; k < 32; k++) {
+        term *= (x / (2.0 * k)) * (x / (2.0 * k));
+        sum += term;
+        if (term < sum * 1e-12) {
+            break;
+        }
+    }
+    return sum;
+}
+
+FilterKernel BuildKernel(MipFilter filter) {
+    FilterKernel kernel = {};
+    if (filter == MipFilter::Box) {
+        kernel.firstOffset = 0;
+        kernel.tapCount = 2;
+        kernel.weights[0] = kernel.weights[1] = 0.5f;
+        return kernel;
+    }
+
+    // sinc(d / 2) * окно Кайзера радиуса 3 исходных пикселя, beta = 4
+    const double pi = 3.14159265358979323846;
+    const double beta = 4.0;
+    const double radius = 3.0;
+    kernel.firstOffset = -2;
+    kernel.tapCount = 6;
+    double sum = 0.0;
+    double weights[6];
+    for (uint32_t i = 0; i < 6; i++) {
+        const double d = (kernel.firstOffset + static_cast<int>(i)) - 0.5; // расстояние до центра 2x + 0.5
+        const double t = d / 2.0;
+        const double sinc = std::sin(pi * t) / (pi * t);
+        const double r = d / radius;
+        const double window = BesselI0(beta * std::sqrt(1.0 - r * r)) / BesselI0(beta);
+        weights[i] = sinc * window;
+        sum += weights[i];
+    }
+    for (uint32_t i = 0; i < 6; i++) {
+        kernel.weights[i] = static_cast<float>(weights[i] / sum);
+    }
+    return kernel;
+}
+
+inline uint32_t ClampIndex(int value, uint32_t size) {
+    return value < 0 ? 0 : (static_cast<uint32_t>(value) >= size ? size - 1 : static_cast<uint32_t>(value));
+}
+
+// Быстрый путь: box без гамма-коррекции, целочисленное среднее 2x2 с округлением
+void DownsampleBoxUnorm(const uint32_t* pSrc, uint32_t srcWidth, uint32_t srcHeight, uint32_t* pDst,
+    uint32_t dstWidth, uint32_t dstHeight, ThreadPool* pThreadPool) {
+    ParallelRows(pThreadPool, dstHeight, [=](uint32_t begin, uint32_t end) {
+        for (uint32_t y = begin; y < end; y++) {
+            const uint32_t* pRow0 = pSrc + static_cast<size_t>(ClampIndex(2 * y, srcHeight)) * srcWidth;
+            const uint32_t* pRow1 = pSrc + static_cast<size_t>(ClampIndex(2 * y + 1, srcHeight)) * srcWidth;
+            uint32_t* pOut = pDst + static_cast<size_t>(y) * dstWidth;
+            uint32_t x = 0;
+#if MIP_HAS_SSE2
+            // По два выходных пикселя: 4 исходных пикселя из каждой строки
+            const __m128i zero = _mm_setzero_si128();
+            const __m128i round = _mm_set1_epi16(2);
+            for (; 2 * x + 3 < srcWidth && x + 1 < dstWidth; x += 2) {
+                const __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pRow0 + 2 * x));
+                const __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pRow1 + 2 * x));
+                const __m128i left = _mm_add_epi16(_mm_unpacklo_epi8(a, zero), _mm_unpacklo_epi8(b, zero));
+                const __m128i right = _mm_add_epi16(_mm_unpackhi_epi8(a, zero), _mm_unpackhi_epi8(b, zero));
+                const __m128i sum0 = _mm_add_epi16(left, _mm_srli_si128(left, 8));
+                const __m128i sum1 = _mm_add_epi16(right, _mm_srli_si128(right, 8));
+                const __m128i average = _mm_srli_epi16(_mm_add_epi16(_mm_unpacklo_epi64(sum0, sum1), round), 2);
+                _mm_storel_epi64(reinterpret_cast<__m128i*>(pOut + x), _mm_packus_epi16(average, average));
+            }
+#endif
+            for (; x < dstWidth; x++) {
+                const uint32_t x0 = ClampIndex(2 * x, srcWidth);
+                const uint32_t x1 = ClampIndex(2 * x + 1, srcWidth);
+                uint32_t result = 0;
+                for (uint32_t c = 0; c < 32; c += 8) {
+                    const uint32_t sum = ((pRow0[x0] >> c) & 255) + ((pRow0[x1] >> c) & 255) +
+                        ((pRow1[x0] >> c) & 255) + ((pRow1[x1] >> c) & 255);
+                    result |= ((sum + 2) >> 2) << c;
+                }
+                pOut[x] = result;
+            }
+        }
+    });
+}
+
+// Общий путь: раздельный фильтр в float, сначала по строкам, затем по столбцам
+void DownsampleSeparable(const uint32_t* pSrc, uint32_t srcWidth, uint32_t srcHeight, uint32_t* pDst,
+    uint32_t dstWidth, uint32_t dstHeight, const FilterKernel& kernel, bool gammaCorrect, ThreadPool* pThreadPool) {
+    const SrgbTables& tables = GetSrgbTables();
+    std::vector<Pixel4> horizontal(static_cast<size_t>(srcHeight) * dstWidth);
+
+    ParallelRows(pThreadPool, srcHeight, [&](uint32_t begin, uint32_t end) {
+        std::vector<Pixel4> row(srcWidth);
+        for (uint32_t y = begin; y < end; y++) {
+            const uint32_t* pRow = pSrc + static_cast<size_t>(y) * srcWidth;
+            for (uint32_t x = 0; x < srcWidth; x++) {
+                row[x] = gammaCorrect ? PixelFromSrgb(pRow[x], tables) : PixelFromUnorm(pRow[x]);
+            }
+            Pixel4* pOut = horizontal.data() + static_cast<size_t>(y) * dstWidth;
+            for (uint32_t x = 0; x < dstWidth; x++) {
+                Pixel4 sum = PixelZero();
+                for (uint32_t k = 0; k < kernel.tapCount; k++) {
+                    sum = PixelMulAdd(sum, row[ClampIndex(static_cast<int>(2 * x) + kernel.firstOffset + static_cast<int>(k), srcWidth)], kernel.weights[k]);
+                }
+                pOut[x] = sum;
+            }
+        }
+    });
+
+    ParallelRows(pThreadPool, dstHeight, [&](uint32_t begin, uint32_t end) {
+        for (uint32_t y = begin; y < end; y++) {
+            const Pixel4* rows[6];
+            for (uint32_t k = 0; k < kernel.tapCount; k++) {
+                rows[k] = horizontal.data() + static_cast<size_t>(ClampIndex(static_cast<int>(2 * y) + kernel.firstOffset + static_cast<int>(k), srcHeight)) * dstWidth;
+            }
+            uint32_t* pOut = pDst + static_cast<size_t>(y) * dstWidth;
+            for (uint32_t x = 0; x < dstWidth; x++) {
+                Pixel4 sum = PixelZero();
+                for (uint32_t k = 0; k < kernel.tapCount; k++) {
+                    sum = PixelMulAdd(sum, rows[k][x], kernel.weights[k]);
+                }
+                pOut[x] = gammaCorrect ? PixelToSrgb(sum, tables) : PixelToUnorm(sum);
+            }
+        }
+    });
+}
+
+// Распаковка верхнего уровня в RGBA8
+bool DecodeTopLevel(uint32_t format, const DdsSubresource& sub, std::vector<uint32_t>& pixels, ThreadPool* pThreadPool) {
+    pixels.resize(static_cast<size_t>(sub.width) * sub.height);
+    if (IsBcFormatDecodable(format)) {
+        // Полосами по строке блоков
+        bool success = true;
+        ParallelRows(pThreadPool, sub.rowCount, [&](uint32_t begin, uint32_t end) {
+            const uint32_t y = begin * 4;
+            const uint32_t height = (end * 4 < sub.height ? end * 4 : sub.height) - y;
+            if (!DecodeBcImage(format, sub.pData + static_cast<size_t>(begin) * sub.rowPitch, sub.rowPitch, sub.width, height,
+                pixels.data() + static_cast<size_t>(y) * sub.width, sub.width)) {
+                success = false;
+            }
+        });
+        return success;
+    }
+
+    const bool bgra = format == DdsFormat::B8G8R8A8_UNORM || format == DdsFormat::B8G8R8X8_UNORM;
+    if (!bgra && format != DdsFormat::R8G8B8A8_UNORM && format != DdsFormat::R8G8B8A8_UNORM_SRGB) {
+        return false;
+    }
+    for (uint32_t y = 0; y < sub.height; y++) {
+        uint32_t* pOut = pixels.data() + static_cast<size_t>(y) * sub.width;
+        memcpy(pOut, sub.pData + static_cast<size_t>(y) * sub.rowPitch, sub.width * sizeof(uint32_t));
+        if (bgra) {
+            for (uint32_t x = 0; x < sub.width; x++) {
+                const uint32_t p = pOut[x];
+                const uint32_t alpha = format == DdsFormat::B8G8R8X8_UNORM ? 0xFF000000 : (p & 0xFF000000);
+                pOut[x] = ((p >> 16) & 0xFF) | (p & 0x0000FF00) | ((p & 0xFF) << 16) | alpha;
+            }
+        }
+    }
+    return true;
+}
+
+} // namespace
+
+uint32_t GetFullMipCount(uint32_t width, uint32_t height) {
+    uint32_t count = 1;
+    for (uint32_t size = width > height ? width : height; size > 1; size >>= 1) {
+        count++;
+    }
+    return count;
+}
+
+bool IsSrgbFormat(uint32_t dxgiFormat) {
+    switch (dxgiFormat) {
+    case DdsFormat::R8G8B8A8_UNORM_SRGB:
+    case DdsFormat::BC1_UNORM_SRGB:
+    case DdsFormat::BC2_UNORM_SRGB:
+    case DdsFormat::BC3_UNORM_SRGB:
+    case DdsFormat::BC7_UNORM_SRGB:
+        return true;
+    default:
+        return false;
+    }
+}
+
+void DownsampleRgba8(const uint32_t* pSrc, uint32_t srcWidth, uint32_t srcHeight, uint32_t* pDst,
+    MipFilter filter, bool gammaCorrect, ThreadPool* pThreadPool) {
+    const uint32_t dstWidth = srcWidth > 1 ? srcWidth / 2 : 1;
+    const uint32_t dstHeight = srcHeight > 1 ? srcHeight / 2 : 1;
+    if (filter == MipFilter::Box && !gammaCorrect) {
+        DownsampleBoxUnorm(pSrc, srcWidth, srcHeight, pDst, dstWidth, dstHeight, pThreadPool);
+        return;
+    }
+    static const FilterKernel boxKernel = BuildKernel(MipFilter::Box);
+    static const FilterKernel kaiserKernel = BuildKernel(MipFilter::Kaiser);
+    DownsampleSeparable(pSrc, srcWidth, srcHeight, pDst, dstWidth, dstHeight,
+        filter == MipFilter::Box ? boxKernel : kaiserKernel, gammaCorrect, pThreadPool);
+}
+
+void MipChain::Clear() {
+    m_format = 0;
+    m_storage.clear();
+    m_levels.clear();
+}
+
+DdsSubresource& MipChain::AddLevel(uint32_t width, uint32_t height) {
+    DdsSubresource level;
+    level.width = width;
+    level.height = height;
+    if (IsBcFormatEncodable(m_format)) {
+        level.rowPitch = ((width + 3) / 4) * DdsFile::GetBytesPerBlock(m_format);
+        level.rowCount = (height + 3) / 4;
+    }
+    else {
+        level.rowPitch = width * 4;
+        level.rowCount = height;
+    }
+    level.size = static_cast<size_t>(level.rowPitch) * level.rowCount;
+    m_storage.emplace_back(level.size);
+    level.pData = m_storage.back().data();
+    m_levels.push_back(level);
+    return m_levels.back();
+}
+
+bool MipChain::Generate(const DdsFile& file, uint32_t item, const MipGenerationOptions& options, ThreadPool* pThreadPool) {
+    Clear();
+    if (!file.IsOpen() || item >= file.GetArraySize()) {
+        return false;
+    }
+
+    const uint32_t format = file.GetFormat();
+    const DdsSubresource& top = file.GetSubresource(0, item);
+    std::vector<uint32_t> pixels;
+    if (!DecodeTopLevel(format, top, pixels, pThreadPool)) {
+        return false;
+    }
+
+    uint32_t outFormat = IsSrgbFormat(format) ? DdsFormat::R8G8B8A8_UNORM_SRGB : DdsFormat::R8G8B8A8_UNORM;
+    if (options.reencode && IsBcFormatEncodable(format)) {
+        outFormat = format;
+    }
+    // Верхний уровень в исходном формате копируется как есть, без повторного сжатия
+    return Build(pixels.data(), top.width, top.height, outFormat, outFormat == format ? &top : nullptr, options, pThreadPool);
+}
+
+bool MipChain::Generate(const uint32_t* pPixels, uint32_t width, uint32_t height, uint32_t format,
+    const MipGenerationOptions& options, ThreadPool* pThreadPool) {
+    Clear();
+    return Build(pPixels, width, height, format, nullptr, options, pThreadPool);
+}
+
+bool MipChain::Build(const uint32_t* pPixels, uint32_t width, uint32_t height, uint32_t format, const DdsSubresource* pTopLevel,
+    const MipGenerationOptions& options, ThreadPool* pThreadPool) {
+    const bool encode = IsBcFormatEncodable(format);
+    if (width == 0 || height == 0 || (!encode && format != DdsFormat::R8G8B8A8_UNORM && format != DdsFormat::R8G8B8A8_UNORM_SRGB)) {
+        return false;
+    }
+    m_format = format;
+
+    const uint32_t mipCount = GetFullMipCount(width, height);
+    m_storage.reserve(mipCount);
+    m_levels.reserve(mipCount);
+
+    std::vector<uint32_t> current(pPixels, pPixels + static_cast<size_t>(width) * height);
+    std::vector<uint32_t> next;
+    for (uint32_t mip = 0; mip < mipCount; mip++) {
+        if (mip > 0) {
+            const uint32_t nextWidth = width > 1 ? width / 2 : 1;
+            const uint32_t nextHeight = height > 1 ? height / 2 : 1;
+            next.resize(static_cast<size_t>(nextWidth) * nextHeight);
+            DownsampleRgba8(current.data(), width, height, next.data(), options.filter, options.gammaCorrect, pThreadPool);
+            current.swap(next);
+            width = nextWidth;
+            height = nextHeight;
+        }
+
+        DdsSubresource& level = AddLevel(width, height);
+        uint8_t* pOut = const_cast<uint8_t*>(level.pData);
+        if (mip == 0 && pTopLevel && pTopLevel->size == level.size && pTopLevel->rowPitch == level.rowPitch) {
+            memcpy(pOut, pTopLevel->pData, level.size);
+        }
+        else if (encode) {
+            // Полосами по строке блоков
+            const uint32_t levelWidth = width;
+            const uint32_t levelHeight = height;
+            const size_t rowPitch = level.rowPitch;
+            const uint32_t* pLevelPixels = current.data();
+            ParallelRows(pThreadPool, level.rowCount, [=](uint32_t begin, uint32_t end) {
+                const uint32_t y = begin * 4;
+                const uint32_t bandHeight = (end * 4 < levelHeight ? end * 4 : levelHeight) - y;
+                EncodeBcImage(format, pLevelPixels + static_cast<size_t>(y) * levelWidth, levelWidth, levelWidth, bandHeight,
+                    pOut + begin * rowPitch, rowPitch);
+            });
+        }
+        else {
+            memcpy(pOut, current.data(), level.size);
+        }
+    }
+    return true;
+}
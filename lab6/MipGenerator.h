@@ -0,0 +1,63 @@
+﻿#pragma once
+
+#include <cstdint>
+#include <vector>
+#include "DdsFile.h"
+
+class ThreadPool;
+
+// Достраивание mip-цепочки для текстур, в файле которых уровней меньше полной цепочки:
+// верхний уровень распаковывается в RGBA8, каждый следующий уровень уменьшается из
+// предыдущего выбранным фильтром и сжимается обратно в исходный BC-формат. Если кодера
+// для формата нет (BC7), уровни остаются в RGBA8. Строки уровней и полосы блоков
+// обрабатываются параллельно на ThreadPool.
+
+enum class MipFilter {
+    Box,    // среднее 2x2
+    Kaiser, // sinc с окном Кайзера (6 отсчетов): резче box, без заметного звона
+};
+
+struct MipGenerationOptions {
+    MipFilter filter = MipFilter::Box;
+    bool gammaCorrect = false; // фильтровать в линейном пространстве (для sRGB-текстур); альфа всегда линейна
+    bool reencode = true;      // сжать уровни обратно в исходный BC-формат
+};
+
+// 1 + floor(log2(max(width, height)))
+uint32_t GetFullMipCount(uint32_t width, uint32_t height);
+bool IsSrgbFormat(uint32_t dxgiFormat);
+
+// Уменьшение RGBA8-изображения вдвое, результат max(1, w / 2) x max(1, h / 2). Край повторяется.
+void DownsampleRgba8(const uint32_t* pSrc, uint32_t srcWidth, uint32_t srcHeight, uint32_t* pDst,
+    MipFilter filter, bool gammaCorrect, ThreadPool* pThreadPool);
+
+class MipChain {
+public:
+    MipChain() = default;
+    MipChain(const MipChain&) = delete;
+    MipChain& operator=(const MipChain&) = delete;
+    MipChain(MipChain&&) = default;
+    MipChain& operator=(MipChain&&) = default;
+
+    // Полная цепочка из верхнего уровня элемента item (грани куба) DDS-файла
+    bool Generate(const DdsFile& file, uint32_t item, const MipGenerationOptions& options, ThreadPool* pThreadPool);
+    // Полная цепочка из RGBA8-изображения; format - BC-формат для сжатия или R8G8B8A8
+    bool Generate(const uint32_t* pPixels, uint32_t width, uint32_t height, uint32_t format,
+        const MipGenerationOptions& options, ThreadPool* pThreadPool);
+    void Clear();
+
+    bool IsEmpty() const { return m_levels.empty(); }
+    // Значение DXGI_FORMAT уровней
+    uint32_t GetFormat() const { return m_format; }
+    uint32_t GetMipLevels() const { return static_cast<uint32_t>(m_levels.size()); }
+    const DdsSubresource& GetSubresource(uint32_t mip) const { return m_levels[mip]; }
+
+private:
+    bool Build(const uint32_t* pPixels, uint32_t width, uint32_t height, uint32_t format, const DdsSubresource* pTopLevel,
+        const MipGenerationOptions& options, ThreadPool* pThreadPool);
+    DdsSubresource& AddLevel(uint32_t width, uint32_t height);
+
+    uint32_t m_format = 0;
+    std::vector<std::vector<uint8_t>> m_storage;
+    std::vector<DdsSubresource> m_levels;
+};
@@ -0,0 +1,264 @@
+﻿#include "OitReference.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <random>
+
+namespace {
+
+inline float GetQuadDepth(const OitQuad& quad, float x, float y) {
+    return quad.depth + quad.depthDx * (x - 0.5f * (quad.x0 + quad.x1)) + quad.depthDy * (y - 0.5f * (quad.y0 + quad.y1));
+}
+
+// Смешивание поверх: цвет ближнего фрагмента закрывает долю a того, что за ним
+inline void BlendOver(DirectX::XMFLOAT3& pixel, const DirectX::XMFLOAT4& color) {
+    pixel.x += (color.x - pixel.x) * color.w;
+    pixel.y += (color.y - pixel.y) * color.w;
+    pixel.z += (color.z - pixel.z) * color.w;
+}
+
+} // namespace
+
+const char* GetOitMethodName(OitMethod method) {
+    switch (method) {
+    case OitMethod::Exact: return "exact";
+    case OitMethod::SortedByCenter: return "sorted";
+    case OitMethod::WeightedBlended: return "weighted";
+    }
+    return "unknown";
+}
+
+float ComputeOitWeight(float viewDepth, float alpha) {
+    const float z = std::fabs(viewDepth);
+    const float near2 = (z / 5.0f) * (z / 5.0f);
+    const float far2 = (z / 200.0f) * (z / 200.0f);
+    const float weight = 10.0f / (1e-5f + near2 + far2 * far2 * far2);
+    return alpha * std::min(std::max(weight, 1e-2f), 3e3f);
+}
+
+void OitReferenceRenderer::Resize(uint32_t width, uint32_t height) {
+    m_width = width;
+    m_height = height;
+    m_image.resize(size_t(width) * height);
+    m_accum.resize(size_t(width) * height);
+    m_revealage.resize(size_t(width) * height);
+    m_fragmentOffsets.resize(size_t(width) * height + 1);
+}
+
+bool OitReferenceRenderer::GetPixelRect(const OitQuad& quad, uint32_t& x0, uint32_t& y0, uint32_t& x1, uint32_t& y1) const {
+    // Пиксель покрыт, если его центр (x + 0.5, y + 0.5) внутри прямоугольника
+    const float left = std::max(std::ceil(quad.x0 - 0.5f), 0.0f);
+    const float top = std::max(std::ceil(quad.y0 - 0.5f), 0.0f);
+    const float right = std::min(std::ceil(quad.x1 - 0.5f), static_cast<float>(m_width));
+    const float bottom = std::min(std::ceil(quad.y1 - 0.5f), static_cast<float>(m_height));
+    if (!(left < right) || !(top < bottom)) {
+        return false;
+    }
+    x0 = static_cast<uint32_t>(left);
+    y0 = static_cast<uint32_t>(top);
+    x1 = static_cast<uint32_t>(right);
+    y1 = static_cast<uint32_t>(bottom);
+    return true;
+}
+
+void OitReferenceRenderer::Render(const OitQuad* pQuads, uint32_t quadCount, const DirectX::XMFLOAT3& background, OitMethod method) {
+    std::fill(m_image.begin(), m_image.end(), background);
+    switch (method) {
+    case OitMethod::Exact:
+        RenderExact(pQuads, quadCount);
+        break;
+    case OitMethod::SortedByCenter:
+        RenderSorted(pQuads, quadCount);
+        break;
+    case OitMethod::WeightedBlended:
+        RenderWeighted(pQuads, quadCount);
+        break;
+    }
+}
+
+void OitReferenceRenderer::RenderExact(const OitQuad* pQuads, uint32_t quadCount) {
+    // Списки фрагментов пикселей в одном массиве: сначала число фрагментов каждого пикселя,
+    // затем смещения списков, затем сами фрагменты
+    std::fill(m_fragmentOffsets.begin(), m_fragmentOffsets.end(), 0u);
+    for (uint32_t q = 0; q < quadCount; q++) {
+        uint32_t x0, y0, x1, y1;
+        if (!GetPixelRect(pQuads[q], x0, y0, x1, y1)) {
+            continue;
+        }
+        for (uint32_t y = y0; y < y1; y++) {
+            for (uint32_t x = x0; x < x1; x++) {
+                m_fragmentOffsets[size_t(y) * m_width + x + 1]++;
+            }
+        }
+    }
+    for (size_t i = 1; i < m_fragmentOffsets.size(); i++) {
+        m_fragmentOffsets[i] += m_fragmentOffsets[i - 1];
+    }
+    m_fragments.resize(m_fragmentOffsets.back());
+
+    std::vector<uint32_t> fill(m_fragmentOffsets.begin(), m_fragmentOffsets.end() - 1);
+    for (uint32_t q = 0; q < quadCount; q++) {
+        uint32_t x0, y0, x1, y1;
+        if (!GetPixelRect(pQuads[q], x0, y0, x1, y1)) {
+            continue;
+        }
+        for (uint32_t y = y0; y < y1; y++) {
+            for (uint32_t x = x0; x < x1; x++) {
+                m_fragments[fill[size_t(y) * m_width + x]++] = Fragment{ GetQuadDepth(pQuads[q], x + 0.5f, y + 0.5f), q };
+            }
+        }
+    }
+
+    // Каждый пиксель - от дальнего фрагмента к ближнему; при равной глубине раньше рисуется
+    // прямоугольник с меньшим номером
+    for (size_t pixel = 0; pixel < m_image.size(); pixel++) {
+        Fragment* pBegin = m_fragments.data() + m_fragmentOffsets[pixel];
+        Fragment* pEnd = m_fragments.data() + m_fragmentOffsets[pixel + 1];
+        std::sort(pBegin, pEnd, [](const Fragment& a, const Fragment& b) {
+            return a.depth > b.depth || (a.depth == b.depth && a.quad < b.quad);
+        });
+        for (const Fragment* pFragment = pBegin; pFragment != pEnd; pFragment++) {
+            BlendOver(m_image[pixel], pQuads[pFragment->quad].color);
+        }
+    }
+}
+
+void OitReferenceRenderer::RenderSorted(const OitQuad* pQuads, uint32_t quadCount) {
+    m_queue.Resize(quadCount);
+    for (uint32_t q = 0; q < quadCount; q++) {
+        m_queue.SetDepth(q, pQuads[q].depth);
+    }
+    const uint32_t* pOrder = m_queue.Sort();
+    for (uint32_t i = 0; i < quadCount; i++) {
+        const OitQuad& quad = pQuads[pOrder[i]];
+        uint32_t x0, y0, x1, y1;
+        if (!GetPixelRect(quad, x0, y0, x1, y1)) {
+            continue;
+        }
+        for (uint32_t y = y0; y < y1; y++) {
+            DirectX::XMFLOAT3* pRow = m_image.data() + size_t(y) * m_width;
+            for (uint32_t x = x0; x < x1; x++) {
+                BlendOver(pRow[x], quad.color);
+            }
+        }
+    }
+}
+
+void OitReferenceRenderer::RenderWeighted(const OitQuad* pQuads, uint32_t quadCount) {
+    // Первый проход, как в двух целях psOit: порядок прямоугольников не важен
+    std::fill(m_accum.begin(), m_accum.end(), DirectX::XMFLOAT4(0.0f, 0.0f, 0.0f, 0.0f));
+    std::fill(m_revealage.begin(), m_revealage.end(), 1.0f);
+    for (uint32_t q = 0; q < quadCount; q++) {
+        const OitQuad& quad = pQuads[q];
+        uint32_t x0, y0, x1, y1;
+        if (!GetPixelRect(quad, x0, y0, x1, y1)) {
+            continue;
+        }
+        for (uint32_t y = y0; y < y1; y++) {
+            const size_t row = size_t(y) * m_width;
+            for (uint32_t x = x0; x < x1; x++) {
+                const float weight = ComputeOitWeight(GetQuadDepth(quad, x + 0.5f, y + 0.5f), quad.color.w);
+                DirectX::XMFLOAT4& accum = m_accum[row + x];
+                accum.x += quad.color.x * weight;
+                accum.y += quad.color.y * weight;
+                accum.z += quad.color.z * weight;
+                accum.w += weight;
+                m_revealage[row + x] *= 1.0f - quad.color.w;
+            }
+        }
+    }
+
+    // Второй проход, как в psOitComposite: средний цвет с весами поверх фона с непрозрачностью 1 - revealage
+    for (size_t pixel = 0; pixel < m_image.size(); pixel++) {
+        const DirectX::XMFLOAT4& accum = m_accum[pixel];
+        const float coverage = 1.0f - m_revealage[pixel];
+        if (coverage <= 0.0f) {
+            continue;
+        }
+        const float inverseWeight = 1.0f / std::max(accum.w, 1e-5f);
+        BlendOver(m_image[pixel], DirectX::XMFLOAT4(accum.x * inverseWeight, accum.y * inverseWeight, accum.z * inverseWeight, coverage));
+    }
+}
+
+namespace {
+
+std::vector<OitBenchmarkResult> RunOitScene(uint32_t quadCount, uint32_t width, uint32_t height, uint32_t frameCount, float tilt, uint32_t seed) {
+    std::mt19937 random(seed);
+    std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+    std::vector<OitQuad> quads(quadCount);
+    for (OitQuad& quad : quads) {
+        const float sizeX = 4.0f + 36.0f * unit(random);
+        const float sizeY = 4.0f + 36.0f * unit(random);
+        quad.x0 = (width + sizeX) * unit(random) - sizeX;
+        quad.y0 = (height + sizeY) * unit(random) - sizeY;
+        quad.x1 = quad.x0 + sizeX;
+        quad.y1 = quad.y0 + sizeY;
+        quad.depth = 2.0f + 18.0f * unit(random);
+        quad.depthDx = (unit(random) - 0.5f) * tilt;
+        quad.depthDy = (unit(random) - 0.5f) * tilt;
+        quad.color = DirectX::XMFLOAT4(unit(random), unit(random), unit(random), 0.1f + 0.4f * unit(random));
+    }
+    const DirectX::XMFLOAT3 background(0.3f, 0.3f, 0.3f);
+
+    OitReferenceRenderer renderer;
+    renderer.Resize(width, height);
+    std::vector<DirectX::XMFLOAT3> exact;
+
+    const OitMethod methods[] = { OitMethod::Exact, OitMethod::SortedByCenter, OitMethod::WeightedBlended };
+    std::vector<OitBenchmarkResult> results;
+    for (OitMethod method : methods) {
+        // Первый кадр - прогрев и картинка для сравнения
+        renderer.Render(quads.data(), quadCount, background, method);
+        const auto startTime = std::chrono::steady_clock::now();
+        for (uint32_t frame = 0; frame < frameCount; frame++) {
+            renderer.Render(quads.data(), quadCount, background, method);
+        }
+        const double elapsed = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - startTime).count();
+
+        const DirectX::XMFLOAT3* pImage = renderer.GetImage();
+        const size_t pixelCount = size_t(width) * height;
+        if (method == OitMethod::Exact) {
+            exact.assign(pImage, pImage + pixelCount);
+        }
+
+        OitBenchmarkResult result;
+        result.method = method;
+        result.millisecondsPerFrame = frameCount > 0 ? elapsed / frameCount : 0.0;
+        double squaredSum = 0.0;
+        size_t badPixelCount = 0;
+        for (size_t pixel = 0; pixel < pixelCount; pixel++) {
+            const float errors[] = { std::fabs(pImage[pixel].x - exact[pixel].x), std::fabs(pImage[pixel].y - exact[pixel].y),
+                std::fabs(pImage[pixel].z - exact[pixel].z) };
+            float pixelError = 0.0f;
+            for (float error : errors) {
+                squaredSum += double(error) * error;
+                pixelError = std::max(pixelError, error);
+            }
+            result.maxError = std::max(result.maxError, double(pixelError));
+            badPixelCount += pixelError > 0.05f ? 1 : 0;
+        }
+        result.rmse = pixelCount > 0 ? std::sqrt(squaredSum / (3.0 * pixelCount)) : 0.0;
+        result.badPixelShare = pixelCount > 0 ? double(badPixelCount) / pixelCount : 0.0;
+        results.push_back(result);
+    }
+    return results;
+}
+
+} // namespace
+
+std::vector<OitBenchmarkResult> RunOitBenchmark(uint32_t quadCount, uint32_t width, uint32_t height, uint32_t frameCount, uint32_t seed) {
+    std::vector<OitBenchmarkResult> results;
+    const char* sceneNames[] = { "flat", "intersecting" };
+    for (int scene = 0; scene < 2; scene++) {
+        // Прямоугольники от 4 до 40 пикселей; наклонные меняют глубину к краям на величину
+        // того же порядка, что и разброс глубин между соседями
+        const float tilt = scene == 0 ? 0.0f : 0.5f;
+        const std::vector<OitBenchmarkResult> sceneResults = RunOitScene(quadCount, width, height, frameCount, tilt, seed);
+        for (OitBenchmarkResult result : sceneResults) {
+            result.scene = sceneNames[scene];
+            results.push_back(result);
+        }
+    }
+    return results;
+}
@@ -0,0 +1,79 @@
+﻿#pragma once
+
+#include <cstdint>
+#include <vector>
+#include <DirectXMath.h>
+#include "TransparencyQueue.h"
+
+// Эталон полупрозрачности на CPU: те же прямоугольники смешиваются тремя способами, чтобы
+// сравнить стоимость и качество взвешенного смешивания без порядка (weighted blended OIT,
+// режим -oit) с сортировкой по центрам (как в Render) и с точным результатом.
+
+// Полупрозрачный прямоугольник на экране. Глубина меняется линейно:
+// depth(x, y) = depth + depthDx * (x - cx) + depthDy * (y - cy), где (cx, cy) - центр,
+// поэтому наклонные прямоугольники пересекаются, и порядок по центрам для них неверен.
+struct OitQuad {
+    float x0, y0, x1, y1; // пиксели с центрами в [x0, x1) x [y0, y1)
+    float depth;          // глубина центра в пространстве вида
+    float depthDx, depthDy;
+    DirectX::XMFLOAT4 color; // rgb и непрозрачность
+};
+
+enum class OitMethod {
+    Exact,           // фрагменты каждого пикселя сортируются по глубине
+    SortedByCenter,  // прямоугольники от дальнего к ближнему по глубине центра
+    WeightedBlended, // сумма цветов с весами по глубине и произведение прозрачностей, без порядка
+};
+
+const char* GetOitMethodName(OitMethod method);
+
+// Вес фрагмента во взвешенном смешивании (McGuire, Bavoil 2013, формула 9): ближние и плотные
+// фрагменты весят больше. Та же формула в psOit из pixelColorShaderCode.
+float ComputeOitWeight(float viewDepth, float alpha);
+
+class OitReferenceRenderer {
+public:
+    void Resize(uint32_t width, uint32_t height);
+    uint32_t GetWidth() const { return m_width; }
+    uint32_t GetHeight() const { return m_height; }
+
+    // Кадр: фон background, поверх него прямоугольники выбранным способом
+    void Render(const OitQuad* pQuads, uint32_t quadCount, const DirectX::XMFLOAT3& background, OitMethod method);
+    const DirectX::XMFLOAT3* GetImage() const { return m_image.data(); }
+
+private:
+    struct Fragment {
+        float depth;
+        uint32_t quad;
+    };
+
+    // Пиксели прямоугольника; false, если он вне экрана
+    bool GetPixelRect(const OitQuad& quad, uint32_t& x0, uint32_t& y0, uint32_t& x1, uint32_t& y1) const;
+
+    void RenderExact(const OitQuad* pQuads, uint32_t quadCount);
+    void RenderSorted(const OitQuad* pQuads, uint32_t quadCount);
+    void RenderWeighted(const OitQuad* pQuads, uint32_t quadCount);
+
+    uint32_t m_width = 0;
+    uint32_t m_height = 0;
+    std::vector<DirectX::XMFLOAT3> m_image;
+    std::vector<DirectX::XMFLOAT4> m_accum; // rgb * a * w и a * w
+    std::vector<float> m_revealage;         // произведение (1 - a)
+    std::vector<uint32_t> m_fragmentOffsets;
+    std::vector<Fragment> m_fragments;
+    TransparencyQueue m_queue;
+};
+
+struct OitBenchmarkResult {
+    const char* scene = "";
+    OitMethod method = OitMethod::Exact;
+    double millisecondsPerFrame = 0;
+    // Отличие от точного результата по каналам RGB
+    double rmse = 0;
+    double maxError = 0;
+    double badPixelShare = 0; // доля пикселей, где ошибка канала больше 0.05
+};
+
+// quadCount сильно перекрывающихся прямоугольников на экране width x height в двух сценах:
+// параллельные экрану (порядок по центрам точен) и наклонные, пересекающиеся друг с другом
+std::vector<OitBenchmarkResult> RunOitBenchmark(uint32_t quadCount, uint32_t width, uint32_t height, uint32_t frameCount, uint32_t seed = 1);
@@ -0,0 +1,680 @@
+﻿#include "PackedVertex.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <random>
+
+#if defined(_M_X64) || defined(__x86_64__) || defined(__SSE2__) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define PACKED_HAS_SSE2 1
+#include <emmintrin.h>
+#else
+#define PACKED_HAS_SSE2 0
+#endif
+
+namespace {
+
+// Обе версии делают одни и те же операции float в одном порядке (без сокращения в FMA)
+// и округляют к ближайшему четному, поэтому результаты совпадают побитно
+
+inline uint32_t FloatBits(float value) {
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    return bits;
+}
+
+inline float BitsFloat(uint32_t bits) {
+    float value;
+    memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+inline int32_t RoundToInt(float value) {
+    return static_cast<int32_t>(std::nearbyint(value));
+}
+
+// float -> half с округлением к ближайшему четному (F. Giesen, float_to_half_fast3_rtne):
+// денормализованные half получаются сложением с магической константой, у нормальных
+// округление прибавлением 0xFFF и младшего бита мантиссы
+const uint32_t kF16Max = (127 + 16) << 23;
+const uint32_t kF32Infinity = 255u << 23;
+const uint32_t kMinNormal = (127 - 14) << 23;
+const uint32_t kSubnormalMagic = ((127 - 15) + (23 - 10) + 1) << 23;
+const uint32_t kNormalBias = 0xFFFu - ((127 - 15) << 23);
+// half -> float: экспонента поправляется умножением на 2^112, это же нормализует денормализованные
+const uint32_t kHalfToFloatMagic = (254 - 15) << 23;
+
+uint16_t FloatToHalf(float value) {
+    uint32_t bits = FloatBits(value);
+    const uint32_t sign = bits & 0x80000000u;
+    bits ^= sign;
+    uint32_t half;
+    if (bits >= kF16Max) {
+        half = bits > kF32Infinity ? 0x7E00 : 0x7C00;
+    }
+    else if (bits < kMinNormal) {
+        half = FloatBits(BitsFloat(bits) + BitsFloat(kSubnormalMagic)) - kSubnormalMagic;
+    }
+    else {
+        half = (bits + kNormalBias + ((bits >> 13) & 1)) >> 13;
+    }
+    return static_cast<uint16_t>(half | (sign >> 16));
+}
+
+float HalfToFloat(uint16_t half) {
+    const uint32_t exponentMantissa = half & 0x7FFFu;
+    uint32_t bits = FloatBits(BitsFloat(exponentMantissa << 13) * BitsFloat(kHalfToFloatMagic));
+    if (exponentMantissa > 0x7BFFu) {
+        bits |= kF32Infinity;
+    }
+    return BitsFloat(bits | (static_cast<uint32_t>(half & 0x8000u) << 16));
+}
+
+// Октаэдрическая развертка: проекция на октаэдр |x| + |y| + |z| = 1, нижняя половина
+// отражается на углы квадрата. Нулевой вектор кодируется как (0, 0, 1)
+void EncodeOctahedral(float x, float y, float z, int8_t* pResult) {
+    float length = std::fabs(x) + std::fabs(y) + std::fabs(z);
+    length = length > 1e-30f ? length : 1e-30f;
+    float px = x / length;
+    float py = y / length;
+    if (z < 0.0f) {
+        const float fx = (1.0f - std::fabs(py)) * (px >= 0.0f ? 1.0f : -1.0f);
+        const float fy = (1.0f - std::fabs(px)) * (py >= 0.0f ? 1.0f : -1.0f);
+        px = fx;
+        py = fy;
+    }
+    pResult[0] = static_cast<int8_t>(RoundToInt(px * 127.0f));
+    pResult[1] = static_cast<int8_t>(RoundToInt(py * 127.0f));
+}
+
+inline float SnormToFloat(int8_t value) {
+    const float result = static_cast<float>(value) / 127.0f;
+    return result < -1.0f ? -1.0f : result;
+}
+
+void DecodeOctahedral(const int8_t* pEncoded, float* pResult) {
+    float x = SnormToFloat(pEncoded[0]);
+    float y = SnormToFloat(pEncoded[1]);
+    const float z = 1.0f - std::fabs(x) - std::fabs(y);
+    const float fold = -z > 0.0f ? -z : 0.0f;
+    x += x >= 0.0f ? -fold : fold;
+    y += y >= 0.0f ? -fold : fold;
+    const float invLength = 1.0f / std::sqrt(x * x + y * y + z * z);
+    pResult[0] = x * invLength;
+    pResult[1] = y * invLength;
+    pResult[2] = z * invLength;
+}
+
+// Квантование позиции - в double: во float (p - offset) * 65535 / scale округляется еще до
+// округления к целому, и ошибка выходит за половину шага на доли процента шага
+struct PackParams {
+    double offset[3];
+    double factor[3];  // 65535 / scale, у вырожденной оси 0
+};
+
+struct UnpackParams {
+    float offset[3];
+    float step[3];    // scale / 65535
+};
+
+PackParams MakePackParams(const PackedVertexBounds& bounds) {
+    PackParams params;
+    for (int i = 0; i < 3; i++) {
+        params.offset[i] = bounds.offset[i];
+        params.factor[i] = bounds.scale[i] > 0.0f ? 65535.0 / bounds.scale[i] : 0.0;
+    }
+    return params;
+}
+
+UnpackParams MakeUnpackParams(const PackedVertexBounds& bounds) {
+    UnpackParams params;
+    for (int i = 0; i < 3; i++) {
+        params.offset[i] = bounds.offset[i];
+        params.step[i] = bounds.scale[i] / 65535.0f;
+    }
+    return params;
+}
+
+void PackVertex(PackedTangentVertex& result, const TextureTangentVertex& vertex, const PackParams& params) {
+    const float position[3] = { vertex.x, vertex.y, vertex.z };
+    for (int i = 0; i < 3; i++) {
+        double q = (static_cast<double>(position[i]) - params.offset[i]) * params.factor[i];
+        q = q > 0.0 ? q : 0.0;
+        q = q < 65535.0 ? q : 65535.0;
+        result.position[i] = static_cast<uint16_t>(std::nearbyint(q));
+    }
+    result.position[3] = 0;
+    EncodeOctahedral(vertex.nx, vertex.ny, vertex.nz, &result.frame[0]);
+    EncodeOctahedral(vertex.tx, vertex.ty, vertex.tz, &result.frame[2]);
+    result.uv[0] = FloatToHalf(vertex.u);
+    result.uv[1] = FloatToHalf(vertex.v);
+}
+
+void UnpackVertex(TextureTangentVertex& result, const PackedTangentVertex& vertex, const UnpackParams& params) {
+    result.x = params.offset[0] + static_cast<float>(vertex.position[0]) * params.step[0];
+    result.y = params.offset[1] + static_cast<float>(vertex.position[1]) * params.step[1];
+    result.z = params.offset[2] + static_cast<float>(vertex.position[2]) * params.step[2];
+
+    float normal[3];
+    float tangent[3];
+    DecodeOctahedral(&vertex.frame[0], normal);
+    DecodeOctahedral(&vertex.frame[2], tangent);
+    // Касательная ортогонализуется к распакованной нормали, как в шейдере
+    const float d = tangent[0] * normal[0] + tangent[1] * normal[1] + tangent[2] * normal[2];
+    for (int i = 0; i < 3; i++) {
+        tangent[i] -= normal[i] * d;
+    }
+    float length = std::sqrt(tangent[0] * tangent[0] + tangent[1] * tangent[1] + tangent[2] * tangent[2]);
+    length = length > 1e-20f ? length : 1e-20f;
+    const float invLength = 1.0f / length;
+
+    result.nx = normal[0];
+    result.ny = normal[1];
+    result.nz = normal[2];
+    result.tx = tangent[0] * invLength;
+    result.ty = tangent[1] * invLength;
+    result.tz = tangent[2] * invLength;
+    result.u = HalfToFloat(vertex.uv[0]);
+    result.v = HalfToFloat(vertex.uv[1]);
+}
+
+#if PACKED_HAS_SSE2
+inline __m128 Abs4(__m128 v) {
+    return _mm_andnot_ps(_mm_set1_ps(-0.0f), v);
+}
+
+// a >= 0 ? b : c
+inline __m128 SelectNonNegative(__m128 a, __m128 b, __m128 c) {
+    const __m128 mask = _mm_cmpge_ps(a, _mm_setzero_ps());
+    return _mm_or_ps(_mm_and_ps(mask, b), _mm_andnot_ps(mask, c));
+}
+
+inline __m128i FloatToHalf4(__m128 value) {
+    const __m128 sign = _mm_and_ps(value, _mm_castsi128_ps(_mm_set1_epi32(static_cast<int>(0x80000000u))));
+    const __m128 absolute = _mm_xor_ps(value, sign);
+    const __m128i bits = _mm_castps_si128(absolute);
+
+    const __m128i isNan = _mm_castps_si128(_mm_cmpunord_ps(absolute, absolute));
+    const __m128i isRegular = _mm_cmpgt_epi32(_mm_set1_epi32(static_cast<int>(kF16Max)), bits);
+    const __m128i infinityOrNan = _mm_or_si128(_mm_and_si128(isNan, _mm_set1_epi32(0x200)), _mm_set1_epi32(0x7C00));
+    const __m128i isSubnormal = _mm_cmpgt_epi32(_mm_set1_epi32(static_cast<int>(kMinNormal)), bits);
+
+    const __m128i subnormalMagic = _mm_set1_epi32(static_cast<int>(kSubnormalMagic));
+    const __m128i subnormal = _mm_sub_epi32(_mm_castps_si128(_mm_add_ps(absolute, _mm_castsi128_ps(subnormalMagic))), subnormalMagic);
+    const __m128i mantissaOdd = _mm_srli_epi32(_mm_slli_epi32(bits, 31 - 13), 31);
+    const __m128i normal = _mm_srli_epi32(_mm_add_epi32(_mm_add_epi32(bits, _mm_set1_epi32(static_cast<int>(kNormalBias))), mantissaOdd), 13);
+
+    const __m128i finite = _mm_or_si128(_mm_and_si128(isSubnormal, subnormal), _mm_andnot_si128(isSubnormal, normal));
+    const __m128i joined = _mm_or_si128(_mm_and_si128(isRegular, finite), _mm_andnot_si128(isRegular, infinityOrNan));
+    return _mm_and_si128(_mm_or_si128(joined, _mm_srli_epi32(_mm_castps_si128(sign), 16)), _mm_set1_epi32(0xFFFF));
+}
+
+inline __m128 HalfToFloat4(__m128i half) {
+    const __m128i exponentMantissa = _mm_and_si128(half, _mm_set1_epi32(0x7FFF));
+    const __m128i sign = _mm_slli_epi32(_mm_xor_si128(half, exponentMantissa), 16);
+    const __m128 scaled = _mm_mul_ps(_mm_castsi128_ps(_mm_slli_epi32(exponentMantissa, 13)),
+        _mm_castsi128_ps(_mm_set1_epi32(static_cast<int>(kHalfToFloatMagic))));
+    const __m128i isInfinityOrNan = _mm_cmpgt_epi32(exponentMantissa, _mm_set1_epi32(0x7BFF));
+    const __m128i extra = _mm_or_si128(sign, _mm_and_si128(isInfinityOrNan, _mm_set1_epi32(static_cast<int>(kF32Infinity))));
+    return _mm_or_ps(scaled, _mm_castsi128_ps(extra));
+}
+
+// Возвращает x и y в младших байтах 32-битных слов
+inline void EncodeOctahedral4(__m128 x, __m128 y, __m128 z, __m128i& ex, __m128i& ey) {
+    const __m128 one = _mm_set1_ps(1.0f);
+    const __m128 minusOne = _mm_set1_ps(-1.0f);
+    const __m128 length = _mm_max_ps(_mm_add_ps(_mm_add_ps(Abs4(x), Abs4(y)), Abs4(z)), _mm_set1_ps(1e-30f));
+    __m128 px = _mm_div_ps(x, length);
+    __m128 py = _mm_div_ps(y, length);
+    const __m128 fx = _mm_mul_ps(_mm_sub_ps(one, Abs4(py)), SelectNonNegative(px, one, minusOne));
+    const __m128 fy = _mm_mul_ps(_mm_sub_ps(one, Abs4(px)), SelectNonNegative(py, one, minusOne));
+    const __m128 lower = _mm_cmplt_ps(z, _mm_setzero_ps());
+    px = _mm_or_ps(_mm_and_ps(lower, fx), _mm_andnot_ps(lower, px));
+    py = _mm_or_ps(_mm_and_ps(lower, fy), _mm_andnot_ps(lower, py));
+    const __m128 snormScale = _mm_set1_ps(127.0f);
+    const __m128i byteMask = _mm_set1_epi32(0xFF);
+    ex = _mm_and_si128(_mm_cvtps_epi32(_mm_mul_ps(px, snormScale)), byteMask);
+    ey = _mm_and_si128(_mm_cvtps_epi32(_mm_mul_ps(py, snormScale)), byteMask);
+}
+
+inline __m128 SnormToFloat4(__m128i value) {
+    return _mm_max_ps(_mm_div_ps(_mm_cvtepi32_ps(value), _mm_set1_ps(127.0f)), _mm_set1_ps(-1.0f));
+}
+
+inline void DecodeOctahedral4(__m128i ex, __m128i ey, __m128& x, __m128& y, __m128& z) {
+    x = SnormToFloat4(ex);
+    y = SnormToFloat4(ey);
+    z = _mm_sub_ps(_mm_sub_ps(_mm_set1_ps(1.0f), Abs4(x)), Abs4(y));
+    const __m128 fold = _mm_max_ps(_mm_sub_ps(_mm_setzero_ps(), z), _mm_setzero_ps());
+    const __m128 negativeFold = _mm_sub_ps(_mm_setzero_ps(), fold);
+    x = _mm_add_ps(x, SelectNonNegative(x, negativeFold, fold));
+    y = _mm_add_ps(y, SelectNonNegative(y, negativeFold, fold));
+    const __m128 invLength = _mm_div_ps(_mm_set1_ps(1.0f),
+        _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(x, x), _mm_mul_ps(y, y)), _mm_mul_ps(z, z))));
+    x = _mm_mul_ps(x, invLength);
+    y = _mm_mul_ps(y, invLength);
+    z = _mm_mul_ps(z, invLength);
+}
+
+// Транспонирование 4x4 32-битных слов: слово j вершины i <-> слово i строки j
+inline void Transpose4(__m128i& r0, __m128i& r1, __m128i& r2, __m128i& r3) {
+    const __m128i t0 = _mm_unpacklo_epi32(r0, r1);
+    const __m128i t1 = _mm_unpacklo_epi32(r2, r3);
+    const __m128i t2 = _mm_unpackhi_epi32(r0, r1);
+    const __m128i t3 = _mm_unpackhi_epi32(r2, r3);
+    r0 = _mm_unpacklo_epi64(t0, t1);
+    r1 = _mm_unpackhi_epi64(t0, t1);
+    r2 = _mm_unpacklo_epi64(t2, t3);
+    r3 = _mm_unpackhi_epi64(t2, t3);
+}
+
+void PackVertices4(PackedTangentVertex* pDestination, const TextureTangentVertex* v, const PackParams& params) {
+    const __m128 position[3] = {
+        _mm_setr_ps(v[0].x, v[1].x, v[2].x, v[3].x),
+        _mm_setr_ps(v[0].y, v[1].y, v[2].y, v[3].y),
+        _mm_setr_ps(v[0].z, v[1].z, v[2].z, v[3].z),
+    };
+    __m128i q[3];
+    for (int i = 0; i < 3; i++) {
+        // Те же операции double, что в PackVertex, по две вершины
+        const __m128d offset = _mm_set1_pd(params.offset[i]);
+        const __m128d factor = _mm_set1_pd(params.factor[i]);
+        __m128d low = _mm_mul_pd(_mm_sub_pd(_mm_cvtps_pd(position[i]), offset), factor);
+        __m128d high = _mm_mul_pd(_mm_sub_pd(_mm_cvtps_pd(_mm_movehl_ps(position[i], position[i])), offset), factor);
+        low = _mm_min_pd(_mm_max_pd(low, _mm_setzero_pd()), _mm_set1_pd(65535.0));
+        high = _mm_min_pd(_mm_max_pd(high, _mm_setzero_pd()), _mm_set1_pd(65535.0));
+        q[i] = _mm_unpacklo_epi64(_mm_cvtpd_epi32(low), _mm_cvtpd_epi32(high));
+    }
+
+    __m128i nx, ny, tx, ty;
+    EncodeOctahedral4(_mm_setr_ps(v[0].nx, v[1].nx, v[2].nx, v[3].nx), _mm_setr_ps(v[0].ny, v[1].ny, v[2].ny, v[3].ny),
+        _mm_setr_ps(v[0].nz, v[1].nz, v[2].nz, v[3].nz), nx, ny);
+    EncodeOctahedral4(_mm_setr_ps(v[0].tx, v[1].tx, v[2].tx, v[3].tx), _mm_setr_ps(v[0].ty, v[1].ty, v[2].ty, v[3].ty),
+        _mm_setr_ps(v[0].tz, v[1].tz, v[2].tz, v[3].tz), tx, ty);
+    const __m128i u = FloatToHalf4(_mm_setr_ps(v[0].u, v[1].u, v[2].u, v[3].u));
+    const __m128i uvV = FloatToHalf4(_mm_setr_ps(v[0].v, v[1].v, v[2].v, v[3].v));
+
+    // Слова вершины: x | y << 16, z, кадр по байтам, u | v << 16
+    __m128i w0 = _mm_or_si128(q[0], _mm_slli_epi32(q[1], 16));
+    __m128i w1 = q[2];
+    __m128i w2 = _mm_or_si128(_mm_or_si128(nx, _mm_slli_epi32(ny, 8)), _mm_or_si128(_mm_slli_epi32(tx, 16), _mm_slli_epi32(ty, 24)));
+    __m128i w3 = _mm_or_si128(u, _mm_slli_epi32(uvV, 16));
+    Transpose4(w0, w1, w2, w3);
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(&pDestination[0]), w0);
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(&pDestination[1]), w1);
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(&pDestination[2]), w2);
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(&pDestination[3]), w3);
+}
+
+void UnpackVertices4(TextureTangentVertex* pDestination, const PackedTangentVertex* pVertices, const UnpackParams& params) {
+    __m128i w0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(&pVertices[0]));
+    __m128i w1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(&pVertices[1]));
+    __m128i w2 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(&pVertices[2]));
+    __m128i w3 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(&pVertices[3]));
+    Transpose4(w0, w1, w2, w3);
+
+    const __m128i lowMask = _mm_set1_epi32(0xFFFF);
+    // Поля вершины по четыре: x, y, z, нормаль, касательная, u, v
+    alignas(16) float fields[11][4];
+    const __m128i q[3] = { _mm_and_si128(w0, lowMask), _mm_srli_epi32(w0, 16), _mm_and_si128(w1, lowMask) };
+    for (int i = 0; i < 3; i++) {
+        _mm_store_ps(fields[i], _mm_add_ps(_mm_set1_ps(params.offset[i]), _mm_mul_ps(_mm_cvtepi32_ps(q[i]), _mm_set1_ps(params.step[i]))));
+    }
+
+    __m128 nx, ny, nz, tx, ty, tz;
+    DecodeOctahedral4(_mm_srai_epi32(_mm_slli_epi32(w2, 24), 24), _mm_srai_epi32(_mm_slli_epi32(w2, 16), 24), nx, ny, nz);
+    DecodeOctahedral4(_mm_srai_epi32(_mm_slli_epi32(w2, 8), 24), _mm_srai_epi32(w2, 24), tx, ty, tz);
+    const __m128 d = _mm_add_ps(_mm_add_ps(_mm_mul_ps(tx, nx), _mm_mul_ps(ty, ny)), _mm_mul_ps(tz, nz));
+    tx = _mm_sub_ps(tx, _mm_mul_ps(nx, d));
+    ty = _mm_sub_ps(ty, _mm_mul_ps(ny, d));
+    tz = _mm_sub_ps(tz, _mm_mul_ps(nz, d));
+    const __m128 length = _mm_max_ps(_mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(tx, tx), _mm_mul_ps(ty, ty)), _mm_mul_ps(tz, tz))),
+        _mm_set1_ps(1e-20f));
+    const __m128 invLength = _mm_div_ps(_mm_set1_ps(1.0f), length);
+
+    _mm_store_ps(fields[3], nx);
+    _mm_store_ps(fields[4], ny);
+    _mm_store_ps(fields[5], nz);
+    _mm_store_ps(fields[6], _mm_mul_ps(tx, invLength));
+    _mm_store_ps(fields[7], _mm_mul_ps(ty, invLength));
+    _mm_store_ps(fields[8], _mm_mul_ps(tz, invLength));
+    _mm_store_ps(fields[9], HalfToFloat4(_mm_and_si128(w3, lowMask)));
+    _mm_store_ps(fields[10], HalfToFloat4(_mm_srli_epi32(w3, 16)));
+
+    for (int k = 0; k < 4; k++) {
+        float* pVertex = &pDestination[k].x;
+        for (int i = 0; i < 11; i++) {
+            pVertex[i] = fields[i][k];
+        }
+    }
+}
+#endif
+
+double NanosecondsPerVertex(std::chrono::steady_clock::time_point start, uint32_t vertexCount) {
+    return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / vertexCount;
+}
+
+} // namespace
+
+PackedVertexBounds ComputePackedVertexBounds(const TextureTangentVertex* pVertices, uint32_t vertexCount) {
+    PackedVertexBounds bounds = {};
+    if (vertexCount == 0) {
+        return bounds;
+    }
+    float minimum[3] = { pVertices[0].x, pVertices[0].y, pVertices[0].z };
+    float maximum[3] = { pVertices[0].x, pVertices[0].y, pVertices[0].z };
+    for (uint32_t v = 1; v < vertexCount; v++) {
+        const float position[3] = { pVertices[v].x, pVertices[v].y, pVertices[v].z };
+        for (int i = 0; i < 3; i++) {
+            minimum[i] = position[i] < minimum[i] ? position[i] : minimum[i];
+            maximum[i] = position[i] > maximum[i] ? position[i] : maximum[i];
+        }
+    }
+    for (int i = 0; i < 3; i++) {
+        bounds.offset[i] = minimum[i];
+        bounds.scale[i] = maximum[i] - minimum[i];
+    }
+    return bounds;
+}
+
+void PackVerticesScalar(PackedTangentVertex* pDestination, const TextureTangentVertex* pVertices, uint32_t vertexCount, const PackedVertexBounds& bounds) {
+    const PackParams params = MakePackParams(bounds);
+    for (uint32_t v = 0; v < vertexCount; v++) {
+        PackVertex(pDestination[v], pVertices[v], params);
+    }
+}
+
+void UnpackVerticesScalar(TextureTangentVertex* pDestination, const PackedTangentVertex* pVertices, uint32_t vertexCount, const PackedVertexBounds& bounds) {
+    const UnpackParams params = MakeUnpackParams(bounds);
+    for (uint32_t v = 0; v < vertexCount; v++) {
+        UnpackVertex(pDestination[v], pVertices[v], params);
+    }
+}
+
+void PackVertices(PackedTangentVertex* pDestination, const TextureTangentVertex* pVertices, uint32_t vertexCount, const PackedVertexBounds& bounds) {
+    const PackParams params = MakePackParams(bounds);
+    uint32_t v = 0;
+#if PACKED_HAS_SSE2
+    for (; v + 4 <= vertexCount; v += 4) {
+        PackVertices4(&pDestination[v], &pVertices[v], params);
+    }
+#endif
+    for (; v < vertexCount; v++) {
+        PackVertex(pDestination[v], pVertices[v], params);
+    }
+}
+
+void UnpackVertices(TextureTangentVertex* pDestination, const PackedTangentVertex* pVertices, uint32_t vertexCount, const PackedVertexBounds& bounds) {
+    const UnpackParams params = MakeUnpackParams(bounds);
+    uint32_t v = 0;
+#if PACKED_HAS_SSE2
+    for (; v + 4 <= vertexCount; v += 4) {
+        UnpackVertices4(&pDestination[v], &pVertices[v], params);
+    }
+#endif
+    for (; v < vertexCount; v++) {
+        UnpackVertex(pDestination[v], pVertices[v], params);
+    }
+}
+
+PackedVertexErrorStats MeasurePackedVertexError(const char* mesh, const TextureTangentVertex* pVertices, uint32_t vertexCount) {
+    PackedVertexErrorStats stats;
+    stats.mesh = mesh;
+    stats.vertexCount = vertexCount;
+
+    const PackedVertexBounds bounds = ComputePackedVertexBounds(pVertices, vertexCount);
+    std::vector<PackedTangentVertex> packed(vertexCount);
+    std::vector<PackedTangentVertex> packedScalar(vertexCount);
+    std::vector<TextureTangentVertex> unpacked(vertexCount);
+    std::vector<TextureTangentVertex> unpackedScalar(vertexCount);
+    PackVertices(packed.data(), pVertices, vertexCount, bounds);
+    PackVerticesScalar(packedScalar.data(), pVertices, vertexCount, bounds);
+    UnpackVertices(unpacked.data(), packed.data(), vertexCount, bounds);
+    UnpackVerticesScalar(unpackedScalar.data(), packed.data(), vertexCount, bounds);
+
+    const double radiansToDegrees = 180.0 / 3.14159265358979323846;
+    auto angle = [radiansToDegrees](const double* a, const double* b) {
+        const double d = a[0] * b[0] + a[1] * b[1] + a[2] * b[2];
+        return static_cast<float>(std::acos(d > 1.0 ? 1.0 : (d < -1.0 ? -1.0 : d)) * radiansToDegrees);
+    };
+    auto normalize = [](double* v) {
+        const double length = std::sqrt(v[0] * v[0] + v[1] * v[1] + v[2] * v[2]);
+        for (int i = 0; i < 3; i++) {
+            v[i] = length > 0 ? v[i] / length : 0;
+        }
+    };
+
+    double maxQuantizationSteps = 0;
+    bool roundingWithinBound = true;
+    for (uint32_t v = 0; v < vertexCount; v++) {
+        const TextureTangentVertex& original = pVertices[v];
+        const TextureTangentVertex& result = unpacked[v];
+        if (memcmp(&packed[v], &packedScalar[v], sizeof(PackedTangentVertex)) != 0 ||
+            memcmp(&unpacked[v], &unpackedScalar[v], sizeof(TextureTangentVertex)) != 0) {
+            stats.simdMismatchCount++;
+        }
+
+        // Квантование - против точной распаковки offset + q * scale / 65535 (double), округления float
+        // при распаковке - отдельно, против их границы
+        const float originalPosition[3] = { original.x, original.y, original.z };
+        const float resultPosition[3] = { result.x, result.y, result.z };
+        for (int i = 0; i < 3; i++) {
+            const double step = bounds.scale[i] / 65535.0;
+            const double exact = bounds.offset[i] + packed[v].position[i] * step;
+            const double quantizationError = std::fabs(exact - originalPosition[i]);
+            const double roundingError = std::fabs(resultPosition[i] - exact);
+            if (step > 0) {
+                maxQuantizationSteps = (std::max)(maxQuantizationSteps, quantizationError / step);
+                stats.maxPositionRoundingSteps = (std::max)(stats.maxPositionRoundingSteps, static_cast<float>(roundingError / step));
+                const double roundingBound = kPackedPositionRoundingSteps + std::ldexp(std::fabs(bounds.offset[i]) / step, -24);
+                roundingWithinBound = roundingWithinBound && roundingError / step <= roundingBound;
+            }
+            else {
+                // Вырожденная ось восстанавливается точно
+                roundingWithinBound = roundingWithinBound && quantizationError == 0 && roundingError == 0;
+            }
+        }
+
+        double normal[3] = { original.nx, original.ny, original.nz };
+        normalize(normal);
+        double tangent[3] = { original.tx, original.ty, original.tz };
+        const double d = tangent[0] * normal[0] + tangent[1] * normal[1] + tangent[2] * normal[2];
+        for (int i = 0; i < 3; i++) {
+            tangent[i] -= normal[i] * d;
+        }
+        normalize(tangent);
+        const double resultNormal[3] = { result.nx, result.ny, result.nz };
+        const double resultTangent[3] = { result.tx, result.ty, result.tz };
+        stats.maxNormalDegrees = (std::max)(stats.maxNormalDegrees, angle(normal, resultNormal));
+        stats.maxTangentDegrees = (std::max)(stats.maxTangentDegrees, angle(tangent, resultTangent));
+
+        const float originalUv[2] = { original.u, original.v };
+        const float resultUv[2] = { result.u, result.v };
+        for (int i = 0; i < 2; i++) {
+            const double magnitude = (std::max)(static_cast<double>(std::fabs(originalUv[i])), 1.0 / 16384.0);
+            const double error = std::fabs(static_cast<double>(resultUv[i]) - originalUv[i]) / magnitude;
+            stats.maxUvRelativeError = (std::max)(stats.maxUvRelativeError, static_cast<float>(error));
+        }
+    }
+
+    // Квантование в double: ровно половина шага с точностью до округлений double
+    stats.maxPositionSteps = static_cast<float>(maxQuantizationSteps);
+    stats.withinBounds = stats.simdMismatchCount == 0 &&
+        maxQuantizationSteps <= 0.5 + 1e-9 && roundingWithinBound &&
+        stats.maxNormalDegrees <= kPackedNormalMaxErrorDegrees &&
+        stats.maxTangentDegrees <= kPackedTangentMaxErrorDegrees &&
+        stats.maxUvRelativeError <= 1.0f / 2048.0f * 1.001f;
+    return stats;
+}
+
+std::vector<PackedVertexErrorStats> RunPackedVertexTests(uint32_t seed) {
+    std::mt19937 random(seed);
+    std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+    std::normal_distribution<float> gaussian(0.0f, 1.0f);
+    std::vector<PackedVertexErrorStats> results;
+
+    // Касательная - любой вектор, перпендикулярный нормали
+    auto setFrame = [](TextureTangentVertex& vertex, float nx, float ny, float nz, float ax, float ay, float az) {
+        const float normalLength = std::sqrt(nx * nx + ny * ny + nz * nz);
+        nx /= normalLength;
+        ny /= normalLength;
+        nz /= normalLength;
+        float d = ax * nx + ay * ny + az * nz;
+        float tx = ax - nx * d;
+        float ty = ay - ny * d;
+        float tz = az - nz * d;
+        float tangentLength = std::sqrt(tx * tx + ty * ty + tz * tz);
+        if (tangentLength < 1e-3f) {
+            // Вспомогательный вектор почти параллелен нормали
+            const bool useX = std::fabs(nx) < 0.9f;
+            d = useX ? nx : ny;
+            tx = (useX ? 1.0f : 0.0f) - nx * d;
+            ty = (useX ? 0.0f : 1.0f) - ny * d;
+            tz = -nz * d;
+            tangentLength = std::sqrt(tx * tx + ty * ty + tz * tz);
+        }
+        vertex.nx = nx;
+        vertex.ny = ny;
+        vertex.nz = nz;
+        vertex.tx = tx / tangentLength;
+        vertex.ty = ty / tangentLength;
+        vertex.tz = tz / tangentLength;
+    };
+
+    // Случайные вершины в кубе со стороной 100 и случайные кадры
+    {
+        std::vector<TextureTangentVertex> vertices(100000);
+        for (TextureTangentVertex& vertex : vertices) {
+            vertex.x = unit(random) * 50.0f;
+            vertex.y = unit(random) * 50.0f;
+            vertex.z = unit(random) * 50.0f;
+            setFrame(vertex, gaussian(random), gaussian(random), gaussian(random), gaussian(random), gaussian(random), gaussian(random));
+            vertex.u = unit(random) * 4.0f;
+            vertex.v = unit(random) * 4.0f;
+        }
+        results.push_back(MeasurePackedVertexError("random", vertices.data(), static_cast<uint32_t>(vertices.size())));
+    }
+
+    // Сфера Фибоначчи: равномерные направления, касательная вдоль параллели; плюс оси и
+    // направления у сгибов развертки (z около нуля и нижний полюс)
+    {
+        std::vector<TextureTangentVertex> vertices;
+        const uint32_t sphereCount = 262144;
+        const float goldenAngle = 2.39996323f;
+        for (uint32_t i = 0; i < sphereCount; i++) {
+            const float z = 1.0f - 2.0f * (i + 0.5f) / sphereCount;
+            const float radius = std::sqrt(1.0f - z * z);
+            const float phi = goldenAngle * i;
+            TextureTangentVertex vertex = {};
+            setFrame(vertex, radius * std::cos(phi), radius * std::sin(phi), z, -std::sin(phi), std::cos(phi), 0.0f);
+            vertices.push_back(vertex);
+        }
+        const float special[][3] = {
+            { 1, 0, 0 }, { -1, 0, 0 }, { 0, 1, 0 }, { 0, -1, 0 }, { 0, 0, 1 }, { 0, 0, -1 },
+            { 1, 1, 0 }, { -1, 1, 0 }, { 1, -1, 0 }, { -1, -1, 0 },
+            { 1, 1, -1e-6f }, { -1, 1, -1e-6f }, { 1, -1, -1e-6f }, { -1, -1, -1e-6f },
+            { 1e-6f, 1e-6f, -1 }, { -1e-6f, 1e-6f, -1 }, { 1, 0, -1e-6f }, { 0, -1, -1e-6f },
+            { 1, 1, 1 }, { 1, 1, -1 }, { -1, -1, -1 },
+        };
+        for (const float* pDirection : special) {
+            for (const float* pAuxiliary : special) {
+                TextureTangentVertex vertex = {};
+                setFrame(vertex, pDirection[0], pDirection[1], pDirection[2], pAuxiliary[0], pAuxiliary[1], pAuxiliary[2]);
+                vertices.push_back(vertex);
+            }
+        }
+        for (TextureTangentVertex& vertex : vertices) {
+            vertex.x = vertex.nx;
+            vertex.y = vertex.ny;
+            vertex.z = vertex.nz;
+        }
+        results.push_back(MeasurePackedVertexError("sphere directions", vertices.data(), static_cast<uint32_t>(vertices.size())));
+    }
+
+    // Плоская сетка: по y AABB нулевой толщины, позиция должна восстанавливаться точно
+    {
+        std::vector<TextureTangentVertex> vertices;
+        for (uint32_t i = 0; i < 64; i++) {
+            for (uint32_t j = 0; j < 64; j++) {
+                TextureTangentVertex vertex = {};
+                vertex.x = i * 0.25f - 8.0f;
+                vertex.y = 2.0f;
+                vertex.z = j * 0.25f - 8.0f;
+                setFrame(vertex, 0.0f, 1.0f, 0.0f, 1.0f, 0.0f, 0.0f);
+                vertex.u = i / 63.0f;
+                vertex.v = j / 63.0f;
+                vertices.push_back(vertex);
+            }
+        }
+        results.push_back(MeasurePackedVertexError("flat grid", vertices.data(), static_cast<uint32_t>(vertices.size())));
+    }
+
+    // Повторяющиеся текстуры и координаты у нуля (денормализованные half)
+    {
+        std::vector<TextureTangentVertex> vertices(4096);
+        for (uint32_t i = 0; i < vertices.size(); i++) {
+            TextureTangentVertex& vertex = vertices[i];
+            vertex.x = unit(random);
+            vertex.y = unit(random);
+            vertex.z = unit(random);
+            setFrame(vertex, gaussian(random), gaussian(random), gaussian(random), gaussian(random), gaussian(random), gaussian(random));
+            const float magnitude = std::pow(10.0f, unit(random) * 5.0f - 2.0f);
+            vertex.u = unit(random) * magnitude;
+            vertex.v = i % 2 ? 0.0f : -unit(random) * magnitude;
+        }
+        results.push_back(MeasurePackedVertexError("uv range", vertices.data(), static_cast<uint32_t>(vertices.size())));
+    }
+    return results;
+}
+
+PackedVertexBenchmarkResult RunPackedVertexBenchmark(uint32_t vertexCount) {
+    PackedVertexBenchmarkResult result;
+    result.vertexCount = vertexCount;
+    if (vertexCount == 0) {
+        return result;
+    }
+
+    std::mt19937 random(7);
+    std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+    std::vector<TextureTangentVertex> vertices(vertexCount);
+    for (TextureTangentVertex& vertex : vertices) {
+        vertex.x = unit(random) * 10.0f;
+        vertex.y = unit(random) * 10.0f;
+        vertex.z = unit(random) * 10.0f;
+        // Нормаль и касательная перпендикулярны: (a, b, c) и (b, -a, 0)
+        const float a = unit(random);
+        const float b = unit(random);
+        const float c = unit(random) + 2.0f;
+        const float normalLength = std::sqrt(a * a + b * b + c * c);
+        const float tangentLength = std::sqrt(a * a + b * b) + 1e-6f;
+        vertex.nx = a / normalLength;
+        vertex.ny = b / normalLength;
+        vertex.nz = c / normalLength;
+        vertex.tx = b / tangentLength;
+        vertex.ty = -a / tangentLength;
+        vertex.tz = 0.0f;
+        vertex.u = unit(random);
+        vertex.v = unit(random);
+    }
+    const PackedVertexBounds bounds = ComputePackedVertexBounds(vertices.data(), vertexCount);
+    std::vector<PackedTangentVertex> packed(vertexCount);
+    std::vector<TextureTangentVertex> unpacked(vertexCount);
+
+    // Лучший из трех замеров
+    auto measure = [vertexCount](const auto& fn) {
+        double best = 0;
+        for (int repeat = 0; repeat < 3; repeat++) {
+            const auto startTime = std::chrono::steady_clock::now();
+            fn();
+            const double nanoseconds = NanosecondsPerVertex(startTime, vertexCount);
+            best = repeat == 0 || nanoseconds < best ? nanoseconds : best;
+        }
+        return best;
+    };
+    result.packScalarNanoseconds = measure([&]() { PackVerticesScalar(packed.data(), vertices.data(), vertexCount, bounds); });
+    result.packSimdNanoseconds = measure([&]() { PackVertices(packed.data(), vertices.data(), vertexCount, bounds); });
+    result.unpackScalarNanoseconds = measure([&]() { UnpackVerticesScalar(unpacked.data(), packed.data(), vertexCount, bounds); });
+    result.unpackSimdNanoseconds = measure([&]() { UnpackVertices(unpacked.data(), packed.data(), vertexCount, bounds); });
+    return result;
+}
@@ -0,0 +1,71 @@
+﻿#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "SceneTypes.h"
+
+// Сжатая вершина для плотных сеток: 16 байт вместо 44 у TextureTangentVertex.
+// position - x, y, z в UNORM16 относительно AABB сетки (w = 0): p = offset + q / 65535 * scale;
+// frame - нормаль (xy) и касательная (zw) в октаэдрической развертке, SNORM8;
+// uv - half. В D3D11: R16G16B16A16_UNORM, R8G8B8A8_SNORM и R16G16_FLOAT, распаковка - в
+// вершинном шейдере с макросом PACKED_VERTEX, касательная там ортогонализуется к нормали.
+struct PackedTangentVertex {
+    uint16_t position[4];
+    int8_t frame[4];
+    uint16_t uv[2];
+};
+static_assert(sizeof(PackedTangentVertex) == 16, "PackedTangentVertex must stay 16 bytes");
+
+// Содержимое cbuffer PackedVertexBuffer (b5) вершинного шейдера
+struct PackedVertexBounds {
+    float offset[4];  // минимум AABB
+    float scale[4];   // размер AABB
+};
+
+// Границы ошибки после упаковки и распаковки, проверяются в LabTests.h. Позиция квантуется
+// (в double) не дальше половины шага scale / 65535 по каждой оси от точной распаковки
+// offset + q * scale / 65535. Распаковка во float, здесь и в шейдере, округляет шаг, произведение
+// и сумму: еще до kPackedPositionRoundingSteps + 2^-24 * |offset| / шаг шагов, так что ошибка
+// распакованной позиции - до 0.5 + 0.0117 шага у сеток вокруг начала координат. Текстурные
+// координаты - относительная ошибка half 2^-11 (у нуля абсолютная 2^-25)
+const float kPackedPositionRoundingSteps = 3.0f * 65535.0f / 16777216.0f;
+const float kPackedNormalMaxErrorDegrees = 1.25f;
+const float kPackedTangentMaxErrorDegrees = 2.0f;
+
+PackedVertexBounds ComputePackedVertexBounds(const TextureTangentVertex* pVertices, uint32_t vertexCount);
+
+// С SSE2 по четыре вершины, результат побитно совпадает со скалярными версиями
+void PackVertices(PackedTangentVertex* pDestination, const TextureTangentVertex* pVertices, uint32_t vertexCount, const PackedVertexBounds& bounds);
+void UnpackVertices(TextureTangentVertex* pDestination, const PackedTangentVertex* pVertices, uint32_t vertexCount, const PackedVertexBounds& bounds);
+void PackVerticesScalar(PackedTangentVertex* pDestination, const TextureTangentVertex* pVertices, uint32_t vertexCount, const PackedVertexBounds& bounds);
+void UnpackVerticesScalar(TextureTangentVertex* pDestination, const PackedTangentVertex* pVertices, uint32_t vertexCount, const PackedVertexBounds& bounds);
+
+struct PackedVertexErrorStats {
+    const char* mesh = "";
+    uint32_t vertexCount = 0;
+    float maxPositionSteps = 0;          // ошибка квантования позиции в шагах оси, не больше 0.5
+    float maxPositionRoundingSteps = 0;  // отклонение распаковки во float от точной, в шагах
+    float maxNormalDegrees = 0;
+    float maxTangentDegrees = 0;     // к касательной, ортогонализованной к исходной нормали
+    float maxUvRelativeError = 0;    // к max(|uv|, 2^-14)
+    uint32_t simdMismatchCount = 0;  // вершин, где SSE2 и скалярный путь разошлись
+    bool withinBounds = false;
+};
+
+// Упаковка и распаковка копии сетки, ошибки по всем вершинам и сравнение путей
+PackedVertexErrorStats MeasurePackedVertexError(const char* mesh, const TextureTangentVertex* pVertices, uint32_t vertexCount);
+
+// Случайные вершины, плотная выборка направлений сферы с осями и сгибами октаэдра,
+// вырожденный AABB и большие текстурные координаты
+std::vector<PackedVertexErrorStats> RunPackedVertexTests(uint32_t seed = 1);
+
+struct PackedVertexBenchmarkResult {
+    uint32_t vertexCount = 0;
+    double packScalarNanoseconds = 0;    // на вершину
+    double packSimdNanoseconds = 0;
+    double unpackScalarNanoseconds = 0;
+    double unpackSimdNanoseconds = 0;
+};
+
+PackedVertexBenchmarkResult RunPackedVertexBenchmark(uint32_t vertexCount);
@@ -0,0 +1,26 @@
+﻿#include "ReportWriter.h"
+
+#include <cstdarg>
+#include <cstdio>
+
+#include "FileIO.h"
+
+void ReportWriter::Print(const char* format, ...) {
+    va_list args;
+    va_start(args, format);
+    va_list measureArgs;
+    va_copy(measureArgs, args);
+    const int length = vsnprintf(nullptr, 0, format, measureArgs);
+    va_end(measureArgs);
+    if (length > 0) {
+        const size_t offset = m_text.size();
+        m_text.resize(offset + length + 1);
+        vsnprintf(&m_text[offset], length + 1, format, args);
+        m_text.resize(offset + length);
+    }
+    va_end(args);
+}
+
+bool ReportWriter::Save(const std::wstring& filePath) const {
+    return WriteWholeFile(filePath, m_text.data(), m_text.size());
+}
@@ -0,0 +1,25 @@
+﻿#pragma once
+
+#include <string>
+
+// Проверка формата Print компилятором (GCC, Clang); MSVC проверяет printf-форматы только у CRT
+#if defined(__GNUC__)
+#define REPORT_PRINTF_FORMAT(formatIndex, firstArgument) __attribute__((format(printf, formatIndex, firstArgument)))
+#else
+#define REPORT_PRINTF_FORMAT(formatIndex, firstArgument)
+#endif
+
+// Текст отчета: строки копятся в памяти, файл пишется целиком (WriteWholeFile). Один и тот же
+// код отчета работает в окне lab6 и в переносимых программах (BenchMain.cpp, TestMain.cpp).
+class ReportWriter {
+public:
+    // Текст по формату printf, без ограничения длины
+    void Print(const char* format, ...) REPORT_PRINTF_FORMAT(2, 3);
+    void Append(const std::string& text) { m_text += text; }
+
+    const std::string& GetText() const { return m_text; }
+    bool Save(const std::wstring& filePath) const;
+
+private:
+    std::string m_text;
+};
@@ -0,0 +1,491 @@
+﻿#include "Reports.h"
+
+#include <cwchar>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "BlockCompression.h"
+#include "DdsFile.h"
+#include "FileIO.h"
+#include "FrameProfiler.h"
+#include "FrustumCulling.h"
+#include "HeadlessRenderer.h"
+#include "Instancing.h"
+#include "LabTests.h"
+#include "LightClusters.h"
+#include "MeshImporter.h"
+#include "MeshOptimizer.h"
+#include "MeshSimplifier.h"
+#include "Meshlets.h"
+#include "MicroBenchmark.h"
+#include "OitReference.h"
+#include "SceneFrame.h"
+#include "SceneGraph.h"
+#include "SceneMeshes.h"
+#include "ThreadPool.h"
+#include "TransformBatch.h"
+#include "Transforms.h"
+#include "TransparencyQueue.h"
+
+namespace {
+
+// Число элементов массива (ARRAYSIZE без windows.h)
+template <typename T, size_t N>
+constexpr uint32_t CountOf(const T (&)[N]) {
+    return static_cast<uint32_t>(N);
+}
+
+// Режим -bcbench: скорость и проверка декодеров BC на случайных блоках и на текстурах lab6.
+// Отчет пишется в bc_benchmark.txt рядом с программой.
+bool RunBlockCompressionReport(const wchar_t*, ReportWriter& report) {
+    bool success = true;
+    report.Print("format          path     MB/s   mismatches\n");
+    for (const BcBenchmarkResult& result : RunBcDecoderBenchmark(1 << 16, 10)) {
+        report.Print("%-15s %-6s %8.1f   %zu\n", GetBcFormatName(result.format), GetBcDecoderPathName(result.path),
+            result.megabytesPerSecond, result.mismatchCount);
+        success = success && result.mismatchCount == 0;
+    }
+
+    const wchar_t* assetNames[] = { L"texture.dds", L"normal_map.dds", L"space.dds" };
+    const BcDecoderPath paths[] = { BcDecoderPath::Sse2, BcDecoderPath::Avx2 };
+    for (const wchar_t* name : assetNames) {
+        DdsFile file;
+        if (!file.Open(std::wstring(name))) {
+            report.Print("%ls: %s\n", name, file.GetErrorMessage().c_str());
+            success = false;
+            continue;
+        }
+        const uint32_t bytesPerBlock = DdsFile::GetBytesPerBlock(file.GetFormat());
+        for (BcDecoderPath path : paths) {
+            if (!IsBcDecoderPathSupported(path) || !IsBcFormatDecodable(file.GetFormat())) {
+                continue;
+            }
+            size_t mismatchCount = 0;
+            for (uint32_t i = 0; i < file.GetSubresourceCount(); i++) {
+                const DdsSubresource& sub = file.GetSubresources()[i];
+                mismatchCount += ValidateBcDecoder(file.GetFormat(), sub.pData, sub.size / bytesPerBlock, path);
+            }
+            report.Print("%ls (%s, %s): mismatches %zu\n", name, GetBcFormatName(file.GetFormat()), GetBcDecoderPathName(path), mismatchCount);
+            success = success && mismatchCount == 0;
+        }
+    }
+
+    return success;
+}
+
+// Режим -cullbench: отсечение 1M сфер и AABB по пирамиде видимости на всех путях (один поток).
+// Отчет пишется в culling_benchmark.txt; ошибка, если путь разошелся со скалярным.
+bool RunCullingBenchmarkReport(const wchar_t*, ReportWriter& report) {
+    bool success = true;
+    report.Print("shape    path     Mobj/s    visible   mismatches\n");
+    for (const CullBenchmarkResult& result : RunCullingBenchmark(1 << 20, 50)) {
+        report.Print("%-8s %-6s %8.1f %10u   %zu\n", result.shape, GetCullPathName(result.path),
+            result.millionObjectsPerSecond, result.visibleCount, result.mismatchCount);
+        success = success && result.mismatchCount == 0;
+    }
+
+    return success;
+}
+
+// Режим -sortbench: очередь полупрозрачных объектов против сортировки по расстоянию для 1k, 100k и 1M
+// объектов. Отчет пишется в transparency_benchmark.txt; ошибка, если очередь нарушила порядок.
+bool RunTransparencyBenchmarkReport(const wchar_t*, ReportWriter& report) {
+    bool success = true;
+    const uint32_t counts[] = { 1000, 100000, 1000000 };
+    report.Print("scene      objects  method      ms/frame  unchanged insertion  radix  errors\n");
+    for (const TransparencyBenchmarkResult& result : RunTransparencyBenchmark(counts, CountOf(counts), 20)) {
+        report.Print("%-9s %8u  %-10s %9.3f %10llu %9llu %6llu  %zu\n", result.scene, result.count, result.method, result.millisecondsPerFrame,
+            static_cast<unsigned long long>(result.stats.unchangedCount), static_cast<unsigned long long>(result.stats.insertionCount),
+            static_cast<unsigned long long>(result.stats.radixCount), result.orderErrors);
+        success = success && result.orderErrors == 0;
+    }
+
+    return success;
+}
+
+// Режим -oitbench: 10 000 прямоугольников на CPU - точное смешивание, сортировка по центрам и взвешенное
+// смешивание без порядка; время и отличие от точного результата. Отчет пишется в oit_benchmark.txt.
+bool RunOitBenchmarkReport(const wchar_t*, ReportWriter& report) {
+    report.Print("scene         method     ms/frame     rmse  max error  bad pixels\n");
+    for (const OitBenchmarkResult& result : RunOitBenchmark(10000, 640, 360, 3)) {
+        report.Print("%-13s %-9s %9.2f %8.4f %10.3f %10.1f%%\n", result.scene, GetOitMethodName(result.method), result.millisecondsPerFrame,
+            result.rmse, result.maxError, 100.0 * result.badPixelShare);
+    }
+
+    return true;
+}
+
+// Режим -lightbench: списки кластеров для 64-4096 точечных источников на всех путях, в одном потоке
+// и в пуле, и освещение тестовых пикселей по спискам против перебора всех источников.
+// Отчет пишется в light_clusters_benchmark.txt; ошибка, если списки путей разошлись.
+bool RunLightClusterBenchmarkReport(const wchar_t*, ReportWriter& report) {
+    ThreadPool threadPool;
+    const uint32_t lightCounts[] = { 64, 256, 1024, 4096 };
+    std::vector<LightClusterBuildResult> buildResults;
+    std::vector<LightShadingResult> shadingResults;
+    RunLightClusterBenchmark(lightCounts, CountOf(lightCounts), 20, &threadPool, buildResults, shadingResults);
+
+    bool success = true;
+    report.Print("lights  path    threads  build ms  indices  mismatches\n");
+    for (const LightClusterBuildResult& result : buildResults) {
+        report.Print("%6u  %-6s %8u %9.3f %8u  %zu\n", result.lightCount, GetCullPathName(result.path), result.threadCount,
+            result.milliseconds, result.indexCount, result.mismatchCount);
+        success = success && result.mismatchCount == 0;
+    }
+    report.Print("\nlights  lights/pixel  clustered ms  all lights ms  max difference\n");
+    for (const LightShadingResult& result : shadingResults) {
+        report.Print("%6u %13.2f %13.2f %14.2f %15g\n", result.lightCount, result.lightsPerPixel, result.clusteredMilliseconds,
+            result.naiveMilliseconds, result.maxDifference);
+    }
+
+    return success;
+}
+
+// Режим -transformbench: пересчет матриц 100000 объектов с разной долей движущихся, с неподвижной
+// и с вращающейся камерой - полный каждый кадр и только измененных (TransformSet), затем пакетный
+// расчет матриц 1M объектов (ComputeTransforms) против DirectXMath по объектам и иерархия из 1M узлов
+// (SceneGraph) против дерева на указателях.
+// Отчет пишется в transform_benchmark.txt; ошибка, если константы отличаются от полного пересчета,
+// пути пакетного расчета - друг от друга, матрицы - от DirectXMath больше погрешности или матрицы
+// мира узлов - от дерева на указателях.
+bool RunTransformBenchmarkReport(const wchar_t*, ReportWriter& report) {
+    const double dynamicFractions[] = { 1.0, 0.1, 0.01, 0.0 };
+    bool success = true;
+    report.Print("objects  dynamic  camera   full ms  tracked ms  speedup  normals  geom buffers  mismatches\n");
+    for (const TransformBenchmarkResult& result : RunTransformBenchmark(100000, dynamicFractions, CountOf(dynamicFractions), 100)) {
+        report.Print("%7u %7.0f%% %7s %9.3f %11.3f %7.1fx %8u %13u %11zu\n", result.objectCount, result.dynamicFraction * 100.0,
+            result.cameraMoving ? "moving" : "static", result.fullMilliseconds, result.trackedMilliseconds,
+            result.trackedMilliseconds > 0 ? result.fullMilliseconds / result.trackedMilliseconds : 0.0,
+            result.stats.normalsRecomputed, result.stats.constantsRebuilt, result.mismatchCount);
+        success = success && result.mismatchCount == 0;
+    }
+
+    ThreadPool threadPool;
+    report.Print("\nbatch         threads  Mobj/s  max difference  mismatches\n");
+    for (const TransformBatchBenchmarkResult& result : RunTransformBatchBenchmark(1 << 20, 10, &threadPool)) {
+        report.Print("%-12s %8u %7.1f %15g %11zu\n", result.name, result.threadCount, result.millionObjectsPerSecond,
+            result.maxDifference, result.mismatchCount);
+        success = success && result.mismatchCount == 0 && result.maxDifference < 1e-4;
+    }
+
+    const double animatedFractions[] = { 1.0, 0.01, 0.0 };
+    report.Print("\nscene graph   threads  animated  ms/frame   updated  mismatches\n");
+    for (const SceneGraphBenchmarkResult& result : RunSceneGraphBenchmark(1 << 20, animatedFractions, CountOf(animatedFractions), 10, &threadPool)) {
+        report.Print("%-12s %8u %8.0f%% %9.3f %9u %11zu\n", result.name, result.threadCount, result.animatedFraction * 100.0,
+            result.millisecondsPerFrame, result.updatedCount, result.mismatchCount);
+        success = success && result.mismatchCount == 0;
+    }
+
+    return success;
+}
+
+// Режим -profilebench: стоимость зоны профилировщика и проверка колец потоков - несколько потоков
+// пишут зоны без пауз, основной собирает. Отчет пишется в profiler_benchmark.txt; ошибка, если
+// запись не собрана и не учтена как отброшенная или зона дороже kProfileZoneMaxNanoseconds.
+bool RunProfilerBenchmarkReport(const wchar_t*, ReportWriter& report) {
+    const unsigned writerCounts[] = { 1, 4 };
+    bool success = true;
+    report.Print("writers  zone ns  loop ns  counter ns  ticks/us     written   collected     dropped  lost  budget\n");
+    for (unsigned writers : writerCounts) {
+        const ProfilerBenchmarkResult result = RunProfilerBenchmark(1 << 22, writers);
+        const bool withinBudget = result.nanosecondsPerZone <= kProfileZoneMaxNanoseconds;
+        report.Print("%7u %8.2f %8.2f %11.2f %9.1f %11llu %11llu %11llu %5llu  %s\n", result.writerThreads, result.nanosecondsPerZone,
+            result.nanosecondsPerLoop, result.nanosecondsPerTicks, result.ticksPerMicrosecond, static_cast<unsigned long long>(result.writtenCount),
+            static_cast<unsigned long long>(result.collectedCount), static_cast<unsigned long long>(result.droppedCount),
+            static_cast<unsigned long long>(result.lostCount), withinBudget ? "ok" : "FAIL");
+        success = success && result.lostCount == 0 && withinBudget;
+    }
+    report.Print("\nzone budget: %.0f ns (two counter reads and a ring write)\n", kProfileZoneMaxNanoseconds);
+
+    return success;
+}
+
+// Режим -meshopt: порядок треугольников для кэша вершин, кластеры против перерисовки и порядок
+// вершин для чтения (MeshOptimizer.h) на сетках lab6 и на больших сетках в случайном порядке.
+// Отчет пишется в mesh_optimizer.txt; ошибка, если после оптимизации изменились треугольники.
+bool RunMeshOptimizerReport(const wchar_t*, ReportWriter& report) {
+    std::vector<MeshOptimizationResult> results;
+    auto measure = [&results](const char* mesh, const uint16_t* pIndices, uint32_t indexCount, const void* pVertices, uint32_t vertexCount, uint32_t vertexStride) {
+        const std::vector<uint32_t> indices(pIndices, pIndices + indexCount);
+        results.push_back(MeasureMeshOptimization(mesh, indices.data(), indexCount, pVertices, vertexCount, vertexStride));
+    };
+    measure("cube", Indices, CountOf(Indices), Vertices, CountOf(Vertices), sizeof(TextureTangentVertex));
+    measure("skybox", SkyboxIndices, CountOf(SkyboxIndices), SkyboxVertices, CountOf(SkyboxVertices), sizeof(SphereVertex));
+    measure("squares", SquareIndices, CountOf(SquareIndices), SquareVertices, CountOf(SquareVertices), sizeof(TextureNormalVertex));
+    for (const MeshOptimizationResult& result : RunMeshOptimizerBenchmark()) {
+        results.push_back(result);
+    }
+
+    bool success = true;
+    report.Print("mesh                  triangles  vertices   ACMR before/after   ATVR before/after   overfetch before/after      ms  valid\n");
+    for (const MeshOptimizationResult& result : results) {
+        report.Print("%-21s %10u %9u %9.3f %9.3f %9.3f %9.3f %11.2f %10.2f %9.2f  %s\n", result.mesh, result.triangleCount,
+            result.vertexCount, result.before.acmr, result.after.acmr, result.before.atvr, result.after.atvr,
+            result.overfetchBefore, result.overfetchAfter, result.milliseconds, result.valid ? "yes" : "NO");
+        success = success && result.valid;
+    }
+
+    return success;
+}
+
+// Режим -importbench: плоская сетка 1024 x 1024 клеток (2M треугольников) как OBJ и как GLB
+// загружается из памяти в одном потоке и на пуле (MeshImporter.h). С -import <файл> вместо замера
+// загружается файл .obj, .gltf или .glb. Отчет пишется в mesh_import.txt; ошибка, если загрузка не
+// удалась или у сетки замера не те вершины, нормали и касательные.
+bool RunMeshImportReport(const wchar_t* pCommandLine, ReportWriter& report) {
+    ThreadPool threadPool;
+    bool success = true;
+    if (const wchar_t* pMeshPath = wcsstr(pCommandLine, L"-import ")) {
+        // Путь до конца командной строки, кавычки снимаются
+        std::wstring meshPath = pMeshPath + wcslen(L"-import ");
+        meshPath.erase(0, meshPath.find_first_not_of(L" \t\""));
+        meshPath.erase(meshPath.find_last_not_of(L" \t\"") + 1);
+
+        MeshImporter importer(&threadPool);
+        ImportedMesh mesh;
+        success = importer.Import(meshPath, mesh);
+        report.Print("file: %ls\n", meshPath.c_str());
+        if (!success) {
+            report.Print("error: %s\n", importer.GetErrorMessage().c_str());
+        }
+        else {
+            const MeshImportStats& stats = importer.GetStats();
+            report.Print("threads: %u\nsize: %.2f MB\ntriangles: %u\ncorners: %u\nvertices: %u (%.2f corners per vertex)\n",
+                threadPool.GetThreadCount(), stats.fileBytes / (1024.0 * 1024.0), stats.triangleCount, stats.cornerCount,
+                stats.vertexCount, stats.vertexCount > 0 ? static_cast<double>(stats.cornerCount) / stats.vertexCount : 0.0);
+            report.Print("indices: %u-bit\nmirrored vertices: %u\ngenerated normals: %s\n", mesh.Uses16BitIndices() ? 16 : 32,
+                mesh.mirroredVertexCount, stats.normalsGenerated ? "yes" : "no");
+            report.Print("parse ms: %.2f\ntangents and weld ms: %.2f\noptimize ms: %.2f\nlod ms: %.2f\ntotal ms: %.2f\n",
+                stats.parseMilliseconds, stats.tangentMilliseconds, stats.optimizeMilliseconds, stats.lodMilliseconds, stats.totalMilliseconds);
+            report.Print("lods: %u\n", stats.lodCount);
+            for (uint32_t lod = 0; lod < mesh.GetLodCount(); lod++) {
+                report.Print("  lod %u: %u triangles, error %g\n", lod, mesh.lods[lod].indexCount / 3, mesh.lods[lod].error);
+            }
+        }
+        return success;
+    }
+
+    report.Print("format  threads  triangles  vertices       MB  parse ms  tangent ms  total ms     MB/s  Mtri/s  normal err  tangent err  valid\n");
+    for (const MeshImportBenchmarkResult& result : RunMeshImportBenchmark(1024, &threadPool)) {
+        report.Print("%-6s %8u %10u %9u %8.1f %9.1f %11.1f %9.1f %8.1f %7.2f %11g %12g  %s\n", result.format, result.threadCount,
+            result.triangleCount, result.vertexCount, result.megabytes, result.stats.parseMilliseconds, result.stats.tangentMilliseconds,
+            result.milliseconds, result.megabytesPerSecond, result.millionTrianglesPerSecond, result.maxNormalError,
+            result.maxTangentError, result.valid ? "yes" : "NO");
+        success = success && result.valid;
+    }
+
+    return success;
+}
+
+// Режим -meshletbench: кластеры сферы и холмистой плоскости около полумиллиона треугольников каждая
+// (Meshlets.h) и их отсечение по пирамиде и конусам нормалей на всех путях для 64 видов камеры.
+// Отчет пишется в meshlet_benchmark.txt; ошибка, если кластеры неверны, отброшен видимый
+// треугольник или пути разошлись со скалярным.
+bool RunMeshletBenchmarkReport(const wchar_t*, ReportWriter& report) {
+    bool success = true;
+    report.Print("mesh     path    triangles  meshlets  verts/ml  tris/ml  build ms  cull ms  ms/Mtri  frustum  cone   backfacing  draws  mismatches  valid\n");
+    for (const MeshletBenchmarkResult& result : RunMeshletBenchmark()) {
+        report.Print("%-8s %-6s %10u %9u %9.1f %8.1f %9.1f %8.4f %8.4f %7.1f%% %5.1f%% %10.1f%% %6.1f %11zu  %s\n", result.mesh,
+            GetCullPathName(result.path), result.triangleCount, result.meshletCount, result.averageVertices, result.averageTriangles,
+            result.buildMilliseconds, result.cullMilliseconds, result.cullMillisecondsPerMillionTriangles, 100.0 * result.frustumRejectedShare,
+            100.0 * result.coneRejectedShare, 100.0 * result.backfacingShare, result.averageDrawRanges, result.mismatchCount, result.valid ? "yes" : "NO");
+        success = success && result.valid;
+    }
+
+    return success;
+}
+
+// Режим -lodbench: цепочки LOD (MeshSimplifier.h) неровной сферы и холмистой плоскости и облет поля
+// экземпляров сферы на программном растеризаторе с полной детализацией и с выбором LOD по ошибке
+// на экране (порог 1 пиксель) без гистерезиса и с ним. Отчет пишется в lod_benchmark.txt; ошибка,
+// если цепочка LOD неверна.
+bool RunMeshLodReport(const wchar_t*, ReportWriter& report) {
+    ThreadPool threadPool;
+    const MeshLodBenchmarkResult result = RunMeshLodBenchmark(threadPool);
+    bool success = true;
+    report.Print("mesh           vertices  lods  build ms  valid  triangles (error) per lod\n");
+    for (const MeshLodBuildResult& build : result.builds) {
+        report.Print("%-14s %8u %5u %9.1f  %-5s ", build.mesh, build.vertexCount, build.lodCount, build.buildMilliseconds, build.valid ? "yes" : "NO");
+        for (uint32_t lod = 0; lod < build.lodCount; lod++) {
+            report.Print(" %u (%.4f)", build.triangleCounts[lod], build.errors[lod]);
+        }
+        report.Print("\n");
+        success = success && build.valid;
+    }
+
+    report.Print("\nscene: %u instances, %u frames at %ux%u, %u threads\n", result.instanceCount, result.frameCount,
+        result.width, result.height, threadPool.GetThreadCount());
+    report.Print("mode               triangles/frame  ms/frame  triangles  frame time  lod switches  instance-frames per lod\n");
+    const MeshLodFrameResult& full = result.frames.front();
+    for (const MeshLodFrameResult& frames : result.frames) {
+        report.Print("%-18s %15llu %9.2f %9.1f%% %10.1f%% %13u ", frames.mode, static_cast<unsigned long long>(frames.trianglesPerFrame),
+            frames.millisecondsPerFrame, full.trianglesPerFrame > 0 ? 100.0 * frames.trianglesPerFrame / full.trianglesPerFrame : 0.0,
+            full.millisecondsPerFrame > 0 ? 100.0 * frames.millisecondsPerFrame / full.millisecondsPerFrame : 0.0, frames.lodSwitches);
+        for (uint32_t lod = 0; lod < kMaxMeshLods; lod++) {
+            report.Print(" %u", frames.lodHistogram[lod]);
+        }
+        report.Print("\n");
+    }
+
+    return success;
+}
+
+// Безоконный режим (HeadlessRenderer.h): кадры в файлы, время кадров и хеши - в отчет
+bool RunHeadlessReport(const wchar_t* pCommandLine, ReportWriter& report) {
+    HeadlessOptions options;
+    if (!ParseHeadlessOptions(pCommandLine, options)) {
+        return false;
+    }
+
+    ThreadPool threadPool;
+    HeadlessResult result;
+    const bool rendered = RunHeadless(threadPool, options, result);
+    report.Append(FormatHeadlessReport(options, result));
+    return rendered;
+}
+
+// Режим -test: проверки модулей (LabTests.h). Отчет пишется в tests.txt.
+bool RunLabTestsReport(const wchar_t*, ReportWriter& report) {
+    return RunLabTests(report);
+}
+
+// Режим -bench: микробенчмарки горячих путей (MicroBenchmark.h) и функций lab6 - центра квадрата
+// и констант кадра с камерой на орбите. Результаты пишутся в benchmark_results.json. С -benchcompare
+// они сравниваются с benchmark_baseline.json (сохраненный прежний benchmark_results.json), таблица
+// пишется в benchmark_compare.txt; ошибка, если базы нет или медиана случая выросла больше чем на 10%.
+bool RunMicroBenchmarkReport(bool compare, ReportWriter& report) {
+    MicroBenchmarkSuite suite;
+    AddCoreMicroBenchmarks(suite);
+    suite.Add("GetSquareCenter", [](uint32_t iterations) {
+        double sum = 0;
+        for (uint32_t i = 0; i < iterations; i++) {
+            sum += GetSquareCenter((i & 1) * 4).x;
+        }
+        return sum;
+    });
+    // Орбита камеры, граф сцены и TransformSet: камера сдвигается каждый кадр, как при вращении мышью
+    auto pTransforms = std::make_shared<SceneTransforms>();
+    auto pFrame = std::make_shared<FrameConstants>();
+    suite.Add("ComputeFrameConstants orbit", [pTransforms, pFrame](uint32_t iterations) {
+        DirectX::XMFLOAT3 cameraPosition = {};
+        double sum = 0;
+        for (uint32_t i = 0; i < iterations; i++) {
+            ComputeFrameConstants(1.0 / 60.0, i * 0.01, 0.5, 2.0, cameraPosition, *pTransforms, *pFrame);
+            sum += cameraPosition.x;
+        }
+        return sum;
+    });
+
+    const std::vector<MicroBenchmarkResult> results = suite.Run();
+    const std::string json = BuildMicroBenchmarkJson(results);
+    if (!WriteWholeFile(L"benchmark_results.json", json.data(), json.size())) {
+        return false;
+    }
+    if (!compare) {
+        return true;
+    }
+
+    MappedFile baselineFile;
+    std::vector<MicroBenchmarkResult> baseline;
+    if (!baselineFile.Open(std::wstring(L"benchmark_baseline.json")) ||
+        !ParseMicroBenchmarkJson(std::string(reinterpret_cast<const char*>(baselineFile.GetData()), baselineFile.GetSize()), baseline)) {
+        return false;
+    }
+    bool success = true;
+    report.Print("benchmark                            baseline ns   current ns   ratio\n");
+    for (const MicroBenchmarkComparison& comparison : CompareMicroBenchmarks(baseline, results, 0.10)) {
+        const char* status = comparison.regression ? "REGRESSION" : comparison.baselineNanoseconds == 0 ? "new" :
+            comparison.currentNanoseconds == 0 ? "removed" : "";
+        report.Print("%-36s %11.2f %12.2f %7.2f  %s\n", comparison.name.c_str(), comparison.baselineNanoseconds,
+            comparison.currentNanoseconds, comparison.ratio, status);
+        success = success && !comparison.regression;
+    }
+    return success;
+}
+
+#if !defined(_WIN32)
+// Без окна -instbench меряет только подготовку кадра; в Windows режим остается за окном lab6
+bool RunNullInstancingReport(const wchar_t*, ReportWriter& report) {
+    ThreadPool threadPool;
+    return RunInstancingBenchmarkReport(nullptr, threadPool, report);
+}
+#endif
+
+bool RunBenchmarkReport(const wchar_t*, ReportWriter& report) {
+    return RunMicroBenchmarkReport(false, report);
+}
+
+bool RunBenchmarkCompareReport(const wchar_t*, ReportWriter& report) {
+    return RunMicroBenchmarkReport(true, report);
+}
+
+// Порядок важен: ключ ищется подстрокой, поэтому -benchcompare стоит раньше -bench,
+// а -importbench - раньше "-import " (после него - путь к файлу)
+const ReportMode kReportModes[] = {
+    { L"-bcbench", L"bc_benchmark.txt", RunBlockCompressionReport },
+    { L"-cullbench", L"culling_benchmark.txt", RunCullingBenchmarkReport },
+    { L"-sortbench", L"transparency_benchmark.txt", RunTransparencyBenchmarkReport },
+    { L"-oitbench", L"oit_benchmark.txt", RunOitBenchmarkReport },
+    { L"-lightbench", L"light_clusters_benchmark.txt", RunLightClusterBenchmarkReport },
+    { L"-transformbench", L"transform_benchmark.txt", RunTransformBenchmarkReport },
+    { L"-profilebench", L"profiler_benchmark.txt", RunProfilerBenchmarkReport },
+    { L"-meshopt", L"mesh_optimizer.txt", RunMeshOptimizerReport },
+    { L"-importbench", L"mesh_import.txt", RunMeshImportReport },
+    { L"-import ", L"mesh_import.txt", RunMeshImportReport },
+    { L"-meshletbench", L"meshlet_benchmark.txt", RunMeshletBenchmarkReport },
+    { L"-lodbench", L"lod_benchmark.txt", RunMeshLodReport },
+    { L"-test", L"tests.txt", RunLabTestsReport },
+    { L"-headless", L"headless_report.txt", RunHeadlessReport },
+#if !defined(_WIN32)
+    { L"-instbench", L"instancing_benchmark.txt", RunNullInstancingReport },
+#endif
+    { L"-benchcompare", L"benchmark_compare.txt", RunBenchmarkCompareReport },
+    { L"-bench", nullptr, RunBenchmarkReport },
+};
+
+} // namespace
+
+const ReportMode* GetReportModes(size_t& count) {
+    count = CountOf(kReportModes);
+    return kReportModes;
+}
+
+const ReportMode* FindReportMode(const wchar_t* pCommandLine) {
+    for (const ReportMode& mode : kReportModes) {
+        if (wcsstr(pCommandLine, mode.key)) {
+            return &mode;
+        }
+    }
+    return nullptr;
+}
+
+bool RunInstancingBenchmarkReport(ISceneDrawBackend* pDeviceBackend, ThreadPool& threadPool, ReportWriter& report) {
+    NullSceneDrawBackend nullBackend;
+    struct {
+        const char* name;
+        ISceneDrawBackend* pBackend;
+        uint32_t frameCount;
+    } backends[] = { { "null", &nullBackend, 60 }, { "d3d11", pDeviceBackend, 10 } };
+
+    report.Print("backend  path        threads   ms/frame  draws/frame   MB/frame\n");
+    for (const auto& backend : backends) {
+        if (!backend.pBackend) {
+            continue;
+        }
+        for (const InstancingBenchmarkResult& result : RunInstancingBenchmark(*backend.pBackend, 100000, 1, backend.frameCount, &threadPool)) {
+            report.Print("%-8s %-11s %7u %10.3f %12llu %10.1f\n", backend.name, result.name, result.threadCount,
+                result.millisecondsPerFrame, static_cast<unsigned long long>(result.drawCallsPerFrame), result.bytesPerFrame / (1024.0 * 1024.0));
+        }
+    }
+
+    return true;
+}
+
+bool RunReportMode(const ReportMode& mode, const wchar_t* pCommandLine, ReportWriter& report) {
+    const bool success = mode.pRun(pCommandLine, report);
+    if (mode.reportPath && !report.Save(mode.reportPath)) {
+        return false;
+    }
+    return success;
+}
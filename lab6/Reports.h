@@ -0,0 +1,30 @@
+﻿#pragma once
+
+#include <cstddef>
+
+#include "ReportWriter.h"
+
+class ISceneDrawBackend;
+class ThreadPool;
+
+// Режимы отчетов lab6 - замеры и проверки модулей без окна и устройства. Режим выбирается ключом
+// командной строки; один и тот же код запускается из окна lab6 (до создания окна) и из переносимой
+// программы BenchMain.cpp. Описание каждого режима - у его функции в Reports.cpp.
+struct ReportMode {
+    const wchar_t* key;        // ключ командной строки, например L"-cullbench"
+    const wchar_t* reportPath; // файл отчета рядом с программой; nullptr - режим пишет свои файлы сам
+    // Текст отчета - в report; false, если замер или проверка не прошли
+    bool (*pRun)(const wchar_t* pCommandLine, ReportWriter& report);
+};
+
+const ReportMode* GetReportModes(size_t& count);
+// Первый режим таблицы, ключ которого есть в командной строке; nullptr - режима нет
+const ReportMode* FindReportMode(const wchar_t* pCommandLine);
+// Запуск режима и запись отчета в mode.reportPath; false, если режим не прошел или файл не записан
+bool RunReportMode(const ReportMode& mode, const wchar_t* pCommandLine, ReportWriter& report);
+
+// Режим -instbench: подготовка кадра для 100 000 кубов по объектам и с инстансингом без устройства
+// (NullSceneDrawBackend, только CPU) и, если задан pDeviceBackend, через устройство вместе с вызовами
+// драйвера. Окно lab6 запускает его после создания устройства с D3D11, переносимая программа
+// (таблица режимов вне Windows) - только без устройства. Отчет пишется в instancing_benchmark.txt.
+bool RunInstancingBenchmarkReport(ISceneDrawBackend* pDeviceBackend, ThreadPool& threadPool, ReportWriter& report);
@@ -0,0 +1,208 @@
+﻿#include "SceneFrame.h"
+
+#include <cstring>
+
+#include "BlockCompression.h"
+#include "DdsFile.h"
+#include "SceneMeshes.h"
+
+namespace {
+
+const uint32_t kCubeVertexCount = sizeof(Vertices) / sizeof(Vertices[0]);
+const uint32_t kCubeIndexCount = sizeof(Indices) / sizeof(Indices[0]);
+const uint32_t kSkyboxVertexCount = sizeof(SkyboxVertices) / sizeof(SkyboxVertices[0]);
+const uint32_t kSkyboxIndexCount = sizeof(SkyboxIndices) / sizeof(SkyboxIndices[0]);
+
+} // namespace
+
+void ComputeFrameConstants(double deltaTime, double angle_y, double angle_xz, double cameraRadius, DirectX::XMFLOAT3& cameraPosition,
+    SceneTransforms& transforms, FrameConstants& frame) {
+    SceneGraph& graph = transforms.graph;
+    TransformSet& transformSet = transforms.set;
+    if (!transforms.created) {
+        const uint32_t root = SceneGraph::kNoParent;
+        transforms.cameraNode = graph.AddNode(root, DirectX::XMFLOAT3(0.0f, 0.0f, 0.0f));
+        transforms.eyeNode = graph.AddNode(transforms.cameraNode, DirectX::XMFLOAT3(0.0f, 0.0f, -1.0f));
+        transforms.lightNode = graph.AddNode(root, DirectX::XMFLOAT3(0.5f, 0.7f, -0.5f));
+        transforms.lightMarkerNode = graph.AddNode(transforms.lightNode, DirectX::XMFLOAT3(0.0f, 0.0f, 0.0f),
+            DirectX::XMQuaternionIdentity(), DirectX::XMFLOAT3(0.1f, 0.1f, 0.1f));
+        transforms.cubeNode = graph.AddNode(root, DirectX::XMFLOAT3(0.0f, 0.0f, 0.0f));
+        transforms.cube2Node = graph.AddNode(root, DirectX::XMFLOAT3(2.0f, 0.0f, 0.0f));
+        transforms.sphereNode = graph.AddNode(root, DirectX::XMFLOAT3(0.0f, 0.0f, 0.0f));
+        transforms.squareNode = graph.AddNode(root, DirectX::XMFLOAT3(0.0f, 0.0f, 0.0f));
+
+        transforms.cube = transformSet.Add(DirectX::XMMatrixIdentity());
+        transforms.cube2 = transformSet.Add(DirectX::XMMatrixIdentity());
+        transforms.light = transformSet.Add(DirectX::XMMatrixIdentity());
+        transforms.sphere = transformSet.Add(DirectX::XMMatrixIdentity());
+        transforms.square = transformSet.Add(DirectX::XMMatrixIdentity());
+        transforms.created = true;
+    }
+
+    DirectX::XMVECTOR rotationAxis = DirectX::XMVectorSet(1.0f, 1.0f, 1.0f, 0.0f); // ось постоянного вращения куба
+    rotationAxis = DirectX::XMVector3Normalize(rotationAxis);
+    static const double rotationModelSpeed = 0.05f;
+
+    float& rotationAngle = transforms.rotationAngle;
+    rotationAngle += rotationModelSpeed * deltaTime;
+    if (rotationAngle > 2 * DirectX::XM_PI) {
+        rotationAngle -= 2 * DirectX::XM_PI;
+    }
+
+    graph.SetRotation(transforms.cubeNode, DirectX::XMQuaternionRotationNormal(rotationAxis, rotationAngle));
+
+    float cameraX = cameraRadius * sinf(static_cast<float>(angle_y)); // x = r * sin(angle)
+    float cameraZ = cameraRadius * cosf(static_cast<float>(angle_y)); // z = r * cos(angle)
+    float cameraY = cameraRadius * sinf(static_cast<float>(angle_xz));
+    cameraX *= cosf(static_cast<float>(angle_xz));
+    cameraZ *= cosf(static_cast<float>(angle_xz));
+
+    cameraPosition = DirectX::XMFLOAT3(cameraX, cameraY, cameraZ);
+
+    // Камера смотрит в начало координат: наклон на angle_xz и азимут, развернутый к центру
+    graph.SetLocal(transforms.cameraNode, cameraPosition,
+        DirectX::XMQuaternionRotationRollPitchYaw(static_cast<float>(angle_xz), static_cast<float>(angle_y) + DirectX::XM_PI, 0.0f),
+        DirectX::XMFLOAT3(1.0f, 1.0f, 1.0f));
+    graph.Update();
+
+    transformSet.SetWorld(transforms.cube, graph.GetWorld(transforms.cubeNode));
+    transformSet.SetWorld(transforms.cube2, graph.GetWorld(transforms.cube2Node));
+    transformSet.SetWorld(transforms.light, graph.GetWorld(transforms.lightMarkerNode));
+    transformSet.SetWorld(transforms.sphere, graph.GetWorld(transforms.sphereNode));
+    transformSet.SetWorld(transforms.square, graph.GetWorld(transforms.squareNode));
+
+    float fov = DirectX::XM_PI / 3.0f; // угол обзора 60 градусов
+    float aspectRatio = 1280.0f / 720.0f;
+    float nearZ = 0.1f; // ближняя плоскость отсечения
+    float farZ = 1000.0f; // дальняя плоскость отсечения
+    auto proj = DirectX::XMMatrixPerspectiveFovLH(fov, aspectRatio, nearZ, farZ);
+
+    // Вид - обратная к матрице мира глаза
+    transformSet.SetCamera(DirectX::XMMatrixInverse(nullptr, graph.GetWorld(transforms.eyeNode)), proj);
+    transformSet.Update();
+
+    // В кадр копируются только константы с новой версией
+    FrameConstantVersions& versions = frame.versions;
+    auto copyConstants = [&transformSet](uint32_t id, GeomBuffer& geom, uint64_t& version) {
+        if (version != transformSet.GetVersion(id)) {
+            geom = transformSet.GetConstants(id);
+            version = transformSet.GetVersion(id);
+        }
+    };
+    copyConstants(transforms.cube, frame.geom, versions.geom);
+    copyConstants(transforms.cube2, frame.geom2, versions.geom2);
+    copyConstants(transforms.light, frame.lightGeom, versions.lightGeom);
+    copyConstants(transforms.sphere, frame.sphereGeom, versions.sphereGeom);
+    copyConstants(transforms.square, frame.squareGeom, versions.squareGeom);
+
+    // SceneBuffer зависит от камеры и положения источника; версии из одного счетчика, бОльшая - последняя
+    const uint64_t cameraVersion = transformSet.GetCameraVersion();
+    const uint64_t lightVersion = transformSet.GetVersion(transforms.light);
+    const uint64_t sceneVersion = cameraVersion > lightVersion ? cameraVersion : lightVersion;
+    if (versions.scene == sceneVersion) {
+        return;
+    }
+
+    // зададим источник освещения
+    SceneBuffer& sceneBuffer = frame.scene;
+    sceneBuffer = {};
+    sceneBuffer.lightCount = DirectX::XMFLOAT4(1, 0, 0, 0); // Один источник света
+    DirectX::XMStoreFloat4(&sceneBuffer.lights[0].pos, graph.GetWorld(transforms.lightNode).r[3]);
+    sceneBuffer.lights[0].color = DirectX::XMFLOAT4(1.0f, 1.0f, 1.0f, 1.0f); // Белый цвет
+    sceneBuffer.ambientColor = DirectX::XMFLOAT4(0.05f, 0.05f, 0.05f, 1.0f); // Окружающее освещение
+    sceneBuffer.cameraPos = DirectX::XMFLOAT4(cameraPosition.x, cameraPosition.y, cameraPosition.z, 1.0f); // Позиция камеры
+
+    SceneBuffer& sphereSceneBuffer = frame.sphereScene;
+    sphereSceneBuffer.vp = frame.geom.view * frame.geom.projection;
+    sphereSceneBuffer.cameraPos.x = cameraX;
+    sphereSceneBuffer.cameraPos.y = cameraY;
+    sphereSceneBuffer.cameraPos.z = cameraZ;
+
+    versions.scene = sceneVersion;
+    versions.sphereScene = cameraVersion;
+}
+
+DirectX::XMFLOAT3 GetSquareCenter(uint32_t startVertex) {
+    DirectX::XMFLOAT3 center = { 0.0f, 0.0f, 0.0f };
+
+    // Суммируем координаты вершин квадрата
+    for (uint32_t i = 0; i < 4; ++i) {
+        center.x += SquareVertices[startVertex + i].x;
+        center.y += SquareVertices[startVertex + i].y;
+        center.z += SquareVertices[startVertex + i].z;
+    }
+
+    // Вычисляем среднее значение (центр)
+    center.x /= 4.0f;
+    center.y /= 4.0f;
+    center.z /= 4.0f;
+
+    return center;
+}
+
+void RenderSoftware(SoftwareRasterizer& rasterizer, const FrameConstants& frame, const MaterialBuffer& material,
+    const SoftwareTexture& colorTexture, const SoftwareTexture& normalTexture, const SoftwareCubeTexture& skyTexture) {
+    static const float clearColor[4] = { 0.3f, 0.3f, 0.3f, 1.0f }; // серый цвет
+    rasterizer.BeginFrame(clearColor, frame.scene, material);
+
+    // cubemap
+    SoftwareSkyboxDraw sky;
+    sky.vertices = SkyboxVertices;
+    sky.vertexCount = kSkyboxVertexCount;
+    sky.indices = SkyboxIndices;
+    sky.indexCount = kSkyboxIndexCount;
+    sky.geom = &frame.sphereGeom;
+    sky.scene = &frame.sphereScene;
+    sky.texture = &skyTexture;
+    rasterizer.DrawSkybox(sky);
+
+    // кубы
+    SoftwareMeshDraw cube;
+    cube.vertices = Vertices;
+    cube.vertexCount = kCubeVertexCount;
+    cube.indices = Indices;
+    cube.indexCount = kCubeIndexCount;
+    cube.colorTexture = &colorTexture;
+    cube.normalTexture = &normalTexture;
+    cube.geom = &frame.geom;
+    rasterizer.DrawMesh(cube);
+
+    cube.geom = &frame.geom2;
+    rasterizer.DrawMesh(cube);
+
+    // Отрисовка источника света
+    cube.geom = &frame.lightGeom;
+    cube.shader = SoftwarePixelShader::Light;
+    rasterizer.DrawMesh(cube);
+
+    rasterizer.EndFrame();
+}
+
+bool DecodeSoftwareTexture(const TextureData& source, SoftwareTexture& texture) {
+    const uint32_t format = source.GetFormat();
+    const bool rgba8 = format == DdsFormat::R8G8B8A8_UNORM || format == DdsFormat::R8G8B8A8_UNORM_SRGB;
+    if (!rgba8 && !IsBcFormatDecodable(format)) {
+        return false;
+    }
+
+    const uint32_t mipLevels = source.GetMipLevels();
+    texture.mips.resize(mipLevels);
+    for (uint32_t mip = 0; mip < mipLevels; mip++) {
+        const DdsSubresource& sub = source.GetSubresource(mip);
+        SoftwareTexture::Level& level = texture.mips[mip];
+        level.width = sub.width;
+        level.height = sub.height;
+        level.texels.resize(static_cast<size_t>(sub.width) * sub.height);
+        if (rgba8) {
+            // Формат уже подходит - копируем строки прямо из отображения
+            for (uint32_t y = 0; y < sub.height; y++) {
+                memcpy(level.texels.data() + static_cast<size_t>(y) * sub.width, sub.pData + static_cast<size_t>(y) * sub.rowPitch,
+                    sub.width * sizeof(uint32_t));
+            }
+        }
+        else if (!DecodeBcImage(format, sub.pData, sub.rowPitch, sub.width, sub.height, level.texels.data(), sub.width)) {
+            return false;
+        }
+    }
+    return true;
+}
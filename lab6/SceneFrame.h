@@ -0,0 +1,58 @@
+﻿#pragma once
+
+#include <DirectXMath.h>
+
+#include "SceneGraph.h"
+#include "SceneTypes.h"
+#include "SoftwareRasterizer.h"
+#include "TextureCache.h"
+#include "Transforms.h"
+
+// Кадр сцены lab6 без обращения к устройству: константы кадра (их загружают Render и
+// DrawSceneCubes) и отрисовка на программном растеризаторе. Собирается без d3d11.h и windows.h,
+// поэтому им пользуются и окно, и безоконный режим (HeadlessRenderer.h).
+
+// Расчет констант кадра без обращения к устройству (используется и программным бэкендом)
+// Объекты сцены: узлы SceneGraph, их матрицы мира - в TransformSet. Иерархия: камера -
+// орбита вокруг начала координат и глаз на единицу позади нее вдоль взгляда; маркер света -
+// потомок источника. Узлы и объекты создаются при первом кадре.
+struct SceneTransforms {
+    SceneGraph graph;
+    TransformSet set;
+    // Узлы
+    uint32_t cameraNode = 0;
+    uint32_t eyeNode = 0;
+    uint32_t lightNode = 0;
+    uint32_t cubeNode = 0;
+    uint32_t cube2Node = 0;
+    uint32_t lightMarkerNode = 0;
+    uint32_t sphereNode = 0;
+    uint32_t squareNode = 0;
+    // Объекты в TransformSet
+    uint32_t cube = 0;   // вращающийся куб
+    uint32_t cube2 = 0;  // неподвижный куб
+    uint32_t light = 0;  // маркер источника света
+    uint32_t sphere = 0;
+    uint32_t square = 0;
+    // Угол вращения куба - часть состояния сцены: повторный прогон с новым SceneTransforms
+    // (-headless) начинается с того же кадра
+    float rotationAngle = 0.0f;
+    bool created = false;
+};
+
+// Пересчитываются только изменившиеся константы: матрицы вращающегося куба каждый кадр,
+// вид и проекция всех объектов и SceneBuffer - когда двигается камера
+void ComputeFrameConstants(double deltaTime, double angle_y, double angle_xz, double cameraRadius, DirectX::XMFLOAT3& cameraPosition,
+    SceneTransforms& transforms, FrameConstants& frame);
+
+// Центр полупрозрачного квадрата из четырех вершин SquareVertices начиная с startVertex
+DirectX::XMFLOAT3 GetSquareCenter(uint32_t startVertex);
+
+// Тот же кадр, что и Render, но на программном растеризаторе (без полупрозрачных квадратов)
+void RenderSoftware(SoftwareRasterizer& rasterizer, const FrameConstants& frame, const MaterialBuffer& material,
+    const SoftwareTexture& colorTexture, const SoftwareTexture& normalTexture, const SoftwareCubeTexture& skyTexture);
+
+// Распаковка текстуры из кэша в RGBA8 для программного бэкенда: RGBA8 копируется строками,
+// BC1-BC5 и BC7 распаковываются своим декодером (BlockCompression.h). false для остальных
+// форматов - их окно переводит через DirectXTex (CreateSoftwareTexture в lab6.cpp)
+bool DecodeSoftwareTexture(const TextureData& source, SoftwareTexture& texture);
@@ -0,0 +1,307 @@
+﻿#include "SceneGraph.h"
+#include "ThreadPool.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <memory>
+#include <random>
+#include <type_traits>
+
+namespace {
+
+// Узлов уровня на одну задачу пула
+const uint32_t kLevelGrainSize = 4096;
+
+// Масштаб, поворот, перенос: строки матрицы поворота умножаются на масштаб, перенос - последняя строка
+inline DirectX::XMMATRIX ComputeLocalMatrix(const DirectX::XMFLOAT3& translation, const DirectX::XMFLOAT4& rotation, const DirectX::XMFLOAT3& scale) {
+    DirectX::XMMATRIX local = DirectX::XMMatrixRotationQuaternion(DirectX::XMLoadFloat4(&rotation));
+    local.r[0] = DirectX::XMVectorScale(local.r[0], scale.x);
+    local.r[1] = DirectX::XMVectorScale(local.r[1], scale.y);
+    local.r[2] = DirectX::XMVectorScale(local.r[2], scale.z);
+    local.r[3] = DirectX::XMVectorSet(translation.x, translation.y, translation.z, 1.0f);
+    return local;
+}
+
+} // namespace
+
+uint32_t SceneGraph::AddNode(uint32_t parent, const DirectX::XMFLOAT3& translation, DirectX::FXMVECTOR rotation, const DirectX::XMFLOAT3& scale) {
+    const uint32_t node = GetNodeCount();
+    const uint32_t parentSlot = parent != kNoParent ? m_slotOfNode[parent] : kNoParent;
+    const uint32_t depth = parentSlot != kNoParent ? m_depth[parentSlot] + 1 : 0;
+    // Новый узел встает в конец; если он мельче последнего, порядок по глубине нарушен
+    if (!m_depth.empty() && depth < m_depth.back()) {
+        m_sorted = false;
+    }
+    if (m_sorted) {
+        if (depth + 1 >= m_levelOffsets.size()) {
+            m_levelOffsets.resize(depth + 2, node);
+        }
+        m_levelOffsets[depth + 1] = node + 1;
+    }
+
+    m_parent.push_back(parentSlot);
+    m_translation.push_back(translation);
+    DirectX::XMFLOAT4 q;
+    DirectX::XMStoreFloat4(&q, rotation);
+    m_rotation.push_back(q);
+    m_scale.push_back(scale);
+    m_world.push_back(DirectX::XMMatrixIdentity());
+    m_localDirty.push_back(1);
+    m_worldChanged.push_back(0);
+    m_depth.push_back(depth);
+    m_nodeOfSlot.push_back(node);
+    m_slotOfNode.push_back(node);
+    m_dirtyCount++;
+    return node;
+}
+
+void SceneGraph::SetLocal(uint32_t node, const DirectX::XMFLOAT3& translation, DirectX::FXMVECTOR rotation, const DirectX::XMFLOAT3& scale) {
+    const uint32_t slot = m_slotOfNode[node];
+    m_translation[slot] = translation;
+    DirectX::XMStoreFloat4(&m_rotation[slot], rotation);
+    m_scale[slot] = scale;
+    MarkDirty(slot);
+}
+
+void SceneGraph::SetTranslation(uint32_t node, const DirectX::XMFLOAT3& translation) {
+    const uint32_t slot = m_slotOfNode[node];
+    m_translation[slot] = translation;
+    MarkDirty(slot);
+}
+
+void SceneGraph::SetRotation(uint32_t node, DirectX::FXMVECTOR rotation) {
+    const uint32_t slot = m_slotOfNode[node];
+    DirectX::XMStoreFloat4(&m_rotation[slot], rotation);
+    MarkDirty(slot);
+}
+
+void SceneGraph::MarkDirty(uint32_t slot) {
+    if (!m_localDirty[slot]) {
+        m_localDirty[slot] = 1;
+        m_dirtyCount++;
+    }
+}
+
+void SceneGraph::SortByDepth() {
+    const uint32_t count = GetNodeCount();
+    uint32_t levelCount = 0;
+    for (uint32_t depth : m_depth) {
+        levelCount = depth + 1 > levelCount ? depth + 1 : levelCount;
+    }
+    m_levelOffsets.assign(levelCount + 1, 0);
+    for (uint32_t depth : m_depth) {
+        m_levelOffsets[depth + 1]++;
+    }
+    for (uint32_t level = 0; level < levelCount; level++) {
+        m_levelOffsets[level + 1] += m_levelOffsets[level];
+    }
+
+    // Новая позиция каждого узла: родитель уровнем выше, поэтому его позиция уже известна
+    std::vector<uint32_t> newSlot(count);
+    std::vector<uint32_t> next(m_levelOffsets.begin(), m_levelOffsets.end() - 1);
+    for (uint32_t slot = 0; slot < count; slot++) {
+        newSlot[slot] = next[m_depth[slot]]++;
+    }
+
+    auto permute = [&newSlot, count](auto& values) {
+        typename std::remove_reference<decltype(values)>::type sorted(count);
+        for (uint32_t slot = 0; slot < count; slot++) {
+            sorted[newSlot[slot]] = values[slot];
+        }
+        values.swap(sorted);
+    };
+    for (uint32_t& parent : m_parent) {
+        parent = parent != kNoParent ? newSlot[parent] : kNoParent;
+    }
+    permute(m_parent);
+    permute(m_translation);
+    permute(m_rotation);
+    permute(m_scale);
+    permute(m_world);
+    permute(m_localDirty);
+    permute(m_worldChanged);
+    permute(m_depth);
+    permute(m_nodeOfSlot);
+    for (uint32_t slot = 0; slot < count; slot++) {
+        m_slotOfNode[m_nodeOfSlot[slot]] = slot;
+    }
+    m_sorted = true;
+}
+
+void SceneGraph::UpdateRange(uint32_t begin, uint32_t end) {
+    for (uint32_t slot = begin; slot < end; slot++) {
+        const uint32_t parent = m_parent[slot];
+        const bool changed = m_localDirty[slot] || (parent != kNoParent && m_worldChanged[parent]);
+        m_worldChanged[slot] = changed ? 1 : 0;
+        if (!changed) {
+            continue;
+        }
+        const DirectX::XMMATRIX local = ComputeLocalMatrix(m_translation[slot], m_rotation[slot], m_scale[slot]);
+        m_world[slot] = parent != kNoParent ? DirectX::XMMatrixMultiply(local, m_world[parent]) : local;
+        m_localDirty[slot] = 0;
+    }
+}
+
+void SceneGraph::Update(ThreadPool* pThreadPool) {
+    if (!m_sorted) {
+        SortByDepth();
+    }
+    const uint32_t levelCount = m_levelOffsets.empty() ? 0 : static_cast<uint32_t>(m_levelOffsets.size()) - 1;
+    const bool changedBefore = m_stats.updatedCount > 0;
+    m_stats = SceneGraphStats();
+    m_stats.nodeCount = GetNodeCount();
+    m_stats.levelCount = levelCount;
+    // Ничего не изменилось ни сейчас, ни в прошлый раз - отметки изменений уже сброшены
+    if (m_dirtyCount == 0 && !changedBefore) {
+        m_stats.skippedCount = m_stats.nodeCount;
+        return;
+    }
+
+    for (uint32_t level = 0; level < levelCount; level++) {
+        const uint32_t begin = m_levelOffsets[level];
+        const uint32_t end = m_levelOffsets[level + 1];
+        if (pThreadPool && end - begin > kLevelGrainSize) {
+            pThreadPool->ParallelFor(end - begin, kLevelGrainSize, [this, begin](uint32_t first, uint32_t last) {
+                UpdateRange(begin + first, begin + last);
+            });
+            m_stats.parallelLevels++;
+        }
+        else {
+            UpdateRange(begin, end);
+        }
+    }
+    m_dirtyCount = 0;
+
+    for (uint8_t changed : m_worldChanged) {
+        m_stats.updatedCount += changed;
+    }
+    m_stats.skippedCount = m_stats.nodeCount - m_stats.updatedCount;
+}
+
+std::vector<SceneGraphBenchmarkResult> RunSceneGraphBenchmark(uint32_t nodeCount, const double* pAnimatedFractions, uint32_t fractionCount,
+    uint32_t frameCount, ThreadPool* pThreadPool, uint32_t seed) {
+    // Лес: первые узлы - корни, родитель каждого следующего - случайный из предыдущих
+    const uint32_t rootCount = nodeCount < 16 ? nodeCount : 16;
+    std::mt19937 random(seed);
+    std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+    std::uniform_real_distribution<double> chance(0.0, 1.0);
+    std::vector<uint32_t> parents(nodeCount);
+    std::vector<DirectX::XMFLOAT3> translations(nodeCount);
+    std::vector<DirectX::XMFLOAT3> axes(nodeCount);
+    std::vector<double> draws(nodeCount);
+    for (uint32_t i = 0; i < nodeCount; i++) {
+        parents[i] = i < rootCount ? SceneGraph::kNoParent : std::uniform_int_distribution<uint32_t>(0, i - 1)(random);
+        translations[i] = DirectX::XMFLOAT3(unit(random), unit(random), unit(random));
+        axes[i] = DirectX::XMFLOAT3(unit(random), unit(random), unit(random) + 2.0f);
+        draws[i] = chance(random);
+    }
+    const DirectX::XMFLOAT3 scale(0.9f, 0.9f, 0.9f);
+    auto getRotation = [&axes](uint32_t i, uint32_t frame) {
+        return DirectX::XMQuaternionRotationAxis(DirectX::XMLoadFloat3(&axes[i]), 0.01f * frame);
+    };
+
+    // Дерево в куче: узлы выделяются в случайном порядке, как при загрузке сцены по частям
+    struct PointerNode {
+        DirectX::XMMATRIX world;
+        DirectX::XMFLOAT3 translation;
+        DirectX::XMFLOAT4 rotation;
+        std::vector<PointerNode*> children;
+    };
+    std::vector<uint32_t> allocationOrder(nodeCount);
+    for (uint32_t i = 0; i < nodeCount; i++) {
+        allocationOrder[i] = i;
+    }
+    std::shuffle(allocationOrder.begin(), allocationOrder.end(), random);
+    std::vector<std::unique_ptr<PointerNode>> pointerNodes(nodeCount);
+    for (uint32_t i : allocationOrder) {
+        pointerNodes[i].reset(new PointerNode());
+    }
+    std::vector<PointerNode*> roots;
+    for (uint32_t i = 0; i < nodeCount; i++) {
+        PointerNode& node = *pointerNodes[i];
+        node.translation = translations[i];
+        DirectX::XMStoreFloat4(&node.rotation, getRotation(i, 0));
+        if (parents[i] == SceneGraph::kNoParent) {
+            roots.push_back(&node);
+        }
+        else {
+            pointerNodes[parents[i]]->children.push_back(&node);
+        }
+    }
+    struct PointerTree {
+        DirectX::XMFLOAT3 scale;
+        void Update(PointerNode& node, const DirectX::XMMATRIX* pParentWorld) const {
+            const DirectX::XMMATRIX local = ComputeLocalMatrix(node.translation, node.rotation, scale);
+            node.world = pParentWorld ? DirectX::XMMatrixMultiply(local, *pParentWorld) : local;
+            for (PointerNode* pChild : node.children) {
+                Update(*pChild, &node.world);
+            }
+        }
+    };
+    const PointerTree pointerTree = { scale };
+
+    std::vector<SceneGraphBenchmarkResult> results;
+    std::vector<uint8_t> animated(nodeCount);
+    for (uint32_t f = 0; f < fractionCount; f++) {
+        for (uint32_t i = 0; i < nodeCount; i++) {
+            animated[i] = draws[i] < pAnimatedFractions[f] ? 1 : 0;
+        }
+
+        // Без отметок изменений: обход всего дерева каждый кадр
+        SceneGraphBenchmarkResult pointerResult;
+        pointerResult.name = "pointer tree";
+        pointerResult.animatedFraction = pAnimatedFractions[f];
+        for (uint32_t i = 0; i < nodeCount; i++) {
+            DirectX::XMStoreFloat4(&pointerNodes[i]->rotation, getRotation(i, 0));
+        }
+        for (PointerNode* pRoot : roots) {
+            pointerTree.Update(*pRoot, nullptr);
+        }
+        auto startTime = std::chrono::steady_clock::now();
+        for (uint32_t frame = 1; frame <= frameCount; frame++) {
+            for (uint32_t i = 0; i < nodeCount; i++) {
+                if (animated[i]) {
+                    DirectX::XMStoreFloat4(&pointerNodes[i]->rotation, getRotation(i, frame));
+                }
+            }
+            for (PointerNode* pRoot : roots) {
+                pointerTree.Update(*pRoot, nullptr);
+            }
+        }
+        pointerResult.millisecondsPerFrame = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - startTime).count() / frameCount;
+        pointerResult.updatedCount = nodeCount;
+        results.push_back(pointerResult);
+
+        for (int pass = 0; pass < (pThreadPool ? 2 : 1); pass++) {
+            ThreadPool* pPool = pass == 1 ? pThreadPool : nullptr;
+            SceneGraph graph;
+            for (uint32_t i = 0; i < nodeCount; i++) {
+                graph.AddNode(parents[i], translations[i], getRotation(i, 0), scale);
+            }
+            // Первое обновление упорядочивает узлы - как при загрузке сцены, в замер не входит
+            graph.Update(pPool);
+
+            SceneGraphBenchmarkResult result;
+            result.name = "SceneGraph";
+            result.threadCount = pPool ? pPool->GetThreadCount() : 1;
+            result.animatedFraction = pAnimatedFractions[f];
+            startTime = std::chrono::steady_clock::now();
+            for (uint32_t frame = 1; frame <= frameCount; frame++) {
+                for (uint32_t i = 0; i < nodeCount; i++) {
+                    if (animated[i]) {
+                        graph.SetRotation(i, getRotation(i, frame));
+                    }
+                }
+                graph.Update(pPool);
+            }
+            result.millisecondsPerFrame = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - startTime).count() / frameCount;
+            result.updatedCount = graph.GetStats().updatedCount;
+            for (uint32_t i = 0; i < nodeCount; i++) {
+                result.mismatchCount += memcmp(&graph.GetWorld(i), &pointerNodes[i]->world, sizeof(DirectX::XMMATRIX)) != 0 ? 1 : 0;
+            }
+            results.push_back(result);
+        }
+    }
+    return results;
+}
@@ -0,0 +1,83 @@
+﻿#pragma once
+
+#include <cstdint>
+#include <vector>
+#include <DirectXMath.h>
+
+class ThreadPool;
+
+// Иерархия сцены в плоских массивах: узлы упорядочены по глубине, поэтому родитель всегда
+// стоит раньше потомка, и матрицы мира обновляются одним проходом по массивам без обхода
+// дерева по указателям. Узлы одного уровня зависят только от предыдущего уровня - с пулом
+// каждый уровень делится между потоками. Матрица мира пересчитывается только у узлов,
+// у которых изменилось локальное преобразование или мир родителя.
+
+struct SceneGraphStats {
+    uint32_t nodeCount = 0;
+    uint32_t levelCount = 0;
+    uint32_t updatedCount = 0;  // пересчитана матрица мира
+    uint32_t skippedCount = 0;
+    uint32_t parallelLevels = 0; // уровни, разделенные между потоками
+};
+
+class SceneGraph {
+public:
+    static const uint32_t kNoParent = 0xFFFFFFFFu;
+
+    // Номер узла - порядковый номер добавления, он не меняется при упорядочивании.
+    // Родитель должен быть добавлен раньше.
+    uint32_t AddNode(uint32_t parent, const DirectX::XMFLOAT3& translation,
+        DirectX::FXMVECTOR rotation = DirectX::XMQuaternionIdentity(), const DirectX::XMFLOAT3& scale = DirectX::XMFLOAT3(1.0f, 1.0f, 1.0f));
+    uint32_t GetNodeCount() const { return static_cast<uint32_t>(m_parent.size()); }
+
+    // Локальное преобразование: масштаб, затем поворот (кватернион), затем перенос относительно родителя
+    void SetLocal(uint32_t node, const DirectX::XMFLOAT3& translation, DirectX::FXMVECTOR rotation, const DirectX::XMFLOAT3& scale);
+    void SetTranslation(uint32_t node, const DirectX::XMFLOAT3& translation);
+    void SetRotation(uint32_t node, DirectX::FXMVECTOR rotation);
+
+    // Матрицы мира изменившихся узлов; с пулом - уровни больше порции параллельно
+    void Update(ThreadPool* pThreadPool = nullptr);
+
+    // После последнего Update
+    const DirectX::XMMATRIX& GetWorld(uint32_t node) const { return m_world[m_slotOfNode[node]]; }
+    bool IsWorldChanged(uint32_t node) const { return m_worldChanged[m_slotOfNode[node]] != 0; }
+    const SceneGraphStats& GetStats() const { return m_stats; }
+
+private:
+    // Упорядочивание по глубине после добавления узлов: сортировка подсчетом, порядок
+    // добавления внутри уровня сохраняется
+    void SortByDepth();
+    void UpdateRange(uint32_t begin, uint32_t end);
+    void MarkDirty(uint32_t slot);
+
+    // По позициям в порядке глубины
+    std::vector<uint32_t> m_parent;      // позиция родителя или kNoParent
+    std::vector<DirectX::XMFLOAT3> m_translation;
+    std::vector<DirectX::XMFLOAT4> m_rotation;
+    std::vector<DirectX::XMFLOAT3> m_scale;
+    std::vector<DirectX::XMMATRIX> m_world;
+    std::vector<uint8_t> m_localDirty;
+    std::vector<uint8_t> m_worldChanged; // за последний Update
+    std::vector<uint32_t> m_depth;
+    std::vector<uint32_t> m_nodeOfSlot;
+
+    std::vector<uint32_t> m_slotOfNode;
+    std::vector<uint32_t> m_levelOffsets; // начало каждого уровня и конец последнего
+    bool m_sorted = true;
+    uint32_t m_dirtyCount = 0;           // узлов с новым локальным преобразованием
+    SceneGraphStats m_stats;
+};
+
+struct SceneGraphBenchmarkResult {
+    const char* name = "";
+    unsigned threadCount = 1;
+    double animatedFraction = 0;   // доля узлов, поворот которых меняется каждый кадр
+    double millisecondsPerFrame = 0;
+    uint32_t updatedCount = 0;     // пересчитано за последний кадр
+    size_t mismatchCount = 0;      // матрицы мира, отличающиеся от дерева на указателях
+};
+
+// Случайный лес из nodeCount узлов (глубина порядка ln(nodeCount)): дерево узлов в куче
+// с рекурсивным обходом и полным пересчетом против SceneGraph в одном потоке и в пуле
+std::vector<SceneGraphBenchmarkResult> RunSceneGraphBenchmark(uint32_t nodeCount, const double* pAnimatedFractions, uint32_t fractionCount,
+    uint32_t frameCount, ThreadPool* pThreadPool, uint32_t seed = 1);
@@ -0,0 +1,126 @@
+﻿#pragma once
+
+#include <cstdint>
+
+#include "SceneTypes.h"
+
+// Геометрия сцены lab6: куб с касательными, небесный куб и полупрозрачные квадраты. Вынесена
+// из lab6.h вместе с типами вершин (SceneTypes.h), чтобы программный бэкенд, безоконный режим
+// и отчеты собирались без d3d11.h.
+
+static const TextureTangentVertex Vertices[24] = {
+    // Bottom face
+    {-0.5f, -0.5f,  0.5f, 0.0f, -1.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f, 1.0f}, // 0
+    { 0.5f, -0.5f,  0.5f, 0.0f, -1.0f, 0.0f, 1.0f, 0.0f, 0.0f, 1.0f, 1.0f}, // 1
+    { 0.5f, -0.5f, -0.5f, 0.0f, -1.0f, 0.0f, 1.0f, 0.0f, 0.0f, 1.0f, 0.0f}, // 2
+    {-0.5f, -0.5f, -0.5f, 0.0f, -1.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f, 0.0f}, // 3
+
+    // Right face
+    { 0.5f, -0.5f, -0.5f, 1.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 1.0f}, // 4
+    { 0.5f, -0.5f,  0.5f, 1.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f, 1.0f, 1.0f}, // 5
+    { 0.5f,  0.5f,  0.5f, 1.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f, 1.0f, 0.0f}, // 6
+    { 0.5f,  0.5f, -0.5f, 1.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f}, // 7
+
+    // Front face
+    {-0.5f, -0.5f,  0.5f, 0.0f, 0.0f, 1.0f, 1.0f, 0.0f, 0.0f, 0.0f, 1.0f}, // 8
+    { 0.5f, -0.5f,  0.5f, 0.0f, 0.0f, 1.0f, 1.0f, 0.0f, 0.0f, 1.0f, 1.0f}, // 9
+    { 0.5f,  0.5f,  0.5f, 0.0f, 0.0f, 1.0f, 1.0f, 0.0f, 0.0f, 1.0f, 0.0f}, // 10
+    {-0.5f,  0.5f,  0.5f, 0.0f, 0.0f, 1.0f, 1.0f, 0.0f, 0.0f, 0.0f, 0.0f}, // 11
+
+    // Back face
+    {-0.5f, -0.5f, -0.5f, 0.0f, 0.0f, -1.0f, 1.0f, 0.0f, 0.0f, 1.0f, 1.0f}, // 12
+    { 0.5f, -0.5f, -0.5f, 0.0f, 0.0f, -1.0f, 1.0f, 0.0f, 0.0f, 0.0f, 1.0f}, // 13
+    { 0.5f,  0.5f, -0.5f, 0.0f, 0.0f, -1.0f, 1.0f, 0.0f, 0.0f, 0.0f, 0.0f}, // 14
+    {-0.5f,  0.5f, -0.5f, 0.0f, 0.0f, -1.0f, 1.0f, 0.0f, 0.0f, 1.0f, 0.0f}, // 15
+
+    // Top face
+    {-0.5f,  0.5f,  0.5f, 0.0f, 1.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f, 1.0f}, // 16
+    { 0.5f,  0.5f,  0.5f, 0.0f, 1.0f, 0.0f, 1.0f, 0.0f, 0.0f, 1.0f, 1.0f}, // 17
+    { 0.5f,  0.5f, -0.5f, 0.0f, 1.0f, 0.0f, 1.0f, 0.0f, 0.0f, 1.0f, 0.0f}, // 18
+    {-0.5f,  0.5f, -0.5f, 0.0f, 1.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f, 0.0f}, // 19
+
+    // Left face
+    {-0.5f, -0.5f, -0.5f, -1.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 1.0f}, // 20
+    {-0.5f, -0.5f,  0.5f, -1.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f, 1.0f, 1.0f}, // 21
+    {-0.5f,  0.5f,  0.5f, -1.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f, 1.0f, 0.0f}, // 22
+    {-0.5f,  0.5f, -0.5f, -1.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f}  // 23
+};
+
+static const uint16_t Indices[36] = {
+    0, 2, 1, 0, 3, 2,
+
+    4, 6, 5, 4, 7, 6,
+
+    8, 9, 10, 8, 10, 11,
+
+    12, 14, 13, 12, 15, 14,
+
+    16, 17, 18, 16, 18, 19,
+
+    20, 21, 22, 20, 22, 23
+};
+
+static const SphereVertex SkyboxVertices[24] = {
+    {-100.0f, -100.0f,  100.0f}, // 0
+    { 100.0f, -100.0f,  100.0f}, // 1
+    { 100.0f, -100.0f, -100.0f}, // 2
+    {-100.0f, -100.0f, -100.0f}, // 3
+
+    { 100.0f, -100.0f, -100.0f}, // 4
+    { 100.0f, -100.0f,  100.0f}, // 5
+    { 100.0f,  100.0f,  100.0f}, // 6
+    { 100.0f,  100.0f, -100.0f}, // 7
+
+    {-100.0f, -100.0f,  100.0f}, // 8
+    { 100.0f, -100.0f,  100.0f}, // 9
+    { 100.0f,  100.0f,  100.0f}, // 10
+    {-100.0f,  100.0f,  100.0f}, // 11
+
+    {-100.0f, -100.0f, -100.0f}, // 12
+    { 100.0f, -100.0f, -100.0f}, // 13
+    { 100.0f,  100.0f, -100.0f}, // 14
+    {-100.0f,  100.0f, -100.0f}, // 15
+
+    {-100.0f,  100.0f,  100.0f}, // 16
+    { 100.0f,  100.0f,  100.0f}, // 17
+    { 100.0f,  100.0f, -100.0f}, // 18
+    {-100.0f,  100.0f, -100.0f}, // 19
+
+    {-100.0f, -100.0f, -100.0f}, // 20
+    {-100.0f, -100.0f,  100.0f}, // 21
+    {-100.0f,  100.0f,  100.0f}, // 22
+    {-100.0f,  100.0f, -100.0f}  // 23
+};
+
+static const uint16_t SkyboxIndices[36] = {
+    0, 1, 2, 0, 2, 3,
+
+    4, 5, 6, 4, 6, 7,
+
+    8, 10, 9, 8, 11, 10,
+
+    12, 13, 14, 12, 14, 15,
+
+    16, 18, 17, 16, 19, 18,
+
+    20, 22, 21, 20, 23, 22
+};
+
+static const TextureNormalVertex SquareVertices[8] = {
+    // Красный квадрат (смещение по X на -2)
+    {0.9f, -0.5f,  0.5f, 1.0f, 0.0f, 0.0f, 0.0f, 0.0f}, // 0
+    {0.9f, -0.5f, -0.5f, 1.0f, 0.0f, 0.0f, 1.0f, 0.0f}, // 1
+    {0.9f,  0.5f, -0.5f, 1.0f, 0.0f, 0.0f, 1.0f, 1.0f}, // 2
+    {0.9f,  0.5f,  0.5f, 1.0f, 0.0f, 0.0f, 0.0f, 1.0f}, // 3
+
+    // Желтый квадрат (смещение по X на -3)
+    {1.0f, -0.5f,  0.5f, 1.0f, 0.0f, 0.0f, 0.0f, 0.0f}, // 4
+    {1.0f, -0.5f, -0.5f, 1.0f, 0.0f, 0.0f, 1.0f, 0.0f}, // 5
+    {1.0f,  0.5f, -0.5f, 1.0f, 0.0f, 0.0f, 1.0f, 1.0f}, // 6
+    {1.0f,  0.5f,  0.5f, 1.0f, 0.0f, 0.0f, 0.0f, 1.0f}  // 7
+};
+
+static const uint16_t SquareIndices[12] = {
+    0, 1, 2, 0, 2, 3,
+    4, 5, 6, 4, 6, 7
+};
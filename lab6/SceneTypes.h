@@ -0,0 +1,94 @@
+﻿#pragma once
+
+// Типы вершин и константных буферов сцены. Вынесены из lab6.h, чтобы их можно было
+// подключать из нескольких единиц трансляции (и собирать без d3d11.h).
+
+#include <cstdint>
+#include <DirectXMath.h>
+
+struct TextureVertex {
+    float x, y, z; // Позиция вершины
+    float u, v; // Текстурные координаты
+};
+
+struct TextureNormalVertex {
+    float x, y, z; // Позиция вершины
+    float nx, ny, nz; // Нормаль вершины
+    float u, v; // Текстурные координаты
+};
+
+struct TextureTangentVertex {
+    float x, y, z;       // Позиция вершины
+    float nx, ny, nz;    // Нормаль вершины
+    float tx, ty, tz;    // Касательный вектор
+    float u, v;          // Текстурные координаты
+};
+
+struct SphereVertex {
+    float x, y, z;
+};
+
+struct GeomBuffer {
+    DirectX::XMMATRIX model;
+    DirectX::XMMATRIX view;
+    DirectX::XMMATRIX projection;
+    DirectX::XMMATRIX normalMatrix; // Матрица для преобразования нормалей
+};
+
+struct Light {
+    DirectX::XMFLOAT4 pos; // Позиция источника света (x, y, z, w)
+    DirectX::XMFLOAT4 color; // Цвет источника света (r, g, b, a)
+};
+
+struct SceneBuffer {
+    DirectX::XMMATRIX vp; // Матрица вида и проекции
+    DirectX::XMFLOAT4 cameraPos; // Позиция камеры (x, y, z, w)
+    DirectX::XMFLOAT4 lightCount; // Количество источников света (x)
+    Light lights[10]; // Массив источников света (максимум 10)
+    DirectX::XMFLOAT4 ambientColor; // Цвет окружающего освещения (r, g, b, a)
+};
+
+struct MaterialBuffer {
+    DirectX::XMFLOAT4 shine; // x - коэффициент блеска
+};
+
+// полупрозрычные квадраты
+struct SquareInfo {
+    DirectX::XMFLOAT3 position;
+    DirectX::XMFLOAT4 color;
+    uint32_t startIndex;
+};
+
+struct ColorBuffer {
+    DirectX::XMFLOAT4 color;
+};
+
+// Сетка кластеров для точечных источников (b4 в pixelShaderCode)
+struct ClusterBuffer {
+    DirectX::XMFLOAT4 clusterGrid;  // ширина и высота тайла в пикселях, тайлов по x и по y
+    DirectX::XMFLOAT4 clusterDepth; // слой = log(z) * x + y, z - число слоев, w - 1, если списки есть
+};
+
+// Версии констант кадра из TransformSet: буфер, версия которого не изменилась
+// с прошлой загрузки, не загружается заново. 0 - версии нет.
+struct FrameConstantVersions {
+    uint64_t scene = 0;
+    uint64_t geom = 0;
+    uint64_t geom2 = 0;
+    uint64_t lightGeom = 0;
+    uint64_t sphereGeom = 0;
+    uint64_t sphereScene = 0;
+    uint64_t squareGeom = 0;
+};
+
+// Константы одного кадра, которые UpdateRotation загружает в константные буферы
+struct FrameConstants {
+    SceneBuffer scene;       // pSceneBuffer
+    GeomBuffer geom;         // pGeomBuffer - вращающийся куб
+    GeomBuffer geom2;        // pGeomBuffer2 - неподвижный куб
+    GeomBuffer lightGeom;    // pLightGeomBuffer - маркер источника света
+    GeomBuffer sphereGeom;   // pSphereGeomBuffer
+    SceneBuffer sphereScene; // pSphereSceneBuffer
+    GeomBuffer squareGeom;   // pSquareGeomBuffer
+    FrameConstantVersions versions;
+};
@@ -0,0 +1,212 @@
+﻿#include "ShaderCache.h"
+#include "Hash.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+
+namespace {
+
+const uint32_t kCacheMagic = 0x43425348; // "HSBC"
+const uint32_t kCacheVersion = 1;
+const uint64_t kCheckSeed = 0x5348414445524B59ull;
+
+struct FileHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t entryCount;
+    uint32_t reserved;
+};
+
+uint64_t HashString(const char* pText, uint64_t seed) {
+    return Hash64(pText, strlen(pText), seed);
+}
+
+uint64_t HashDesc(const ShaderCompileDesc& desc, const std::string& compilerVersion, uint64_t seed) {
+    uint64_t hash = Hash64(compilerVersion.data(), compilerVersion.size(), seed);
+    hash = Hash64(desc.pSource, desc.sourceSize, hash);
+    hash = HashString(desc.entryPoint, hash);
+    hash = HashString(desc.target, hash);
+    for (uint32_t i = 0; i < desc.defineCount; i++) {
+        hash = HashString(desc.pDefines[i].name, hash);
+        hash = HashString(desc.pDefines[i].definition ? desc.pDefines[i].definition : "", hash);
+    }
+    return Hash64(&desc.flags, sizeof(desc.flags), hash);
+}
+
+inline bool KeyLess(uint64_t hashA, uint64_t checkA, uint64_t hashB, uint64_t checkB) {
+    return hashA < hashB || (hashA == hashB && checkA < checkB);
+}
+
+} // namespace
+
+ShaderCache::ShaderCache(IShaderCompiler& compiler)
+    : m_compiler(compiler)
+    , m_compilerVersion(compiler.GetVersion()) {
+}
+
+bool ShaderCache::Open(const std::wstring& filePath) {
+    Close();
+    m_filePath = filePath;
+    if (!m_file.Open(filePath)) {
+        return false;
+    }
+
+    // Файл проверяется целиком до первого поиска: индекс в пределах файла, отсортирован,
+    // байт-код каждой записи в пределах файла. Иначе кэш считается пустым.
+    const uint8_t* pData = m_file.GetData();
+    const size_t size = m_file.GetSize();
+    FileHeader header;
+    if (size < sizeof(header)) {
+        m_file.Close();
+        return false;
+    }
+    memcpy(&header, pData, sizeof(header));
+    const size_t indexEnd = sizeof(header) + static_cast<size_t>(header.entryCount) * sizeof(IndexEntry);
+    if (header.magic != kCacheMagic || header.version != kCacheVersion || indexEnd > size) {
+        m_file.Close();
+        return false;
+    }
+    const IndexEntry* pIndex = reinterpret_cast<const IndexEntry*>(pData + sizeof(header));
+    for (uint32_t i = 0; i < header.entryCount; i++) {
+        const IndexEntry& entry = pIndex[i];
+        const bool sorted = i == 0 || KeyLess(pIndex[i - 1].hash, pIndex[i - 1].check, entry.hash, entry.check);
+        if (!sorted || entry.offset < indexEnd || entry.offset > size || entry.size > size - entry.offset) {
+            m_file.Close();
+            return false;
+        }
+    }
+
+    m_pIndex = pIndex;
+    m_entryCount = header.entryCount;
+    m_used.assign(m_entryCount, false);
+    return true;
+}
+
+void ShaderCache::Close() {
+    m_file.Close();
+    m_pIndex = nullptr;
+    m_entryCount = 0;
+    m_used.clear();
+    m_newEntries.clear();
+}
+
+ShaderCache::Key ShaderCache::MakeKey(const ShaderCompileDesc& desc) const {
+    Key key;
+    key.hash = HashDesc(desc, m_compilerVersion, 0);
+    key.check = HashDesc(desc, m_compilerVersion, kCheckSeed);
+    return key;
+}
+
+const ShaderCache::IndexEntry* ShaderCache::FindMapped(const Key& key) const {
+    const IndexEntry* pEnd = m_pIndex + m_entryCount;
+    const IndexEntry* pEntry = std::lower_bound(m_pIndex, pEnd, key, [](const IndexEntry& entry, const Key& value) {
+        return KeyLess(entry.hash, entry.check, value.hash, value.check);
+    });
+    if (pEntry != pEnd && pEntry->hash == key.hash && pEntry->check == key.check) {
+        return pEntry;
+    }
+    return nullptr;
+}
+
+const ShaderCache::NewEntry* ShaderCache::FindNew(const Key& key) const {
+    for (const auto& pEntry : m_newEntries) {
+        if (pEntry->key.hash == key.hash && pEntry->key.check == key.check) {
+            return pEntry.get();
+        }
+    }
+    return nullptr;
+}
+
+bool ShaderCache::GetBytecode(const ShaderCompileDesc& desc, ShaderBytecode& bytecode, std::string* pErrors) {
+    const Key key = MakeKey(desc);
+
+    if (const IndexEntry* pEntry = m_pIndex ? FindMapped(key) : nullptr) {
+        m_used[pEntry - m_pIndex] = true;
+        m_stats.hits++;
+        m_stats.savedMilliseconds += pEntry->compileMicroseconds / 1000.0;
+        bytecode.pData = m_file.GetData() + pEntry->offset;
+        bytecode.size = pEntry->size;
+        return true;
+    }
+    if (const NewEntry* pEntry = FindNew(key)) {
+        m_stats.hits++;
+        m_stats.savedMilliseconds += pEntry->compileMicroseconds / 1000.0;
+        bytecode.pData = pEntry->bytecode.data();
+        bytecode.size = pEntry->bytecode.size();
+        return true;
+    }
+
+    auto pEntry = std::make_unique<NewEntry>();
+    pEntry->key = key;
+    std::string errors;
+    const auto startTime = std::chrono::steady_clock::now();
+    const bool compiled = m_compiler.Compile(desc, pEntry->bytecode, errors);
+    const double elapsed = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - startTime).count();
+    m_stats.compileMilliseconds += elapsed;
+    if (pErrors) {
+        *pErrors = errors;
+    }
+    if (!compiled) {
+        m_stats.failures++;
+        return false;
+    }
+
+    m_stats.misses++;
+    pEntry->compileMicroseconds = static_cast<uint32_t>(std::min(elapsed * 1000.0, 4294967295.0));
+    bytecode.pData = pEntry->bytecode.data();
+    bytecode.size = pEntry->bytecode.size();
+    m_newEntries.push_back(std::move(pEntry));
+    return true;
+}
+
+bool ShaderCache::Save() {
+    if (m_newEntries.empty() || m_filePath.empty()) {
+        return true;
+    }
+
+    // Записи этого запуска: попадания из старого файла и новые, по возрастанию ключа
+    struct Record {
+        uint64_t hash;
+        uint64_t check;
+        uint32_t compileMicroseconds;
+        const uint8_t* pData;
+        uint32_t size;
+    };
+    std::vector<Record> records;
+    for (uint32_t i = 0; i < m_entryCount; i++) {
+        if (m_used[i]) {
+            const IndexEntry& entry = m_pIndex[i];
+            records.push_back(Record{ entry.hash, entry.check, entry.compileMicroseconds, m_file.GetData() + entry.offset, entry.size });
+        }
+    }
+    for (const auto& pEntry : m_newEntries) {
+        records.push_back(Record{ pEntry->key.hash, pEntry->key.check, pEntry->compileMicroseconds,
+            pEntry->bytecode.data(), static_cast<uint32_t>(pEntry->bytecode.size()) });
+    }
+    std::sort(records.begin(), records.end(), [](const Record& a, const Record& b) {
+        return KeyLess(a.hash, a.check, b.hash, b.check);
+    });
+
+    FileHeader header = { kCacheMagic, kCacheVersion, static_cast<uint32_t>(records.size()), 0 };
+    size_t offset = sizeof(header) + records.size() * sizeof(IndexEntry);
+    std::vector<IndexEntry> index(records.size());
+    for (size_t i = 0; i < records.size(); i++) {
+        index[i] = IndexEntry{ records[i].hash, records[i].check, offset, records[i].size, records[i].compileMicroseconds };
+        offset += (records[i].size + 3) & ~size_t(3);
+    }
+
+    std::vector<uint8_t> file(offset, 0);
+    memcpy(file.data(), &header, sizeof(header));
+    memcpy(file.data() + sizeof(header), index.data(), index.size() * sizeof(IndexEntry));
+    for (size_t i = 0; i < records.size(); i++) {
+        memcpy(file.data() + index[i].offset, records[i].pData, records[i].size);
+    }
+
+    // Отображенный файл нельзя заменить - закрываем его до записи
+    const std::wstring filePath = m_filePath;
+    Close();
+    const bool written = WriteWholeFile(filePath, file.data(), file.size());
+    Open(filePath);
+    return written;
+}
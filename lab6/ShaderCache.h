@@ -0,0 +1,112 @@
+﻿#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+#include "FileIO.h"
+
+// Кэш байт-кода шейдеров на диске. Ключ - хеш от исходного текста, точки входа, профиля,
+// макросов, флагов и версии компилятора, поэтому любое изменение шейдера или компилятора
+// просто дает промах. Все записи лежат в одном файле: заголовок, отсортированный индекс
+// и байт-код; файл отображается в память, поиск - двоичный по индексу без разбора файла.
+// Сам компилятор скрыт за IShaderCompiler: рендер подставляет D3DCompile, а без D3D
+// кэш проверяется с любой заменой, которая превращает текст в байты.
+
+struct ShaderMacro {
+    const char* name;
+    const char* definition;
+};
+
+struct ShaderCompileDesc {
+    const char* pSource = nullptr;
+    size_t sourceSize = 0;
+    const char* entryPoint = "";
+    const char* target = "";
+    const ShaderMacro* pDefines = nullptr;
+    uint32_t defineCount = 0;
+    uint32_t flags = 0; // флаги компилятора (D3DCOMPILE_*), входят в ключ
+};
+
+class IShaderCompiler {
+public:
+    virtual ~IShaderCompiler() = default;
+
+    // Строка версии компилятора, входит в ключ: после обновления компилятора кэш пересобирается
+    virtual std::string GetVersion() const = 0;
+    virtual bool Compile(const ShaderCompileDesc& desc, std::vector<uint8_t>& bytecode, std::string& errors) = 0;
+};
+
+// Байт-код из кэша; указатель действителен до Save() или Close()
+struct ShaderBytecode {
+    const void* pData = nullptr;
+    size_t size = 0;
+};
+
+struct ShaderCacheStats {
+    uint32_t hits = 0;
+    uint32_t misses = 0;
+    uint32_t failures = 0;          // ошибки компиляции
+    double compileMilliseconds = 0; // потрачено на компиляцию промахов
+    double savedMilliseconds = 0;   // сколько заняла бы компиляция попаданий (время записано при их компиляции)
+};
+
+class ShaderCache {
+public:
+    explicit ShaderCache(IShaderCompiler& compiler);
+
+    ShaderCache(const ShaderCache&) = delete;
+    ShaderCache& operator=(const ShaderCache&) = delete;
+
+    // Отображение файла кэша. Отсутствующий или испорченный файл - пустой кэш (false),
+    // Save() запишет его заново по тому же пути.
+    bool Open(const std::wstring& filePath);
+    void Close();
+
+    // Байт-код из кэша или от компилятора; при ошибке текст ошибки - в pErrors
+    bool GetBytecode(const ShaderCompileDesc& desc, ShaderBytecode& bytecode, std::string* pErrors = nullptr);
+
+    // Запись файла, если были промахи: в него попадают все записи, запрошенные в этом запуске,
+    // устаревшие отбрасываются. После записи файл снова отображается.
+    bool Save();
+
+    const ShaderCacheStats& GetStats() const { return m_stats; }
+
+private:
+    struct Key {
+        uint64_t hash = 0;
+        uint64_t check = 0; // второй хеш с другим зерном - защита от коллизий
+    };
+
+    // Запись индекса в файле
+    struct IndexEntry {
+        uint64_t hash;
+        uint64_t check;
+        uint64_t offset;
+        uint32_t size;
+        uint32_t compileMicroseconds;
+    };
+
+    struct NewEntry {
+        Key key;
+        uint32_t compileMicroseconds = 0;
+        std::vector<uint8_t> bytecode;
+    };
+
+    Key MakeKey(const ShaderCompileDesc& desc) const;
+    const IndexEntry* FindMapped(const Key& key) const;
+    const NewEntry* FindNew(const Key& key) const;
+
+    IShaderCompiler& m_compiler;
+    std::string m_compilerVersion;
+
+    std::wstring m_filePath;
+    MappedFile m_file;
+    const IndexEntry* m_pIndex = nullptr;
+    uint32_t m_entryCount = 0;
+    std::vector<bool> m_used; // записи индекса, запрошенные в этом запуске
+
+    std::vector<std::unique_ptr<NewEntry>> m_newEntries; // unique_ptr - адреса байт-кода не меняются
+    ShaderCacheStats m_stats;
+};
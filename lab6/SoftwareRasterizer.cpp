@@ -0,0 +1,588 @@
+﻿#include "SoftwareRasterizer.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+namespace {
+
+const uint32_t kSetupChunkSize = 1024; // треугольников на задачу при подготовке
+const uint32_t kBinChunkSize = 4096;   // треугольников на задачу при раскладке по тайлам
+const float kSubpixelScale = 256.0f;   // 8 бит субпиксельной точности, как у D3D11
+
+double NowSeconds() {
+    return std::chrono::duration<double>(std::chrono::high_resolution_clock::now().time_since_epoch()).count();
+}
+
+inline float Saturate(float v) {
+    return v < 0.0f ? 0.0f : (v > 1.0f ? 1.0f : v);
+}
+
+inline uint32_t PackColor(float r, float g, float b, float a) {
+    uint32_t ir = static_cast<uint32_t>(Saturate(r) * 255.0f + 0.5f);
+    uint32_t ig = static_cast<uint32_t>(Saturate(g) * 255.0f + 0.5f);
+    uint32_t ib = static_cast<uint32_t>(Saturate(b) * 255.0f + 0.5f);
+    uint32_t ia = static_cast<uint32_t>(Saturate(a) * 255.0f + 0.5f);
+    return ir | (ig << 8) | (ib << 16) | (ia << 24);
+}
+
+struct Float4 {
+    float x, y, z, w;
+};
+
+inline Float4 UnpackColor(uint32_t c) {
+    const float k = 1.0f / 255.0f;
+    return { (c & 0xFF) * k, ((c >> 8) & 0xFF) * k, ((c >> 16) & 0xFF) * k, (c >> 24) * k };
+}
+
+inline Float4 Lerp(const Float4& a, const Float4& b, float t) {
+    return { a.x + (b.x - a.x) * t, a.y + (b.y - a.y) * t, a.z + (b.z - a.z) * t, a.w + (b.w - a.w) * t };
+}
+
+inline int32_t WrapCoord(int32_t v, uint32_t size) {
+    int32_t m = v % static_cast<int32_t>(size);
+    return m < 0 ? m + static_cast<int32_t>(size) : m;
+}
+
+inline int32_t ClampCoord(int32_t v, uint32_t size) {
+    return v < 0 ? 0 : (v >= static_cast<int32_t>(size) ? static_cast<int32_t>(size) - 1 : v);
+}
+
+// Билинейная выборка из одного mip-уровня
+Float4 SampleBilinear(const SoftwareTexture::Level& level, float u, float v, bool wrap) {
+    float x = u * level.width - 0.5f;
+    float y = v * level.height - 0.5f;
+    float fx = std::floor(x);
+    float fy = std::floor(y);
+    float tx = x - fx;
+    float ty = y - fy;
+    int32_t x0 = static_cast<int32_t>(fx);
+    int32_t y0 = static_cast<int32_t>(fy);
+    int32_t x1 = x0 + 1;
+    int32_t y1 = y0 + 1;
+    if (wrap) {
+        x0 = WrapCoord(x0, level.width); x1 = WrapCoord(x1, level.width);
+        y0 = WrapCoord(y0, level.height); y1 = WrapCoord(y1, level.height);
+    }
+    else {
+        x0 = ClampCoord(x0, level.width); x1 = ClampCoord(x1, level.width);
+        y0 = ClampCoord(y0, level.height); y1 = ClampCoord(y1, level.height);
+    }
+    const uint32_t* row0 = level.texels.data() + static_cast<size_t>(y0) * level.width;
+    const uint32_t* row1 = level.texels.data() + static_cast<size_t>(y1) * level.width;
+    Float4 top = Lerp(UnpackColor(row0[x0]), UnpackColor(row0[x1]), tx);
+    Float4 bottom = Lerp(UnpackColor(row1[x0]), UnpackColor(row1[x1]), tx);
+    return Lerp(top, bottom, ty);
+}
+
+// Трилинейная выборка с адресацией WRAP. Анизотропный фильтр семплера lab6 приближается трилинейным,
+// уровень детализации считается по производным текстурных координат в пикселе.
+Float4 SampleTrilinear(const SoftwareTexture& texture, float u, float v, float dudx, float dvdx, float dudy, float dvdy) {
+    if (texture.mips.empty()) {
+        return { 0.0f, 0.0f, 0.0f, 1.0f };
+    }
+    const SoftwareTexture::Level& base = texture.mips[0];
+    float lenX = (dudx * base.width) * (dudx * base.width) + (dvdx * base.height) * (dvdx * base.height);
+    float lenY = (dudy * base.width) * (dudy * base.width) + (dvdy * base.height) * (dvdy * base.height);
+    float lod = 0.5f * std::log2(std::max(std::max(lenX, lenY), 1e-12f));
+    float maxLod = static_cast<float>(texture.mips.size() - 1);
+    lod = std::min(std::max(lod, 0.0f), maxLod);
+
+    uint32_t level0 = static_cast<uint32_t>(lod);
+    float t = lod - level0;
+    Float4 c0 = SampleBilinear(texture.mips[level0], u, v, true);
+    if (t <= 0.0f || level0 + 1 >= texture.mips.size()) {
+        return c0;
+    }
+    return Lerp(c0, SampleBilinear(texture.mips[level0 + 1], u, v, true), t);
+}
+
+// Выборка из кубической текстуры по направлению (правила выбора грани D3D)
+Float4 SampleCube(const SoftwareCubeTexture& texture, float x, float y, float z) {
+    float ax = std::fabs(x), ay = std::fabs(y), az = std::fabs(z);
+    uint32_t face;
+    float sc, tc, ma;
+    if (ax >= ay && ax >= az) {
+        face = x >= 0.0f ? 0 : 1;
+        sc = x >= 0.0f ? -z : z;
+        tc = -y;
+        ma = ax;
+    }
+    else if (ay >= az) {
+        face = y >= 0.0f ? 2 : 3;
+        sc = x;
+        tc = y >= 0.0f ? z : -z;
+        ma = ay;
+    }
+    else {
+        face = z >= 0.0f ? 4 : 5;
+        sc = z >= 0.0f ? x : -x;
+        tc = -y;
+        ma = az;
+    }
+    const SoftwareTexture& faceTexture = texture.faces[face];
+    if (faceTexture.mips.empty() || ma <= 0.0f) {
+        return { 0.0f, 0.0f, 0.0f, 1.0f };
+    }
+    // Для неба в lab6 создается SRV с одним mip-уровнем
+    return SampleBilinear(faceTexture.mips[0], (sc / ma + 1.0f) * 0.5f, (tc / ma + 1.0f) * 0.5f, false);
+}
+
+inline float PlaneAt(const float plane[3], float x, float y) {
+    return plane[0] * x + plane[1] * y + plane[2];
+}
+
+// Отсечение многоугольника плоскостью dot(plane, pos) >= 0 (алгоритм Сазерленда - Ходжмана)
+template <typename Vertex>
+uint32_t ClipPolygon(const Vertex* in, uint32_t count, Vertex* out, const float plane[4], uint32_t attrCount) {
+    uint32_t outCount = 0;
+    for (uint32_t i = 0; i < count; i++) {
+        const Vertex& a = in[i];
+        const Vertex& b = in[(i + 1) % count];
+        float da = a.pos[0] * plane[0] + a.pos[1] * plane[1] + a.pos[2] * plane[2] + a.pos[3] * plane[3];
+        float db = b.pos[0] * plane[0] + b.pos[1] * plane[1] + b.pos[2] * plane[2] + b.pos[3] * plane[3];
+        if (da >= 0.0f) {
+            out[outCount++] = a;
+        }
+        if ((da >= 0.0f) != (db >= 0.0f)) {
+            float t = da / (da - db);
+            Vertex& v = out[outCount++];
+            for (uint32_t k = 0; k < 4; k++) {
+                v.pos[k] = a.pos[k] + (b.pos[k] - a.pos[k]) * t;
+            }
+            for (uint32_t k = 0; k < attrCount; k++) {
+                v.attr[k] = a.attr[k] + (b.attr[k] - a.attr[k]) * t;
+            }
+        }
+    }
+    return outCount;
+}
+
+} // namespace
+
+SoftwareRasterizer::SoftwareRasterizer(ThreadPool& threadPool, uint32_t width, uint32_t height, uint32_t tileSize)
+    : m_threadPool(threadPool), m_width(width), m_height(height), m_tileSize(tileSize) {
+    m_tilesX = (width + tileSize - 1) / tileSize;
+    m_tilesY = (height + tileSize - 1) / tileSize;
+    m_color.resize(static_cast<size_t>(width) * height);
+    m_depth.resize(static_cast<size_t>(width) * height);
+}
+
+void SoftwareRasterizer::BeginFrame(const float clearColor[4], const SceneBuffer& scene, const MaterialBuffer& material) {
+    m_frameStart = NowSeconds();
+    m_frameTriangles = 0;
+    m_clearColor = PackColor(clearColor[0], clearColor[1], clearColor[2], clearColor[3]);
+    m_scene = scene;
+    m_material = material;
+    m_draws.clear();
+    m_triangles.clear();
+}
+
+void SoftwareRasterizer::DrawSkybox(const SoftwareSkyboxDraw& draw) {
+    m_frameTriangles += draw.indexCount / 3;
+
+    DrawState state = {};
+    state.kind = DrawKind::Skybox;
+    state.cubeTexture = draw.texture;
+    uint32_t drawIndex = static_cast<uint32_t>(m_draws.size());
+    m_draws.push_back(state);
+
+    // vertexSphereShaderCode: небо всегда центрировано на камере
+    const DirectX::XMMATRIX mvp = DirectX::XMMatrixMultiply(draw.geom->model, draw.scene->vp);
+    const DirectX::XMFLOAT4& cameraPos = draw.scene->cameraPos;
+    m_clipVertices.resize(draw.vertexCount);
+    for (uint32_t i = 0; i < draw.vertexCount; i++) {
+        const SphereVertex& v = draw.vertices[i];
+        ClipVertex& out = m_clipVertices[i];
+        DirectX::XMVECTOR pos = DirectX::XMVectorSet(cameraPos.x + v.x, cameraPos.y + v.y, cameraPos.z + v.z, 1.0f);
+        DirectX::XMFLOAT4 clip;
+        DirectX::XMStoreFloat4(&clip, DirectX::XMVector4Transform(pos, mvp));
+        out.pos[0] = clip.x; out.pos[1] = clip.y; out.pos[2] = clip.z; out.pos[3] = clip.w;
+        std::fill(out.attr, out.attr + AttributeCount, 0.0f);
+        out.attr[0] = v.x; out.attr[1] = v.y; out.attr[2] = v.z; // localPos
+    }
+
+    // Порядок обхода граней неба рассчитан на отсечение задних граней по умолчанию
+    SetupTriangles(m_clipVertices.data(), draw.indices, draw.indexCount, SoftwareCullMode::Back, drawIndex);
+}
+
+void SoftwareRasterizer::DrawMesh(const SoftwareMeshDraw& draw) {
+    m_frameTriangles += draw.indexCount / 3;
+
+    DrawState state = {};
+    state.kind = DrawKind::Mesh;
+    state.shader = draw.shader;
+    state.colorTexture = draw.colorTexture;
+    state.normalTexture = draw.normalTexture;
+    uint32_t drawIndex = static_cast<uint32_t>(m_draws.size());
+    m_draws.push_back(state);
+
+    // vertexShaderCode
+    const GeomBuffer& geom = *draw.geom;
+    const DirectX::XMMATRIX viewProj = DirectX::XMMatrixMultiply(geom.view, geom.projection);
+    m_clipVertices.resize(draw.vertexCount);
+    m_threadPool.ParallelFor(draw.vertexCount, 4096, [&](uint32_t begin, uint32_t end) {
+        for (uint32_t i = begin; i < end; i++) {
+            const TextureTangentVertex& v = draw.vertices[i];
+            ClipVertex& out = m_clipVertices[i];
+
+            DirectX::XMVECTOR worldPos = DirectX::XMVector4Transform(DirectX::XMVectorSet(v.x, v.y, v.z, 1.0f), geom.model);
+            DirectX::XMVECTOR clipPos = DirectX::XMVector4Transform(worldPos, viewProj);
+            DirectX::XMVECTOR norm = DirectX::XMVector3TransformNormal(DirectX::XMVectorSet(v.nx, v.ny, v.nz, 0.0f), geom.normalMatrix);
+            DirectX::XMVECTOR tang = DirectX::XMVector3TransformNormal(DirectX::XMVectorSet(v.tx, v.ty, v.tz, 0.0f), geom.model);
+
+            DirectX::XMFLOAT4 clip, world;
+            DirectX::XMFLOAT3 n, t;
+            DirectX::XMStoreFloat4(&clip, clipPos);
+            DirectX::XMStoreFloat4(&world, worldPos);
+            DirectX::XMStoreFloat3(&n, norm);
+            DirectX::XMStoreFloat3(&t, tang);
+
+            out.pos[0] = clip.x; out.pos[1] = clip.y; out.pos[2] = clip.z; out.pos[3] = clip.w;
+            out.attr[0] = world.x; out.attr[1] = world.y; out.attr[2] = world.z;
+            out.attr[3] = n.x; out.attr[4] = n.y; out.attr[5] = n.z;
+            out.attr[6] = t.x; out.attr[7] = t.y; out.attr[8] = t.z;
+            out.attr[9] = v.u; out.attr[10] = v.v;
+        }
+    });
+
+    SetupTriangles(m_clipVertices.data(), draw.indices, draw.indexCount, draw.cullMode, drawIndex);
+}
+
+void SoftwareRasterizer::SetupTriangles(const ClipVertex* vertices, const uint16_t* indices, uint32_t indexCount,
+    SoftwareCullMode cullMode, uint32_t drawIndex) {
+    const uint32_t triangleCount = indexCount / 3;
+    const uint32_t chunkCount = (triangleCount + kSetupChunkSize - 1) / kSetupChunkSize;
+    if (m_setupChunks.size() < chunkCount) {
+        m_setupChunks.resize(chunkCount);
+    }
+
+    m_threadPool.ParallelFor(chunkCount, 1, [&](uint32_t begin, uint32_t end) {
+        for (uint32_t chunk = begin; chunk < end; chunk++) {
+            std::vector<RasterTriangle>& out = m_setupChunks[chunk];
+            out.clear();
+            uint32_t first = chunk * kSetupChunkSize;
+            uint32_t last = std::min(first + kSetupChunkSize, triangleCount);
+            for (uint32_t i = first; i < last; i++) {
+                SetupTriangle(vertices[indices[i * 3]], vertices[indices[i * 3 + 1]], vertices[indices[i * 3 + 2]],
+                    cullMode, drawIndex, out);
+            }
+        }
+    });
+
+    // Сохраняем порядок подачи треугольников - от него зависит результат при равной глубине
+    for (uint32_t chunk = 0; chunk < chunkCount; chunk++) {
+        m_triangles.insert(m_triangles.end(), m_setupChunks[chunk].begin(), m_setupChunks[chunk].end());
+    }
+}
+
+void SoftwareRasterizer::SetupTriangle(const ClipVertex& v0, const ClipVertex& v1, const ClipVertex& v2,
+    SoftwareCullMode cullMode, uint32_t drawIndex, std::vector<RasterTriangle>& out) const {
+    // Отсечение ближней (z >= 0) и дальней (z <= w) плоскостями, остальное отбрасывает ограничивающий прямоугольник
+    static const float nearPlane[4] = { 0.0f, 0.0f, 1.0f, 0.0f };
+    static const float farPlane[4] = { 0.0f, 0.0f, -1.0f, 1.0f };
+
+    ClipVertex polygon[3] = { v0, v1, v2 };
+    const ClipVertex* verts = polygon;
+    uint32_t count = 3;
+
+    bool needsClip = false;
+    for (uint32_t i = 0; i < 3; i++) {
+        if (polygon[i].pos[2] < 0.0f || polygon[i].pos[2] > polygon[i].pos[3]) {
+            needsClip = true;
+        }
+    }
+
+    ClipVertex clipped0[5];
+    ClipVertex clipped1[6];
+    if (needsClip) {
+        count = ClipPolygon(polygon, 3, clipped0, nearPlane, AttributeCount);
+        count = ClipPolygon(clipped0, count, clipped1, farPlane, AttributeCount);
+        verts = clipped1;
+        if (count < 3) {
+            return;
+        }
+    }
+
+    struct ScreenVertex {
+        float x, y, z, invW;
+        const float* attr;
+    };
+    ScreenVertex screen[6];
+    for (uint32_t i = 0; i < count; i++) {
+        float invW = 1.0f / verts[i].pos[3];
+        float ndcX = verts[i].pos[0] * invW;
+        float ndcY = verts[i].pos[1] * invW;
+        // Привязка к субпиксельной сетке
+        screen[i].x = std::round((ndcX * 0.5f + 0.5f) * m_width * kSubpixelScale) / kSubpixelScale;
+        screen[i].y = std::round((0.5f - ndcY * 0.5f) * m_height * kSubpixelScale) / kSubpixelScale;
+        screen[i].z = verts[i].pos[2] * invW;
+        screen[i].invW = invW;
+        screen[i].attr = verts[i].attr;
+    }
+
+    // Многоугольник после отсечения разбиваем веером
+    for (uint32_t k = 1; k + 1 < count; k++) {
+        const ScreenVertex* s[3] = { &screen[0], &screen[k], &screen[k + 1] };
+        float area = (s[1]->x - s[0]->x) * (s[2]->y - s[0]->y) - (s[2]->x - s[0]->x) * (s[1]->y - s[0]->y);
+        if (area == 0.0f) {
+            continue;
+        }
+        // Лицевые грани - обход по часовой стрелке на экране (area > 0)
+        if (area < 0.0f) {
+            if (cullMode == SoftwareCullMode::Back) {
+                continue;
+            }
+            std::swap(s[1], s[2]);
+            area = -area;
+        }
+
+        RasterTriangle tri;
+        float minX = std::min(s[0]->x, std::min(s[1]->x, s[2]->x));
+        float maxX = std::max(s[0]->x, std::max(s[1]->x, s[2]->x));
+        float minY = std::min(s[0]->y, std::min(s[1]->y, s[2]->y));
+        float maxY = std::max(s[0]->y, std::max(s[1]->y, s[2]->y));
+        tri.minX = std::max(static_cast<int32_t>(std::floor(minX)), 0);
+        tri.minY = std::max(static_cast<int32_t>(std::floor(minY)), 0);
+        tri.maxX = std::min(static_cast<int32_t>(std::ceil(maxX)), static_cast<int32_t>(m_width) - 1);
+        tri.maxY = std::min(static_cast<int32_t>(std::ceil(maxY)), static_cast<int32_t>(m_height) - 1);
+        if (tri.minX > tri.maxX || tri.minY > tri.maxY) {
+            continue;
+        }
+
+        // Ребро i противолежит вершине i: e_i(p) > 0 внутри треугольника, sum(e_i) = area
+        for (uint32_t i = 0; i < 3; i++) {
+            const ScreenVertex& a = *s[(i + 1) % 3];
+            const ScreenVertex& b = *s[(i + 2) % 3];
+            float dx = b.x - a.x;
+            float dy = b.y - a.y;
+            tri.edge[i][0] = -dy;
+            tri.edge[i][1] = dx;
+            tri.edge[i][2] = dy * a.x - dx * a.y;
+            // Правило верхнего левого ребра
+            tri.topLeft[i] = (dy == 0.0f && dx > 0.0f) || dy < 0.0f;
+        }
+
+        // Коэффициенты плоскости f(x, y) по значениям в вершинах
+        const float dx1 = s[1]->x - s[0]->x, dy1 = s[1]->y - s[0]->y;
+        const float dx2 = s[2]->x - s[0]->x, dy2 = s[2]->y - s[0]->y;
+        const float invArea = 1.0f / area;
+        auto makePlane = [&](float f0, float f1, float f2, float plane[3]) {
+            float df1 = f1 - f0;
+            float df2 = f2 - f0;
+            plane[0] = (df1 * dy2 - df2 * dy1) * invArea;
+            plane[1] = (dx1 * df2 - dx2 * df1) * invArea;
+            plane[2] = f0 - plane[0] * s[0]->x - plane[1] * s[0]->y;
+        };
+        makePlane(s[0]->z, s[1]->z, s[2]->z, tri.z);
+        makePlane(s[0]->invW, s[1]->invW, s[2]->invW, tri.invW);
+        for (uint32_t a = 0; a < AttributeCount; a++) {
+            makePlane(s[0]->attr[a] * s[0]->invW, s[1]->attr[a] * s[1]->invW, s[2]->attr[a] * s[2]->invW, tri.attr[a]);
+        }
+        tri.drawIndex = drawIndex;
+        out.push_back(tri);
+    }
+}
+
+void SoftwareRasterizer::BinTriangles() {
+    const uint32_t tileCount = m_tilesX * m_tilesY;
+    const uint32_t triangleCount = static_cast<uint32_t>(m_triangles.size());
+    const uint32_t chunkCount = (triangleCount + kBinChunkSize - 1) / kBinChunkSize;
+    m_binChunks.resize(chunkCount);
+
+    m_threadPool.ParallelFor(chunkCount, 1, [&](uint32_t begin, uint32_t end) {
+        for (uint32_t chunk = begin; chunk < end; chunk++) {
+            BinChunk& bin = m_binChunks[chunk];
+            bin.tileOffsets.assign(tileCount + 1, 0);
+            uint32_t first = chunk * kBinChunkSize;
+            uint32_t last = std::min(first + kBinChunkSize, triangleCount);
+
+            // Первый проход - подсчет, второй - раскладка (порядок треугольников внутри тайла сохраняется)
+            for (uint32_t i = first; i < last; i++) {
+                const RasterTriangle& tri = m_triangles[i];
+                for (uint32_t ty = tri.minY / m_tileSize; ty <= tri.maxY / m_tileSize; ty++) {
+                    for (uint32_t tx = tri.minX / m_tileSize; tx <= tri.maxX / m_tileSize; tx++) {
+                        bin.tileOffsets[ty * m_tilesX + tx + 1]++;
+                    }
+                }
+            }
+            for (uint32_t t = 0; t < tileCount; t++) {
+                bin.tileOffsets[t + 1] += bin.tileOffsets[t];
+            }
+            bin.triangleIndices.resize(bin.tileOffsets[tileCount]);
+            std::vector<uint32_t> cursor(bin.tileOffsets.begin(), bin.tileOffsets.end() - 1);
+            for (uint32_t i = first; i < last; i++) {
+                const RasterTriangle& tri = m_triangles[i];
+                for (uint32_t ty = tri.minY / m_tileSize; ty <= tri.maxY / m_tileSize; ty++) {
+                    for (uint32_t tx = tri.minX / m_tileSize; tx <= tri.maxX / m_tileSize; tx++) {
+                        bin.triangleIndices[cursor[ty * m_tilesX + tx]++] = i;
+                    }
+                }
+            }
+        }
+    });
+}
+
+void SoftwareRasterizer::EndFrame() {
+    BinTriangles();
+
+    m_threadPool.ParallelFor(m_tilesX * m_tilesY, 1, [this](uint32_t begin, uint32_t end) {
+        for (uint32_t tile = begin; tile < end; tile++) {
+            RasterizeTile(tile);
+        }
+    });
+
+    m_stats.frameCount++;
+    m_stats.triangleCount += m_frameTriangles;
+    m_stats.totalSeconds += NowSeconds() - m_frameStart;
+}
+
+void SoftwareRasterizer::RasterizeTile(uint32_t tileIndex) {
+    const int32_t tileMinX = static_cast<int32_t>((tileIndex % m_tilesX) * m_tileSize);
+    const int32_t tileMinY = static_cast<int32_t>((tileIndex / m_tilesX) * m_tileSize);
+    const int32_t tileMaxX = std::min(tileMinX + static_cast<int32_t>(m_tileSize), static_cast<int32_t>(m_width)) - 1;
+    const int32_t tileMaxY = std::min(tileMinY + static_cast<int32_t>(m_tileSize), static_cast<int32_t>(m_height)) - 1;
+
+    // Очистка (ClearRenderTargetView / ClearDepthStencilView) выполняется потоком, владеющим тайлом
+    for (int32_t y = tileMinY; y <= tileMaxY; y++) {
+        size_t row = static_cast<size_t>(y) * m_width;
+        std::fill(m_color.begin() + row + tileMinX, m_color.begin() + row + tileMaxX + 1, m_clearColor);
+        std::fill(m_depth.begin() + row + tileMinX, m_depth.begin() + row + tileMaxX + 1, 1.0f);
+    }
+
+    for (const BinChunk& bin : m_binChunks) {
+        for (uint32_t k = bin.tileOffsets[tileIndex]; k < bin.tileOffsets[tileIndex + 1]; k++) {
+            RasterizeTriangle(m_triangles[bin.triangleIndices[k]], tileMinX, tileMinY, tileMaxX, tileMaxY);
+        }
+    }
+}
+
+void SoftwareRasterizer::RasterizeTriangle(const RasterTriangle& tri, int32_t tileMinX, int32_t tileMinY, int32_t tileMaxX, int32_t tileMaxY) {
+    const int32_t minX = std::max(tri.minX, tileMinX);
+    const int32_t maxX = std::min(tri.maxX, tileMaxX);
+    const int32_t minY = std::max(tri.minY, tileMinY);
+    const int32_t maxY = std::min(tri.maxY, tileMaxY);
+    const DrawState& draw = m_draws[tri.drawIndex];
+
+    for (int32_t y = minY; y <= maxY; y++) {
+        const float py = y + 0.5f;
+        const float startX = minX + 0.5f;
+        float e0 = PlaneAt(tri.edge[0], startX, py);
+        float e1 = PlaneAt(tri.edge[1], startX, py);
+        float e2 = PlaneAt(tri.edge[2], startX, py);
+        size_t row = static_cast<size_t>(y) * m_width;
+
+        for (int32_t x = minX; x <= maxX; x++, e0 += tri.edge[0][0], e1 += tri.edge[1][0], e2 += tri.edge[2][0]) {
+            bool inside = (e0 > 0.0f || (e0 == 0.0f && tri.topLeft[0])) &&
+                (e1 > 0.0f || (e1 == 0.0f && tri.topLeft[1])) &&
+                (e2 > 0.0f || (e2 == 0.0f && tri.topLeft[2]));
+            if (!inside) {
+                continue;
+            }
+
+            const float px = x + 0.5f;
+            float z = PlaneAt(tri.z, px, py);
+            // Состояние глубины по умолчанию: D3D11_COMPARISON_LESS с записью
+            if (!(z < m_depth[row + x]) || z < 0.0f || z > 1.0f) {
+                continue;
+            }
+
+            float w = 1.0f / PlaneAt(tri.invW, px, py);
+            float attr[AttributeCount];
+            for (uint32_t a = 0; a < AttributeCount; a++) {
+                attr[a] = PlaneAt(tri.attr[a], px, py) * w;
+            }
+
+            m_depth[row + x] = z;
+            m_color[row + x] = ShadePixel(draw, tri, px, py, attr);
+        }
+    }
+}
+
+uint32_t SoftwareRasterizer::ShadePixel(const DrawState& draw, const RasterTriangle& tri, float px, float py, const float* attr) const {
+    if (draw.kind == DrawKind::Skybox) {
+        // pixelSphereShaderCode
+        Float4 c = draw.cubeTexture ? SampleCube(*draw.cubeTexture, attr[0], attr[1], attr[2]) : Float4{ 0.0f, 0.0f, 0.0f, 1.0f };
+        return PackColor(c.x * 0.5f, c.y * 0.5f, c.z * 0.5f, 1.0f);
+    }
+    if (draw.shader == SoftwarePixelShader::Light) {
+        // pixelLightShaderCode
+        return PackColor(1.0f, 1.0f, 1.0f, 1.0f);
+    }
+
+    // Производные uv по экрану (аналог ddx/ddy для выбора mip-уровня)
+    const float u = attr[9], v = attr[10];
+    const float wx = 1.0f / PlaneAt(tri.invW, px + 1.0f, py);
+    const float wy = 1.0f / PlaneAt(tri.invW, px, py + 1.0f);
+    const float dudx = PlaneAt(tri.attr[9], px + 1.0f, py) * wx - u;
+    const float dvdx = PlaneAt(tri.attr[10], px + 1.0f, py) * wx - v;
+    const float dudy = PlaneAt(tri.attr[9], px, py + 1.0f) * wy - u;
+    const float dvdy = PlaneAt(tri.attr[10], px, py + 1.0f) * wy - v;
+
+    // pixelShaderCode
+    Float4 color = draw.colorTexture ? SampleTrilinear(*draw.colorTexture, u, v, dudx, dvdx, dudy, dvdy) : Float4{ 1.0f, 1.0f, 1.0f, 1.0f };
+    Float4 normalSample = draw.normalTexture ? SampleTrilinear(*draw.normalTexture, u, v, dudx, dvdx, dudy, dvdy) : Float4{ 0.5f, 0.5f, 1.0f, 1.0f };
+
+    const float* worldPos = attr;
+    const float* pnorm = attr + 3;
+    const float* ptang = attr + 6;
+
+    float r = m_scene.ambientColor.x * color.x;
+    float g = m_scene.ambientColor.y * color.y;
+    float b = m_scene.ambientColor.z * color.z;
+
+    auto length3 = [](float x, float y, float z) { return std::sqrt(x * x + y * y + z * z); };
+
+    // Нормаль из карты нормалей: binorm = normalize(cross(norm, tang))
+    float bx = pnorm[1] * ptang[2] - pnorm[2] * ptang[1];
+    float by = pnorm[2] * ptang[0] - pnorm[0] * ptang[2];
+    float bz = pnorm[0] * ptang[1] - pnorm[1] * ptang[0];
+    float bl = length3(bx, by, bz);
+    if (bl > 0.0f) { bx /= bl; by /= bl; bz /= bl; }
+    float tl = length3(ptang[0], ptang[1], ptang[2]);
+    float nl = length3(pnorm[0], pnorm[1], pnorm[2]);
+    float tx = tl > 0.0f ? ptang[0] / tl : 0.0f, ty = tl > 0.0f ? ptang[1] / tl : 0.0f, tz = tl > 0.0f ? ptang[2] / tl : 0.0f;
+    float nx = nl > 0.0f ? pnorm[0] / nl : 0.0f, ny = nl > 0.0f ? pnorm[1] / nl : 0.0f, nz = nl > 0.0f ? pnorm[2] / nl : 0.0f;
+    float lx = normalSample.x * 2.0f - 1.0f;
+    float ly = normalSample.y * 2.0f - 1.0f;
+    float lz = normalSample.z * 2.0f - 1.0f;
+    // Как и в шейдере, результат не нормируется
+    float normalX = lx * tx + ly * bx + lz * nx;
+    float normalY = lx * ty + ly * by + lz * ny;
+    float normalZ = lx * tz + ly * bz + lz * nz;
+
+    float vx = m_scene.cameraPos.x - worldPos[0];
+    float vy = m_scene.cameraPos.y - worldPos[1];
+    float vz = m_scene.cameraPos.z - worldPos[2];
+    float vl = length3(vx, vy, vz);
+    if (vl > 0.0f) { vx /= vl; vy /= vl; vz /= vl; }
+
+    const int lightCount = std::min(static_cast<int>(m_scene.lightCount.x), 10);
+    const float shine = m_material.shine.x;
+    for (int i = 0; i < lightCount; i++) {
+        const Light& light = m_scene.lights[i];
+        float ldx = light.pos.x - worldPos[0];
+        float ldy = light.pos.y - worldPos[1];
+        float ldz = light.pos.z - worldPos[2];
+        float dist = length3(ldx, ldy, ldz);
+        ldx /= dist; ldy /= dist; ldz /= dist;
+
+        // Диффузная составляющая
+        float diff = std::max(ldx * normalX + ldy * normalY + ldz * normalZ, 0.0f);
+        r += color.x * diff * light.color.x;
+        g += color.y * diff * light.color.y;
+        b += color.z * diff * light.color.z;
+
+        // Зеркальная составляющая: reflect(-l, n) = 2 * dot(l, n) * n - l
+        float ln = ldx * normalX + ldy * normalY + ldz * normalZ;
+        float rx = 2.0f * ln * normalX - ldx;
+        float ry = 2.0f * ln * normalY - ldy;
+        float rz = 2.0f * ln * normalZ - ldz;
+        float spec = shine > 0.0f ? std::pow(std::max(vx * rx + vy * ry + vz * rz, 0.0f), shine) : 0.0f;
+        r += color.x * spec * light.color.x;
+        g += color.y * spec * light.color.y;
+        b += color.z * spec * light.color.z;
+    }
+
+    return PackColor(r, g, b, 1.0f);
+}
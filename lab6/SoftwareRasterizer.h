@@ -0,0 +1,156 @@
+﻿#pragma once
+
+#include <cstdint>
+#include <vector>
+#include "SceneTypes.h"
+#include "ThreadPool.h"
+
+// Программный (CPU) бэкенд, повторяющий конвейер lab6: вершинный шейдер vertexShaderCode,
+// пиксельные шейдеры pixelShaderCode / pixelLightShaderCode и небесный куб (vertexSphereShaderCode,
+// pixelSphereShaderCode). Треугольники раскладываются по экранным тайлам, тайлы растеризуются
+// параллельно на ThreadPool.
+
+// Текстура в памяти: RGBA8 (R в младшем байте) со всей цепочкой mip-уровней
+struct SoftwareTexture {
+    struct Level {
+        uint32_t width = 0;
+        uint32_t height = 0;
+        std::vector<uint32_t> texels;
+    };
+    std::vector<Level> mips;
+};
+
+// Кубическая текстура, грани в порядке D3D: +X, -X, +Y, -Y, +Z, -Z
+struct SoftwareCubeTexture {
+    SoftwareTexture faces[6];
+};
+
+enum class SoftwarePixelShader {
+    NormalMapped, // pixelShaderCode: текстура + карта нормалей + освещение по SceneBuffer
+    Light,        // pixelLightShaderCode: белый цвет
+};
+
+enum class SoftwareCullMode {
+    None,
+    Back, // как D3D11_CULL_BACK при FrontCounterClockwise = FALSE
+};
+
+struct SoftwareMeshDraw {
+    const TextureTangentVertex* vertices = nullptr;
+    uint32_t vertexCount = 0;
+    const uint16_t* indices = nullptr;
+    uint32_t indexCount = 0;
+    const GeomBuffer* geom = nullptr;
+    SoftwarePixelShader shader = SoftwarePixelShader::NormalMapped;
+    const SoftwareTexture* colorTexture = nullptr;  // t0
+    const SoftwareTexture* normalTexture = nullptr; // t1
+    SoftwareCullMode cullMode = SoftwareCullMode::Back;
+};
+
+struct SoftwareSkyboxDraw {
+    const SphereVertex* vertices = nullptr;
+    uint32_t vertexCount = 0;
+    const uint16_t* indices = nullptr;
+    uint32_t indexCount = 0;
+    const GeomBuffer* geom = nullptr;   // используется только model
+    const SceneBuffer* scene = nullptr; // vp и cameraPos
+    const SoftwareCubeTexture* texture = nullptr;
+};
+
+struct SoftwareRasterizerStats {
+    uint64_t frameCount = 0;
+    uint64_t triangleCount = 0; // треугольники, поданные на вход (до отсечения)
+    double totalSeconds = 0.0;
+
+    double GetFramesPerSecond() const { return totalSeconds > 0.0 ? frameCount / totalSeconds : 0.0; }
+    double GetMTrianglesPerSecond() const { return totalSeconds > 0.0 ? triangleCount / totalSeconds * 1e-6 : 0.0; }
+};
+
+class SoftwareRasterizer {
+public:
+    SoftwareRasterizer(ThreadPool& threadPool, uint32_t width, uint32_t height, uint32_t tileSize = 64);
+
+    // Начало кадра: запоминает константы сцены, очистка буферов выполняется вместе с растеризацией тайлов
+    void BeginFrame(const float clearColor[4], const SceneBuffer& scene, const MaterialBuffer& material);
+    void DrawSkybox(const SoftwareSkyboxDraw& draw);
+    void DrawMesh(const SoftwareMeshDraw& draw);
+    // Раскладка по тайлам и растеризация. После возврата цветовой буфер готов.
+    void EndFrame();
+
+    uint32_t GetWidth() const { return m_width; }
+    uint32_t GetHeight() const { return m_height; }
+    // RGBA8 (совместимо с DXGI_FORMAT_R8G8B8A8_UNORM), строка = width * 4 байт
+    const uint32_t* GetColorBuffer() const { return m_color.data(); }
+    const float* GetDepthBuffer() const { return m_depth.data(); }
+
+    const SoftwareRasterizerStats& GetStats() const { return m_stats; }
+    void ResetStats() { m_stats = SoftwareRasterizerStats(); }
+
+    static const uint32_t AttributeCount = 11; // worldPos(3), norm(3), tang(3), uv(2)
+
+private:
+    enum class DrawKind { Mesh, Skybox };
+
+    struct DrawState {
+        DrawKind kind;
+        SoftwarePixelShader shader;
+        const SoftwareTexture* colorTexture;
+        const SoftwareTexture* normalTexture;
+        const SoftwareCubeTexture* cubeTexture;
+    };
+
+    struct ClipVertex {
+        float pos[4];
+        float attr[AttributeCount];
+    };
+
+    // Подготовленный треугольник: все величины заданы плоскостями f(x, y) = a * x + b * y + c
+    struct RasterTriangle {
+        float edge[3][3];
+        float z[3];
+        float invW[3];
+        float attr[AttributeCount][3]; // attr / w
+        int32_t minX, minY, maxX, maxY;
+        uint8_t topLeft[3];
+        uint32_t drawIndex;
+    };
+
+    // Порция треугольников, разложенная по тайлам (сортировка подсчетом)
+    struct BinChunk {
+        std::vector<uint32_t> tileOffsets;
+        std::vector<uint32_t> triangleIndices;
+    };
+
+    void SetupTriangles(const ClipVertex* vertices, const uint16_t* indices, uint32_t indexCount,
+        SoftwareCullMode cullMode, uint32_t drawIndex);
+    void SetupTriangle(const ClipVertex& v0, const ClipVertex& v1, const ClipVertex& v2,
+        SoftwareCullMode cullMode, uint32_t drawIndex, std::vector<RasterTriangle>& out) const;
+    void BinTriangles();
+    void RasterizeTile(uint32_t tileIndex);
+    void RasterizeTriangle(const RasterTriangle& tri, int32_t tileMinX, int32_t tileMinY, int32_t tileMaxX, int32_t tileMaxY);
+    uint32_t ShadePixel(const DrawState& draw, const RasterTriangle& tri, float px, float py, const float* attr) const;
+
+    ThreadPool& m_threadPool;
+    uint32_t m_width;
+    uint32_t m_height;
+    uint32_t m_tileSize;
+    uint32_t m_tilesX;
+    uint32_t m_tilesY;
+
+    std::vector<uint32_t> m_color;
+    std::vector<float> m_depth;
+    uint32_t m_clearColor = 0;
+
+    SceneBuffer m_scene = {};
+    MaterialBuffer m_material = {};
+
+    std::vector<DrawState> m_draws;
+    std::vector<ClipVertex> m_clipVertices;
+    std::vector<RasterTriangle> m_triangles;
+    std::vector<std::vector<RasterTriangle>> m_setupChunks;
+    std::vector<BinChunk> m_binChunks;
+
+    double m_frameStart = 0.0;
+    uint64_t m_frameTriangles = 0;
+    SoftwareRasterizerStats m_stats;
+};
@@ -0,0 +1,21 @@
+﻿// Точка входа проверок модулей (LabTests.h) для Linux и сборочных машин без GPU и Windows.
+// В Windows те же проверки запускаются из lab6 ключом -test, а здесь файл пустой. Сборка:
+//   g++ -std=c++17 -O2 -I<DirectXMath> TestMain.cpp LabTests.cpp TextureStreamer.cpp TextureCache.cpp
+//       MipGenerator.cpp DdsFile.cpp BlockCompression.cpp CpuFeatures.cpp FileIO.cpp Hash.cpp ThreadPool.cpp FrameProfiler.cpp
+//       ShaderCache.cpp UploadRing.cpp PackedVertex.cpp ReportWriter.cpp -lpthread -o lab6_tests
+// Запуск из каталога с текстурами lab6 (texture.dds, normal_map.dds, space.dds - проверка DdsFile);
+// временные файлы пишутся туда же. Код возврата 0 - все проверки прошли.
+#if !defined(_WIN32)
+
+#include <cstdio>
+
+#include "LabTests.h"
+
+int main() {
+    ReportWriter report;
+    const bool passed = RunLabTests(report);
+    fputs(report.GetText().c_str(), stdout);
+    return passed ? 0 : 1;
+}
+
+#endif
@@ -0,0 +1,124 @@
+﻿#include "TextureCache.h"
+#include "Hash.h"
+
+#include <cstring>
+#include <iterator>
+
+TextureCache::TextureCache(ThreadPool* pThreadPool)
+    : m_pThreadPool(pThreadPool) {
+}
+
+std::shared_ptr<TextureData> TextureCache::FindLocked(const std::wstring& filePath, const TextureData* pCandidate) {
+    auto pathIt = m_byPath.find(filePath);
+    if (pathIt != m_byPath.end()) {
+        if (std::shared_ptr<TextureData> pData = pathIt->second.lock()) {
+            m_stats.pathHits++;
+            m_stats.bytesSaved += pData->GetMemorySize();
+            return pData;
+        }
+    }
+    if (!pCandidate) {
+        return nullptr;
+    }
+
+    // Тот же хеш - сравниваем байты, чтобы коллизия не подменила текстуру
+    const DdsFile& file = pCandidate->m_file;
+    auto range = m_byContent.equal_range(pCandidate->m_contentHash);
+    for (auto it = range.first; it != range.second; ++it) {
+        std::shared_ptr<TextureData> pExisting = it->second.lock();
+        if (pExisting && pExisting->m_file.GetFileSize() == file.GetFileSize() &&
+            memcmp(pExisting->m_file.GetFileData(), file.GetFileData(), file.GetFileSize()) == 0) {
+            m_stats.contentHits++;
+            m_stats.bytesSaved += pExisting->GetMemorySize();
+            m_byPath[filePath] = pExisting;
+            return pExisting;
+        }
+    }
+    return nullptr;
+}
+
+std::shared_ptr<TextureData> TextureCache::Load(const std::wstring& filePath) {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (std::shared_ptr<TextureData> pData = FindLocked(filePath, nullptr)) {
+            return pData;
+        }
+    }
+
+    // Открытие, хеширование и достраивание mip-уровней идут без блокировки,
+    // чтобы несколько потоков могли загружать разные файлы одновременно
+    std::shared_ptr<TextureData> pData = std::make_shared<TextureData>();
+    if (!pData->m_file.Open(filePath)) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_error = pData->m_file.GetErrorMessage();
+        return nullptr;
+    }
+    const DdsFile& file = pData->m_file;
+    pData->m_path = filePath;
+    pData->m_contentHash = Hash64(file.GetFileData(), file.GetFileSize());
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (std::shared_ptr<TextureData> pExisting = FindLocked(filePath, pData.get())) {
+            return pExisting; // отображение нового файла закроется вместе с pData
+        }
+    }
+
+    pData->m_memorySize = file.GetFileSize();
+    if (file.GetMipLevels() < GetFullMipCount(file.GetWidth(), file.GetHeight())) {
+        MipGenerationOptions options;
+        options.filter = MipFilter::Kaiser;
+        options.gammaCorrect = IsSrgbFormat(file.GetFormat());
+        // Формат без декодера остается со своими уровнями из файла
+        if (pData->m_mipChain.Generate(file, 0, options, m_pThreadPool)) {
+            for (uint32_t mip = 0; mip < pData->m_mipChain.GetMipLevels(); mip++) {
+                pData->m_memorySize += pData->m_mipChain.GetSubresource(mip).size;
+            }
+        }
+    }
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    // Пока достраивались уровни, ту же текстуру мог загрузить другой поток
+    if (std::shared_ptr<TextureData> pExisting = FindLocked(filePath, pData.get())) {
+        return pExisting;
+    }
+    Prune();
+    m_stats.misses++;
+    m_stats.bytesLoaded += pData->m_memorySize;
+    m_byPath[filePath] = pData;
+    m_byContent.emplace(pData->m_contentHash, pData);
+    return pData;
+}
+
+void TextureCache::Prune() {
+    for (auto it = m_byPath.begin(); it != m_byPath.end();) {
+        it = it->second.expired() ? m_byPath.erase(it) : std::next(it);
+    }
+    for (auto it = m_byContent.begin(); it != m_byContent.end();) {
+        it = it->second.expired() ? m_byContent.erase(it) : std::next(it);
+    }
+}
+
+std::string TextureCache::GetErrorMessage() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_error;
+}
+
+TextureCacheStats TextureCache::GetStats() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_stats;
+}
+
+void TextureCache::ResetStats() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_stats = TextureCacheStats();
+}
+
+size_t TextureCache::GetLiveCount() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    size_t count = 0;
+    for (const auto& entry : m_byContent) {
+        count += entry.second.expired() ? 0 : 1;
+    }
+    return count;
+}
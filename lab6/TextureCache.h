@@ -0,0 +1,85 @@
+﻿#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "DdsFile.h"
+#include "MipGenerator.h"
+
+class ThreadPool;
+
+// Кэш текстур с адресацией по содержимому. Повторная загрузка того же пути отдает уже
+// загруженные данные без открытия файла; файл с другим путем, но тем же содержимым
+// (совпал хеш и байты) тоже не хранится второй раз. Данные общие и живут, пока на них
+// есть ссылки: кэш держит только слабые ссылки и не продлевает им жизнь.
+
+// Загруженная текстура: отображение файла и, если в файле неполная mip-цепочка, достроенные уровни
+class TextureData {
+public:
+    const std::wstring& GetPath() const { return m_path; }
+    uint64_t GetContentHash() const { return m_contentHash; }
+
+    uint32_t GetWidth() const { return m_file.GetWidth(); }
+    uint32_t GetHeight() const { return m_file.GetHeight(); }
+    uint32_t GetArraySize() const { return m_file.GetArraySize(); }
+    // С учетом достроенной цепочки
+    uint32_t GetMipLevels() const { return m_mipChain.IsEmpty() ? m_file.GetMipLevels() : m_mipChain.GetMipLevels(); }
+    uint32_t GetFormat() const { return m_mipChain.IsEmpty() ? m_file.GetFormat() : m_mipChain.GetFormat(); }
+    const DdsSubresource& GetSubresource(uint32_t mip) const {
+        return m_mipChain.IsEmpty() ? m_file.GetSubresource(mip) : m_mipChain.GetSubresource(mip);
+    }
+    // Байт в памяти процесса: отображение файла и достроенные уровни
+    size_t GetMemorySize() const { return m_memorySize; }
+
+private:
+    friend class TextureCache;
+
+    std::wstring m_path;
+    uint64_t m_contentHash = 0;
+    DdsFile m_file;
+    MipChain m_mipChain;
+    size_t m_memorySize = 0;
+};
+
+struct TextureCacheStats {
+    uint64_t pathHits = 0;      // тот же путь уже загружен
+    uint64_t contentHits = 0;   // другой путь, то же содержимое
+    uint64_t misses = 0;        // файл загружен заново
+    uint64_t bytesLoaded = 0;   // байт в загруженных текстурах
+    uint64_t bytesSaved = 0;    // байт, которые заняли бы повторные копии
+};
+
+class TextureCache {
+public:
+    // pThreadPool - для достраивания mip-цепочек; может быть nullptr
+    explicit TextureCache(ThreadPool* pThreadPool = nullptr);
+
+    TextureCache(const TextureCache&) = delete;
+    TextureCache& operator=(const TextureCache&) = delete;
+
+    // nullptr, если файл не открылся или не разобрался (причина - в GetErrorMessage).
+    // Можно вызывать из нескольких потоков.
+    std::shared_ptr<TextureData> Load(const std::wstring& filePath);
+    std::string GetErrorMessage() const;
+
+    TextureCacheStats GetStats() const;
+    void ResetStats();
+    // Число живых текстур в кэше
+    size_t GetLiveCount() const;
+
+private:
+    // Поиск по пути, затем (если задан pCandidate) по содержимому; вызывается под m_mutex
+    std::shared_ptr<TextureData> FindLocked(const std::wstring& filePath, const TextureData* pCandidate);
+    void Prune();
+
+    ThreadPool* m_pThreadPool = nullptr;
+    mutable std::mutex m_mutex;
+    std::unordered_map<std::wstring, std::weak_ptr<TextureData>> m_byPath;
+    std::unordered_multimap<uint64_t, std::weak_ptr<TextureData>> m_byContent;
+    TextureCacheStats m_stats;
+    std::string m_error;
+};
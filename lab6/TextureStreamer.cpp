@@ -0,0 +1,234 @@
+﻿#include "TextureStreamer.h"
+#include "TextureCache.h"
+#include "ThreadPool.h"
+
+#include <functional>
+#include <queue>
+
+namespace {
+
+// Чтение по байту со страницы: для отображенного файла это подкачка страниц с диска
+// в фоновом потоке, чтобы загрузка на устройство в потоке рендера не ждала ввода-вывода
+void TouchPages(const uint8_t* pData, size_t size) {
+    const size_t pageSize = 4096;
+    uint8_t sum = 0;
+    for (size_t offset = 0; offset < size; offset += pageSize) {
+        sum ^= pData[offset];
+    }
+    volatile uint8_t sink = sum;
+    (void)sink;
+}
+
+} // namespace
+
+TextureStreamer::TextureStreamer(TextureCache& textureCache, ITextureUploadTarget& target, uint64_t uploadBudget, unsigned ioThreadCount)
+    : m_textureCache(textureCache)
+    , m_target(target)
+    , m_uploadBudget(uploadBudget)
+    , m_pIoPool(std::make_unique<ThreadPool>(ioThreadCount > 0 ? ioThreadCount : 1)) {
+}
+
+TextureStreamer::~TextureStreamer() {
+    // Фоновые задачи ссылаются на записи - дожидаемся их до разрушения m_entries
+    m_pIoPool->Wait();
+}
+
+uint32_t TextureStreamer::Request(const std::wstring& filePath) {
+    return AddEntry(&filePath, 1, false);
+}
+
+uint32_t TextureStreamer::RequestCube(const std::wstring facePaths[6]) {
+    return AddEntry(facePaths, 6, true);
+}
+
+uint32_t TextureStreamer::AddEntry(const std::wstring* pPaths, uint32_t count, bool cubemap) {
+    std::wstring key = cubemap ? L"cube:" : L"";
+    for (uint32_t i = 0; i < count; i++) {
+        key += (i > 0 ? L"|" : L"") + pPaths[i];
+    }
+    auto it = m_handles.find(key);
+    if (it != m_handles.end()) {
+        return it->second;
+    }
+
+    const uint32_t handle = static_cast<uint32_t>(m_entries.size());
+    m_entries.push_back(std::make_unique<Entry>());
+    Entry* pEntry = m_entries.back().get();
+    pEntry->paths.assign(pPaths, pPaths + count);
+    pEntry->cubemap = cubemap;
+    m_handles.emplace(key, handle);
+    m_stats.requested++;
+
+    m_pIoPool->Submit([this, pEntry] { LoadEntry(*pEntry); });
+    return handle;
+}
+
+void TextureStreamer::LoadEntry(Entry& entry) {
+    entry.items.reserve(entry.paths.size());
+    for (const std::wstring& path : entry.paths) {
+        std::shared_ptr<TextureData> pData = m_textureCache.Load(path);
+        if (!pData) {
+            entry.items.clear();
+            entry.state.store(State::Failed, std::memory_order_release);
+            return;
+        }
+        const TextureData& first = entry.items.empty() ? *pData : *entry.items[0];
+        if (pData->GetWidth() != first.GetWidth() || pData->GetHeight() != first.GetHeight() ||
+            pData->GetFormat() != first.GetFormat() || pData->GetMipLevels() != first.GetMipLevels()) {
+            entry.items.clear();
+            entry.state.store(State::Failed, std::memory_order_release);
+            return;
+        }
+        entry.items.push_back(std::move(pData));
+    }
+
+    const uint32_t mipLevels = entry.items[0]->GetMipLevels();
+    entry.readyMip.store(mipLevels, std::memory_order_relaxed);
+    entry.state.store(State::Ready, std::memory_order_release);
+
+    // Хвост цепочки читается первым - его загрузят на устройство раньше всего
+    for (uint32_t mip = mipLevels; mip-- > 0;) {
+        for (size_t i = 0; i < entry.items.size(); i++) {
+            // Грани с общими данными (один и тот же файл) читаются один раз
+            if (i > 0 && entry.items[i] == entry.items[i - 1]) {
+                continue;
+            }
+            const DdsSubresource& sub = entry.items[i]->GetSubresource(mip);
+            TouchPages(sub.pData, sub.size);
+        }
+        entry.readyMip.store(mip, std::memory_order_release);
+    }
+}
+
+bool TextureStreamer::PrepareEntry(Entry& entry, uint32_t handle) {
+    if (entry.created) {
+        // Данные текстуры, которую не удалось создать, освобождаются, когда поток ввода-вывода дочитал их
+        if (entry.mipLevels == 0 && !entry.items.empty() && entry.readyMip.load(std::memory_order_acquire) == 0) {
+            entry.items.clear();
+        }
+        return entry.residentMip > 0;
+    }
+
+    const State state = entry.state.load(std::memory_order_acquire);
+    if (state == State::Loading) {
+        return false;
+    }
+    if (state == State::Ready) {
+        const TextureData& first = *entry.items[0];
+        entry.mipLevels = first.GetMipLevels();
+        if (m_target.CreateTexture(handle, first.GetWidth(), first.GetHeight(), entry.mipLevels,
+            static_cast<uint32_t>(entry.items.size()), entry.cubemap, first.GetFormat())) {
+            entry.created = true;
+            entry.residentMip = entry.mipLevels;
+            m_stats.loaded++;
+            return true;
+        }
+        // Состояние Ready публикуется до чтения страниц, и поток ввода-вывода может еще обходить items
+        if (entry.readyMip.load(std::memory_order_acquire) == 0) {
+            entry.items.clear();
+        }
+        entry.state.store(State::Failed, std::memory_order_relaxed);
+    }
+
+    // Ошибка учитывается один раз: запись переходит в created без уровней
+    entry.created = true;
+    entry.mipLevels = 0;
+    entry.residentMip = 0;
+    m_stats.failed++;
+    return false;
+}
+
+void TextureStreamer::Upload(uint64_t budget) {
+    // Очередь по размеру следующего уровня: маленькие уровни всех текстур раньше крупных
+    struct Pending {
+        size_t size;
+        uint32_t handle;
+        bool operator>(const Pending& other) const { return size > other.size || (size == other.size && handle > other.handle); }
+    };
+    std::priority_queue<Pending, std::vector<Pending>, std::greater<Pending>> queue;
+
+    auto pushNext = [this, &queue](uint32_t handle) {
+        Entry& entry = *m_entries[handle];
+        if (entry.residentMip == 0) {
+            return;
+        }
+        const uint32_t mip = entry.residentMip - 1;
+        if (mip < entry.readyMip.load(std::memory_order_acquire)) {
+            return; // уровень еще читается с диска
+        }
+        queue.push(Pending{ entry.items[entry.nextItem]->GetSubresource(mip).size, handle });
+    };
+
+    for (uint32_t handle = 0; handle < m_entries.size(); handle++) {
+        if (PrepareEntry(*m_entries[handle], handle)) {
+            pushNext(handle);
+        }
+    }
+
+    uint64_t spent = 0;
+    while (!queue.empty()) {
+        const Pending next = queue.top();
+        if (spent > 0 && spent + next.size > budget) {
+            break;
+        }
+        queue.pop();
+
+        Entry& entry = *m_entries[next.handle];
+        const uint32_t mip = entry.residentMip - 1;
+        m_target.UploadMip(next.handle, entry.nextItem, mip, entry.items[entry.nextItem]->GetSubresource(mip));
+        spent += next.size;
+        m_stats.bytesUploaded += next.size;
+        m_stats.uploadCount++;
+
+        // Уровень становится доступным, когда загружены все его грани
+        if (++entry.nextItem == entry.items.size()) {
+            entry.nextItem = 0;
+            entry.residentMip = mip;
+            m_target.SetMostDetailedMip(next.handle, mip);
+            if (mip == 0) {
+                // Все уровни на устройстве - данные в памяти больше не нужны
+                entry.items.clear();
+                m_stats.fullyResident++;
+                continue;
+            }
+        }
+        pushNext(next.handle);
+    }
+}
+
+void TextureStreamer::Update() {
+    Upload(m_uploadBudget);
+}
+
+void TextureStreamer::Flush() {
+    m_pIoPool->Wait();
+    Upload(UINT64_MAX);
+}
+
+bool TextureStreamer::IsCreated(uint32_t handle) const {
+    return handle < m_entries.size() && m_entries[handle]->created && m_entries[handle]->mipLevels > 0;
+}
+
+bool TextureStreamer::HasFailed(uint32_t handle) const {
+    return handle >= m_entries.size() || m_entries[handle]->state.load(std::memory_order_acquire) == State::Failed;
+}
+
+uint32_t TextureStreamer::GetMostDetailedMip(uint32_t handle) const {
+    if (!IsCreated(handle)) {
+        return InvalidHandle;
+    }
+    return m_entries[handle]->residentMip;
+}
+
+bool TextureStreamer::IsFullyResident(uint32_t handle) const {
+    return IsCreated(handle) && m_entries[handle]->residentMip == 0;
+}
+
+bool TextureStreamer::IsIdle() const {
+    for (const auto& pEntry : m_entries) {
+        if (!pEntry->created || (pEntry->mipLevels > 0 && pEntry->residentMip > 0)) {
+            return false;
+        }
+    }
+    return true;
+}
@@ -0,0 +1,113 @@
+﻿#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "DdsFile.h"
+
+class TextureCache;
+class TextureData;
+class ThreadPool;
+
+// Потоковая загрузка текстур. Файлы открываются и читаются в фоновом пуле ввода-вывода,
+// а на устройство уровни попадают в Update() раз в кадр: сначала самые маленькие mip-уровни
+// всех текстур, затем все более крупные, не больше бюджета байт за кадр. Текстура создается
+// сразу со всеми уровнями, а сэмплировать разрешается только уже загруженный хвост цепочки,
+// поэтому первый кадр рисуется сразу с размытыми текстурами, которые затем уточняются.
+
+// Устройство, на которое идет загрузка. Рендер реализует его поверх D3D11; без устройства
+// (например, для проверки порядка загрузки) достаточно реализации, которая записывает вызовы.
+class ITextureUploadTarget {
+public:
+    virtual ~ITextureUploadTarget() = default;
+
+    // Пустая текстура со всеми уровнями; arraySize == 6 и cubemap - куб. false - ошибка устройства.
+    virtual bool CreateTexture(uint32_t handle, uint32_t width, uint32_t height, uint32_t mipLevels,
+        uint32_t arraySize, bool cubemap, uint32_t format) = 0;
+    // Загрузка одного уровня одного элемента массива (грани куба)
+    virtual void UploadMip(uint32_t handle, uint32_t item, uint32_t mip, const DdsSubresource& data) = 0;
+    // Сэмплировать можно уровни [mip, mipLevels)
+    virtual void SetMostDetailedMip(uint32_t handle, uint32_t mip) = 0;
+};
+
+struct TextureStreamerStats {
+    uint32_t requested = 0;      // разных текстур запрошено
+    uint32_t loaded = 0;         // файлы прочитаны, текстура создана на устройстве
+    uint32_t fullyResident = 0;  // загружены все уровни
+    uint32_t failed = 0;
+    uint64_t bytesUploaded = 0;
+    uint64_t uploadCount = 0;
+};
+
+class TextureStreamer {
+public:
+    static const uint32_t InvalidHandle = 0xFFFFFFFF;
+
+    // uploadBudget - байт на кадр; за кадр всегда загружается хотя бы один уровень
+    TextureStreamer(TextureCache& textureCache, ITextureUploadTarget& target, uint64_t uploadBudget, unsigned ioThreadCount = 2);
+    ~TextureStreamer();
+
+    TextureStreamer(const TextureStreamer&) = delete;
+    TextureStreamer& operator=(const TextureStreamer&) = delete;
+
+    // Запрос обычной текстуры; повторный запрос того же файла возвращает тот же дескриптор
+    uint32_t Request(const std::wstring& filePath);
+    // Куб из шести файлов-граней (+X, -X, +Y, -Y, +Z, -Z); грани должны совпадать по размеру и формату
+    uint32_t RequestCube(const std::wstring facePaths[6]);
+
+    // Раз в кадр на потоке рендера: создание текстур и загрузка уровней в пределах бюджета
+    void Update();
+    // Дождаться чтения всех файлов и загрузить все уровни без ограничения бюджета
+    void Flush();
+
+    bool IsCreated(uint32_t handle) const;
+    bool HasFailed(uint32_t handle) const;
+    // Самый детальный загруженный уровень: mipLevels, пока не загружено ничего; InvalidHandle, пока текстура не создана
+    uint32_t GetMostDetailedMip(uint32_t handle) const;
+    bool IsFullyResident(uint32_t handle) const;
+    // Все запросы обработаны: текстуры загружены полностью или с ошибкой
+    bool IsIdle() const;
+
+    const TextureStreamerStats& GetStats() const { return m_stats; }
+
+private:
+    enum class State {
+        Loading,  // файлы читаются в фоне
+        Ready,    // данные в памяти, хвост цепочки от readyMip прочитан
+        Failed,
+    };
+
+    struct Entry {
+        std::vector<std::wstring> paths;
+        bool cubemap = false;
+
+        // Пишутся потоком ввода-вывода, публикуются через state / readyMip
+        std::vector<std::shared_ptr<TextureData>> items;
+        std::atomic<State> state{ State::Loading };
+        std::atomic<uint32_t> readyMip{ 0xFFFFFFFF }; // уровни [readyMip, mipLevels) уже в памяти
+
+        // Только поток рендера
+        bool created = false;
+        uint32_t mipLevels = 0;
+        uint32_t residentMip = 0; // самый детальный загруженный уровень
+        uint32_t nextItem = 0;    // следующая грань уровня residentMip - 1
+    };
+
+    uint32_t AddEntry(const std::wstring* pPaths, uint32_t count, bool cubemap);
+    void LoadEntry(Entry& entry);
+    // Создать текстуру, если данные готовы; false - ждать или ошибка
+    bool PrepareEntry(Entry& entry, uint32_t handle);
+    void Upload(uint64_t budget);
+
+    TextureCache& m_textureCache;
+    ITextureUploadTarget& m_target;
+    uint64_t m_uploadBudget = 0;
+    std::unique_ptr<ThreadPool> m_pIoPool;
+
+    std::vector<std::unique_ptr<Entry>> m_entries;
+    std::unordered_map<std::wstring, uint32_t> m_handles;
+    TextureStreamerStats m_stats;
+};
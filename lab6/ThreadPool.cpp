@@ -0,0 +1,170 @@
+﻿#include "ThreadPool.h"
+#include "FrameProfiler.h"
+
+ThreadPool::ThreadPool(unsigned threadCount) {
+    if (threadCount == 0) {
+        threadCount = std::thread::hardware_concurrency();
+    }
+    if (threadCount == 0) {
+        threadCount = 1;
+    }
+
+    // Последняя очередь принадлежит внешним потокам, которые вызывают Submit/Wait
+    for (unsigned i = 0; i <= threadCount; i++) {
+        m_queues.push_back(std::make_unique<WorkQueue>());
+    }
+    for (unsigned i = 0; i < threadCount; i++) {
+        m_workers.emplace_back(&ThreadPool::WorkerLoop, this, i);
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    Wait();
+    {
+        std::lock_guard<std::mutex> lock(m_wakeMutex);
+        m_stop = true;
+    }
+    m_wakeCondition.notify_all();
+    for (auto& worker : m_workers) {
+        worker.join();
+    }
+}
+
+void ThreadPool::Submit(std::function<void()> task) {
+    // Раскладываем задачи по очередям по кругу, дальше потоки сами перераспределят их воровством
+    unsigned index = m_nextQueue.fetch_add(1, std::memory_order_relaxed) % static_cast<unsigned>(m_workers.size());
+    m_pending.fetch_add(1, std::memory_order_acq_rel);
+    {
+        std::lock_guard<std::mutex> lock(m_queues[index]->mutex);
+        m_queues[index]->tasks.push_back(std::move(task));
+        m_queued.fetch_add(1, std::memory_order_release);
+    }
+    {
+        // Захват мьютекса исключает потерю пробуждения между проверкой и ожиданием в WorkerLoop
+        std::lock_guard<std::mutex> lock(m_wakeMutex);
+    }
+    m_wakeCondition.notify_one();
+}
+
+bool ThreadPool::PopTask(unsigned queueIndex, std::function<void()>& task) {
+    WorkQueue& queue = *m_queues[queueIndex];
+    std::lock_guard<std::mutex> lock(queue.mutex);
+    if (queue.tasks.empty()) {
+        return false;
+    }
+    // Свои задачи берем с конца (LIFO) - они горячие в кэше
+    task = std::move(queue.tasks.back());
+    queue.tasks.pop_back();
+    m_queued.fetch_sub(1, std::memory_order_relaxed);
+    return true;
+}
+
+bool ThreadPool::StealTask(unsigned thiefIndex, std::function<void()>& task) {
+    const unsigned queueCount = static_cast<unsigned>(m_queues.size());
+    for (unsigned i = 1; i < queueCount; i++) {
+        WorkQueue& queue = *m_queues[(thiefIndex + i) % queueCount];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        if (!queue.tasks.empty()) {
+            // Чужие задачи берем с начала (FIFO), чтобы меньше мешать владельцу
+            task = std::move(queue.tasks.front());
+            queue.tasks.pop_front();
+            m_queued.fetch_sub(1, std::memory_order_relaxed);
+            return true;
+        }
+    }
+    return false;
+}
+
+void ThreadPool::RunTask(std::function<void()>& task) {
+    {
+        // Задачи пула видны в трассе кадра на дорожках своих потоков
+        ProfileZone zone("ThreadPool task");
+        task();
+    }
+    task = nullptr;
+    if (m_pending.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+        std::lock_guard<std::mutex> lock(m_wakeMutex);
+        m_doneCondition.notify_all();
+    }
+}
+
+void ThreadPool::WorkerLoop(unsigned index) {
+    std::function<void()> task;
+    for (;;) {
+        if (PopTask(index, task) || StealTask(index, task)) {
+            RunTask(task);
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(m_wakeMutex);
+        if (m_stop) {
+            return;
+        }
+        // Спим, пока в очередях нет задач (выполняемые другими потоками не в счет)
+        m_wakeCondition.wait(lock, [this] { return m_stop || m_queued.load(std::memory_order_acquire) != 0; });
+    }
+}
+
+void ThreadPool::Wait() {
+    const unsigned externalQueue = static_cast<unsigned>(m_queues.size()) - 1;
+    std::function<void()> task;
+    while (m_pending.load(std::memory_order_acquire) != 0) {
+        if (StealTask(externalQueue, task)) {
+            RunTask(task);
+            continue;
+        }
+
+        // Остались только задачи, которые уже выполняются другими потоками
+        std::unique_lock<std::mutex> lock(m_wakeMutex);
+        m_doneCondition.wait(lock, [this] { return m_pending.load(std::memory_order_acquire) == 0; });
+    }
+}
+
+void ThreadPool::ParallelFor(uint32_t count, uint32_t grainSize, const std::function<void(uint32_t begin, uint32_t end)>& fn) {
+    if (count == 0) {
+        return;
+    }
+    if (grainSize == 0) {
+        grainSize = 1;
+    }
+    if (count <= grainSize || m_workers.size() <= 1) {
+        fn(0, count);
+        return;
+    }
+
+    // Отдельный счетчик, чтобы ParallelFor можно было вызывать параллельно с другими задачами
+    struct Batch {
+        std::atomic<uint32_t> remaining{ 0 };
+        std::mutex mutex;
+        std::condition_variable done;
+    };
+    auto batch = std::make_shared<Batch>();
+    const uint32_t chunkCount = (count + grainSize - 1) / grainSize;
+    batch->remaining = chunkCount;
+
+    // Первую порцию выполняем сами, остальные раздаем пулу
+    for (uint32_t chunk = 1; chunk < chunkCount; chunk++) {
+        uint32_t begin = chunk * grainSize;
+        uint32_t end = begin + grainSize < count ? begin + grainSize : count;
+        Submit([batch, begin, end, &fn] {
+            fn(begin, end);
+            if (batch->remaining.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+                std::lock_guard<std::mutex> lock(batch->mutex);
+                batch->done.notify_all();
+            }
+        });
+    }
+    fn(0, grainSize < count ? grainSize : count);
+    batch->remaining.fetch_sub(1, std::memory_order_acq_rel);
+
+    const unsigned externalQueue = static_cast<unsigned>(m_queues.size()) - 1;
+    std::function<void()> task;
+    while (batch->remaining.load(std::memory_order_acquire) != 0) {
+        if (StealTask(externalQueue, task)) {
+            RunTask(task);
+            continue;
+        }
+        std::unique_lock<std::mutex> lock(batch->mutex);
+        batch->done.wait(lock, [&batch] { return batch->remaining.load(std::memory_order_acquire) == 0; });
+    }
+}
@@ -0,0 +1,57 @@
+﻿#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Пул потоков с перехватом работы (work stealing): у каждого потока своя очередь,
+// свободный поток сначала берет задачи из своей очереди, затем ворует у соседей.
+class ThreadPool {
+public:
+    // threadCount == 0 - по числу аппаратных потоков
+    explicit ThreadPool(unsigned threadCount = 0);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    unsigned GetThreadCount() const { return static_cast<unsigned>(m_workers.size()); }
+
+    // Поставить задачу в очередь (без ожидания)
+    void Submit(std::function<void()> task);
+
+    // Дождаться выполнения всех поставленных задач. Вызывающий поток помогает их выполнять.
+    void Wait();
+
+    // Вызвать fn(i) для i из [0, count), разбив диапазон на порции по grainSize.
+    // Возвращает управление, когда все итерации выполнены.
+    void ParallelFor(uint32_t count, uint32_t grainSize, const std::function<void(uint32_t begin, uint32_t end)>& fn);
+
+private:
+    struct WorkQueue {
+        std::mutex mutex;
+        std::deque<std::function<void()>> tasks;
+    };
+
+    bool PopTask(unsigned queueIndex, std::function<void()>& task);
+    bool StealTask(unsigned thiefIndex, std::function<void()>& task);
+    void RunTask(std::function<void()>& task);
+    void WorkerLoop(unsigned index);
+
+    std::vector<std::unique_ptr<WorkQueue>> m_queues;
+    std::vector<std::thread> m_workers;
+
+    std::mutex m_wakeMutex;
+    std::condition_variable m_wakeCondition;
+    std::condition_variable m_doneCondition;
+    std::atomic<uint32_t> m_pending{ 0 }; // поставлены, но еще не выполнены
+    std::atomic<uint32_t> m_queued{ 0 };  // лежат в очередях
+    std::atomic<uint32_t> m_nextQueue{ 0 };
+    bool m_stop = false;
+};
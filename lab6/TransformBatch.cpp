@@ -0,0 +1,435 @@
+﻿#include "TransformBatch.h"
+#include "ThreadPool.h"
+
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <random>
+
+#if defined(_M_X64) || defined(__x86_64__) || defined(__SSE2__) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define TRANSFORM_HAS_SSE2 1
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#define TRANSFORM_TARGET_AVX2
+#else
+#define TRANSFORM_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+#else
+#define TRANSFORM_HAS_SSE2 0
+#endif
+
+namespace {
+
+const size_t kInstanceStride = sizeof(InstanceData) / sizeof(float);
+const size_t kMatrixStride = sizeof(DirectX::XMMATRIX) / sizeof(float);
+
+// Поворот из кватерниона - строки как у XMMatrixRotationQuaternion. Порядок операций один во всех
+// путях - результаты совпадают.
+void ComputeTransformsScalar(const TransformStreams& streams, uint32_t begin, uint32_t count, const DirectX::XMFLOAT4X4& vp,
+    InstanceData* pInstances, DirectX::XMMATRIX* pWorldViewProjection) {
+    for (uint32_t i = begin; i < count; i++) {
+        const float x = streams.rotationX[i];
+        const float y = streams.rotationY[i];
+        const float z = streams.rotationZ[i];
+        const float w = streams.rotationW[i];
+        const float x2 = x + x;
+        const float y2 = y + y;
+        const float z2 = z + z;
+        const float xx = x * x2, yy = y * y2, zz = z * z2;
+        const float xy = x * y2, xz = x * z2, yz = y * z2;
+        const float wx = w * x2, wy = w * y2, wz = w * z2;
+        const float rotation[3][3] = {
+            { 1.0f - (yy + zz), xy + wz, xz - wy },
+            { xy - wz, 1.0f - (xx + zz), yz + wx },
+            { xz + wy, yz - wx, 1.0f - (xx + yy) },
+        };
+        const float s = streams.scale[i];
+        const float inverseScale = 1.0f / s;
+        const float t[3] = { streams.positionX[i], streams.positionY[i], streams.positionZ[i] };
+
+        DirectX::XMFLOAT4X4 world;
+        DirectX::XMFLOAT4X4 normal;
+        for (int row = 0; row < 3; row++) {
+            for (int column = 0; column < 3; column++) {
+                world.m[row][column] = rotation[row][column] * s;
+                normal.m[row][column] = rotation[row][column] * inverseScale;
+            }
+            world.m[row][3] = 0.0f;
+            normal.m[row][3] = 0.0f;
+        }
+        world.m[3][0] = t[0];
+        world.m[3][1] = t[1];
+        world.m[3][2] = t[2];
+        world.m[3][3] = 1.0f;
+        normal.m[3][0] = 0.0f;
+        normal.m[3][1] = 0.0f;
+        normal.m[3][2] = 0.0f;
+        normal.m[3][3] = 1.0f;
+        pInstances[i].model = DirectX::XMLoadFloat4x4(&world);
+        pInstances[i].normalMatrix = DirectX::XMLoadFloat4x4(&normal);
+
+        if (pWorldViewProjection) {
+            DirectX::XMFLOAT4X4 mvp;
+            for (int row = 0; row < 3; row++) {
+                for (int column = 0; column < 4; column++) {
+                    mvp.m[row][column] = (world.m[row][0] * vp.m[0][column] + world.m[row][1] * vp.m[1][column]) + world.m[row][2] * vp.m[2][column];
+                }
+            }
+            for (int column = 0; column < 4; column++) {
+                mvp.m[3][column] = ((t[0] * vp.m[0][column] + t[1] * vp.m[1][column]) + t[2] * vp.m[2][column]) + vp.m[3][column];
+            }
+            pWorldViewProjection[i] = DirectX::XMLoadFloat4x4(&mvp);
+        }
+    }
+}
+
+#if TRANSFORM_HAS_SSE2
+
+// Строка матрицы четырех объектов: столбцы c0..c3 по дорожкам -> по строке на объект
+inline void StoreRows4(float* pFirst, size_t stride, __m128 c0, __m128 c1, __m128 c2, __m128 c3) {
+    _MM_TRANSPOSE4_PS(c0, c1, c2, c3);
+    _mm_storeu_ps(pFirst, c0);
+    _mm_storeu_ps(pFirst + stride, c1);
+    _mm_storeu_ps(pFirst + 2 * stride, c2);
+    _mm_storeu_ps(pFirst + 3 * stride, c3);
+}
+
+inline __m128 TransformColumnSse2(__m128 a, __m128 b, __m128 c, const DirectX::XMFLOAT4X4& vp, int column) {
+    return _mm_add_ps(_mm_add_ps(_mm_mul_ps(a, _mm_set1_ps(vp.m[0][column])), _mm_mul_ps(b, _mm_set1_ps(vp.m[1][column]))),
+        _mm_mul_ps(c, _mm_set1_ps(vp.m[2][column])));
+}
+
+void ComputeTransformsSse2(const TransformStreams& streams, uint32_t count, const DirectX::XMFLOAT4X4& vp,
+    InstanceData* pInstances, DirectX::XMMATRIX* pWorldViewProjection) {
+    const uint32_t blockEnd = count & ~3u;
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 one = _mm_set1_ps(1.0f);
+    for (uint32_t i = 0; i < blockEnd; i += 4) {
+        const __m128 x = _mm_loadu_ps(streams.rotationX + i);
+        const __m128 y = _mm_loadu_ps(streams.rotationY + i);
+        const __m128 z = _mm_loadu_ps(streams.rotationZ + i);
+        const __m128 w = _mm_loadu_ps(streams.rotationW + i);
+        const __m128 x2 = _mm_add_ps(x, x);
+        const __m128 y2 = _mm_add_ps(y, y);
+        const __m128 z2 = _mm_add_ps(z, z);
+        const __m128 xx = _mm_mul_ps(x, x2), yy = _mm_mul_ps(y, y2), zz = _mm_mul_ps(z, z2);
+        const __m128 xy = _mm_mul_ps(x, y2), xz = _mm_mul_ps(x, z2), yz = _mm_mul_ps(y, z2);
+        const __m128 wx = _mm_mul_ps(w, x2), wy = _mm_mul_ps(w, y2), wz = _mm_mul_ps(w, z2);
+        const __m128 rotation[3][3] = {
+            { _mm_sub_ps(one, _mm_add_ps(yy, zz)), _mm_add_ps(xy, wz), _mm_sub_ps(xz, wy) },
+            { _mm_sub_ps(xy, wz), _mm_sub_ps(one, _mm_add_ps(xx, zz)), _mm_add_ps(yz, wx) },
+            { _mm_add_ps(xz, wy), _mm_sub_ps(yz, wx), _mm_sub_ps(one, _mm_add_ps(xx, yy)) },
+        };
+        const __m128 s = _mm_loadu_ps(streams.scale + i);
+        const __m128 inverseScale = _mm_div_ps(one, s);
+        const __m128 tx = _mm_loadu_ps(streams.positionX + i);
+        const __m128 ty = _mm_loadu_ps(streams.positionY + i);
+        const __m128 tz = _mm_loadu_ps(streams.positionZ + i);
+
+        __m128 world[3][3];
+        float* pModel = reinterpret_cast<float*>(&pInstances[i].model);
+        float* pNormal = reinterpret_cast<float*>(&pInstances[i].normalMatrix);
+        for (int row = 0; row < 3; row++) {
+            world[row][0] = _mm_mul_ps(rotation[row][0], s);
+            world[row][1] = _mm_mul_ps(rotation[row][1], s);
+            world[row][2] = _mm_mul_ps(rotation[row][2], s);
+            StoreRows4(pModel + 4 * row, kInstanceStride, world[row][0], world[row][1], world[row][2], zero);
+            StoreRows4(pNormal + 4 * row, kInstanceStride, _mm_mul_ps(rotation[row][0], inverseScale),
+                _mm_mul_ps(rotation[row][1], inverseScale), _mm_mul_ps(rotation[row][2], inverseScale), zero);
+        }
+        StoreRows4(pModel + 12, kInstanceStride, tx, ty, tz, one);
+        StoreRows4(pNormal + 12, kInstanceStride, zero, zero, zero, one);
+
+        if (pWorldViewProjection) {
+            float* pMvp = reinterpret_cast<float*>(pWorldViewProjection + i);
+            for (int row = 0; row < 3; row++) {
+                StoreRows4(pMvp + 4 * row, kMatrixStride,
+                    TransformColumnSse2(world[row][0], world[row][1], world[row][2], vp, 0),
+                    TransformColumnSse2(world[row][0], world[row][1], world[row][2], vp, 1),
+                    TransformColumnSse2(world[row][0], world[row][1], world[row][2], vp, 2),
+                    TransformColumnSse2(world[row][0], world[row][1], world[row][2], vp, 3));
+            }
+            StoreRows4(pMvp + 12, kMatrixStride,
+                _mm_add_ps(TransformColumnSse2(tx, ty, tz, vp, 0), _mm_set1_ps(vp.m[3][0])),
+                _mm_add_ps(TransformColumnSse2(tx, ty, tz, vp, 1), _mm_set1_ps(vp.m[3][1])),
+                _mm_add_ps(TransformColumnSse2(tx, ty, tz, vp, 2), _mm_set1_ps(vp.m[3][2])),
+                _mm_add_ps(TransformColumnSse2(tx, ty, tz, vp, 3), _mm_set1_ps(vp.m[3][3])));
+        }
+    }
+    ComputeTransformsScalar(streams, blockEnd, count, vp, pInstances, pWorldViewProjection);
+}
+
+// Строка матрицы восьми объектов: транспонирование 4x4 в каждой половине регистра,
+// младшая половина - объекты 0..3, старшая - 4..7
+TRANSFORM_TARGET_AVX2 inline void StoreRows8(float* pFirst, size_t stride, __m256 c0, __m256 c1, __m256 c2, __m256 c3) {
+    const __m256 t0 = _mm256_unpacklo_ps(c0, c1);
+    const __m256 t1 = _mm256_unpackhi_ps(c0, c1);
+    const __m256 t2 = _mm256_unpacklo_ps(c2, c3);
+    const __m256 t3 = _mm256_unpackhi_ps(c2, c3);
+    const __m256 r0 = _mm256_shuffle_ps(t0, t2, 0x44);
+    const __m256 r1 = _mm256_shuffle_ps(t0, t2, 0xEE);
+    const __m256 r2 = _mm256_shuffle_ps(t1, t3, 0x44);
+    const __m256 r3 = _mm256_shuffle_ps(t1, t3, 0xEE);
+    _mm_storeu_ps(pFirst, _mm256_castps256_ps128(r0));
+    _mm_storeu_ps(pFirst + stride, _mm256_castps256_ps128(r1));
+    _mm_storeu_ps(pFirst + 2 * stride, _mm256_castps256_ps128(r2));
+    _mm_storeu_ps(pFirst + 3 * stride, _mm256_castps256_ps128(r3));
+    _mm_storeu_ps(pFirst + 4 * stride, _mm256_extractf128_ps(r0, 1));
+    _mm_storeu_ps(pFirst + 5 * stride, _mm256_extractf128_ps(r1, 1));
+    _mm_storeu_ps(pFirst + 6 * stride, _mm256_extractf128_ps(r2, 1));
+    _mm_storeu_ps(pFirst + 7 * stride, _mm256_extractf128_ps(r3, 1));
+}
+
+TRANSFORM_TARGET_AVX2 inline __m256 TransformColumnAvx2(__m256 a, __m256 b, __m256 c, const DirectX::XMFLOAT4X4& vp, int column) {
+    return _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(a, _mm256_set1_ps(vp.m[0][column])), _mm256_mul_ps(b, _mm256_set1_ps(vp.m[1][column]))),
+        _mm256_mul_ps(c, _mm256_set1_ps(vp.m[2][column])));
+}
+
+TRANSFORM_TARGET_AVX2 void ComputeTransformsAvx2(const TransformStreams& streams, uint32_t count, const DirectX::XMFLOAT4X4& vp,
+    InstanceData* pInstances, DirectX::XMMATRIX* pWorldViewProjection) {
+    const uint32_t blockEnd = count & ~7u;
+    const __m256 zero = _mm256_setzero_ps();
+    const __m256 one = _mm256_set1_ps(1.0f);
+    for (uint32_t i = 0; i < blockEnd; i += 8) {
+        const __m256 x = _mm256_loadu_ps(streams.rotationX + i);
+        const __m256 y = _mm256_loadu_ps(streams.rotationY + i);
+        const __m256 z = _mm256_loadu_ps(streams.rotationZ + i);
+        const __m256 w = _mm256_loadu_ps(streams.rotationW + i);
+        const __m256 x2 = _mm256_add_ps(x, x);
+        const __m256 y2 = _mm256_add_ps(y, y);
+        const __m256 z2 = _mm256_add_ps(z, z);
+        const __m256 xx = _mm256_mul_ps(x, x2), yy = _mm256_mul_ps(y, y2), zz = _mm256_mul_ps(z, z2);
+        const __m256 xy = _mm256_mul_ps(x, y2), xz = _mm256_mul_ps(x, z2), yz = _mm256_mul_ps(y, z2);
+        const __m256 wx = _mm256_mul_ps(w, x2), wy = _mm256_mul_ps(w, y2), wz = _mm256_mul_ps(w, z2);
+        const __m256 rotation[3][3] = {
+            { _mm256_sub_ps(one, _mm256_add_ps(yy, zz)), _mm256_add_ps(xy, wz), _mm256_sub_ps(xz, wy) },
+            { _mm256_sub_ps(xy, wz), _mm256_sub_ps(one, _mm256_add_ps(xx, zz)), _mm256_add_ps(yz, wx) },
+            { _mm256_add_ps(xz, wy), _mm256_sub_ps(yz, wx), _mm256_sub_ps(one, _mm256_add_ps(xx, yy)) },
+        };
+        const __m256 s = _mm256_loadu_ps(streams.scale + i);
+        const __m256 inverseScale = _mm256_div_ps(one, s);
+        const __m256 tx = _mm256_loadu_ps(streams.positionX + i);
+        const __m256 ty = _mm256_loadu_ps(streams.positionY + i);
+        const __m256 tz = _mm256_loadu_ps(streams.positionZ + i);
+
+        __m256 world[3][3];
+        float* pModel = reinterpret_cast<float*>(&pInstances[i].model);
+        float* pNormal = reinterpret_cast<float*>(&pInstances[i].normalMatrix);
+        for (int row = 0; row < 3; row++) {
+            world[row][0] = _mm256_mul_ps(rotation[row][0], s);
+            world[row][1] = _mm256_mul_ps(rotation[row][1], s);
+            world[row][2] = _mm256_mul_ps(rotation[row][2], s);
+            StoreRows8(pModel + 4 * row, kInstanceStride, world[row][0], world[row][1], world[row][2], zero);
+            StoreRows8(pNormal + 4 * row, kInstanceStride, _mm256_mul_ps(rotation[row][0], inverseScale),
+                _mm256_mul_ps(rotation[row][1], inverseScale), _mm256_mul_ps(rotation[row][2], inverseScale), zero);
+        }
+        StoreRows8(pModel + 12, kInstanceStride, tx, ty, tz, one);
+        StoreRows8(pNormal + 12, kInstanceStride, zero, zero, zero, one);
+
+        if (pWorldViewProjection) {
+            float* pMvp = reinterpret_cast<float*>(pWorldViewProjection + i);
+            for (int row = 0; row < 3; row++) {
+                StoreRows8(pMvp + 4 * row, kMatrixStride,
+                    TransformColumnAvx2(world[row][0], world[row][1], world[row][2], vp, 0),
+                    TransformColumnAvx2(world[row][0], world[row][1], world[row][2], vp, 1),
+                    TransformColumnAvx2(world[row][0], world[row][1], world[row][2], vp, 2),
+                    TransformColumnAvx2(world[row][0], world[row][1], world[row][2], vp, 3));
+            }
+            StoreRows8(pMvp + 12, kMatrixStride,
+                _mm256_add_ps(TransformColumnAvx2(tx, ty, tz, vp, 0), _mm256_set1_ps(vp.m[3][0])),
+                _mm256_add_ps(TransformColumnAvx2(tx, ty, tz, vp, 1), _mm256_set1_ps(vp.m[3][1])),
+                _mm256_add_ps(TransformColumnAvx2(tx, ty, tz, vp, 2), _mm256_set1_ps(vp.m[3][2])),
+                _mm256_add_ps(TransformColumnAvx2(tx, ty, tz, vp, 3), _mm256_set1_ps(vp.m[3][3])));
+        }
+    }
+    // Хвост и вызывающий код - SSE: верхние половины YMM сбрасываются
+    _mm256_zeroupper();
+    ComputeTransformsScalar(streams, blockEnd, count, vp, pInstances, pWorldViewProjection);
+}
+
+#endif // TRANSFORM_HAS_SSE2
+
+// Наибольшее отличие элементов матриц, относительно величины элемента (не меньше 1)
+double MaxMatrixDifference(DirectX::FXMMATRIX a, DirectX::CXMMATRIX b, int rowCount, int columnCount) {
+    DirectX::XMFLOAT4X4 fa;
+    DirectX::XMFLOAT4X4 fb;
+    DirectX::XMStoreFloat4x4(&fa, a);
+    DirectX::XMStoreFloat4x4(&fb, b);
+    double difference = 0.0;
+    for (int row = 0; row < rowCount; row++) {
+        for (int column = 0; column < columnCount; column++) {
+            const double magnitude = std::fabs(fb.m[row][column]) > 1.0f ? std::fabs(fb.m[row][column]) : 1.0;
+            const double d = std::fabs(static_cast<double>(fa.m[row][column]) - fb.m[row][column]) / magnitude;
+            difference = d > difference ? d : difference;
+        }
+    }
+    return difference;
+}
+
+} // namespace
+
+void TransformArrays::Resize(uint32_t count) {
+    rotationX.resize(count);
+    rotationY.resize(count);
+    rotationZ.resize(count);
+    rotationW.resize(count);
+    scale.resize(count);
+    positionX.resize(count);
+    positionY.resize(count);
+    positionZ.resize(count);
+}
+
+void TransformArrays::Set(uint32_t index, DirectX::FXMVECTOR rotation, float s, const DirectX::XMFLOAT3& position) {
+    DirectX::XMFLOAT4 q;
+    DirectX::XMStoreFloat4(&q, rotation);
+    rotationX[index] = q.x;
+    rotationY[index] = q.y;
+    rotationZ[index] = q.z;
+    rotationW[index] = q.w;
+    scale[index] = s;
+    positionX[index] = position.x;
+    positionY[index] = position.y;
+    positionZ[index] = position.z;
+}
+
+TransformStreams TransformArrays::GetStreams(uint32_t first) const {
+    TransformStreams streams;
+    streams.rotationX = rotationX.data() + first;
+    streams.rotationY = rotationY.data() + first;
+    streams.rotationZ = rotationZ.data() + first;
+    streams.rotationW = rotationW.data() + first;
+    streams.scale = scale.data() + first;
+    streams.positionX = positionX.data() + first;
+    streams.positionY = positionY.data() + first;
+    streams.positionZ = positionZ.data() + first;
+    return streams;
+}
+
+void ComputeTransformBatch(const TransformStreams& streams, uint32_t count, DirectX::FXMMATRIX viewProjection,
+    InstanceData* pInstances, DirectX::XMMATRIX* pWorldViewProjection, CullPath path) {
+    if (!IsCullPathSupported(path)) {
+        path = CullPath::Scalar;
+    }
+    DirectX::XMFLOAT4X4 vp;
+    DirectX::XMStoreFloat4x4(&vp, viewProjection);
+    switch (path) {
+#if TRANSFORM_HAS_SSE2
+    case CullPath::Sse2:
+        ComputeTransformsSse2(streams, count, vp, pInstances, pWorldViewProjection);
+        break;
+    case CullPath::Avx2:
+        ComputeTransformsAvx2(streams, count, vp, pInstances, pWorldViewProjection);
+        break;
+#endif
+    default:
+        ComputeTransformsScalar(streams, 0, count, vp, pInstances, pWorldViewProjection);
+        break;
+    }
+}
+
+void ComputeTransforms(const TransformArrays& transforms, DirectX::FXMMATRIX viewProjection,
+    InstanceData* pInstances, DirectX::XMMATRIX* pWorldViewProjection, CullPath path, ThreadPool* pThreadPool) {
+    // Порции кратны 8, чтобы хвосты не дробились на каждой порции
+    auto compute = [&transforms, viewProjection, pInstances, pWorldViewProjection, path](uint32_t begin, uint32_t end) {
+        ComputeTransformBatch(transforms.GetStreams(begin), end - begin, viewProjection, pInstances + begin,
+            pWorldViewProjection ? pWorldViewProjection + begin : nullptr, path);
+    };
+    if (pThreadPool) {
+        pThreadPool->ParallelFor(transforms.GetCount(), 8192, compute);
+    }
+    else {
+        compute(0, transforms.GetCount());
+    }
+}
+
+std::vector<TransformBatchBenchmarkResult> RunTransformBatchBenchmark(uint32_t objectCount, uint32_t repeatCount,
+    ThreadPool* pThreadPool, uint32_t seed) {
+    std::mt19937 random(seed);
+    std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+    std::uniform_real_distribution<float> scale(0.2f, 5.0f);
+    TransformArrays transforms;
+    transforms.Resize(objectCount);
+    for (uint32_t i = 0; i < objectCount; i++) {
+        const DirectX::XMVECTOR axis = DirectX::XMVector3Normalize(DirectX::XMVectorSet(unit(random), unit(random), unit(random) + 1e-3f, 0.0f));
+        const DirectX::XMVECTOR rotation = DirectX::XMQuaternionRotationAxis(axis, DirectX::XM_PI * unit(random));
+        transforms.Set(i, rotation, scale(random), DirectX::XMFLOAT3(100.0f * unit(random), 10.0f * unit(random), 100.0f * unit(random)));
+    }
+    const DirectX::XMMATRIX viewProjection = DirectX::XMMatrixMultiply(
+        DirectX::XMMatrixLookAtLH(DirectX::XMVectorSet(0.0f, 50.0f, -150.0f, 0.0f), DirectX::XMVectorZero(), DirectX::XMVectorSet(0.0f, 1.0f, 0.0f, 0.0f)),
+        DirectX::XMMatrixPerspectiveFovLH(DirectX::XM_PI / 3.0f, 1280.0f / 720.0f, 0.1f, 1000.0f));
+
+    std::vector<InstanceData> referenceInstances(objectCount);
+    std::vector<DirectX::XMMATRIX> referenceMvp(objectCount);
+    std::vector<InstanceData> expectedInstances(objectCount);
+    std::vector<DirectX::XMMATRIX> expectedMvp(objectCount);
+    std::vector<InstanceData> instances(objectCount);
+    std::vector<DirectX::XMMATRIX> mvp(objectCount);
+
+    std::vector<TransformBatchBenchmarkResult> results;
+    auto measure = [&](TransformBatchBenchmarkResult& result, auto compute) {
+        compute();
+        const auto startTime = std::chrono::steady_clock::now();
+        for (uint32_t repeat = 0; repeat < repeatCount; repeat++) {
+            compute();
+        }
+        const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+        result.millionObjectsPerSecond = seconds > 0.0 ? static_cast<double>(objectCount) * repeatCount / seconds / 1e6 : 0.0;
+    };
+
+    // По объектам, как в UpdateRotation: матрицы DirectXMath и общее обращение 4x4
+    TransformBatchBenchmarkResult reference;
+    reference.name = "DirectXMath";
+    measure(reference, [&]() {
+        for (uint32_t i = 0; i < objectCount; i++) {
+            const DirectX::XMVECTOR rotation = DirectX::XMVectorSet(transforms.rotationX[i], transforms.rotationY[i], transforms.rotationZ[i], transforms.rotationW[i]);
+            const DirectX::XMMATRIX world = DirectX::XMMatrixScaling(transforms.scale[i], transforms.scale[i], transforms.scale[i]) *
+                DirectX::XMMatrixRotationQuaternion(rotation) *
+                DirectX::XMMatrixTranslation(transforms.positionX[i], transforms.positionY[i], transforms.positionZ[i]);
+            referenceInstances[i].model = world;
+            referenceInstances[i].normalMatrix = ComputeNormalMatrix(world);
+            referenceMvp[i] = DirectX::XMMatrixMultiply(world, viewProjection);
+        }
+    });
+    results.push_back(reference);
+
+    ComputeTransformBatch(transforms.GetStreams(0), objectCount, viewProjection, expectedInstances.data(), expectedMvp.data(), CullPath::Scalar);
+    auto compare = [&](TransformBatchBenchmarkResult& result) {
+        for (uint32_t i = 0; i < objectCount; i++) {
+            // У матрицы нормалей сравнивается часть 3x3: перенос в ней не считается
+            double difference = MaxMatrixDifference(instances[i].model, referenceInstances[i].model, 4, 4);
+            const double normalDifference = MaxMatrixDifference(instances[i].normalMatrix, referenceInstances[i].normalMatrix, 3, 3);
+            const double mvpDifference = MaxMatrixDifference(mvp[i], referenceMvp[i], 4, 4);
+            difference = normalDifference > difference ? normalDifference : difference;
+            difference = mvpDifference > difference ? mvpDifference : difference;
+            result.maxDifference = difference > result.maxDifference ? difference : result.maxDifference;
+            result.mismatchCount += memcmp(&instances[i], &expectedInstances[i], sizeof(InstanceData)) != 0 ||
+                memcmp(&mvp[i], &expectedMvp[i], sizeof(DirectX::XMMATRIX)) != 0 ? 1 : 0;
+        }
+    };
+
+    const CullPath paths[] = { CullPath::Scalar, CullPath::Sse2, CullPath::Avx2 };
+    for (CullPath path : paths) {
+        if (!IsCullPathSupported(path)) {
+            continue;
+        }
+        TransformBatchBenchmarkResult result;
+        result.name = GetCullPathName(path);
+        measure(result, [&]() {
+            ComputeTransforms(transforms, viewProjection, instances.data(), mvp.data(), path, nullptr);
+        });
+        compare(result);
+        results.push_back(result);
+    }
+
+    if (pThreadPool) {
+        TransformBatchBenchmarkResult result;
+        result.name = GetCullPathName(GetBestCullPath());
+        result.threadCount = pThreadPool->GetThreadCount();
+        measure(result, [&]() {
+            ComputeTransforms(transforms, viewProjection, instances.data(), mvp.data(), GetBestCullPath(), pThreadPool);
+        });
+        compare(result);
+        results.push_back(result);
+    }
+    return results;
+}
@@ -0,0 +1,66 @@
+﻿#pragma once
+
+#include <cstdint>
+#include <vector>
+#include <DirectXMath.h>
+#include "FrustumCulling.h"
+#include "Instancing.h"
+
+class ThreadPool;
+
+// Пакетный расчет матриц объектов с жесткими преобразованиями и равномерным масштабом.
+// Поворот (кватернион), масштаб и перенос хранятся по полям (SoA), и матрицы считаются сразу
+// для 8 (AVX2) или 4 (SSE2) объектов: матрица мира - прямо из кватерниона, матрица нормалей -
+// ее часть 3x3, деленная на квадрат масштаба, без обращения 4x4, MVP - произведение с общей
+// view * projection. Готовые матрицы раскладываются по объектам - в InstanceData и XMMATRIX.
+
+// Поля диапазона объектов: указатели на первый объект диапазона
+struct TransformStreams {
+    const float* rotationX;
+    const float* rotationY;
+    const float* rotationZ;
+    const float* rotationW;
+    const float* scale;
+    const float* positionX;
+    const float* positionY;
+    const float* positionZ;
+};
+
+struct TransformArrays {
+    std::vector<float> rotationX; // единичный кватернион
+    std::vector<float> rotationY;
+    std::vector<float> rotationZ;
+    std::vector<float> rotationW;
+    std::vector<float> scale;
+    std::vector<float> positionX;
+    std::vector<float> positionY;
+    std::vector<float> positionZ;
+
+    void Resize(uint32_t count);
+    void Set(uint32_t index, DirectX::FXMVECTOR rotation, float s, const DirectX::XMFLOAT3& position);
+    uint32_t GetCount() const { return static_cast<uint32_t>(scale.size()); }
+    TransformStreams GetStreams(uint32_t first) const;
+};
+
+// Матрицы count объектов: мир и нормали в pInstances, мир * viewProjection в pWorldViewProjection
+// (nullptr - не нужны). Матрица нормалей, как у CubeField::GetInstance, без переноса: шейдер берет
+// только ее часть 3x3. Все пути считают в одном порядке и без FMA - результаты совпадают побитно.
+void ComputeTransformBatch(const TransformStreams& streams, uint32_t count, DirectX::FXMMATRIX viewProjection,
+    InstanceData* pInstances, DirectX::XMMATRIX* pWorldViewProjection, CullPath path);
+
+// Все объекты массивов; с пулом - параллельно по диапазонам
+void ComputeTransforms(const TransformArrays& transforms, DirectX::FXMMATRIX viewProjection,
+    InstanceData* pInstances, DirectX::XMMATRIX* pWorldViewProjection, CullPath path, ThreadPool* pThreadPool);
+
+struct TransformBatchBenchmarkResult {
+    const char* name = "";         // "DirectXMath" - по объектам, иначе путь пакетного расчета
+    unsigned threadCount = 1;
+    double millionObjectsPerSecond = 0;
+    double maxDifference = 0;      // от DirectXMath, относительно величины элемента
+    size_t mismatchCount = 0;      // объекты, отличающиеся от скалярного пакетного пути
+};
+
+// Случайные объекты: по объектам через XMMatrixRotationQuaternion, XMMatrixInverse и XMMatrixMultiply,
+// затем пакетный расчет на всех путях в одном потоке и лучший путь в пуле
+std::vector<TransformBatchBenchmarkResult> RunTransformBatchBenchmark(uint32_t objectCount, uint32_t repeatCount,
+    ThreadPool* pThreadPool, uint32_t seed = 1);
@@ -0,0 +1,154 @@
+﻿#include "Transforms.h"
+#include "Instancing.h"
+
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <random>
+
+uint32_t TransformSet::Add(DirectX::FXMMATRIX world) {
+    const uint32_t id = GetCount();
+    GeomBuffer constants = {};
+    constants.model = world;
+    m_constants.push_back(constants);
+    m_versions.push_back(0);
+    m_dirty.push_back(1);
+    m_dirtyList.push_back(id);
+    return id;
+}
+
+void TransformSet::SetWorld(uint32_t id, DirectX::FXMMATRIX world) {
+    GeomBuffer& constants = m_constants[id];
+    if (memcmp(&constants.model, &world, sizeof(DirectX::XMMATRIX)) == 0) {
+        return;
+    }
+    constants.model = world;
+    if (!m_dirty[id]) {
+        m_dirty[id] = 1;
+        m_dirtyList.push_back(id);
+    }
+}
+
+void TransformSet::SetCamera(DirectX::FXMMATRIX view, DirectX::CXMMATRIX projection) {
+    if (memcmp(&m_view, &view, sizeof(DirectX::XMMATRIX)) == 0 && memcmp(&m_projection, &projection, sizeof(DirectX::XMMATRIX)) == 0) {
+        return;
+    }
+    m_view = view;
+    m_projection = projection;
+    m_cameraDirty = true;
+}
+
+void TransformSet::Update() {
+    m_stats = TransformUpdateStats();
+    m_stats.objectCount = GetCount();
+    m_stats.cameraChanged = m_cameraDirty;
+
+    for (uint32_t id : m_dirtyList) {
+        GeomBuffer& constants = m_constants[id];
+        constants.normalMatrix = ComputeNormalMatrix(constants.model);
+        // С камерой пересчитываются все объекты ниже, версия - там же
+        if (!m_cameraDirty) {
+            m_versions[id] = m_nextVersion++;
+        }
+        m_dirty[id] = 0;
+    }
+    m_stats.normalsRecomputed = static_cast<uint32_t>(m_dirtyList.size());
+    m_stats.constantsRebuilt = m_stats.normalsRecomputed;
+    m_dirtyList.clear();
+
+    if (m_cameraDirty) {
+        for (uint32_t id = 0; id < GetCount(); id++) {
+            m_constants[id].view = m_view;
+            m_constants[id].projection = m_projection;
+            m_versions[id] = m_nextVersion++;
+        }
+        m_cameraVersion = m_nextVersion++;
+        m_cameraDirty = false;
+        m_stats.constantsRebuilt = GetCount();
+    }
+    m_stats.normalsSkipped = m_stats.objectCount - m_stats.normalsRecomputed;
+    m_stats.constantsSkipped = m_stats.objectCount - m_stats.constantsRebuilt;
+}
+
+std::vector<TransformBenchmarkResult> RunTransformBenchmark(uint32_t objectCount, const double* pDynamicFractions, uint32_t fractionCount,
+    uint32_t frameCount, uint32_t seed) {
+    // Объекты вращаются на месте вокруг своих осей; неподвижные - в начальном положении
+    std::mt19937 random(seed);
+    std::uniform_real_distribution<float> position(-100.0f, 100.0f);
+    std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+    std::uniform_real_distribution<double> chance(0.0, 1.0);
+    std::vector<DirectX::XMFLOAT4> axes(objectCount);
+    std::vector<DirectX::XMFLOAT3> positions(objectCount);
+    std::vector<double> draws(objectCount);
+    for (uint32_t i = 0; i < objectCount; i++) {
+        axes[i] = DirectX::XMFLOAT4(unit(random), unit(random), unit(random) + 2.0f, unit(random) * DirectX::XM_PI);
+        positions[i] = DirectX::XMFLOAT3(position(random), position(random) * 0.1f, position(random));
+        draws[i] = chance(random);
+    }
+    auto getWorld = [&](uint32_t i, float time) {
+        const DirectX::XMVECTOR axis = DirectX::XMVector3Normalize(DirectX::XMLoadFloat4(&axes[i]));
+        return DirectX::XMMatrixMultiply(DirectX::XMMatrixRotationAxis(axis, axes[i].w + time),
+            DirectX::XMMatrixTranslation(positions[i].x, positions[i].y, positions[i].z));
+    };
+    const DirectX::XMMATRIX projection = DirectX::XMMatrixPerspectiveFovLH(DirectX::XM_PI / 3.0f, 1280.0f / 720.0f, 0.1f, 1000.0f);
+    auto getView = [](bool moving, uint32_t frame) {
+        const float angle = moving ? frame * 0.01f : 0.0f;
+        return DirectX::XMMatrixLookAtLH(DirectX::XMVectorSet(150.0f * sinf(angle), 60.0f, -150.0f * cosf(angle), 0.0f),
+            DirectX::XMVectorZero(), DirectX::XMVectorSet(0.0f, 1.0f, 0.0f, 0.0f));
+    };
+
+    std::vector<GeomBuffer> fullConstants(objectCount);
+    std::vector<uint8_t> dynamic(objectCount);
+    std::vector<TransformBenchmarkResult> results;
+    for (uint32_t f = 0; f < fractionCount; f++) {
+        for (uint32_t i = 0; i < objectCount; i++) {
+            dynamic[i] = draws[i] < pDynamicFractions[f] ? 1 : 0;
+        }
+        for (bool cameraMoving : { false, true }) {
+            TransformBenchmarkResult result;
+            result.objectCount = objectCount;
+            result.dynamicFraction = pDynamicFractions[f];
+            result.cameraMoving = cameraMoving;
+
+            // Полный пересчет: матрица мира, обращение и GeomBuffer каждого объекта в каждом кадре
+            auto startTime = std::chrono::steady_clock::now();
+            for (uint32_t frame = 1; frame <= frameCount; frame++) {
+                const DirectX::XMMATRIX view = getView(cameraMoving, frame);
+                for (uint32_t i = 0; i < objectCount; i++) {
+                    GeomBuffer& constants = fullConstants[i];
+                    constants.model = getWorld(i, dynamic[i] ? frame * 0.02f : 0.0f);
+                    constants.view = view;
+                    constants.projection = projection;
+                    constants.normalMatrix = ComputeNormalMatrix(constants.model);
+                }
+            }
+            result.fullMilliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - startTime).count() / frameCount;
+
+            // Начальное положение и первый Update не входят в замер - их делает загрузка сцены
+            TransformSet transforms;
+            for (uint32_t i = 0; i < objectCount; i++) {
+                transforms.Add(getWorld(i, 0.0f));
+            }
+            transforms.SetCamera(getView(cameraMoving, 0), projection);
+            transforms.Update();
+            startTime = std::chrono::steady_clock::now();
+            for (uint32_t frame = 1; frame <= frameCount; frame++) {
+                for (uint32_t i = 0; i < objectCount; i++) {
+                    if (dynamic[i]) {
+                        transforms.SetWorld(i, getWorld(i, frame * 0.02f));
+                    }
+                }
+                transforms.SetCamera(getView(cameraMoving, frame), projection);
+                transforms.Update();
+            }
+            result.trackedMilliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - startTime).count() / frameCount;
+            result.stats = transforms.GetStats();
+
+            for (uint32_t i = 0; i < objectCount; i++) {
+                result.mismatchCount += memcmp(&transforms.GetConstants(i), &fullConstants[i], sizeof(GeomBuffer)) != 0 ? 1 : 0;
+            }
+            results.push_back(result);
+        }
+    }
+    return results;
+}
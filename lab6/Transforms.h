@@ -0,0 +1,69 @@
+﻿#pragma once
+
+#include <cstdint>
+#include <vector>
+#include <DirectXMath.h>
+#include "SceneTypes.h"
+
+// Трансформации объектов сцены с отметками изменений. Матрица нормалей (обращение и
+// транспонирование) пересчитывается только у объектов, чья матрица мира изменилась,
+// а GeomBuffer - только у них или при изменении камеры. Версия констант объекта меняется
+// вместе с его GeomBuffer: по ней рендер не загружает заново буферы неизменных объектов.
+
+struct TransformUpdateStats {
+    uint32_t objectCount = 0;
+    uint32_t normalsRecomputed = 0;  // изменилась матрица мира
+    uint32_t normalsSkipped = 0;
+    uint32_t constantsRebuilt = 0;   // изменился мир или камера
+    uint32_t constantsSkipped = 0;
+    bool cameraChanged = false;
+};
+
+class TransformSet {
+public:
+    // Номер объекта - индекс в порядке добавления
+    uint32_t Add(DirectX::FXMMATRIX world);
+    uint32_t GetCount() const { return static_cast<uint32_t>(m_constants.size()); }
+
+    // Матрица мира, совпадающая с прежней побайтно, объект не помечает
+    void SetWorld(uint32_t id, DirectX::FXMMATRIX world);
+    void SetCamera(DirectX::FXMMATRIX view, DirectX::CXMMATRIX projection);
+
+    // Пересчет помеченных объектов; статистика - только этого вызова
+    void Update();
+
+    // model, view, projection и normalMatrix объекта после последнего Update
+    const GeomBuffer& GetConstants(uint32_t id) const { return m_constants[id]; }
+    // Версии уникальны в пределах набора и не равны нулю
+    uint64_t GetVersion(uint32_t id) const { return m_versions[id]; }
+    uint64_t GetCameraVersion() const { return m_cameraVersion; }
+
+    const TransformUpdateStats& GetStats() const { return m_stats; }
+
+private:
+    std::vector<GeomBuffer> m_constants;
+    std::vector<uint64_t> m_versions;
+    std::vector<uint8_t> m_dirty;
+    std::vector<uint32_t> m_dirtyList; // без просмотра всех объектов, пока камера неподвижна
+    DirectX::XMMATRIX m_view = DirectX::XMMatrixIdentity();
+    DirectX::XMMATRIX m_projection = DirectX::XMMatrixIdentity();
+    bool m_cameraDirty = true;
+    uint64_t m_cameraVersion = 0;
+    uint64_t m_nextVersion = 1;
+    TransformUpdateStats m_stats;
+};
+
+struct TransformBenchmarkResult {
+    uint32_t objectCount = 0;
+    double dynamicFraction = 0;    // доля объектов, которые двигаются каждый кадр
+    bool cameraMoving = false;
+    double fullMilliseconds = 0;   // все матрицы и GeomBuffer каждый кадр, как раньше в UpdateRotation
+    double trackedMilliseconds = 0;
+    TransformUpdateStats stats;    // последнего кадра TransformSet
+    size_t mismatchCount = 0;      // GeomBuffer, отличающиеся от полного пересчета
+};
+
+// Кадры сцены из objectCount объектов с долей движущихся из pDynamicFractions, с неподвижной
+// и с вращающейся камерой: полный пересчет против TransformSet
+std::vector<TransformBenchmarkResult> RunTransformBenchmark(uint32_t objectCount, const double* pDynamicFractions, uint32_t fractionCount,
+    uint32_t frameCount, uint32_t seed = 1);
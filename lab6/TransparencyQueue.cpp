@@ -0,0 +1,272 @@
+﻿#include "TransparencyQueue.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <numeric>
+#include <random>
+
+namespace {
+
+const uint32_t kRadixBits = 11;
+const uint32_t kRadixSize = 1u << kRadixBits;
+const uint32_t kRadixMask = kRadixSize - 1;
+const uint32_t kKeyBits = 2 * kRadixBits;
+const float kMaxKey = static_cast<float>((1u << kKeyBits) - 1);
+const uint32_t kSampleCount = 256;
+
+// Дальний объект получает ключ 0, ближний - наибольший; NaN уходит в начало очереди
+inline uint32_t QuantizeDepth(float depth, float farthest, float scale) {
+    const float key = (farthest - depth) * scale;
+    if (!(key > 0.0f)) {
+        return 0;
+    }
+    return key < kMaxKey ? static_cast<uint32_t>(key) : static_cast<uint32_t>(kMaxKey);
+}
+
+} // namespace
+
+void ComputeViewDepths(DirectX::FXMMATRIX view, const float* pX, const float* pY, const float* pZ, uint32_t count, float* pDepths) {
+    // Третий столбец view: z = x * m02 + y * m12 + z * m22 + m32
+    const float m02 = DirectX::XMVectorGetZ(view.r[0]);
+    const float m12 = DirectX::XMVectorGetZ(view.r[1]);
+    const float m22 = DirectX::XMVectorGetZ(view.r[2]);
+    const float m32 = DirectX::XMVectorGetZ(view.r[3]);
+    for (uint32_t i = 0; i < count; i++) {
+        pDepths[i] = pX[i] * m02 + pY[i] * m12 + pZ[i] * m22 + m32;
+    }
+}
+
+void TransparencyQueue::Resize(uint32_t count) {
+    if (count != m_depths.size()) {
+        m_depths.resize(count);
+        m_order.clear();
+    }
+}
+
+const uint32_t* TransparencyQueue::Sort() {
+    const uint32_t count = GetCount();
+    m_stats.sortCount++;
+
+    // Диапазон глубин кадра задает шаг квантования
+    float nearest = count > 0 ? m_depths[0] : 0.0f;
+    float farthest = nearest;
+    for (uint32_t i = 1; i < count; i++) {
+        nearest = m_depths[i] < nearest ? m_depths[i] : nearest;
+        farthest = m_depths[i] > farthest ? m_depths[i] : farthest;
+    }
+    const float scale = farthest > nearest ? kMaxKey / (farthest - nearest) : 0.0f;
+
+    // Ключи в порядке прошлого кадра; число мест, где порядок нарушен, решает, как сортировать.
+    // Чтение глубин по старому порядку идет вразброс, поэтому сначала порядок проверяется
+    // на выборке пар: если он уже заметно нарушен, ключи строятся в порядке номеров.
+    bool coherent = m_order.size() == count;
+    if (coherent && count > 16 * kSampleCount) {
+        uint32_t sampleDescentCount = 0;
+        for (uint32_t sample = 0; sample < kSampleCount; sample++) {
+            const uint32_t i = static_cast<uint32_t>(uint64_t(sample) * (count - 1) / kSampleCount);
+            sampleDescentCount += QuantizeDepth(m_depths[m_order[i + 1]], farthest, scale) < QuantizeDepth(m_depths[m_order[i]], farthest, scale) ? 1 : 0;
+        }
+        coherent = sampleDescentCount <= kSampleCount / 16;
+    }
+    if (!coherent) {
+        m_order.resize(count);
+        std::iota(m_order.begin(), m_order.end(), 0u);
+    }
+    m_keys.resize(count);
+    uint32_t descentCount = 0;
+    for (uint32_t i = 0; i < count; i++) {
+        m_keys[i] = QuantizeDepth(m_depths[m_order[i]], farthest, scale);
+        descentCount += i > 0 && m_keys[i] < m_keys[i - 1] ? 1 : 0;
+    }
+
+    if (descentCount == 0) {
+        m_stats.unchangedCount++;
+    }
+    else if (coherent && descentCount <= count / 16 && SortByInsertion(4 * count)) {
+        m_stats.insertionCount++;
+    }
+    else {
+        // Прерванная вставка оставляет перестановку, с которой поразрядная сортировка работает так же
+        SortByRadix();
+        m_stats.radixCount++;
+    }
+    return m_order.data();
+}
+
+bool TransparencyQueue::SortByInsertion(uint32_t moveBudget) {
+    uint32_t* pKeys = m_keys.data();
+    uint32_t* pOrder = m_order.data();
+    uint64_t moveCount = 0;
+    for (uint32_t i = 1; i < GetCount(); i++) {
+        const uint32_t key = pKeys[i];
+        if (key >= pKeys[i - 1]) {
+            continue;
+        }
+        const uint32_t index = pOrder[i];
+        uint32_t j = i;
+        for (; j > 0 && pKeys[j - 1] > key; j--) {
+            pKeys[j] = pKeys[j - 1];
+            pOrder[j] = pOrder[j - 1];
+        }
+        pKeys[j] = key;
+        pOrder[j] = index;
+        moveCount += i - j;
+        if (moveCount > moveBudget) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void TransparencyQueue::SortByRadix() {
+    const uint32_t count = GetCount();
+    m_tempKeys.resize(count);
+    m_tempOrder.resize(count);
+
+    // Гистограммы обеих цифр за один проход по ключам
+    std::vector<uint32_t> histograms(2 * kRadixSize, 0);
+    for (uint32_t i = 0; i < count; i++) {
+        histograms[m_keys[i] & kRadixMask]++;
+        histograms[kRadixSize + (m_keys[i] >> kRadixBits)]++;
+    }
+
+    uint32_t* pKeys = m_keys.data();
+    uint32_t* pOrder = m_order.data();
+    uint32_t* pTempKeys = m_tempKeys.data();
+    uint32_t* pTempOrder = m_tempOrder.data();
+    for (uint32_t pass = 0; pass < 2; pass++) {
+        const uint32_t shift = pass * kRadixBits;
+        uint32_t* pHistogram = histograms.data() + pass * kRadixSize;
+        // Если у всех ключей одна цифра, проход ничего не меняет
+        if (pHistogram[(pKeys[0] >> shift) & kRadixMask] == count) {
+            m_stats.skippedPassCount++;
+            continue;
+        }
+        uint32_t offset = 0;
+        for (uint32_t digit = 0; digit < kRadixSize; digit++) {
+            const uint32_t digitCount = pHistogram[digit];
+            pHistogram[digit] = offset;
+            offset += digitCount;
+        }
+        for (uint32_t i = 0; i < count; i++) {
+            const uint32_t position = pHistogram[(pKeys[i] >> shift) & kRadixMask]++;
+            pTempKeys[position] = pKeys[i];
+            pTempOrder[position] = pOrder[i];
+        }
+        std::swap(pKeys, pTempKeys);
+        std::swap(pOrder, pTempOrder);
+    }
+
+    // После нечетного числа проходов результат лежит во временных массивах
+    if (pKeys != m_keys.data()) {
+        m_keys.swap(m_tempKeys);
+        m_order.swap(m_tempOrder);
+    }
+}
+
+std::vector<TransparencyBenchmarkResult> RunTransparencyBenchmark(const uint32_t* pCounts, uint32_t countCount, uint32_t frameCount, uint32_t seed) {
+    enum Method { SortByDistance, RadixEachFrame, Coherent };
+    const char* methodNames[] = { "std::sort", "radix", "coherent" };
+
+    enum Scene { Particles, Foliage };
+    const char* sceneNames[] = { "particles", "foliage" };
+
+    std::vector<TransparencyBenchmarkResult> results;
+    for (uint32_t run = 0; run < 2 * countCount; run++) {
+        const int scene = run < countCount ? Particles : Foliage;
+        const uint32_t count = pCounts[run % countCount];
+        for (int method = SortByDistance; method <= Coherent; method++) {
+            // Одинаковые частицы и камера для всех способов
+            std::mt19937 random(seed);
+            std::uniform_real_distribution<float> position(-100.0f, 100.0f);
+            const float speed = scene == Particles ? 0.02f : 0.0f;
+            std::uniform_real_distribution<float> velocity(-speed, speed);
+            std::vector<float> x(count), y(count), z(count), vx(count), vy(count), vz(count);
+            for (uint32_t i = 0; i < count; i++) {
+                x[i] = position(random);
+                y[i] = position(random);
+                z[i] = position(random);
+                vx[i] = velocity(random);
+                vy[i] = velocity(random);
+                vz[i] = velocity(random);
+            }
+
+            struct DistanceEntry {
+                float distance;
+                uint32_t index;
+            };
+            std::vector<DistanceEntry> entries(count);
+            TransparencyQueue queue;
+            queue.Resize(count);
+
+            TransparencyBenchmarkResult result;
+            result.scene = sceneNames[scene];
+            result.count = count;
+            result.method = methodNames[method];
+            double milliseconds = 0.0;
+            DirectX::XMMATRIX view = DirectX::XMMatrixIdentity();
+            // Кадр 0 - прогрев, в замер не входит
+            for (uint32_t frame = 0; frame <= frameCount; frame++) {
+                // Частицы: камера поворачивается на месте; листва: камера идет вдоль z
+                const float yaw = scene == Particles ? 0.002f * frame : 0.0f;
+                const DirectX::XMFLOAT3 eye(0.0f, 0.0f, scene == Particles ? 0.0f : 0.05f * frame);
+                view = DirectX::XMMatrixLookToLH(DirectX::XMLoadFloat3(&eye),
+                    DirectX::XMVectorSet(std::sin(yaw), 0.0f, std::cos(yaw), 0.0f), DirectX::XMVectorSet(0.0f, 1.0f, 0.0f, 0.0f));
+
+                const auto startTime = std::chrono::steady_clock::now();
+                if (method == SortByDistance) {
+                    for (uint32_t i = 0; i < count; i++) {
+                        entries[i].distance = std::sqrt((x[i] - eye.x) * (x[i] - eye.x) + (y[i] - eye.y) * (y[i] - eye.y) + (z[i] - eye.z) * (z[i] - eye.z));
+                        entries[i].index = i;
+                    }
+                    std::sort(entries.begin(), entries.end(), [](const DistanceEntry& a, const DistanceEntry& b) {
+                        return a.distance > b.distance;
+                    });
+                }
+                else {
+                    if (method == RadixEachFrame) {
+                        queue.Invalidate();
+                    }
+                    ComputeViewDepths(view, x.data(), y.data(), z.data(), count, queue.GetDepths());
+                    queue.Sort();
+                }
+                if (frame > 0) {
+                    milliseconds += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - startTime).count();
+                }
+                else {
+                    queue.ResetStats();
+                }
+
+                if (frame < frameCount) {
+                    for (uint32_t i = 0; i < count; i++) {
+                        x[i] += vx[i];
+                        y[i] += vy[i];
+                        z[i] += vz[i];
+                    }
+                }
+            }
+
+            // Порядок последнего кадра по ключу своего способа: для очереди допускаются
+            // равные ключи, то есть разница глубин до шага квантования (с запасом на округление)
+            if (method == SortByDistance) {
+                for (uint32_t i = 1; i < count; i++) {
+                    result.orderErrors += entries[i - 1].distance < entries[i].distance ? 1 : 0;
+                }
+            }
+            else {
+                const float* pDepths = queue.GetDepths();
+                const uint32_t* pOrder = queue.GetOrder();
+                const auto range = std::minmax_element(pDepths, pDepths + count);
+                const float step = count > 0 ? 2.0f * (*range.second - *range.first) / kMaxKey : 0.0f;
+                for (uint32_t i = 1; i < count; i++) {
+                    result.orderErrors += pDepths[pOrder[i - 1]] + step < pDepths[pOrder[i]] ? 1 : 0;
+                }
+                result.stats = queue.GetStats();
+            }
+            result.millisecondsPerFrame = frameCount > 0 ? milliseconds / frameCount : 0.0;
+            results.push_back(result);
+        }
+    }
+    return results;
+}
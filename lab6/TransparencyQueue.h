@@ -0,0 +1,74 @@
+﻿#pragma once
+
+#include <cstdint>
+#include <vector>
+#include <DirectXMath.h>
+
+// Очередь полупрозрачных объектов в порядке от дальнего к ближнему. Объекты сортируются
+// по глубине в пространстве вида (без корня, как у расстояния до камеры), глубина
+// квантуется в 22-битный ключ по диапазону глубин кадра, ключи сортируются поразрядно (LSD,
+// два прохода по 11 бит). У объектов постоянные номера, поэтому порядок прошлого кадра
+// служит начальным: если он еще верен или почти верен, поразрядная сортировка не нужна.
+
+// Глубина точки в пространстве вида: третья координата p * view
+inline float ComputeViewDepth(DirectX::FXMMATRIX view, const DirectX::XMFLOAT3& position) {
+    return DirectX::XMVectorGetZ(DirectX::XMVector3Transform(DirectX::XMLoadFloat3(&position), view));
+}
+
+// Глубины count точек, заданных по полям
+void ComputeViewDepths(DirectX::FXMMATRIX view, const float* pX, const float* pY, const float* pZ, uint32_t count, float* pDepths);
+
+struct TransparencySortStats {
+    uint64_t sortCount = 0;
+    uint64_t unchangedCount = 0; // порядок прошлого кадра уже верен
+    uint64_t insertionCount = 0; // почти верный порядок досортирован вставками
+    uint64_t radixCount = 0;     // полная поразрядная сортировка
+    uint32_t skippedPassCount = 0; // проходы, где у всех ключей одна цифра
+};
+
+class TransparencyQueue {
+public:
+    // count объектов с номерами 0..count-1. При смене числа объектов порядок прошлого кадра забывается.
+    void Resize(uint32_t count);
+    uint32_t GetCount() const { return static_cast<uint32_t>(m_depths.size()); }
+
+    void SetDepth(uint32_t index, float viewDepth) { m_depths[index] = viewDepth; }
+    float* GetDepths() { return m_depths.data(); }
+
+    // Упорядочить номера объектов от дальнего к ближнему. Сортировка устойчивая: пока порядок
+    // меняется мало, объекты с равными ключами не меняются местами от кадра к кадру.
+    const uint32_t* Sort();
+    const uint32_t* GetOrder() const { return m_order.data(); }
+
+    // Следующая сортировка начнется с нуля (например, после скачка камеры)
+    void Invalidate() { m_order.clear(); }
+
+    const TransparencySortStats& GetStats() const { return m_stats; }
+    void ResetStats() { m_stats = {}; }
+
+private:
+    bool SortByInsertion(uint32_t moveBudget);
+    void SortByRadix();
+
+    std::vector<float> m_depths;
+    std::vector<uint32_t> m_order;
+    std::vector<uint32_t> m_keys;     // ключи в порядке m_order
+    std::vector<uint32_t> m_tempKeys;
+    std::vector<uint32_t> m_tempOrder;
+    TransparencySortStats m_stats;
+};
+
+struct TransparencyBenchmarkResult {
+    const char* scene = "";
+    uint32_t count = 0;
+    const char* method = "";
+    double millisecondsPerFrame = 0;
+    size_t orderErrors = 0; // соседние пары, нарушающие порядок больше чем на шаг квантования
+    TransparencySortStats stats;
+};
+
+// Объекты в кубе 200x200x200 в двух сценах: летящие частицы вокруг поворачивающейся камеры
+// (порядок меняется каждый кадр) и неподвижная листва, сквозь которую камера идет вперед.
+// Для каждой сцены и числа объектов: расстояние с корнем и std::sort, как раньше в Render,
+// поразрядная сортировка каждого кадра с нуля и очередь с порядком прошлого кадра.
+std::vector<TransparencyBenchmarkResult> RunTransparencyBenchmark(const uint32_t* pCounts, uint32_t countCount, uint32_t frameCount, uint32_t seed = 1);
@@ -0,0 +1,231 @@
+﻿#include "UploadRing.h"
+
+#include <chrono>
+#include <cstring>
+#include <random>
+#include <unordered_map>
+
+UploadRing::UploadRing(IUploadRingDevice& device, uint32_t capacity)
+    : m_device(device), m_capacity(capacity & ~(kAlignment - 1)) {
+}
+
+void UploadRing::BeginFrame() {
+    while (RetireOldestFrame(false)) {
+    }
+}
+
+bool UploadRing::Upload(const void* pData, uint32_t size, uint32_t& offset) {
+    const uint32_t paddedSize = (size + kAlignment - 1) & ~(kAlignment - 1);
+    if (size == 0 || paddedSize > m_capacity) {
+        m_stats.failedCount++;
+        return false;
+    }
+
+    // Блок не разрезается концом буфера: хвост пропускается и занят до конца кадра.
+    // Если места нет, ждем самый старый кадр; если у GPU кадров нет, блок не помещается.
+    for (;;) {
+        const uint32_t skippedBytes = m_head + paddedSize > m_capacity ? m_capacity - m_head : 0;
+        if (m_usedBytes + skippedBytes + paddedSize <= m_capacity) {
+            if (m_head + paddedSize > m_capacity) {
+                m_head = 0;
+                m_stats.wrapCount++;
+            }
+            m_usedBytes += skippedBytes + paddedSize;
+            m_frameBytes += skippedBytes + paddedSize;
+            m_stats.paddedByteCount += skippedBytes + paddedSize;
+            break;
+        }
+        if (!RetireOldestFrame(true)) {
+            m_stats.failedCount++;
+            return false;
+        }
+    }
+    offset = m_head;
+    m_head += paddedSize;
+
+    // Первое отображение - с discard, дальше без перезаписи: блоки у GPU не трогаются
+    uint8_t* pMemory = m_device.Map(!m_mapped);
+    m_stats.mapCount++;
+    if (!pMemory) {
+        m_stats.failedCount++;
+        return false;
+    }
+    m_mapped = true;
+    memcpy(pMemory + offset, pData, size);
+    m_device.Unmap();
+
+    m_stats.uploadCount++;
+    m_stats.byteCount += size;
+    return true;
+}
+
+void UploadRing::EndFrame() {
+    // Меток у устройства на kMaxFramesInFlight кадров
+    while (m_framesInFlight.size() >= kMaxFramesInFlight && RetireOldestFrame(true)) {
+    }
+    m_frame++;
+    m_device.SignalFrame(m_frame);
+    m_framesInFlight.push_back(FrameRecord{ m_frame, m_frameBytes });
+    m_frameBytes = 0;
+    m_stats.frameCount++;
+}
+
+bool UploadRing::RetireOldestFrame(bool wait) {
+    if (m_framesInFlight.empty()) {
+        return false;
+    }
+    const FrameRecord& record = m_framesInFlight.front();
+    if (!m_device.IsFrameComplete(record.frame, false)) {
+        if (!wait) {
+            return false;
+        }
+        m_stats.waitCount++;
+        if (!m_device.IsFrameComplete(record.frame, true)) {
+            return false;
+        }
+    }
+    m_usedBytes -= record.byteCount;
+    m_framesInFlight.pop_front();
+    // Пустое кольцо начинается с начала буфера - меньше пропусков при переходе через конец
+    if (m_usedBytes == 0) {
+        m_head = 0;
+    }
+    return true;
+}
+
+MockUploadRingDevice::MockUploadRingDevice(uint32_t capacity, uint32_t latency, std::function<void(uint64_t frame)> onComplete)
+    : m_memory(capacity), m_latency(latency), m_onComplete(std::move(onComplete)) {
+}
+
+uint8_t* MockUploadRingDevice::Map(bool discard) {
+    if (m_mapped) {
+        return nullptr;
+    }
+    if (discard) {
+        std::fill(m_memory.begin(), m_memory.end(), uint8_t(0xCD));
+    }
+    m_mapped = true;
+    return m_memory.data();
+}
+
+void MockUploadRingDevice::Unmap() {
+    m_mapped = false;
+}
+
+void MockUploadRingDevice::SignalFrame(uint64_t frame) {
+    m_lastSignaled = frame;
+    // GPU отстает от CPU на latency кадров
+    if (frame > m_latency) {
+        CompleteUpTo(frame - m_latency);
+    }
+}
+
+bool MockUploadRingDevice::IsFrameComplete(uint64_t frame, bool wait) {
+    if (wait) {
+        CompleteUpTo(frame < m_lastSignaled ? frame : m_lastSignaled);
+    }
+    return frame <= m_lastCompleted;
+}
+
+void MockUploadRingDevice::CompleteUpTo(uint64_t frame) {
+    while (m_lastCompleted < frame) {
+        m_lastCompleted++;
+        if (m_onComplete) {
+            m_onComplete(m_lastCompleted);
+        }
+    }
+}
+
+std::vector<UploadRingTestResult> RunUploadRingTest(uint32_t frameCount, uint32_t seed) {
+    struct Scenario {
+        const char* name;
+        uint32_t capacity;
+        uint32_t latency;
+        uint32_t minBlocks, maxBlocks;
+        uint32_t minSize, maxSize;
+        uint32_t oversizedEvery; // каждый такой кадр добавляет блок больше кольца; 0 - нет
+    };
+    // Константы lab6: GeomBuffer - 272 байта, SceneBuffer - 432, ColorBuffer - 16
+    const Scenario scenarios[] = {
+        { "scene", 1 << 20, 2, 8, 1200, 16, 432, 0 },
+        { "no gpu lag", 64 << 10, 0, 8, 100, 16, 432, 0 },
+        { "tight", 32 << 10, 3, 20, 50, 16, 432, 0 },
+        { "large", 64 << 10, 1, 1, 2, 4 << 10, 20 << 10, 10 },
+    };
+
+    std::vector<UploadRingTestResult> results;
+    for (const Scenario& scenario : scenarios) {
+        UploadRingTestResult result;
+        result.scenario = scenario.name;
+        result.capacity = scenario.capacity;
+        result.latency = scenario.latency;
+
+        // Блоки каждого кадра проверяются, когда "GPU" выполнил кадр: содержимое должно быть тем,
+        // что записали в этом кадре
+        struct Block {
+            uint32_t offset;
+            uint32_t size;
+            uint8_t seed;
+        };
+        std::unordered_map<uint64_t, std::vector<Block>> frameBlocks;
+        MockUploadRingDevice* pDevice = nullptr;
+        auto checkFrame = [&](uint64_t frame) {
+            auto it = frameBlocks.find(frame);
+            if (it == frameBlocks.end()) {
+                return;
+            }
+            for (const Block& block : it->second) {
+                const uint8_t* pData = pDevice->GetMemory() + block.offset;
+                for (uint32_t i = 0; i < block.size; i++) {
+                    if (pData[i] != static_cast<uint8_t>(block.seed + i * 31)) {
+                        result.corruptedCount++;
+                        break;
+                    }
+                }
+            }
+            frameBlocks.erase(it);
+        };
+        MockUploadRingDevice device(scenario.capacity, scenario.latency, checkFrame);
+        pDevice = &device;
+        UploadRing ring(device, scenario.capacity);
+
+        std::mt19937 random(seed);
+        std::uniform_int_distribution<uint32_t> blockCount(scenario.minBlocks, scenario.maxBlocks);
+        std::uniform_int_distribution<uint32_t> blockSize(scenario.minSize, scenario.maxSize);
+        std::vector<uint8_t> data(scenario.capacity + UploadRing::kAlignment);
+        double seconds = 0.0;
+        for (uint32_t frame = 1; frame <= frameCount; frame++) {
+            ring.BeginFrame();
+            std::vector<Block>& blocks = frameBlocks[frame];
+            const uint32_t count = blockCount(random);
+            const bool oversized = scenario.oversizedEvery > 0 && frame % scenario.oversizedEvery == 0;
+            for (uint32_t b = 0; b <= count; b++) {
+                if (b == count && !oversized) {
+                    break;
+                }
+                const uint32_t size = b < count ? blockSize(random) : static_cast<uint32_t>(data.size());
+                const uint8_t blockSeed = static_cast<uint8_t>(random());
+                for (uint32_t i = 0; i < size; i++) {
+                    data[i] = static_cast<uint8_t>(blockSeed + i * 31);
+                }
+                uint32_t offset = 0;
+                const auto startTime = std::chrono::steady_clock::now();
+                const bool uploaded = ring.Upload(data.data(), size, offset);
+                seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+                result.oversizedCount += b == count ? 1 : 0;
+                if (uploaded) {
+                    result.misalignedCount += offset % UploadRing::kAlignment != 0 || offset + size > scenario.capacity ? 1 : 0;
+                    blocks.push_back(Block{ offset, size, blockSeed });
+                }
+            }
+            ring.EndFrame();
+        }
+        // Оставшиеся кадры "GPU" дорисовывает в конце
+        device.IsFrameComplete(frameCount, true);
+
+        result.stats = ring.GetStats();
+        result.nanosecondsPerUpload = result.stats.uploadCount > 0 ? seconds * 1e9 / result.stats.uploadCount : 0.0;
+        results.push_back(result);
+    }
+    return results;
+}
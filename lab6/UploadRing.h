@@ -0,0 +1,127 @@
+﻿#pragma once
+
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <vector>
+
+// Кольцо загрузки констант: блоки всех константных буферов кадра выделяются подряд из одного
+// большого буфера и привязываются по смещению, вместо UpdateSubresource в отдельные буферы.
+// Память кадра возвращается в кольцо, когда GPU дошел до метки конца этого кадра.
+
+// Устройство под кольцом: отображение буфера и метки кадров. Реализации - D3D11 в lab6.cpp
+// (динамический буфер и запросы D3D11_QUERY_EVENT) и MockUploadRingDevice для проверки без GPU.
+class IUploadRingDevice {
+public:
+    virtual ~IUploadRingDevice() = default;
+
+    // Буфер для записи. discard - прежнее содержимое не нужно (первое отображение),
+    // иначе GPU может читать блоки, в которые кольцо не пишет
+    virtual uint8_t* Map(bool discard) = 0;
+    virtual void Unmap() = 0;
+
+    // Метка конца кадра в очереди команд
+    virtual void SignalFrame(uint64_t frame) = 0;
+    // GPU выполнил кадр; wait - дождаться этого
+    virtual bool IsFrameComplete(uint64_t frame, bool wait) = 0;
+};
+
+struct UploadRingStats {
+    uint64_t frameCount = 0;
+    uint64_t uploadCount = 0;      // блоков
+    uint64_t byteCount = 0;        // байтов данных
+    uint64_t paddedByteCount = 0;  // с выравниванием блоков и пропуском хвоста при переходе через конец
+    uint64_t mapCount = 0;
+    uint64_t wrapCount = 0;
+    uint64_t waitCount = 0;        // кольцо заполнено - ожидание кадра на GPU
+    uint64_t failedCount = 0;      // блок не поместился даже в пустое кольцо или отображение не удалось
+};
+
+class UploadRing {
+public:
+    // Смещение константного буфера в VSSetConstantBuffers1 - кратно 16 константам по 16 байт
+    static const uint32_t kAlignment = 256;
+    // Не больше стольких кадров одновременно у GPU
+    static const uint32_t kMaxFramesInFlight = 8;
+
+    // capacity округляется вниз до kAlignment
+    UploadRing(IUploadRingDevice& device, uint32_t capacity);
+
+    UploadRing(const UploadRing&) = delete;
+    UploadRing& operator=(const UploadRing&) = delete;
+
+    uint32_t GetCapacity() const { return m_capacity; }
+    uint32_t GetUsedBytes() const { return m_usedBytes; }
+
+    // Выполненные GPU кадры возвращают свою память, без ожидания
+    void BeginFrame();
+    // Копия данных в новый блок; offset - начало блока в буфере. false - блок не выделен,
+    // вызывающий обходится без кольца
+    bool Upload(const void* pData, uint32_t size, uint32_t& offset);
+    // Метка конца кадра: после нее память кадра можно использовать снова
+    void EndFrame();
+
+    const UploadRingStats& GetStats() const { return m_stats; }
+    void ResetStats() { m_stats = UploadRingStats(); }
+
+private:
+    struct FrameRecord {
+        uint64_t frame;
+        uint32_t byteCount; // занято кадром вместе с пропусками
+    };
+
+    // Вернуть память самого старого кадра у GPU; false, если его еще нет или он не выполнен
+    bool RetireOldestFrame(bool wait);
+
+    IUploadRingDevice& m_device;
+    uint32_t m_capacity = 0;
+    uint32_t m_head = 0;           // следующий свободный байт
+    uint32_t m_usedBytes = 0;      // от начала самого старого кадра у GPU до m_head
+    uint32_t m_frameBytes = 0;     // занято текущим кадром
+    uint64_t m_frame = 0;
+    bool m_mapped = false;         // буфер уже отображался с discard
+    std::deque<FrameRecord> m_framesInFlight;
+    UploadRingStats m_stats;
+};
+
+// Устройство без GPU: буфер в памяти, кадр считается выполненным через latency кадров после
+// своей метки (или сразу при ожидании). onComplete вызывается один раз для каждого выполненного
+// кадра - в этот момент "GPU" читает блоки кадра.
+class MockUploadRingDevice : public IUploadRingDevice {
+public:
+    MockUploadRingDevice(uint32_t capacity, uint32_t latency, std::function<void(uint64_t frame)> onComplete);
+
+    uint8_t* Map(bool discard) override;
+    void Unmap() override;
+    void SignalFrame(uint64_t frame) override;
+    bool IsFrameComplete(uint64_t frame, bool wait) override;
+
+    const uint8_t* GetMemory() const { return m_memory.data(); }
+    bool IsMapped() const { return m_mapped; }
+
+private:
+    void CompleteUpTo(uint64_t frame);
+
+    std::vector<uint8_t> m_memory;
+    uint32_t m_latency = 0;
+    std::function<void(uint64_t)> m_onComplete;
+    uint64_t m_lastSignaled = 0;
+    uint64_t m_lastCompleted = 0;
+    bool m_mapped = false;
+};
+
+struct UploadRingTestResult {
+    const char* scenario = "";
+    uint32_t capacity = 0;
+    uint32_t latency = 0;
+    UploadRingStats stats;
+    size_t corruptedCount = 0;     // блоки, которые кольцо перезаписало раньше, чем их прочитал GPU
+    size_t misalignedCount = 0;
+    uint64_t oversizedCount = 0;   // блоки больше кольца - должны дать столько же отказов
+    double nanosecondsPerUpload = 0;
+};
+
+// Кадры со случайным числом блоков случайного размера на MockUploadRingDevice с разной задержкой
+// GPU и размером кольца: переходы через конец, ожидания, блоки больше кольца. Блоки одного кадра
+// с учетом пропуска хвоста всегда помещаются в кольцо, поэтому отказы - только для блоков больше кольца.
+std::vector<UploadRingTestResult> RunUploadRingTest(uint32_t frameCount, uint32_t seed = 1);
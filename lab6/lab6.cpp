@@ -13,6 +13,32 @@ HRESULT CreateVertexBuffer(ID3D11Device* pDevice, ID3D11Buffer** ppVertexBuffer)
     return pDevice->CreateBuffer(&desc, &data, ppVertexBuffer);
 }
 
+// -packed: вершины куба в формате PackedTangentVertex (16 байт вместо 44) и cbuffer с AABB для
+// распаковки позиции в вершинном шейдере (b5)
+HRESULT CreatePackedVertexBuffer(ID3D11Device* pDevice, ID3D11Buffer** ppVertexBuffer, ID3D11Buffer** ppBoundsBuffer) {
+    const uint32_t vertexCount = ARRAYSIZE(Vertices);
+    const PackedVertexBounds bounds = ComputePackedVertexBounds(Vertices, vertexCount);
+    std::vector<PackedTangentVertex> packed(vertexCount);
+    PackVertices(packed.data(), Vertices, vertexCount, bounds);
+
+    D3D11_BUFFER_DESC desc = {};
+    desc.ByteWidth = static_cast<UINT>(packed.size() * sizeof(PackedTangentVertex));
+    desc.Usage = D3D11_USAGE_IMMUTABLE;
+    desc.BindFlags = D3D11_BIND_VERTEX_BUFFER;
+
+    D3D11_SUBRESOURCE_DATA data = {};
+    data.pSysMem = packed.data();
+    HRESULT hr = pDevice->CreateBuffer(&desc, &data, ppVertexBuffer);
+    if (FAILED(hr)) {
+        return hr;
+    }
+
+    desc.ByteWidth = sizeof(PackedVertexBounds);
+    desc.BindFlags = D3D11_BIND_CONSTANT_BUFFER;
+    data.pSysMem = &bounds;
+    return pDevice->CreateBuffer(&desc, &data, ppBoundsBuffer);
+}
+
 HRESULT CreateIndexBuffer(ID3D11Device* pDevice, ID3D11Buffer** ppIndexBuffer) {
     D3D11_BUFFER_DESC desc = {};
     desc.ByteWidth = sizeof(Indices);
@@ -52,17 +78,62 @@ HRESULT CreateSphereIndexBuffer(ID3D11Device* pDevice, ID3D11Buffer** ppIndexBuf
     return pDevice->CreateBuffer(&desc, &data, ppIndexBuffer);
 }
 
-HRESULT CompileShader(const char* shaderCode, const char* entryPoint, const char* target, ID3DBlob** ppCode) {
-    ID3DBlob* pErrorBlob = nullptr;
-    HRESULT hr = D3DCompile(shaderCode, strlen(shaderCode), nullptr, nullptr, nullptr, entryPoint, target, D3DCOMPILE_DEBUG | D3DCOMPILE_SKIP_OPTIMIZATION, 0, ppCode, &pErrorBlob);
-    if (FAILED(hr)) {
+// Компилятор для кэша шейдеров: D3DCompile, версия берется из заголовка d3dcompiler.h
+class D3DShaderCompiler : public IShaderCompiler {
+public:
+    std::string GetVersion() const override {
+        return "d3dcompiler_" + std::to_string(D3D_COMPILER_VERSION);
+    }
+
+    bool Compile(const ShaderCompileDesc& desc, std::vector<uint8_t>& bytecode, std::string& errors) override {
+        std::vector<D3D_SHADER_MACRO> macros;
+        for (uint32_t i = 0; i < desc.defineCount; i++) {
+            macros.push_back({ desc.pDefines[i].name, desc.pDefines[i].definition });
+        }
+        macros.push_back({ nullptr, nullptr });
+
+        ID3DBlob* pCode = nullptr;
+        ID3DBlob* pErrorBlob = nullptr;
+        HRESULT hr = D3DCompile(desc.pSource, desc.sourceSize, nullptr, macros.data(), nullptr, desc.entryPoint, desc.target, desc.flags, 0, &pCode, &pErrorBlob);
         if (pErrorBlob) {
-            OutputDebugStringA((char*)pErrorBlob->GetBufferPointer());
+            errors.assign(static_cast<const char*>(pErrorBlob->GetBufferPointer()), pErrorBlob->GetBufferSize());
             pErrorBlob->Release();
         }
+        if (FAILED(hr)) {
+            return false;
+        }
+        const uint8_t* pBytes = static_cast<const uint8_t*>(pCode->GetBufferPointer());
+        bytecode.assign(pBytes, pBytes + pCode->GetBufferSize());
+        pCode->Release();
+        return true;
+    }
+};
+
+// Байт-код берется из кэша на диске, компилируется только измененный шейдер
+HRESULT CompileShader(ShaderCache& shaderCache, const char* shaderCode, const char* entryPoint, const char* target, ID3DBlob** ppCode,
+    const ShaderMacro* pDefines = nullptr, uint32_t defineCount = 0) {
+    ShaderCompileDesc desc;
+    desc.pSource = shaderCode;
+    desc.sourceSize = strlen(shaderCode);
+    desc.entryPoint = entryPoint;
+    desc.target = target;
+    desc.pDefines = pDefines;
+    desc.defineCount = defineCount;
+    desc.flags = D3DCOMPILE_DEBUG | D3DCOMPILE_SKIP_OPTIMIZATION;
+
+    ShaderBytecode bytecode;
+    std::string errors;
+    if (!shaderCache.GetBytecode(desc, bytecode, &errors)) {
+        OutputDebugStringA(errors.c_str());
+        return E_FAIL;
+    }
+
+    // Копия в ID3DBlob: байт-код кэша действителен только до ShaderCache::Save()
+    HRESULT hr = D3DCreateBlob(bytecode.size, ppCode);
+    if (FAILED(hr)) {
         return hr;
     }
-    if (pErrorBlob) pErrorBlob->Release();
+    memcpy((*ppCode)->GetBufferPointer(), bytecode.pData, bytecode.size);
     return S_OK;
 }
 
@@ -75,113 +146,134 @@ HRESULT CreateInputLayout(ID3D11Device* pDevice, ID3D11InputLayout** ppInputLayo
     return pDevice->CreateInputLayout(inputDesc, ARRAYSIZE(inputDesc), pVertexShaderCode->GetBufferPointer(), pVertexShaderCode->GetBufferSize(), ppInputLayout);
 }
 
-bool LoadDDS(const std::wstring& filePath, TextureDesc& textureDesc) {
-    HRESULT hr = DirectX::LoadFromDDSFile(filePath.c_str(), DirectX::DDS_FLAGS_NONE, nullptr, textureDesc.image);
-    if (FAILED(hr)) {
-        return false;
-    }
-
-    const DirectX::TexMetadata& metadata = textureDesc.image.GetMetadata();
-    textureDesc.width = static_cast<UINT32>(metadata.width);
-    textureDesc.height = static_cast<UINT32>(metadata.height);
-    textureDesc.fmt = metadata.format;
-    textureDesc.mipmapsCount = static_cast<UINT32>(metadata.mipLevels);
-    textureDesc.pData = textureDesc.image.GetPixels();
-
-    return true;
+// Раскладка для инстансинга: вершина куба из слота 0, строки матриц InstanceData из слота 1
+HRESULT CreateInstancedInputLayout(ID3D11Device* pDevice, ID3D11InputLayout** ppInputLayout, ID3DBlob* pVertexShaderCode) {
+    D3D11_INPUT_ELEMENT_DESC inputDesc[] = {
+    {"POSITION", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 0, D3D11_INPUT_PER_VERTEX_DATA, 0},
+    {"NORMAL", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 12, D3D11_INPUT_PER_VERTEX_DATA, 0},
+    {"TANGENT", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 24, D3D11_INPUT_PER_VERTEX_DATA, 0},
+    {"TEXCOORD", 0, DXGI_FORMAT_R32G32_FLOAT, 0, 36, D3D11_INPUT_PER_VERTEX_DATA, 0},
+    {"INSTANCE_MODEL", 0, DXGI_FORMAT_R32G32B32A32_FLOAT, 1, 0, D3D11_INPUT_PER_INSTANCE_DATA, 1},
+    {"INSTANCE_MODEL", 1, DXGI_FORMAT_R32G32B32A32_FLOAT, 1, 16, D3D11_INPUT_PER_INSTANCE_DATA, 1},
+    {"INSTANCE_MODEL", 2, DXGI_FORMAT_R32G32B32A32_FLOAT, 1, 32, D3D11_INPUT_PER_INSTANCE_DATA, 1},
+    {"INSTANCE_MODEL", 3, DXGI_FORMAT_R32G32B32A32_FLOAT, 1, 48, D3D11_INPUT_PER_INSTANCE_DATA, 1},
+    {"INSTANCE_NORMAL", 0, DXGI_FORMAT_R32G32B32_FLOAT, 1, 64, D3D11_INPUT_PER_INSTANCE_DATA, 1},
+    {"INSTANCE_NORMAL", 1, DXGI_FORMAT_R32G32B32_FLOAT, 1, 80, D3D11_INPUT_PER_INSTANCE_DATA, 1},
+    {"INSTANCE_NORMAL", 2, DXGI_FORMAT_R32G32B32_FLOAT, 1, 96, D3D11_INPUT_PER_INSTANCE_DATA, 1}, };
+    return pDevice->CreateInputLayout(inputDesc, ARRAYSIZE(inputDesc), pVertexShaderCode->GetBufferPointer(), pVertexShaderCode->GetBufferSize(), ppInputLayout);
 }
 
-inline UINT32 DivUp(UINT32 value, UINT32 divisor) {
-    return (value + divisor - 1) / divisor;
+// Раскладки для PackedTangentVertex (шейдеры с PACKED_VERTEX): нормаль и касательная - один
+// атрибут NORMAL из четырех SNORM8
+HRESULT CreatePackedInputLayout(ID3D11Device* pDevice, ID3D11InputLayout** ppInputLayout, ID3DBlob* pVertexShaderCode) {
+    D3D11_INPUT_ELEMENT_DESC inputDesc[] = {
+    {"POSITION", 0, DXGI_FORMAT_R16G16B16A16_UNORM, 0, 0, D3D11_INPUT_PER_VERTEX_DATA, 0},
+    {"NORMAL", 0, DXGI_FORMAT_R8G8B8A8_SNORM, 0, 8, D3D11_INPUT_PER_VERTEX_DATA, 0},
+    {"TEXCOORD", 0, DXGI_FORMAT_R16G16_FLOAT, 0, 12, D3D11_INPUT_PER_VERTEX_DATA, 0}, };
+    return pDevice->CreateInputLayout(inputDesc, ARRAYSIZE(inputDesc), pVertexShaderCode->GetBufferPointer(), pVertexShaderCode->GetBufferSize(), ppInputLayout);
 }
 
-inline UINT32 GetBytesPerBlock(DXGI_FORMAT format) {
-    switch (format) {
-    case DXGI_FORMAT_BC1_UNORM:
-    case DXGI_FORMAT_BC1_UNORM_SRGB:
-    case DXGI_FORMAT_BC4_UNORM:
-    case DXGI_FORMAT_BC4_SNORM:
-        return 8;
-    case DXGI_FORMAT_BC2_UNORM:
-    case DXGI_FORMAT_BC2_UNORM_SRGB:
-    case DXGI_FORMAT_BC3_UNORM:
-    case DXGI_FORMAT_BC3_UNORM_SRGB:
-    case DXGI_FORMAT_BC5_UNORM:
-    case DXGI_FORMAT_BC5_SNORM:
-    case DXGI_FORMAT_BC6H_UF16:
-    case DXGI_FORMAT_BC6H_SF16:
-    case DXGI_FORMAT_BC7_UNORM:
-    case DXGI_FORMAT_BC7_UNORM_SRGB:
-        return 16;
-    case DXGI_FORMAT_R8G8B8A8_UNORM:
-    case DXGI_FORMAT_B8G8R8X8_UNORM:
-        return 4;
-    default:
-        return 0;
-    }
+HRESULT CreatePackedInstancedInputLayout(ID3D11Device* pDevice, ID3D11InputLayout** ppInputLayout, ID3DBlob* pVertexShaderCode) {
+    D3D11_INPUT_ELEMENT_DESC inputDesc[] = {
+    {"POSITION", 0, DXGI_FORMAT_R16G16B16A16_UNORM, 0, 0, D3D11_INPUT_PER_VERTEX_DATA, 0},
+    {"NORMAL", 0, DXGI_FORMAT_R8G8B8A8_SNORM, 0, 8, D3D11_INPUT_PER_VERTEX_DATA, 0},
+    {"TEXCOORD", 0, DXGI_FORMAT_R16G16_FLOAT, 0, 12, D3D11_INPUT_PER_VERTEX_DATA, 0},
+    {"INSTANCE_MODEL", 0, DXGI_FORMAT_R32G32B32A32_FLOAT, 1, 0, D3D11_INPUT_PER_INSTANCE_DATA, 1},
+    {"INSTANCE_MODEL", 1, DXGI_FORMAT_R32G32B32A32_FLOAT, 1, 16, D3D11_INPUT_PER_INSTANCE_DATA, 1},
+    {"INSTANCE_MODEL", 2, DXGI_FORMAT_R32G32B32A32_FLOAT, 1, 32, D3D11_INPUT_PER_INSTANCE_DATA, 1},
+    {"INSTANCE_MODEL", 3, DXGI_FORMAT_R32G32B32A32_FLOAT, 1, 48, D3D11_INPUT_PER_INSTANCE_DATA, 1},
+    {"INSTANCE_NORMAL", 0, DXGI_FORMAT_R32G32B32_FLOAT, 1, 64, D3D11_INPUT_PER_INSTANCE_DATA, 1},
+    {"INSTANCE_NORMAL", 1, DXGI_FORMAT_R32G32B32_FLOAT, 1, 80, D3D11_INPUT_PER_INSTANCE_DATA, 1},
+    {"INSTANCE_NORMAL", 2, DXGI_FORMAT_R32G32B32_FLOAT, 1, 96, D3D11_INPUT_PER_INSTANCE_DATA, 1}, };
+    return pDevice->CreateInputLayout(inputDesc, ARRAYSIZE(inputDesc), pVertexShaderCode->GetBufferPointer(), pVertexShaderCode->GetBufferSize(), ppInputLayout);
 }
 
-HRESULT CreateTexture(ID3D11Device* pDevice, const TextureDesc& textureDesc, ID3D11Texture2D** ppTexture) {
-    D3D11_TEXTURE2D_DESC desc = {};
-    desc.Width = textureDesc.width;
-    desc.Height = textureDesc.height;
-    desc.MipLevels = textureDesc.mipmapsCount;
-    desc.ArraySize = 1;
-    desc.Format = textureDesc.fmt;
-    desc.SampleDesc.Count = 1;
-    desc.SampleDesc.Quality = 0;
-    desc.Usage = D3D11_USAGE_IMMUTABLE;
-    desc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
-    desc.CPUAccessFlags = 0;
-    desc.MiscFlags = 0;
+// Уровень текстуры: из достроенной цепочки, если она есть, иначе прямо из файла
+const DdsSubresource& GetTextureSubresource(const TextureDesc& textureDesc, UINT32 mip) {
+    return textureDesc.pSource->GetSubresource(mip);
+}
 
-    UINT32 blockWidth = DivUp(desc.Width, 4u);
-    UINT32 blockHeight = DivUp(desc.Height, 4u);
-    UINT32 pitch = blockWidth * GetBytesPerBlock(desc.Format);
+// DDS-файл отображается в память без копирования; pData указывает на первый mip-уровень.
+// Данные общие для всех TextureDesc с тем же файлом (или тем же содержимым) и живут,
+// пока textureDesc.pSource не сброшен после создания текстур.
+// Если в файле не полная mip-цепочка, кэш достраивает ее на CPU.
+bool LoadDDS(const std::wstring& filePath, TextureDesc& textureDesc, TextureCache& textureCache) {
+    textureDesc.pSource = textureCache.Load(filePath);
+    if (!textureDesc.pSource) {
+        return false;
+    }
 
-    const char* pSrcData = reinterpret_cast<const char*>(textureDesc.pData);
-    std::vector<D3D11_SUBRESOURCE_DATA> data;
-    data.resize(desc.MipLevels);
+    textureDesc.width = textureDesc.pSource->GetWidth();
+    textureDesc.height = textureDesc.pSource->GetHeight();
+    textureDesc.fmt = static_cast<DXGI_FORMAT>(textureDesc.pSource->GetFormat());
+    textureDesc.mipmapsCount = textureDesc.pSource->GetMipLevels();
 
-    for (UINT32 i = 0; i < desc.MipLevels; i++) {
-        data[i].pSysMem = pSrcData;
-        data[i].SysMemPitch = pitch;
-        data[i].SysMemSlicePitch = 0;
-        pSrcData += pitch * blockHeight;
-        blockHeight = (blockHeight / 2) > 1 ? (blockHeight / 2) : 1;
-        blockWidth = (blockWidth / 2) > 1 ? (blockWidth / 2) : 1;
-        pitch = blockWidth * GetBytesPerBlock(desc.Format);
-    }
+    const DdsSubresource& top = GetTextureSubresource(textureDesc, 0);
+    textureDesc.pitch = top.rowPitch;
+    textureDesc.pData = top.pData;
 
-    return pDevice->CreateTexture2D(&desc, data.data(), ppTexture);
+    return true;
 }
 
-HRESULT CreateSphereTexture(ID3D11Device* pDevice, const TextureDesc* textureDesc, ID3D11Texture2D** ppCubemapTexture) {
-    D3D11_TEXTURE2D_DESC desc = {};
-    desc.Width = textureDesc[0].width;
-    desc.Height = textureDesc[0].height;
-    desc.MipLevels = 1;
-    desc.ArraySize = 6;
-    desc.Format = textureDesc[0].fmt;
-    desc.SampleDesc.Count = 1;
-    desc.SampleDesc.Quality = 0;
-    desc.Usage = D3D11_USAGE_IMMUTABLE;
-    desc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
-    desc.CPUAccessFlags = 0;
-    desc.MiscFlags = D3D11_RESOURCE_MISC_TEXTURECUBE;
+// Распаковка загруженной DDS-текстуры в RGBA8 для программного бэкенда. RGBA8 и BC-форматы -
+// без DirectXTex (DecodeSoftwareTexture, как и в безоконном режиме), остальные - через DirectXTex
+bool CreateSoftwareTexture(const TextureDesc& textureDesc, SoftwareTexture& texture) {
+    if (DecodeSoftwareTexture(*textureDesc.pSource, texture)) {
+        return true;
+    }
 
-    UINT32 blockWidth = DivUp(desc.Width, 4u);
-    UINT32 blockHeight = DivUp(desc.Height, 4u);
-    UINT32 pitch = blockWidth * GetBytesPerBlock(desc.Format);
+    const UINT32 mipLevels = textureDesc.mipmapsCount;
+    texture.mips.resize(mipLevels);
+
+    // Описания изображений ссылаются на отображенный файл, DirectXTex только читает их
+    DirectX::TexMetadata metadata = {};
+    metadata.width = textureDesc.width;
+    metadata.height = textureDesc.height;
+    metadata.depth = 1;
+    metadata.arraySize = 1;
+    metadata.mipLevels = mipLevels;
+    metadata.format = textureDesc.fmt;
+    metadata.dimension = DirectX::TEX_DIMENSION_TEXTURE2D;
+
+    std::vector<DirectX::Image> images(mipLevels);
+    for (UINT32 mip = 0; mip < mipLevels; mip++) {
+        const DdsSubresource& sub = GetTextureSubresource(textureDesc, mip);
+        images[mip].width = sub.width;
+        images[mip].height = sub.height;
+        images[mip].format = textureDesc.fmt;
+        images[mip].rowPitch = sub.rowPitch;
+        images[mip].slicePitch = sub.size;
+        images[mip].pixels = const_cast<uint8_t*>(sub.pData);
+    }
 
-    D3D11_SUBRESOURCE_DATA data[6];
-    for (UINT32 i = 0; i < 6; i++) {
-        data[i].pSysMem = textureDesc[i].pData;
-        data[i].SysMemPitch = pitch;
-        data[i].SysMemSlicePitch = 0;
+    DirectX::ScratchImage converted;
+    HRESULT hr;
+    if (DirectX::IsCompressed(textureDesc.fmt)) {
+        // Остается только BC6H
+        hr = DirectX::Decompress(images.data(), images.size(), metadata, DXGI_FORMAT_R8G8B8A8_UNORM, converted);
+    }
+    else {
+        hr = DirectX::Convert(images.data(), images.size(), metadata,
+            DXGI_FORMAT_R8G8B8A8_UNORM, DirectX::TEX_FILTER_DEFAULT, DirectX::TEX_THRESHOLD_DEFAULT, converted);
+    }
+    if (FAILED(hr)) {
+        return false;
     }
 
-    return pDevice->CreateTexture2D(&desc, data, ppCubemapTexture);
+    for (UINT32 mip = 0; mip < mipLevels; mip++) {
+        const DirectX::Image* pImage = converted.GetImage(mip, 0, 0);
+        if (!pImage) {
+            return false;
+        }
+        SoftwareTexture::Level& level = texture.mips[mip];
+        level.width = static_cast<uint32_t>(pImage->width);
+        level.height = static_cast<uint32_t>(pImage->height);
+        level.texels.resize(pImage->width * pImage->height);
+        for (size_t y = 0; y < pImage->height; y++) {
+            memcpy(level.texels.data() + y * pImage->width, pImage->pixels + y * pImage->rowPitch, pImage->width * sizeof(uint32_t));
+        }
+    }
+    return true;
 }
 
 HRESULT CreateShaderResourceView(ID3D11Device* pDevice, ID3D11Texture2D* pTexture, DXGI_FORMAT textureFmt, ID3D11ShaderResourceView** ppTextureView) {
@@ -198,12 +290,505 @@ HRESULT CreateShaderSphereResourceView(ID3D11Device* pDevice, ID3D11Texture2D* p
     D3D11_SHADER_RESOURCE_VIEW_DESC desc = {};
     desc.Format = textureFmt;
     desc.ViewDimension = D3D11_SRV_DIMENSION_TEXTURECUBE;
-    desc.TextureCube.MipLevels = 1;
+    desc.TextureCube.MipLevels = -1;
     desc.TextureCube.MostDetailedMip = 0;
 
     return pDevice->CreateShaderResourceView(pTexture, &desc, ppTextureView);
 }
 
+// Приемник потоковой загрузки поверх D3D11. Текстура создается пустой со всеми уровнями
+// (DEFAULT, уровни пишутся через UpdateSubresource), а SetResourceMinLOD не дает сэмплеру
+// читать еще не загруженные детальные уровни.
+class D3D11TextureUploadTarget : public ITextureUploadTarget {
+public:
+    D3D11TextureUploadTarget(ID3D11Device* pDevice, ID3D11DeviceContext* pDeviceContext)
+        : m_pDevice(pDevice), m_pDeviceContext(pDeviceContext) {
+    }
+    ~D3D11TextureUploadTarget() { Clear(); }
+
+    bool CreateTexture(uint32_t handle, uint32_t width, uint32_t height, uint32_t mipLevels,
+        uint32_t arraySize, bool cubemap, uint32_t format) override {
+        D3D11_TEXTURE2D_DESC desc = {};
+        desc.Width = width;
+        desc.Height = height;
+        desc.MipLevels = mipLevels;
+        desc.ArraySize = arraySize;
+        desc.Format = static_cast<DXGI_FORMAT>(format);
+        desc.SampleDesc.Count = 1;
+        desc.SampleDesc.Quality = 0;
+        desc.Usage = D3D11_USAGE_DEFAULT;
+        desc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
+        desc.CPUAccessFlags = 0;
+        desc.MiscFlags = cubemap ? D3D11_RESOURCE_MISC_TEXTURECUBE : 0;
+
+        if (m_resources.size() <= handle) {
+            m_resources.resize(handle + 1);
+        }
+        Resource& resource = m_resources[handle];
+        if (FAILED(m_pDevice->CreateTexture2D(&desc, nullptr, &resource.pTexture))) {
+            return false;
+        }
+        const HRESULT hr = cubemap ?
+            CreateShaderSphereResourceView(m_pDevice, resource.pTexture, desc.Format, &resource.pView) :
+            CreateShaderResourceView(m_pDevice, resource.pTexture, desc.Format, &resource.pView);
+        if (FAILED(hr)) {
+            resource.pTexture->Release();
+            resource.pTexture = nullptr;
+            return false;
+        }
+        resource.mipLevels = mipLevels;
+        resource.residentMip = mipLevels;
+        m_pDeviceContext->SetResourceMinLOD(resource.pTexture, static_cast<FLOAT>(mipLevels - 1));
+        return true;
+    }
+
+    void UploadMip(uint32_t handle, uint32_t item, uint32_t mip, const DdsSubresource& data) override {
+        const Resource& resource = m_resources[handle];
+        m_pDeviceContext->UpdateSubresource(resource.pTexture, D3D11CalcSubresource(mip, item, resource.mipLevels), nullptr,
+            data.pData, data.rowPitch, 0);
+    }
+
+    void SetMostDetailedMip(uint32_t handle, uint32_t mip) override {
+        Resource& resource = m_resources[handle];
+        resource.residentMip = mip;
+        m_pDeviceContext->SetResourceMinLOD(resource.pTexture, static_cast<FLOAT>(mip));
+    }
+
+    // nullptr, пока на устройстве нет ни одного уровня - шейдер читает нули
+    ID3D11ShaderResourceView* GetView(uint32_t handle) const {
+        if (handle >= m_resources.size() || m_resources[handle].residentMip >= m_resources[handle].mipLevels) {
+            return nullptr;
+        }
+        return m_resources[handle].pView;
+    }
+
+    void Clear() {
+        for (Resource& resource : m_resources) {
+            if (resource.pView) resource.pView->Release();
+            if (resource.pTexture) resource.pTexture->Release();
+        }
+        m_resources.clear();
+    }
+
+private:
+    struct Resource {
+        ID3D11Texture2D* pTexture = nullptr;
+        ID3D11ShaderResourceView* pView = nullptr;
+        UINT mipLevels = 0;
+        UINT residentMip = 0;
+    };
+
+    ID3D11Device* m_pDevice = nullptr;
+    ID3D11DeviceContext* m_pDeviceContext = nullptr;
+    std::vector<Resource> m_resources;
+};
+
+// Константные буферы через кольцо загрузки (D3D11.1): блоки кадра пишутся в один динамический
+// буфер с D3D11_MAP_WRITE_NO_OVERWRITE и привязываются по смещению через *SetConstantBuffers1,
+// конец кадра отмечается запросом D3D11_QUERY_EVENT. Без поддержки смещений, с ключом -nocbring
+// или если блок не поместился - UpdateSubresource в отдельный буфер, как раньше.
+// Константы с версией (FrameConstantVersions), пока версия меняется от кадра к кадру, идут
+// через кольцо; версия, повторившаяся в следующем кадре, один раз копируется в отдельный буфер,
+// и дальше он только привязывается - без загрузки, пока версия не изменится.
+class D3D11ConstantUploader : public IUploadRingDevice {
+public:
+    D3D11ConstantUploader(ID3D11Device* pDevice, ID3D11DeviceContext* pDeviceContext, uint32_t capacity)
+        : m_pDevice(pDevice), m_pDeviceContext(pDeviceContext), m_ring(*this, capacity) {
+    }
+    ~D3D11ConstantUploader() { Clear(); }
+
+    HRESULT Create() {
+        D3D11_FEATURE_DATA_D3D11_OPTIONS options = {};
+        HRESULT hr = m_pDevice->CheckFeatureSupport(D3D11_FEATURE_D3D11_OPTIONS, &options, sizeof(options));
+        if (SUCCEEDED(hr) && (!options.ConstantBufferOffsetting || !options.MapNoOverwriteOnDynamicConstantBuffer)) {
+            hr = E_NOTIMPL;
+        }
+        if (SUCCEEDED(hr)) {
+            hr = m_pDeviceContext->QueryInterface(__uuidof(ID3D11DeviceContext1), reinterpret_cast<void**>(&m_pDeviceContext1));
+        }
+        if (SUCCEEDED(hr)) {
+            D3D11_BUFFER_DESC desc = {};
+            desc.ByteWidth = m_ring.GetCapacity();
+            desc.Usage = D3D11_USAGE_DYNAMIC;
+            desc.BindFlags = D3D11_BIND_CONSTANT_BUFFER;
+            desc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+            hr = m_pDevice->CreateBuffer(&desc, nullptr, &m_pBuffer);
+        }
+        for (UINT i = 0; i < UploadRing::kMaxFramesInFlight && SUCCEEDED(hr); i++) {
+            D3D11_QUERY_DESC queryDesc = {};
+            queryDesc.Query = D3D11_QUERY_EVENT;
+            hr = m_pDevice->CreateQuery(&queryDesc, &m_queries[i]);
+        }
+        if (FAILED(hr)) {
+            Clear();
+        }
+        return hr;
+    }
+
+    bool IsRingEnabled() const { return m_pBuffer != nullptr; }
+
+    void BeginFrame() {
+        if (m_pBuffer) {
+            m_ring.BeginFrame();
+        }
+    }
+
+    void EndFrame() {
+        if (m_pBuffer) {
+            m_ring.EndFrame();
+        }
+        m_frameCount++;
+    }
+
+    void SetVS(UINT slot, const void* pData, UINT size, ID3D11Buffer* pFallbackBuffer) {
+        UINT firstConstant = 0;
+        UINT constantCount = 0;
+        if (Upload(pData, size, firstConstant, constantCount)) {
+            m_pDeviceContext1->VSSetConstantBuffers1(slot, 1, &m_pBuffer, &firstConstant, &constantCount);
+        }
+        else {
+            UpdateFallback(pFallbackBuffer, pData, size);
+            m_pDeviceContext->VSSetConstantBuffers(slot, 1, &pFallbackBuffer);
+        }
+    }
+
+    void SetPS(UINT slot, const void* pData, UINT size, ID3D11Buffer* pFallbackBuffer) {
+        UINT firstConstant = 0;
+        UINT constantCount = 0;
+        if (Upload(pData, size, firstConstant, constantCount)) {
+            m_pDeviceContext1->PSSetConstantBuffers1(slot, 1, &m_pBuffer, &firstConstant, &constantCount);
+        }
+        else {
+            UpdateFallback(pFallbackBuffer, pData, size);
+            m_pDeviceContext->PSSetConstantBuffers(slot, 1, &pFallbackBuffer);
+        }
+    }
+
+    void SetVS(UINT slot, const void* pData, UINT size, ID3D11Buffer* pBuffer, uint64_t version) {
+        UINT firstConstant = 0;
+        UINT constantCount = 0;
+        if (UploadVersioned(pBuffer, pData, size, version, firstConstant, constantCount)) {
+            m_pDeviceContext1->VSSetConstantBuffers1(slot, 1, &m_pBuffer, &firstConstant, &constantCount);
+        }
+        else {
+            m_pDeviceContext->VSSetConstantBuffers(slot, 1, &pBuffer);
+        }
+    }
+
+    void SetPS(UINT slot, const void* pData, UINT size, ID3D11Buffer* pBuffer, uint64_t version) {
+        UINT firstConstant = 0;
+        UINT constantCount = 0;
+        if (UploadVersioned(pBuffer, pData, size, version, firstConstant, constantCount)) {
+            m_pDeviceContext1->PSSetConstantBuffers1(slot, 1, &m_pBuffer, &firstConstant, &constantCount);
+        }
+        else {
+            m_pDeviceContext->PSSetConstantBuffers(slot, 1, &pBuffer);
+        }
+    }
+
+    // Загрузки через кольцо; UpdateSubresource и пропущенные загрузки неизменных констант считаются отдельно
+    const UploadRingStats& GetRingStats() const { return m_ring.GetStats(); }
+    uint64_t GetFrameCount() const { return m_frameCount; }
+    uint64_t GetFallbackCount() const { return m_fallbackCount; }
+    uint64_t GetFallbackBytes() const { return m_fallbackBytes; }
+    uint64_t GetSkippedCount() const { return m_skippedCount; }
+    uint64_t GetSkippedBytes() const { return m_skippedBytes; }
+    void ResetStats() {
+        m_ring.ResetStats();
+        m_frameCount = 0;
+        m_fallbackCount = 0;
+        m_fallbackBytes = 0;
+        m_skippedCount = 0;
+        m_skippedBytes = 0;
+    }
+
+    uint8_t* Map(bool discard) override {
+        D3D11_MAPPED_SUBRESOURCE mapped = {};
+        if (FAILED(m_pDeviceContext->Map(m_pBuffer, 0, discard ? D3D11_MAP_WRITE_DISCARD : D3D11_MAP_WRITE_NO_OVERWRITE, 0, &mapped))) {
+            return nullptr;
+        }
+        return static_cast<uint8_t*>(mapped.pData);
+    }
+
+    void Unmap() override {
+        m_pDeviceContext->Unmap(m_pBuffer, 0);
+    }
+
+    void SignalFrame(uint64_t frame) override {
+        m_pDeviceContext->End(m_queries[frame % UploadRing::kMaxFramesInFlight]);
+    }
+
+    bool IsFrameComplete(uint64_t frame, bool wait) override {
+        ID3D11Query* pQuery = m_queries[frame % UploadRing::kMaxFramesInFlight];
+        for (;;) {
+            // Без ожидания команды не отправляются драйверу - проверка ничего не стоит
+            const HRESULT hr = m_pDeviceContext->GetData(pQuery, nullptr, 0, wait ? 0 : D3D11_ASYNC_GETDATA_DONOTFLUSH);
+            // При потере устройства ждать нечего - память кадра свободна
+            if (hr != S_FALSE) {
+                return true;
+            }
+            if (!wait) {
+                return false;
+            }
+            SwitchToThread();
+        }
+    }
+
+    void Clear() {
+        for (ID3D11Query*& pQuery : m_queries) {
+            if (pQuery) pQuery->Release();
+            pQuery = nullptr;
+        }
+        if (m_pBuffer) m_pBuffer->Release();
+        if (m_pDeviceContext1) m_pDeviceContext1->Release();
+        m_pBuffer = nullptr;
+        m_pDeviceContext1 = nullptr;
+        m_bufferVersions.clear();
+    }
+
+private:
+    // Версии констант в отдельном буфере: загруженная в него и переданная в прошлый раз
+    struct BufferVersion {
+        ID3D11Buffer* pBuffer;
+        uint64_t resident;
+        uint64_t previous;
+    };
+
+    // Смещение и размер окна буфера - в константах по 16 байт
+    bool Upload(const void* pData, UINT size, UINT& firstConstant, UINT& constantCount) {
+        uint32_t offset = 0;
+        if (!m_pBuffer || !m_ring.Upload(pData, size, offset)) {
+            return false;
+        }
+        firstConstant = offset / 16;
+        constantCount = ((size + UploadRing::kAlignment - 1) & ~(UploadRing::kAlignment - 1)) / 16;
+        return true;
+    }
+
+    void UpdateFallback(ID3D11Buffer* pBuffer, const void* pData, UINT size) {
+        m_pDeviceContext->UpdateSubresource(pBuffer, 0, nullptr, pData, 0, 0);
+        m_fallbackCount++;
+        m_fallbackBytes += size;
+    }
+
+    // true - блок в кольце; false - привязывается pBuffer, загруженный сейчас или раньше
+    bool UploadVersioned(ID3D11Buffer* pBuffer, const void* pData, UINT size, uint64_t version, UINT& firstConstant, UINT& constantCount) {
+        BufferVersion* pState = nullptr;
+        for (BufferVersion& state : m_bufferVersions) {
+            if (state.pBuffer == pBuffer) {
+                pState = &state;
+                break;
+            }
+        }
+        if (!pState) {
+            m_bufferVersions.push_back(BufferVersion{ pBuffer, 0, 0 });
+            pState = &m_bufferVersions.back();
+        }
+
+        if (version != 0 && version == pState->resident) {
+            m_skippedCount++;
+            m_skippedBytes += size;
+            return false;
+        }
+        const bool changing = version == 0 || version != pState->previous;
+        pState->previous = version;
+        if (changing && Upload(pData, size, firstConstant, constantCount)) {
+            return true;
+        }
+        UpdateFallback(pBuffer, pData, size);
+        pState->resident = version;
+        return false;
+    }
+
+    ID3D11Device* m_pDevice = nullptr;
+    ID3D11DeviceContext* m_pDeviceContext = nullptr;
+    ID3D11DeviceContext1* m_pDeviceContext1 = nullptr;
+    ID3D11Buffer* m_pBuffer = nullptr;
+    ID3D11Query* m_queries[UploadRing::kMaxFramesInFlight] = {};
+    UploadRing m_ring;
+    uint64_t m_frameCount = 0;
+    uint64_t m_fallbackCount = 0;
+    uint64_t m_fallbackBytes = 0;
+    uint64_t m_skippedCount = 0;
+    uint64_t m_skippedBytes = 0;
+    std::vector<BufferVersion> m_bufferVersions;
+};
+
+// Сетки кубов сцены: общая геометрия, разные пиксельные шейдеры
+enum CubeMesh : uint32_t {
+    CubeMeshTextured = 0, // куб с текстурой и картой нормалей
+    CubeMeshLight = 1,    // маркер источника света
+    CubeMeshCount
+};
+
+// Отрисовка кубов через D3D11. По объектам: перед каждым DrawIndexed свой блок констант в кольце
+// загрузки (или UpdateSubresource общего буфера). С инстансингом: матрицы всех экземпляров кадра в одном динамическом вершинном
+// буфере (слот 1) и один DrawIndexedInstanced на сетку.
+class D3D11SceneDrawBackend : public ISceneDrawBackend {
+public:
+    D3D11SceneDrawBackend(ID3D11Device* pDevice, ID3D11DeviceContext* pDeviceContext, ID3D11Buffer* pGeomBuffer, D3D11ConstantUploader& constants)
+        : m_pDevice(pDevice), m_pDeviceContext(pDeviceContext), m_pGeomBuffer(pGeomBuffer), m_constants(constants) {
+    }
+    ~D3D11SceneDrawBackend() { Clear(); }
+
+    void SetShaders(ID3D11VertexShader* pVertexShader, ID3D11InputLayout* pInputLayout,
+        ID3D11VertexShader* pInstancedVertexShader, ID3D11InputLayout* pInstancedInputLayout) {
+        m_pVertexShader = pVertexShader;
+        m_pInputLayout = pInputLayout;
+        m_pInstancedVertexShader = pInstancedVertexShader;
+        m_pInstancedInputLayout = pInstancedInputLayout;
+    }
+
+    void SetMeshPixelShader(uint32_t mesh, ID3D11PixelShader* pPixelShader) {
+        m_pixelShaders[mesh] = pPixelShader;
+    }
+
+    // Кадры -instbench идут без Present: метка прошлого кадра, чтобы кольцо не переполнялось
+    void BeginFrame() override {
+        m_constants.EndFrame();
+        m_constants.BeginFrame();
+    }
+
+    void DrawObject(uint32_t mesh, const GeomBuffer& geom) override {
+        m_constants.SetVS(0, &geom, sizeof(GeomBuffer), m_pGeomBuffer);
+        m_pDeviceContext->PSSetShader(m_pixelShaders[mesh], nullptr, 0);
+        m_pDeviceContext->DrawIndexed(CubeIndexCount, 0, 0);
+    }
+
+    void DrawBatch(const GeomBuffer& camera, const InstanceBatch& batch) override {
+        const uint32_t instanceCount = batch.GetInstanceCount();
+        if (instanceCount == 0 || FAILED(ReserveInstanceBuffer(instanceCount))) {
+            return;
+        }
+        D3D11_MAPPED_SUBRESOURCE mapped = {};
+        if (FAILED(m_pDeviceContext->Map(m_pInstanceBuffer, 0, D3D11_MAP_WRITE_DISCARD, 0, &mapped))) {
+            return;
+        }
+        memcpy(mapped.pData, batch.GetData(), instanceCount * sizeof(InstanceData));
+        m_pDeviceContext->Unmap(m_pInstanceBuffer, 0);
+
+        m_constants.SetVS(0, &camera, sizeof(GeomBuffer), m_pGeomBuffer);
+        UINT stride = sizeof(InstanceData);
+        UINT offset = 0;
+        m_pDeviceContext->IASetVertexBuffers(1, 1, &m_pInstanceBuffer, &stride, &offset);
+        m_pDeviceContext->IASetInputLayout(m_pInstancedInputLayout);
+        m_pDeviceContext->VSSetShader(m_pInstancedVertexShader, nullptr, 0);
+        for (uint32_t mesh = 0; mesh < batch.GetMeshCount() && mesh < CubeMeshCount; mesh++) {
+            const InstanceRange& range = batch.GetMeshRange(mesh);
+            if (range.count == 0) {
+                continue;
+            }
+            m_pDeviceContext->PSSetShader(m_pixelShaders[mesh], nullptr, 0);
+            m_pDeviceContext->DrawIndexedInstanced(CubeIndexCount, range.count, 0, 0, range.first);
+        }
+
+        // Возвращаем состояние пути по объектам
+        m_pDeviceContext->IASetInputLayout(m_pInputLayout);
+        m_pDeviceContext->VSSetShader(m_pVertexShader, nullptr, 0);
+    }
+
+    void Clear() {
+        if (m_pInstanceBuffer) m_pInstanceBuffer->Release();
+        m_pInstanceBuffer = nullptr;
+        m_instanceCapacity = 0;
+    }
+
+private:
+    static const UINT CubeIndexCount = 36;
+
+    HRESULT ReserveInstanceBuffer(uint32_t instanceCount) {
+        if (instanceCount <= m_instanceCapacity) {
+            return S_OK;
+        }
+        Clear();
+        // С запасом, чтобы буфер не пересоздавался при каждом небольшом росте
+        const uint32_t capacity = instanceCount < 64 ? 64 : instanceCount + instanceCount / 2;
+        D3D11_BUFFER_DESC desc = {};
+        desc.ByteWidth = capacity * sizeof(InstanceData);
+        desc.Usage = D3D11_USAGE_DYNAMIC;
+        desc.BindFlags = D3D11_BIND_VERTEX_BUFFER;
+        desc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+        desc.MiscFlags = 0;
+        desc.StructureByteStride = 0;
+        HRESULT hr = m_pDevice->CreateBuffer(&desc, nullptr, &m_pInstanceBuffer);
+        if (SUCCEEDED(hr)) {
+            m_instanceCapacity = capacity;
+        }
+        return hr;
+    }
+
+    ID3D11Device* m_pDevice = nullptr;
+    ID3D11DeviceContext* m_pDeviceContext = nullptr;
+    ID3D11Buffer* m_pGeomBuffer = nullptr;
+    D3D11ConstantUploader& m_constants;
+    ID3D11VertexShader* m_pVertexShader = nullptr;
+    ID3D11InputLayout* m_pInputLayout = nullptr;
+    ID3D11VertexShader* m_pInstancedVertexShader = nullptr;
+    ID3D11InputLayout* m_pInstancedInputLayout = nullptr;
+    ID3D11PixelShader* m_pixelShaders[CubeMeshCount] = {};
+    ID3D11Buffer* m_pInstanceBuffer = nullptr;
+    uint32_t m_instanceCapacity = 0;
+};
+
+// Кубы кадра: вращающийся и неподвижный кубы и маркер света из FrameConstants плюс поле кубов (-cubes N)
+struct SceneCubes {
+    CubeField field;
+    InstanceBatch batch;
+    ISceneDrawBackend* pBackend = nullptr;
+    ThreadPool* pThreadPool = nullptr; // заполнение экземпляров поля
+    bool instanced = false;            // -instanced
+    UINT vertexStride = sizeof(TextureTangentVertex); // sizeof(PackedTangentVertex) с -packed
+    ID3D11Buffer* pPackedBoundsBuffer = nullptr;      // -packed: PackedVertexBounds (b5)
+    double time = 0.0;
+    std::vector<uint32_t> visibleCubes; // кубы поля в пирамиде видимости кадра
+};
+
+// Без -instanced каждый куб - свой блок констант и DrawIndexed, с -instanced - один вызов на сетку.
+// Кубы поля вне пирамиды видимости отбрасываются до подготовки их матриц.
+void DrawSceneCubes(SceneCubes& cubes, const FrameConstants& frame) {
+    ISceneDrawBackend& backend = *cubes.pBackend;
+    const Frustum frustum = ExtractFrustum(DirectX::XMMatrixMultiply(frame.geom.view, frame.geom.projection));
+    cubes.visibleCubes.resize(cubes.field.GetCubeCount());
+    const uint32_t visibleCount = CullSpheres(frustum, cubes.field.GetBounds(), cubes.visibleCubes.data(), GetBestCullPath());
+
+    if (!cubes.instanced) {
+        backend.DrawObject(CubeMeshTextured, frame.geom);
+        backend.DrawObject(CubeMeshTextured, frame.geom2);
+        SubmitPerObject(cubes.field, cubes.time, frame.geom, backend, cubes.visibleCubes.data(), visibleCount);
+        backend.DrawObject(CubeMeshLight, frame.lightGeom);
+        return;
+    }
+
+    const uint32_t instanceCounts[CubeMeshCount] = { 2 + visibleCount, 1 };
+    cubes.batch.Reset(instanceCounts, CubeMeshCount);
+    cubes.batch.SetInstance(CubeMeshTextured, 0, frame.geom.model, frame.geom.normalMatrix);
+    cubes.batch.SetInstance(CubeMeshTextured, 1, frame.geom2.model, frame.geom2.normalMatrix);
+    cubes.field.FillInstances(cubes.time, cubes.visibleCubes.data(), visibleCount, cubes.batch.GetMeshInstances(CubeMeshTextured) + 2, cubes.pThreadPool);
+    cubes.batch.SetInstance(CubeMeshLight, 0, frame.lightGeom.model, frame.lightGeom.normalMatrix);
+    backend.DrawBatch(frame.geom, cubes.batch);
+}
+
+// Состояние конвейера для кубов: сетка куба, шейдеры пути по объектам, семплер и текстуры.
+// Сжатые вершины (-packed) распаковываются с AABB из pPackedBoundsBuffer
+void SetCubeState(ID3D11DeviceContext* pDeviceContext, ID3D11Buffer* pIndexBuffer, ID3D11Buffer* pVertexBuffer, UINT vertexStride,
+    ID3D11Buffer* pPackedBoundsBuffer, ID3D11InputLayout* pInputLayout, ID3D11VertexShader* pVertexShader, ID3D11SamplerState* pSampler,
+    ID3D11ShaderResourceView* pTextureView, ID3D11ShaderResourceView* pTextureNormalView) {
+    pDeviceContext->PSSetShaderResources(1, 1, &pTextureNormalView); // Карта нормалей (t1)
+    pDeviceContext->IASetIndexBuffer(pIndexBuffer, DXGI_FORMAT_R16_UINT, 0);
+    ID3D11Buffer* vertexBuffers[] = { pVertexBuffer };
+    UINT strides[] = { vertexStride };
+    UINT offsets[] = { 0 };
+    pDeviceContext->IASetVertexBuffers(0, 1, vertexBuffers, strides, offsets);
+    if (pPackedBoundsBuffer) {
+        pDeviceContext->VSSetConstantBuffers(5, 1, &pPackedBoundsBuffer);
+    }
+    pDeviceContext->IASetInputLayout(pInputLayout);
+    pDeviceContext->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+    pDeviceContext->VSSetShader(pVertexShader, nullptr, 0);
+    pDeviceContext->PSSetSamplers(0, 1, &pSampler);
+    pDeviceContext->PSSetShaderResources(0, 1, &pTextureView);
+}
+
 HRESULT CreateSampler(ID3D11Device* pDevice, ID3D11SamplerState** ppSampler) {
     D3D11_SAMPLER_DESC desc = {};
     desc.Filter = D3D11_FILTER_ANISOTROPIC;
@@ -246,38 +831,313 @@ HRESULT CreateSquareIndexBuffer(ID3D11Device* pDevice, ID3D11Buffer** ppIndexBuf
     return pDevice->CreateBuffer(&desc, &data, ppIndexBuffer);
 }
 
-float CalculateDistance(const DirectX::XMFLOAT3& a, const DirectX::XMFLOAT3& b) {
-    return sqrtf((a.x - b.x) * (a.x - b.x) +
-        (a.y - b.y) * (a.y - b.y) +
-        (a.z - b.z) * (a.z - b.z));
-}
+// Взвешенное смешивание без порядка (-oit): полупрозрачные объекты рисуются в любом порядке в две
+// цели - сумму цветов с весами (RGBA16F) и произведение прозрачностей (R16F), затем один
+// полноэкранный проход сводит их с кадром. Эталон и сравнение с сортировкой на CPU - OitReference.
+class WeightedOitPass {
+public:
+    ~WeightedOitPass() { Clear(); }
+
+    HRESULT Create(ID3D11Device* pDevice, ShaderCache& shaderCache, UINT width, UINT height) {
+        HRESULT hr = CreateTarget(pDevice, width, height, DXGI_FORMAT_R16G16B16A16_FLOAT, &m_pAccumTexture, &m_pAccumTarget, &m_pAccumView);
+        if (SUCCEEDED(hr)) {
+            hr = CreateTarget(pDevice, width, height, DXGI_FORMAT_R16_FLOAT, &m_pRevealageTexture, &m_pRevealageTarget, &m_pRevealageView);
+        }
 
-DirectX::XMFLOAT3 GetSquareCenter(UINT startVertex) {
-    DirectX::XMFLOAT3 center = { 0.0f, 0.0f, 0.0f };
+        ID3DBlob* pPixelShaderBlob = nullptr;
+        ID3DBlob* pCompositeVertexShaderBlob = nullptr;
+        ID3DBlob* pCompositePixelShaderBlob = nullptr;
+        if (SUCCEEDED(hr)) {
+            hr = CompileShader(shaderCache, pixelColorShaderCode, "psOit", "ps_5_0", &pPixelShaderBlob);
+        }
+        if (SUCCEEDED(hr)) {
+            hr = CompileShader(shaderCache, oitCompositeShaderCode, "vs", "vs_5_0", &pCompositeVertexShaderBlob);
+        }
+        if (SUCCEEDED(hr)) {
+            hr = CompileShader(shaderCache, oitCompositeShaderCode, "ps", "ps_5_0", &pCompositePixelShaderBlob);
+        }
+        if (SUCCEEDED(hr)) {
+            hr = pDevice->CreatePixelShader(pPixelShaderBlob->GetBufferPointer(), pPixelShaderBlob->GetBufferSize(), nullptr, &m_pPixelShader);
+        }
+        if (SUCCEEDED(hr)) {
+            hr = pDevice->CreateVertexShader(pCompositeVertexShaderBlob->GetBufferPointer(), pCompositeVertexShaderBlob->GetBufferSize(), nullptr, &m_pCompositeVertexShader);
+        }
+        if (SUCCEEDED(hr)) {
+            hr = pDevice->CreatePixelShader(pCompositePixelShaderBlob->GetBufferPointer(), pCompositePixelShaderBlob->GetBufferSize(), nullptr, &m_pCompositePixelShader);
+        }
+        if (pPixelShaderBlob) pPixelShaderBlob->Release();
+        if (pCompositeVertexShaderBlob) pCompositeVertexShaderBlob->Release();
+        if (pCompositePixelShaderBlob) pCompositePixelShaderBlob->Release();
+
+        // Накопление: сумма в первой цели, dst * (1 - a) во второй
+        D3D11_BLEND_DESC blendDesc = {};
+        blendDesc.IndependentBlendEnable = TRUE;
+        blendDesc.RenderTarget[0].BlendEnable = TRUE;
+        blendDesc.RenderTarget[0].SrcBlend = D3D11_BLEND_ONE;
+        blendDesc.RenderTarget[0].DestBlend = D3D11_BLEND_ONE;
+        blendDesc.RenderTarget[0].BlendOp = D3D11_BLEND_OP_ADD;
+        blendDesc.RenderTarget[0].SrcBlendAlpha = D3D11_BLEND_ONE;
+        blendDesc.RenderTarget[0].DestBlendAlpha = D3D11_BLEND_ONE;
+        blendDesc.RenderTarget[0].BlendOpAlpha = D3D11_BLEND_OP_ADD;
+        blendDesc.RenderTarget[0].RenderTargetWriteMask = D3D11_COLOR_WRITE_ENABLE_ALL;
+        blendDesc.RenderTarget[1].BlendEnable = TRUE;
+        blendDesc.RenderTarget[1].SrcBlend = D3D11_BLEND_ZERO;
+        blendDesc.RenderTarget[1].DestBlend = D3D11_BLEND_INV_SRC_COLOR;
+        blendDesc.RenderTarget[1].BlendOp = D3D11_BLEND_OP_ADD;
+        blendDesc.RenderTarget[1].SrcBlendAlpha = D3D11_BLEND_ZERO;
+        blendDesc.RenderTarget[1].DestBlendAlpha = D3D11_BLEND_INV_SRC_ALPHA;
+        blendDesc.RenderTarget[1].BlendOpAlpha = D3D11_BLEND_OP_ADD;
+        blendDesc.RenderTarget[1].RenderTargetWriteMask = D3D11_COLOR_WRITE_ENABLE_RED;
+        if (SUCCEEDED(hr)) {
+            hr = pDevice->CreateBlendState(&blendDesc, &m_pAccumulateBlendState);
+        }
+
+        // Сведение: обычное смешивание поверх кадра, как у отсортированных квадратов
+        blendDesc = {};
+        blendDesc.RenderTarget[0].BlendEnable = TRUE;
+        blendDesc.RenderTarget[0].SrcBlend = D3D11_BLEND_SRC_ALPHA;
+        blendDesc.RenderTarget[0].DestBlend = D3D11_BLEND_INV_SRC_ALPHA;
+        blendDesc.RenderTarget[0].BlendOp = D3D11_BLEND_OP_ADD;
+        blendDesc.RenderTarget[0].SrcBlendAlpha = D3D11_BLEND_ONE;
+        blendDesc.RenderTarget[0].DestBlendAlpha = D3D11_BLEND_ZERO;
+        blendDesc.RenderTarget[0].BlendOpAlpha = D3D11_BLEND_OP_ADD;
+        blendDesc.RenderTarget[0].RenderTargetWriteMask = D3D11_COLOR_WRITE_ENABLE_RED | D3D11_COLOR_WRITE_ENABLE_GREEN | D3D11_COLOR_WRITE_ENABLE_BLUE;
+        if (SUCCEEDED(hr)) {
+            hr = pDevice->CreateBlendState(&blendDesc, &m_pCompositeBlendState);
+        }
 
-    // Суммируем координаты вершин квадрата
-    for (UINT i = 0; i < 4; ++i) {
-        center.x += SquareVertices[startVertex + i].x;
-        center.y += SquareVertices[startVertex + i].y;
-        center.z += SquareVertices[startVertex + i].z;
+        if (FAILED(hr)) {
+            Clear();
+        }
+        return hr;
     }
 
-    // Вычисляем среднее значение (центр)
-    center.x /= 4.0f;
-    center.y /= 4.0f;
-    center.z /= 4.0f;
+    ID3D11PixelShader* GetPixelShader() const { return m_pPixelShader; }
+
+    // Очистка целей и их установка вместо кадра; буфер глубины сцены остается для проверки глубины
+    void Begin(ID3D11DeviceContext* pDeviceContext, ID3D11DepthStencilView* pDepthStencilView) {
+        static const FLOAT accumClear[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+        static const FLOAT revealageClear[4] = { 1.0f, 1.0f, 1.0f, 1.0f };
+        pDeviceContext->ClearRenderTargetView(m_pAccumTarget, accumClear);
+        pDeviceContext->ClearRenderTargetView(m_pRevealageTarget, revealageClear);
+        ID3D11RenderTargetView* targets[] = { m_pAccumTarget, m_pRevealageTarget };
+        pDeviceContext->OMSetRenderTargets(2, targets, pDepthStencilView);
+        pDeviceContext->OMSetBlendState(m_pAccumulateBlendState, nullptr, 0xFFFFFFFF);
+    }
+
+    // Сведение с кадром pRenderTargetView и возврат его целей
+    void Composite(ID3D11DeviceContext* pDeviceContext, ID3D11RenderTargetView* pRenderTargetView, ID3D11DepthStencilView* pDepthStencilView) {
+        pDeviceContext->OMSetRenderTargets(1, &pRenderTargetView, nullptr);
+        pDeviceContext->OMSetBlendState(m_pCompositeBlendState, nullptr, 0xFFFFFFFF);
+        ID3D11ShaderResourceView* views[] = { m_pAccumView, m_pRevealageView };
+        pDeviceContext->PSSetShaderResources(0, 2, views);
+        pDeviceContext->IASetInputLayout(nullptr);
+        pDeviceContext->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+        pDeviceContext->VSSetShader(m_pCompositeVertexShader, nullptr, 0);
+        pDeviceContext->PSSetShader(m_pCompositePixelShader, nullptr, 0);
+        pDeviceContext->Draw(3, 0);
+
+        // Цели следующего кадра нельзя установить, пока они привязаны как текстуры
+        ID3D11ShaderResourceView* nullViews[] = { nullptr, nullptr };
+        pDeviceContext->PSSetShaderResources(0, 2, nullViews);
+        pDeviceContext->OMSetRenderTargets(1, &pRenderTargetView, pDepthStencilView);
+    }
+
+    void Clear() {
+        ID3D11DeviceChild* resources[] = { m_pAccumTexture, m_pAccumTarget, m_pAccumView, m_pRevealageTexture, m_pRevealageTarget, m_pRevealageView,
+            m_pPixelShader, m_pCompositeVertexShader, m_pCompositePixelShader, m_pAccumulateBlendState, m_pCompositeBlendState };
+        for (ID3D11DeviceChild* pResource : resources) {
+            if (pResource) pResource->Release();
+        }
+        m_pAccumTexture = nullptr;
+        m_pAccumTarget = nullptr;
+        m_pAccumView = nullptr;
+        m_pRevealageTexture = nullptr;
+        m_pRevealageTarget = nullptr;
+        m_pRevealageView = nullptr;
+        m_pPixelShader = nullptr;
+        m_pCompositeVertexShader = nullptr;
+        m_pCompositePixelShader = nullptr;
+        m_pAccumulateBlendState = nullptr;
+        m_pCompositeBlendState = nullptr;
+    }
 
-    return center;
+private:
+    static HRESULT CreateTarget(ID3D11Device* pDevice, UINT width, UINT height, DXGI_FORMAT format,
+        ID3D11Texture2D** ppTexture, ID3D11RenderTargetView** ppTarget, ID3D11ShaderResourceView** ppView) {
+        D3D11_TEXTURE2D_DESC desc = {};
+        desc.Width = width;
+        desc.Height = height;
+        desc.MipLevels = 1;
+        desc.ArraySize = 1;
+        desc.Format = format;
+        desc.SampleDesc.Count = 1;
+        desc.SampleDesc.Quality = 0;
+        desc.Usage = D3D11_USAGE_DEFAULT;
+        desc.BindFlags = D3D11_BIND_RENDER_TARGET | D3D11_BIND_SHADER_RESOURCE;
+        desc.CPUAccessFlags = 0;
+        desc.MiscFlags = 0;
+        HRESULT hr = pDevice->CreateTexture2D(&desc, nullptr, ppTexture);
+        if (SUCCEEDED(hr)) {
+            hr = pDevice->CreateRenderTargetView(*ppTexture, nullptr, ppTarget);
+        }
+        if (SUCCEEDED(hr)) {
+            hr = pDevice->CreateShaderResourceView(*ppTexture, nullptr, ppView);
+        }
+        return hr;
+    }
+
+    ID3D11Texture2D* m_pAccumTexture = nullptr;
+    ID3D11RenderTargetView* m_pAccumTarget = nullptr;
+    ID3D11ShaderResourceView* m_pAccumView = nullptr;
+    ID3D11Texture2D* m_pRevealageTexture = nullptr;
+    ID3D11RenderTargetView* m_pRevealageTarget = nullptr;
+    ID3D11ShaderResourceView* m_pRevealageView = nullptr;
+    ID3D11PixelShader* m_pPixelShader = nullptr;
+    ID3D11VertexShader* m_pCompositeVertexShader = nullptr;
+    ID3D11PixelShader* m_pCompositePixelShader = nullptr;
+    ID3D11BlendState* m_pAccumulateBlendState = nullptr;
+    ID3D11BlendState* m_pCompositeBlendState = nullptr;
+};
+
+// Точечные источники режима -lights на устройстве: источники, диапазоны кластеров и индексы -
+// динамические структурированные буферы (t2-t4), константы сетки - b4. Буферы растут по мере
+// надобности и перезаписываются целиком каждый кадр.
+class D3D11LightClusterBuffers {
+public:
+    ~D3D11LightClusterBuffers() { Clear(); }
+
+    HRESULT Update(ID3D11Device* pDevice, ID3D11DeviceContext* pDeviceContext, const LightClusterGrid& grid,
+        const PointLight* pLights, uint32_t lightCount, UINT width, UINT height) {
+        const LightClusterDesc& desc = grid.GetDesc();
+        HRESULT hr = Upload(pDevice, pDeviceContext, m_lights, pLights, lightCount, sizeof(PointLight));
+        if (SUCCEEDED(hr)) {
+            hr = Upload(pDevice, pDeviceContext, m_clusters, grid.GetClusters(), desc.GetClusterCount(), sizeof(LightClusterRange));
+        }
+        if (SUCCEEDED(hr)) {
+            hr = Upload(pDevice, pDeviceContext, m_indices, grid.GetLightIndices(), grid.GetLightIndexCount(), sizeof(uint32_t));
+        }
+
+        ClusterBuffer clusterBuffer;
+        clusterBuffer.clusterGrid = DirectX::XMFLOAT4(static_cast<float>(width) / desc.tilesX, static_cast<float>(height) / desc.tilesY,
+            static_cast<float>(desc.tilesX), static_cast<float>(desc.tilesY));
+        // Если буферы не обновились, шейдер обходится источниками из SceneBuffer
+        clusterBuffer.clusterDepth = DirectX::XMFLOAT4(grid.GetSliceScale(), grid.GetSliceBias(), static_cast<float>(desc.slices), SUCCEEDED(hr) ? 1.0f : 0.0f);
+        if (!m_pClusterBuffer) {
+            D3D11_BUFFER_DESC bufferDesc = {};
+            bufferDesc.ByteWidth = sizeof(ClusterBuffer);
+            bufferDesc.Usage = D3D11_USAGE_DEFAULT;
+            bufferDesc.BindFlags = D3D11_BIND_CONSTANT_BUFFER;
+            const HRESULT createResult = pDevice->CreateBuffer(&bufferDesc, nullptr, &m_pClusterBuffer);
+            if (FAILED(createResult)) {
+                return createResult;
+            }
+        }
+        pDeviceContext->UpdateSubresource(m_pClusterBuffer, 0, nullptr, &clusterBuffer, 0, 0);
+        return hr;
+    }
+
+    void Bind(ID3D11DeviceContext* pDeviceContext) {
+        ID3D11ShaderResourceView* views[] = { m_lights.pView, m_clusters.pView, m_indices.pView };
+        pDeviceContext->PSSetShaderResources(2, 3, views);
+        pDeviceContext->PSSetConstantBuffers(4, 1, &m_pClusterBuffer);
+    }
+
+    void Clear() {
+        for (StructuredBuffer* pBuffer : { &m_lights, &m_clusters, &m_indices }) {
+            if (pBuffer->pView) pBuffer->pView->Release();
+            if (pBuffer->pBuffer) pBuffer->pBuffer->Release();
+            *pBuffer = StructuredBuffer();
+        }
+        if (m_pClusterBuffer) m_pClusterBuffer->Release();
+        m_pClusterBuffer = nullptr;
+    }
+
+private:
+    struct StructuredBuffer {
+        ID3D11Buffer* pBuffer = nullptr;
+        ID3D11ShaderResourceView* pView = nullptr;
+        uint32_t capacity = 0;
+    };
+
+    // Буфер пересоздается с запасом, если данные не помещаются; пустой буфер получает один элемент
+    static HRESULT Upload(ID3D11Device* pDevice, ID3D11DeviceContext* pDeviceContext, StructuredBuffer& buffer,
+        const void* pData, uint32_t count, UINT stride) {
+        if (count > buffer.capacity || !buffer.pBuffer) {
+            if (buffer.pView) buffer.pView->Release();
+            if (buffer.pBuffer) buffer.pBuffer->Release();
+            buffer = StructuredBuffer();
+            const uint32_t capacity = count > 64 ? count + count / 2 : 64;
+
+            D3D11_BUFFER_DESC desc = {};
+            desc.ByteWidth = capacity * stride;
+            desc.Usage = D3D11_USAGE_DYNAMIC;
+            desc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
+            desc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+            desc.MiscFlags = D3D11_RESOURCE_MISC_BUFFER_STRUCTURED;
+            desc.StructureByteStride = stride;
+            HRESULT hr = pDevice->CreateBuffer(&desc, nullptr, &buffer.pBuffer);
+            if (FAILED(hr)) {
+                return hr;
+            }
+
+            D3D11_SHADER_RESOURCE_VIEW_DESC viewDesc = {};
+            viewDesc.Format = DXGI_FORMAT_UNKNOWN;
+            viewDesc.ViewDimension = D3D11_SRV_DIMENSION_BUFFER;
+            viewDesc.Buffer.FirstElement = 0;
+            viewDesc.Buffer.NumElements = capacity;
+            hr = pDevice->CreateShaderResourceView(buffer.pBuffer, &viewDesc, &buffer.pView);
+            if (FAILED(hr)) {
+                buffer.pBuffer->Release();
+                buffer.pBuffer = nullptr;
+                return hr;
+            }
+            buffer.capacity = capacity;
+        }
+
+        D3D11_MAPPED_SUBRESOURCE mapped = {};
+        const HRESULT hr = pDeviceContext->Map(buffer.pBuffer, 0, D3D11_MAP_WRITE_DISCARD, 0, &mapped);
+        if (FAILED(hr)) {
+            return hr;
+        }
+        if (count > 0) {
+            memcpy(mapped.pData, pData, static_cast<size_t>(count) * stride);
+        }
+        pDeviceContext->Unmap(buffer.pBuffer, 0);
+        return S_OK;
+    }
+
+    StructuredBuffer m_lights;
+    StructuredBuffer m_clusters;
+    StructuredBuffer m_indices;
+    ID3D11Buffer* m_pClusterBuffer = nullptr;
+};
+
+// Точечные источники вокруг кубов для режима -lights N: радиусы 0.5-2, приглушенные цвета
+std::vector<PointLight> GeneratePointLights(uint32_t count, uint32_t seed) {
+    std::mt19937 random(seed);
+    std::uniform_real_distribution<float> position(-12.0f, 12.0f);
+    std::uniform_real_distribution<float> radius(0.5f, 2.0f);
+    std::uniform_real_distribution<float> channel(0.1f, 0.6f);
+    std::vector<PointLight> lights(count);
+    for (PointLight& light : lights) {
+        light.position = DirectX::XMFLOAT3(position(random), position(random), position(random));
+        light.radius = radius(random);
+        light.color = DirectX::XMFLOAT3(channel(random), channel(random), channel(random));
+        light.padding = 0.0f;
+    }
+    return lights;
 }
 
 void Render(ID3D11DeviceContext* pDeviceContext, ID3D11RenderTargetView* pRenderTargetView, ID3D11DepthStencilView* pDepthStencilView,
     ID3D11Buffer* pIndexBuffer, ID3D11Buffer* pVertexBuffer, ID3D11InputLayout* pInputLayout, ID3D11VertexShader* pVertexShader,
-    ID3D11PixelShader* pPixelShader, ID3D11Buffer* pGeomBuffer, ID3D11Buffer* pGeomBuffer2, ID3D11SamplerState* pSampler, ID3D11ShaderResourceView* pTextureView,
+    ID3D11SamplerState* pSampler, ID3D11ShaderResourceView* pTextureView,
     ID3D11Buffer* pSphereIndexBuffer, ID3D11Buffer* pSphereVertexBuffer, ID3D11InputLayout* pSphereInputLayout, ID3D11VertexShader* pSphereVertexShader,
     ID3D11PixelShader* pSpherePixelShader, ID3D11Buffer* pSphereGeomBuffer, ID3D11Buffer* pSphereSceneBuffer, ID3D11ShaderResourceView* pSphereTextureView,
     ID3D11Buffer* pSquareVertexBuffer, ID3D11Buffer* pSquareIndexBuffer, ID3D11InputLayout* pSquareInputLayout, ID3D11VertexShader* pSquareVertexShader,
     ID3D11PixelShader* pSquarePixelShader, ID3D11Buffer* pSquareGeomBuffer, ID3D11Buffer* pColorBuffer, ID3D11RasterizerState* pNoCullRasterizerState,
-    ID3D11BlendState* pTransBlendState, ID3D11DepthStencilState* pNoWriteDepthStencilState, const DirectX::XMFLOAT3& cameraPosition, ID3D11Buffer* pSceneBuffer, ID3D11Buffer* pMaterialBuffer, ID3D11Buffer* pLightGeomBuffer, ID3D11PixelShader* pLightPixelShader, ID3D11ShaderResourceView* pTextureNormalView)
+    ID3D11BlendState* pTransBlendState, ID3D11DepthStencilState* pNoWriteDepthStencilState, TransparencyQueue& transparencyQueue, WeightedOitPass* pOitPass, ID3D11Buffer* pSceneBuffer, ID3D11Buffer* pMaterialBuffer, ID3D11ShaderResourceView* pTextureNormalView,
+    SceneCubes& sceneCubes, D3D11ConstantUploader& constants, const FrameConstants& frame)
 {
     static const FLOAT clearColor[4] = { 0.3f, 0.3f, 0.3f, 1.0f }; // серый цвет
     pDeviceContext->ClearRenderTargetView(pRenderTargetView, clearColor);
@@ -292,7 +1152,7 @@ void Render(ID3D11DeviceContext* pDeviceContext, ID3D11RenderTargetView* pRender
     viewport.MinDepth = 0.0f;
     viewport.MaxDepth = 1.0f;
     pDeviceContext->RSSetViewports(1, &viewport);
-    pDeviceContext->PSSetConstantBuffers(1, 1, &pSceneBuffer);
+    constants.SetPS(1, &frame.scene, sizeof(SceneBuffer), pSceneBuffer, frame.versions.scene);
     pDeviceContext->PSSetConstantBuffers(2, 1, &pMaterialBuffer);
 
     // cubemap
@@ -305,39 +1165,19 @@ void Render(ID3D11DeviceContext* pDeviceContext, ID3D11RenderTargetView* pRender
     pDeviceContext->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
     pDeviceContext->VSSetShader(pSphereVertexShader, nullptr, 0);
     pDeviceContext->PSSetShader(pSpherePixelShader, nullptr, 0);
-    pDeviceContext->VSSetConstantBuffers(1, 1, &pSphereGeomBuffer);
-    pDeviceContext->VSSetConstantBuffers(0, 1, &pSphereSceneBuffer);
+    constants.SetVS(1, &frame.sphereGeom, sizeof(GeomBuffer), pSphereGeomBuffer, frame.versions.sphereGeom);
+    constants.SetVS(0, &frame.sphereScene, sizeof(SceneBuffer), pSphereSceneBuffer, frame.versions.sphereScene);
     pDeviceContext->PSSetSamplers(0, 1, &pSampler);
     pDeviceContext->PSSetShaderResources(0, 1, &pSphereTextureView);
     pDeviceContext->DrawIndexed(36, 0, 0);
 
-    // кубы
-    pDeviceContext->PSSetShaderResources(1, 1, &pTextureNormalView); // Карта нормалей (t1)
-    pDeviceContext->IASetIndexBuffer(pIndexBuffer, DXGI_FORMAT_R16_UINT, 0);
-    ID3D11Buffer* vertexBuffers[] = { pVertexBuffer };
-    UINT strides[] = { sizeof(TextureTangentVertex) };
-    UINT offsets[] = { 0 };
-    pDeviceContext->IASetVertexBuffers(0, 1, vertexBuffers, strides, offsets);
-    pDeviceContext->IASetInputLayout(pInputLayout);
-    pDeviceContext->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
-    pDeviceContext->VSSetShader(pVertexShader, nullptr, 0);
-    pDeviceContext->PSSetShader(pPixelShader, nullptr, 0);
-    pDeviceContext->VSSetConstantBuffers(0, 1, &pGeomBuffer);
-    pDeviceContext->PSSetSamplers(0, 1, &pSampler);
-    pDeviceContext->PSSetShaderResources(0, 1, &pTextureView);
-    pDeviceContext->DrawIndexed(36, 0, 0);
-
-    pDeviceContext->VSSetConstantBuffers(0, 1, &pGeomBuffer2);
-    pDeviceContext->DrawIndexed(36, 0, 0);
-
-    // Отрисовка источника света
-    pDeviceContext->VSSetConstantBuffers(0, 1, &pLightGeomBuffer);
-    pDeviceContext->PSSetShader(pLightPixelShader, nullptr, 0);
-    pDeviceContext->DrawIndexed(36, 0, 0);
+    // кубы и источник света
+    SetCubeState(pDeviceContext, pIndexBuffer, pVertexBuffer, sceneCubes.vertexStride, sceneCubes.pPackedBoundsBuffer, pInputLayout, pVertexShader,
+        pSampler, pTextureView, pTextureNormalView);
+    DrawSceneCubes(sceneCubes, frame);
 
     // Отрисовка квадратов
     pDeviceContext->RSSetState(pNoCullRasterizerState);
-    pDeviceContext->OMSetBlendState(pTransBlendState, nullptr, 0xFFFFFFFF); // Устанавливаем состояние смешивания для прозрачности
     pDeviceContext->OMSetDepthStencilState(pNoWriteDepthStencilState, 0); // Отключаем запись в буфер глубины
 
     pDeviceContext->IASetIndexBuffer(pSquareIndexBuffer, DXGI_FORMAT_R16_UINT, 0);
@@ -349,30 +1189,43 @@ void Render(ID3D11DeviceContext* pDeviceContext, ID3D11RenderTargetView* pRender
     pDeviceContext->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
     pDeviceContext->VSSetShader(pSquareVertexShader, nullptr, 0);
     pDeviceContext->PSSetShader(pSquarePixelShader, nullptr, 0);
-    pDeviceContext->VSSetConstantBuffers(0, 1, &pSquareGeomBuffer);
+    constants.SetVS(0, &frame.squareGeom, sizeof(GeomBuffer), pSquareGeomBuffer, frame.versions.squareGeom);
 
     // Информация о квадратах
-    SquareInfo squares[] = {
-        { GetSquareCenter(0), DirectX::XMFLOAT4(1.0f, 0.0f, 0.0f, 0.8f), 0.0f, 0 }, // Красный квадрат (индексы 0-5)
-        { GetSquareCenter(4), DirectX::XMFLOAT4(1.0f, 1.0f, 0.0f, 0.8f), 0.0f, 6 }  // Желтый квадрат (индексы 6-11)
+    const SquareInfo squares[] = {
+        { GetSquareCenter(0), DirectX::XMFLOAT4(1.0f, 0.0f, 0.0f, 0.8f), 0 }, // Красный квадрат (индексы 0-5)
+        { GetSquareCenter(4), DirectX::XMFLOAT4(1.0f, 1.0f, 0.0f, 0.8f), 6 }  // Желтый квадрат (индексы 6-11)
     };
 
-    for (auto& square : squares) {
-        square.distance = CalculateDistance(square.position, cameraPosition);
-    }
-
-    // Сортируем квадраты по расстоянию (от дальнего к ближнему)
-    std::sort(squares, squares + 2, [](const SquareInfo& a, const SquareInfo& b) {
-        return a.distance > b.distance;
-        });
-    // Отрисовка квадратов
-    for (const auto& square : squares) {
+    auto drawSquare = [&](const SquareInfo& square) {
         ColorBuffer colorBuffer;
         colorBuffer.color = square.color;
-        pDeviceContext->UpdateSubresource(pColorBuffer, 0, nullptr, &colorBuffer, 0, 0);
-        pDeviceContext->PSSetConstantBuffers(3, 1, &pColorBuffer);
+        constants.SetPS(3, &colorBuffer, sizeof(ColorBuffer), pColorBuffer);
 
         pDeviceContext->DrawIndexed(6, square.startIndex, 0);
+    };
+
+    if (pOitPass) {
+        // Без сортировки: пересекающиеся квадраты смешиваются по весам в каждом пикселе
+        pOitPass->Begin(pDeviceContext, pDepthStencilView);
+        pDeviceContext->PSSetShader(pOitPass->GetPixelShader(), nullptr, 0);
+        for (const SquareInfo& square : squares) {
+            drawSquare(square);
+        }
+        pOitPass->Composite(pDeviceContext, pRenderTargetView, pDepthStencilView);
+    }
+    else {
+        // Сортируем квадраты по глубине в пространстве вида (от дальнего к ближнему)
+        pDeviceContext->OMSetBlendState(pTransBlendState, nullptr, 0xFFFFFFFF); // Устанавливаем состояние смешивания для прозрачности
+        const DirectX::XMMATRIX squareModelView = DirectX::XMMatrixMultiply(frame.squareGeom.model, frame.squareGeom.view);
+        transparencyQueue.Resize(ARRAYSIZE(squares));
+        for (uint32_t i = 0; i < ARRAYSIZE(squares); i++) {
+            transparencyQueue.SetDepth(i, ComputeViewDepth(squareModelView, squares[i].position));
+        }
+        const uint32_t* pSquareOrder = transparencyQueue.Sort();
+        for (uint32_t i = 0; i < ARRAYSIZE(squares); i++) {
+            drawSquare(squares[pSquareOrder[i]]);
+        }
     }
 
     pDeviceContext->OMSetBlendState(nullptr, nullptr, 0xFFFFFFFF);
@@ -488,143 +1341,61 @@ HRESULT InitDirectX(HWND hWnd, ID3D11Device** ppDevice, ID3D11DeviceContext** pp
     return (*ppDevice)->CreateDepthStencilState(&deptStateDesc, ppDepthState);
 }
 
-void HandleInput(double deltaTime, double& angle_y, double& angle_xz, double rotationSpeed, double& cameraRadius) {
-    // Поворот влево (стрелка влево)
-    if (GetAsyncKeyState(VK_RIGHT) & 0x8000) {
-        angle_y -= rotationSpeed * deltaTime;
-    }
-    // Поворот вправо (стрелка вправо)
+// Нажатые клавиши управления камерой; поворот и приближение - в ApplyCameraKeys (CameraDriver.h)
+uint8_t PollCameraKeys() {
+    uint8_t keys = 0;
     if (GetAsyncKeyState(VK_LEFT) & 0x8000) {
-        angle_y += rotationSpeed * deltaTime;
+        keys |= CameraKey::Left;
+    }
+    if (GetAsyncKeyState(VK_RIGHT) & 0x8000) {
+        keys |= CameraKey::Right;
     }
     if (GetAsyncKeyState(VK_UP) & 0x8000) {
-        angle_xz += rotationSpeed * deltaTime;
+        keys |= CameraKey::Up;
     }
     if (GetAsyncKeyState(VK_DOWN) & 0x8000) {
-        angle_xz -= rotationSpeed * deltaTime;
+        keys |= CameraKey::Down;
     }
-    // проверка на выход из диапазона
-    if (angle_y > 2 * DirectX::XM_PI) {
-        angle_y -= 2 * DirectX::XM_PI;
+    if (GetAsyncKeyState('W') & 0x8000) {
+        keys |= CameraKey::Closer;
     }
-    if (angle_y < 0) {
-        angle_y += 2 * DirectX::XM_PI;
-    }
-    if (angle_xz > DirectX::XM_PI / 2 - FLT_EPSILON)
-    {
-        angle_xz = DirectX::XM_PI / 2 - FLT_EPSILON;
-    }
-    if (angle_xz < -DirectX::XM_PI / 2 + FLT_EPSILON)
-    {
-        angle_xz = -DirectX::XM_PI / 2 + FLT_EPSILON;
+    if (GetAsyncKeyState('S') & 0x8000) {
+        keys |= CameraKey::Farther;
     }
+    return keys;
+}
 
-    // изменение расстояния от камеры
-    if (GetAsyncKeyState('W') & 0x8000 && cameraRadius > 1.0) {
-        cameraRadius -= rotationSpeed * 2.0 * deltaTime;
-    }
-    // Уменьшение расстояния (клавиша S)
-    if (GetAsyncKeyState('S') & 0x8000 && cameraRadius < 100.0) {
-        cameraRadius += rotationSpeed * 2.0 * deltaTime;
+// Константы кадра загружаются при отрисовке, рядом с привязкой - в Render и DrawSceneCubes
+// deltaTime - время кадра из cameraDriver.BeginFrame: при воспроизведении и по сценарию оно не зависит от часов
+void UpdateRotation(double deltaTime, CameraDriver& cameraDriver, CameraState& camera, DirectX::XMFLOAT3& cameraPosition,
+    SceneTransforms& transforms, FrameConstants& frame) {
+    {
+        ProfileZone zone("HandleInput");
+        cameraDriver.Update(PollCameraKeys(), camera);
     }
-}
 
-void UpdateRotation(double deltaTime, ID3D11DeviceContext* pDeviceContext, ID3D11Buffer* pGeomBuffer, ID3D11Buffer* pGeomBuffer2, ID3D11Buffer* pLightGeomBuffer, ID3D11Buffer* pSphereGeomBuffer,
-    ID3D11Buffer* pSphereSceneBuffer, ID3D11Buffer* pSquareGeomBuffer, double& angle_y, double& angle_xz, double& cameraRadius, DirectX::XMFLOAT3& cameraPosition, ID3D11Buffer* pSceneBuffer) {
-    static const double rotationViewSpeed = 1.0; // Скорость повота камеры
-    HandleInput(deltaTime, angle_y, angle_xz, rotationViewSpeed, cameraRadius);
-
-    GeomBuffer geomBuffer;
-    GeomBuffer geomBuffer2;
-    GeomBuffer geomLightBuffer;
-    GeomBuffer sphereGeomBuffer;
-    SceneBuffer sphereSceneBuffer;
-
-    // зададим источник освещения
-    SceneBuffer sceneBuffer = {};
-    sceneBuffer.lightCount = DirectX::XMFLOAT4(1, 0, 0, 0); // Один источник света
-    sceneBuffer.lights[0].pos = DirectX::XMFLOAT4(0.5f, 0.7f, -0.5f, 1.0f);
-    sceneBuffer.lights[0].color = DirectX::XMFLOAT4(1.0f, 1.0f, 1.0f, 1.0f); // Белый цвет
-    sceneBuffer.ambientColor = DirectX::XMFLOAT4(0.05f, 0.05f, 0.05f, 1.0f); // Окружающее освещение
-    sceneBuffer.cameraPos = DirectX::XMFLOAT4(cameraPosition.x, cameraPosition.y, cameraPosition.z, 1.0f); // Позиция камеры
-    pDeviceContext->UpdateSubresource(pSceneBuffer, 0, nullptr, &sceneBuffer, 0, 0);
-
-    DirectX::CXMMATRIX offset = DirectX::XMMatrixTranslation(0.0f, 0.0f, 1.0f);
-    DirectX::XMVECTOR rotationAxis = DirectX::XMVectorSet(1.0f, 1.0f, 1.0f, 0.0f); // ось постоянного вращения куба
-    rotationAxis = DirectX::XMVector3Normalize(rotationAxis);
-    static float rotationAngle = 0.0f;
-    static const double rotationModelSpeed = 0.05f;
-
-    rotationAngle += rotationModelSpeed * deltaTime;
-    if (rotationAngle > 2 * DirectX::XM_PI) {
-        rotationAngle -= 2 * DirectX::XM_PI;
-    }
-
-    DirectX::XMMATRIX rotationMatrix = DirectX::XMMatrixRotationAxis(rotationAxis, rotationAngle);
-
-    geomBuffer.model = rotationMatrix;
-    geomBuffer2.model = DirectX::XMMatrixMultiply(DirectX::XMMatrixIdentity(), DirectX::XMMatrixTranslation(2.0f, 0.0f, 0.0f));
-    sphereGeomBuffer.model = DirectX::XMMatrixIdentity();
-    geomLightBuffer.model = DirectX::XMMatrixScaling(0.1f, 0.1f, 0.1f) *
-        DirectX::XMMatrixTranslation(sceneBuffer.lights[0].pos.x, sceneBuffer.lights[0].pos.y, sceneBuffer.lights[0].pos.z);
-
-    DirectX::XMMATRIX normalMatrix = XMMatrixTranspose(XMMatrixInverse(nullptr, geomBuffer.model));
-    geomBuffer.normalMatrix = normalMatrix;
-    DirectX::XMMATRIX normalMatrix2 = XMMatrixTranspose(XMMatrixInverse(nullptr, geomBuffer2.model));
-    geomBuffer2.normalMatrix = normalMatrix2;
-
-    float cameraX = cameraRadius * sinf(static_cast<float>(angle_y)); // x = r * sin(angle)
-    float cameraZ = cameraRadius * cosf(static_cast<float>(angle_y)); // z = r * cos(angle)
-    float cameraY = cameraRadius * sinf(static_cast<float>(angle_xz));
-    cameraX *= cosf(static_cast<float>(angle_xz));
-    cameraZ *= cosf(static_cast<float>(angle_xz));
-
-    cameraPosition = DirectX::XMFLOAT3(cameraX, cameraY, cameraZ);
-
-    DirectX::XMMATRIX view = DirectX::XMMatrixLookAtLH(
-        DirectX::XMVectorSet(cameraX, cameraY, cameraZ, 0.0f),
-        DirectX::XMVectorSet(0.0f, 0.0f, 0.0f, 0.0f),
-        DirectX::XMVectorSet(0.0f, 1.0f, 0.0f, 0.0f)
-    );
-
-    geomBuffer.view = DirectX::XMMatrixMultiply(view, offset);
-    geomBuffer2.view = DirectX::XMMatrixMultiply(view, offset);
-    geomLightBuffer.view = geomBuffer.view;
-
-    float fov = DirectX::XM_PI / 3.0f; // угол обзора 60 градусов
-    float aspectRatio = 1280.0f / 720.0f;
-    float nearZ = 0.1f; // ближняя плоскость отсечения
-    float farZ = 1000.0f; // дальняя плоскость отсечения
-    auto proj = DirectX::XMMatrixPerspectiveFovLH(fov, aspectRatio, nearZ, farZ);
-
-    geomBuffer.projection = proj;
-    geomBuffer2.projection = proj;
-    geomLightBuffer.projection = proj;
-    //sphereGeomBuffer.projection = DirectX::XMMatrixPerspectiveFovLH(fov, aspectRatio, nearZ, farZ);
-    sphereSceneBuffer.vp = geomBuffer.view * geomBuffer.projection;
-    sphereSceneBuffer.cameraPos.x = cameraX;
-    sphereSceneBuffer.cameraPos.y = cameraY;
-    sphereSceneBuffer.cameraPos.z = cameraZ;
-
-    pDeviceContext->UpdateSubresource(pGeomBuffer, 0, nullptr, &geomBuffer, 0, 0);
-    pDeviceContext->UpdateSubresource(pGeomBuffer2, 0, nullptr, &geomBuffer2, 0, 0);
-    pDeviceContext->UpdateSubresource(pLightGeomBuffer, 0, nullptr, &geomLightBuffer, 0, 0);
-    pDeviceContext->UpdateSubresource(pSphereGeomBuffer, 0, nullptr, &sphereGeomBuffer, 0, 0);
-    pDeviceContext->UpdateSubresource(pSphereSceneBuffer, 0, nullptr, &sphereSceneBuffer, 0, 0);
-
-    // Обновление преобразований для квадратов
-    GeomBuffer squareGeomBuffer;
-    squareGeomBuffer.model = DirectX::XMMatrixIdentity();
-    squareGeomBuffer.view = geomBuffer.view;
-    squareGeomBuffer.projection = geomBuffer.projection;
-    DirectX::XMMATRIX normalMatrixSquare = XMMatrixTranspose(XMMatrixInverse(nullptr, squareGeomBuffer.model));
-    squareGeomBuffer.normalMatrix = normalMatrixSquare;
-
-    pDeviceContext->UpdateSubresource(pSquareGeomBuffer, 0, nullptr, &squareGeomBuffer, 0, 0);
+    ProfileZone zone("ComputeFrameConstants");
+    ComputeFrameConstants(deltaTime, camera.angle_y, camera.angle_xz, camera.cameraRadius, cameraPosition, transforms, frame);
 }
 
 int APIENTRY wWinMain(_In_ HINSTANCE hInstance, _In_opt_ HINSTANCE hPrevInstance, _In_ LPWSTR lpCmdLine, _In_ int nCmdShow)
 {
+    // Режимы отчетов (Reports.h) работают без окна и устройства
+    if (const ReportMode* pMode = lpCmdLine ? FindReportMode(lpCmdLine) : nullptr) {
+        ReportWriter report;
+        return RunReportMode(*pMode, lpCmdLine, report) ? 0 : -1;
+    }
+    // Трасса последних кадров (FrameProfiler::kHistoryCapacity зон) записывается при выходе
+    const bool writeTrace = lpCmdLine && wcsstr(lpCmdLine, L"-trace");
+    // Движение камеры: клавиатура, запись клавиш (-record), воспроизведение (-replay) или сценарий
+    // (-camerapath). При воспроизведении и по сценарию окно закрывается после последнего кадра
+    CameraState camera;
+    CameraDriver cameraDriver;
+    if (lpCmdLine && !cameraDriver.Start(lpCmdLine, camera, 1.0 / 60.0)) {
+        OutputDebugStringA(cameraDriver.GetErrorMessage());
+        return -1;
+    }
+
     HWND hWnd = CreateWindowInstance(hInstance, nCmdShow);
     if (!hWnd) {
         return -1;
@@ -643,6 +1414,27 @@ int APIENTRY wWinMain(_In_ HINSTANCE hInstance, _In_opt_ HINSTANCE hPrevInstance
         return -1;
     }
 
+    // Общий пул потоков: достраивание mip-цепочек при загрузке и программный бэкенд
+    ThreadPool threadPool;
+    // Повторные загрузки одного файла (шесть граней неба) отдают общие данные
+    TextureCache textureCache(&threadPool);
+    // Текстуры грузятся в фоне, уровни попадают на устройство в каждом кадре в пределах 2 МБ,
+    // начиная с самых маленьких. С ключом -nostream все загружается до первого кадра.
+    D3D11TextureUploadTarget textureTarget(pDevice, pDeviceContext);
+    TextureStreamer textureStreamer(textureCache, textureTarget, 2 * 1024 * 1024);
+    const auto streamStartTime = std::chrono::high_resolution_clock::now();
+
+    // Байт-код шейдеров между запусками хранится в shader_cache.bin рядом с программой
+    D3DShaderCompiler shaderCompiler;
+    ShaderCache shaderCache(shaderCompiler);
+    shaderCache.Open(L"shader_cache.bin");
+
+    // Константные буферы кадра - блоками из кольца на 8 МБ; -nocbring - UpdateSubresource, как раньше
+    D3D11ConstantUploader constants(pDevice, pDeviceContext, 8 << 20);
+    if (!(lpCmdLine && wcsstr(lpCmdLine, L"-nocbring"))) {
+        constants.Create();
+    }
+
     // Создание константного буфера для освещения
     ID3D11Buffer* pSceneBuffer = nullptr;
 
@@ -692,13 +1484,17 @@ int APIENTRY wWinMain(_In_ HINSTANCE hInstance, _In_opt_ HINSTANCE hPrevInstance
 
     ID3DBlob* pSquareVertexShaderBlob = nullptr;
     ID3DBlob* pSquarePixelShaderBlob = nullptr;
-    CompileShader(vertexColorShaderCode, "vs", "vs_5_0", &pSquareVertexShaderBlob);
-    CompileShader(pixelColorShaderCode, "ps", "ps_5_0", &pSquarePixelShaderBlob);
+    CompileShader(shaderCache, vertexColorShaderCode, "vs", "vs_5_0", &pSquareVertexShaderBlob);
+    CompileShader(shaderCache, pixelColorShaderCode, "ps", "ps_5_0", &pSquarePixelShaderBlob);
 
     pDevice->CreateVertexShader(pSquareVertexShaderBlob->GetBufferPointer(), pSquareVertexShaderBlob->GetBufferSize(), nullptr, &pSquareVertexShader);
     pDevice->CreatePixelShader(pSquarePixelShaderBlob->GetBufferPointer(), pSquarePixelShaderBlob->GetBufferSize(), nullptr, &pSquarePixelShader);
     CreateInputLayout(pDevice, &pSquareInputLayout, pSquareVertexShaderBlob);
 
+    // Режим -oit: квадраты смешиваются без сортировки; если цели не создались - обычный путь
+    WeightedOitPass oitPass;
+    const bool useOit = lpCmdLine && wcsstr(lpCmdLine, L"-oit") && SUCCEEDED(oitPass.Create(pDevice, shaderCache, 1280, 720));
+
     D3D11_BUFFER_DESC squareGeomDesc = {};
     squareGeomDesc.ByteWidth = sizeof(GeomBuffer);
     squareGeomDesc.Usage = D3D11_USAGE_DEFAULT;
@@ -792,31 +1588,12 @@ int APIENTRY wWinMain(_In_ HINSTANCE hInstance, _In_opt_ HINSTANCE hPrevInstance
 
     // Загрузка текстуры сферы
     const std::wstring TextureNames[6] = { L"space.dds", L"space.dds", L"space.dds", L"space.dds", L"space.dds", L"space.dds" };
-    TextureDesc texDescs[6];
-    for (int i = 0; i < 6; i++)
-    {
-        if (!LoadDDS(TextureNames[i].c_str(), texDescs[i]))
-        {
-            return -1;
-        }
-    }
-    ID3D11Texture2D* pSphereTexture = nullptr;
-
-    hr = CreateSphereTexture(pDevice, texDescs, &pSphereTexture);
-    if (FAILED(hr)) {
-        return -1;
-    }
-
-    ID3D11ShaderResourceView* pSphereTextureView = nullptr;
-    hr = CreateShaderSphereResourceView(pDevice, pSphereTexture, texDescs[0].fmt, &pSphereTextureView);
-    if (FAILED(hr)) {
-        return -1;
-    }
+    const uint32_t sphereTextureHandle = textureStreamer.RequestCube(TextureNames);
 
     ID3DBlob* pSphereVertexShaderBlob = nullptr;
     ID3DBlob* pSpherePixelShaderBlob = nullptr;
-    CompileShader(vertexSphereShaderCode, "vs", "vs_5_0", &pSphereVertexShaderBlob);
-    CompileShader(pixelSphereShaderCode, "ps", "ps_5_0", &pSpherePixelShaderBlob);
+    CompileShader(shaderCache, vertexSphereShaderCode, "vs", "vs_5_0", &pSphereVertexShaderBlob);
+    CompileShader(shaderCache, pixelSphereShaderCode, "ps", "ps_5_0", &pSpherePixelShaderBlob);
 
     pDevice->CreateVertexShader(pSphereVertexShaderBlob->GetBufferPointer(), pSphereVertexShaderBlob->GetBufferSize(), nullptr, &pSphereVertexShader);
     pDevice->CreatePixelShader(pSpherePixelShaderBlob->GetBufferPointer(), pSpherePixelShaderBlob->GetBufferSize(), nullptr, &pSpherePixelShader);
@@ -856,50 +1633,33 @@ int APIENTRY wWinMain(_In_ HINSTANCE hInstance, _In_opt_ HINSTANCE hPrevInstance
     ID3D11VertexShader* pVertexShader = nullptr;
     ID3D11PixelShader* pPixelShader = nullptr;
     ID3D11InputLayout* pInputLayout = nullptr;
-    ID3D11Buffer* pGeomBuffer = nullptr;
-    ID3D11Buffer* pGeomBuffer2 = nullptr;
-    ID3D11Buffer* pLightGeomBuffer = nullptr;
+    ID3D11Buffer* pGeomBuffer = nullptr; // общий для всех кубов
     ID3D11PixelShader* pLightPixelShader = nullptr;
-
-    CreateVertexBuffer(pDevice, &pVertexBuffer);
-    CreateIndexBuffer(pDevice, &pIndexBuffer);
-
-    // Загрузка текстуры
-    TextureDesc textureDesc;
-    const std::wstring textureName = L"texture.dds";
-    if (!LoadDDS(textureName, textureDesc)) {
-        return -1;
+    ID3D11VertexShader* pInstancedVertexShader = nullptr;
+    ID3D11InputLayout* pInstancedInputLayout = nullptr;
+    ID3D11Buffer* pPackedBoundsBuffer = nullptr;
+
+    // -packed: сжатые вершины PackedTangentVertex, вершинные шейдеры собираются с PACKED_VERTEX
+    const bool packedVertices = lpCmdLine && wcsstr(lpCmdLine, L"-packed");
+    if (packedVertices) {
+        CreatePackedVertexBuffer(pDevice, &pVertexBuffer, &pPackedBoundsBuffer);
     }
-
-    ID3D11Texture2D* pTexture = nullptr;
-    hr = CreateTexture(pDevice, textureDesc, &pTexture);
-    if (FAILED(hr)) {
-        return -1;
-    }
-
-    ID3D11ShaderResourceView* pTextureView = nullptr;
-    hr = CreateShaderResourceView(pDevice, pTexture, textureDesc.fmt, &pTextureView);
-    if (FAILED(hr)) {
-        return -1;
+    else {
+        CreateVertexBuffer(pDevice, &pVertexBuffer);
     }
+    CreateIndexBuffer(pDevice, &pIndexBuffer);
 
-    // Загрузка текстуры-карты нормалей
-    TextureDesc textureNormDesc;
+    // Загрузка текстуры и текстуры-карты нормалей
+    const std::wstring textureName = L"texture.dds";
     const std::wstring textureNormalName = L"normal_map.dds";
-    if (!LoadDDS(textureNormalName, textureNormDesc)) {
-        return -1;
-    }
+    const uint32_t textureHandle = textureStreamer.Request(textureName);
+    const uint32_t textureNormalHandle = textureStreamer.Request(textureNormalName);
 
-    ID3D11Texture2D* pNormalTexture = nullptr;
-    hr = CreateTexture(pDevice, textureNormDesc, &pNormalTexture);
-    if (FAILED(hr)) {
-        return -1;
-    }
-
-    ID3D11ShaderResourceView* pTextureNormalView = nullptr;
-    hr = CreateShaderResourceView(pDevice, pNormalTexture, textureNormDesc.fmt, &pTextureNormalView);
-    if (FAILED(hr)) {
-        return -1;
+    if (lpCmdLine && wcsstr(lpCmdLine, L"-nostream")) {
+        textureStreamer.Flush();
+        if (textureStreamer.HasFailed(textureHandle) || textureStreamer.HasFailed(textureNormalHandle) || textureStreamer.HasFailed(sphereTextureHandle)) {
+            return -1;
+        }
     }
 
     // Создание семплера
@@ -912,15 +1672,36 @@ int APIENTRY wWinMain(_In_ HINSTANCE hInstance, _In_opt_ HINSTANCE hPrevInstance
     ID3DBlob* pVertexShaderBlob = nullptr;
     ID3DBlob* pPixelShaderBlob = nullptr;
     ID3DBlob* pLightPixelShaderBlob = nullptr;
-    CompileShader(vertexShaderCode, "vs", "vs_5_0", &pVertexShaderBlob);
-    CompileShader(pixelShaderCode, "ps", "ps_5_0", &pPixelShaderBlob);
-    CompileShader(pixelLightShaderCode, "ps", "ps_5_0", &pLightPixelShaderBlob);
-
+    ID3DBlob* pInstancedVertexShaderBlob = nullptr;
+    const ShaderMacro packedDefines[] = { { "PACKED_VERTEX", "1" } };
+    const uint32_t packedDefineCount = packedVertices ? static_cast<uint32_t>(ARRAYSIZE(packedDefines)) : 0;
+    CompileShader(shaderCache, vertexShaderCode, "vs", "vs_5_0", &pVertexShaderBlob, packedDefines, packedDefineCount);
+    CompileShader(shaderCache, pixelShaderCode, "ps", "ps_5_0", &pPixelShaderBlob);
+    CompileShader(shaderCache, pixelLightShaderCode, "ps", "ps_5_0", &pLightPixelShaderBlob);
+    CompileShader(shaderCache, vertexInstancedShaderCode, "vs", "vs_5_0", &pInstancedVertexShaderBlob, packedDefines, packedDefineCount);
+
+    // Все шейдеры получены - новые записи сохраняются в кэш
+    shaderCache.Save();
+    {
+        const ShaderCacheStats& stats = shaderCache.GetStats();
+        wchar_t report[256];
+        swprintf_s(report, L"Shader cache: %u hits, %u compiled, %u failed, %.1f ms compiling, %.1f ms saved\n",
+            stats.hits, stats.misses, stats.failures, stats.compileMilliseconds, stats.savedMilliseconds);
+        OutputDebugStringW(report);
+    }
 
     pDevice->CreateVertexShader(pVertexShaderBlob->GetBufferPointer(), pVertexShaderBlob->GetBufferSize(), nullptr, &pVertexShader);
     pDevice->CreatePixelShader(pPixelShaderBlob->GetBufferPointer(), pPixelShaderBlob->GetBufferSize(), nullptr, &pPixelShader);
     pDevice->CreatePixelShader(pLightPixelShaderBlob->GetBufferPointer(), pLightPixelShaderBlob->GetBufferSize(), nullptr, &pLightPixelShader);
-    CreateInputLayout(pDevice, &pInputLayout, pVertexShaderBlob);
+    pDevice->CreateVertexShader(pInstancedVertexShaderBlob->GetBufferPointer(), pInstancedVertexShaderBlob->GetBufferSize(), nullptr, &pInstancedVertexShader);
+    if (packedVertices) {
+        CreatePackedInputLayout(pDevice, &pInputLayout, pVertexShaderBlob);
+        CreatePackedInstancedInputLayout(pDevice, &pInstancedInputLayout, pInstancedVertexShaderBlob);
+    }
+    else {
+        CreateInputLayout(pDevice, &pInputLayout, pVertexShaderBlob);
+        CreateInstancedInputLayout(pDevice, &pInstancedInputLayout, pInstancedVertexShaderBlob);
+    }
 
     // Создание константного буфера
     D3D11_BUFFER_DESC desc = {};
@@ -936,61 +1717,246 @@ int APIENTRY wWinMain(_In_ HINSTANCE hInstance, _In_opt_ HINSTANCE hPrevInstance
         return -1;
     }
 
-    D3D11_BUFFER_DESC desc2 = {};
-    desc2.ByteWidth = sizeof(GeomBuffer);
-    desc2.Usage = D3D11_USAGE_DEFAULT;
-    desc2.BindFlags = D3D11_BIND_CONSTANT_BUFFER;
-    desc2.CPUAccessFlags = 0;
-    desc2.MiscFlags = 0;
-    desc2.StructureByteStride = 0;
-
-    hr = pDevice->CreateBuffer(&desc2, nullptr, &pGeomBuffer2);
-    if (FAILED(hr)) {
-        return -1;
+    // Кубы: по объектам или с инстансингом (-instanced); -cubes N добавляет поле из N вращающихся кубов
+    D3D11SceneDrawBackend cubeBackend(pDevice, pDeviceContext, pGeomBuffer, constants);
+    cubeBackend.SetShaders(pVertexShader, pInputLayout, pInstancedVertexShader, pInstancedInputLayout);
+    cubeBackend.SetMeshPixelShader(CubeMeshTextured, pPixelShader);
+    cubeBackend.SetMeshPixelShader(CubeMeshLight, pLightPixelShader);
+
+    SceneCubes sceneCubes;
+    sceneCubes.pBackend = &cubeBackend;
+    sceneCubes.pThreadPool = &threadPool;
+    sceneCubes.instanced = lpCmdLine && wcsstr(lpCmdLine, L"-instanced");
+    sceneCubes.vertexStride = packedVertices ? sizeof(PackedTangentVertex) : sizeof(TextureTangentVertex);
+    sceneCubes.pPackedBoundsBuffer = pPackedBoundsBuffer;
+    uint32_t fieldCubeCount = 0;
+    if (const wchar_t* pCubesArg = lpCmdLine ? wcsstr(lpCmdLine, L"-cubes") : nullptr) {
+        fieldCubeCount = static_cast<uint32_t>(wcstoul(pCubesArg + wcslen(L"-cubes"), nullptr, 10));
     }
+    sceneCubes.field.Generate(fieldCubeCount, 1, 1.5f, -3.0f);
 
-    D3D11_BUFFER_DESC desc3 = {};
-    desc3.ByteWidth = sizeof(GeomBuffer);
-    desc3.Usage = D3D11_USAGE_DEFAULT;
-    desc3.BindFlags = D3D11_BIND_CONSTANT_BUFFER;
-    desc3.CPUAccessFlags = 0;
-    desc3.MiscFlags = 0;
-    desc3.StructureByteStride = 0;
+    // Порядок полупрозрачных квадратов переживает кадр - следующая сортировка начинается с него
+    TransparencyQueue transparencyQueue;
 
-    hr = pDevice->CreateBuffer(&desc3, nullptr, &pLightGeomBuffer);
-    if (FAILED(hr)) {
-        return -1;
+    // -lights N: N точечных источников сверх SceneBuffer, списки кластеров строятся каждый кадр
+    std::vector<PointLight> pointLights;
+    if (const wchar_t* pLightsArg = lpCmdLine ? wcsstr(lpCmdLine, L"-lights") : nullptr) {
+        pointLights = GeneratePointLights(static_cast<uint32_t>(wcstoul(pLightsArg + wcslen(L"-lights"), nullptr, 10)), 1);
+    }
+    LightClusterGrid lightClusters;
+    bool lightClustersConfigured = false;
+    D3D11LightClusterBuffers lightClusterBuffers;
+
+    // Программный бэкенд (запуск с ключом -software): кадр рисуется на CPU и копируется в задний буфер
+    std::unique_ptr<SoftwareRasterizer> pSoftwareRasterizer;
+    SoftwareTexture softwareTexture;
+    SoftwareTexture softwareNormalTexture;
+    SoftwareCubeTexture softwareSkyTexture;
+    if (lpCmdLine && wcsstr(lpCmdLine, L"-software")) {
+        // Программному бэкенду нужны все уровни сразу - грузим синхронно, данные общие со стримингом через кэш.
+        // Отображения файлов освобождаются при выходе из блока.
+        TextureDesc textureDesc;
+        TextureDesc textureNormDesc;
+        TextureDesc texDescs[6];
+        if (!LoadDDS(textureName, textureDesc, textureCache) || !LoadDDS(textureNormalName, textureNormDesc, textureCache)) {
+            return -1;
+        }
+        for (int i = 0; i < 6; i++) {
+            if (!LoadDDS(TextureNames[i], texDescs[i], textureCache)) {
+                return -1;
+            }
+        }
+        if (!CreateSoftwareTexture(textureDesc, softwareTexture) || !CreateSoftwareTexture(textureNormDesc, softwareNormalTexture)) {
+            return -1;
+        }
+        for (int i = 0; i < 6; i++) {
+            // Грани с общими данными распаковываются один раз
+            if (i > 0 && texDescs[i].pSource == texDescs[i - 1].pSource) {
+                softwareSkyTexture.faces[i] = softwareSkyTexture.faces[i - 1];
+                continue;
+            }
+            if (!CreateSoftwareTexture(texDescs[i], softwareSkyTexture.faces[i])) {
+                return -1;
+            }
+        }
+        pSoftwareRasterizer = std::make_unique<SoftwareRasterizer>(threadPool, 1280, 720);
+    }
+
+    if (lpCmdLine && wcsstr(lpCmdLine, L"-instbench")) {
+        pDeviceContext->OMSetRenderTargets(1, &pRenderTargetView, pDepthStencilView);
+        SetCubeState(pDeviceContext, pIndexBuffer, pVertexBuffer, sceneCubes.vertexStride, sceneCubes.pPackedBoundsBuffer, pInputLayout, pVertexShader,
+            pSampler, nullptr, nullptr);
+        ReportWriter report;
+        const bool written = RunInstancingBenchmarkReport(&cubeBackend, threadPool, report) && report.Save(L"instancing_benchmark.txt");
+        PostQuitMessage(written ? 0 : -1);
     }
 
     MSG msg = {};
     auto prevTime = std::chrono::high_resolution_clock::now();
-    double angle_y = 0.0;
-    double angle_xz = 0.5;
-    double cameraRadius = 2.0;
+    auto statsTime = prevTime;
+    auto profileTime = prevTime;
     DirectX::XMFLOAT3 cameraPosition = { 0.0f, 0.0f, 0.0f };
+    FrameConstants frame = {};
+    SceneTransforms sceneTransforms;
+    bool firstFrameReported = false;
+    bool streamingReported = false;
     while (msg.message != WM_QUIT) {
         if (PeekMessage(&msg, nullptr, 0, 0, PM_REMOVE)) {
             TranslateMessage(&msg);
             DispatchMessage(&msg);
         }
         else {
+            ProfileZone frameZone("Frame");
             auto currentTime = std::chrono::high_resolution_clock::now();
             std::chrono::duration<double> elapsed = currentTime - prevTime;
             prevTime = currentTime;
+            const double deltaTime = cameraDriver.BeginFrame(elapsed.count());
+            sceneCubes.time += deltaTime;
 
             // Обновление вращения
-            UpdateRotation(elapsed.count(), pDeviceContext, pGeomBuffer, pGeomBuffer2, pLightGeomBuffer, pSphereGeomBuffer, pSphereSceneBuffer, pSquareGeomBuffer, angle_y, angle_xz, cameraRadius, cameraPosition, pSceneBuffer);
+            {
+                ProfileZone zone("UpdateRotation");
+                UpdateRotation(deltaTime, cameraDriver, camera, cameraPosition, sceneTransforms, frame);
+            }
 
             // Отрисовка
-            Render(pDeviceContext, pRenderTargetView, pDepthStencilView, pIndexBuffer, pVertexBuffer, pInputLayout, pVertexShader, pPixelShader, pGeomBuffer, pGeomBuffer2, pSampler, pTextureView,
-                pSphereIndexBuffer, pSphereVertexBuffer, pSphereInputLayout, pSphereVertexShader, pSpherePixelShader, pSphereGeomBuffer, pSphereSceneBuffer, pSphereTextureView,
-                pSquareVertexBuffer, pSquareIndexBuffer, pSquareInputLayout, pSquareVertexShader, pSquarePixelShader, pSquareGeomBuffer, pColorBuffer, pNoCullRasterizerState, pTransBlendState, pNoWriteDepthStencilState, cameraPosition, pSceneBuffer, pMaterialBuffer, pLightGeomBuffer, pLightPixelShader, pTextureNormalView);
-            pSwapChain->Present(1, 0);
+            if (pSoftwareRasterizer) {
+                {
+                    ProfileZone zone("RenderSoftware");
+                    RenderSoftware(*pSoftwareRasterizer, frame, materialBuffer, softwareTexture, softwareNormalTexture, softwareSkyTexture);
+                }
+
+                ID3D11Texture2D* pBackBuffer = nullptr;
+                if (SUCCEEDED(pSwapChain->GetBuffer(0, __uuidof(ID3D11Texture2D), reinterpret_cast<void**>(&pBackBuffer)))) {
+                    ProfileZone zone("CopySoftwareFrame");
+                    pDeviceContext->UpdateSubresource(pBackBuffer, 0, nullptr, pSoftwareRasterizer->GetColorBuffer(), pSoftwareRasterizer->GetWidth() * sizeof(uint32_t), 0);
+                    pBackBuffer->Release();
+                }
+
+                // Раз в секунду выводим производительность в заголовок окна
+                if (std::chrono::duration<double>(currentTime - statsTime).count() >= 1.0) {
+                    const SoftwareRasterizerStats& stats = pSoftwareRasterizer->GetStats();
+                    wchar_t title[128];
+                    swprintf_s(title, L"Lab4 [software, %u threads] %.1f fps, %.3f Mtri/s", threadPool.GetThreadCount(),
+                        stats.GetFramesPerSecond(), stats.GetMTrianglesPerSecond());
+                    SetWindowText(hWnd, title);
+                    pSoftwareRasterizer->ResetStats();
+                    statsTime = currentTime;
+                }
+            }
+            else {
+                // Очередная порция mip-уровней; пока текстура не создана, ее вид равен nullptr
+                {
+                    ProfileZone zone("TextureStreamer");
+                    textureStreamer.Update();
+                }
+                ID3D11ShaderResourceView* pTextureView = textureTarget.GetView(textureHandle);
+                ID3D11ShaderResourceView* pTextureNormalView = textureTarget.GetView(textureNormalHandle);
+                ID3D11ShaderResourceView* pSphereTextureView = textureTarget.GetView(sphereTextureHandle);
+                if (!pointLights.empty()) {
+                    ProfileZone zone("LightClusters");
+                    // Проекция постоянна - сетка настраивается по константам первого кадра
+                    if (!lightClustersConfigured) {
+                        lightClusters.Configure(MakeLightClusterDesc(frame.geom.projection, 0.1f, 1000.0f));
+                        lightClustersConfigured = true;
+                    }
+                    lightClusters.Build(frame.geom.view, pointLights.data(), static_cast<uint32_t>(pointLights.size()), GetBestCullPath(), &threadPool);
+                    lightClusterBuffers.Update(pDevice, pDeviceContext, lightClusters, pointLights.data(), static_cast<uint32_t>(pointLights.size()), 1280, 720);
+                    lightClusterBuffers.Bind(pDeviceContext);
+                }
+                {
+                    ProfileZone zone("Render");
+                    constants.BeginFrame();
+                    Render(pDeviceContext, pRenderTargetView, pDepthStencilView, pIndexBuffer, pVertexBuffer, pInputLayout, pVertexShader, pSampler, pTextureView,
+                        pSphereIndexBuffer, pSphereVertexBuffer, pSphereInputLayout, pSphereVertexShader, pSpherePixelShader, pSphereGeomBuffer, pSphereSceneBuffer, pSphereTextureView,
+                        pSquareVertexBuffer, pSquareIndexBuffer, pSquareInputLayout, pSquareVertexShader, pSquarePixelShader, pSquareGeomBuffer, pColorBuffer, pNoCullRasterizerState, pTransBlendState, pNoWriteDepthStencilState, transparencyQueue, useOit ? &oitPass : nullptr, pSceneBuffer, pMaterialBuffer, pTextureNormalView,
+                        sceneCubes, constants, frame);
+                    constants.EndFrame();
+                }
+
+                // Раз в секунду - загрузки констант за кадр в окно отладчика
+                if (std::chrono::duration<double>(currentTime - statsTime).count() >= 1.0) {
+                    const UploadRingStats& ringStats = constants.GetRingStats();
+                    const double frames = constants.GetFrameCount() > 0 ? static_cast<double>(constants.GetFrameCount()) : 1.0;
+                    wchar_t report[256];
+                    swprintf_s(report, L"Constants per frame: %.1f ring uploads (%.1f KB, %.1f KB with padding, %.1f Map), %.1f UpdateSubresource (%.1f KB); %llu waits, %llu wraps\n",
+                        ringStats.uploadCount / frames, ringStats.byteCount / frames / 1024.0, ringStats.paddedByteCount / frames / 1024.0, ringStats.mapCount / frames,
+                        constants.GetFallbackCount() / frames, constants.GetFallbackBytes() / frames / 1024.0, ringStats.waitCount, ringStats.wrapCount);
+                    OutputDebugStringW(report);
+                    const TransformUpdateStats& transformStats = sceneTransforms.set.GetStats();
+                    swprintf_s(report, L"Transforms: %u of %u normal matrices and %u of %u GeomBuffers recomputed%s; %.1f constant uploads (%.1f KB) skipped per frame\n",
+                        transformStats.normalsRecomputed, transformStats.objectCount, transformStats.constantsRebuilt, transformStats.objectCount,
+                        transformStats.cameraChanged ? L" (camera moved)" : L"", constants.GetSkippedCount() / frames, constants.GetSkippedBytes() / frames / 1024.0);
+                    OutputDebugStringW(report);
+                    constants.ResetStats();
+                    statsTime = currentTime;
+                }
+            }
+            {
+                ProfileZone zone("Present");
+                pSwapChain->Present(1, 0);
+            }
+
+            // Зоны собираются раз в кадр; раз в секунду - перцентили этапов за последние
+            // FrameProfiler::kWindowSize замеров в окно отладчика
+            FrameProfiler& profiler = GetFrameProfiler();
+            profiler.Collect();
+            if (std::chrono::duration<double>(currentTime - profileTime).count() >= 1.0) {
+                for (const ProfileStageStats& stage : profiler.GetStageStats()) {
+                    wchar_t report[160];
+                    swprintf_s(report, L"%-22S p50 %.3f ms, p95 %.3f ms, p99 %.3f ms, max %.3f ms\n",
+                        stage.name, stage.p50, stage.p95, stage.p99, stage.maximum);
+                    OutputDebugStringW(report);
+                }
+                profileTime = currentTime;
+            }
+
+            // Время до первого кадра и до полной загрузки текстур - в окно отладчика
+            const double streamTime = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - streamStartTime).count();
+            if (!firstFrameReported) {
+                wchar_t report[128];
+                swprintf_s(report, L"First frame: %.1f ms after texture requests\n", streamTime);
+                OutputDebugStringW(report);
+                firstFrameReported = true;
+            }
+            if (!streamingReported && textureStreamer.IsIdle()) {
+                const TextureStreamerStats& streamStats = textureStreamer.GetStats();
+                const TextureCacheStats cacheStats = textureCache.GetStats();
+                wchar_t report[256];
+                swprintf_s(report, L"Textures resident: %.1f ms, %u of %u (%u failed), %llu uploads, %.1f MB\n",
+                    streamTime, streamStats.fullyResident, streamStats.requested, streamStats.failed, streamStats.uploadCount,
+                    streamStats.bytesUploaded / (1024.0 * 1024.0));
+                OutputDebugStringW(report);
+                swprintf_s(report, L"Texture cache: %llu loaded, %llu path hits, %llu content hits, %.1f MB loaded, %.1f MB saved\n",
+                    cacheStats.misses, cacheStats.pathHits, cacheStats.contentHits, cacheStats.bytesLoaded / (1024.0 * 1024.0), cacheStats.bytesSaved / (1024.0 * 1024.0));
+                OutputDebugStringW(report);
+                streamingReported = true;
+            }
+
+            if (cameraDriver.IsFinished()) {
+                PostQuitMessage(0);
+            }
         }
     }
 
+    // Запись клавиш сохраняется при выходе
+    if (!cameraDriver.Stop()) {
+        OutputDebugStringA(cameraDriver.GetErrorMessage());
+    }
+
+    if (writeTrace) {
+        GetFrameProfiler().Collect();
+        GetFrameProfiler().WriteChromeTrace(L"frame_trace.json");
+    }
+
     // Освобождение ресурсов
+    textureTarget.Clear();
+    cubeBackend.Clear();
+    oitPass.Clear();
+    lightClusterBuffers.Clear();
+    constants.Clear();
     if (pVertexBuffer) pVertexBuffer->Release();
+    if (pPackedBoundsBuffer) pPackedBoundsBuffer->Release();
     if (pIndexBuffer) pIndexBuffer->Release();
     if (pVertexShader) pVertexShader->Release();
     if (pPixelShader) pPixelShader->Release();
@@ -1000,11 +1966,12 @@ int APIENTRY wWinMain(_In_ HINSTANCE hInstance, _In_opt_ HINSTANCE hPrevInstance
     if (pDeviceContext) pDeviceContext->Release();
     if (pDevice) pDevice->Release();
     if (pGeomBuffer) pGeomBuffer->Release();
+    if (pLightPixelShader) pLightPixelShader->Release();
+    if (pInstancedVertexShader) pInstancedVertexShader->Release();
+    if (pInstancedInputLayout) pInstancedInputLayout->Release();
     if (pDepthStencilView) pDepthStencilView->Release();
     if (pDepthStencilTexture) pDepthStencilTexture->Release();
-    if (pTextureView) pTextureView->Release();
     if (pSampler) pSampler->Release();
-    if (pTexture) pTexture->Release();
 
     if (pSphereVertexBuffer) pSphereVertexBuffer->Release();
     if (pSphereIndexBuffer) pSphereIndexBuffer->Release();
@@ -1012,8 +1979,6 @@ int APIENTRY wWinMain(_In_ HINSTANCE hInstance, _In_opt_ HINSTANCE hPrevInstance
     if (pSpherePixelShader) pSpherePixelShader->Release();
     if (pSphereInputLayout) pSphereInputLayout->Release();
     if (pSphereGeomBuffer) pSphereGeomBuffer->Release();
-    if (pSphereTextureView) pSphereTextureView->Release();
-    if (pSphereTexture) pSphereTexture->Release();
 
     if (pSquareVertexBuffer) pSquareVertexBuffer->Release();
     if (pSquareIndexBuffer) pSquareIndexBuffer->Release();
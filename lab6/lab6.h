@@ -1,103 +1,55 @@
 #pragma once
 
 #include "resource.h"
+#include "SceneTypes.h"
+#include "SceneMeshes.h"
+#include "SoftwareRasterizer.h"
+#include "DdsFile.h"
+#include "BlockCompression.h"
+#include "TextureCache.h"
+#include "TextureStreamer.h"
+#include "ShaderCache.h"
+#include "Instancing.h"
+#include "FrustumCulling.h"
+#include "TransparencyQueue.h"
+#include "OitReference.h"
+#include "LightClusters.h"
+#include "UploadRing.h"
+#include "Transforms.h"
+#include "TransformBatch.h"
+#include "SceneGraph.h"
+#include "SceneFrame.h"
+#include "FrameProfiler.h"
+#include "MicroBenchmark.h"
+#include "MeshOptimizer.h"
+#include "MeshImporter.h"
+#include "PackedVertex.h"
+#include "Meshlets.h"
+#include "MeshSimplifier.h"
+#include "CameraDriver.h"
+#include "HeadlessRenderer.h"
+#include "LabTests.h"
+#include "Reports.h"
 #include <dxgi.h>
 #include <d3dcompiler.h>
 #include <cmath>
 #include <string>
 #include <vector>
 #include <chrono>
+#include <memory>
+#include <cstdio>
+#include <random>
 #include <DirectXMath.h>
 #include "DirectXTex.h"
 #include <algorithm>
 #include <d3d11.h>
+#include <d3d11_1.h>
 #include <windows.h>
 
 #pragma comment(lib, "d3d11.lib")
 #pragma comment(lib, "dxgi.lib")
 #pragma comment(lib, "d3dcompiler.lib")
 
-struct TextureVertex {
-    float x, y, z; //  
-    float u, v; //  
-};
-
-struct TextureNormalVertex {
-    float x, y, z; //  
-    float nx, ny, nz; //  
-    float u, v; //  
-};
-
-struct TextureTangentVertex {
-    float x, y, z;       //  
-    float nx, ny, nz;    //  
-    float tx, ty, tz;    //  
-    float u, v;          //  
-};
-
-struct SphereVertex {
-    float x, y, z;
-};
-
-static const TextureTangentVertex Vertices[24] = {
-    // Bottom face
-    {-0.5f, -0.5f,  0.5f, 0.0f, -1.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f, 1.0f}, // 0
-    { 0.5f, -0.5f,  0.5f, 0.0f, -1.0f, 0.0f, 1.0f, 0.0f, 0.0f, 1.0f, 1.0f}, // 1
-    { 0.5f, -0.5f, -0.5f, 0.0f, -1.0f, 0.0f, 1.0f, 0.0f, 0.0f, 1.0f, 0.0f}, // 2
-    {-0.5f, -0.5f, -0.5f, 0.0f, -1.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f, 0.0f}, // 3
-
-    // Right face
-    { 0.5f, -0.5f, -0.5f, 1.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 1.0f}, // 4
-    { 0.5f, -0.5f,  0.5f, 1.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f, 1.0f, 1.0f}, // 5
-    { 0.5f,  0.5f,  0.5f, 1.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f, 1.0f, 0.0f}, // 6
-    { 0.5f,  0.5f, -0.5f, 1.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f}, // 7
-
-    // Front face
-    {-0.5f, -0.5f,  0.5f, 0.0f, 0.0f, 1.0f, 1.0f, 0.0f, 0.0f, 0.0f, 1.0f}, // 8
-    { 0.5f, -0.5f,  0.5f, 0.0f, 0.0f, 1.0f, 1.0f, 0.0f, 0.0f, 1.0f, 1.0f}, // 9
-    { 0.5f,  0.5f,  0.5f, 0.0f, 0.0f, 1.0f, 1.0f, 0.0f, 0.0f, 1.0f, 0.0f}, // 10
-    {-0.5f,  0.5f,  0.5f, 0.0f, 0.0f, 1.0f, 1.0f, 0.0f, 0.0f, 0.0f, 0.0f}, // 11
-
-    // Back face
-    {-0.5f, -0.5f, -0.5f, 0.0f, 0.0f, -1.0f, 1.0f, 0.0f, 0.0f, 1.0f, 1.0f}, // 12
-    { 0.5f, -0.5f, -0.5f, 0.0f, 0.0f, -1.0f, 1.0f, 0.0f, 0.0f, 0.0f, 1.0f}, // 13
-    { 0.5f,  0.5f, -0.5f, 0.0f, 0.0f, -1.0f, 1.0f, 0.0f, 0.0f, 0.0f, 0.0f}, // 14
-    {-0.5f,  0.5f, -0.5f, 0.0f, 0.0f, -1.0f, 1.0f, 0.0f, 0.0f, 1.0f, 0.0f}, // 15
-
-    // Top face
-    {-0.5f,  0.5f,  0.5f, 0.0f, 1.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f, 1.0f}, // 16
-    { 0.5f,  0.5f,  0.5f, 0.0f, 1.0f, 0.0f, 1.0f, 0.0f, 0.0f, 1.0f, 1.0f}, // 17
-    { 0.5f,  0.5f, -0.5f, 0.0f, 1.0f, 0.0f, 1.0f, 0.0f, 0.0f, 1.0f, 0.0f}, // 18
-    {-0.5f,  0.5f, -0.5f, 0.0f, 1.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f, 0.0f}, // 19
-
-    // Left face
-    {-0.5f, -0.5f, -0.5f, -1.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 1.0f}, // 20
-    {-0.5f, -0.5f,  0.5f, -1.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f, 1.0f, 1.0f}, // 21
-    {-0.5f,  0.5f,  0.5f, -1.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f, 1.0f, 0.0f}, // 22
-    {-0.5f,  0.5f, -0.5f, -1.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f}  // 23
-};
-
-struct GeomBuffer {
-    DirectX::XMMATRIX model;
-    DirectX::XMMATRIX view;
-    DirectX::XMMATRIX projection;
-    DirectX::XMMATRIX normalMatrix; //    
-};
-
-static const UINT16 Indices[36] = {
-    0, 2, 1, 0, 3, 2,
-
-    4, 6, 5, 4, 7, 6,
-
-    8, 9, 10, 8, 10, 11,
-
-    12, 14, 13, 12, 15, 14,
-
-    16, 17, 18, 16, 18, 19,
-
-    20, 21, 22, 20, 22, 23
-};
-
 struct TextureDesc
 {
     UINT32 pitch = 0;
@@ -105,88 +57,134 @@ struct TextureDesc
     DXGI_FORMAT fmt = DXGI_FORMAT_UNKNOWN;
     UINT32 width = 0;
     UINT32 height = 0;
-    void* pData = nullptr;
-    DirectX::ScratchImage image;
+    const void* pData = nullptr;
+    std::shared_ptr<TextureData> pSource; //    TextureCache:     
 };
 
-static const SphereVertex SkyboxVertices[24] = {
-    {-100.0f, -100.0f,  100.0f}, // 0
-    { 100.0f, -100.0f,  100.0f}, // 1
-    { 100.0f, -100.0f, -100.0f}, // 2
-    {-100.0f, -100.0f, -100.0f}, // 3
-
-    { 100.0f, -100.0f, -100.0f}, // 4
-    { 100.0f, -100.0f,  100.0f}, // 5
-    { 100.0f,  100.0f,  100.0f}, // 6
-    { 100.0f,  100.0f, -100.0f}, // 7
-
-    {-100.0f, -100.0f,  100.0f}, // 8
-    { 100.0f, -100.0f,  100.0f}, // 9
-    { 100.0f,  100.0f,  100.0f}, // 10
-    {-100.0f,  100.0f,  100.0f}, // 11
-
-    {-100.0f, -100.0f, -100.0f}, // 12
-    { 100.0f, -100.0f, -100.0f}, // 13
-    { 100.0f,  100.0f, -100.0f}, // 14
-    {-100.0f,  100.0f, -100.0f}, // 15
-
-    {-100.0f,  100.0f,  100.0f}, // 16
-    { 100.0f,  100.0f,  100.0f}, // 17
-    { 100.0f,  100.0f, -100.0f}, // 18
-    {-100.0f,  100.0f, -100.0f}, // 19
-
-    {-100.0f, -100.0f, -100.0f}, // 20
-    {-100.0f, -100.0f,  100.0f}, // 21
-    {-100.0f,  100.0f,  100.0f}, // 22
-    {-100.0f,  100.0f, -100.0f}  // 23
+const char* vertexShaderCode = R"(
+cbuffer GeomBuffer : register(b0)
+{
+    float4x4 model;
+    float4x4 view;
+    float4x4 projection;
+    float4x4 normalMatrix; //    
 };
 
-static const UINT16 SkyboxIndices[36] = {
-    0, 1, 2, 0, 2, 3,
-
-    4, 5, 6, 4, 6, 7,
-
-    8, 10, 9, 8, 11, 10,
-
-    12, 13, 14, 12, 14, 15,
+#if PACKED_VERTEX
+//   PackedTangentVertex (PackedVertex.h):   UNORM16  AABB ,
+//       (SNORM8),    half
+cbuffer PackedVertexBuffer : register(b5)
+{
+    float4 positionOffset;
+    float4 positionScale;
+};
 
-    16, 18, 17, 16, 19, 18,
+float3 DecodeOctahedral(float2 encoded)
+{
+    float3 v = float3(encoded, 1.0 - abs(encoded.x) - abs(encoded.y));
+    float fold = saturate(-v.z);
+    v.xy += v.xy >= 0.0 ? -fold : fold;
+    return normalize(v);
+}
+#endif
 
-    20, 22, 21, 20, 23, 22
+struct VSInput
+{
+#if PACKED_VERTEX
+    float4 pos : POSITION;
+    float4 frame : NORMAL;
+    float2 uv : TEXCOORD;
+#else
+    float3 pos : POSITION;
+    float3 norm : NORMAL;
+    float3 tang : TANGENT;
+    float2 uv : TEXCOORD;
+#endif
 };
 
-struct Light {
-    DirectX::XMFLOAT4 pos; //    (x, y, z, w)
-    DirectX::XMFLOAT4 color; //    (r, g, b, a)
+struct VSOutput
+{
+    float4 pos : SV_Position;
+    float4 worldPos : POSITION;
+    float3 norm : NORMAL;
+    float3 tang : TANGENT;
+    float2 uv : TEXCOORD;
 };
 
-struct SceneBuffer {
-    DirectX::XMMATRIX vp; //    
-    DirectX::XMFLOAT4 cameraPos; //   (x, y, z, w)
-    DirectX::XMFLOAT4 lightCount; //    (x)
-    Light lights[10]; //    ( 10)
-    DirectX::XMFLOAT4 ambientColor; //    (r, g, b, a)
-};
+VSOutput vs(VSInput vertex)
+{
+#if PACKED_VERTEX
+    float3 position = positionOffset.xyz + vertex.pos.xyz * positionScale.xyz;
+    float3 normal = DecodeOctahedral(vertex.frame.xy);
+    float3 tangent = DecodeOctahedral(vertex.frame.zw);
+    tangent = normalize(tangent - normal * dot(tangent, normal));
+#else
+    float3 position = vertex.pos;
+    float3 normal = vertex.norm;
+    float3 tangent = vertex.tang;
+#endif
 
-struct MaterialBuffer {
-    DirectX::XMFLOAT4 shine; // x -  
-};
+    VSOutput result;
+    float4 pos = float4(position, 1.0);
+    result.worldPos = mul(model, pos); //   
+    pos = mul(view, result.worldPos);
+    pos = mul(projection, pos);
+    result.pos = pos;
+    result.norm = mul((float3x3)normalMatrix, normal); //  
+    result.tang = mul((float3x3)model, tangent);
+    result.uv = vertex.uv;
+    return result;
+}
+)";
 
-const char* vertexShaderCode = R"(
+//       :      
+// ( 1),  GeomBuffer   view  projection
+const char* vertexInstancedShaderCode = R"(
 cbuffer GeomBuffer : register(b0)
 {
     float4x4 model;
     float4x4 view;
     float4x4 projection;
-    float4x4 normalMatrix; //    
+    float4x4 normalMatrix;
+};
+
+#if PACKED_VERTEX
+//  ,   vertexShaderCode
+cbuffer PackedVertexBuffer : register(b5)
+{
+    float4 positionOffset;
+    float4 positionScale;
 };
 
+float3 DecodeOctahedral(float2 encoded)
+{
+    float3 v = float3(encoded, 1.0 - abs(encoded.x) - abs(encoded.y));
+    float fold = saturate(-v.z);
+    v.xy += v.xy >= 0.0 ? -fold : fold;
+    return normalize(v);
+}
+#endif
+
 struct VSInput
 {
+#if PACKED_VERTEX
+    float4 pos : POSITION;
+    float4 frame : NORMAL;
+    float2 uv : TEXCOORD;
+#else
     float3 pos : POSITION;
     float3 norm : NORMAL;
     float3 tang : TANGENT;
     float2 uv : TEXCOORD;
+#endif
+    //  XMMATRIX ,   -    
+    float4 model0 : INSTANCE_MODEL0;
+    float4 model1 : INSTANCE_MODEL1;
+    float4 model2 : INSTANCE_MODEL2;
+    float4 model3 : INSTANCE_MODEL3;
+    float3 normal0 : INSTANCE_NORMAL0;
+    float3 normal1 : INSTANCE_NORMAL1;
+    float3 normal2 : INSTANCE_NORMAL2;
 };
 
 struct VSOutput
@@ -200,14 +198,28 @@ struct VSOutput
 
 VSOutput vs(VSInput vertex)
 {
+    float4x4 instanceModel = float4x4(vertex.model0, vertex.model1, vertex.model2, vertex.model3);
+    float3x3 instanceNormal = float3x3(vertex.normal0, vertex.normal1, vertex.normal2);
+
+#if PACKED_VERTEX
+    float3 position = positionOffset.xyz + vertex.pos.xyz * positionScale.xyz;
+    float3 normal = DecodeOctahedral(vertex.frame.xy);
+    float3 tangent = DecodeOctahedral(vertex.frame.zw);
+    tangent = normalize(tangent - normal * dot(tangent, normal));
+#else
+    float3 position = vertex.pos;
+    float3 normal = vertex.norm;
+    float3 tangent = vertex.tang;
+#endif
+
     VSOutput result;
-    float4 pos = float4(vertex.pos, 1.0);
-    result.worldPos = mul(model, pos); //   
+    float4 pos = float4(position, 1.0);
+    result.worldPos = mul(pos, instanceModel);
     pos = mul(view, result.worldPos);
     pos = mul(projection, pos);
     result.pos = pos;
-    result.norm = mul((float3x3)normalMatrix, vertex.norm); //  
-    result.tang = mul((float3x3)model, vertex.tang);
+    result.norm = mul(normal, instanceNormal);
+    result.tang = mul(tangent, (float3x3)instanceModel);
     result.uv = vertex.uv;
     return result;
 }
@@ -237,6 +249,24 @@ cbuffer MaterialBuffer : register(b2)
     float4 shine; // x -  
 };
 
+//     ( -lights):    LightClusterGrid
+struct PointLight {
+    float3 pos;
+    float radius;
+    float3 color;
+    float padding;
+};
+
+StructuredBuffer<PointLight> pointLights : register(t2);
+StructuredBuffer<uint2> lightClusters : register(t3); //      lightIndices
+StructuredBuffer<uint> lightIndices : register(t4);
+
+cbuffer ClusterBuffer : register(b4)
+{
+    float4 clusterGrid;  //      ,   x   y
+    float4 clusterDepth; //  = log(z) * x + y, z -  , w - 1,   
+};
+
 struct VSOutput
 {
     float4 pos : SV_Position;
@@ -246,6 +276,18 @@ struct VSOutput
     float2 uv : TEXCOORD;
 };
 
+float3 ShadeLight(float3 color, float3 normal, float3 viewDir, float3 lightDir, float3 lightColor)
+{
+    //  
+    float diff = max(dot(lightDir, normal), 0.0);
+    float3 result = color * diff * lightColor;
+
+    //  
+    float3 reflectDir = reflect(-lightDir, normal);
+    float spec = shine.x > 0 ? pow(max(dot(viewDir, reflectDir), 0.0), shine.x) : 0.0;
+    return result + color * spec * lightColor;
+}
+
 float4 ps(VSOutput pixel) : SV_Target
 {
     float3 color = colorTexture.Sample(colorSampler, pixel.uv).xyz;
@@ -268,15 +310,24 @@ float4 ps(VSOutput pixel) : SV_Target
         float3 lightDir = lights[i].pos.xyz - pixel.worldPos.xyz;
         float lightDist = length(lightDir);
         lightDir /= lightDist;
+        finalColor += ShadeLight(color, normal, viewDir, lightDir, lights[i].color.xyz);
+    }
 
-        //  
-        float diff = max(dot(lightDir, normal), 0.0);
-        finalColor += color * diff * lights[i].color.xyz;
-
-        //  
-        float3 reflectDir = reflect(-lightDir, normal);
-        float spec = shine.x > 0 ? pow(max(dot(viewDir, reflectDir), 0.0), shine.x) : 0.0;
-        finalColor += color * spec * lights[i].color.xyz;
+    //  :   SV_Position,       (pos.w)
+    if (clusterDepth.w > 0)
+    {
+        uint2 tile = min(uint2(pixel.pos.xy / clusterGrid.xy), uint2(clusterGrid.zw) - 1);
+        uint slice = uint(clamp(log(pixel.pos.w) * clusterDepth.x + clusterDepth.y, 0.0, clusterDepth.z - 1));
+        uint2 range = lightClusters[(slice * uint(clusterGrid.w) + tile.y) * uint(clusterGrid.z) + tile.x];
+        for (uint k = 0; k < range.y; k++)
+        {
+            PointLight light = pointLights[lightIndices[range.x + k]];
+            float3 lightDir = light.pos - pixel.worldPos.xyz;
+            float distSq = dot(lightDir, lightDir);
+            float falloff = saturate(1.0 - distSq / (light.radius * light.radius));
+            lightDir *= rsqrt(max(distSq, 1e-8));
+            finalColor += falloff * falloff * ShadeLight(color, normal, viewDir, lightDir, light.color);
+        }
     }
 
     return float4(finalColor, 1.0);
@@ -324,37 +375,6 @@ float4 ps(VSOutput pixel) : SV_Target0 {
 }
 )";
 
-//  
-struct SquareInfo {
-    DirectX::XMFLOAT3 position;
-    DirectX::XMFLOAT4 color;
-    float distance;
-    UINT startIndex;
-};
-
-struct ColorBuffer {
-    DirectX::XMFLOAT4 color;
-};
-
-static const TextureNormalVertex SquareVertices[] = {
-    //   (  X  -2)
-    {0.9f, -0.5f,  0.5f, 1.0f, 0.0f, 0.0f, 0.0f, 0.0f}, // 0
-    {0.9f, -0.5f, -0.5f, 1.0f, 0.0f, 0.0f, 1.0f, 0.0f}, // 1
-    {0.9f,  0.5f, -0.5f, 1.0f, 0.0f, 0.0f, 1.0f, 1.0f}, // 2
-    {0.9f,  0.5f,  0.5f, 1.0f, 0.0f, 0.0f, 0.0f, 1.0f}, // 3
-
-    //   (  X  -3)
-    {1.0f, -0.5f,  0.5f, 1.0f, 0.0f, 0.0f, 0.0f, 0.0f}, // 4
-    {1.0f, -0.5f, -0.5f, 1.0f, 0.0f, 0.0f, 1.0f, 0.0f}, // 5
-    {1.0f,  0.5f, -0.5f, 1.0f, 0.0f, 0.0f, 1.0f, 1.0f}, // 6
-    {1.0f,  0.5f,  0.5f, 1.0f, 0.0f, 0.0f, 0.0f, 1.0f}  // 7
-};
-
-static const UINT16 SquareIndices[] = {
-    0, 1, 2, 0, 2, 3,
-    4, 5, 6, 4, 6, 7
-};
-
 const char* vertexColorShaderCode = R"(
 cbuffer GeomBuffer : register(b0)
 {
@@ -428,7 +448,7 @@ struct VSOutput
     float2 uv : TEXCOORD;
 };
 
-float4 ps(VSOutput pixel) : SV_Target
+float3 ShadeSquare(VSOutput pixel)
 {
     float3 finalColor = ambientColor.xyz * color; //  
 
@@ -452,7 +472,63 @@ float4 ps(VSOutput pixel) : SV_Target
         //finalColor += color * spec * lights[i].color.xyz;
     }
 
-    return float4(finalColor, color.w);
+    return finalColor;
+}
+
+float4 ps(VSOutput pixel) : SV_Target
+{
+    return float4(ShadeSquare(pixel), color.w);
+}
+
+//     (-oit):       .
+//  -  9  McGuire, Bavoil 2013,  ComputeOitWeight  OitReference.cpp; z -   .
+struct OitOutput
+{
+    float4 accum : SV_Target0;     // rgb * a * w  a * w,  ONE + ONE
+    float revealage : SV_Target1;  // a,  ZERO + INV_SRC_COLOR
+};
+
+OitOutput psOit(VSOutput pixel)
+{
+    float z = length(cameraPos.xyz - pixel.worldPos.xyz);
+    float weight = color.w * clamp(10.0 / (1e-5 + pow(z / 5.0, 2.0) + pow(z / 200.0, 6.0)), 1e-2, 3e3);
+
+    OitOutput result;
+    result.accum = float4(ShadeSquare(pixel) * weight, weight);
+    result.revealage = color.w;
+    return result;
+}
+)";
+
+//      :     
+const char* oitCompositeShaderCode = R"(
+Texture2D accumTexture : register(t0);
+Texture2D revealageTexture : register(t1);
+
+struct VSOutput
+{
+    float4 pos : SV_Position;
+};
+
+VSOutput vs(uint id : SV_VertexID)
+{
+    VSOutput result;
+    float2 uv = float2((id << 1) & 2, id & 2);
+    result.pos = float4(uv * float2(2.0, -2.0) + float2(-1.0, 1.0), 0.0, 1.0);
+    return result;
+}
+
+float4 ps(VSOutput pixel) : SV_Target
+{
+    int3 coord = int3(pixel.pos.xy, 0);
+    float revealage = revealageTexture.Load(coord).r;
+    if (revealage >= 1.0)
+    {
+        discard; //    
+    }
+    float4 accum = accumTexture.Load(coord);
+    float3 average = accum.rgb / clamp(accum.a, 1e-5, 5e4);
+    return float4(average, 1.0 - revealage); //  SRC_ALPHA + INV_SRC_ALPHA
 }
 )";
 